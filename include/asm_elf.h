@@ -0,0 +1,96 @@
+/*
+ * Relocatable ELF object model.
+ *
+ * The integrated assembler collects the bytes of each section, the
+ * symbols it defines or references and the relocations left for the
+ * linker in an asm_object_t.  asm_elf_write() then lays the object out
+ * as an ELF32 file with REL relocations for i386 or an ELF64 file with
+ * RELA relocations for x86-64.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#ifndef VC_ASM_ELF_H
+#define VC_ASM_ELF_H
+
+#include <stddef.h>
+#include "vector.h"
+
+/* ELF constants used by the assembler */
+#define ASM_SHT_PROGBITS 1
+#define ASM_SHT_NOBITS 8
+#define ASM_SHF_WRITE 0x1
+#define ASM_SHF_ALLOC 0x2
+#define ASM_SHF_EXECINSTR 0x4
+#define ASM_STT_NOTYPE 0
+#define ASM_STT_OBJECT 1
+#define ASM_STT_FUNC 2
+
+/* Relocation kinds, mapped to R_386_* or R_X86_64_* when written */
+typedef enum {
+    ASM_RELOC_ABS32,    /* 32-bit absolute, zero extended in 64-bit mode */
+    ASM_RELOC_ABS32S,   /* 32-bit absolute, sign extended */
+    ASM_RELOC_ABS64,    /* 64-bit absolute */
+    ASM_RELOC_PC32,     /* 32-bit PC relative */
+    ASM_RELOC_PLT32     /* 32-bit PC relative call or jump */
+} asm_reloc_kind_t;
+
+typedef struct {
+    size_t offset;          /* position of the field in the section */
+    int symbol;             /* index into asm_object_t.symbols or -1 */
+    int section;            /* section symbol used when SYMBOL is -1 */
+    asm_reloc_kind_t kind;
+    long long addend;
+} asm_reloc_t;
+
+typedef struct {
+    const char *name;       /* interned */
+    unsigned type;          /* ASM_SHT_PROGBITS or ASM_SHT_NOBITS */
+    unsigned flags;         /* ASM_SHF_* bits */
+    unsigned char *data;    /* contents, NULL for SHT_NOBITS */
+    size_t size;
+    size_t cap;
+    size_t align;
+    vector_t relocs;        /* asm_reloc_t */
+} asm_section_t;
+
+typedef struct {
+    const char *name;       /* interned */
+    int section;            /* index into asm_object_t.sections or -1 */
+    size_t value;           /* offset in the section */
+    size_t size;
+    int global;
+    int type;               /* ASM_STT_NOTYPE, _OBJECT or _FUNC */
+} asm_symbol_t;
+
+typedef struct {
+    vector_t sections;      /* asm_section_t */
+    vector_t symbols;       /* asm_symbol_t */
+} asm_object_t;
+
+#define ASM_SECTION(obj, i) (&((asm_section_t *)(obj)->sections.data)[i])
+#define ASM_SYMBOL(obj, i) (&((asm_symbol_t *)(obj)->symbols.data)[i])
+
+void asm_object_init(asm_object_t *obj);
+void asm_object_free(asm_object_t *obj);
+
+/*
+ * Return the index of the section NAME, creating it with TYPE and FLAGS
+ * when it does not exist yet.  Returns -1 on allocation failure.
+ */
+int asm_object_section(asm_object_t *obj, const char *name, unsigned type,
+                       unsigned flags);
+
+/* Append LEN bytes to SEC.  Returns 0 on allocation failure. */
+int asm_section_append(asm_section_t *sec, const void *bytes, size_t len);
+
+/*
+ * Write OBJ to PATH as a 32- or 64-bit relocatable object.  The fields
+ * of i386 relocations must already hold their addends, REL entries
+ * having no addend of their own.  SHT_NOBITS sections may not carry
+ * relocations.  Errors are reported to stderr and 0 is returned.
+ */
+int asm_elf_write(const asm_object_t *obj, int x64, const char *path);
+
+#endif /* VC_ASM_ELF_H */
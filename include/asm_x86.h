@@ -0,0 +1,99 @@
+/*
+ * Integrated x86 assembler.
+ *
+ * Translates the AT&T assembly produced by the code generator into a
+ * relocatable ELF object without running an external assembler.  Only
+ * the subset of the GNU syntax the compiler emits is accepted: labels,
+ * the section, symbol and data directives written by codegen.c and the
+ * instructions selected by the codegen_* modules.  Writable data goes
+ * to .data, constants to .rodata and .lcomm storage to .bss, which holds
+ * only zeros and no relocations.  Encodings follow the choices GNU as
+ * makes so objects can be compared byte for byte with the external path.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#ifndef VC_ASM_X86_H
+#define VC_ASM_X86_H
+
+#include <stddef.h>
+#include "asm_elf.h"
+
+typedef enum {
+    ASM_OP_REG,         /* general purpose register */
+    ASM_OP_XMM,         /* SSE register */
+    ASM_OP_IMM,         /* $expr */
+    ASM_OP_MEM          /* disp(base,index,scale) or an absolute address */
+} asm_operand_kind_t;
+
+/* Symbolic expression SYM + VALUE; SYM is -1 for plain numbers */
+typedef struct {
+    int sym;
+    long long value;
+} asm_expr_t;
+
+typedef struct {
+    asm_operand_kind_t kind;
+    int reg;            /* register number 0-15, -1 when absent */
+    int size;           /* register width in bytes */
+    int rex_byte;       /* %spl, %bpl, %sil or %dil */
+    int base;           /* memory base register or -1 */
+    int index;          /* memory index register or -1 */
+    int scale;          /* 1, 2, 4 or 8 */
+    int rip;            /* base is %rip */
+    int addr32;         /* 32-bit address registers in 64-bit mode */
+    int indirect;       /* '*' prefix of call and jmp targets */
+    asm_expr_t expr;    /* immediate value or displacement */
+} asm_operand_t;
+
+/* A parsed instruction with its operands in AT&T order */
+typedef struct {
+    const char *mnemonic;
+    size_t mnemonic_len;
+    asm_operand_t ops[3];
+    int nops;
+} asm_insn_t;
+
+/* Field of an encoded instruction that still refers to a symbol */
+typedef struct {
+    size_t offset;      /* position of the field within the instruction */
+    int size;           /* 1, 4 or 8 bytes */
+    int pcrel;          /* relative to the end of the instruction */
+    int branch;         /* target of call or jmp */
+    int sign;           /* 32-bit absolute sign extended */
+    asm_expr_t expr;
+} asm_fixup_t;
+
+/* Bytes of one instruction with up to two symbolic fields */
+typedef struct {
+    unsigned char bytes[16];
+    size_t len;
+    asm_fixup_t fixups[2];
+    int nfixups;
+} asm_code_t;
+
+/*
+ * Encode INS for 32- or 64-bit mode into CODE.  Branches to labels use
+ * an 8-bit displacement when SHORT_BRANCH is set.  Returns 0 and writes
+ * a message to ERR when the instruction or its operands are not
+ * supported.
+ */
+int asm_x86_encode(const asm_insn_t *ins, int x64, int short_branch,
+                   asm_code_t *code, char *err, size_t errlen);
+
+/* Return 1 when INS is a jmp or jcc to a label, which may be relaxed */
+int asm_x86_is_jump(const asm_insn_t *ins);
+
+/*
+ * Assemble LEN bytes of TEXT into OBJ.  Errors are reported to stderr
+ * with the offending line and 0 is returned.
+ */
+int asm_x86_assemble_object(const char *text, size_t len, int x64,
+                            asm_object_t *obj);
+
+/* Assemble TEXT and write the resulting object file to OUTPUT */
+int asm_x86_assemble(const char *text, size_t len, int x64,
+                     const char *output);
+
+#endif /* VC_ASM_X86_H */
@@ -190,6 +190,7 @@ struct func {
     size_t body_count;
     int is_inline;
     int is_noreturn;
+    int is_static;
 };
 
 /* Create a statement from a single expression. */
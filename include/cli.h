@@ -53,23 +53,31 @@ typedef enum {
     CLI_OPT_VC_SYSINCLUDE,
     CLI_OPT_INTERNAL_LIBC,
     CLI_OPT_VERBOSE_INCLUDES,
-    CLI_OPT_NAMED_LOCALS
+    CLI_OPT_NAMED_LOCALS,
+    CLI_OPT_INCLUDE_INDEX,
+    CLI_OPT_INCLUDE_INDEX_STATS,
+    CLI_OPT_DUMP_REGALLOC,
+    CLI_OPT_REGALLOC,
+    CLI_OPT_NO_INTEGRATED_AS
 } cli_opt_id;
 
 /* Command line options parsed from argv */
 typedef struct {
     char *output;       /* output file path */
     opt_config_t opt_cfg; /* optimization configuration */
+    int regalloc;       /* regalloc_mode_t or -1 to follow the -O level */
     bool use_x86_64;    /* enable 64-bit codegen */
     bool compile;       /* assemble to object */
     bool link;          /* build executable */
     bool dump_asm;      /* dump assembly to stdout (-S/--dump-asm) */
     bool dump_ast;      /* dump AST to stdout */
     bool dump_ir;       /* dump IR to stdout */
+    bool dump_regalloc; /* dump register allocation to stdout */
     bool dump_tokens;   /* dump token list to stdout */
     bool preprocess;    /* run preprocessor only and print to stdout */
     bool debug;         /* emit debug directives */
     bool emit_dwarf;    /* emit DWARF line and symbol data */
+    bool integrated_as; /* assemble objects without an external tool */
     bool color_diag;    /* use ANSI colors in diagnostics */
     bool dep_only;      /* generate dependencies only */
     bool deps;          /* generate dependency file */
@@ -81,6 +89,8 @@ typedef struct {
     char *vc_sysinclude; /* first system include directory */
     bool internal_libc; /* use bundled libc */
     bool verbose_includes; /* print include search details */
+    bool include_index;  /* search include dirs via cached listings */
+    bool include_index_stats; /* print include index statistics */
     bool named_locals;   /* keep names for local variables */
     bool free_output;    /* output path needs free */
     bool free_obj_dir;   /* obj_dir was heap allocated */
@@ -93,6 +103,7 @@ typedef struct {
     vector_t lib_dirs;     /* additional library search paths */
     vector_t libs;         /* libraries to link against */
     size_t max_include_depth; /* maximum nested includes */
+    size_t jobs;           /* translation units compiled in parallel */
     char *vcflags_buf;     /* buffer holding VCFLAGS contents */
 } cli_options_t;
 
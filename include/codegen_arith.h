@@ -12,10 +12,9 @@
 #ifndef VC_CODEGEN_ARITH_H
 #define VC_CODEGEN_ARITH_H
 
-#include "strbuf.h"
+#include "x86_insn.h"
 #include "ir_core.h"
 #include "regalloc.h"
-#include "cli.h"
 
 /*
  * Emit assembly for an arithmetic instruction.
@@ -23,8 +22,7 @@
  * `ra` provides operand locations and `x64` selects between 32- and
  * 64-bit instruction encodings.
  */
-void emit_arith_instr(strbuf_t *sb, ir_instr_t *ins,
-                      regalloc_t *ra, int x64,
-                      asm_syntax_t syntax);
+void emit_arith_instr(x86_insn_list_t *code, ir_instr_t *ins,
+                      regalloc_t *ra, int x64);
 
 #endif /* VC_CODEGEN_ARITH_H */
@@ -1,16 +1,13 @@
 #ifndef VC_CODEGEN_ARITH_FLOAT_H
 #define VC_CODEGEN_ARITH_FLOAT_H
 
-#include "strbuf.h"
+#include "x86_insn.h"
 #include "ir_core.h"
 #include "regalloc.h"
-#include "cli.h"
 
-void emit_cast(strbuf_t *sb, ir_instr_t *ins,
-               regalloc_t *ra, int x64,
-               asm_syntax_t syntax);
-void emit_long_float_binop(strbuf_t *sb, ir_instr_t *ins,
-                           regalloc_t *ra, int x64, const char *op,
-                           asm_syntax_t syntax);
+void emit_cast(x86_insn_list_t *code, ir_instr_t *ins,
+               regalloc_t *ra, int x64);
+void emit_long_float_binop(x86_insn_list_t *code, ir_instr_t *ins,
+                           regalloc_t *ra, int x64, x86_opcode_t op);
 
 #endif /* VC_CODEGEN_ARITH_FLOAT_H */
@@ -1,43 +1,33 @@
 #ifndef VC_CODEGEN_ARITH_INT_H
 #define VC_CODEGEN_ARITH_INT_H
 
-#include "strbuf.h"
+#include "x86_insn.h"
 #include "ir_core.h"
 #include "regalloc.h"
-#include "cli.h"
 
-void emit_ptr_add(strbuf_t *sb, ir_instr_t *ins,
-                  regalloc_t *ra, int x64,
-                  asm_syntax_t syntax);
-void emit_ptr_diff(strbuf_t *sb, ir_instr_t *ins,
-                   regalloc_t *ra, int x64,
-                   asm_syntax_t syntax);
-void emit_ptr_arith(strbuf_t *sb, ir_instr_t *ins,
-                    regalloc_t *ra, int x64,
-                    asm_syntax_t syntax);
-void emit_int_arith(strbuf_t *sb, ir_instr_t *ins,
-                    regalloc_t *ra, int x64, const char *op,
-                    asm_syntax_t syntax);
-void emit_div(strbuf_t *sb, ir_instr_t *ins,
-              regalloc_t *ra, int x64,
-              asm_syntax_t syntax);
-void emit_mod(strbuf_t *sb, ir_instr_t *ins,
-              regalloc_t *ra, int x64,
-              asm_syntax_t syntax);
-void emit_shift(strbuf_t *sb, ir_instr_t *ins,
-                regalloc_t *ra, int x64, const char *op,
-                asm_syntax_t syntax);
-void emit_bitwise(strbuf_t *sb, ir_instr_t *ins,
-                  regalloc_t *ra, int x64, const char *op,
-                  asm_syntax_t syntax);
-void emit_cmp(strbuf_t *sb, ir_instr_t *ins,
-              regalloc_t *ra, int x64,
-              asm_syntax_t syntax);
-void emit_logand(strbuf_t *sb, ir_instr_t *ins,
-                 regalloc_t *ra, int x64,
-                 asm_syntax_t syntax);
-void emit_logor(strbuf_t *sb, ir_instr_t *ins,
-                regalloc_t *ra, int x64,
-                asm_syntax_t syntax);
+void emit_ptr_add(x86_insn_list_t *code, ir_instr_t *ins,
+                  regalloc_t *ra, int x64);
+void emit_ptr_diff(x86_insn_list_t *code, ir_instr_t *ins,
+                   regalloc_t *ra, int x64);
+void emit_ptr_arith(x86_insn_list_t *code, ir_instr_t *ins,
+                    regalloc_t *ra, int x64);
+void emit_int_arith(x86_insn_list_t *code, ir_instr_t *ins,
+                    regalloc_t *ra, int x64, x86_opcode_t op);
+void emit_div(x86_insn_list_t *code, ir_instr_t *ins,
+              regalloc_t *ra, int x64);
+void emit_mod(x86_insn_list_t *code, ir_instr_t *ins,
+              regalloc_t *ra, int x64);
+void emit_shift(x86_insn_list_t *code, ir_instr_t *ins,
+                regalloc_t *ra, int x64, x86_opcode_t op);
+void emit_bitwise(x86_insn_list_t *code, ir_instr_t *ins,
+                  regalloc_t *ra, int x64, x86_opcode_t op);
+void emit_copy(x86_insn_list_t *code, ir_instr_t *ins,
+               regalloc_t *ra, int x64);
+void emit_cmp(x86_insn_list_t *code, ir_instr_t *ins,
+              regalloc_t *ra, int x64);
+void emit_logand(x86_insn_list_t *code, ir_instr_t *ins,
+                 regalloc_t *ra, int x64);
+void emit_logor(x86_insn_list_t *code, ir_instr_t *ins,
+                regalloc_t *ra, int x64);
 
 #endif /* VC_CODEGEN_ARITH_INT_H */
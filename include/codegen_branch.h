@@ -11,10 +11,9 @@
 #ifndef VC_CODEGEN_BRANCH_H
 #define VC_CODEGEN_BRANCH_H
 
-#include "strbuf.h"
+#include "x86_insn.h"
 #include "ir_core.h"
 #include "regalloc.h"
-#include "cli.h"
 
 /*
  * Emit assembly for branching and function control flow instructions.
@@ -22,8 +21,7 @@
  * Uses `ra` for stack frame information and chooses between 32- and
  * 64-bit encodings according to `x64`.
  */
-void emit_branch_instr(strbuf_t *sb, ir_instr_t *ins,
-                       regalloc_t *ra, int x64,
-                       asm_syntax_t syntax);
+void emit_branch_instr(x86_insn_list_t *code, ir_instr_t *ins,
+                       regalloc_t *ra, int x64);
 
 #endif /* VC_CODEGEN_BRANCH_H */
@@ -1,22 +1,20 @@
 #ifndef VC_CODEGEN_FLOAT_H
 #define VC_CODEGEN_FLOAT_H
 
-#include "strbuf.h"
+#include "x86_insn.h"
 #include "ir_core.h"
 #include "regalloc.h"
-#include "cli.h"
 
 /* Basic single-precision floating point operations */
-void emit_float_binop(strbuf_t *sb, ir_instr_t *ins,
-                      regalloc_t *ra, int x64, const char *op,
-                      asm_syntax_t syntax);
+void emit_float_binop(x86_insn_list_t *code, ir_instr_t *ins,
+                      regalloc_t *ra, int x64, x86_opcode_t op);
 
 /* Complex arithmetic helpers */
-void emit_cplx_addsub(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
-                      int x64, const char *op, asm_syntax_t syntax);
-void emit_cplx_mul(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
-                   int x64, asm_syntax_t syntax);
-void emit_cplx_div(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
-                   int x64, asm_syntax_t syntax);
+void emit_cplx_addsub(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                      int x64, x86_opcode_t op);
+void emit_cplx_mul(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                   int x64);
+void emit_cplx_div(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                   int x64);
 
 #endif /* VC_CODEGEN_FLOAT_H */
@@ -11,10 +11,9 @@
 #ifndef VC_CODEGEN_LOADSTORE_H
 #define VC_CODEGEN_LOADSTORE_H
 
-#include "strbuf.h"
+#include "x86_insn.h"
 #include "ir_core.h"
 #include "regalloc.h"
-#include "cli.h"
 
 /* Determine the element size for indexed loads and stores. */
 static inline int idx_scale(const ir_instr_t *ins, int x64)
@@ -42,28 +41,22 @@ static inline int idx_scale(const ir_instr_t *ins, int x64)
     }
 }
 
-void emit_load(strbuf_t *sb, ir_instr_t *ins,
-               regalloc_t *ra, int x64,
-               asm_syntax_t syntax);
+void emit_load(x86_insn_list_t *code, ir_instr_t *ins,
+               regalloc_t *ra, int x64);
 
-void emit_store(strbuf_t *sb, ir_instr_t *ins,
-                regalloc_t *ra, int x64,
-                asm_syntax_t syntax);
+void emit_store(x86_insn_list_t *code, ir_instr_t *ins,
+                regalloc_t *ra, int x64);
 
-void emit_load_idx(strbuf_t *sb, ir_instr_t *ins,
-                   regalloc_t *ra, int x64,
-                   asm_syntax_t syntax);
+void emit_load_idx(x86_insn_list_t *code, ir_instr_t *ins,
+                   regalloc_t *ra, int x64);
 
-void emit_store_idx(strbuf_t *sb, ir_instr_t *ins,
-                    regalloc_t *ra, int x64,
-                    asm_syntax_t syntax);
+void emit_store_idx(x86_insn_list_t *code, ir_instr_t *ins,
+                    regalloc_t *ra, int x64);
 
-void emit_load_ptr(strbuf_t *sb, ir_instr_t *ins,
-                   regalloc_t *ra, int x64,
-                   asm_syntax_t syntax);
+void emit_load_ptr(x86_insn_list_t *code, ir_instr_t *ins,
+                   regalloc_t *ra, int x64);
 
-void emit_store_ptr(strbuf_t *sb, ir_instr_t *ins,
-                    regalloc_t *ra, int x64,
-                    asm_syntax_t syntax);
+void emit_store_ptr(x86_insn_list_t *code, ir_instr_t *ins,
+                    regalloc_t *ra, int x64);
 
 #endif /* VC_CODEGEN_LOADSTORE_H */
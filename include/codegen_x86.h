@@ -1,21 +1,48 @@
 #ifndef VC_CODEGEN_X86_H
 #define VC_CODEGEN_X86_H
 
-#include "strbuf.h"
+#include "x86_insn.h"
 #include "ir_core.h"
 #include "regalloc.h"
-#include "cli.h"
 
-const char *x86_reg_str(int reg, const char *sfx, asm_syntax_t syntax);
-const char *x86_fmt_reg(const char *name, asm_syntax_t syntax);
-const char *x86_loc_str(char buf[32], regalloc_t *ra, int id, int x64,
-                        const char *sfx, asm_syntax_t syntax);
+/*
+ * Register operand for allocator index REG.  A SIZE of 4 selects the
+ * 32-bit register, anything else the width of the current mode.
+ */
+x86_operand_t x86_op_reg(int reg, int size);
+/* Like x86_op_reg but also selects the 8- and 16-bit registers */
+x86_operand_t x86_op_subreg(int reg, int size);
+/* Register or stack slot holding IR value ID, none when ID is unset */
+x86_operand_t x86_op_loc(regalloc_t *ra, int id, int x64, int size);
+/* Frame slot OFF bytes below the frame pointer */
+x86_operand_t x86_op_frame(int off, int x64);
+/* Memory operand for a "stack:N" slot name or a global symbol */
+x86_operand_t x86_op_name(const char *name, int x64);
+/* XMM register IDX */
+x86_operand_t x86_op_xmm(int idx);
+/* Memory addressed by register operand REG */
+x86_operand_t x86_op_deref(x86_operand_t reg);
 
-void x86_emit_mov(strbuf_t *sb, const char *sfx,
-                  const char *src, const char *dest,
-                  asm_syntax_t syntax);
-void x86_emit_op(strbuf_t *sb, const char *op, const char *sfx,
-                 const char *src, const char *dest,
-                 asm_syntax_t syntax);
+/*
+ * Memory operand addressed by the pointer value ID.  A spilled pointer is
+ * first loaded into the scratch register.
+ */
+x86_operand_t x86_op_ptr(x86_insn_list_t *code, regalloc_t *ra, int id,
+                         int x64);
+/*
+ * Element `src1` of the array named by INS.  Spilled indices and scales
+ * the addressing modes lack are computed in the scratch register.
+ */
+x86_operand_t x86_op_indexed(x86_insn_list_t *code, ir_instr_t *ins,
+                             regalloc_t *ra, int x64);
+
+/*
+ * Integer move or two-operand instruction.  The Intel form leaves the
+ * operand size to the registers.
+ */
+void x86_emit_mov(x86_insn_list_t *code, char sfx,
+                  x86_operand_t src, x86_operand_t dest);
+void x86_emit_op(x86_insn_list_t *code, x86_opcode_t op, char sfx,
+                 x86_operand_t src, x86_operand_t dest);
 
 #endif /* VC_CODEGEN_X86_H */
@@ -0,0 +1,32 @@
+/*
+ * Parallel compilation of translation units.
+ *
+ * Each source listed on the command line is compiled in its own worker
+ * process so the per-unit state kept by the label, semantic and inline
+ * tracking modules never crosses between units.  Diagnostics and dumps
+ * written by a worker are captured and replayed in source order once the
+ * pool drains, so the output matches a sequential build.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#ifndef VC_COMPILE_JOBS_H
+#define VC_COMPILE_JOBS_H
+
+#include "cli.h"
+
+/* Compile SOURCE into the object file OUTPUT */
+typedef int (*compile_job_fn)(const char *source, const cli_options_t *cli,
+                              const char *output, int compile_obj);
+
+/*
+ * Compile every entry of cli->sources into the matching OUTPUTS path using
+ * up to cli->jobs worker processes.  Returns 1 when every unit compiled
+ * successfully.  On failure the output of units after the first failing
+ * one is discarded, as a sequential build would never have produced it.
+ */
+int compile_jobs_run(const cli_options_t *cli, char *const *outputs,
+                     compile_job_fn compile);
+
+#endif /* VC_COMPILE_JOBS_H */
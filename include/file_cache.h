@@ -0,0 +1,51 @@
+/*
+ * Per-process cache of file system lookups made by the preprocessor.
+ *
+ * Every `#include` used to canonicalize the same path several times and
+ * probe each search directory with access().  The file cache remembers
+ * the outcome of those queries, including negative ones, so repeated
+ * lookups are answered without system calls.  Canonical paths are
+ * interned and stay valid until file_cache_cleanup() is called.  The
+ * spliced text of every loaded source is kept as well, keyed by the
+ * file's device, inode, size and modification time.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+#ifndef VC_FILE_CACHE_H
+#define VC_FILE_CACHE_H
+
+#include <stddef.h>
+#include <sys/stat.h>
+
+/*
+ * Return the interned canonical form of PATH.  When realpath() fails the
+ * path itself is interned and returned so callers always get a usable
+ * string.  The result is owned by the cache.
+ */
+const char *file_cache_realpath(const char *path);
+
+/* Return non-zero when PATH is readable, caching the answer */
+int file_cache_readable(const char *path);
+
+/*
+ * Look up the cached contents of the file at the canonical path CANON.
+ * On a hit a private copy of the text and a NULL terminated line array
+ * pointing into it are returned through OUT_TEXT and OUT_LINES and 1 is
+ * returned.  Returns 0 when the file is not cached or has changed.
+ */
+int file_cache_get_lines(const char *canon, char **out_text,
+                         char ***out_lines);
+
+/*
+ * Store LEN bytes of TEXT (including the final NUL) together with the
+ * NULL terminated LINES array pointing into it for the file at CANON
+ * described by ST.
+ */
+void file_cache_put_lines(const char *canon, const char *text, size_t len,
+                          char **lines, const struct stat *st);
+
+/* Release every cached entry */
+void file_cache_cleanup(void);
+
+#endif /* VC_FILE_CACHE_H */
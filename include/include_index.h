@@ -0,0 +1,41 @@
+/*
+ * Directory listing index for include path searches.
+ *
+ * Probing every search directory with access() costs one failed system
+ * call per directory for each header that lives late in the search list.
+ * When enabled, the index instead reads each directory once with
+ * opendir() the first time it is consulted and answers later queries
+ * from an in-memory hash of its entries.  Subdirectories are indexed on
+ * demand when a header name contains a path component.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+#ifndef VC_INCLUDE_INDEX_H
+#define VC_INCLUDE_INDEX_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/* Enable or disable directory indexing for include searches */
+void include_index_enable(bool flag);
+
+/* Return true when include searches should consult the index */
+bool include_index_enabled(void);
+
+/*
+ * Check whether NAME exists below the directory DIR.  Returns 1 when the
+ * listing contains it, 0 when it definitely does not exist and -1 when
+ * the name cannot be answered from listings (for example when it
+ * contains "." or ".." components) and the caller must probe the file
+ * system directly.
+ */
+int include_index_lookup(const char *dir, const char *name);
+
+/* Print counters describing index usage to FP */
+void include_index_print_stats(FILE *fp);
+
+/* Release all cached directory listings */
+void include_index_cleanup(void);
+
+#endif /* VC_INCLUDE_INDEX_H */
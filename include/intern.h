@@ -0,0 +1,35 @@
+/*
+ * String interning.
+ *
+ * Frequently repeated strings such as identifiers and punctuators are
+ * stored once in an arena and looked up through a hash set.  Interned
+ * strings are NUL terminated, never move and stay valid until
+ * intern_cleanup() is called.  Two interned strings are equal exactly when
+ * their pointers are, so callers holding interned names compare them with
+ * == instead of strcmp().
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#ifndef VC_INTERN_H
+#define VC_INTERN_H
+
+#include <stddef.h>
+
+/* Return the interned copy of the LEN bytes at TEXT */
+const char *intern_text(const char *text, size_t len);
+
+/* Return the interned copy of the NUL terminated string STR */
+const char *intern_str(const char *str);
+
+/*
+ * Return the interned copy of STR if one exists or NULL otherwise.  Useful
+ * for lookups, where a string that was never interned cannot match.
+ */
+const char *intern_find(const char *str);
+
+/* Release every interned string */
+void intern_cleanup(void);
+
+#endif /* VC_INTERN_H */
@@ -0,0 +1,83 @@
+/*
+ * Alias queries over the memory instructions of one function.
+ *
+ * Locals are the "stack:N" slots of the function.  The analysis tracks
+ * which of them a pointer value may address, flow insensitively: the
+ * address of a local flows through arithmetic, copies, phis and locals
+ * holding pointers, and a local escapes once its address is passed to
+ * a call, returned or written to memory.  Pointers obtained any other
+ * way, e.g. loaded from memory or received as a parameter, are unknown
+ * and may reach globals, escaped locals and memory outside the frame.
+ *
+ * On top of the points-to sets two rules of C99 separate accesses: the
+ * effective type rules (6.5p7) for typed accesses of which at least
+ * one goes through a pointer, and `restrict` (6.7.3.1) for accesses
+ * based on different parameters when one of them is restrict
+ * qualified.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#ifndef VC_IR_ALIAS_H
+#define VC_IR_ALIAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ir_core.h"
+
+/* Locals with an own bit in a points-to set; later ones count as escaped */
+#define IR_ALIAS_MAX_LOCALS 63
+
+/* Points-to bit of pointers that may reach memory outside the locals */
+#define IR_ALIAS_UNKNOWN ((uint64_t)1 << IR_ALIAS_MAX_LOCALS)
+
+typedef struct {
+    const char *name;      /* interned variable name */
+    int object;            /* bit of an address taken local or -1 */
+    int exposed;           /* reachable through unknown pointers */
+    uint64_t pts;          /* what a pointer stored in the variable may reach */
+} ir_alias_var_t;
+
+typedef struct {
+    ir_instr_t *begin;     /* IR_FUNC_BEGIN of the analysed function */
+    int lo;                /* smallest value id defined in the function */
+    size_t count;          /* value ids covered from lo on */
+    uint64_t *pts;         /* value id - lo -> points-to set */
+    ir_instr_t **def;      /* value id - lo -> defining instruction */
+    ir_alias_var_t *vars;  /* open addressed by name, NULL name when empty */
+    size_t var_cap;        /* power of two */
+    uint64_t escaped;      /* locals reachable through unknown pointers */
+    uint64_t stored;       /* parameters assigned in the function */
+    int params_exposed;    /* a parameter's address may have been taken */
+} ir_alias_t;
+
+/*
+ * Analyse the function starting at BEGIN.  Values created afterwards
+ * are treated as unknown pointers.  Returns 0 when memory could not be
+ * allocated, leaving AA empty.
+ */
+int ir_alias_init(ir_alias_t *aa, ir_instr_t *begin);
+
+/* Release the tables of AA */
+void ir_alias_free(ir_alias_t *aa);
+
+/*
+ * Return non-zero when the memory instructions A and B may access
+ * overlapping storage.  Instructions that are not loads or stores
+ * conservatively alias everything.
+ */
+int ir_may_alias(const ir_alias_t *aa, const ir_instr_t *a,
+                 const ir_instr_t *b);
+
+/* Return non-zero when a call may read or write what MEM accesses */
+int ir_call_may_access(const ir_alias_t *aa, const ir_instr_t *mem);
+
+/*
+ * Return non-zero when objects accessed with types A and B may overlap
+ * under the effective type rules.  Character types and types the IR
+ * does not record alias everything.
+ */
+int ir_types_may_alias(type_kind_t a, type_kind_t b);
+
+#endif /* VC_IR_ALIAS_H */
@@ -0,0 +1,118 @@
+/*
+ * Control flow graph over the IR instruction list.
+ *
+ * The instruction list stays the primary representation.  The CFG is an
+ * index on top of it: every function between IR_FUNC_BEGIN and
+ * IR_FUNC_END is split into basic blocks describing an instruction range
+ * together with successor and predecessor edges.  A block starts at a
+ * label or after a terminator and ends at a terminator or just before the
+ * next label.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#ifndef VC_IR_CFG_H
+#define VC_IR_CFG_H
+
+#include <stddef.h>
+#include "ir_core.h"
+
+typedef struct {
+    size_t id;          /* index within the owning function */
+    ir_instr_t *first;  /* first instruction, the label when present */
+    ir_instr_t *last;   /* last instruction of the block */
+    ir_instr_t *prev;   /* instruction linked just before first */
+    const char *label;  /* interned label name or NULL */
+    size_t succs[2];    /* branch target first, fall through second */
+    size_t succ_count;
+    size_t *preds;      /* points into the function's edge storage */
+    size_t pred_count;
+} ir_block_t;
+
+/*
+ * Natural loop: a header dominating every member and the blocks that
+ * reach one of its back edges without passing through the header.
+ * Back edges sharing a header form a single loop.
+ */
+typedef struct {
+    size_t header;      /* member dominating all others */
+    size_t parent;      /* index of the enclosing loop or IR_CFG_NO_BLOCK */
+    size_t depth;       /* 1 for loops not nested in another */
+    size_t *blocks;     /* members in reverse postorder, header first */
+    size_t block_count;
+    size_t latch_count; /* members with an edge back to the header */
+} ir_loop_t;
+
+typedef struct {
+    const char *name;      /* interned function name */
+    ir_instr_t *begin;     /* IR_FUNC_BEGIN */
+    ir_instr_t *end;       /* IR_FUNC_END or NULL when missing */
+    ir_block_t *blocks;    /* blocks in list order, entry first */
+    size_t block_count;
+    size_t *edges;         /* predecessor storage shared by the blocks */
+    size_t *label_map;     /* open addressed label -> block id + 1 */
+    size_t label_cap;      /* power of two or zero */
+    size_t *idom;          /* immediate dominators, see ir_cfg_dominators() */
+    size_t *rpo;           /* reachable blocks in reverse postorder */
+    size_t rpo_count;
+    size_t *dom_start;     /* children of b: dom_child[dom_start[b]..[b + 1]] */
+    size_t *dom_child;     /* dominator tree children in block order */
+    ir_loop_t *loops;      /* natural loops, inner before outer */
+    size_t loop_count;
+    size_t *loop_blocks;   /* member storage shared by the loops */
+    size_t *loop_of;       /* innermost loop of every block */
+    int dirty;             /* instruction range changed since the build */
+} ir_function_t;
+
+/* Immediate dominator of unreachable blocks and of the entry block */
+#define IR_CFG_NO_BLOCK ((size_t)-1)
+
+typedef struct {
+    ir_function_t *funcs;
+    size_t func_count;
+} ir_cfg_t;
+
+/*
+ * Build the CFG of every function in IR.  Returns 1 on success and 0
+ * when memory could not be allocated, in which case CFG is left empty.
+ */
+int ir_cfg_build(ir_builder_t *ir, ir_cfg_t *cfg);
+
+/* Recompute the blocks of FN from its begin instruction */
+int ir_cfg_rebuild_function(ir_function_t *fn);
+
+/* Rebuild every function marked dirty.  Returns 0 on allocation failure. */
+int ir_cfg_refresh(ir_cfg_t *cfg);
+
+/* Mark every function dirty after an edit not tracked per function */
+void ir_cfg_invalidate(ir_cfg_t *cfg);
+
+/*
+ * Compute the reverse postorder, the immediate dominator of every block
+ * of FN and the dominator tree.  The results stay valid until FN is
+ * rebuilt.  Returns 0 on allocation failure.
+ */
+int ir_cfg_dominators(ir_function_t *fn);
+
+/* Return non-zero when block A dominates block B */
+int ir_cfg_dominates(const ir_function_t *fn, size_t a, size_t b);
+
+/*
+ * Find the natural loops of FN and their nesting, computing the
+ * dominators first when needed.  Loops are ordered so every loop comes
+ * before the loops enclosing it.  Blocks outside any loop map to
+ * IR_CFG_NO_BLOCK in `loop_of`.  Returns 0 on allocation failure.
+ */
+int ir_cfg_loops(ir_function_t *fn);
+
+/* Return non-zero when block B belongs to loop L of FN or a loop inside it */
+int ir_cfg_loop_contains(const ir_function_t *fn, size_t l, size_t b);
+
+/* Return the block of FN starting with LABEL or NULL */
+ir_block_t *ir_cfg_label_block(const ir_function_t *fn, const char *label);
+
+/* Release all memory owned by CFG */
+void ir_cfg_free(ir_cfg_t *cfg);
+
+#endif /* VC_IR_CFG_H */
@@ -77,7 +77,9 @@ typedef enum {
     IR_FUNC_END,
     IR_BR,
     IR_BCOND,
-    IR_LABEL
+    IR_LABEL,
+    IR_PHI,
+    IR_COPY
 } ir_op_t;
 
 struct ir_instr;
@@ -92,7 +94,7 @@ typedef struct ir_instr {
     int src1;
     int src2;
     long long imm;
-    char *name;
+    const char *name; /* interned; compare with == */
     char *data;
     int is_volatile;
     int is_restrict;
@@ -104,6 +106,27 @@ typedef struct ir_instr {
     size_t column;
 } ir_instr_t;
 
+/* Flags kept in `src1` of IR_FUNC_BEGIN */
+#define IR_FUNC_PROMOTED 0x1 /* locals were turned into values by opt_mem2reg() */
+#define IR_FUNC_INLINE   0x2 /* declared `inline` */
+#define IR_FUNC_STATIC   0x4 /* internal linkage */
+#define IR_FUNC_NORETURN 0x8 /* declared `_Noreturn` or `noreturn` */
+#define IR_FUNC_PARAM_ADDR 0x10 /* IR_ADDR names one of the parameters */
+
+/*
+ * Incoming value of an IR_PHI.  `pred` names the edge it arrives on: the
+ * IR_BR or IR_BCOND of the predecessor jumping to the phi's block, or
+ * NULL for the edge falling through from the preceding block (the
+ * function entry for the first block).  A phi keeps its arguments in
+ * `data` and their number in `imm`.  Phis only exist between SSA
+ * construction and opt_out_of_ssa(), which replaces them with IR_COPY
+ * instructions on the incoming edges.
+ */
+typedef struct {
+    int value;
+    ir_instr_t *pred;
+} ir_phi_arg_t;
+
 
 typedef struct alias_ent {
     const char *name;
@@ -111,6 +134,26 @@ typedef struct alias_ent {
     struct alias_ent *next;
 } alias_ent_t;
 
+/*
+ * Chunked arena holding the instructions of one builder together with
+ * their data payloads.  Everything is released at once by
+ * ir_builder_free(); instructions removed earlier are kept on a free
+ * list and reused by later allocations.
+ */
+typedef struct ir_arena_chunk {
+    struct ir_arena_chunk *next; /* previously filled chunk */
+    size_t used;                 /* bytes handed out from the chunk */
+    size_t size;                 /* usable bytes after the header */
+} ir_arena_chunk_t;
+
+typedef struct {
+    ir_arena_chunk_t *chunks;  /* most recent chunk first */
+    size_t next_size;          /* size of the next regular chunk */
+    ir_instr_t *free_instrs;   /* removed instructions, linked by next */
+} ir_arena_t;
+
+struct ir_defuse;
+
 typedef struct {
     ir_instr_t *head;
     ir_instr_t *tail;
@@ -120,6 +163,8 @@ typedef struct {
     size_t cur_column;
     alias_ent_t *aliases;
     int next_alias_id;
+    ir_arena_t arena;
+    struct ir_defuse *defuse; /* optional index kept current, see ir_defuse.h */
 } ir_builder_t;
 
 /*
@@ -137,6 +182,49 @@ void ir_builder_free(ir_builder_t *b);
 /* Allocate and insert a blank instruction after `pos`. */
 ir_instr_t *ir_insert_after(ir_builder_t *b, ir_instr_t *pos);
 
+/*
+ * Insert an IR_PHI defining a new value after `pos` with room for
+ * `count` arguments.  Arguments are appended with ir_phi_add_arg().
+ */
+ir_instr_t *ir_insert_phi(ir_builder_t *b, ir_instr_t *pos,
+                          type_kind_t type, size_t count);
+
+/* Append an argument to PHI; the caller ensures there is room */
+void ir_phi_add_arg(ir_instr_t *phi, int value, ir_instr_t *pred);
+
+/* Return the argument array of an IR_PHI */
+ir_phi_arg_t *ir_phi_args(const ir_instr_t *phi);
+
+/* Insert `dest = src` as an IR_COPY after `pos` */
+ir_instr_t *ir_insert_copy(ir_builder_t *b, ir_instr_t *pos, int dest,
+                           int src, type_kind_t type);
+
+/*
+ * Return non-zero when `src1` and `src2` of INS name values.  Global
+ * declarations store their linkage and alignment there instead and
+ * IR_FUNC_BEGIN its flags.
+ */
+int ir_has_value_operands(const ir_instr_t *ins);
+
+/*
+ * Allocate SIZE bytes from the builder's arena.  The memory is suitably
+ * aligned for any scalar, lives until ir_builder_free() and must not be
+ * passed to free().  Returns NULL when a new chunk cannot be allocated.
+ */
+void *ir_arena_alloc(ir_builder_t *b, size_t size);
+
+/* Copy the NUL terminated string STR into the builder's arena */
+char *ir_arena_strdup(ir_builder_t *b, const char *str);
+
+/* Allocate a zeroed instruction that is not yet linked into the list */
+ir_instr_t *ir_alloc_instr(ir_builder_t *b);
+
+/* Return an instruction already unlinked from the list for reuse */
+void ir_release_instr(ir_builder_t *b, ir_instr_t *ins);
+
+/* Free every chunk of ARENA at once */
+void ir_arena_release(ir_arena_t *arena);
+
 
 /* Emit the binary operation `op` with operands `left` and `right`. */
 ir_value_t ir_build_binop(ir_builder_t *b, ir_op_t op, ir_value_t left,
@@ -0,0 +1,86 @@
+/*
+ * Def-use index over the IR values of one builder.
+ *
+ * The index maps every value id to the instruction defining it and to a
+ * list of the instructions reading it, one entry per operand.  Once
+ * attached with ir_defuse_init() it is kept current by the builder: the
+ * ir_build_* helpers and ir_insert_after() register new instructions and
+ * ir_release_instr() withdraws removed ones.  Passes rewriting operands
+ * of indexed instructions go through ir_defuse_set_src() or
+ * ir_replace_all_uses() so the lists stay exact.
+ *
+ * Arguments added to a phi with ir_phi_add_arg() after the next
+ * instruction was created are not seen by the index.  When the index
+ * cannot grow while the builder emits code `valid` is cleared and the
+ * lists must no longer be trusted.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#ifndef VC_IR_DEFUSE_H
+#define VC_IR_DEFUSE_H
+
+#include <stddef.h>
+#include "ir_core.h"
+
+typedef struct {
+    ir_instr_t *ins;   /* instruction reading the value */
+    int next;          /* next use of the same value or -1 */
+} ir_use_t;
+
+typedef struct ir_defuse {
+    ir_builder_t *ir;      /* builder the index is attached to */
+    ir_instr_t **def;      /* value id -> defining instruction or NULL */
+    int *head;             /* value id -> first entry in uses or -1 */
+    size_t *count;         /* value id -> number of uses */
+    size_t value_cap;
+    ir_use_t *uses;        /* use entries linked per value */
+    size_t use_len;
+    size_t use_cap;
+    int free_use;          /* released entries linked by next */
+    ir_instr_t *pending;   /* created but operands not yet indexed */
+    int valid;             /* cleared when growing the index failed */
+} ir_defuse_t;
+
+/*
+ * Index every instruction of IR and attach DU to it.  Returns 0 when
+ * memory could not be allocated, leaving DU empty and detached.
+ */
+int ir_defuse_init(ir_defuse_t *du, ir_builder_t *ir);
+
+/* Detach DU from its builder and release the index */
+void ir_defuse_free(ir_defuse_t *du);
+
+/* Return the instruction defining VALUE or NULL */
+ir_instr_t *ir_defuse_def(ir_defuse_t *du, int value);
+
+/*
+ * Return the first use entry of VALUE or -1.  The remaining uses follow
+ * through `du->uses[u].next`.
+ */
+int ir_defuse_first_use(ir_defuse_t *du, int value);
+
+/* Return the number of operands reading VALUE */
+size_t ir_defuse_use_count(ir_defuse_t *du, int value);
+
+/*
+ * Set operand WHICH (1 or 2) of INS to VALUE and move the use entry.
+ * Returns 0 on allocation failure.
+ */
+int ir_defuse_set_src(ir_defuse_t *du, ir_instr_t *ins, int which, int value);
+
+/*
+ * Make every use of OLD read NEW instead, including phi arguments, in
+ * time proportional to the number of uses.  Returns 0 on allocation
+ * failure without changing anything.
+ */
+int ir_replace_all_uses(ir_defuse_t *du, int old, int new_value);
+
+/* Register INS with the index; called by the builder on creation */
+void ir_defuse_note(ir_defuse_t *du, ir_instr_t *ins);
+
+/* Withdraw INS from the index; called by the builder on release */
+void ir_defuse_forget(ir_defuse_t *du, ir_instr_t *ins);
+
+#endif /* VC_IR_DEFUSE_H */
@@ -5,9 +5,28 @@
 #include "token.h"
 #include "vector.h"
 
+/*
+ * Character classes of the scanners.  lexer_char_class maps every byte to
+ * a set of these flags so the hot loops test one table entry instead of
+ * calling the locale aware <ctype.h> functions.  Only ASCII characters
+ * belong to any class, matching the "C" locale.
+ */
+#define LEX_SPACE  0x01 /* ' ', '\t', '\n', '\v', '\f', '\r' */
+#define LEX_DIGIT  0x02 /* '0'-'9' */
+#define LEX_XDIGIT 0x04 /* '0'-'9', 'a'-'f', 'A'-'F' */
+#define LEX_ALPHA  0x08 /* letters and '_' */
+
+extern const unsigned char lexer_char_class[256];
+
+/* Test whether C belongs to any class in the mask CLS */
+#define LEX_IS(c, cls) (lexer_char_class[(unsigned char)(c)] & (cls))
+
 int append_token(vector_t *vec, token_type_t type, const char *lexeme,
                  size_t len, size_t line, size_t column);
 
+/* Return the keyword token for the LEN bytes at STR or TOK_IDENT */
+token_type_t lookup_keyword(const char *str, size_t len);
+
 int scan_identifier(const char *src, size_t *i, size_t *col,
                     vector_t *tokens, size_t line);
 
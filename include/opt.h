@@ -9,13 +9,16 @@
 #define VC_OPT_H
 
 #include "ir_core.h"
+#include "ir_cfg.h"
 
 typedef struct {
     int opt_level;     /* numeric optimization level */
     int fold_constants; /* enable constant folding */
     int dead_code;      /* enable dead code elimination */
-    int const_prop;     /* enable store/load constant propagation */
+    int const_prop;     /* enable sparse conditional constant propagation */
     int inline_funcs;   /* inline small functions */
+    int mem2reg;        /* promote scalar locals to SSA values */
+    int x86_64;         /* calls pass arguments in x86-64 order */
 } opt_config_t;
 
 /* Print an optimization error message */
@@ -29,17 +32,65 @@ void compute_alias_sets(ir_builder_t *ir);
  *
  * Passes execute in the following order:
  * 1. Alias analysis
- * 2. Constant propagation
- * 3. Common subexpression elimination
- * 4. Inline expansion
+ * 2. Common subexpression elimination by value numbering
+ * 3. Inline expansion in bottom-up call graph order
+ * 4. Sparse conditional constant propagation
  * 5. Constant folding
- * 6. Loop-invariant code motion
- * 7. Unreachable block elimination
- * 8. Dead code elimination
+ * 6. Unreachable block elimination
+ * 7. SSA construction (mem2reg)
+ * 8. Loop-invariant code motion and strength reduction
+ * 9. Redundant load and dead store elimination
+ * 10. Dead code elimination
+ * 11. SSA destruction, lowering phis to copies
  */
 void opt_run(ir_builder_t *ir, const opt_config_t *cfg);
 
-/* Hoist loop invariant computations */
-void opt_licm(ir_builder_t *ir);
+/* Reuse pure expressions already computed in a dominating block */
+void opt_value_number(ir_builder_t *ir, ir_cfg_t *cfg);
+
+/*
+ * Propagate constants through values and scalar variables along the
+ * executable paths of every function, fold branches on known conditions
+ * and remove the blocks they make unreachable.
+ */
+void opt_sccp(ir_builder_t *ir, ir_cfg_t *cfg, const opt_config_t *opts);
+
+/*
+ * Give every natural loop a preheader, hoist invariant computations and
+ * loads into it and, in SSA form, strength reduce expressions scaled by
+ * an induction variable.
+ */
+void opt_licm(ir_builder_t *ir, ir_cfg_t *cfg, const opt_config_t *opts);
+
+/*
+ * Within each block reuse loads of memory unchanged since an earlier
+ * load and remove stores overwritten before they are read.
+ */
+void opt_memory(ir_builder_t *ir, ir_cfg_t *cfg);
+
+/* Promote locals whose address is never taken to SSA values */
+void opt_mem2reg(ir_builder_t *ir, ir_cfg_t *cfg);
+
+/* Replace IR_PHI instructions by copies on the incoming edges */
+void opt_out_of_ssa(ir_builder_t *ir, ir_cfg_t *cfg);
+
+/*
+ * Integer evaluation shared by the constant passes.  Types are sized for
+ * the target selected by X86_64; non-integer types have width 0.
+ */
+int opt_int_width(type_kind_t type, int x86_64);
+
+/* Truncate VALUE to TYPE, sign or zero extending the result */
+long long opt_int_normalize(type_kind_t type, long long value, int x86_64);
+
+/*
+ * Evaluate the integer operation OP on operands of TYPE.  Returns 0 when
+ * the result is not defined at compile time, e.g. on division by zero.
+ */
+int opt_eval_int(ir_op_t op, type_kind_t type, long long a, long long b,
+                 int x86_64, long long *out);
+
+/* Evaluate an IR_CAST with immediate IMM between integer types */
+int opt_eval_cast(long long imm, long long value, int x86_64, long long *out);
 
 #endif /* VC_OPT_H */
@@ -10,26 +10,39 @@
 
 #include "ir_core.h"
 
-/* Representation of a candidate inline function */
+/* Parameters beyond this index keep a function out of the inliner */
+#define INLINE_MAX_PARAMS 16
+
+/* A function definition seen by the inliner */
 typedef struct {
     const char *name;    /* function name */
-    ir_instr_t *body;    /* cloned body instructions */
-    size_t count;        /* number of instructions in body */
-    int param_count;     /* number of parameters */
+    ir_instr_t *begin;   /* IR_FUNC_BEGIN of the definition */
+    ir_instr_t *end;     /* matching IR_FUNC_END */
+    size_t size;         /* instructions in the body, labels excluded */
+    int inlinable;       /* body may be copied into a caller */
+    int param_count;     /* highest parameter index used plus one */
+    unsigned written;    /* bit N set when parameter N is assigned */
+    int param_loads[INLINE_MAX_PARAMS];       /* IR_LOAD_PARAM per index */
+    type_kind_t param_type[INLINE_MAX_PARAMS];
+    int returns;         /* number of IR_RETURN instructions */
+    int void_return;     /* some IR_RETURN carries no value */
+    int tail_return;     /* a single IR_RETURN ends the body */
+    type_kind_t ret_type; /* type of the returned values */
+    int min_value;       /* range of value ids defined in the body */
+    int max_value;
 } inline_func_t;
 
 /*
- * Clone a small function body for inlining.
- * `begin` must point to an IR_FUNC_BEGIN instruction.
- * On success, returns 1 and stores a newly allocated instruction array in
- * `*out` and the number of entries in `*count`.
+ * Measure the body of FN->begin .. FN->end and decide whether it can be
+ * copied into a caller.  Bodies allocating stack dynamically, returning
+ * aggregates or defining globals are rejected.
  */
-int clone_inline_body(ir_instr_t *begin, ir_instr_t **out, size_t *count);
+void inline_analyze(inline_func_t *fn);
 
 /*
- * Collect inline function candidates from the builder.
- * On success, returns 1 and stores an array of inline_func_t in `*out` with
- * `*count` entries.
+ * Collect every function definition of the builder in IR order.
+ * On success, returns 1 and stores an array of analyzed inline_func_t in
+ * `*out` with `*count` entries.
  */
 int collect_funcs(ir_builder_t *ir, inline_func_t **out, size_t *count);
 
@@ -17,7 +17,7 @@ int parse_basic_type(parser_t *p, type_kind_t *out);
 size_t basic_type_size(type_kind_t t);
 
 /* Try to parse a function pointer declaration suffix. */
-int parse_func_ptr_suffix(parser_t *p, char **name,
+int parse_func_ptr_suffix(parser_t *p, const char **name,
                           type_kind_t **param_types, size_t *param_count,
                           int *is_variadic);
 /* Parse an alignas specifier and return the expression. */
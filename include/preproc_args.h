@@ -6,14 +6,29 @@
 #define VC_PREPROC_ARGS_H
 
 #include "vector.h"
+#include "preproc_tokens.h"
 
-int parse_macro_args(const char *line, size_t *pos, vector_t *out);
-int gather_varargs(vector_t *args, size_t fixed,
-                   char ***out_ap, char **out_va);
-int parse_macro_arg_vector(const char *line, size_t *pos, vector_t *out,
-                           size_t param_count, int variadic);
-int handle_varargs(vector_t *args, size_t fixed, int variadic,
-                   char ***out_ap, char **out_va);
-void free_arg_vector(vector_t *v);
+/*
+ * One argument of a macro invocation.  TOKS points into the tokens of the
+ * call; EXPANDED is filled on demand with the fully expanded argument.
+ */
+typedef struct {
+    const pp_token_t *toks; /* tokens of the argument as written */
+    size_t count;           /* number of tokens at toks */
+    vector_t expanded;      /* pp_token_t list valid when have_expanded */
+    int have_expanded;      /* non-zero once expanded is filled */
+} macro_arg_t;
+
+/*
+ * Split the COUNT tokens between the parentheses of a macro call into
+ * macro_arg_t entries appended to OUT.  With VARIADIC set everything after
+ * the first PARAM_COUNT arguments becomes the __VA_ARGS__ argument.
+ * Returns 1 on success or 0 when the number of arguments does not match.
+ */
+int split_macro_args(const pp_token_t *toks, size_t count,
+                     size_t param_count, int variadic, vector_t *out);
+
+/* Release the argument vector filled by split_macro_args() */
+void free_macro_args(vector_t *args);
 
 #endif /* VC_PREPROC_ARGS_H */
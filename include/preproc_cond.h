@@ -20,28 +20,28 @@ typedef struct {
 } cond_state_t;
 
 /* Push a new state for #ifdef/#ifndef directives */
-int cond_push_ifdef_common(char *line, vector_t *macros,
+int cond_push_ifdef_common(char *line, macro_table_t *macros,
                            vector_t *conds, int neg,
                            preproc_context_t *ctx);
-int cond_push_ifdef(char *line, vector_t *macros, vector_t *conds,
+int cond_push_ifdef(char *line, macro_table_t *macros, vector_t *conds,
                     preproc_context_t *ctx);
-int cond_push_ifndef(char *line, vector_t *macros, vector_t *conds,
+int cond_push_ifndef(char *line, macro_table_t *macros, vector_t *conds,
                      preproc_context_t *ctx);
 
 /* Push a new state for a generic #if expression */
-int cond_push_ifexpr(char *line, const char *dir, vector_t *macros,
+int cond_push_ifexpr(char *line, const char *dir, macro_table_t *macros,
                      vector_t *conds, const vector_t *incdirs, vector_t *stack,
                      preproc_context_t *ctx);
 
 /* Handle conditional branches */
-void cond_handle_elif(char *line, const char *dir, vector_t *macros,
+void cond_handle_elif(char *line, const char *dir, macro_table_t *macros,
                       vector_t *conds, const vector_t *incdirs,
                       vector_t *stack, preproc_context_t *ctx);
 void cond_handle_else(vector_t *conds);
 void cond_handle_endif(vector_t *conds);
 
 /* Dispatch a conditional directive */
-int handle_conditional(char *line, const char *dir, vector_t *macros,
+int handle_conditional(char *line, const char *dir, macro_table_t *macros,
                        vector_t *conds, const vector_t *incdirs,
                        vector_t *stack, preproc_context_t *ctx);
 
@@ -16,7 +16,7 @@
 #include "preproc_macros.h"
 
 /* Evaluate an expression with include lookup support */
-long long eval_expr_full(const char *s, vector_t *macros,
+long long eval_expr_full(const char *s, macro_table_t *macros,
                          const char *dir, const vector_t *incdirs,
                          vector_t *stack);
 
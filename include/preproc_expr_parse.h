@@ -7,7 +7,7 @@
 /* Parser context used for expression evaluation */
 typedef struct {
     const char *s;
-    vector_t *macros;
+    macro_table_t *macros;
     const char *dir;
     const vector_t *incdirs;
     vector_t *stack;
@@ -4,8 +4,8 @@
  * The preprocessor reads a source file, handles directives such as
  * `#include`, `#define`, `#ifdef` and friends and returns the expanded
  * text.  Included files are processed recursively using the caller
- * provided search paths.  Macro definitions are collected into a simple
- * vector and expanded on demand.
+ * provided search paths.  Macro definitions are collected into a hash
+ * table and expanded on demand.
  *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
@@ -16,21 +16,34 @@
 
 #include "vector.h"
 #include "strbuf.h"
+#include "preproc_table.h"
+#include "token.h"
 #include <stdint.h>
 #include <stdbool.h>
 
 /* Context used by the preprocessor.
  *
  * `pragma_once_files` stores headers that emitted `#pragma once` so
- * subsequent includes are ignored. `deps` records every file processed
- * including the initial source and all headers. The caller is
- * responsible for freeing both vectors via `preproc_context_free()`.
+ * subsequent includes are ignored. `include_guards` maps headers wrapped
+ * in a classic `#ifndef` guard to their controlling macro so they can be
+ * skipped without being read again while that macro stays defined.
+ * `deps` records every file processed including the initial source and
+ * all headers. The caller is responsible for freeing `deps` via
+ * `preproc_context_free()`.
  */
 /* default include depth limit */
 #define DEFAULT_INCLUDE_DEPTH 20
 
+/* Header protected by an include guard */
+typedef struct {
+    char *path;  /* malloc'd canonical file path */
+    char *macro; /* malloc'd controlling macro name */
+} include_guard_t;
+
 typedef struct {
     vector_t pragma_once_files; /* vector of malloc'd char* paths */
+    vector_t include_guards;    /* vector of include_guard_t */
+    size_t guard_skips;         /* includes skipped via include guards */
     vector_t deps;              /* vector of malloc'd char* paths */
     vector_t pack_stack;        /* vector of size_t pack values */
     size_t pack_alignment;      /* current #pragma pack value */
@@ -47,6 +60,9 @@ typedef struct {
     size_t max_include_depth;   /* maximum nested includes allowed */
     size_t max_expand_size;     /* maximum size of macro expansion */
     int system_header;          /* suppress warnings for current file */
+    lexer_stream_t *tokens;     /* lexes output line by line when set */
+    char **lines;               /* lines of the file being processed */
+    size_t line_index;          /* index of the current line in lines */
 } preproc_context_t;
 
 /* Free the dependency lists stored in the context */
@@ -62,12 +78,26 @@ char *preproc_run(preproc_context_t *ctx, const char *path,
                   const char *vc_sysinclude, bool internal_libc,
                   bool use_x86_64);
 
+/*
+ * Preprocess the file at the given path and return its tokens directly.
+ *
+ * Each expanded line is handed to the lexer as soon as it is produced so
+ * the complete preprocessed text is never materialized.  The returned
+ * array must be freed with lexer_free_tokens().  Returns NULL on failure.
+ */
+token_t *preproc_run_tokens(preproc_context_t *ctx, const char *path,
+                            const vector_t *include_dirs,
+                            const vector_t *defines,
+                            const vector_t *undefines, const char *sysroot,
+                            const char *vc_sysinclude, bool internal_libc,
+                            bool use_x86_64, size_t *out_count);
+
 /* Internal helpers shared across preprocessing modules */
-int process_line(char *line, const char *dir, vector_t *macros,
+int process_line(char *line, const char *dir, macro_table_t *macros,
                  vector_t *conds, strbuf_t *out,
                  const vector_t *incdirs, vector_t *stack,
                  preproc_context_t *ctx);
-int process_file(const char *path, vector_t *macros, vector_t *conds,
+int process_file(const char *path, macro_table_t *macros, vector_t *conds,
                  strbuf_t *out, const vector_t *incdirs, vector_t *stack,
                  preproc_context_t *ctx, size_t idx);
 
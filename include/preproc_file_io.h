@@ -32,7 +32,7 @@ int open_source_file(const char *path, vector_t *stack, size_t idx,
                      preproc_context_t *ctx);
 
 int process_all_lines(char **lines, const char *path, const char *dir,
-                      vector_t *macros, vector_t *conds, strbuf_t *out,
+                      macro_table_t *macros, vector_t *conds, strbuf_t *out,
                       const vector_t *incdirs, vector_t *stack,
                       preproc_context_t *ctx);
 void preproc_apply_line_directive(preproc_context_t *ctx,
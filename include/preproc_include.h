@@ -14,15 +14,21 @@
 #include "preproc_path.h"
 
 /* Process a standard #include directive */
-int handle_include(char *line, const char *dir, vector_t *macros,
+int handle_include(char *line, const char *dir, macro_table_t *macros,
                    vector_t *conds, strbuf_t *out,
                    const vector_t *incdirs, vector_t *stack,
                    preproc_context_t *ctx);
 
 /* Process an #include_next directive */
-int handle_include_next(char *line, const char *dir, vector_t *macros,
+int handle_include_next(char *line, const char *dir, macro_table_t *macros,
                         vector_t *conds, strbuf_t *out,
                         const vector_t *incdirs, vector_t *stack,
                         preproc_context_t *ctx);
 
+/*
+ * Return the malloc'd name of the macro guarding LINES when the file is
+ * wrapped in an #ifndef include guard, or NULL otherwise.
+ */
+char *detect_include_guard(char **lines);
+
 #endif /* VC_PREPROC_INCLUDE_H */
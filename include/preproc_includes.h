@@ -9,17 +9,17 @@
 #include "strbuf.h"
 #include "preproc_file.h"
 
-int handle_include_directive(char *line, const char *dir, vector_t *macros,
+int handle_include_directive(char *line, const char *dir, macro_table_t *macros,
                              vector_t *conds, strbuf_t *out,
                              const vector_t *incdirs, vector_t *stack,
                              preproc_context_t *ctx);
 
-int handle_line_directive(char *line, const char *dir, vector_t *macros,
+int handle_line_directive(char *line, const char *dir, macro_table_t *macros,
                           vector_t *conds, strbuf_t *out,
                           const vector_t *incdirs, vector_t *stack,
                           preproc_context_t *ctx);
 
-int handle_pragma_directive(char *line, const char *dir, vector_t *macros,
+int handle_pragma_directive(char *line, const char *dir, macro_table_t *macros,
                             vector_t *conds, strbuf_t *out,
                             const vector_t *incdirs, vector_t *stack,
                             preproc_context_t *ctx);
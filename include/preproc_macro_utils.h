@@ -1,5 +1,5 @@
 /*
- * Macro parsing and stringizing helpers.
+ * Macro parameter and stringizing helpers.
  *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
@@ -9,13 +9,16 @@
 #define VC_PREPROC_MACRO_UTILS_H
 
 #include "vector.h"
-#include "strbuf.h"
+#include "preproc_tokens.h"
 
-size_t parse_ident(const char *s);
-const char *lookup_param(const char *name, size_t len,
-                         const vector_t *params, char **args);
-size_t append_stringized_param(const char *value, size_t i,
-                               const vector_t *params, char **args,
-                               int variadic, strbuf_t *sb);
+/*
+ * Return the number of the parameter named by TOK or -1.  __VA_ARGS__ of a
+ * VARIADIC macro is the parameter following the named ones.
+ */
+int lookup_param(const pp_token_t *tok, const vector_t *params,
+                 int variadic);
+
+/* Store the string literal spelling the COUNT tokens at TOKS in OUT */
+int stringize_tokens(const pp_token_t *toks, size_t count, pp_token_t *out);
 
 #endif /* VC_PREPROC_MACRO_UTILS_H */
@@ -2,8 +2,9 @@
  * Macro handling for the preprocessor.
  *
  * Defines the `macro_t` structure and helper routines used to store,
- * expand and query macros.  Expansion occurs line by line and is
- * recursive so macro bodies may themselves contain macro invocations.
+ * expand and query macros.  Expansion works on the pp-tokens of one line
+ * and rescans each replacement together with the rest of the line, so
+ * macro bodies may themselves contain macro invocations.
  *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
@@ -15,6 +16,8 @@
 #include "vector.h"
 #include "strbuf.h"
 #include "preproc_file.h"
+#include "preproc_table.h"
+#include "preproc_tokens.h"
 
 /*
  * Stored macro definition.
@@ -24,13 +27,20 @@
  * allocations belongs to the macro instance and they are released by
  * macro_free().  add_macro() creates a fully self-contained macro_t by
  * duplicating the provided name and value strings and taking ownership of
- * the parameter names supplied in the vector.
+ * the parameter names supplied in the vector.  The name length and hash
+ * are cached for lookups through macro_table_t.  The body is split into
+ * pp-tokens the first time the macro is expanded.
  */
-typedef struct {
+typedef struct macro {
     char *name;       /* malloc'd name string */
+    size_t name_len;  /* strlen(name) */
+    unsigned hash;    /* hash of name used by the macro table */
     vector_t params;  /* vector of malloc'd char* parameter names */
     int variadic;     /* non-zero when macro accepts variable arguments */
+    int function_like; /* non-zero when defined with a parameter list */
     char *value;      /* malloc'd macro body */
+    vector_t body;    /* pp_token_t list of value once body_ready is set */
+    int body_ready;   /* non-zero when body holds the lexed value */
     int expanding;    /* recursion guard flag */
 } macro_t;
 
@@ -38,14 +48,32 @@ typedef struct {
 void macro_free(macro_t *m);
 
 /* Expand macros in one line */
-int expand_line(const char *line, vector_t *macros, strbuf_t *out,
+int expand_line(const char *line, macro_table_t *macros, strbuf_t *out,
                 size_t column, int depth, preproc_context_t *ctx);
 
+/*
+ * Expand the COUNT pp-tokens at TOKS and append the result to OUT, a
+ * vector of pp_token_t.  Returns 1 on success or 0 on a fatal error.
+ */
+int expand_token_list(const pp_token_t *toks, size_t count,
+                      macro_table_t *macros, vector_t *out, int depth,
+                      preproc_context_t *ctx);
+
+/*
+ * Like expand_token_list() but a function-like macro call still open when
+ * the tokens run out is left unexpanded.  Its name and the tokens read so
+ * far are appended to HELD so the caller can add the next line and expand
+ * them again.
+ */
+int expand_open_token_list(const pp_token_t *toks, size_t count,
+                           macro_table_t *macros, vector_t *out,
+                           vector_t *held, preproc_context_t *ctx);
+
 /* Check whether a macro exists */
-int is_macro_defined(vector_t *macros, const char *name);
+int is_macro_defined(macro_table_t *macros, const char *name);
 
-/* Remove all definitions of a macro */
-void remove_macro(vector_t *macros, const char *name);
+/* Remove the definition of a macro */
+void remove_macro(macro_table_t *macros, const char *name);
 
 /* Update builtin macro expansion context */
 void preproc_set_location(preproc_context_t *ctx, const char *file,
@@ -54,15 +82,15 @@ void preproc_set_location(preproc_context_t *ctx, const char *file,
 /* Set the current function name for __func__ expansion */
 void preproc_set_function(preproc_context_t *ctx, const char *name);
 
-/* Add a macro definition to the table */
+/* Add a macro definition to the table, replacing any previous one */
 int add_macro(const char *name, const char *value, vector_t *params,
-              int variadic, vector_t *macros);
+              int variadic, macro_table_t *macros);
 
 /* Handle a '#define' directive when processing a line */
-int handle_define(char *line, vector_t *macros, vector_t *conds);
+int handle_define(char *line, macro_table_t *macros, vector_t *conds);
 
 /* Wrapper used by process_line for '#define' */
-int handle_define_directive(char *line, const char *dir, vector_t *macros,
+int handle_define_directive(char *line, const char *dir, macro_table_t *macros,
                             vector_t *conds, strbuf_t *out,
                             const vector_t *incdirs, vector_t *stack,
                             preproc_context_t *ctx);
@@ -9,9 +9,21 @@
 #define VC_PREPROC_PASTE_H
 
 #include "vector.h"
-#include "strbuf.h"
+#include "preproc_macros.h"
+#include "preproc_args.h"
 
-char *expand_params(const char *value, const vector_t *params,
-                    char **args, int variadic);
+/*
+ * Lex the body of M into pp-tokens, numbering parameter references and
+ * flagging the operands of # and ## with PP_RAW_ARG.  Does nothing once
+ * the body is ready.  Returns 1 on success.
+ */
+int prepare_macro_body(macro_t *m);
+
+/*
+ * Append the body of M with its parameters replaced to OUT.  Operands of
+ * # and ## use the arguments as written, every other parameter uses the
+ * expanded argument, which the caller must have filled in.
+ */
+int expand_params(const macro_t *m, macro_arg_t *args, vector_t *out);
 
 #endif /* VC_PREPROC_PASTE_H */
@@ -12,6 +12,13 @@
 int record_dependency(preproc_context_t *ctx, const char *path);
 int pragma_once_contains(preproc_context_t *ctx, const char *path);
 int pragma_once_add(preproc_context_t *ctx, const char *path);
+
+/* Multiple-include optimization for headers with an #ifndef guard */
+int include_guard_add(preproc_context_t *ctx, const char *path,
+                      const char *macro);
+int include_guard_skip(preproc_context_t *ctx, const char *path,
+                       macro_table_t *macros);
+void include_guard_free(preproc_context_t *ctx);
 char *find_include_path(const char *fname, char endc, const char *dir,
                         const vector_t *incdirs, size_t start, size_t *out_idx);
 int append_env_paths(const char *env, vector_t *search_dirs);
@@ -27,6 +34,13 @@ void print_include_search_dirs(FILE *fp, char endc, const char *dir,
 
 /* Toggle verbose include search output */
 void preproc_set_verbose_includes(bool flag);
+
+/* Search include directories through cached listings, optionally
+ * printing index statistics after each run */
+void preproc_set_include_index(bool enable, bool stats);
+
+/* Print include statistics when verbose include output is enabled */
+void preproc_report_include_stats(const preproc_context_t *ctx);
 void preproc_set_internal_libc_dir(const char *path);
 
 /* Release cached include path resources */
@@ -0,0 +1,44 @@
+/*
+ * Hash table of preprocessor macro definitions.
+ *
+ * Macros are stored in an open-addressing table keyed by name so that
+ * lookups performed for every identifier, as well as `#define` and
+ * `#undef`, run in constant time regardless of how many macros the
+ * included headers define.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#ifndef VC_PREPROC_TABLE_H
+#define VC_PREPROC_TABLE_H
+
+#include <stddef.h>
+
+struct macro;
+
+/*
+ * Open-addressing macro table.
+ *
+ * Each non-empty slot points to a heap allocated macro owned by the
+ * table.  Removed entries leave a tombstone so probe sequences stay
+ * intact until the next rehash.
+ */
+typedef struct {
+    struct macro **slots; /* slot array, capacity is a power of two */
+    size_t cap;           /* number of slots */
+    size_t count;         /* live macros */
+    size_t used;          /* live macros plus tombstones */
+} macro_table_t;
+
+/* Initialize an empty macro table */
+void macro_table_init(macro_table_t *t);
+
+/* Release every macro in the table and the slot array */
+void macro_table_free(macro_table_t *t);
+
+/* Return the macro named by the LEN bytes at NAME or NULL */
+struct macro *macro_table_lookup(const macro_table_t *t, const char *name,
+                                 size_t len);
+
+#endif /* VC_PREPROC_TABLE_H */
@@ -0,0 +1,74 @@
+/*
+ * Preprocessing tokens.
+ *
+ * Text lines and macro bodies are split into pp-tokens once.  Macro
+ * expansion, stringizing and token pasting work on these token lists and
+ * the expanded tokens are either printed for -E or handed one by one to
+ * the C lexer stream, so the preprocessor output is never scanned again.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#ifndef VC_PREPROC_TOKENS_H
+#define VC_PREPROC_TOKENS_H
+
+#include <stddef.h>
+#include "vector.h"
+#include "strbuf.h"
+#include "token.h"
+
+struct macro;
+
+typedef enum {
+    PP_IDENT,
+    PP_NUMBER,      /* preprocessing number */
+    PP_CHAR,        /* character constant, including any prefix */
+    PP_STRING,      /* string literal, including any prefix */
+    PP_PUNCT,
+    PP_OTHER,       /* any other single character */
+    PP_RAW,         /* text copied to the output as is, e.g. _Pragma */
+    PP_PLACEMARKER, /* empty macro argument while pasting */
+    PP_END          /* end of a macro expansion being rescanned */
+} pp_kind_t;
+
+#define PP_NO_EXPAND 0x1 /* macro name met inside its own expansion */
+#define PP_RAW_ARG   0x2 /* parameter used as an operand of # or ## */
+
+/*
+ * One preprocessing token.
+ *
+ * The spelling is interned and NUL terminated.  The whitespace in front
+ * of the token points into the line or macro body it was read from and
+ * is only valid while that text is; tokens built by the preprocessor
+ * itself carry either no whitespace or the whitespace of a token they
+ * replace.
+ */
+typedef struct {
+    const char *text;     /* interned spelling */
+    const char *ws;       /* whitespace in front, not NUL terminated */
+    unsigned len;         /* length of text */
+    unsigned ws_len;      /* length of ws */
+    unsigned char kind;   /* pp_kind_t */
+    unsigned char flags;  /* PP_NO_EXPAND, PP_RAW_ARG */
+    short param;          /* parameter number in a macro body or -1 */
+    struct macro *macro;  /* macro re-enabled at a PP_END marker */
+} pp_token_t;
+
+/* Split TEXT into pp-tokens appended to OUT.  Returns 1 on success */
+int pp_lex(const char *text, vector_t *out);
+
+/* Return non-zero when TOK is the punctuator P */
+int pp_is_punct(const pp_token_t *tok, const char *p);
+
+/* Append the spelling of COUNT tokens with their whitespace to OUT */
+int pp_print_tokens(strbuf_t *out, const pp_token_t *toks, size_t count);
+
+/*
+ * Append COUNT tokens forming one output line to the lexer stream LS,
+ * at the line and columns pp_print_tokens() would place them, and move
+ * the stream to the next line.  Returns 1 on success or 0 on error.
+ */
+int pp_emit_line(lexer_stream_t *ls, const pp_token_t *toks, size_t count);
+
+#endif /* VC_PREPROC_TOKENS_H */
@@ -2,11 +2,13 @@
  * Register allocation interface.
  *
  * The allocator assigns each SSA value produced by the IR to either a
- * physical register or a stack slot.  Allocation is performed using a
- * simple linear scan: values are given registers from a small fixed pool
- * and spilled to the stack when no registers remain.  Registers are
- * recycled immediately after the last use of a value, allowing them to
- * be reused later in the instruction stream.
+ * physical register or a stack slot.  Allocation is performed per
+ * function using a linear scan over live intervals: values are given
+ * registers from the pool described by regalloc_target() and the value
+ * with the lowest spill weight goes to the stack when no suitable
+ * register remains.  A register is free again once the interval holding
+ * it ends or reaches a hole, and spill slots are shared by values whose
+ * lifetimes do not overlap.
  *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
@@ -15,17 +17,15 @@
 #ifndef VC_REGALLOC_H
 #define VC_REGALLOC_H
 
+#include <stdio.h>
 #include "ir_core.h"
 
 /*
- * Indices of scratch registers kept out of the general allocation pool.
- *
- * REGALLOC_SCRATCH_REG is always available for temporary values. Some
- * store operations may require a second temporary register which is
- * provided by REGALLOC_SCRATCH_REG2.
+ * Index of the scratch register used for temporary values.  Some store
+ * operations need a second one, named by the `scratch2` field of
+ * regalloc_target().
  */
 #define REGALLOC_SCRATCH_REG  0
-#define REGALLOC_SCRATCH_REG2 1
 
 /*
  * Location mapping for IR values returned by the allocator.
@@ -40,13 +40,20 @@ typedef struct {
     int stack_slots;/* number of stack slots used */
 } regalloc_t;
 
+/* Algorithm used by regalloc_run */
+typedef enum {
+    REGALLOC_LINEAR,    /* linear scan over the live intervals */
+    REGALLOC_COLOR      /* graph coloring with iterated coalescing */
+} regalloc_mode_t;
+
 /*
- * Assign locations to IR values using a linear scan algorithm.
+ * Assign locations to IR values using a linear scan algorithm or, when
+ * REGALLOC_COLOR is selected, by coloring the interference graph.
  *
  * Registers are allocated from a fixed pool. When none are
- * available the value is placed in a new stack slot. A register
- * becomes free again once the allocator reaches the last
- * instruction that references the value stored in it.
+ * available the cheapest competing value is placed in a stack
+ * slot. A register becomes free again once the allocator passes
+ * the last instruction at which the value stored in it is live.
  */
 /*
  * Run the allocator on the given builder and populate `ra` with the
@@ -64,5 +71,13 @@ void regalloc_run(ir_builder_t *ir, regalloc_t *ra);
 /* Release all memory held inside `ra`. */
 void regalloc_free(regalloc_t *ra);
 
+/*
+ * Print the live intervals, locations and spill decisions of every
+ * following `regalloc_run` to OUT.  Passing NULL turns the output off.
+ */
+void regalloc_set_dump(FILE *out);
+
+/* Select the algorithm of following `regalloc_run` calls */
+void regalloc_set_mode(regalloc_mode_t mode);
 
 #endif /* VC_REGALLOC_H */
@@ -3,9 +3,10 @@
  *
  * The register allocator itself only deals with small integer indices.
  * This header provides helpers that map those indices to textual
- * register names understood by the assembler.  Two tables are kept for
- * 32- and 64-bit code generation and `regalloc_set_x86_64` selects the
- * active one.
+ * register names understood by the assembler, together with the
+ * register classes and calling convention of each mode.  Two tables are
+ * kept for 32- and 64-bit code generation and `regalloc_set_x86_64`
+ * selects the active one.
  *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
@@ -17,16 +18,43 @@
 #include "cli.h"
 
 /*
- * Number of allocatable general purpose registers.
+ * Number of general purpose register indices.
  *
- * Register indices returned by the allocator range from
- * 0 to REGALLOC_NUM_REGS-1.
+ * Indices 0-5 name %eax, %ebx, %ecx, %edx, %esi and %edi in both modes
+ * and 6-13 name %r8-%r15, which only exist in 64-bit mode.  The
+ * allocator hands out indices below the `count` of the active target.
  */
-#define REGALLOC_NUM_REGS 6  /* size of the register pool used by regalloc */
+#define REGALLOC_NUM_REGS 14
 
 /* Register index used for aggregate return pointers. */
 #define REGALLOC_RET_REG 0
 
+/* Bit of register index R in the masks of regalloc_target_t */
+#define REGALLOC_REG_BIT(r) (1u << (r))
+
+/*
+ * Register description of the selected mode.  Classes are bit masks over
+ * the register indices; the orders list the candidates of a class from
+ * most to least preferred.
+ */
+typedef struct {
+    int count;                  /* indices 0 .. count-1 exist */
+    unsigned local_regs;        /* values live within one block */
+    unsigned global_regs;       /* values live across blocks */
+    const int *local_order;     /* -1 terminated */
+    const int *global_order;    /* -1 terminated */
+    unsigned caller_saved;      /* clobbered by a call */
+    unsigned callee_saved;      /* preserved by a call, saved when written */
+    unsigned arg_regs;          /* written while passing call arguments */
+    const int *arg_order;       /* integer argument registers, -1 terminated */
+    unsigned byte_regs;         /* have an 8-bit form */
+    int scratch2;               /* second scratch register of the code generator */
+    unsigned fixed_regs[3];     /* accumulator, count and data register */
+} regalloc_target_t;
+
+/* Return the register description of the mode selected by regalloc_set_x86_64 */
+const regalloc_target_t *regalloc_target(void);
+
 /*
  * Return the textual CPU register name for the allocator index `idx`.
  * Indices outside the valid range fall back to the first register of
@@ -40,6 +68,10 @@ const char *regalloc_reg_name(int idx);
  */
 const char *regalloc_reg_name32(int idx);
 
+/* Return the 16-bit and 8-bit CPU register names for allocator index `idx`. */
+const char *regalloc_reg_name16(int idx);
+const char *regalloc_reg_name8(int idx);
+
 /* Allocate and release temporary XMM registers. */
 int regalloc_xmm_acquire(void);
 void regalloc_xmm_release(int reg);
@@ -51,6 +83,9 @@ const char *regalloc_xmm_name(int idx);
 /* Enable or disable 64-bit register naming. */
 void regalloc_set_x86_64(int enable);
 
+/* Return non-zero when 64-bit register names are selected. */
+int regalloc_get_x86_64(void);
+
 /* Select assembly syntax flavor for register names. */
 void regalloc_set_asm_syntax(asm_syntax_t syntax);
 
@@ -16,8 +16,8 @@
 #include "util.h"
 
 typedef struct label_entry {
-    char *name;
-    char *ir_name;
+    const char *name;    /* interned user label */
+    const char *ir_name; /* interned IR label */
     struct label_entry *next;
 } label_entry_t;
 
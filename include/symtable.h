@@ -14,8 +14,8 @@
 
 /* Symbol table entry */
 typedef struct symbol {
-    char *name;
-    char *ir_name;
+    const char *name;    /* interned source name */
+    const char *ir_name; /* interned name used in the IR */
     type_kind_t type;
     int param_index; /* -1 for locals */
     size_t array_size;
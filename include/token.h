@@ -9,6 +9,7 @@
 #define VC_TOKEN_H
 
 #include <stddef.h>
+#include "vector.h"
 
 /* Token types used by the lexer */
 typedef enum {
@@ -108,12 +109,20 @@ typedef enum {
     TOK_UNKNOWN
 } token_type_t;
 
-/* Representation of a single lexical token */
+/*
+ * Representation of a single lexical token.
+ *
+ * Identifiers, keywords, numbers and punctuators share their text through
+ * the string interner so producing them needs no allocation.  Only the
+ * decoded contents of string and character literals are owned by the
+ * token and released by lexer_free_tokens().
+ */
 typedef struct {
     token_type_t type;
-    char *lexeme; /* NUL terminated string */
+    const char *lexeme; /* NUL terminated string */
     size_t line;
     size_t column;
+    int owned;          /* lexeme is heap allocated for this token */
 } token_t;
 
 /* Tokenize the given C source string. The returned array must be freed
@@ -121,6 +130,45 @@ typedef struct {
  * number of tokens returned. */
 token_t *lexer_tokenize(const char *src, size_t *out_count);
 
+/*
+ * Incremental lexer state.
+ *
+ * Text may be supplied in several chunks with lexer_stream_feed() as long
+ * as every chunk ends on a line boundary.  Line and column counters carry
+ * over between chunks so the resulting tokens match those produced by
+ * lexer_tokenize() on the concatenated text.
+ */
+typedef struct {
+    vector_t tokens; /* token_t elements produced so far */
+    size_t line;     /* current line number */
+    size_t column;   /* current column number */
+} lexer_stream_t;
+
+/* Prepare an empty token stream */
+void lexer_stream_init(lexer_stream_t *ls);
+
+/* Tokenize TEXT and append the tokens to the stream.  Returns 1 on
+ * success or 0 on error. */
+int lexer_stream_feed(lexer_stream_t *ls, const char *text);
+
+/*
+ * Append the token spelled by TEXT, an interned preprocessing token of
+ * LEN bytes, at the current position and advance the column past it.
+ * Identifiers and punctuators are classified directly; other spellings go
+ * through the scanners.  LABEL turns an identifier into the TOK_LABEL the
+ * lexer produces for 'name:'.  Returns 1 on success or 0 on error.
+ */
+int lexer_stream_add(lexer_stream_t *ls, const char *text, size_t len,
+                     int label);
+
+/* Append the EOF marker and return the token array, which must be freed
+ * with lexer_free_tokens().  The stream is left empty.  Returns NULL on
+ * failure. */
+token_t *lexer_stream_finish(lexer_stream_t *ls, size_t *out_count);
+
+/* Release all tokens held by an unfinished stream */
+void lexer_stream_free(lexer_stream_t *ls);
+
 /* Free an array of tokens returned by lexer_tokenize().  If \a tokens is NULL
  * or \a count is zero the function does nothing. */
 void lexer_free_tokens(token_t *tokens, size_t count);
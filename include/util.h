@@ -51,9 +51,6 @@ int vc_strtoul_unsigned(const char *s, unsigned *out);
 /* Release a vector of malloc'd strings */
 void free_string_vector(vector_t *v);
 
-/* Release a vector of macro_t elements */
-void free_macro_vector(vector_t *v);
-
 /* Release a vector of func_t* elements */
 void free_func_list_vector(vector_t *v);
 
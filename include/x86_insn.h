@@ -0,0 +1,151 @@
+/*
+ * Machine instructions of the x86 backend.
+ *
+ * The code generator lowers each IR instruction into x86_insn_t records
+ * collected in an x86_insn_list_t instead of formatting assembly text.
+ * Operands keep registers, memory references, immediates and symbols
+ * apart so later passes can inspect or rewrite the list, and
+ * x86_insn_list_print() renders it in AT&T or Intel syntax.  Operands are
+ * stored in AT&T order with the destination last.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#ifndef VC_X86_INSN_H
+#define VC_X86_INSN_H
+
+#include "cli.h"
+#include "strbuf.h"
+#include "vector.h"
+
+/*
+ * Registers.  The first fourteen share the numbering of the register
+ * allocator indices; the width of a register operand is kept separately.
+ */
+typedef enum {
+    X86_NOREG = -1,
+    X86_AX, X86_BX, X86_CX, X86_DX, X86_SI, X86_DI,
+    X86_R8, X86_R9, X86_R10, X86_R11, X86_R12, X86_R13, X86_R14, X86_R15,
+    X86_SP, X86_BP,
+    X86_XMM0, X86_XMM1, X86_XMM2, X86_XMM3,
+    X86_XMM4, X86_XMM5, X86_XMM6, X86_XMM7
+} x86_reg_t;
+
+/* Condition codes of X86_SETCC and X86_JCC */
+typedef enum {
+    X86_CC_E, X86_CC_NE,
+    X86_CC_L, X86_CC_LE, X86_CC_G, X86_CC_GE,
+    X86_CC_B, X86_CC_BE, X86_CC_A, X86_CC_AE
+} x86_cc_t;
+
+typedef enum {
+    /* integer moves */
+    X86_MOV, X86_MOVABS, X86_MOVZB, X86_MOVZW, X86_MOVSB, X86_MOVSW,
+    X86_LEA, X86_PUSH, X86_POP, X86_XCHG,
+    /* integer arithmetic */
+    X86_ADD, X86_SUB, X86_IMUL, X86_DIV, X86_IDIV, X86_NEG,
+    X86_AND, X86_OR, X86_XOR, X86_SAL, X86_SAR, X86_SHL, X86_SHR,
+    X86_CMP, X86_SETCC, X86_CLTD, X86_CQTO,
+    /* control flow */
+    X86_JMP, X86_JCC, X86_CALL, X86_RET,
+    /* SSE */
+    X86_MOVD, X86_MOVQ, X86_MOVSS, X86_MOVSD, X86_MOVDQU,
+    X86_ADDSS, X86_SUBSS, X86_MULSS, X86_DIVSS,
+    X86_ADDSD, X86_SUBSD, X86_MULSD, X86_DIVSD,
+    X86_CVTSI2SS, X86_CVTSI2SD, X86_CVTTSS2SI, X86_CVTTSD2SI,
+    X86_CVTSS2SD, X86_CVTSD2SS,
+    /* x87 */
+    X86_FLDT, X86_FSTPT, X86_FADDP, X86_FSUBP, X86_FMULP, X86_FDIVP,
+    /* labels and directives */
+    X86_LABEL,          /* operand: symbol */
+    X86_GLOBL,          /* .globl symbol */
+    X86_TYPE_FUNC,      /* .type symbol, @function */
+    X86_SIZE_FUNC,      /* .size symbol, .-symbol */
+    X86_LOC,            /* .loc 1 line column */
+    X86_COMMENT         /* operand symbol holds the text */
+} x86_opcode_t;
+
+typedef enum {
+    X86_OPD_NONE,       /* missing value, printed as nothing */
+    X86_OPD_REG,        /* register */
+    X86_OPD_IMM,        /* number or address of a symbol */
+    X86_OPD_MEM,        /* sym+disp(base,index,scale) */
+    X86_OPD_SYM         /* symbol or label used by name */
+} x86_operand_kind_t;
+
+/* Operand flags */
+#define X86_OPF_UNSIGNED 0x1    /* immediate printed as an unsigned value */
+#define X86_OPF_FLAT 0x2        /* Intel symbol address as OFFSET FLAT:sym */
+
+typedef struct {
+    x86_operand_kind_t kind;
+    x86_reg_t reg;          /* register or base of a memory operand */
+    x86_reg_t index;        /* index register of a memory operand */
+    unsigned char size;     /* register width in bytes */
+    unsigned char scale;    /* 1, 2, 4 or 8 */
+    unsigned char flags;    /* X86_OPF_* */
+    long long value;        /* immediate or displacement */
+    const char *sym;        /* symbol name, label suffix or comment */
+    int label;              /* generated label L<label><sym> or -1 */
+} x86_operand_t;
+
+/* Instruction flags */
+#define X86_INSF_BARE 0x1       /* Intel form leaves the size to the operands */
+
+typedef struct {
+    x86_opcode_t op;
+    char sfx;               /* size suffix b, w, l or q, 0 for none */
+    unsigned char cc;       /* x86_cc_t of X86_SETCC and X86_JCC */
+    unsigned char flags;    /* X86_INSF_* */
+    unsigned char nops;
+    x86_operand_t ops[3];   /* AT&T order, destination last */
+} x86_insn_t;
+
+typedef struct {
+    vector_t insns;         /* x86_insn_t */
+} x86_insn_list_t;
+
+/* Operand constructors */
+x86_operand_t x86_none(void);
+x86_operand_t x86_reg(x86_reg_t reg, int size);
+x86_operand_t x86_imm(long long value);
+x86_operand_t x86_uimm(unsigned long long value);
+/* Address of SYM as an immediate */
+x86_operand_t x86_sym_addr(const char *sym);
+x86_operand_t x86_sym(const char *sym);
+/* Generated label L<id><suffix> */
+x86_operand_t x86_label(int id, const char *suffix);
+/* DISP(BASE) with a base register of SIZE bytes */
+x86_operand_t x86_mem(x86_reg_t base, int size, long long disp);
+
+/* Return 1 when A and B denote the same operand */
+int x86_operand_equal(const x86_operand_t *a, const x86_operand_t *b);
+
+void x86_insn_list_init(x86_insn_list_t *list);
+void x86_insn_list_free(x86_insn_list_t *list);
+
+/*
+ * Append an instruction with zero to three operands.  Returns 0 on
+ * allocation failure.
+ */
+int x86_emit_insn(x86_insn_list_t *list, const x86_insn_t *ins);
+int x86_emit0(x86_insn_list_t *list, x86_opcode_t op, char sfx);
+int x86_emit1(x86_insn_list_t *list, x86_opcode_t op, char sfx,
+              x86_operand_t a);
+int x86_emit2(x86_insn_list_t *list, x86_opcode_t op, char sfx,
+              x86_operand_t src, x86_operand_t dest);
+int x86_emit3(x86_insn_list_t *list, x86_opcode_t op, char sfx,
+              x86_operand_t a, x86_operand_t b, x86_operand_t c);
+/* Append X86_SETCC or X86_JCC */
+int x86_emit_cc(x86_insn_list_t *list, x86_opcode_t op, x86_cc_t cc,
+                x86_operand_t a);
+
+/*
+ * Append the assembly for LIST to SB in the requested syntax.  Returns 0
+ * on success and -1 on failure.
+ */
+int x86_insn_list_print(strbuf_t *sb, const x86_insn_list_t *list,
+                        asm_syntax_t syntax);
+
+#endif /* VC_X86_INSN_H */
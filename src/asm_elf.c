@@ -0,0 +1,415 @@
+/*
+ * ELF relocatable object writer.
+ *
+ * The file is assembled in memory: the ELF header, the contents of every
+ * section, one relocation section per section with relocations, the
+ * symbol and string tables and finally the section header table.
+ * Sections keep the type and flags the assembler gave them, so .rodata
+ * is written as read-only PROGBITS and .bss as NOBITS, which has a size
+ * and alignment but no bytes in the file and therefore no relocations.  All
+ * fields are written little endian one byte at a time, so the host
+ * byte order and structure layout do not matter.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "asm_elf.h"
+#include "util.h"
+
+/* Values from the System V ABI and its i386 and x86-64 supplements */
+#define ET_REL 1
+#define EM_386 3
+#define EM_X86_64 62
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+#define SHT_REL 9
+#define SHF_INFO_LINK 0x40
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_SECTION 3
+#define R_386_32 1
+#define R_386_PC32 2
+#define R_X86_64_64 1
+#define R_X86_64_PC32 2
+#define R_X86_64_PLT32 4
+#define R_X86_64_32 10
+#define R_X86_64_32S 11
+
+void asm_object_init(asm_object_t *obj)
+{
+    vector_init(&obj->sections, sizeof(asm_section_t));
+    vector_init(&obj->symbols, sizeof(asm_symbol_t));
+}
+
+void asm_object_free(asm_object_t *obj)
+{
+    for (size_t i = 0; i < obj->sections.count; i++) {
+        asm_section_t *sec = ASM_SECTION(obj, i);
+        free(sec->data);
+        vector_free(&sec->relocs);
+    }
+    vector_free(&obj->sections);
+    vector_free(&obj->symbols);
+}
+
+int asm_object_section(asm_object_t *obj, const char *name, unsigned type,
+                       unsigned flags)
+{
+    for (size_t i = 0; i < obj->sections.count; i++)
+        if (ASM_SECTION(obj, i)->name == name)
+            return (int)i;
+    asm_section_t sec;
+    memset(&sec, 0, sizeof(sec));
+    sec.name = name;
+    sec.type = type;
+    sec.flags = flags;
+    sec.align = 1;
+    vector_init(&sec.relocs, sizeof(asm_reloc_t));
+    if (!vector_push(&obj->sections, &sec))
+        return -1;
+    return (int)obj->sections.count - 1;
+}
+
+int asm_section_append(asm_section_t *sec, const void *bytes, size_t len)
+{
+    if (sec->type == ASM_SHT_NOBITS) {
+        sec->size += len;
+        return 1;
+    }
+    if (sec->size + len > sec->cap) {
+        size_t cap = sec->cap ? sec->cap * 2 : 256;
+        while (cap < sec->size + len)
+            cap *= 2;
+        unsigned char *data = realloc(sec->data, cap);
+        if (!data)
+            return 0;
+        sec->data = data;
+        sec->cap = cap;
+    }
+    if (bytes)
+        memcpy(sec->data + sec->size, bytes, len);
+    else
+        memset(sec->data + sec->size, 0, len);
+    sec->size += len;
+    return 1;
+}
+
+/* Growable output buffer */
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+} outbuf_t;
+
+static void out_reserve(outbuf_t *b, size_t extra)
+{
+    if (b->len + extra <= b->cap)
+        return;
+    size_t cap = b->cap ? b->cap * 2 : 4096;
+    while (cap < b->len + extra)
+        cap *= 2;
+    b->data = vc_realloc_or_exit(b->data, cap);
+    b->cap = cap;
+}
+
+static void out_int(outbuf_t *b, unsigned long long v, int size)
+{
+    out_reserve(b, (size_t)size);
+    for (int i = 0; i < size; i++)
+        b->data[b->len++] = (unsigned char)(v >> (8 * i));
+}
+
+static void out_bytes(outbuf_t *b, const void *p, size_t len)
+{
+    out_reserve(b, len);
+    if (p)
+        memcpy(b->data + b->len, p, len);
+    else
+        memset(b->data + b->len, 0, len);
+    b->len += len;
+}
+
+static void out_align(outbuf_t *b, size_t align)
+{
+    while (align > 1 && b->len % align)
+        out_int(b, 0, 1);
+}
+
+/* Append NAME to the string table B and return its offset */
+static size_t add_string(outbuf_t *b, const char *name)
+{
+    size_t off = b->len;
+    out_bytes(b, name, strlen(name) + 1);
+    return off;
+}
+
+/* Section header fields, written once all offsets are known */
+typedef struct {
+    size_t name;
+    unsigned type;
+    unsigned long long flags;
+    size_t offset;
+    size_t size;
+    unsigned link;
+    unsigned info;
+    size_t align;
+    size_t entsize;
+} shdr_t;
+
+static unsigned reloc_type(asm_reloc_kind_t kind, int x64)
+{
+    if (!x64)
+        return kind == ASM_RELOC_PC32 || kind == ASM_RELOC_PLT32
+                   ? R_386_PC32 : R_386_32;
+    switch (kind) {
+    case ASM_RELOC_ABS32: return R_X86_64_32;
+    case ASM_RELOC_ABS32S: return R_X86_64_32S;
+    case ASM_RELOC_ABS64: return R_X86_64_64;
+    case ASM_RELOC_PC32: return R_X86_64_PC32;
+    case ASM_RELOC_PLT32: return R_X86_64_PLT32;
+    }
+    return R_X86_64_32;
+}
+
+static void out_symbol(outbuf_t *b, int x64, size_t name, size_t value,
+                       size_t size, int bind, int type, unsigned shndx)
+{
+    unsigned info = (unsigned)((bind << 4) | type);
+    if (x64) {
+        out_int(b, name, 4);
+        out_int(b, info, 1);
+        out_int(b, 0, 1);
+        out_int(b, shndx, 2);
+        out_int(b, value, 8);
+        out_int(b, size, 8);
+    } else {
+        out_int(b, name, 4);
+        out_int(b, value, 4);
+        out_int(b, size, 4);
+        out_int(b, info, 1);
+        out_int(b, 0, 1);
+        out_int(b, shndx, 2);
+    }
+}
+
+/*
+ * Build the symbol table: the null symbol, one symbol per section, the
+ * local symbols and then the global ones.  MAP receives the ELF index
+ * of every object symbol and *FIRST_GLOBAL the index of the first
+ * global entry.
+ */
+static void build_symtab(const asm_object_t *obj, int x64, outbuf_t *symtab,
+                         outbuf_t *strtab, unsigned *map,
+                         unsigned *first_global)
+{
+    unsigned count = 0;
+    out_int(strtab, 0, 1);
+    out_symbol(symtab, x64, 0, 0, 0, STB_LOCAL, 0, 0);
+    count++;
+    for (size_t i = 0; i < obj->sections.count; i++) {
+        out_symbol(symtab, x64, 0, 0, 0, STB_LOCAL, STT_SECTION,
+                   (unsigned)i + 1);
+        count++;
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 1)
+            *first_global = count;
+        for (size_t i = 0; i < obj->symbols.count; i++) {
+            const asm_symbol_t *sym = ASM_SYMBOL(obj, i);
+            int global = sym->global || sym->section < 0;
+            if (global != pass)
+                continue;
+            size_t name = add_string(strtab, sym->name);
+            unsigned shndx = sym->section < 0 ? 0 : (unsigned)sym->section + 1;
+            out_symbol(symtab, x64, name, sym->value, sym->size,
+                       global ? STB_GLOBAL : STB_LOCAL, sym->type, shndx);
+            map[i] = count++;
+        }
+    }
+}
+
+static void out_shdr(outbuf_t *b, int x64, const shdr_t *h)
+{
+    int w = x64 ? 8 : 4;
+    out_int(b, h->name, 4);
+    out_int(b, h->type, 4);
+    out_int(b, h->flags, w);
+    out_int(b, 0, w);
+    out_int(b, h->offset, w);
+    out_int(b, h->size, w);
+    out_int(b, h->link, 4);
+    out_int(b, h->info, 4);
+    out_int(b, h->align, w);
+    out_int(b, h->entsize, w);
+}
+
+int asm_elf_write(const asm_object_t *obj, int x64, const char *path)
+{
+    size_t nsec = obj->sections.count;
+    for (size_t i = 0; i < nsec; i++) {
+        const asm_section_t *sec = ASM_SECTION(obj, i);
+        if (sec->type == ASM_SHT_NOBITS && sec->relocs.count) {
+            fprintf(stderr,
+                    "%s: relocation in section '%s' without contents\n",
+                    path, sec->name);
+            return 0;
+        }
+    }
+    size_t nrel = 0;
+    for (size_t i = 0; i < nsec; i++)
+        if (ASM_SECTION(obj, i)->relocs.count)
+            nrel++;
+    /* null, user sections, relocations, .symtab, .strtab, .shstrtab */
+    size_t nhdr = 1 + nsec + nrel + 3;
+    unsigned symtab_idx = (unsigned)(1 + nsec + nrel);
+    shdr_t *hdrs = vc_alloc_or_exit(nhdr * sizeof(*hdrs));
+    memset(hdrs, 0, nhdr * sizeof(*hdrs));
+    unsigned *map = vc_alloc_or_exit((obj->symbols.count + 1) *
+                                     sizeof(*map));
+
+    outbuf_t out = {0}, shstr = {0}, symtab = {0}, strtab = {0};
+    size_t ehsize = x64 ? 64 : 52;
+    out_bytes(&out, NULL, ehsize);
+    out_int(&shstr, 0, 1);
+
+    for (size_t i = 0; i < nsec; i++) {
+        const asm_section_t *sec = ASM_SECTION(obj, i);
+        shdr_t *h = &hdrs[i + 1];
+        h->name = add_string(&shstr, sec->name);
+        h->type = sec->type;
+        h->flags = sec->flags;
+        h->align = sec->align;
+        h->size = sec->size;
+        if (sec->type != ASM_SHT_NOBITS) {
+            out_align(&out, sec->align);
+            h->offset = out.len;
+            out_bytes(&out, sec->data, sec->size);
+        } else {
+            h->offset = out.len;
+        }
+    }
+
+    unsigned first_global = 0;
+    build_symtab(obj, x64, &symtab, &strtab, map, &first_global);
+
+    size_t r = 1 + nsec;
+    for (size_t i = 0; i < nsec; i++) {
+        const asm_section_t *sec = ASM_SECTION(obj, i);
+        if (!sec->relocs.count)
+            continue;
+        shdr_t *h = &hdrs[r++];
+        char name[256];
+        snprintf(name, sizeof(name), "%s%s", x64 ? ".rela" : ".rel",
+                 sec->name);
+        h->name = add_string(&shstr, name);
+        h->type = x64 ? SHT_RELA : SHT_REL;
+        h->flags = SHF_INFO_LINK;
+        h->link = symtab_idx;
+        h->info = (unsigned)i + 1;
+        h->align = x64 ? 8 : 4;
+        h->entsize = x64 ? 24 : 8;
+        out_align(&out, h->align);
+        h->offset = out.len;
+        const asm_reloc_t *rel = sec->relocs.data;
+        for (size_t j = 0; j < sec->relocs.count; j++) {
+            unsigned long long sym = rel[j].symbol >= 0
+                                         ? map[rel[j].symbol]
+                                         : (unsigned)rel[j].section + 1;
+            unsigned long long type = reloc_type(rel[j].kind, x64);
+            if (x64) {
+                out_int(&out, rel[j].offset, 8);
+                out_int(&out, (sym << 32) | type, 8);
+                out_int(&out, (unsigned long long)rel[j].addend, 8);
+            } else {
+                out_int(&out, rel[j].offset, 4);
+                out_int(&out, (sym << 8) | type, 4);
+            }
+        }
+        h->size = out.len - h->offset;
+    }
+
+    shdr_t *h = &hdrs[symtab_idx];
+    h->name = add_string(&shstr, ".symtab");
+    h->type = SHT_SYMTAB;
+    h->link = symtab_idx + 1;
+    h->info = first_global;
+    h->align = x64 ? 8 : 4;
+    h->entsize = x64 ? 24 : 16;
+    out_align(&out, h->align);
+    h->offset = out.len;
+    h->size = symtab.len;
+    out_bytes(&out, symtab.data, symtab.len);
+
+    h = &hdrs[symtab_idx + 1];
+    h->name = add_string(&shstr, ".strtab");
+    h->type = SHT_STRTAB;
+    h->align = 1;
+    h->offset = out.len;
+    h->size = strtab.len;
+    out_bytes(&out, strtab.data, strtab.len);
+
+    h = &hdrs[symtab_idx + 2];
+    h->name = add_string(&shstr, ".shstrtab");
+    h->type = SHT_STRTAB;
+    h->align = 1;
+    h->offset = out.len;
+    h->size = shstr.len;
+    out_bytes(&out, shstr.data, shstr.len);
+
+    out_align(&out, x64 ? 8 : 4);
+    size_t shoff = out.len;
+    for (size_t i = 0; i < nhdr; i++)
+        out_shdr(&out, x64, &hdrs[i]);
+
+    /* ELF header */
+    outbuf_t eh = {0};
+    static const unsigned char magic[4] = {0x7f, 'E', 'L', 'F'};
+    out_bytes(&eh, magic, 4);
+    out_int(&eh, x64 ? 2 : 1, 1);       /* class */
+    out_int(&eh, 1, 1);                 /* little endian */
+    out_int(&eh, 1, 1);                 /* version */
+    out_bytes(&eh, NULL, 9);            /* System V ABI and padding */
+    out_int(&eh, ET_REL, 2);
+    out_int(&eh, x64 ? EM_X86_64 : EM_386, 2);
+    out_int(&eh, 1, 4);
+    out_int(&eh, 0, x64 ? 8 : 4);       /* entry */
+    out_int(&eh, 0, x64 ? 8 : 4);       /* program headers */
+    out_int(&eh, shoff, x64 ? 8 : 4);
+    out_int(&eh, 0, 4);                 /* flags */
+    out_int(&eh, ehsize, 2);
+    out_int(&eh, 0, 2);
+    out_int(&eh, 0, 2);
+    out_int(&eh, x64 ? 64 : 40, 2);
+    out_int(&eh, nhdr, 2);
+    out_int(&eh, symtab_idx + 2, 2);    /* .shstrtab */
+    memcpy(out.data, eh.data, ehsize);
+
+    int ok = 1;
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        perror(path);
+        ok = 0;
+    } else {
+        if (fwrite(out.data, 1, out.len, f) != out.len) {
+            perror("fwrite");
+            ok = 0;
+        }
+        if (fclose(f) == EOF) {
+            perror("fclose");
+            ok = 0;
+        }
+    }
+    free(eh.data);
+    free(out.data);
+    free(shstr.data);
+    free(symtab.data);
+    free(strtab.data);
+    free(hdrs);
+    free(map);
+    return ok;
+}
@@ -0,0 +1,1136 @@
+/*
+ * Integrated assembler driver.
+ *
+ * The assembly text is processed in passes.  Every pass parses each line,
+ * defines labels at the current location, runs directives and encodes
+ * instructions into the sections of the object.  Jumps to nearby labels
+ * start out with 8-bit displacements; after a pass every short jump whose
+ * target turned out to be out of range, in another section or global is
+ * marked long and the text is assembled again.  Once a pass changes no
+ * jump its layout is final and the recorded fixups are resolved, either
+ * directly or as relocations against a symbol or section.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "asm_x86.h"
+#include "intern.h"
+#include "util.h"
+
+/* Symbol as seen by the assembler; .L names never reach the object */
+typedef struct {
+    const char *name;
+    int section;            /* -1 while undefined */
+    size_t value;
+    size_t size;
+    int global;
+    int type;
+    int pass;               /* last pass defining the symbol */
+} as_sym_t;
+
+/* Symbolic field recorded while encoding, resolved after the last pass */
+typedef struct {
+    int section;
+    size_t offset;          /* field position in the section */
+    size_t end;             /* end of the instruction, for PC relative */
+    int size;
+    int pcrel;
+    int branch;
+    int sign;
+    asm_expr_t expr;
+} as_fixup_t;
+
+/* Jump encoded short in the current pass */
+typedef struct {
+    size_t index;           /* into as_t.jump_long */
+    int section;
+    size_t end;
+    asm_expr_t target;
+} as_jump_t;
+
+typedef struct {
+    asm_object_t *obj;
+    int x64;
+    int pass;
+    int section;            /* current section */
+    vector_t syms;          /* as_sym_t */
+    int *slots;             /* hash of symbol names to indices, -1 empty */
+    size_t nslots;
+    vector_t fixups;        /* as_fixup_t */
+    vector_t jump_long;     /* unsigned char per jump */
+    vector_t jumps;         /* as_jump_t */
+    size_t jump_count;
+    int line;
+    const char *line_text;
+    size_t line_len;
+    int error;
+} as_t;
+
+#define SYM(as, i) (&((as_sym_t *)(as)->syms.data)[i])
+
+static void as_error(as_t *as, const char *fmt, const char *arg)
+{
+    if (as->error)
+        return;
+    fprintf(stderr, "assembler: line %d: ", as->line);
+    fprintf(stderr, fmt, arg);
+    fprintf(stderr, "\n    %.*s\n", (int)as->line_len, as->line_text);
+    as->error = 1;
+}
+
+static size_t hash_ptr(const char *p)
+{
+    size_t h = (size_t)p;
+    return (h >> 4) ^ (h >> 13);
+}
+
+static void rehash(as_t *as)
+{
+    size_t n = as->nslots ? as->nslots * 2 : 256;
+    int *slots = vc_alloc_or_exit(n * sizeof(*slots));
+    for (size_t i = 0; i < n; i++)
+        slots[i] = -1;
+    for (size_t i = 0; i < as->syms.count; i++) {
+        size_t h = hash_ptr(SYM(as, i)->name) & (n - 1);
+        while (slots[h] >= 0)
+            h = (h + 1) & (n - 1);
+        slots[h] = (int)i;
+    }
+    free(as->slots);
+    as->slots = slots;
+    as->nslots = n;
+}
+
+/* Index of the symbol spelled by LEN bytes at NAME, created on first use */
+static int sym_lookup(as_t *as, const char *name, size_t len)
+{
+    const char *key = intern_text(name, len);
+    if ((as->syms.count + 1) * 2 > as->nslots)
+        rehash(as);
+    size_t h = hash_ptr(key) & (as->nslots - 1);
+    while (as->slots[h] >= 0) {
+        if (SYM(as, as->slots[h])->name == key)
+            return as->slots[h];
+        h = (h + 1) & (as->nslots - 1);
+    }
+    as_sym_t sym = { key, -1, 0, 0, 0, ASM_STT_NOTYPE, 0 };
+    if (!vector_push(&as->syms, &sym)) {
+        vc_oom();
+        exit(1);
+    }
+    as->slots[h] = (int)as->syms.count - 1;
+    return as->slots[h];
+}
+
+static asm_section_t *cur_sec(as_t *as)
+{
+    return ASM_SECTION(as->obj, as->section);
+}
+
+static void push_or_exit(vector_t *v, const void *elem)
+{
+    if (!vector_push(v, elem)) {
+        vc_oom();
+        exit(1);
+    }
+}
+
+/* Switch to section NAME, creating it with the given type and flags */
+static void set_section(as_t *as, const char *name, size_t len,
+                        unsigned type, unsigned flags)
+{
+    int idx = asm_object_section(as->obj, intern_text(name, len), type, flags);
+    if (idx < 0) {
+        vc_oom();
+        exit(1);
+    }
+    as->section = idx;
+    if (cur_sec(as)->type != type || cur_sec(as)->flags != flags)
+        as_error(as, "section '%s' changed its type or flags",
+                 cur_sec(as)->name);
+}
+
+static void emit_bytes(as_t *as, const void *bytes, size_t len)
+{
+    asm_section_t *sec = cur_sec(as);
+    if (sec->type == ASM_SHT_NOBITS && bytes) {
+        for (size_t i = 0; i < len; i++) {
+            if (((const unsigned char *)bytes)[i]) {
+                as_error(as, "%s", "data in a section without contents");
+                return;
+            }
+        }
+    }
+    if (!asm_section_append(sec, bytes, len)) {
+        vc_oom();
+        exit(1);
+    }
+}
+
+static void emit_fill(as_t *as, size_t len, unsigned char fill)
+{
+    if (!fill) {
+        emit_bytes(as, NULL, len);
+        return;
+    }
+    for (size_t i = 0; i < len; i++)
+        emit_bytes(as, &fill, 1);
+}
+
+static void align_section(as_t *as, size_t align)
+{
+    asm_section_t *sec = cur_sec(as);
+    if (align < 1 || (align & (align - 1))) {
+        as_error(as, "%s", "alignment is not a power of two");
+        return;
+    }
+    if (align > sec->align)
+        sec->align = align;
+    size_t pad = (align - sec->size % align) % align;
+    emit_fill(as, pad, (sec->flags & ASM_SHF_EXECINSTR) ? 0x90 : 0);
+}
+
+/* ---------------------------------------------------------------------
+ * Lexical helpers
+ * --------------------------------------------------------------------- */
+
+typedef struct {
+    const char *p;
+    const char *end;
+} cursor_t;
+
+static void skip_ws(cursor_t *c)
+{
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t'))
+        c->p++;
+}
+
+static int at_end(cursor_t *c)
+{
+    skip_ws(c);
+    return c->p >= c->end;
+}
+
+static int sym_start(char ch)
+{
+    return isalpha((unsigned char)ch) || ch == '_' || ch == '.' || ch == '$';
+}
+
+static int sym_char(char ch)
+{
+    return isalnum((unsigned char)ch) || ch == '_' || ch == '.' || ch == '$';
+}
+
+/* Length of the identifier at C or 0 */
+static size_t ident_len(const cursor_t *c)
+{
+    const char *p = c->p;
+    if (p >= c->end || !sym_start(*p))
+        return 0;
+    while (p < c->end && sym_char(*p))
+        p++;
+    return (size_t)(p - c->p);
+}
+
+static int accept(cursor_t *c, char ch)
+{
+    skip_ws(c);
+    if (c->p < c->end && *c->p == ch) {
+        c->p++;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Parse an expression of numbers and symbols joined by + and -.  At
+ * most one symbol may remain; the difference of two symbols defined in
+ * the same section, '.' being the current location, folds to a number.
+ */
+static int parse_expr(as_t *as, cursor_t *c, asm_expr_t *out)
+{
+    int pos = -1, neg = -1;
+    int pos_dot = 0, neg_dot = 0;
+    long long value = 0;
+    int sign = 1;
+    for (;;) {
+        skip_ws(c);
+        while (c->p < c->end && (*c->p == '-' || *c->p == '+')) {
+            if (*c->p == '-')
+                sign = -sign;
+            c->p++;
+            skip_ws(c);
+        }
+        if (c->p >= c->end) {
+            as_error(as, "%s", "missing expression");
+            return 0;
+        }
+        size_t n = ident_len(c);
+        if (isdigit((unsigned char)*c->p)) {
+            char buf[32];
+            size_t len = 0;
+            while (c->p + len < c->end && len < sizeof(buf) - 1 &&
+                   isalnum((unsigned char)c->p[len])) {
+                buf[len] = c->p[len];
+                len++;
+            }
+            buf[len] = '\0';
+            char *endp;
+            unsigned long long v = strtoull(buf, &endp, 0);
+            if (*endp) {
+                as_error(as, "%s", "bad number");
+                return 0;
+            }
+            c->p += len;
+            value += sign * (long long)v;
+        } else if (n == 1 && *c->p == '.') {
+            c->p++;
+            if (sign > 0 && !pos_dot && pos < 0)
+                pos_dot = 1;
+            else if (sign < 0 && !neg_dot && neg < 0)
+                neg_dot = 1;
+            else
+                goto complex;
+        } else if (n) {
+            int s = sym_lookup(as, c->p, n);
+            c->p += n;
+            if (sign > 0 && pos < 0 && !pos_dot)
+                pos = s;
+            else if (sign < 0 && neg < 0 && !neg_dot)
+                neg = s;
+            else
+                goto complex;
+        } else {
+            as_error(as, "%s", "bad expression");
+            return 0;
+        }
+        skip_ws(c);
+        if (c->p < c->end && (*c->p == '+' || *c->p == '-')) {
+            sign = 1;
+            continue;
+        }
+        break;
+    }
+    if (neg >= 0 || neg_dot) {
+        int psec, nsec;
+        size_t pval, nval;
+        if (pos < 0 && !pos_dot)
+            goto complex;
+        psec = pos_dot ? as->section : SYM(as, pos)->section;
+        pval = pos_dot ? cur_sec(as)->size : SYM(as, pos)->value;
+        nsec = neg_dot ? as->section : SYM(as, neg)->section;
+        nval = neg_dot ? cur_sec(as)->size : SYM(as, neg)->value;
+        if (psec < 0 || psec != nsec)
+            goto complex;
+        value += (long long)pval - (long long)nval;
+        pos = -1;
+        pos_dot = 0;
+    }
+    if (pos_dot)
+        goto complex;
+    out->sym = pos;
+    out->value = value;
+    return 1;
+
+complex:
+    as_error(as, "%s", "unsupported expression");
+    return 0;
+}
+
+/* Parse an absolute expression, one without symbols */
+static int parse_number(as_t *as, cursor_t *c, long long *out)
+{
+    asm_expr_t e;
+    if (!parse_expr(as, c, &e))
+        return 0;
+    if (e.sym >= 0) {
+        as_error(as, "%s", "expected a constant");
+        return 0;
+    }
+    *out = e.value;
+    return 1;
+}
+
+/* ---------------------------------------------------------------------
+ * Operands
+ * --------------------------------------------------------------------- */
+
+static const char *const reg64[] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi"
+};
+static const char *const reg32[] = {
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi"
+};
+static const char *const reg16[] = {
+    "ax", "cx", "dx", "bx", "sp", "bp", "si", "di"
+};
+static const char *const reg8[] = {
+    "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil"
+};
+
+static int name_eq(const char *s, size_t len, const char *name)
+{
+    return strlen(name) == len && strncmp(s, name, len) == 0;
+}
+
+/*
+ * Parse the register name of LEN bytes at S into OP.  Returns 0 for
+ * unknown names.  %rip sets OP->rip.
+ */
+static int parse_reg_name(const char *s, size_t len, asm_operand_t *op)
+{
+    op->kind = ASM_OP_REG;
+    op->rex_byte = 0;
+    for (int i = 0; i < 8; i++) {
+        if (name_eq(s, len, reg64[i])) {
+            op->reg = i;
+            op->size = 8;
+            return 1;
+        }
+        if (name_eq(s, len, reg32[i])) {
+            op->reg = i;
+            op->size = 4;
+            return 1;
+        }
+        if (name_eq(s, len, reg16[i])) {
+            op->reg = i;
+            op->size = 2;
+            return 1;
+        }
+        if (name_eq(s, len, reg8[i])) {
+            op->reg = i;
+            op->size = 1;
+            op->rex_byte = i >= 4;
+            return 1;
+        }
+    }
+    if (name_eq(s, len, "rip")) {
+        op->rip = 1;
+        op->size = 8;
+        return 1;
+    }
+    if (len >= 4 && strncmp(s, "xmm", 3) == 0) {
+        int n = 0;
+        for (size_t i = 3; i < len; i++) {
+            if (!isdigit((unsigned char)s[i]))
+                return 0;
+            n = n * 10 + (s[i] - '0');
+        }
+        if (n > 15 || (len > 4 && s[3] == '0'))
+            return 0;
+        op->kind = ASM_OP_XMM;
+        op->reg = n;
+        op->size = 16;
+        return 1;
+    }
+    if (len >= 2 && s[0] == 'r' && isdigit((unsigned char)s[1])) {
+        size_t i = 1;
+        int n = 0;
+        while (i < len && isdigit((unsigned char)s[i]))
+            n = n * 10 + (s[i++] - '0');
+        if (n < 8 || n > 15)
+            return 0;
+        op->reg = n;
+        if (i == len)
+            op->size = 8;
+        else if (i + 1 == len && s[i] == 'd')
+            op->size = 4;
+        else if (i + 1 == len && s[i] == 'w')
+            op->size = 2;
+        else if (i + 1 == len && s[i] == 'b')
+            op->size = 1;
+        else
+            return 0;
+        return 1;
+    }
+    return 0;
+}
+
+static int parse_reg(as_t *as, cursor_t *c, asm_operand_t *op)
+{
+    skip_ws(c);
+    if (c->p >= c->end || *c->p != '%') {
+        as_error(as, "%s", "expected a register");
+        return 0;
+    }
+    c->p++;
+    const char *s = c->p;
+    while (c->p < c->end && isalnum((unsigned char)*c->p))
+        c->p++;
+    if (!parse_reg_name(s, (size_t)(c->p - s), op)) {
+        as_error(as, "%s", "unknown register");
+        return 0;
+    }
+    return 1;
+}
+
+/* Base or index register of a memory operand */
+static int address_reg(as_t *as, cursor_t *c, asm_operand_t *mem, int index)
+{
+    asm_operand_t r;
+    memset(&r, 0, sizeof(r));
+    if (!parse_reg(as, c, &r))
+        return 0;
+    if (r.rip) {
+        if (index || !as->x64) {
+            as_error(as, "%s", "invalid use of %rip");
+            return 0;
+        }
+        mem->rip = 1;
+        return 1;
+    }
+    if (r.kind != ASM_OP_REG || r.size < 4 || (r.size == 8 && !as->x64) ||
+        (index && r.reg == 4)) {
+        as_error(as, "%s", "invalid address register");
+        return 0;
+    }
+    if (as->x64 && r.size == 4)
+        mem->addr32 = 1;
+    if (index)
+        mem->index = r.reg;
+    else
+        mem->base = r.reg;
+    return 1;
+}
+
+static int parse_operand(as_t *as, cursor_t *c, asm_operand_t *op)
+{
+    memset(op, 0, sizeof(*op));
+    op->reg = -1;
+    op->base = -1;
+    op->index = -1;
+    op->scale = 1;
+    op->expr.sym = -1;
+    skip_ws(c);
+    if (c->p < c->end && *c->p == '*') {
+        op->indirect = 1;
+        c->p++;
+        skip_ws(c);
+    }
+    if (c->p < c->end && *c->p == '%') {
+        if (!parse_reg(as, c, op))
+            return 0;
+        if (op->rip) {
+            as_error(as, "%s", "invalid use of %rip");
+            return 0;
+        }
+        return 1;
+    }
+    if (c->p < c->end && *c->p == '$') {
+        c->p++;
+        op->kind = ASM_OP_IMM;
+        return parse_expr(as, c, &op->expr);
+    }
+    op->kind = ASM_OP_MEM;
+    skip_ws(c);
+    if (c->p < c->end && *c->p != '(' && !parse_expr(as, c, &op->expr))
+        return 0;
+    if (!accept(c, '('))
+        return 1;
+    skip_ws(c);
+    if (c->p < c->end && *c->p == '%' && !address_reg(as, c, op, 0))
+        return 0;
+    if (accept(c, ',')) {
+        if (!address_reg(as, c, op, 1))
+            return 0;
+        if (accept(c, ',')) {
+            long long scale;
+            if (!parse_number(as, c, &scale))
+                return 0;
+            if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+                as_error(as, "%s", "invalid scale");
+                return 0;
+            }
+            op->scale = (int)scale;
+        }
+    }
+    if (!accept(c, ')')) {
+        as_error(as, "%s", "expected ')'");
+        return 0;
+    }
+    if (op->rip && op->index >= 0) {
+        as_error(as, "%s", "invalid use of %rip");
+        return 0;
+    }
+    /* frame slots are addressed by plain offsets, never by a symbol */
+    if (op->expr.sym >= 0 && op->base == 5) {
+        as_error(as, "%s", "symbol used with a frame pointer base");
+        return 0;
+    }
+    return 1;
+}
+
+/* ---------------------------------------------------------------------
+ * Instructions
+ * --------------------------------------------------------------------- */
+
+static void add_fixups(as_t *as, const asm_code_t *code, size_t start)
+{
+    for (int i = 0; i < code->nfixups; i++) {
+        const asm_fixup_t *f = &code->fixups[i];
+        as_fixup_t fx = { as->section, start + f->offset, start + code->len,
+                          f->size, f->pcrel, f->branch, f->sign, f->expr };
+        push_or_exit(&as->fixups, &fx);
+    }
+}
+
+static void assemble_insn(as_t *as, cursor_t *c)
+{
+    asm_insn_t ins;
+    memset(&ins, 0, sizeof(ins));
+    ins.mnemonic = c->p;
+    while (c->p < c->end && isalnum((unsigned char)*c->p))
+        c->p++;
+    ins.mnemonic_len = (size_t)(c->p - ins.mnemonic);
+    if (!ins.mnemonic_len) {
+        as_error(as, "%s", "syntax error");
+        return;
+    }
+    if (!at_end(c)) {
+        do {
+            if (ins.nops == 3) {
+                as_error(as, "%s", "too many operands");
+                return;
+            }
+            if (!parse_operand(as, c, &ins.ops[ins.nops++]))
+                return;
+        } while (accept(c, ','));
+        if (!at_end(c)) {
+            as_error(as, "%s", "junk after operands");
+            return;
+        }
+    }
+
+    int jump = asm_x86_is_jump(&ins);
+    size_t jump_index = 0;
+    int short_branch = 0;
+    if (jump) {
+        jump_index = as->jump_count++;
+        if (jump_index >= as->jump_long.count) {
+            unsigned char zero = 0;
+            push_or_exit(&as->jump_long, &zero);
+        }
+        short_branch = !((unsigned char *)as->jump_long.data)[jump_index];
+    }
+
+    asm_code_t code;
+    char err[128];
+    if (!asm_x86_encode(&ins, as->x64, short_branch, &code, err,
+                        sizeof(err))) {
+        as_error(as, "%s", err);
+        return;
+    }
+    size_t start = cur_sec(as)->size;
+    emit_bytes(as, code.bytes, code.len);
+    if (jump && short_branch) {
+        as_jump_t j = { jump_index, as->section, start + code.len,
+                        ins.ops[0].expr };
+        push_or_exit(&as->jumps, &j);
+    } else {
+        add_fixups(as, &code, start);
+    }
+}
+
+/* ---------------------------------------------------------------------
+ * Directives
+ * --------------------------------------------------------------------- */
+
+/* Parse the symbol name at C and return its index or -1 */
+static int parse_sym(as_t *as, cursor_t *c)
+{
+    skip_ws(c);
+    size_t n = ident_len(c);
+    if (!n) {
+        as_error(as, "%s", "expected a symbol name");
+        return -1;
+    }
+    int s = sym_lookup(as, c->p, n);
+    c->p += n;
+    return s;
+}
+
+static void define_label(as_t *as, int s)
+{
+    as_sym_t *sym = SYM(as, s);
+    if (sym->pass == as->pass) {
+        as_error(as, "symbol '%s' is already defined", sym->name);
+        return;
+    }
+    sym->pass = as->pass;
+    sym->section = as->section;
+    sym->value = cur_sec(as)->size;
+}
+
+/* .byte, .short, .long and .quad with SIZE bytes per value */
+static void dir_data(as_t *as, cursor_t *c, int size)
+{
+    do {
+        asm_expr_t e;
+        if (!parse_expr(as, c, &e))
+            return;
+        if (e.sym >= 0) {
+            if (cur_sec(as)->type == ASM_SHT_NOBITS) {
+                as_error(as, "%s", "relocation in a section without contents");
+                return;
+            }
+            if (size < 4 || (size == 8 && !as->x64)) {
+                as_error(as, "%s", "unsupported relocation size");
+                return;
+            }
+            as_fixup_t fx = { as->section, cur_sec(as)->size, 0, size, 0, 0,
+                              0, e };
+            push_or_exit(&as->fixups, &fx);
+            e.value = 0;
+        }
+        unsigned char buf[8];
+        for (int i = 0; i < size; i++)
+            buf[i] = (unsigned char)((unsigned long long)e.value >> (8 * i));
+        emit_bytes(as, buf, (size_t)size);
+    } while (accept(c, ','));
+}
+
+static int hex_digit(char ch)
+{
+    if (isdigit((unsigned char)ch))
+        return ch - '0';
+    return tolower((unsigned char)ch) - 'a' + 10;
+}
+
+/* .ascii and .asciz; TERMINATE appends a NUL to every string */
+static void dir_string(as_t *as, cursor_t *c, int terminate)
+{
+    do {
+        if (!accept(c, '"')) {
+            as_error(as, "%s", "expected a string");
+            return;
+        }
+        for (;;) {
+            if (c->p >= c->end) {
+                as_error(as, "%s", "unterminated string");
+                return;
+            }
+            unsigned char ch = (unsigned char)*c->p++;
+            if (ch == '"')
+                break;
+            if (ch == '\\' && c->p < c->end) {
+                ch = (unsigned char)*c->p++;
+                switch (ch) {
+                case 'n': ch = '\n'; break;
+                case 't': ch = '\t'; break;
+                case 'r': ch = '\r'; break;
+                case 'b': ch = '\b'; break;
+                case 'f': ch = '\f'; break;
+                case 'v': ch = '\v'; break;
+                case 'a': ch = '\a'; break;
+                case 'x': {
+                    unsigned v = 0;
+                    while (c->p < c->end && isxdigit((unsigned char)*c->p))
+                        v = v * 16 + (unsigned)hex_digit(*c->p++);
+                    ch = (unsigned char)v;
+                    break;
+                }
+                default:
+                    if (ch >= '0' && ch <= '7') {
+                        unsigned v = (unsigned)(ch - '0');
+                        for (int i = 0; i < 2 && c->p < c->end &&
+                                        *c->p >= '0' && *c->p <= '7'; i++)
+                            v = v * 8 + (unsigned)(*c->p++ - '0');
+                        ch = (unsigned char)v;
+                    }
+                    break;
+                }
+            }
+            emit_bytes(as, &ch, 1);
+        }
+        if (terminate)
+            emit_bytes(as, NULL, 1);
+    } while (accept(c, ','));
+}
+
+/* .section NAME[, "FLAGS"[, @TYPE]] */
+static void dir_section(as_t *as, cursor_t *c)
+{
+    skip_ws(c);
+    const char *name = c->p;
+    while (c->p < c->end && *c->p != ',' && *c->p != ' ' && *c->p != '\t')
+        c->p++;
+    size_t n = (size_t)(c->p - name);
+    if (!n) {
+        as_error(as, "%s", "expected a section name");
+        return;
+    }
+    unsigned type = ASM_SHT_PROGBITS;
+    unsigned flags = 0;
+    if (n >= 5 && strncmp(name, ".text", 5) == 0)
+        flags = ASM_SHF_ALLOC | ASM_SHF_EXECINSTR;
+    else if (n >= 5 && strncmp(name, ".data", 5) == 0)
+        flags = ASM_SHF_ALLOC | ASM_SHF_WRITE;
+    else if (n >= 7 && strncmp(name, ".rodata", 7) == 0)
+        flags = ASM_SHF_ALLOC;
+    else if (n >= 4 && strncmp(name, ".bss", 4) == 0) {
+        flags = ASM_SHF_ALLOC | ASM_SHF_WRITE;
+        type = ASM_SHT_NOBITS;
+    }
+    if (accept(c, ',')) {
+        if (!accept(c, '"')) {
+            as_error(as, "%s", "expected section flags");
+            return;
+        }
+        flags = 0;
+        while (c->p < c->end && *c->p != '"') {
+            switch (*c->p++) {
+            case 'a': flags |= ASM_SHF_ALLOC; break;
+            case 'w': flags |= ASM_SHF_WRITE; break;
+            case 'x': flags |= ASM_SHF_EXECINSTR; break;
+            default:
+                as_error(as, "%s", "unsupported section flag");
+                return;
+            }
+        }
+        if (!accept(c, '"')) {
+            as_error(as, "%s", "unterminated section flags");
+            return;
+        }
+        if (accept(c, ',')) {
+            if (!accept(c, '@')) {
+                as_error(as, "%s", "expected a section type");
+                return;
+            }
+            size_t t = ident_len(c);
+            if (name_eq(c->p, t, "progbits"))
+                type = ASM_SHT_PROGBITS;
+            else if (name_eq(c->p, t, "nobits"))
+                type = ASM_SHT_NOBITS;
+            else {
+                as_error(as, "%s", "unsupported section type");
+                return;
+            }
+            c->p += t;
+        }
+    }
+    set_section(as, name, n, type, flags);
+}
+
+/* .lcomm NAME, SIZE[, ALIGN] reserves zeroed storage in .bss */
+static void dir_lcomm(as_t *as, cursor_t *c)
+{
+    int s = parse_sym(as, c);
+    long long size, align = 0;
+    if (s < 0)
+        return;
+    if (!accept(c, ',') || !parse_number(as, c, &size) || size < 0) {
+        as_error(as, "%s", "expected a size");
+        return;
+    }
+    if (accept(c, ',') && !parse_number(as, c, &align))
+        return;
+    if (!align)
+        align = size >= 8 ? 8 : size >= 4 ? 4 : size >= 2 ? 2 : 1;
+    int saved = as->section;
+    set_section(as, ".bss", 4, ASM_SHT_NOBITS,
+                ASM_SHF_ALLOC | ASM_SHF_WRITE);
+    align_section(as, (size_t)align);
+    define_label(as, s);
+    SYM(as, s)->size = (size_t)size;
+    SYM(as, s)->type = ASM_STT_OBJECT;
+    emit_bytes(as, NULL, (size_t)size);
+    as->section = saved;
+}
+
+static void dir_type(as_t *as, cursor_t *c)
+{
+    int s = parse_sym(as, c);
+    if (s < 0)
+        return;
+    if (!accept(c, ',') || !(accept(c, '@') || accept(c, '%'))) {
+        as_error(as, "%s", "expected a symbol type");
+        return;
+    }
+    size_t n = ident_len(c);
+    if (name_eq(c->p, n, "function"))
+        SYM(as, s)->type = ASM_STT_FUNC;
+    else if (name_eq(c->p, n, "object"))
+        SYM(as, s)->type = ASM_STT_OBJECT;
+    else if (name_eq(c->p, n, "notype"))
+        SYM(as, s)->type = ASM_STT_NOTYPE;
+    else {
+        as_error(as, "%s", "unsupported symbol type");
+        return;
+    }
+    c->p += n;
+}
+
+static void directive(as_t *as, cursor_t *c)
+{
+    const char *d = c->p;
+    size_t n = ident_len(c);
+    c->p += n;
+    if (name_eq(d, n, ".text")) {
+        set_section(as, d, n, ASM_SHT_PROGBITS,
+                    ASM_SHF_ALLOC | ASM_SHF_EXECINSTR);
+    } else if (name_eq(d, n, ".data")) {
+        set_section(as, d, n, ASM_SHT_PROGBITS,
+                    ASM_SHF_ALLOC | ASM_SHF_WRITE);
+    } else if (name_eq(d, n, ".bss")) {
+        set_section(as, d, n, ASM_SHT_NOBITS,
+                    ASM_SHF_ALLOC | ASM_SHF_WRITE);
+    } else if (name_eq(d, n, ".section")) {
+        dir_section(as, c);
+    } else if (name_eq(d, n, ".globl") || name_eq(d, n, ".global") ||
+               name_eq(d, n, ".local")) {
+        do {
+            int s = parse_sym(as, c);
+            if (s < 0)
+                return;
+            SYM(as, s)->global = d[1] == 'g';
+        } while (accept(c, ','));
+    } else if (name_eq(d, n, ".type")) {
+        dir_type(as, c);
+    } else if (name_eq(d, n, ".size")) {
+        int s = parse_sym(as, c);
+        long long size;
+        if (s < 0)
+            return;
+        if (!accept(c, ',') || !parse_number(as, c, &size))
+            return;
+        SYM(as, s)->size = (size_t)size;
+    } else if (name_eq(d, n, ".align") || name_eq(d, n, ".balign") ||
+               name_eq(d, n, ".p2align")) {
+        long long align;
+        if (!parse_number(as, c, &align))
+            return;
+        if (d[1] == 'p')
+            align = align >= 0 && align < 32 ? 1LL << align : -1;
+        if (align <= 0) {
+            as_error(as, "%s", "invalid alignment");
+            return;
+        }
+        align_section(as, (size_t)align);
+    } else if (name_eq(d, n, ".byte")) {
+        dir_data(as, c, 1);
+    } else if (name_eq(d, n, ".short") || name_eq(d, n, ".word") ||
+               name_eq(d, n, ".value")) {
+        dir_data(as, c, 2);
+    } else if (name_eq(d, n, ".long") || name_eq(d, n, ".int")) {
+        dir_data(as, c, 4);
+    } else if (name_eq(d, n, ".quad")) {
+        dir_data(as, c, 8);
+    } else if (name_eq(d, n, ".zero") || name_eq(d, n, ".skip") ||
+               name_eq(d, n, ".space")) {
+        long long size, fill = 0;
+        if (!parse_number(as, c, &size))
+            return;
+        if (accept(c, ',') && !parse_number(as, c, &fill))
+            return;
+        if (size < 0) {
+            as_error(as, "%s", "negative size");
+            return;
+        }
+        emit_fill(as, (size_t)size, (unsigned char)fill);
+    } else if (name_eq(d, n, ".ascii")) {
+        dir_string(as, c, 0);
+    } else if (name_eq(d, n, ".asciz") || name_eq(d, n, ".string")) {
+        dir_string(as, c, 1);
+    } else if (name_eq(d, n, ".lcomm")) {
+        dir_lcomm(as, c);
+    } else {
+        as_error(as, "unsupported directive '%s'", intern_text(d, n));
+        return;
+    }
+    if (!as->error && !at_end(c))
+        as_error(as, "%s", "junk after directive");
+}
+
+/* Length of the line at P without its comment */
+static size_t strip_comment(const char *p, size_t len)
+{
+    int quoted = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (quoted) {
+            if (p[i] == '\\')
+                i++;
+            else if (p[i] == '"')
+                quoted = 0;
+        } else if (p[i] == '"') {
+            quoted = 1;
+        } else if (p[i] == '#') {
+            return i;
+        }
+    }
+    return len;
+}
+
+static void assemble_line(as_t *as, const char *p, size_t len)
+{
+    cursor_t c = { p, p + strip_comment(p, len) };
+    for (;;) {
+        skip_ws(&c);
+        size_t n = ident_len(&c);
+        const char *q = c.p + n;
+        while (q < c.end && (*q == ' ' || *q == '\t'))
+            q++;
+        if (!n || q >= c.end || *q != ':')
+            break;
+        define_label(as, sym_lookup(as, c.p, n));
+        c.p = q + 1;
+    }
+    if (at_end(&c))
+        return;
+    if (*c.p == '.')
+        directive(as, &c);
+    else
+        assemble_insn(as, &c);
+}
+
+/* Assemble the whole text once; returns 1 when a jump had to grow */
+static int run_pass(as_t *as, const char *text, size_t len)
+{
+    as->pass++;
+    as->jump_count = 0;
+    as->fixups.count = 0;
+    as->jumps.count = 0;
+    for (size_t i = 0; i < as->obj->sections.count; i++)
+        ASM_SECTION(as->obj, i)->size = 0;
+    set_section(as, ".text", 5, ASM_SHT_PROGBITS,
+                ASM_SHF_ALLOC | ASM_SHF_EXECINSTR);
+    as->line = 0;
+
+    const char *p = text;
+    const char *end = text + len;
+    while (p < end && !as->error) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t n = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        as->line++;
+        as->line_text = p;
+        as->line_len = n;
+        assemble_line(as, p, n);
+        p += n + (nl != NULL);
+    }
+    if (as->error)
+        return 0;
+
+    int grew = 0;
+    const as_jump_t *jumps = as->jumps.data;
+    for (size_t i = 0; i < as->jumps.count; i++) {
+        const as_jump_t *j = &jumps[i];
+        const as_sym_t *t = SYM(as, j->target.sym);
+        long long disp = (long long)t->value + j->target.value -
+                         (long long)j->end;
+        if (t->section != j->section || t->global || disp < -128 ||
+            disp > 127) {
+            ((unsigned char *)as->jump_long.data)[j->index] = 1;
+            grew = 1;
+        }
+    }
+    return grew;
+}
+
+/* Write the value or relocation of every recorded fixup */
+static void resolve_fixups(as_t *as, const int *map)
+{
+    const as_fixup_t *fx = as->fixups.data;
+    const as_jump_t *jumps = as->jumps.data;
+    for (size_t i = 0; i < as->jumps.count; i++) {
+        const as_jump_t *j = &jumps[i];
+        const as_sym_t *t = SYM(as, j->target.sym);
+        long long disp = (long long)t->value + j->target.value -
+                         (long long)j->end;
+        ASM_SECTION(as->obj, j->section)->data[j->end - 1] =
+            (unsigned char)disp;
+    }
+    for (size_t i = 0; i < as->fixups.count; i++) {
+        const as_fixup_t *f = &fx[i];
+        const as_sym_t *sym = SYM(as, f->expr.sym);
+        asm_section_t *sec = ASM_SECTION(as->obj, f->section);
+        long long addend = f->expr.value;
+        if (f->pcrel)
+            addend -= (long long)(f->end - f->offset);
+        if (f->pcrel && sym->section == f->section && !sym->global) {
+            long long v = (long long)sym->value + addend - (long long)f->offset;
+            for (int b = 0; b < f->size; b++)
+                sec->data[f->offset + (size_t)b] =
+                    (unsigned char)((unsigned long long)v >> (8 * b));
+            continue;
+        }
+        asm_reloc_t r;
+        r.offset = f->offset;
+        if (f->pcrel)
+            r.kind = f->branch && (sym->section < 0 ||
+                                   sym->type == ASM_STT_FUNC)
+                         ? ASM_RELOC_PLT32 : ASM_RELOC_PC32;
+        else if (f->size == 8)
+            r.kind = ASM_RELOC_ABS64;
+        else
+            r.kind = f->sign ? ASM_RELOC_ABS32S : ASM_RELOC_ABS32;
+        if (sym->section >= 0 && !sym->global) {
+            r.symbol = -1;
+            r.section = sym->section;
+            addend += (long long)sym->value;
+        } else {
+            r.symbol = map[f->expr.sym];
+            r.section = -1;
+        }
+        r.addend = addend;
+        if (!as->x64)
+            for (int b = 0; b < f->size; b++)
+                sec->data[f->offset + (size_t)b] =
+                    (unsigned char)((unsigned long long)addend >> (8 * b));
+        push_or_exit(&sec->relocs, &r);
+    }
+}
+
+int asm_x86_assemble_object(const char *text, size_t len, int x64,
+                            asm_object_t *obj)
+{
+    as_t as;
+    memset(&as, 0, sizeof(as));
+    as.obj = obj;
+    as.x64 = x64;
+    vector_init(&as.syms, sizeof(as_sym_t));
+    vector_init(&as.fixups, sizeof(as_fixup_t));
+    vector_init(&as.jump_long, 1);
+    vector_init(&as.jumps, sizeof(as_jump_t));
+
+    while (run_pass(&as, text, len))
+        ;
+
+    int *map = NULL;
+    if (!as.error) {
+        map = vc_alloc_or_exit((as.syms.count + 1) * sizeof(*map));
+        for (size_t i = 0; i < as.syms.count; i++) {
+            const as_sym_t *s = SYM(&as, i);
+            map[i] = -1;
+            if (s->section >= 0 && strncmp(s->name, ".L", 2) == 0)
+                continue;
+            asm_symbol_t out = { s->name, s->section, s->value, s->size,
+                                 s->global, s->type };
+            push_or_exit(&obj->symbols, &out);
+            map[i] = (int)obj->symbols.count - 1;
+        }
+        resolve_fixups(&as, map);
+    }
+
+    free(map);
+    free(as.slots);
+    vector_free(&as.syms);
+    vector_free(&as.fixups);
+    vector_free(&as.jump_long);
+    vector_free(&as.jumps);
+    return !as.error;
+}
+
+int asm_x86_assemble(const char *text, size_t len, int x64,
+                     const char *output)
+{
+    asm_object_t obj;
+    asm_object_init(&obj);
+    int ok = asm_x86_assemble_object(text, len, x64, &obj) &&
+             asm_elf_write(&obj, x64, output);
+    asm_object_free(&obj);
+    return ok;
+}
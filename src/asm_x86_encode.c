@@ -0,0 +1,1150 @@
+/*
+ * Instruction encoder of the integrated assembler.
+ *
+ * Each mnemonic is mapped to an encoding plan: prefixes, opcode bytes,
+ * a ModRM operand or a register folded into the opcode and an optional
+ * immediate.  emit_plan() turns the plan into bytes and records the
+ * fields that refer to symbols as fixups for the caller to resolve.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "asm_x86.h"
+
+typedef struct {
+    int p66;                /* operand size prefix */
+    int rep;                /* mandatory 0xf2 or 0xf3 prefix, 0 if none */
+    int rexw;
+    unsigned char op[3];
+    int oplen;
+    int opreg;              /* register added to the last opcode byte or -1 */
+    int modrm;              /* a ModRM byte follows the opcode */
+    int reg;                /* ModRM.reg: register or opcode extension */
+    const asm_operand_t *rm;
+    int imm_size;           /* 0, 1, 2, 4 or 8 */
+    asm_expr_t imm;
+    int imm_pcrel;
+    int imm_branch;
+    int imm_sign;
+} plan_t;
+
+typedef struct {
+    const asm_insn_t *ins;
+    int x64;
+    asm_code_t *code;
+    char *err;
+    size_t errlen;
+} enc_t;
+
+/* Condition codes in the order of their encodings, aliases included */
+static const struct {
+    const char *name;
+    int code;
+} cond_codes[] = {
+    {"o", 0}, {"no", 1}, {"b", 2}, {"c", 2}, {"nae", 2}, {"ae", 3},
+    {"nb", 3}, {"nc", 3}, {"e", 4}, {"z", 4}, {"ne", 5}, {"nz", 5},
+    {"be", 6}, {"na", 6}, {"a", 7}, {"nbe", 7}, {"s", 8}, {"ns", 9},
+    {"p", 10}, {"pe", 10}, {"np", 11}, {"po", 11}, {"l", 12}, {"nge", 12},
+    {"ge", 13}, {"nl", 13}, {"le", 14}, {"ng", 14}, {"g", 15}, {"nle", 15}
+};
+
+/* Mnemonics without operands */
+static const struct {
+    const char *name;
+    unsigned char bytes[3];
+    int len;
+} plain_ops[] = {
+    {"ret", {0xc3}, 1}, {"leave", {0xc9}, 1}, {"nop", {0x90}, 1},
+    {"hlt", {0xf4}, 1}, {"cltd", {0x99}, 1}, {"cwtl", {0x98}, 1},
+    {"cltq", {0x48, 0x98}, 2}, {"cqto", {0x48, 0x99}, 2},
+    {"cbtw", {0x66, 0x98}, 2}, {"cwtd", {0x66, 0x99}, 2},
+    {"syscall", {0x0f, 0x05}, 2}, {"ud2", {0x0f, 0x0b}, 2},
+    {"faddp", {0xde, 0xc1}, 2}, {"fsubp", {0xde, 0xe1}, 2},
+    {"fmulp", {0xde, 0xc9}, 2}, {"fdivp", {0xde, 0xf1}, 2},
+    {"fsubrp", {0xde, 0xe9}, 2}, {"fdivrp", {0xde, 0xf9}, 2},
+    {"fchs", {0xd9, 0xe0}, 2}, {"fld1", {0xd9, 0xe8}, 2},
+    {"fldz", {0xd9, 0xee}, 2}, {"fxch", {0xd9, 0xc9}, 2}
+};
+
+/* x87 loads and stores of memory: opcode and ModRM extension */
+static const struct {
+    const char *name;
+    unsigned char op;
+    int ext;
+} x87_mem_ops[] = {
+    {"flds", 0xd9, 0}, {"fldl", 0xdd, 0}, {"fldt", 0xdb, 5},
+    {"fsts", 0xd9, 2}, {"fstl", 0xdd, 2},
+    {"fstps", 0xd9, 3}, {"fstpl", 0xdd, 3}, {"fstpt", 0xdb, 7},
+    {"filds", 0xdf, 0}, {"fildl", 0xdb, 0}, {"fildll", 0xdf, 5},
+    {"fildq", 0xdf, 5}, {"fistps", 0xdf, 3}, {"fistpl", 0xdb, 3},
+    {"fistpll", 0xdf, 7}, {"fistpq", 0xdf, 7}
+};
+
+/* SSE instructions of the form op xmm/mem, xmm */
+static const struct {
+    const char *name;
+    int prefix;             /* 0x66, 0xf2, 0xf3 or 0 */
+    unsigned char op;
+} sse_ops[] = {
+    {"addss", 0xf3, 0x58}, {"subss", 0xf3, 0x5c}, {"mulss", 0xf3, 0x59},
+    {"divss", 0xf3, 0x5e}, {"sqrtss", 0xf3, 0x51}, {"minss", 0xf3, 0x5d},
+    {"maxss", 0xf3, 0x5f}, {"addsd", 0xf2, 0x58}, {"subsd", 0xf2, 0x5c},
+    {"mulsd", 0xf2, 0x59}, {"divsd", 0xf2, 0x5e}, {"sqrtsd", 0xf2, 0x51},
+    {"minsd", 0xf2, 0x5d}, {"maxsd", 0xf2, 0x5f},
+    {"cvtss2sd", 0xf3, 0x5a}, {"cvtsd2ss", 0xf2, 0x5a},
+    {"ucomiss", 0, 0x2e}, {"ucomisd", 0x66, 0x2e},
+    {"comiss", 0, 0x2f}, {"comisd", 0x66, 0x2f},
+    {"andps", 0, 0x54}, {"andpd", 0x66, 0x54},
+    {"xorps", 0, 0x57}, {"xorpd", 0x66, 0x57}, {"pxor", 0x66, 0xef}
+};
+
+/* SSE moves: load opcode, store opcode */
+static const struct {
+    const char *name;
+    int prefix;
+    unsigned char load;
+    unsigned char store;
+} sse_moves[] = {
+    {"movss", 0xf3, 0x10, 0x11}, {"movsd", 0xf2, 0x10, 0x11},
+    {"movups", 0, 0x10, 0x11}, {"movupd", 0x66, 0x10, 0x11},
+    {"movaps", 0, 0x28, 0x29}, {"movapd", 0x66, 0x28, 0x29},
+    {"movdqu", 0xf3, 0x6f, 0x7f}, {"movdqa", 0x66, 0x6f, 0x7f}
+};
+
+/* Integer operations taking a suffix: ALU group, unary group and shifts */
+static const char *const alu_names[] = {
+    "add", "or", "adc", "sbb", "and", "sub", "xor", "cmp"
+};
+
+static const struct {
+    const char *name;
+    int ext;
+} unary_ops[] = {
+    {"inc", 0}, {"dec", 1}, {"not", 2}, {"neg", 3},
+    {"mul", 4}, {"div", 6}, {"idiv", 7}
+};
+
+static const struct {
+    const char *name;
+    int ext;
+} shift_ops[] = {
+    {"rol", 0}, {"ror", 1}, {"rcl", 2}, {"rcr", 3},
+    {"shl", 4}, {"sal", 4}, {"shr", 5}, {"sar", 7}
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static int fail(enc_t *e, const char *msg)
+{
+    snprintf(e->err, e->errlen, "%s", msg);
+    return 0;
+}
+
+static void plan_init(plan_t *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->opreg = -1;
+}
+
+static void plan_op(plan_t *p, int b)
+{
+    p->op[p->oplen++] = (unsigned char)b;
+}
+
+static void put_bytes(asm_code_t *code, unsigned long long v, int size)
+{
+    for (int i = 0; i < size; i++)
+        code->bytes[code->len++] = (unsigned char)(v >> (8 * i));
+}
+
+static void add_fixup(asm_code_t *code, int size, asm_expr_t expr,
+                      int pcrel, int branch, int sign)
+{
+    asm_fixup_t *f = &code->fixups[code->nfixups++];
+    f->offset = code->len;
+    f->size = size;
+    f->pcrel = pcrel;
+    f->branch = branch;
+    f->sign = sign;
+    f->expr = expr;
+}
+
+static int fits8(long long v)
+{
+    return v >= -128 && v <= 127;
+}
+
+static int fits32(long long v)
+{
+    return v >= -2147483648LL && v <= 4294967295LL;
+}
+
+/* Truncate V to SIZE bytes and sign extend the result */
+static long long narrow(long long v, int size)
+{
+    switch (size) {
+    case 1: return (signed char)(unsigned char)v;
+    case 2: return (short)(unsigned short)v;
+    case 4: return (int)(unsigned)v;
+    default: return v;
+    }
+}
+
+static int is_reg(const asm_operand_t *op, int reg)
+{
+    return op->kind == ASM_OP_REG && op->reg == reg;
+}
+
+/* Memory operand without registers, an absolute address */
+static int is_abs(const asm_operand_t *op)
+{
+    return op->kind == ASM_OP_MEM && op->base < 0 && op->index < 0 &&
+           !op->rip;
+}
+
+static int scale_bits(int scale)
+{
+    switch (scale) {
+    case 2: return 1;
+    case 4: return 2;
+    case 8: return 3;
+    default: return 0;
+    }
+}
+
+/* Write the ModRM byte, SIB byte and displacement of P */
+static int emit_modrm(enc_t *e, const plan_t *p)
+{
+    asm_code_t *code = e->code;
+    const asm_operand_t *rm = p->rm;
+    int reg = (p->reg & 7) << 3;
+    if (rm->kind == ASM_OP_REG || rm->kind == ASM_OP_XMM) {
+        put_bytes(code, (unsigned)(0xc0 | reg | (rm->reg & 7)), 1);
+        return 1;
+    }
+    const asm_expr_t *d = &rm->expr;
+    if (!fits32(d->value) || (e->x64 && d->value > 2147483647LL && !rm->rip))
+        return fail(e, "displacement out of range");
+    if (rm->rip) {
+        put_bytes(code, (unsigned)(reg | 5), 1);
+        if (d->sym >= 0)
+            add_fixup(code, 4, *d, 1, 0, 0);
+        put_bytes(code, d->sym >= 0 ? 0 : (unsigned long long)d->value, 4);
+        return 1;
+    }
+    int mod;
+    if (rm->base < 0) {
+        mod = 0;
+    } else if (d->sym >= 0) {
+        mod = 2;
+    } else if (d->value == 0 && (rm->base & 7) != 5) {
+        mod = 0;
+    } else if (fits8(d->value)) {
+        mod = 1;
+    } else {
+        mod = 2;
+    }
+    if (rm->base < 0 && rm->index < 0 && !e->x64) {
+        put_bytes(code, (unsigned)(reg | 5), 1);
+    } else if (rm->index >= 0 || rm->base < 0 || (rm->base & 7) == 4) {
+        int index = rm->index >= 0 ? rm->index & 7 : 4;
+        int base = rm->base >= 0 ? rm->base & 7 : 5;
+        put_bytes(code, (unsigned)((mod << 6) | reg | 4), 1);
+        put_bytes(code, (unsigned)((scale_bits(rm->scale) << 6) |
+                                   (index << 3) | base), 1);
+    } else {
+        put_bytes(code, (unsigned)((mod << 6) | reg | (rm->base & 7)), 1);
+    }
+    if (mod == 1) {
+        put_bytes(code, (unsigned long long)d->value, 1);
+    } else if (mod == 2 || rm->base < 0) {
+        if (d->sym >= 0) {
+            add_fixup(code, 4, *d, 0, 0, e->x64);
+            put_bytes(code, 0, 4);
+        } else {
+            put_bytes(code, (unsigned long long)d->value, 4);
+        }
+    }
+    return 1;
+}
+
+/* Encode plan P with its prefixes, REX byte, opcode and operands */
+static int emit_plan(enc_t *e, const plan_t *p)
+{
+    asm_code_t *code = e->code;
+    const asm_insn_t *ins = e->ins;
+    int rex = p->rexw ? 8 : 0;
+    int force_rex = 0;
+    if (p->modrm) {
+        const asm_operand_t *rm = p->rm;
+        if (p->reg >= 8)
+            rex |= 4;
+        if (rm->kind == ASM_OP_MEM) {
+            if (rm->index >= 8)
+                rex |= 2;
+            if (rm->base >= 8)
+                rex |= 1;
+        } else if (rm->reg >= 8) {
+            rex |= 1;
+        }
+    }
+    if (p->opreg >= 8)
+        rex |= 1;
+    for (int i = 0; i < ins->nops; i++)
+        if (ins->ops[i].rex_byte)
+            force_rex = 1;
+    if ((rex || force_rex) && !e->x64)
+        return fail(e, "instruction requires 64-bit mode");
+    int addr32 = 0;
+    if (p->modrm && p->rm->kind == ASM_OP_MEM && p->rm->addr32)
+        addr32 = 1;
+
+    code->len = 0;
+    code->nfixups = 0;
+    if (addr32)
+        put_bytes(code, 0x67, 1);
+    if (p->p66)
+        put_bytes(code, 0x66, 1);
+    if (p->rep)
+        put_bytes(code, (unsigned)p->rep, 1);
+    if (rex || force_rex)
+        put_bytes(code, (unsigned)(0x40 | rex), 1);
+    for (int i = 0; i < p->oplen; i++) {
+        unsigned b = p->op[i];
+        if (i == p->oplen - 1 && p->opreg >= 0)
+            b += (unsigned)(p->opreg & 7);
+        put_bytes(code, b, 1);
+    }
+    if (p->modrm && !emit_modrm(e, p))
+        return 0;
+    if (p->imm_size) {
+        if (p->imm.sym >= 0) {
+            add_fixup(code, p->imm_size, p->imm, p->imm_pcrel,
+                      p->imm_branch, p->imm_sign);
+            put_bytes(code, 0, p->imm_size);
+        } else {
+            put_bytes(code, (unsigned long long)p->imm.value, p->imm_size);
+        }
+    }
+    return 1;
+}
+
+/* Size in bytes of a suffix letter or 0 */
+static int suffix_size(char c)
+{
+    switch (c) {
+    case 'b': return 1;
+    case 'w': return 2;
+    case 'l': return 4;
+    case 'q': return 8;
+    default: return 0;
+    }
+}
+
+/*
+ * Operand size of an integer instruction: the suffix when present,
+ * otherwise the width of its register operands.
+ */
+static int operand_size(enc_t *e, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    int size = suffix;
+    for (int i = 0; i < ins->nops; i++) {
+        const asm_operand_t *op = &ins->ops[i];
+        if (op->kind != ASM_OP_REG)
+            continue;
+        if (!size)
+            size = op->size;
+        else if (op->size != size)
+            return fail(e, "operand size mismatch");
+    }
+    if (!size)
+        return fail(e, "operand size not specified");
+    if (size == 8 && !e->x64)
+        return fail(e, "64-bit operand in 32-bit mode");
+    return size;
+}
+
+/* Set the operand size fields of P for SIZE */
+static void plan_size(plan_t *p, int size)
+{
+    p->p66 = size == 2;
+    p->rexw = size == 8;
+}
+
+static void plan_rm(plan_t *p, int reg, const asm_operand_t *rm)
+{
+    p->modrm = 1;
+    p->reg = reg;
+    p->rm = rm;
+}
+
+/* Immediate of SIZE bytes, at most 4 for 64-bit operations */
+static void plan_imm(plan_t *p, const asm_operand_t *op, int size)
+{
+    p->imm_size = size == 8 ? 4 : size;
+    p->imm = op->expr;
+    if (op->expr.sym < 0)
+        p->imm.value = narrow(op->expr.value, p->imm_size);
+    p->imm_sign = size == 8;
+}
+
+static int imm8_form(const asm_operand_t *op, int size)
+{
+    return op->expr.sym < 0 && fits8(narrow(op->expr.value, size == 8 ? 4 : size));
+}
+
+static int enc_alu(enc_t *e, int ext, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 2)
+        return fail(e, "expected two operands");
+    const asm_operand_t *src = &ins->ops[0];
+    const asm_operand_t *dst = &ins->ops[1];
+    int size = operand_size(e, suffix);
+    if (!size)
+        return 0;
+    plan_t p;
+    plan_init(&p);
+    plan_size(&p, size);
+    if (src->kind == ASM_OP_IMM) {
+        if (dst->kind == ASM_OP_IMM || dst->kind == ASM_OP_XMM)
+            return fail(e, "invalid operands");
+        if (size == 1) {
+            if (is_reg(dst, 0)) {
+                plan_op(&p, ext * 8 + 4);
+            } else {
+                plan_op(&p, 0x80);
+                plan_rm(&p, ext, dst);
+            }
+            plan_imm(&p, src, 1);
+        } else if (imm8_form(src, size)) {
+            plan_op(&p, 0x83);
+            plan_rm(&p, ext, dst);
+            plan_imm(&p, src, 1);
+        } else {
+            if (is_reg(dst, 0)) {
+                plan_op(&p, ext * 8 + 5);
+            } else {
+                plan_op(&p, 0x81);
+                plan_rm(&p, ext, dst);
+            }
+            plan_imm(&p, src, size);
+        }
+    } else if (src->kind == ASM_OP_REG &&
+               (dst->kind == ASM_OP_REG || dst->kind == ASM_OP_MEM)) {
+        plan_op(&p, ext * 8 + (size == 1 ? 0 : 1));
+        plan_rm(&p, src->reg, dst);
+    } else if (src->kind == ASM_OP_MEM && dst->kind == ASM_OP_REG) {
+        plan_op(&p, ext * 8 + (size == 1 ? 2 : 3));
+        plan_rm(&p, dst->reg, src);
+    } else {
+        return fail(e, "invalid operands");
+    }
+    return emit_plan(e, &p);
+}
+
+static int enc_test(enc_t *e, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 2)
+        return fail(e, "expected two operands");
+    const asm_operand_t *src = &ins->ops[0];
+    const asm_operand_t *dst = &ins->ops[1];
+    int size = operand_size(e, suffix);
+    if (!size)
+        return 0;
+    plan_t p;
+    plan_init(&p);
+    plan_size(&p, size);
+    if (src->kind == ASM_OP_IMM) {
+        if (is_reg(dst, 0)) {
+            plan_op(&p, size == 1 ? 0xa8 : 0xa9);
+        } else {
+            plan_op(&p, size == 1 ? 0xf6 : 0xf7);
+            plan_rm(&p, 0, dst);
+        }
+        plan_imm(&p, src, size);
+    } else if (src->kind == ASM_OP_REG && dst->kind != ASM_OP_IMM) {
+        plan_op(&p, size == 1 ? 0x84 : 0x85);
+        plan_rm(&p, src->reg, dst);
+    } else if (src->kind == ASM_OP_MEM && dst->kind == ASM_OP_REG) {
+        plan_op(&p, size == 1 ? 0x84 : 0x85);
+        plan_rm(&p, dst->reg, src);
+    } else {
+        return fail(e, "invalid operands");
+    }
+    return emit_plan(e, &p);
+}
+
+static int enc_mov(enc_t *e, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 2)
+        return fail(e, "expected two operands");
+    const asm_operand_t *src = &ins->ops[0];
+    const asm_operand_t *dst = &ins->ops[1];
+    int size = operand_size(e, suffix);
+    if (!size)
+        return 0;
+    plan_t p;
+    plan_init(&p);
+    plan_size(&p, size);
+    if (src->kind == ASM_OP_IMM && dst->kind == ASM_OP_REG) {
+        if (size == 8 && src->expr.sym < 0 &&
+            narrow(src->expr.value, 4) != src->expr.value) {
+            plan_op(&p, 0xb8);
+            p.opreg = dst->reg;
+            p.imm_size = 8;
+            p.imm = src->expr;
+        } else if (size == 8) {
+            plan_op(&p, 0xc7);
+            plan_rm(&p, 0, dst);
+            plan_imm(&p, src, 8);
+        } else {
+            plan_op(&p, size == 1 ? 0xb0 : 0xb8);
+            p.opreg = dst->reg;
+            plan_imm(&p, src, size);
+        }
+    } else if (src->kind == ASM_OP_IMM && dst->kind == ASM_OP_MEM) {
+        plan_op(&p, size == 1 ? 0xc6 : 0xc7);
+        plan_rm(&p, 0, dst);
+        plan_imm(&p, src, size);
+    } else if (src->kind == ASM_OP_REG && dst->kind != ASM_OP_IMM &&
+               dst->kind != ASM_OP_XMM) {
+        if (!e->x64 && src->reg == 0 && is_abs(dst)) {
+            plan_op(&p, size == 1 ? 0xa2 : 0xa3);
+            p.imm_size = 4;
+            p.imm = dst->expr;
+        } else {
+            plan_op(&p, size == 1 ? 0x88 : 0x89);
+            plan_rm(&p, src->reg, dst);
+        }
+    } else if (src->kind == ASM_OP_MEM && dst->kind == ASM_OP_REG) {
+        if (!e->x64 && dst->reg == 0 && is_abs(src)) {
+            plan_op(&p, size == 1 ? 0xa0 : 0xa1);
+            p.imm_size = 4;
+            p.imm = src->expr;
+        } else {
+            plan_op(&p, size == 1 ? 0x8a : 0x8b);
+            plan_rm(&p, dst->reg, src);
+        }
+    } else {
+        return fail(e, "invalid operands");
+    }
+    return emit_plan(e, &p);
+}
+
+static int enc_movabs(enc_t *e)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 2 || ins->ops[0].kind != ASM_OP_IMM ||
+        ins->ops[1].kind != ASM_OP_REG || ins->ops[1].size != 8 || !e->x64)
+        return fail(e, "invalid operands");
+    plan_t p;
+    plan_init(&p);
+    p.rexw = 1;
+    plan_op(&p, 0xb8);
+    p.opreg = ins->ops[1].reg;
+    p.imm_size = 8;
+    p.imm = ins->ops[0].expr;
+    return emit_plan(e, &p);
+}
+
+/*
+ * movz and movs extensions.  FROM is the source width, TO the width
+ * named by the suffix or 0 to take it from the destination register.
+ */
+static int enc_extend(enc_t *e, int sign, int from, int to)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 2 || ins->ops[1].kind != ASM_OP_REG ||
+        (ins->ops[0].kind != ASM_OP_REG && ins->ops[0].kind != ASM_OP_MEM))
+        return fail(e, "invalid operands");
+    const asm_operand_t *src = &ins->ops[0];
+    const asm_operand_t *dst = &ins->ops[1];
+    if (!to)
+        to = dst->size;
+    if (dst->size != to || (src->kind == ASM_OP_REG && src->size != from) ||
+        to <= from)
+        return fail(e, "operand size mismatch");
+    if (to == 8 && !e->x64)
+        return fail(e, "64-bit operand in 32-bit mode");
+    plan_t p;
+    plan_init(&p);
+    plan_size(&p, to);
+    if (from == 4) {
+        if (!sign)
+            return fail(e, "invalid operands");
+        plan_op(&p, 0x63);
+    } else {
+        plan_op(&p, 0x0f);
+        plan_op(&p, (sign ? 0xbe : 0xb6) + (from == 2));
+    }
+    plan_rm(&p, dst->reg, src);
+    return emit_plan(e, &p);
+}
+
+static int enc_lea(enc_t *e, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 2 || ins->ops[0].kind != ASM_OP_MEM ||
+        ins->ops[1].kind != ASM_OP_REG)
+        return fail(e, "invalid operands");
+    int size = operand_size(e, suffix);
+    if (!size)
+        return 0;
+    plan_t p;
+    plan_init(&p);
+    plan_size(&p, size);
+    plan_op(&p, 0x8d);
+    plan_rm(&p, ins->ops[1].reg, &ins->ops[0]);
+    return emit_plan(e, &p);
+}
+
+/* push and pop use the stack width unless a 16-bit form is requested */
+static int enc_stack(enc_t *e, int push, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 1)
+        return fail(e, "expected one operand");
+    const asm_operand_t *op = &ins->ops[0];
+    int width = e->x64 ? 8 : 4;
+    int size = suffix;
+    if (!size)
+        size = op->kind == ASM_OP_REG ? op->size : width;
+    if (op->kind == ASM_OP_REG && op->size != size)
+        return fail(e, "operand size mismatch");
+    if (size != width && size != 2)
+        return fail(e, "invalid operand size");
+    plan_t p;
+    plan_init(&p);
+    p.p66 = size == 2;
+    if (op->kind == ASM_OP_REG) {
+        plan_op(&p, push ? 0x50 : 0x58);
+        p.opreg = op->reg;
+    } else if (op->kind == ASM_OP_MEM) {
+        plan_op(&p, push ? 0xff : 0x8f);
+        plan_rm(&p, push ? 6 : 0, op);
+    } else if (op->kind == ASM_OP_IMM && push) {
+        if (imm8_form(op, size)) {
+            plan_op(&p, 0x6a);
+            plan_imm(&p, op, 1);
+        } else {
+            plan_op(&p, 0x68);
+            plan_imm(&p, op, size == 2 ? 2 : 4);
+            p.imm_sign = e->x64;
+        }
+    } else {
+        return fail(e, "invalid operands");
+    }
+    return emit_plan(e, &p);
+}
+
+/* inc, dec, not, neg, mul, div and idiv: one r/m operand */
+static int enc_unary(enc_t *e, int ext, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 1 || ins->ops[0].kind == ASM_OP_IMM ||
+        ins->ops[0].kind == ASM_OP_XMM)
+        return fail(e, "invalid operands");
+    int size = operand_size(e, suffix);
+    if (!size)
+        return 0;
+    plan_t p;
+    plan_init(&p);
+    plan_size(&p, size);
+    if (ext <= 1)
+        plan_op(&p, size == 1 ? 0xfe : 0xff);
+    else
+        plan_op(&p, size == 1 ? 0xf6 : 0xf7);
+    plan_rm(&p, ext, &ins->ops[0]);
+    return emit_plan(e, &p);
+}
+
+static int enc_imul(enc_t *e, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops == 1)
+        return enc_unary(e, 5, suffix);
+    int size = operand_size(e, suffix);
+    if (!size)
+        return 0;
+    if (size == 1)
+        return fail(e, "invalid operand size");
+    const asm_operand_t *imm = NULL;
+    const asm_operand_t *src;
+    const asm_operand_t *dst = &ins->ops[ins->nops - 1];
+    if (ins->nops == 3) {
+        imm = &ins->ops[0];
+        src = &ins->ops[1];
+    } else if (ins->ops[0].kind == ASM_OP_IMM) {
+        imm = &ins->ops[0];
+        src = dst;
+    } else {
+        src = &ins->ops[0];
+    }
+    if (dst->kind != ASM_OP_REG || src->kind == ASM_OP_IMM ||
+        src->kind == ASM_OP_XMM || (imm && imm->kind != ASM_OP_IMM))
+        return fail(e, "invalid operands");
+    plan_t p;
+    plan_init(&p);
+    plan_size(&p, size);
+    if (!imm) {
+        plan_op(&p, 0x0f);
+        plan_op(&p, 0xaf);
+    } else if (imm8_form(imm, size)) {
+        plan_op(&p, 0x6b);
+        plan_imm(&p, imm, 1);
+    } else {
+        plan_op(&p, 0x69);
+        plan_imm(&p, imm, size);
+    }
+    plan_rm(&p, dst->reg, src);
+    return emit_plan(e, &p);
+}
+
+static int enc_shift(enc_t *e, int ext, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops < 1 || ins->nops > 2)
+        return fail(e, "invalid operands");
+    const asm_operand_t *dst = &ins->ops[ins->nops - 1];
+    const asm_operand_t *count = ins->nops == 2 ? &ins->ops[0] : NULL;
+    if (dst->kind != ASM_OP_REG && dst->kind != ASM_OP_MEM)
+        return fail(e, "invalid operands");
+    int size = suffix ? suffix : (dst->kind == ASM_OP_REG ? dst->size : 0);
+    if (!size || (dst->kind == ASM_OP_REG && dst->size != size))
+        return fail(e, "operand size mismatch");
+    if (size == 8 && !e->x64)
+        return fail(e, "64-bit operand in 32-bit mode");
+    plan_t p;
+    plan_init(&p);
+    plan_size(&p, size);
+    int byte = size == 1;
+    if (!count || (count->kind == ASM_OP_IMM && count->expr.sym < 0 &&
+                   count->expr.value == 1)) {
+        plan_op(&p, byte ? 0xd0 : 0xd1);
+    } else if (count->kind == ASM_OP_REG && count->reg == 1 &&
+               count->size == 1) {
+        plan_op(&p, byte ? 0xd2 : 0xd3);
+    } else if (count->kind == ASM_OP_IMM) {
+        plan_op(&p, byte ? 0xc0 : 0xc1);
+        plan_imm(&p, count, 1);
+    } else {
+        return fail(e, "invalid shift count");
+    }
+    plan_rm(&p, ext, dst);
+    return emit_plan(e, &p);
+}
+
+static int enc_xchg(enc_t *e, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 2)
+        return fail(e, "expected two operands");
+    const asm_operand_t *a = &ins->ops[0];
+    const asm_operand_t *b = &ins->ops[1];
+    int size = operand_size(e, suffix);
+    if (!size)
+        return 0;
+    plan_t p;
+    plan_init(&p);
+    plan_size(&p, size);
+    if (a->kind == ASM_OP_REG && b->kind == ASM_OP_REG && size > 1 &&
+        (a->reg == 0 || b->reg == 0) &&
+        !(a->reg == 0 && b->reg == 0 && size == 4 && e->x64)) {
+        plan_op(&p, 0x90);
+        p.opreg = a->reg == 0 ? b->reg : a->reg;
+    } else if (a->kind == ASM_OP_REG &&
+               (b->kind == ASM_OP_REG || b->kind == ASM_OP_MEM)) {
+        plan_op(&p, size == 1 ? 0x86 : 0x87);
+        plan_rm(&p, a->reg, b);
+    } else if (a->kind == ASM_OP_MEM && b->kind == ASM_OP_REG) {
+        plan_op(&p, size == 1 ? 0x86 : 0x87);
+        plan_rm(&p, b->reg, a);
+    } else {
+        return fail(e, "invalid operands");
+    }
+    return emit_plan(e, &p);
+}
+
+/* call, jmp and jcc; COND is -1 for call, -2 for jmp */
+static int enc_branch(enc_t *e, int cond, int short_branch)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 1)
+        return fail(e, "expected one operand");
+    const asm_operand_t *op = &ins->ops[0];
+    plan_t p;
+    plan_init(&p);
+    if (op->indirect) {
+        if (cond >= 0 || (op->kind != ASM_OP_REG && op->kind != ASM_OP_MEM))
+            return fail(e, "invalid operands");
+        if (op->kind == ASM_OP_REG && op->size != (e->x64 ? 8 : 4))
+            return fail(e, "operand size mismatch");
+        plan_op(&p, 0xff);
+        plan_rm(&p, cond == -1 ? 2 : 4, op);
+        return emit_plan(e, &p);
+    }
+    if (!is_abs(op) || op->expr.sym < 0)
+        return fail(e, "branch target must be a symbol");
+    if (cond == -1) {
+        plan_op(&p, 0xe8);
+    } else if (short_branch) {
+        plan_op(&p, cond == -2 ? 0xeb : 0x70 + cond);
+    } else if (cond == -2) {
+        plan_op(&p, 0xe9);
+    } else {
+        plan_op(&p, 0x0f);
+        plan_op(&p, 0x80 + cond);
+    }
+    p.imm_size = cond != -1 && short_branch ? 1 : 4;
+    p.imm = op->expr;
+    p.imm_pcrel = 1;
+    p.imm_branch = 1;
+    return emit_plan(e, &p);
+}
+
+static int enc_setcc(enc_t *e, int cond)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 1 || (ins->ops[0].kind != ASM_OP_MEM &&
+                           !(ins->ops[0].kind == ASM_OP_REG &&
+                             ins->ops[0].size == 1)))
+        return fail(e, "invalid operands");
+    plan_t p;
+    plan_init(&p);
+    plan_op(&p, 0x0f);
+    plan_op(&p, 0x90 + cond);
+    plan_rm(&p, 0, &ins->ops[0]);
+    return emit_plan(e, &p);
+}
+
+static int enc_cmov(enc_t *e, int cond, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 2 || ins->ops[1].kind != ASM_OP_REG ||
+        (ins->ops[0].kind != ASM_OP_REG && ins->ops[0].kind != ASM_OP_MEM))
+        return fail(e, "invalid operands");
+    int size = operand_size(e, suffix);
+    if (!size)
+        return 0;
+    plan_t p;
+    plan_init(&p);
+    plan_size(&p, size);
+    plan_op(&p, 0x0f);
+    plan_op(&p, 0x40 + cond);
+    plan_rm(&p, ins->ops[1].reg, &ins->ops[0]);
+    return emit_plan(e, &p);
+}
+
+static int enc_int(enc_t *e)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 1 || ins->ops[0].kind != ASM_OP_IMM ||
+        ins->ops[0].expr.sym >= 0)
+        return fail(e, "invalid operands");
+    plan_t p;
+    plan_init(&p);
+    plan_op(&p, 0xcd);
+    plan_imm(&p, &ins->ops[0], 1);
+    return emit_plan(e, &p);
+}
+
+/* SSE op xmm/mem, xmm with an optional mandatory prefix */
+static int enc_sse(enc_t *e, int prefix, int op, int rexw,
+                   const asm_operand_t *reg, const asm_operand_t *rm)
+{
+    plan_t p;
+    plan_init(&p);
+    if (prefix == 0x66)
+        p.p66 = 1;
+    else
+        p.rep = prefix;
+    p.rexw = rexw;
+    plan_op(&p, 0x0f);
+    plan_op(&p, op);
+    plan_rm(&p, reg->reg, rm);
+    return emit_plan(e, &p);
+}
+
+static int xmm_or_mem(const asm_operand_t *op)
+{
+    return op->kind == ASM_OP_XMM || op->kind == ASM_OP_MEM;
+}
+
+/* movd and the SSE forms of movq */
+static int enc_movd(enc_t *e, int quad)
+{
+    const asm_insn_t *ins = e->ins;
+    const asm_operand_t *src = &ins->ops[0];
+    const asm_operand_t *dst = &ins->ops[1];
+    if (ins->nops != 2)
+        return fail(e, "expected two operands");
+    if (dst->kind == ASM_OP_XMM && src->kind == ASM_OP_REG) {
+        if (src->size != 4 && src->size != 8)
+            return fail(e, "operand size mismatch");
+        return enc_sse(e, 0x66, 0x6e, src->size == 8, dst, src);
+    }
+    if (src->kind == ASM_OP_XMM && dst->kind == ASM_OP_REG) {
+        if (dst->size != 4 && dst->size != 8)
+            return fail(e, "operand size mismatch");
+        return enc_sse(e, 0x66, 0x7e, dst->size == 8, src, dst);
+    }
+    if (!quad) {
+        if (dst->kind == ASM_OP_XMM && src->kind == ASM_OP_MEM)
+            return enc_sse(e, 0x66, 0x6e, 0, dst, src);
+        if (src->kind == ASM_OP_XMM && dst->kind == ASM_OP_MEM)
+            return enc_sse(e, 0x66, 0x7e, 0, src, dst);
+        return fail(e, "invalid operands");
+    }
+    if (dst->kind == ASM_OP_XMM && xmm_or_mem(src))
+        return enc_sse(e, 0xf3, 0x7e, 0, dst, src);
+    if (src->kind == ASM_OP_XMM && dst->kind == ASM_OP_MEM)
+        return enc_sse(e, 0x66, 0xd6, 0, src, dst);
+    return fail(e, "invalid operands");
+}
+
+/*
+ * cvtsi2ss and cvtsi2sd convert a general register or memory operand;
+ * cvt(t)ss2si and cvt(t)sd2si write one.  SUFFIX selects the integer
+ * width for memory operands.
+ */
+static int enc_cvt(enc_t *e, int prefix, int op, int to_int, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 2)
+        return fail(e, "expected two operands");
+    const asm_operand_t *src = &ins->ops[0];
+    const asm_operand_t *dst = &ins->ops[1];
+    const asm_operand_t *gpr = to_int ? dst : src;
+    const asm_operand_t *xmm = to_int ? src : dst;
+    if (to_int ? (dst->kind != ASM_OP_REG || !xmm_or_mem(src))
+               : (dst->kind != ASM_OP_XMM ||
+                  (src->kind != ASM_OP_REG && src->kind != ASM_OP_MEM)))
+        return fail(e, "invalid operands");
+    int size = suffix;
+    if (gpr->kind == ASM_OP_REG) {
+        if (size && size != gpr->size)
+            return fail(e, "operand size mismatch");
+        size = gpr->size;
+    }
+    if (!size)
+        size = 4;
+    if (size != 4 && size != 8)
+        return fail(e, "invalid operand size");
+    if (size == 8 && !e->x64)
+        return fail(e, "64-bit operand in 32-bit mode");
+    return to_int ? enc_sse(e, prefix, op, size == 8, dst, src)
+                  : enc_sse(e, prefix, op, size == 8, xmm, gpr);
+}
+
+static int enc_x87_mem(enc_t *e, int op, int ext)
+{
+    const asm_insn_t *ins = e->ins;
+    if (ins->nops != 1 || ins->ops[0].kind != ASM_OP_MEM)
+        return fail(e, "invalid operands");
+    plan_t p;
+    plan_init(&p);
+    plan_op(&p, op);
+    plan_rm(&p, ext, &ins->ops[0]);
+    return emit_plan(e, &p);
+}
+
+static int name_is(const asm_insn_t *ins, size_t len, const char *name)
+{
+    return strlen(name) == len && strncmp(ins->mnemonic, name, len) == 0;
+}
+
+/* Condition code spelled by the LEN bytes at S or -1 */
+static int lookup_cond(const char *s, size_t len)
+{
+    for (size_t i = 0; i < COUNT(cond_codes); i++)
+        if (strlen(cond_codes[i].name) == len &&
+            strncmp(cond_codes[i].name, s, len) == 0)
+            return cond_codes[i].code;
+    return -1;
+}
+
+/* Instructions spelled without a size suffix */
+static int encode_exact(enc_t *e, int short_branch, int *handled)
+{
+    const asm_insn_t *ins = e->ins;
+    const char *m = ins->mnemonic;
+    size_t len = ins->mnemonic_len;
+    *handled = 1;
+
+    for (size_t i = 0; i < COUNT(plain_ops); i++) {
+        if (name_is(ins, len, plain_ops[i].name)) {
+            if (ins->nops)
+                return fail(e, "unexpected operand");
+            if (plain_ops[i].bytes[0] == 0x48 && !e->x64)
+                return fail(e, "instruction requires 64-bit mode");
+            asm_code_t *code = e->code;
+            code->len = 0;
+            code->nfixups = 0;
+            for (int j = 0; j < plain_ops[i].len; j++)
+                put_bytes(code, plain_ops[i].bytes[j], 1);
+            return 1;
+        }
+    }
+    for (size_t i = 0; i < COUNT(x87_mem_ops); i++)
+        if (name_is(ins, len, x87_mem_ops[i].name))
+            return enc_x87_mem(e, x87_mem_ops[i].op, x87_mem_ops[i].ext);
+    for (size_t i = 0; i < COUNT(sse_ops); i++) {
+        if (name_is(ins, len, sse_ops[i].name)) {
+            if (ins->nops != 2 || ins->ops[1].kind != ASM_OP_XMM ||
+                !xmm_or_mem(&ins->ops[0]))
+                return fail(e, "invalid operands");
+            return enc_sse(e, sse_ops[i].prefix, sse_ops[i].op, 0,
+                           &ins->ops[1], &ins->ops[0]);
+        }
+    }
+    for (size_t i = 0; i < COUNT(sse_moves); i++) {
+        if (name_is(ins, len, sse_moves[i].name)) {
+            if (ins->nops != 2)
+                return fail(e, "expected two operands");
+            const asm_operand_t *src = &ins->ops[0];
+            const asm_operand_t *dst = &ins->ops[1];
+            if (dst->kind == ASM_OP_XMM && xmm_or_mem(src))
+                return enc_sse(e, sse_moves[i].prefix, sse_moves[i].load, 0,
+                               dst, src);
+            if (src->kind == ASM_OP_XMM && dst->kind == ASM_OP_MEM)
+                return enc_sse(e, sse_moves[i].prefix, sse_moves[i].store,
+                               0, src, dst);
+            return fail(e, "invalid operands");
+        }
+    }
+    if (name_is(ins, len, "movd"))
+        return enc_movd(e, 0);
+    if (name_is(ins, len, "int"))
+        return enc_int(e);
+    if (name_is(ins, len, "call"))
+        return enc_branch(e, -1, 0);
+    if (name_is(ins, len, "jmp"))
+        return enc_branch(e, -2, short_branch);
+    if (len >= 2 && m[0] == 'j') {
+        int cond = lookup_cond(m + 1, len - 1);
+        if (cond >= 0)
+            return enc_branch(e, cond, short_branch);
+    }
+    if (len >= 4 && strncmp(m, "set", 3) == 0) {
+        int cond = lookup_cond(m + 3, len - 3);
+        if (cond >= 0)
+            return enc_setcc(e, cond);
+    }
+    if (len >= 5 && strncmp(m, "cmov", 4) == 0) {
+        int cond = lookup_cond(m + 4, len - 4);
+        if (cond >= 0)
+            return enc_cmov(e, cond, 0);
+        cond = lookup_cond(m + 4, len - 5);
+        if (cond >= 0 && suffix_size(m[len - 1]) > 1)
+            return enc_cmov(e, cond, suffix_size(m[len - 1]));
+    }
+    static const struct {
+        const char *name;
+        int prefix;
+        int op;
+        int to_int;
+    } cvt_ops[] = {
+        {"cvtsi2ss", 0xf3, 0x2a, 0}, {"cvtsi2sd", 0xf2, 0x2a, 0},
+        {"cvttss2si", 0xf3, 0x2c, 1}, {"cvttsd2si", 0xf2, 0x2c, 1},
+        {"cvtss2si", 0xf3, 0x2d, 1}, {"cvtsd2si", 0xf2, 0x2d, 1}
+    };
+    for (size_t i = 0; i < COUNT(cvt_ops); i++) {
+        size_t n = strlen(cvt_ops[i].name);
+        if (strncmp(m, cvt_ops[i].name, n) != 0)
+            continue;
+        int suffix = 0;
+        if (len == n + 1 && (m[n] == 'l' || m[n] == 'q'))
+            suffix = suffix_size(m[n]);
+        else if (len != n)
+            continue;
+        return enc_cvt(e, cvt_ops[i].prefix, cvt_ops[i].op,
+                       cvt_ops[i].to_int, suffix);
+    }
+    /* movzbl, movsbw, movswq, movslq and friends */
+    if (len >= 5 && len <= 6 && strncmp(m, "mov", 3) == 0 &&
+        (m[3] == 'z' || m[3] == 's')) {
+        int from = suffix_size(m[4]);
+        int to = len == 6 ? suffix_size(m[5]) : 0;
+        if (from && from < 8 && (len == 5 || to))
+            return enc_extend(e, m[3] == 's', from, to);
+    }
+    *handled = 0;
+    return 0;
+}
+
+/* Instructions taking an optional b, w, l or q suffix */
+static int encode_suffixed(enc_t *e, size_t len, int suffix)
+{
+    const asm_insn_t *ins = e->ins;
+    for (size_t i = 0; i < COUNT(alu_names); i++)
+        if (name_is(ins, len, alu_names[i]))
+            return enc_alu(e, (int)i, suffix);
+    for (size_t i = 0; i < COUNT(unary_ops); i++)
+        if (name_is(ins, len, unary_ops[i].name))
+            return enc_unary(e, unary_ops[i].ext, suffix);
+    for (size_t i = 0; i < COUNT(shift_ops); i++)
+        if (name_is(ins, len, shift_ops[i].name))
+            return enc_shift(e, shift_ops[i].ext, suffix);
+    if (name_is(ins, len, "mov")) {
+        if (suffix == 8 && ins->nops == 2 &&
+            (ins->ops[0].kind == ASM_OP_XMM || ins->ops[1].kind == ASM_OP_XMM))
+            return enc_movd(e, 1);
+        return enc_mov(e, suffix);
+    }
+    if (name_is(ins, len, "movabs"))
+        return enc_movabs(e);
+    if (name_is(ins, len, "test"))
+        return enc_test(e, suffix);
+    if (name_is(ins, len, "lea"))
+        return enc_lea(e, suffix);
+    if (name_is(ins, len, "imul"))
+        return enc_imul(e, suffix);
+    if (name_is(ins, len, "xchg"))
+        return enc_xchg(e, suffix);
+    if (name_is(ins, len, "push"))
+        return enc_stack(e, 1, suffix);
+    if (name_is(ins, len, "pop"))
+        return enc_stack(e, 0, suffix);
+    if (name_is(ins, len, "call") && suffix == (e->x64 ? 8 : 4))
+        return enc_branch(e, -1, 0);
+    return -1;
+}
+
+int asm_x86_encode(const asm_insn_t *ins, int x64, int short_branch,
+                   asm_code_t *code, char *err, size_t errlen)
+{
+    enc_t e = { ins, x64, code, err, errlen };
+    code->len = 0;
+    code->nfixups = 0;
+    int handled;
+    int ok = encode_exact(&e, short_branch, &handled);
+    if (handled)
+        return ok;
+
+    size_t len = ins->mnemonic_len;
+    ok = encode_suffixed(&e, len, 0);
+    if (ok < 0 && len > 1 && suffix_size(ins->mnemonic[len - 1]))
+        ok = encode_suffixed(&e, len - 1, suffix_size(ins->mnemonic[len - 1]));
+    if (ok < 0) {
+        snprintf(err, errlen, "unknown instruction '%.*s'", (int)len,
+                 ins->mnemonic);
+        return 0;
+    }
+    return ok;
+}
+
+int asm_x86_is_jump(const asm_insn_t *ins)
+{
+    const char *m = ins->mnemonic;
+    size_t len = ins->mnemonic_len;
+    if (ins->nops != 1 || ins->ops[0].indirect || len < 2 || m[0] != 'j')
+        return 0;
+    return name_is(ins, len, "jmp") || lookup_cond(m + 1, len - 1) >= 0;
+}
@@ -434,5 +434,6 @@ func_t *ast_make_func(const char *name, type_kind_t ret_type,
     fn->body_count = body_count;
     fn->is_inline = is_inline;
     fn->is_noreturn = is_noreturn;
+    fn->is_static = 0;
     return fn;
 }
@@ -26,16 +26,21 @@ static void init_default_opts(cli_options_t *opts)
     opts->opt_cfg.dead_code = 1;
     opts->opt_cfg.const_prop = 1;
     opts->opt_cfg.inline_funcs = 1;
+    opts->opt_cfg.mem2reg = 0;
+    opts->opt_cfg.x86_64 = 0;
+    opts->regalloc = -1;
     opts->use_x86_64 = false;
     opts->compile = false;
     opts->link = false;
     opts->dump_asm = false;
     opts->dump_ast = false;
     opts->dump_ir = false;
+    opts->dump_regalloc = false;
     opts->dump_tokens = false;
     opts->preprocess = false;
     opts->debug = false;
     opts->emit_dwarf = false;
+    opts->integrated_as = true;
     opts->color_diag = true;
     opts->dep_only = false;
     opts->deps = false;
@@ -47,6 +52,8 @@ static void init_default_opts(cli_options_t *opts)
     opts->vc_sysinclude = NULL;
     opts->internal_libc = false;
     opts->verbose_includes = false;
+    opts->include_index = false;
+    opts->include_index_stats = false;
     opts->named_locals = false;
     opts->free_output = false;
     opts->free_obj_dir = false;
@@ -54,6 +61,7 @@ static void init_default_opts(cli_options_t *opts)
     opts->free_vc_sysinclude = false;
     opts->vcflags_buf = NULL;
     opts->max_include_depth = DEFAULT_INCLUDE_DEPTH;
+    opts->jobs = 1;
     vector_init(&opts->include_dirs, sizeof(char *));
     vector_init(&opts->sources, sizeof(char *));
     vector_init(&opts->defines, sizeof(char *));
@@ -115,7 +123,9 @@ int cli_parse_args(int argc, char **argv, cli_options_t *opts)
         {"dump-ast", no_argument,     0, CLI_OPT_DUMP_AST},
         {"no-cprop", no_argument,     0, CLI_OPT_NO_CPROP},
         {"no-inline", no_argument,   0, CLI_OPT_NO_INLINE},
+        {"regalloc", required_argument, 0, CLI_OPT_REGALLOC},
         {"dump-ir", no_argument,      0, CLI_OPT_DUMP_IR},
+        {"dump-regalloc", no_argument, 0, CLI_OPT_DUMP_REGALLOC},
         {"dump-tokens", no_argument, 0, CLI_OPT_DUMP_TOKENS},
         {"debug", no_argument,       0, CLI_OPT_DEBUG},
         {"define", required_argument, 0, CLI_OPT_DEFINE},
@@ -134,14 +144,23 @@ int cli_parse_args(int argc, char **argv, cli_options_t *opts)
         {"vc-sysinclude", required_argument, 0, CLI_OPT_VC_SYSINCLUDE},
         {"internal-libc", no_argument, 0, CLI_OPT_INTERNAL_LIBC},
         {"verbose-includes", no_argument, 0, CLI_OPT_VERBOSE_INCLUDES},
+        {"include-index", no_argument, 0, CLI_OPT_INCLUDE_INDEX},
+        {"include-index-stats", no_argument, 0, CLI_OPT_INCLUDE_INDEX_STATS},
         {"named-locals", no_argument, 0, CLI_OPT_NAMED_LOCALS},
+        {"no-integrated-as", no_argument, 0, CLI_OPT_NO_INTEGRATED_AS},
+        {"jobs", required_argument, 0, 'j'},
         {0, 0, 0, 0}
     };
 
     init_default_opts(opts);
 
+    if (load_vc_jobs(opts)) {
+        free(vcflags_argv);
+        return 1;
+    }
+
     int opt;
-    while ((opt = getopt_long(argc, argv, "hvo:O:cD:U:I:L:l:ESf:",
+    while ((opt = getopt_long(argc, argv, "hvo:O:cD:U:I:L:l:ESf:j:",
                               long_opts, NULL)) != -1) {
         int ret = handle_opt_group(opt, optarg, opts);
         if (ret >= 0) {
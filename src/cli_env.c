@@ -2,6 +2,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
+#include <limits.h>
+#include <errno.h>
 #include "cli_env.h"
 #include "util.h"
 
@@ -228,3 +230,20 @@ void scan_shortcuts(int *argc, char **argv)
     }
     *argc = new_argc;
 }
+
+int load_vc_jobs(cli_options_t *opts)
+{
+    const char *env = getenv("VC_JOBS");
+    if (!env || !*env)
+        return 0;
+
+    errno = 0;
+    char *end;
+    long long v = strtoll(env, &end, 10);
+    if (*end != '\0' || errno != 0 || v <= 0 || v > INT_MAX) {
+        fprintf(stderr, "Invalid VC_JOBS value '%s'\n", env);
+        return 1;
+    }
+    opts->jobs = (size_t)v;
+    return 0;
+}
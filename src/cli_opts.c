@@ -7,6 +7,7 @@
 #include <getopt.h>
 #include "cli_opts.h"
 #include "preproc_path.h"
+#include "regalloc.h"
 #ifndef PATH_MAX
 #define PATH_MAX 4096
 #endif
@@ -32,23 +33,29 @@ void print_usage(const char *prog)
         "  -v, --version        Print version information and exit\n",
         "  -c, --compile        Assemble to an object file\n",
         "      --link           Compile and link to an executable\n",
+        "  -j, --jobs <n>       Compile up to <n> sources in parallel\n",
         "      --obj-dir <dir>  Directory for temporary object files\n",
         "      --sysroot <dir>  Prefix system include paths with <dir>\n",
         "      --vc-sysinclude <dir>  Prepend <dir> to system headers\n",
         "      --internal-libc   Use bundled libc headers\n",
         "      --verbose-includes  Print include search details\n",
+        "      --include-index  Search include dirs via cached listings\n",
+        "      --include-index-stats  Print include index statistics\n",
         "      --no-fold        Disable constant folding\n",
         "      --no-dce         Disable dead code elimination\n",
         "      --no-cprop       Disable constant propagation\n",
         "      --no-inline      Disable inline expansion\n",
+        "      --regalloc=<alg> Register allocator (linear or color)\n",
         "      --debug          Emit .file/.loc directives\n",
         "      --no-color       Disable colored diagnostics\n",
         "      --no-warn-unreachable  Disable unreachable code warnings\n",
         "      --x86-64         Generate 64-bit x86 assembly\n",
         "      --intel-syntax    Use Intel assembly syntax\n",
+        "      --no-integrated-as  Run the system assembler for object files\n",
         "      --emit-dwarf      Include DWARF information\n",
         "  -S, --dump-asm       Print assembly to stdout and exit\n",
         "      --dump-ir        Print IR to stdout and exit\n",
+        "      --dump-regalloc  Print register allocation to stdout and exit\n",
         "      --dump-tokens    Print tokens to stdout and exit\n",
         "  -M                   Generate dependency file and exit\n",
         "  -MD                  Generate dependency file during compilation\n",
@@ -122,6 +129,7 @@ static int set_opt_level(cli_options_t *opts, const char *level)
         opts->opt_cfg.const_prop = 1;
         opts->opt_cfg.inline_funcs = 1;
     }
+    opts->opt_cfg.mem2reg = opts->opt_cfg.opt_level >= 2;
 
     return 0;
 }
@@ -139,6 +147,19 @@ static int set_standard(cli_options_t *opts, const char *std)
     return 0;
 }
 
+static int set_regalloc(cli_options_t *opts, const char *alg)
+{
+    if (strcmp(alg, "linear") == 0)
+        opts->regalloc = REGALLOC_LINEAR;
+    else if (strcmp(alg, "color") == 0)
+        opts->regalloc = REGALLOC_COLOR;
+    else {
+        fprintf(stderr, "Unknown register allocator '%s'\n", alg);
+        return 1;
+    }
+    return 0;
+}
+
 static int set_max_depth(cli_options_t *opts, const char *val)
 {
     errno = 0;
@@ -152,6 +173,19 @@ static int set_max_depth(cli_options_t *opts, const char *val)
     return 0;
 }
 
+static int set_jobs(cli_options_t *opts, const char *val)
+{
+    errno = 0;
+    char *end;
+    long long v = strtoll(val, &end, 10);
+    if (*end != '\0' || errno != 0 || v <= 0 || v > INT_MAX) {
+        fprintf(stderr, "Invalid job count '%s'\n", val);
+        return 1;
+    }
+    opts->jobs = (size_t)v;
+    return 0;
+}
+
 static int handle_help(const char *arg, const char *prog, cli_options_t *opts)
 {
     (void)arg; (void)opts;
@@ -222,6 +256,7 @@ static int handle_debug_flags(int opt, cli_options_t *opts)
  * -S/--dump-asm   sets opts->dump_asm
  * --dump-ast      sets opts->dump_ast
  * --dump-ir       sets opts->dump_ir
+ * --dump-regalloc sets opts->dump_regalloc
  * --dump-tokens   sets opts->dump_tokens
  */
 static int handle_dump_flags(int opt, cli_options_t *opts)
@@ -237,6 +272,9 @@ static int handle_dump_flags(int opt, cli_options_t *opts)
     case CLI_OPT_DUMP_IR:
         opts->dump_ir = true;
         return 0;
+    case CLI_OPT_DUMP_REGALLOC:
+        opts->dump_regalloc = true;
+        return 0;
     case CLI_OPT_DUMP_TOKENS:
         opts->dump_tokens = true;
         return 0;
@@ -253,7 +291,11 @@ struct flag_entry {
 
 static void set_compile(cli_options_t *opts) { opts->compile = true; }
 static void set_link(cli_options_t *opts) { opts->link = true; }
-static void set_x86(cli_options_t *opts) { opts->use_x86_64 = true; }
+static void set_x86(cli_options_t *opts)
+{
+    opts->use_x86_64 = true;
+    opts->opt_cfg.x86_64 = 1;
+}
 static void set_intel(cli_options_t *opts) { opts->asm_syntax = ASM_INTEL; }
 static void set_preprocess(cli_options_t *opts) { opts->preprocess = true; }
 static void set_no_color(cli_options_t *opts) { opts->color_diag = false; }
@@ -261,7 +303,13 @@ static void set_dep_only(cli_options_t *opts) { opts->dep_only = true; }
 static void set_dep(cli_options_t *opts) { opts->deps = true; }
 static void set_no_warn(cli_options_t *opts) { opts->warn_unreachable = false; }
 static void set_verbose(cli_options_t *opts) { opts->verbose_includes = true; }
+static void set_include_index(cli_options_t *opts) { opts->include_index = true; }
+static void set_include_index_stats(cli_options_t *opts)
+{
+    opts->include_index_stats = true;
+}
 static void set_named_locals(cli_options_t *opts) { opts->named_locals = true; }
+static void set_external_as(cli_options_t *opts) { opts->integrated_as = false; }
 
 
 int parse_optimization_opts(int opt, const char *arg, cli_options_t *opts)
@@ -281,6 +329,8 @@ int parse_optimization_opts(int opt, const char *arg, cli_options_t *opts)
     case CLI_OPT_NO_INLINE:
         opts->opt_cfg.inline_funcs = 0;
         return 0;
+    case CLI_OPT_REGALLOC:
+        return set_regalloc(opts, arg);
     default:
         return -1;
     }
@@ -329,7 +379,10 @@ int parse_misc_opts(int opt, const char *arg, const char *prog,
         { CLI_OPT_DEP, set_dep },
         { CLI_OPT_NO_WARN_UNREACHABLE, set_no_warn },
         { CLI_OPT_VERBOSE_INCLUDES, set_verbose },
+        { CLI_OPT_INCLUDE_INDEX, set_include_index },
+        { CLI_OPT_INCLUDE_INDEX_STATS, set_include_index_stats },
         { CLI_OPT_NAMED_LOCALS, set_named_locals },
+        { CLI_OPT_NO_INTEGRATED_AS, set_external_as },
     };
 
     for (size_t i = 0; i < sizeof(table) / sizeof(table[0]); i++) {
@@ -364,6 +417,8 @@ int parse_misc_opts(int opt, const char *arg, const char *prog,
         return handle_std(arg, prog, opts);
     case CLI_OPT_FMAX_DEPTH:
         return set_max_depth(opts, arg);
+    case 'j':
+        return set_jobs(opts, arg);
     default:
         return -1;
     }
@@ -410,7 +465,7 @@ static int collect_sources(int argc, char **argv, const char *prog,
 static int validate_output(const char *prog, cli_options_t *opts)
 {
     if (!opts->output && !opts->dump_asm && !opts->dump_ir &&
-        !opts->dump_tokens && !opts->dump_ast && !opts->preprocess &&
+        !opts->dump_regalloc && !opts->dump_tokens && !opts->dump_ast && !opts->preprocess &&
         !opts->dep_only) {
         fprintf(stderr, "Error: no output path specified.\n");
         print_usage(prog);
@@ -25,6 +25,7 @@
 #include "codegen_mem.h"
 #include "codegen_arith.h"
 #include "codegen_branch.h"
+#include "x86_insn.h"
 #include "vector.h"
 
 /*
@@ -74,9 +75,8 @@ void codegen_set_dwarf(int flag)
  * register allocator state `ra` provides operand locations and `x64`
  * selects the 32- or 64-bit instruction forms used by the helper.
  */
-static void emit_instr(strbuf_t *sb, ir_instr_t *ins,
-                       regalloc_t *ra, int x64,
-                       asm_syntax_t syntax)
+static void emit_instr(x86_insn_list_t *code, ir_instr_t *ins,
+                       regalloc_t *ra, int x64)
 {
     switch (ins->op) {
     case IR_CONST: case IR_LOAD: case IR_STORE:
@@ -87,7 +87,7 @@ static void emit_instr(strbuf_t *sb, ir_instr_t *ins,
     case IR_ARG: case IR_GLOB_STRING: case IR_GLOB_WSTRING:
     case IR_GLOB_VAR: case IR_GLOB_ARRAY:
     case IR_GLOB_UNION: case IR_GLOB_STRUCT: case IR_GLOB_ADDR:
-        emit_memory_instr(sb, ins, ra, x64, syntax);
+        emit_memory_instr(code, ins, ra, x64);
         break;
 
     case IR_PTR_ADD: case IR_PTR_DIFF:
@@ -101,12 +101,12 @@ static void emit_instr(strbuf_t *sb, ir_instr_t *ins,
     case IR_XOR: case IR_CAST:
     case IR_CMPEQ: case IR_CMPNE: case IR_CMPLT: case IR_CMPGT:
     case IR_CMPLE: case IR_CMPGE:
-    case IR_LOGAND: case IR_LOGOR:
-        emit_arith_instr(sb, ins, ra, x64, syntax);
+    case IR_LOGAND: case IR_LOGOR: case IR_COPY:
+        emit_arith_instr(code, ins, ra, x64);
         break;
 
     default:
-        emit_branch_instr(sb, ins, ra, x64, syntax);
+        emit_branch_instr(code, ins, ra, x64);
         break;
     }
 }
@@ -139,17 +139,22 @@ char *codegen_ir_to_string(ir_builder_t *ir, int x64,
             regalloc_free(&ra);
             return NULL;
         }
+    /* lower to machine instructions first, then print them in one pass */
+    x86_insn_list_t code;
+    x86_insn_list_init(&code);
     for (ir_instr_t *ins = ir->head; ins; ins = ins->next) {
         if (debug_info && ins->file && ins->line)
-            if (strbuf_appendf(&sb, ".loc 1 %zu %zu\n", ins->line, ins->column) < 0) {
-                strbuf_free(&sb);
-                regalloc_free(&ra);
-                return NULL;
-            }
-        emit_instr(&sb, ins, &ra, x64, syntax);
+            x86_emit2(&code, X86_LOC, 0, x86_imm((long long)ins->line),
+                      x86_imm((long long)ins->column));
+        emit_instr(&code, ins, &ra, x64);
     }
-
+    int rc = x86_insn_list_print(&sb, &code, syntax);
+    x86_insn_list_free(&code);
     regalloc_free(&ra);
+    if (rc < 0) {
+        strbuf_free(&sb);
+        return NULL;
+    }
     return sb.data; /* caller takes ownership */
 }
 
@@ -195,7 +200,6 @@ static void emit_global_string(ir_instr_t *ins,
         case '\b': fputs("\\b", out); break;
         case '\f': fputs("\\f", out); break;
         case '\v': fputs("\\v", out); break;
-        case '\a': fputs("\\a", out); break;
         default:
             if (c < 32 || c > 126)
                 fprintf(out, "\\x%02x", c);
@@ -305,15 +309,16 @@ static int emit_global_data(FILE *out, const ir_builder_t *ir, int x64)
  *
  * When stack slots are not used the IR retains variable names in memory
  * operations.  Emit a `.lcomm` directive for each such name so that the
- * resulting assembly has a definition for every symbol referenced.
+ * resulting assembly has a definition for every symbol referenced.  IR
+ * names are interned, so duplicates are detected by pointer comparison.
  */
 static int emit_local_comm(FILE *out, const ir_builder_t *ir, int x64)
 {
     vector_t names;
-    vector_init(&names, sizeof(char *));
+    vector_init(&names, sizeof(const char *));
 
     vector_t globals;
-    vector_init(&globals, sizeof(char *));
+    vector_init(&globals, sizeof(const char *));
 
     for (ir_instr_t *ins = ir->head; ins; ins = ins->next) {
         if (ins->name && ins->name[0]) {
@@ -325,7 +330,7 @@ static int emit_local_comm(FILE *out, const ir_builder_t *ir, int x64)
                 ins->op == IR_GLOB_ADDR) {
                 int exists = 0;
                 for (size_t i = 0; i < globals.count && !exists; i++)
-                    if (strcmp(((char **)globals.data)[i], ins->name) == 0)
+                    if (((const char **)globals.data)[i] == ins->name)
                         exists = 1;
                 if (!exists)
                     vector_push(&globals, &ins->name);
@@ -352,14 +357,14 @@ static int emit_local_comm(FILE *out, const ir_builder_t *ir, int x64)
 
         int is_global = 0;
         for (size_t i = 0; i < globals.count && !is_global; i++)
-            if (strcmp(((char **)globals.data)[i], name) == 0)
+            if (((const char **)globals.data)[i] == name)
                 is_global = 1;
         if (is_global)
             continue;
 
         int exists = 0;
         for (size_t i = 0; i < names.count && !exists; i++)
-            if (strcmp(((char **)names.data)[i], name) == 0)
+            if (((const char **)names.data)[i] == name)
                 exists = 1;
         if (!exists)
             vector_push(&names, &name);
@@ -367,7 +372,7 @@ static int emit_local_comm(FILE *out, const ir_builder_t *ir, int x64)
 
     int emitted = 0;
     for (size_t i = 0; i < names.count; i++) {
-        const char *n = ((char **)names.data)[i];
+        const char *n = ((const char **)names.data)[i];
         if (!emitted)
             fputs(".bss\n", out);
         fprintf(out, ".lcomm %s, %d\n", n, x64 ? 8 : 4);
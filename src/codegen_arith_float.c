@@ -4,55 +4,31 @@
 
 #include <stdio.h>
 #include "codegen_arith_float.h"
+#include "codegen_x86.h"
 #include "regalloc_x86.h"
 #include "consteval.h"
 #include "regalloc.h"
 
-static const char *reg_str(int reg, int size, asm_syntax_t syntax)
-{
-    const char *name = (size == 4) ? regalloc_reg_name32(reg)
-                                  : regalloc_reg_name(reg);
-    if (syntax == ASM_INTEL && name[0] == '%')
-        return name + 1;
-    return name;
-}
-
-static const char *fmt_reg(const char *name, asm_syntax_t syntax)
-{
-    if (syntax == ASM_INTEL && name[0] == '%')
-        return name + 1;
-    return name;
-}
-
-static const char *loc_str(char buf[32], regalloc_t *ra, int id, int x64,
-                           int size, asm_syntax_t syntax)
+/*
+ * Store the scalar in xmm register `reg` to the result of `ins`: movd or
+ * movq when it lives in a register, movss or movsd otherwise.
+ */
+static void store_xmm(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                      int x64, x86_operand_t reg, int size)
 {
-    if (!ra || id <= 0)
-        return "";
-    int loc = ra->loc[id];
-    if (loc >= 0)
-        return reg_str(loc, size, syntax);
-    if (x64) {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[rbp-%d]", -loc * 8);
-        else
-            snprintf(buf, 32, "-%d(%%rbp)", -loc * 8);
-    } else {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[ebp-%d]", -loc * 4);
-        else
-            snprintf(buf, 32, "-%d(%%ebp)", -loc * 4);
-    }
-    return buf;
+    int in_reg = ra && ra->loc[ins->dest] >= 0;
+    x86_opcode_t op;
+    if (size == 4)
+        op = in_reg ? X86_MOVD : X86_MOVSS;
+    else
+        op = in_reg ? X86_MOVQ : X86_MOVSD;
+    x86_emit2(code, op, 0, reg, x86_op_loc(ra, ins->dest, x64, size));
 }
 
 /* Convert between integer and floating-point types. */
-void emit_cast(strbuf_t *sb, ir_instr_t *ins,
-               regalloc_t *ra, int x64,
-               asm_syntax_t syntax)
+void emit_cast(x86_insn_list_t *code, ir_instr_t *ins,
+               regalloc_t *ra, int x64)
 {
-    char b1[32];
-    char b2[32];
     type_kind_t src = (type_kind_t)((unsigned long long)ins->imm >> 32);
     type_kind_t dst = (type_kind_t)(ins->imm & 0xffffffffu);
     int src64 = (src == TYPE_LLONG || src == TYPE_ULLONG);
@@ -63,161 +39,71 @@ void emit_cast(strbuf_t *sb, ir_instr_t *ins,
     int r0 = regalloc_xmm_acquire();
     if (r0 < 0) {
         fprintf(stderr, "emit_cast: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
-        return;
-    }
-    const char *reg0 = fmt_reg(regalloc_xmm_name(r0), syntax);
-    const char *sfx = x64 ? "q" : "l";
-    int regsize = (sfx[0] == 'l') ? 4 : 8;
-
-    if (is_intlike(src) && dst == TYPE_FLOAT) {
-        const char *op = src64 ? "cvtsi2ssq" : "cvtsi2ss";
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    %s %s, %s\n", op, reg0,
-                           loc_str(b1, ra, ins->src1, x64, src_size, syntax));
-        else
-            strbuf_appendf(sb, "    %s %s, %s\n", op,
-                           loc_str(b1, ra, ins->src1, x64, src_size, syntax), reg0);
-        if (ra && ra->loc[ins->dest] >= 0)
-            strbuf_appendf(sb, "    movd %s, %s\n", reg0,
-                           loc_str(b2, ra, ins->dest, x64, 4, syntax));
-        else
-            strbuf_appendf(sb, "    movss %s, %s\n", reg0,
-                           loc_str(b2, ra, ins->dest, x64, 4, syntax));
-        regalloc_xmm_release(r0);
-        return;
-    }
-
-    if (is_intlike(src) && dst == TYPE_DOUBLE) {
-        const char *op = src64 ? "cvtsi2sdq" : "cvtsi2sd";
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    %s %s, %s\n", op, reg0,
-                           loc_str(b1, ra, ins->src1, x64, src_size, syntax));
-        else
-            strbuf_appendf(sb, "    %s %s, %s\n", op,
-                           loc_str(b1, ra, ins->src1, x64, src_size, syntax), reg0);
-        if (ra && ra->loc[ins->dest] >= 0)
-            strbuf_appendf(sb, "    movq %s, %s\n", reg0,
-                           loc_str(b2, ra, ins->dest, x64, 8, syntax));
-        else
-            strbuf_appendf(sb, "    movsd %s, %s\n", reg0,
-                           loc_str(b2, ra, ins->dest, x64, 8, syntax));
-        regalloc_xmm_release(r0);
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
-
-    if (src == TYPE_FLOAT && is_intlike(dst)) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    movss %s, %s\n", reg0,
-                           loc_str(b1, ra, ins->src1, x64, 4, syntax));
-        else
-            strbuf_appendf(sb, "    movss %s, %s\n",
-                           loc_str(b1, ra, ins->src1, x64, 4, syntax), reg0);
-        const char *op = dst64 ? "cvttss2siq" : "cvttss2si";
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    %s %s, %s\n", op,
-                           loc_str(b2, ra, ins->dest, x64, dst_size, syntax), reg0);
-        else
-            strbuf_appendf(sb, "    %s %s, %s\n", op, reg0,
-                           loc_str(b2, ra, ins->dest, x64, dst_size, syntax));
+    x86_operand_t reg0 = x86_op_xmm(r0);
+    char sfx = x64 ? 'q' : 'l';
+    int regsize = (sfx == 'l') ? 4 : 8;
+
+    if (is_intlike(src) && (dst == TYPE_FLOAT || dst == TYPE_DOUBLE)) {
+        int size = dst == TYPE_FLOAT ? 4 : 8;
+        x86_emit2(code, size == 4 ? X86_CVTSI2SS : X86_CVTSI2SD,
+                  src64 ? 'q' : 0,
+                  x86_op_loc(ra, ins->src1, x64, src_size), reg0);
+        store_xmm(code, ins, ra, x64, reg0, size);
         regalloc_xmm_release(r0);
         return;
     }
 
-    if (src == TYPE_DOUBLE && is_intlike(dst)) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    movsd %s, %s\n", reg0,
-                           loc_str(b1, ra, ins->src1, x64, 8, syntax));
-        else
-            strbuf_appendf(sb, "    movsd %s, %s\n",
-                           loc_str(b1, ra, ins->src1, x64, 8, syntax), reg0);
-        const char *op = dst64 ? "cvttsd2siq" : "cvttsd2si";
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    %s %s, %s\n", op,
-                           loc_str(b2, ra, ins->dest, x64, dst_size, syntax), reg0);
-        else
-            strbuf_appendf(sb, "    %s %s, %s\n", op, reg0,
-                           loc_str(b2, ra, ins->dest, x64, dst_size, syntax));
+    if ((src == TYPE_FLOAT || src == TYPE_DOUBLE) && is_intlike(dst)) {
+        int flt = src == TYPE_FLOAT;
+        x86_emit2(code, flt ? X86_MOVSS : X86_MOVSD, 0,
+                  x86_op_loc(ra, ins->src1, x64, flt ? 4 : 8), reg0);
+        x86_emit2(code, flt ? X86_CVTTSS2SI : X86_CVTTSD2SI,
+                  dst64 ? 'q' : 0, reg0,
+                  x86_op_loc(ra, ins->dest, x64, dst_size));
         regalloc_xmm_release(r0);
         return;
     }
 
     if (src == TYPE_FLOAT && dst == TYPE_DOUBLE) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    movss %s, %s\n", reg0,
-                           loc_str(b1, ra, ins->src1, x64, 4, syntax));
-        else
-            strbuf_appendf(sb, "    movss %s, %s\n",
-                           loc_str(b1, ra, ins->src1, x64, 4, syntax), reg0);
-        strbuf_appendf(sb, "    cvtss2sd %s, %s\n", reg0, reg0);
-        if (ra && ra->loc[ins->dest] >= 0)
-            strbuf_appendf(sb, "    movq %s, %s\n", reg0,
-                           loc_str(b2, ra, ins->dest, x64, 8, syntax));
-        else
-            strbuf_appendf(sb, "    movsd %s, %s\n", reg0,
-                           loc_str(b2, ra, ins->dest, x64, 8, syntax));
+        x86_emit2(code, X86_MOVSS, 0, x86_op_loc(ra, ins->src1, x64, 4), reg0);
+        x86_emit2(code, X86_CVTSS2SD, 0, reg0, reg0);
+        store_xmm(code, ins, ra, x64, reg0, 8);
         regalloc_xmm_release(r0);
         return;
     }
 
     if (src == TYPE_DOUBLE && dst == TYPE_FLOAT) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    movsd %s, %s\n", reg0,
-                           loc_str(b1, ra, ins->src1, x64, 8, syntax));
-        else
-            strbuf_appendf(sb, "    movsd %s, %s\n",
-                           loc_str(b1, ra, ins->src1, x64, 8, syntax), reg0);
-        strbuf_appendf(sb, "    cvtsd2ss %s, %s\n", reg0, reg0);
-        if (ra && ra->loc[ins->dest] >= 0)
-            strbuf_appendf(sb, "    movd %s, %s\n", reg0,
-                           loc_str(b2, ra, ins->dest, x64, 4, syntax));
-        else
-            strbuf_appendf(sb, "    movss %s, %s\n", reg0,
-                           loc_str(b2, ra, ins->dest, x64, 4, syntax));
+        x86_emit2(code, X86_MOVSD, 0, x86_op_loc(ra, ins->src1, x64, 8), reg0);
+        x86_emit2(code, X86_CVTSD2SS, 0, reg0, reg0);
+        store_xmm(code, ins, ra, x64, reg0, 4);
         regalloc_xmm_release(r0);
         return;
     }
 
+    x86_operand_t from = x86_op_loc(ra, ins->src1, x64, regsize);
+    x86_operand_t to = x86_op_loc(ra, ins->dest, x64, regsize);
     int spill_src = ra && ra->loc[ins->src1] < 0;
     int spill_dest = ra && ra->loc[ins->dest] < 0;
     if (spill_src && spill_dest) {
-        const char *tmp = reg_str(REGALLOC_SCRATCH_REG, regsize, syntax);
-        if (syntax == ASM_INTEL) {
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, tmp,
-                           loc_str(b1, ra, ins->src1, x64, regsize, syntax));
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx,
-                           loc_str(b2, ra, ins->dest, x64, regsize, syntax), tmp);
-        } else {
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx,
-                           loc_str(b1, ra, ins->src1, x64, regsize, syntax), tmp);
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, tmp,
-                           loc_str(b2, ra, ins->dest, x64, regsize, syntax));
-        }
-        regalloc_xmm_release(r0);
-        return;
+        x86_operand_t tmp = x86_op_reg(REGALLOC_SCRATCH_REG, regsize);
+        x86_emit2(code, X86_MOV, sfx, from, tmp);
+        from = tmp;
     }
-
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx,
-                       loc_str(b2, ra, ins->dest, x64, regsize, syntax),
-                       loc_str(b1, ra, ins->src1, x64, regsize, syntax));
-    else
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx,
-                       loc_str(b1, ra, ins->src1, x64, regsize, syntax),
-                       loc_str(b2, ra, ins->dest, x64, regsize, syntax));
+    x86_emit2(code, X86_MOV, sfx, from, to);
     regalloc_xmm_release(r0);
 }
 
 /* Generate a long double binary operation using the x87 FPU. */
-void emit_long_float_binop(strbuf_t *sb, ir_instr_t *ins,
-                           regalloc_t *ra, int x64, const char *op,
-                           asm_syntax_t syntax)
+void emit_long_float_binop(x86_insn_list_t *code, ir_instr_t *ins,
+                           regalloc_t *ra, int x64, x86_opcode_t op)
 {
-    char b1[32];
-    char b2[32];
-    strbuf_appendf(sb, "    fldt %s\n", loc_str(b1, ra, ins->src1, x64, x64 ? 8 : 4, syntax));
-    strbuf_appendf(sb, "    fldt %s\n", loc_str(b1, ra, ins->src2, x64, x64 ? 8 : 4, syntax));
-    strbuf_appendf(sb, "    %s\n", op);
-    strbuf_appendf(sb, "    fstpt %s\n", loc_str(b2, ra, ins->dest, x64, x64 ? 8 : 4, syntax));
+    int size = x64 ? 8 : 4;
+    x86_emit1(code, X86_FLDT, 0, x86_op_loc(ra, ins->src1, x64, size));
+    x86_emit1(code, X86_FLDT, 0, x86_op_loc(ra, ins->src2, x64, size));
+    x86_emit0(code, op, 0);
+    x86_emit1(code, X86_FSTPT, 0, x86_op_loc(ra, ins->dest, x64, size));
 }
-
@@ -3,7 +3,6 @@
  */
 
 #include <stdio.h>
-#include <string.h>
 #include "codegen_arith.h"
 #include "codegen_arith_int.h"
 #include "codegen_arith_float.h"
@@ -14,39 +13,76 @@
 #include "regalloc.h"
 
 
-void emit_ptr_add(strbuf_t *sb, ir_instr_t *ins,
-                  regalloc_t *ra, int x64,
-                  asm_syntax_t syntax)
+/*
+ * Move SRC to DEST unless both name the same location, as happens when
+ * the allocator coalesces an operand with the result or places it in the
+ * register the instruction needs.
+ */
+static void emit_move_to(x86_insn_list_t *code, char sfx, x86_operand_t src,
+                         x86_operand_t dest)
+{
+    if (!x86_operand_equal(&src, &dest))
+        x86_emit_mov(code, sfx, src, dest);
+}
+
+/* Operation suffix for the IR type of `ins`. */
+static char arith_sfx(const ir_instr_t *ins, int x64)
+{
+    return (x64 && ins->type != TYPE_INT) ? 'q' : 'l';
+}
+
+/* Register width in bytes for the suffix `sfx`. */
+static int sfx_size(char sfx)
 {
-    char b1[32];
-    char b2[32];
-    char mem[32];
-    const char *sfx = (x64 && ins->type != TYPE_INT) ? "q" : "l";
+    return sfx == 'l' ? 4 : 8;
+}
+
+/* Negate `reg`; the Intel form leaves the size to the register. */
+static void emit_neg(x86_insn_list_t *code, char sfx, x86_operand_t reg)
+{
+    x86_insn_t ins = {0};
+    ins.op = X86_NEG;
+    ins.sfx = sfx;
+    ins.flags = X86_INSF_BARE;
+    ins.nops = 1;
+    ins.ops[0] = reg;
+    x86_emit_insn(code, &ins);
+}
+
+void emit_ptr_add(x86_insn_list_t *code, ir_instr_t *ins,
+                  regalloc_t *ra, int x64)
+{
+    char sfx = arith_sfx(ins, x64);
+    int size = sfx_size(sfx);
     int scale = (int)ins->imm;
     int dest_spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest_reg = dest_spill ? x86_reg_str(REGALLOC_SCRATCH_REG, sfx, syntax)
-                                      : x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax);
-    const char *dest_mem = x86_loc_str(mem, ra, ins->dest, x64, sfx, syntax);
-    x86_emit_mov(sb, sfx,
-                 x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax), dest_reg, syntax);
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    imul%s %s, %d\n", sfx, dest_reg, scale);
-    else
-        strbuf_appendf(sb, "    imul%s $%d, %s\n", sfx, scale, dest_reg);
-    x86_emit_op(sb, "add", sfx,
-                x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax), dest_reg, syntax);
+    x86_operand_t dest_reg = dest_spill ? x86_op_reg(REGALLOC_SCRATCH_REG, size)
+                                        : x86_op_loc(ra, ins->dest, x64, size);
+    x86_operand_t dest_mem = x86_op_loc(ra, ins->dest, x64, size);
+    /* a base held in the scratch register is parked in the result's slot */
+    int park = dest_spill && ins->src1 > 0 &&
+               ra->loc[ins->src1] == REGALLOC_SCRATCH_REG;
+    if (park)
+        x86_emit_mov(code, sfx, dest_reg, dest_mem);
+    x86_emit_mov(code, sfx, x86_op_loc(ra, ins->src2, x64, size), dest_reg);
+    /* byte offsets, e.g. strength reduced steps, need no scaling */
+    if (scale != 1)
+        x86_emit2(code, X86_IMUL, sfx, x86_imm(scale), dest_reg);
+    if (park) {
+        x86_emit_op(code, X86_ADD, sfx, dest_reg, dest_mem);
+        return;
+    }
+    x86_emit_op(code, X86_ADD, sfx, x86_op_loc(ra, ins->src1, x64, size),
+                dest_reg);
     if (dest_spill)
-        x86_emit_mov(sb, sfx, dest_reg, dest_mem, syntax);
+        x86_emit_mov(code, sfx, dest_reg, dest_mem);
 }
 
-void emit_ptr_diff(strbuf_t *sb, ir_instr_t *ins,
-                   regalloc_t *ra, int x64,
-                   asm_syntax_t syntax)
+void emit_ptr_diff(x86_insn_list_t *code, ir_instr_t *ins,
+                   regalloc_t *ra, int x64)
 {
-    char b1[32];
-    char b2[32];
-    char mem[32];
-    const char *sfx = (x64 && ins->type != TYPE_INT) ? "q" : "l";
+    char sfx = arith_sfx(ins, x64);
+    int size = sfx_size(sfx);
     int esz = (int)ins->imm;
     int power_two = esz && !(esz & (esz - 1));
     int shift = 0;
@@ -54,422 +90,403 @@ void emit_ptr_diff(strbuf_t *sb, ir_instr_t *ins,
     while (power_two && (tmp >>= 1) > 0) shift++;
 
     int dest_spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest_reg = dest_spill ? x86_reg_str(REGALLOC_SCRATCH_REG, sfx, syntax)
-                                      : x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax);
-    const char *dest_mem = x86_loc_str(mem, ra, ins->dest, x64, sfx, syntax);
+    x86_operand_t dest_reg = dest_spill ? x86_op_reg(REGALLOC_SCRATCH_REG, size)
+                                        : x86_op_loc(ra, ins->dest, x64, size);
+    x86_operand_t dest_mem = x86_op_loc(ra, ins->dest, x64, size);
 
     if (esz == 0) {
-        x86_emit_op(sb, "xor", sfx, dest_reg, dest_reg, syntax);
+        x86_emit_op(code, X86_XOR, sfx, dest_reg, dest_reg);
         if (dest_spill)
-            x86_emit_mov(sb, sfx, dest_reg, dest_mem, syntax);
+            x86_emit_mov(code, sfx, dest_reg, dest_mem);
         return;
     }
 
-    x86_emit_mov(sb, sfx,
-                 x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax), dest_reg, syntax);
-    x86_emit_op(sb, "sub", sfx,
-                x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax), dest_reg, syntax);
+    if (dest_spill && ins->src1 != ins->src2 &&
+        ra->loc[ins->src2] == REGALLOC_SCRATCH_REG) {
+        /* the subtrahend already sits in the scratch register */
+        emit_neg(code, sfx, dest_reg);
+        x86_emit_op(code, X86_ADD, sfx, x86_op_loc(ra, ins->src1, x64, size),
+                    dest_reg);
+    } else {
+        x86_emit_mov(code, sfx, x86_op_loc(ra, ins->src1, x64, size),
+                     dest_reg);
+        x86_emit_op(code, X86_SUB, sfx, x86_op_loc(ra, ins->src2, x64, size),
+                    dest_reg);
+    }
 
     if (power_two) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    sar%s %s, %d\n", sfx, dest_reg, shift);
-        else
-            strbuf_appendf(sb, "    sar%s $%d, %s\n", sfx, shift, dest_reg);
+        x86_emit2(code, X86_SAR, sfx, x86_imm(shift), dest_reg);
     } else {
-        const char *ax = x86_reg_str(0, sfx, syntax);
-        const char *cx = x86_reg_str(2, sfx, syntax);
-        if (strcmp(dest_reg, ax) != 0)
-            x86_emit_mov(sb, sfx, dest_reg, ax, syntax);
-        strbuf_appendf(sb, "    %s\n", strcmp(sfx, "q") == 0 ? "cqto" : "cltd");
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %d\n", sfx, cx, esz);
-        else
-            strbuf_appendf(sb, "    mov%s $%d, %s\n", sfx, esz, cx);
-        strbuf_appendf(sb, "    idiv%s %s\n", sfx, cx);
-        if (strcmp(dest_reg, ax) != 0)
-            x86_emit_mov(sb, sfx, ax, dest_reg, syntax);
+        x86_operand_t ax = x86_op_reg(0, size);
+        x86_operand_t cx = x86_op_reg(2, size);
+        int in_ax = x86_operand_equal(&dest_reg, &ax);
+        if (!in_ax)
+            x86_emit_mov(code, sfx, dest_reg, ax);
+        x86_emit0(code, sfx == 'q' ? X86_CQTO : X86_CLTD, 0);
+        x86_emit2(code, X86_MOV, sfx, x86_imm(esz), cx);
+        x86_emit1(code, X86_IDIV, sfx, cx);
+        if (!in_ax)
+            x86_emit_mov(code, sfx, ax, dest_reg);
     }
 
     if (dest_spill)
-        x86_emit_mov(sb, sfx, dest_reg, dest_mem, syntax);
+        x86_emit_mov(code, sfx, dest_reg, dest_mem);
 }
 
-void emit_ptr_arith(strbuf_t *sb, ir_instr_t *ins,
-                    regalloc_t *ra, int x64,
-                    asm_syntax_t syntax)
+void emit_ptr_arith(x86_insn_list_t *code, ir_instr_t *ins,
+                    regalloc_t *ra, int x64)
 {
     switch (ins->op) {
     case IR_PTR_ADD:
-        emit_ptr_add(sb, ins, ra, x64, syntax);
+        emit_ptr_add(code, ins, ra, x64);
         break;
     case IR_PTR_DIFF:
-        emit_ptr_diff(sb, ins, ra, x64, syntax);
+        emit_ptr_diff(code, ins, ra, x64);
         break;
     default:
         break;
     }
 }
 
-void emit_int_arith(strbuf_t *sb, ir_instr_t *ins,
-                    regalloc_t *ra, int x64, const char *op,
-                    asm_syntax_t syntax)
+/*
+ * Emit DEST = SRC1 OP SRC2 for a two-operand instruction.  A spilled
+ * result is computed in the scratch register; when the right operand
+ * already sits there the operands of a commutative OP are swapped and a
+ * subtraction adds the left operand to the negated right one.
+ */
+static void emit_two_operand(x86_insn_list_t *code, ir_instr_t *ins,
+                             regalloc_t *ra, int x64, x86_opcode_t op)
 {
-    char b1[32];
-    char destb[32];
-    char mem[32];
-    const char *sfx = (x64 && ins->type != TYPE_INT) ? "q" : "l";
+    char sfx = arith_sfx(ins, x64);
+    int size = sfx_size(sfx);
     int dest_spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest_reg = dest_spill ? x86_reg_str(REGALLOC_SCRATCH_REG, sfx, syntax)
-                                      : x86_loc_str(destb, ra, ins->dest, x64, sfx, syntax);
-    const char *dest_mem = x86_loc_str(mem, ra, ins->dest, x64, sfx, syntax);
-    x86_emit_mov(sb, sfx,
-                 x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax), dest_reg, syntax);
-    x86_emit_op(sb, op, sfx,
-                x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax), dest_reg, syntax);
+    x86_operand_t dest_reg = dest_spill ? x86_op_reg(REGALLOC_SCRATCH_REG, size)
+                                        : x86_op_loc(ra, ins->dest, x64, size);
+    x86_operand_t dest_mem = x86_op_loc(ra, ins->dest, x64, size);
+    int lhs = ins->src1, rhs = ins->src2;
+    if (dest_spill && rhs > 0 && ra->loc[rhs] == REGALLOC_SCRATCH_REG &&
+        lhs != rhs) {
+        if (op == X86_SUB) {
+            emit_neg(code, sfx, dest_reg);
+            op = X86_ADD;
+        }
+        lhs = ins->src2;
+        rhs = ins->src1;
+    }
+    emit_move_to(code, sfx, x86_op_loc(ra, lhs, x64, size), dest_reg);
+    x86_emit_op(code, op, sfx, x86_op_loc(ra, rhs, x64, size), dest_reg);
     if (dest_spill)
-        x86_emit_mov(sb, sfx, dest_reg, dest_mem, syntax);
+        x86_emit_mov(code, sfx, dest_reg, dest_mem);
 }
 
-void emit_div(strbuf_t *sb, ir_instr_t *ins,
-              regalloc_t *ra, int x64,
-              asm_syntax_t syntax)
+void emit_int_arith(x86_insn_list_t *code, ir_instr_t *ins,
+                    regalloc_t *ra, int x64, x86_opcode_t op)
 {
-    char b1[32];
-    const char *sfx = (x64 && ins->type != TYPE_INT) ? "q" : "l";
-    const char *ax = x86_reg_str(0, sfx, syntax);
-    const char *dx = x86_reg_str(3, sfx, syntax);
-    int is_unsigned = (ins->type == TYPE_UINT || ins->type == TYPE_ULONG ||
-                       ins->type == TYPE_USHORT || ins->type == TYPE_UCHAR ||
-                       ins->type == TYPE_ULLONG);
-
-    x86_emit_mov(sb, sfx,
-                 x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax), ax,
-                 syntax);
-
-    if (is_unsigned) {
-        x86_emit_op(sb, "xor", sfx, dx, dx, syntax);
-        strbuf_appendf(sb, "    div%s %s\n", sfx,
-                       x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax));
-    } else {
-        strbuf_appendf(sb, "    %s\n", strcmp(sfx, "q") == 0 ? "cqto" : "cltd");
-        strbuf_appendf(sb, "    idiv%s %s\n", sfx,
-                       x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax));
-    }
-    if (ra && ins->dest > 0) {
-        int dest_loc = ra->loc[ins->dest];
-        if (dest_loc < 0 ||
-            strcmp(x86_reg_str(dest_loc, sfx, syntax), ax) != 0) {
-            char b2[32];
-            x86_emit_mov(sb, sfx, ax,
-                         x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax),
-                         syntax);
-        }
-    }
+    emit_two_operand(code, ins, ra, x64, op);
 }
 
-void emit_mod(strbuf_t *sb, ir_instr_t *ins,
-              regalloc_t *ra, int x64,
-              asm_syntax_t syntax)
+static int is_unsigned_type(type_kind_t t)
 {
-    char b1[32];
-    const char *sfx = (x64 && ins->type != TYPE_INT) ? "q" : "l";
-    const char *ax = x86_reg_str(0, sfx, syntax);
-    const char *dx = x86_reg_str(3, sfx, syntax);
-    int is_unsigned = (ins->type == TYPE_UINT || ins->type == TYPE_ULONG ||
-                       ins->type == TYPE_USHORT || ins->type == TYPE_UCHAR ||
-                       ins->type == TYPE_ULLONG);
-
-    x86_emit_mov(sb, sfx,
-                 x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax), ax,
-                 syntax);
-
-    if (is_unsigned) {
-        x86_emit_op(sb, "xor", sfx, dx, dx, syntax);
-        strbuf_appendf(sb, "    div%s %s\n", sfx,
-                       x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax));
+    return t == TYPE_UINT || t == TYPE_ULONG || t == TYPE_USHORT ||
+           t == TYPE_UCHAR || t == TYPE_ULLONG;
+}
+
+/*
+ * Divide src1 by src2 leaving the quotient in %eax/%rax and the
+ * remainder in %edx/%rdx.
+ */
+static void emit_divide(x86_insn_list_t *code, ir_instr_t *ins,
+                        regalloc_t *ra, int x64, char sfx)
+{
+    int size = sfx_size(sfx);
+    x86_operand_t dx = x86_op_reg(3, size);
+
+    emit_move_to(code, sfx, x86_op_loc(ra, ins->src1, x64, size),
+                 x86_op_reg(0, size));
+    if (is_unsigned_type(ins->type)) {
+        x86_emit_op(code, X86_XOR, sfx, dx, dx);
+        x86_emit1(code, X86_DIV, sfx, x86_op_loc(ra, ins->src2, x64, size));
     } else {
-        strbuf_appendf(sb, "    %s\n", strcmp(sfx, "q") == 0 ? "cqto" : "cltd");
-        strbuf_appendf(sb, "    idiv%s %s\n", sfx,
-                       x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax));
-    }
-    if (ra && ins->dest > 0) {
-        char b2[32];
-        x86_emit_mov(sb, sfx,
-                     dx,
-                     x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax),
-                     syntax);
+        x86_emit0(code, sfx == 'q' ? X86_CQTO : X86_CLTD, 0);
+        x86_emit1(code, X86_IDIV, sfx, x86_op_loc(ra, ins->src2, x64, size));
     }
 }
 
-void emit_shift(strbuf_t *sb, ir_instr_t *ins,
-                regalloc_t *ra, int x64, const char *op,
-                asm_syntax_t syntax)
+void emit_div(x86_insn_list_t *code, ir_instr_t *ins,
+              regalloc_t *ra, int x64)
+{
+    char sfx = arith_sfx(ins, x64);
+    emit_divide(code, ins, ra, x64, sfx);
+    if (ra && ins->dest > 0)
+        emit_move_to(code, sfx, x86_op_reg(0, sfx_size(sfx)),
+                     x86_op_loc(ra, ins->dest, x64, sfx_size(sfx)));
+}
+
+void emit_mod(x86_insn_list_t *code, ir_instr_t *ins,
+              regalloc_t *ra, int x64)
 {
-    char b1[32];
-    char b2[32];
-    const char *sfx = (x64 && ins->type != TYPE_INT) ? "q" : "l";
-    const char *cx = x86_reg_str(2, sfx, syntax);
-    const char *cl = x86_fmt_reg("%cl", syntax);
+    char sfx = arith_sfx(ins, x64);
+    emit_divide(code, ins, ra, x64, sfx);
+    if (ra && ins->dest > 0)
+        emit_move_to(code, sfx, x86_op_reg(3, sfx_size(sfx)),
+                     x86_op_loc(ra, ins->dest, x64, sfx_size(sfx)));
+}
+
+/* Shift `dest` by %cl; the Intel form leaves the size to the register. */
+static void emit_shift_cl(x86_insn_list_t *code, x86_opcode_t op, char sfx,
+                          x86_operand_t dest)
+{
+    x86_insn_t ins = {0};
+    ins.op = op;
+    ins.sfx = sfx;
+    ins.flags = X86_INSF_BARE;
+    ins.nops = 2;
+    ins.ops[0] = x86_reg(X86_CX, 1);
+    ins.ops[1] = dest;
+    x86_emit_insn(code, &ins);
+}
+
+void emit_shift(x86_insn_list_t *code, ir_instr_t *ins,
+                regalloc_t *ra, int x64, x86_opcode_t op)
+{
+    char sfx = arith_sfx(ins, x64);
+    int size = sfx_size(sfx);
+    x86_operand_t cx = x86_op_reg(2, size);
     int dest_is_cx = (ra && ins->dest > 0 && ra->loc[ins->dest] == 2);
-    if (dest_is_cx) {
-        const char *scratch = x86_reg_str(REGALLOC_SCRATCH_REG, sfx, syntax);
-        const char *dest = x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax);
-        x86_emit_mov(sb, sfx,
-                     x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax), scratch, syntax);
-        x86_emit_mov(sb, sfx,
-                     x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax), cx, syntax);
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    %s %s, %s\n", op, scratch, cl);
-        else
-            strbuf_appendf(sb, "    %s%s %s, %s\n", op, sfx, cl, scratch);
-        x86_emit_mov(sb, sfx, scratch, dest, syntax);
+    int dest_spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
+    if (dest_is_cx || dest_spill) {
+        x86_operand_t scratch = x86_op_reg(REGALLOC_SCRATCH_REG, size);
+        int count_in_scratch = ra && ins->src2 > 0 &&
+                               ra->loc[ins->src2] == REGALLOC_SCRATCH_REG;
+        if (count_in_scratch && ins->src1 > 0 && ra->loc[ins->src1] == 2) {
+            /* value and count sit in each other's register */
+            x86_emit_op(code, X86_XCHG, sfx, cx, scratch);
+        } else if (count_in_scratch) {
+            x86_emit_mov(code, sfx, scratch, cx);
+            x86_emit_mov(code, sfx, x86_op_loc(ra, ins->src1, x64, size),
+                         scratch);
+        } else {
+            x86_emit_mov(code, sfx, x86_op_loc(ra, ins->src1, x64, size),
+                         scratch);
+            emit_move_to(code, sfx, x86_op_loc(ra, ins->src2, x64, size), cx);
+        }
+        emit_shift_cl(code, op, sfx, scratch);
+        x86_emit_mov(code, sfx, scratch, x86_op_loc(ra, ins->dest, x64, size));
     } else {
-        x86_emit_mov(sb, sfx,
-                     x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax),
-                     x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax), syntax);
-        x86_emit_mov(sb, sfx,
-                     x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax), cx, syntax);
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    %s %s, %s\n", op,
-                           x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax), cl);
-        else
-            strbuf_appendf(sb, "    %s%s %s, %s\n", op, sfx, cl,
-                           x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax));
+        x86_operand_t dest = x86_op_loc(ra, ins->dest, x64, size);
+        emit_move_to(code, sfx, x86_op_loc(ra, ins->src1, x64, size), dest);
+        emit_move_to(code, sfx, x86_op_loc(ra, ins->src2, x64, size), cx);
+        emit_shift_cl(code, op, sfx, dest);
     }
 }
 
-void emit_bitwise(strbuf_t *sb, ir_instr_t *ins,
-                  regalloc_t *ra, int x64, const char *op,
-                  asm_syntax_t syntax)
+void emit_bitwise(x86_insn_list_t *code, ir_instr_t *ins,
+                  regalloc_t *ra, int x64, x86_opcode_t op)
 {
-    char b1[32];
-    char destb[32];
-    char mem[32];
-    const char *sfx = (x64 && ins->type != TYPE_INT) ? "q" : "l";
-    int dest_spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest_reg = dest_spill ? x86_reg_str(REGALLOC_SCRATCH_REG, sfx, syntax)
-                                      : x86_loc_str(destb, ra, ins->dest, x64, sfx, syntax);
-    const char *dest_mem = x86_loc_str(mem, ra, ins->dest, x64, sfx, syntax);
-    x86_emit_mov(sb, sfx,
-                 x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax), dest_reg, syntax);
-    x86_emit_op(sb, op, sfx,
-                x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax), dest_reg, syntax);
-    if (dest_spill)
-        x86_emit_mov(sb, sfx, dest_reg, dest_mem, syntax);
+    emit_two_operand(code, ins, ra, x64, op);
 }
 
-void emit_cmp(strbuf_t *sb, ir_instr_t *ins,
-              regalloc_t *ra, int x64,
-              asm_syntax_t syntax)
+/* Move the value in src1 to dest, going through the scratch register when
+ * both live in memory. */
+void emit_copy(x86_insn_list_t *code, ir_instr_t *ins,
+               regalloc_t *ra, int x64)
 {
-    char b1[32];
-    char b2[32];
-    char destb[32];
-    const char *sfx = (x64 && ins->type != TYPE_INT) ? "q" : "l";
-    int is_unsigned = (ins->type == TYPE_UINT || ins->type == TYPE_ULONG ||
-                       ins->type == TYPE_USHORT || ins->type == TYPE_UCHAR ||
-                       ins->type == TYPE_ULLONG);
-    const char *cc = "";
+    char sfx = arith_sfx(ins, x64);
+    int size = sfx_size(sfx);
+    if (ra && ra->loc[ins->dest] == ra->loc[ins->src1])
+        return;
+    int both_spill = (ra && ra->loc[ins->dest] < 0 && ra->loc[ins->src1] < 0);
+    x86_operand_t src = x86_op_loc(ra, ins->src1, x64, size);
+    x86_operand_t dest = x86_op_loc(ra, ins->dest, x64, size);
+    if (both_spill) {
+        x86_operand_t tmp = x86_op_reg(REGALLOC_SCRATCH_REG, size);
+        x86_emit_mov(code, sfx, src, tmp);
+        src = tmp;
+    }
+    x86_emit_mov(code, sfx, src, dest);
+}
+
+void emit_cmp(x86_insn_list_t *code, ir_instr_t *ins,
+              regalloc_t *ra, int x64)
+{
+    char sfx = arith_sfx(ins, x64);
+    int size = sfx_size(sfx);
+    int is_unsigned = is_unsigned_type(ins->type);
+    x86_cc_t cc = X86_CC_E;
     switch (ins->op) {
-    case IR_CMPEQ: cc = "e"; break;
-    case IR_CMPNE: cc = "ne"; break;
-    case IR_CMPLT: cc = is_unsigned ? "b" : "l"; break;
-    case IR_CMPGT: cc = is_unsigned ? "a" : "g"; break;
-    case IR_CMPLE: cc = is_unsigned ? "be" : "le"; break;
-    case IR_CMPGE: cc = is_unsigned ? "ae" : "ge"; break;
+    case IR_CMPEQ: cc = X86_CC_E; break;
+    case IR_CMPNE: cc = X86_CC_NE; break;
+    case IR_CMPLT: cc = is_unsigned ? X86_CC_B : X86_CC_L; break;
+    case IR_CMPGT: cc = is_unsigned ? X86_CC_A : X86_CC_G; break;
+    case IR_CMPLE: cc = is_unsigned ? X86_CC_BE : X86_CC_LE; break;
+    case IR_CMPGE: cc = is_unsigned ? X86_CC_AE : X86_CC_GE; break;
     default: break;
     }
-    const char *al = x86_fmt_reg("%al", syntax);
+    x86_operand_t al = x86_reg(X86_AX, 1);
 
     int src1_spill = (ra && ins->src1 > 0 && ra->loc[ins->src1] < 0);
     int src2_spill = (ra && ins->src2 > 0 && ra->loc[ins->src2] < 0);
-    int dest_spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
 
-    const char *lhs;
-    if (src1_spill || src2_spill || dest_spill) {
-        const char *scratch = x86_reg_str(REGALLOC_SCRATCH_REG, sfx, syntax);
-        x86_emit_mov(sb, sfx,
-                     x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax), scratch,
-                     syntax);
+    x86_operand_t lhs = x86_op_loc(ra, ins->src1, x64, size);
+    if (src1_spill && src2_spill) {
+        x86_operand_t scratch = x86_op_reg(REGALLOC_SCRATCH_REG, size);
+        x86_emit_mov(code, sfx, lhs, scratch);
         lhs = scratch;
-    } else {
-        lhs = x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax);
     }
 
-    const char *rhs = x86_loc_str(b2, ra, ins->src2, x64, sfx, syntax);
-    x86_emit_op(sb, "cmp", sfx, rhs, lhs, syntax);
-    strbuf_appendf(sb, "    set%s %s\n", cc, al);
+    x86_emit_op(code, X86_CMP, sfx, x86_op_loc(ra, ins->src2, x64, size), lhs);
+    x86_emit_cc(code, X86_SETCC, cc, al);
     int loc = ra ? ra->loc[ins->dest] : 0;
-    const char *dest = x86_loc_str(destb, ra, ins->dest, x64, sfx, syntax);
-    const char *movz = (x64 && strcmp(sfx, "q") == 0) ? "movzbq" : "movzbl";
+    x86_operand_t dest = x86_op_loc(ra, ins->dest, x64, size);
     if (loc < 0) {
-        /* Destination on stack: write byte, then zero-extend via scratch register. */
-        x86_emit_mov(sb, "b", al, dest, syntax);
-        const char *ax = x86_reg_str(0, sfx, syntax);
-        strbuf_appendf(sb, "    %s %s, %s\n", movz, al, ax);
-        x86_emit_mov(sb, x64 ? "q" : "l", ax, dest, syntax);
+        /*
+         * Destination on stack: write byte, then zero-extend via scratch
+         * register.  The whole slot is written, whatever the operand size.
+         */
+        char wide = x64 ? 'q' : 'l';
+        x86_operand_t ax = x86_op_reg(0, sfx_size(wide));
+        x86_emit_mov(code, 'b', al, dest);
+        x86_emit2(code, X86_MOVZB, wide, al, ax);
+        x86_emit_mov(code, wide, ax, dest);
     } else {
         /* Destination in register: zero-extend directly. */
-        strbuf_appendf(sb, "    %s %s, %s\n", movz, al, dest);
+        x86_emit2(code, X86_MOVZB, (x64 && sfx == 'q') ? 'q' : 'l', al, dest);
     }
 }
 
 
-static void emit_logical_op(strbuf_t *sb, ir_instr_t *ins,
-                            regalloc_t *ra, int x64,
-                            asm_syntax_t syntax,
-                            const char *jcc, int val)
+static void emit_logical_op(x86_insn_list_t *code, ir_instr_t *ins,
+                            regalloc_t *ra, int x64, x86_cc_t jcc, int val)
 {
-    char b1[32];
-    char b2[32];
-    const char *sfx = (x64 && ins->type != TYPE_INT) ? "q" : "l";
+    char sfx = arith_sfx(ins, x64);
+    int size = sfx_size(sfx);
     int id = label_next_id();
-    char lab[32];
-    char end[32];
-    const char *suf = val ? "_true" : "_false";
-
-    if (!label_format_suffix("L", id, suf, lab) ||
-        !label_format_suffix("L", id, "_end", end))
-        return;
+    x86_operand_t lab = x86_label(id, val ? "_true" : "_false");
+    x86_operand_t end = x86_label(id, "_end");
+    x86_operand_t al = x86_reg(X86_AX, 1);
 
-    const char *al = x86_fmt_reg("%al", syntax);
-    x86_emit_mov(sb, sfx,
-                 x86_loc_str(b1, ra, ins->src1, x64, sfx, syntax),
-                 x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax), syntax);
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    cmp%s %s, 0\n", sfx,
-                       x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax));
-    else
-        strbuf_appendf(sb, "    cmp%s $0, %s\n", sfx,
-                       x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax));
-    strbuf_appendf(sb, "    %s %s\n", jcc, lab);
-    x86_emit_mov(sb, sfx,
-                 x86_loc_str(b1, ra, ins->src2, x64, sfx, syntax),
-                 x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax), syntax);
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    cmp%s %s, 0\n", sfx,
-                       x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax));
-    else
-        strbuf_appendf(sb, "    cmp%s $0, %s\n", sfx,
-                       x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax));
-    strbuf_appendf(sb, "    setne %s\n", al);
-    const char *movz = (x64 && strcmp(sfx, "q") == 0) ? "movzbq" : "movzbl";
-    strbuf_appendf(sb, "    %s %s, %s\n", movz, al,
-                   x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax));
-    strbuf_appendf(sb, "    jmp %s\n", end);
-    strbuf_appendf(sb, "%s:\n", lab);
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    mov%s %s, %d\n", sfx,
-                       x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax), val);
-    else
-        strbuf_appendf(sb, "    mov%s $%d, %s\n", sfx, val,
-                       x86_loc_str(b2, ra, ins->dest, x64, sfx, syntax));
-    strbuf_appendf(sb, "%s:\n", end);
+    x86_emit2(code, X86_CMP, sfx, x86_imm(0),
+              x86_op_loc(ra, ins->src1, x64, size));
+    x86_emit_cc(code, X86_JCC, jcc, lab);
+    x86_emit2(code, X86_CMP, sfx, x86_imm(0),
+              x86_op_loc(ra, ins->src2, x64, size));
+    x86_emit_cc(code, X86_SETCC, X86_CC_NE, al);
+    /* a spilled result is widened in the scratch register first */
+    int dest_spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
+    x86_operand_t dest = x86_op_loc(ra, ins->dest, x64, size);
+    x86_operand_t wide = dest_spill ? x86_op_reg(REGALLOC_SCRATCH_REG, size)
+                                    : dest;
+    x86_emit2(code, X86_MOVZB, (x64 && sfx == 'q') ? 'q' : 'l', al, wide);
+    if (dest_spill)
+        x86_emit_mov(code, sfx, wide, dest);
+    x86_emit1(code, X86_JMP, 0, end);
+    x86_emit1(code, X86_LABEL, 0, lab);
+    x86_emit2(code, X86_MOV, sfx, x86_imm(val), dest);
+    x86_emit1(code, X86_LABEL, 0, end);
 }
 
-void emit_logand(strbuf_t *sb, ir_instr_t *ins,
-                 regalloc_t *ra, int x64,
-                 asm_syntax_t syntax)
+void emit_logand(x86_insn_list_t *code, ir_instr_t *ins,
+                 regalloc_t *ra, int x64)
 {
-    emit_logical_op(sb, ins, ra, x64, syntax, "je", 0);
+    emit_logical_op(code, ins, ra, x64, X86_CC_E, 0);
 }
 
-void emit_logor(strbuf_t *sb, ir_instr_t *ins,
-                regalloc_t *ra, int x64,
-                asm_syntax_t syntax)
+void emit_logor(x86_insn_list_t *code, ir_instr_t *ins,
+                regalloc_t *ra, int x64)
 {
-    emit_logical_op(sb, ins, ra, x64, syntax, "jne", 1);
+    emit_logical_op(code, ins, ra, x64, X86_CC_NE, 1);
 }
 
-void emit_arith_instr(strbuf_t *sb, ir_instr_t *ins,
-                      regalloc_t *ra, int x64,
-                      asm_syntax_t syntax)
+void emit_arith_instr(x86_insn_list_t *code, ir_instr_t *ins,
+                      regalloc_t *ra, int x64)
 {
     switch (ins->op) {
     case IR_PTR_ADD: case IR_PTR_DIFF:
-        emit_ptr_arith(sb, ins, ra, x64, syntax);
+        emit_ptr_arith(code, ins, ra, x64);
         break;
     case IR_FADD:
-        emit_float_binop(sb, ins, ra, x64, "addss", syntax);
+        emit_float_binop(code, ins, ra, x64, X86_ADDSS);
         break;
     case IR_FSUB:
-        emit_float_binop(sb, ins, ra, x64, "subss", syntax);
+        emit_float_binop(code, ins, ra, x64, X86_SUBSS);
         break;
     case IR_FMUL:
-        emit_float_binop(sb, ins, ra, x64, "mulss", syntax);
+        emit_float_binop(code, ins, ra, x64, X86_MULSS);
         break;
     case IR_FDIV:
-        emit_float_binop(sb, ins, ra, x64, "divss", syntax);
+        emit_float_binop(code, ins, ra, x64, X86_DIVSS);
         break;
     case IR_LFADD:
-        emit_long_float_binop(sb, ins, ra, x64, "faddp", syntax);
+        emit_long_float_binop(code, ins, ra, x64, X86_FADDP);
         break;
     case IR_LFSUB:
-        emit_long_float_binop(sb, ins, ra, x64, "fsubp", syntax);
+        emit_long_float_binop(code, ins, ra, x64, X86_FSUBP);
         break;
     case IR_LFMUL:
-        emit_long_float_binop(sb, ins, ra, x64, "fmulp", syntax);
+        emit_long_float_binop(code, ins, ra, x64, X86_FMULP);
         break;
     case IR_LFDIV:
-        emit_long_float_binop(sb, ins, ra, x64, "fdivp", syntax);
+        emit_long_float_binop(code, ins, ra, x64, X86_FDIVP);
         break;
     case IR_CPLX_ADD:
-        emit_cplx_addsub(sb, ins, ra, x64, "add", syntax);
+        emit_cplx_addsub(code, ins, ra, x64, X86_ADDSD);
         break;
     case IR_CPLX_SUB:
-        emit_cplx_addsub(sb, ins, ra, x64, "sub", syntax);
+        emit_cplx_addsub(code, ins, ra, x64, X86_SUBSD);
         break;
     case IR_CPLX_MUL:
-        emit_cplx_mul(sb, ins, ra, x64, syntax);
+        emit_cplx_mul(code, ins, ra, x64);
         break;
     case IR_CPLX_DIV:
-        emit_cplx_div(sb, ins, ra, x64, syntax);
+        emit_cplx_div(code, ins, ra, x64);
         break;
     case IR_ADD:
-        emit_int_arith(sb, ins, ra, x64, "add", syntax);
+        emit_int_arith(code, ins, ra, x64, X86_ADD);
         break;
     case IR_SUB:
-        emit_int_arith(sb, ins, ra, x64, "sub", syntax);
+        emit_int_arith(code, ins, ra, x64, X86_SUB);
         break;
     case IR_MUL:
-        emit_int_arith(sb, ins, ra, x64, "imul", syntax);
+        emit_int_arith(code, ins, ra, x64, X86_IMUL);
         break;
     case IR_DIV:
-        emit_div(sb, ins, ra, x64, syntax);
+        emit_div(code, ins, ra, x64);
         break;
     case IR_MOD:
-        emit_mod(sb, ins, ra, x64, syntax);
+        emit_mod(code, ins, ra, x64);
         break;
     case IR_SHL:
-        emit_shift(sb, ins, ra, x64, "sal", syntax);
+        emit_shift(code, ins, ra, x64, X86_SAL);
         break;
     case IR_SHR:
-        emit_shift(sb, ins, ra, x64, "sar", syntax);
+        emit_shift(code, ins, ra, x64, X86_SAR);
         break;
     case IR_AND:
-        emit_bitwise(sb, ins, ra, x64, "and", syntax);
+        emit_bitwise(code, ins, ra, x64, X86_AND);
         break;
     case IR_OR:
-        emit_bitwise(sb, ins, ra, x64, "or", syntax);
+        emit_bitwise(code, ins, ra, x64, X86_OR);
         break;
     case IR_XOR:
-        emit_bitwise(sb, ins, ra, x64, "xor", syntax);
+        emit_bitwise(code, ins, ra, x64, X86_XOR);
         break;
     case IR_CAST:
-        emit_cast(sb, ins, ra, x64, syntax);
+        emit_cast(code, ins, ra, x64);
         break;
     case IR_CMPEQ: case IR_CMPNE: case IR_CMPLT: case IR_CMPGT:
     case IR_CMPLE: case IR_CMPGE:
-        emit_cmp(sb, ins, ra, x64, syntax);
+        emit_cmp(code, ins, ra, x64);
         break;
     case IR_LOGAND:
-        emit_logand(sb, ins, ra, x64, syntax);
+        emit_logand(code, ins, ra, x64);
         break;
     case IR_LOGOR:
-        emit_logor(sb, ins, ra, x64, syntax);
+        emit_logor(code, ins, ra, x64);
+        break;
+    case IR_COPY:
+        emit_copy(code, ins, ra, x64);
         break;
     default:
         break;
     }
 }
-
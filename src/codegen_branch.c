@@ -14,74 +14,15 @@
 #include "codegen_branch.h"
 #include "regalloc_x86.h"
 #include "codegen_mem.h"
+#include "codegen_x86.h"
 
 
 extern int export_syms;
 extern size_t arg_stack_bytes;
 extern int dwarf_enabled;
 
-/* Forward declarations for small helpers. */
-static void emit_return(strbuf_t *sb, ir_instr_t *ins,
-                        regalloc_t *ra, int x64,
-                        const char *ax, asm_syntax_t syntax);
-static void emit_call(strbuf_t *sb, ir_instr_t *ins,
-                      regalloc_t *ra, int x64,
-                      const char *sfx, const char *ax, const char *sp,
-                      asm_syntax_t syntax);
-static void emit_func_frame(strbuf_t *sb, ir_instr_t *ins,
-                            regalloc_t *ra, int x64,
-                            const char *sfx, const char *bp, const char *sp,
-                            asm_syntax_t syntax);
-static void emit_jumps(strbuf_t *sb, ir_instr_t *ins,
-                       regalloc_t *ra, int x64,
-                       const char *sfx, asm_syntax_t syntax);
-static void emit_alloca(strbuf_t *sb, ir_instr_t *ins,
-                        regalloc_t *ra, int x64,
-                        const char *sfx, const char *sp, const char *ax,
-                        asm_syntax_t syntax);
-
-/* Return the register or stack location string for `id`. */
-/* Format a register name for the requested syntax. */
-static const char *reg_str(int reg, asm_syntax_t syntax)
-{
-    const char *name = regalloc_reg_name(reg);
-    if (syntax == ASM_INTEL && name[0] == '%')
-        return name + 1;
-    return name;
-}
-
-static const char *fmt_reg(const char *name, asm_syntax_t syntax)
-{
-    if (syntax == ASM_INTEL && name[0] == '%')
-        return name + 1;
-    return name;
-}
-
-/* Helper returning the textual location of operand `id`. */
-static const char *loc_str(char buf[32], regalloc_t *ra, int id, int x64,
-                           asm_syntax_t syntax)
-{
-    if (!ra || id <= 0)
-        return "";
-    int loc = ra->loc[id];
-    if (loc >= 0)
-        return reg_str(loc, syntax);
-    if (x64) {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[rbp-%d]", -loc * 8);
-        else
-            snprintf(buf, 32, "-%d(%%rbp)", -loc * 8);
-    } else {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[ebp-%d]", -loc * 4);
-        else
-            snprintf(buf, 32, "-%d(%%ebp)", -loc * 4);
-    }
-    return buf;
-}
-
 /* Map a type to the appropriate mov instruction suffix. */
-static const char *mov_sfx_from_type(type_kind_t t, int x64)
+static char mov_sfx_from_type(type_kind_t t, int x64)
 {
     size_t size;
     switch (t) {
@@ -103,352 +44,237 @@ static const char *mov_sfx_from_type(type_kind_t t, int x64)
         size = x64 ? 8 : 4; break;
     }
     switch (size) {
-    case 1: return "b";
-    case 2: return "w";
-    case 4: return "l";
-    default: return "q";
+    case 1: return 'b';
+    case 2: return 'w';
+    case 4: return 'l';
+    default: return 'q';
     }
 }
 
+/*
+ * Callee-saved registers written by the function being emitted and the
+ * frame offset below which their save slots start.
+ */
+static unsigned saved_regs;
+static int saved_base;
+
+/* Return the callee-saved registers the function starting at BEGIN writes */
+static unsigned find_saved_regs(ir_instr_t *begin, regalloc_t *ra)
+{
+    if (!ra || !ra->loc)
+        return 0;
+    const regalloc_target_t *tgt = regalloc_target();
+    unsigned used = 0;
+    for (ir_instr_t *ins = begin->next; ins && ins->op != IR_FUNC_END;
+         ins = ins->next) {
+        if (ins->dest > 0 && ra->loc[ins->dest] >= 0)
+            used |= REGALLOC_REG_BIT(ra->loc[ins->dest]);
+        /* stores of spilled values may go through the second scratch */
+        if (ins->op == IR_STORE_PTR || ins->op == IR_STORE_IDX)
+            used |= REGALLOC_REG_BIT(tgt->scratch2);
+    }
+    return used & tgt->callee_saved;
+}
+
+/* Move the saved registers to their slots or back when RESTORE is set */
+static void emit_saved_regs(x86_insn_list_t *code, int x64, int restore)
+{
+    int word = x64 ? 8 : 4;
+    int off = saved_base;
+    char sfx = x64 ? 'q' : 'l';
+    for (int r = 0; r < REGALLOC_NUM_REGS; r++) {
+        if (!(saved_regs & REGALLOC_REG_BIT(r)))
+            continue;
+        off += word;
+        x86_operand_t reg = x86_op_reg(r, word);
+        x86_operand_t slot = x86_op_frame(off, x64);
+        if (restore)
+            x86_emit2(code, X86_MOV, sfx, slot, reg);
+        else
+            x86_emit2(code, X86_MOV, sfx, reg, slot);
+    }
+}
+
+/* Restore the saved registers, tear down the frame and return. */
+static void emit_epilogue(x86_insn_list_t *code, int x64)
+{
+    int word = x64 ? 8 : 4;
+    char sfx = x64 ? 'q' : 'l';
+    x86_operand_t bp = x86_reg(X86_BP, word);
+    emit_saved_regs(code, x64, 1);
+    x86_emit2(code, X86_MOV, sfx, bp, x86_reg(X86_SP, word));
+    x86_emit1(code, X86_POP, sfx, bp);
+    x86_emit0(code, X86_RET, 0);
+}
+
 /* Emit a return instruction (IR_RETURN or IR_RETURN_AGG). */
-static void emit_return(strbuf_t *sb, ir_instr_t *ins,
-                        regalloc_t *ra, int x64,
-                        const char *ax, asm_syntax_t syntax)
+static void emit_return(x86_insn_list_t *code, ir_instr_t *ins,
+                        regalloc_t *ra, int x64, x86_operand_t ax)
 {
-    char buf[32];
+    int word = x64 ? 8 : 4;
     int loc = ra ? ra->loc[ins->src1] : -1;
-    const char *src = loc_str(buf, ra, ins->src1, x64, syntax);
+    x86_operand_t src = x86_op_loc(ra, ins->src1, x64, word);
 
     if (ins->type == TYPE_FLOAT || ins->type == TYPE_DOUBLE) {
-        const char *xmm0 = fmt_reg("%xmm0", syntax);
-        const char *ld = (ins->type == TYPE_FLOAT) ? "movss" : "movsd";
-        const char *ldint = (ins->type == TYPE_FLOAT) ? "movd" : (x64 ? "movq" : "movd");
-        if (loc >= 0) {
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    %s %s, %s\n", ldint, xmm0, src);
-            else
-                strbuf_appendf(sb, "    %s %s, %s\n", ldint, src, xmm0);
-        } else {
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    %s %s, %s\n", ld, xmm0, src);
-            else
-                strbuf_appendf(sb, "    %s %s, %s\n", ld, src, xmm0);
-        }
-        if (ins->op == IR_RETURN_AGG) {
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    %s [%s], %s\n", ld, ax, xmm0);
-            else
-                strbuf_appendf(sb, "    %s %s, (%s)\n", ld, xmm0, ax);
-        }
-        const char *bp = fmt_reg(x64 ? "%rbp" : "%ebp", syntax);
-        const char *sp = fmt_reg(x64 ? "%rsp" : "%esp", syntax);
-        const char *rsfx = x64 ? "q" : "l";
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", rsfx, sp, bp);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", rsfx, bp, sp);
-        strbuf_appendf(sb, "    pop%s %s\n", rsfx, bp);
-        strbuf_append(sb, "    ret\n");
+        x86_operand_t xmm0 = x86_op_xmm(0);
+        x86_opcode_t ld = (ins->type == TYPE_FLOAT) ? X86_MOVSS : X86_MOVSD;
+        x86_opcode_t ldint = (ins->type == TYPE_DOUBLE && x64) ? X86_MOVQ
+                                                                : X86_MOVD;
+        x86_emit2(code, loc >= 0 ? ldint : ld, 0, src, xmm0);
+        if (ins->op == IR_RETURN_AGG)
+            x86_emit2(code, ld, 0, xmm0, x86_op_deref(ax));
+        emit_epilogue(code, x64);
         return;
     } else if (ins->type == TYPE_LDOUBLE) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    fld tword ptr %s\n", src);
-        else
-            strbuf_appendf(sb, "    fldt %s\n", src);
-        if (ins->op == IR_RETURN_AGG) {
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    fstp tword ptr [%s]\n", ax);
-            else
-                strbuf_appendf(sb, "    fstpt (%s)\n", ax);
-        }
-        const char *bp = fmt_reg(x64 ? "%rbp" : "%ebp", syntax);
-        const char *sp = fmt_reg(x64 ? "%rsp" : "%esp", syntax);
-        const char *rsfx = x64 ? "q" : "l";
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", rsfx, sp, bp);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", rsfx, bp, sp);
-        strbuf_appendf(sb, "    pop%s %s\n", rsfx, bp);
-        strbuf_append(sb, "    ret\n");
+        x86_emit1(code, X86_FLDT, 0, src);
+        if (ins->op == IR_RETURN_AGG)
+            x86_emit1(code, X86_FSTPT, 0, x86_op_deref(ax));
+        emit_epilogue(code, x64);
         return;
     }
 
-    const char *msfx = mov_sfx_from_type(ins->type, x64);
-    const char *retreg = ax;
-    const char *src_reg = src;
-    static const char *reg32[6] = {"%eax","%ebx","%ecx","%edx","%esi","%edi"};
-    if (x64 && msfx[0] == 'l') {
+    char msfx = mov_sfx_from_type(ins->type, x64);
+    x86_operand_t retreg = ax;
+    x86_operand_t src_reg = src;
+    if (x64 && msfx == 'l') {
         if (ins->op == IR_RETURN)
-            retreg = fmt_reg("%eax", syntax);
-        if (loc >= 0 && loc < 6)
-            src_reg = fmt_reg(reg32[loc], syntax);
+            retreg = x86_reg(X86_AX, 4);
+        if (loc >= 0)
+            src_reg = x86_op_reg(loc, 4);
     }
     if (ins->op == IR_RETURN) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", msfx, retreg, src_reg);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", msfx, src_reg, retreg);
+        /* the allocator may already have placed the value there */
+        if (!x86_operand_equal(&src_reg, &retreg))
+            x86_emit2(code, X86_MOV, msfx, src_reg, retreg);
     } else { /* IR_RETURN_AGG */
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s [%s], %s\n", msfx, ax, src_reg);
-        else
-            strbuf_appendf(sb, "    mov%s %s, (%s)\n", msfx, src_reg, ax);
+        x86_emit2(code, X86_MOV, msfx, src_reg, x86_op_deref(ax));
     }
-    const char *bp = fmt_reg(x64 ? "%rbp" : "%ebp", syntax);
-    const char *sp = fmt_reg(x64 ? "%rsp" : "%esp", syntax);
-    const char *rsfx = x64 ? "q" : "l";
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    mov%s %s, %s\n", rsfx, sp, bp);
-    else
-        strbuf_appendf(sb, "    mov%s %s, %s\n", rsfx, bp, sp);
-    strbuf_appendf(sb, "    pop%s %s\n", rsfx, bp);
-    strbuf_append(sb, "    ret\n");
+    emit_epilogue(code, x64);
 }
 
-/* Emit a call instruction (IR_CALL).
- * Stack space for arguments and alignment is always restored with an
- * add instruction when non-zero. */
-static void emit_call(strbuf_t *sb, ir_instr_t *ins,
-                      regalloc_t *ra, int x64,
-                      const char *sfx, const char *ax, const char *sp,
-                      asm_syntax_t syntax)
-{
-    char buf[32];
-    const char *msfx = mov_sfx_from_type(ins->type, x64);
-    size_t align = 0;
-    if (x64)
-        align = (16 - (arg_stack_bytes % 16)) % 16;
-    if (align > 0) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    sub%s %s, %zu\n", sfx, sp, align);
-        else
-            strbuf_appendf(sb, "    sub%s $%zu, %s\n", sfx, align, sp);
-    }
-    strbuf_appendf(sb, "    call %s\n", ins->name);
-    size_t total = arg_stack_bytes + align;
-    /* Always restore any stack space used for arguments or alignment,
-       regardless of the instruction's immediate. */
-    if (total > 0) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    add%s %s, %zu\n", sfx, sp, total);
-        else
-            strbuf_appendf(sb, "    add%s $%zu, %s\n", sfx, total, sp);
-    }
-    arg_stack_bytes = 0;
-    arg_reg_idx = 0;
-    float_reg_idx = 0;
-    if (ins->dest > 0) {
-        const char *dst = loc_str(buf, ra, ins->dest, x64, syntax);
-        int dloc = ra ? ra->loc[ins->dest] : -1;
-        if (ins->type == TYPE_FLOAT || ins->type == TYPE_DOUBLE) {
-            const char *xmm0 = fmt_reg("%xmm0", syntax);
-            const char *movm = (ins->type == TYPE_FLOAT) ? "movss" : "movsd";
-            const char *movi = (ins->type == TYPE_FLOAT) ? "movd" : (x64 ? "movq" : "movd");
-            if (dloc >= 0) {
-                if (syntax == ASM_INTEL)
-                    strbuf_appendf(sb, "    %s %s, %s\n", movi, dst, xmm0);
-                else
-                    strbuf_appendf(sb, "    %s %s, %s\n", movi, xmm0, dst);
-            } else {
-                if (syntax == ASM_INTEL)
-                    strbuf_appendf(sb, "    %s %s, %s\n", movm, dst, xmm0);
-                else
-                    strbuf_appendf(sb, "    %s %s, %s\n", movm, xmm0, dst);
-            }
-        } else if (ins->type == TYPE_LDOUBLE) {
-            if (syntax == ASM_INTEL) {
-                strbuf_appendf(sb, "    fstp tword ptr %s\n", dst);
-                strbuf_appendf(sb, "    fld tword ptr %s\n", dst);
-            } else {
-                strbuf_appendf(sb, "    fstpt %s\n", dst);
-                strbuf_appendf(sb, "    fldt %s\n", dst);
-            }
-        } else {
-            const char *retreg = ax;
-            if (x64 && msfx[0] == 'l')
-                retreg = fmt_reg("%eax", syntax);
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    mov%s %s, %s\n", msfx, dst, retreg);
-            else
-                strbuf_appendf(sb, "    mov%s %s, %s\n", msfx, retreg, dst);
-        }
-    }
-}
-
-/* Emit an indirect call instruction (IR_CALL_PTR).
+/*
+ * Emit a direct (IR_CALL) or indirect (IR_CALL_PTR) call to TARGET.
  * Stack space for arguments and alignment is always restored with an
- * add instruction when non-zero. */
-static void emit_call_ptr(strbuf_t *sb, ir_instr_t *ins,
-                          regalloc_t *ra, int x64,
-                          const char *sfx, const char *ax, const char *sp,
-                          asm_syntax_t syntax)
+ * add instruction when non-zero.
+ */
+static void emit_call(x86_insn_list_t *code, ir_instr_t *ins,
+                      regalloc_t *ra, int x64, x86_operand_t target,
+                      x86_operand_t ax, x86_operand_t sp)
 {
-    char buf[32];
-    const char *msfx = mov_sfx_from_type(ins->type, x64);
+    char sfx = x64 ? 'q' : 'l';
+    char msfx = mov_sfx_from_type(ins->type, x64);
     size_t align = 0;
     if (x64)
         align = (16 - (arg_stack_bytes % 16)) % 16;
-    if (align > 0) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    sub%s %s, %zu\n", sfx, sp, align);
-        else
-            strbuf_appendf(sb, "    sub%s $%zu, %s\n", sfx, align, sp);
-    }
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    call %s\n", loc_str(buf, ra, ins->src1, x64, syntax));
-    else
-        strbuf_appendf(sb, "    call *%s\n", loc_str(buf, ra, ins->src1, x64, syntax));
+    if (align > 0)
+        x86_emit2(code, X86_SUB, sfx, x86_imm((long long)align), sp);
+    x86_emit1(code, X86_CALL, 0, target);
     size_t total = arg_stack_bytes + align;
     /* Always restore any stack space used for arguments or alignment,
        regardless of the instruction's immediate. */
-    if (total > 0) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    add%s %s, %zu\n", sfx, sp, total);
-        else
-            strbuf_appendf(sb, "    add%s $%zu, %s\n", sfx, total, sp);
-    }
+    if (total > 0)
+        x86_emit2(code, X86_ADD, sfx, x86_imm((long long)total), sp);
     arg_stack_bytes = 0;
     arg_reg_idx = 0;
     float_reg_idx = 0;
     if (ins->dest > 0) {
-        const char *dst = loc_str(buf, ra, ins->dest, x64, syntax);
+        x86_operand_t dst = x86_op_loc(ra, ins->dest, x64, x64 ? 8 : 4);
         int dloc = ra ? ra->loc[ins->dest] : -1;
         if (ins->type == TYPE_FLOAT || ins->type == TYPE_DOUBLE) {
-            const char *xmm0 = fmt_reg("%xmm0", syntax);
-            const char *movm = (ins->type == TYPE_FLOAT) ? "movss" : "movsd";
-            const char *movi = (ins->type == TYPE_FLOAT) ? "movd" : (x64 ? "movq" : "movd");
-            if (dloc >= 0) {
-                if (syntax == ASM_INTEL)
-                    strbuf_appendf(sb, "    %s %s, %s\n", movi, dst, xmm0);
-                else
-                    strbuf_appendf(sb, "    %s %s, %s\n", movi, xmm0, dst);
-            } else {
-                if (syntax == ASM_INTEL)
-                    strbuf_appendf(sb, "    %s %s, %s\n", movm, dst, xmm0);
-                else
-                    strbuf_appendf(sb, "    %s %s, %s\n", movm, xmm0, dst);
-            }
+            x86_opcode_t movm = (ins->type == TYPE_FLOAT) ? X86_MOVSS
+                                                          : X86_MOVSD;
+            x86_opcode_t movi = (ins->type == TYPE_DOUBLE && x64) ? X86_MOVQ
+                                                                   : X86_MOVD;
+            x86_emit2(code, dloc >= 0 ? movi : movm, 0, x86_op_xmm(0), dst);
         } else if (ins->type == TYPE_LDOUBLE) {
-            if (syntax == ASM_INTEL) {
-                strbuf_appendf(sb, "    fstp tword ptr %s\n", dst);
-                strbuf_appendf(sb, "    fld tword ptr %s\n", dst);
-            } else {
-                strbuf_appendf(sb, "    fstpt %s\n", dst);
-                strbuf_appendf(sb, "    fldt %s\n", dst);
-            }
+            x86_emit1(code, X86_FSTPT, 0, dst);
+            x86_emit1(code, X86_FLDT, 0, dst);
         } else {
-            const char *retreg = ax;
-            if (x64 && msfx[0] == 'l')
-                retreg = fmt_reg("%eax", syntax);
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    mov%s %s, %s\n", msfx, dst, retreg);
-            else
-                strbuf_appendf(sb, "    mov%s %s, %s\n", msfx, retreg, dst);
+            x86_operand_t retreg = ax;
+            if (x64 && msfx == 'l')
+                retreg = x86_reg(X86_AX, 4);
+            if (x86_operand_equal(&dst, &retreg))
+                return;
+            x86_emit2(code, X86_MOV, msfx, retreg, dst);
         }
     }
 }
 
 /* Emit function prologue and epilogue. */
-static void emit_func_frame(strbuf_t *sb, ir_instr_t *ins,
+static void emit_func_frame(x86_insn_list_t *code, ir_instr_t *ins,
                             regalloc_t *ra, int x64,
-                            const char *sfx, const char *bp, const char *sp,
-                            asm_syntax_t syntax)
+                            x86_operand_t bp, x86_operand_t sp)
 {
     static const char *cur_func = NULL;
+    char sfx = x64 ? 'q' : 'l';
     if (ins->op == IR_FUNC_BEGIN) {
         if (export_syms)
-            strbuf_appendf(sb, ".globl %s\n", ins->name);
+            x86_emit1(code, X86_GLOBL, 0, x86_sym(ins->name));
         if (dwarf_enabled)
-            strbuf_appendf(sb, ".type %s, @function\n", ins->name);
-        strbuf_appendf(sb, "%s:\n", ins->name);
-        strbuf_appendf(sb, "    push%s %s\n", sfx, bp);
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, bp, sp);
+            x86_emit1(code, X86_TYPE_FUNC, 0, x86_sym(ins->name));
+        x86_emit1(code, X86_LABEL, 0, x86_sym(ins->name));
+        x86_emit1(code, X86_PUSH, sfx, bp);
+        x86_emit2(code, X86_MOV, sfx, sp, bp);
+        int word = x64 ? 8 : 4;
+        int frame = ra ? ra->stack_slots * word : 0;
+        /* spill slots start at the first word past the locals */
+        if (frame)
+            frame += ((int)ins->imm + word - 1) / word * word;
         else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, sp, bp);
-        int frame = ra ? ra->stack_slots * (x64 ? 8 : 4) : 0;
-        frame += (int)ins->imm;
+            frame += (int)ins->imm;
+        /* callee-saved registers go below the locals and spill slots */
+        saved_regs = find_saved_regs(ins, ra);
+        saved_base = (frame + word - 1) / word * word;
+        if (saved_regs) {
+            frame = saved_base;
+            for (unsigned m = saved_regs; m; m &= m - 1)
+                frame += word;
+        }
         if (x64 && frame % 16 != 0)
             frame += 16 - (frame % 16);
-        if (frame != 0) {
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    sub%s %s, %d\n", sfx, sp, frame);
-            else
-                strbuf_appendf(sb, "    sub%s $%d, %s\n", sfx, frame, sp);
-        }
+        if (frame != 0)
+            x86_emit2(code, X86_SUB, sfx, x86_imm(frame), sp);
+        emit_saved_regs(code, x64, 0);
         cur_func = ins->name;
     } else { /* IR_FUNC_END */
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, sp, bp);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, bp, sp);
-        strbuf_appendf(sb, "    pop%s %s\n", sfx, bp);
-        strbuf_append(sb, "    ret\n");
+        emit_epilogue(code, x64);
         if (dwarf_enabled && cur_func)
-            strbuf_appendf(sb, ".size %s, .-%s\n", cur_func, cur_func);
+            x86_emit1(code, X86_SIZE_FUNC, 0, x86_sym(cur_func));
     }
 }
 
 /* Emit unconditional and conditional jumps. */
-static void emit_jumps(strbuf_t *sb, ir_instr_t *ins,
-                       regalloc_t *ra, int x64,
-                       const char *sfx, asm_syntax_t syntax)
+static void emit_jumps(x86_insn_list_t *code, ir_instr_t *ins,
+                       regalloc_t *ra, int x64)
 {
-    char buf[32];
     if (ins->op == IR_BR) {
-        strbuf_appendf(sb, "    jmp %s\n", ins->name);
+        x86_emit1(code, X86_JMP, 0, x86_sym(ins->name));
     } else if (ins->op == IR_BCOND) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    cmp%s %s, 0\n", sfx,
-                           loc_str(buf, ra, ins->src1, x64, syntax));
-        else
-            strbuf_appendf(sb, "    cmp%s $0, %s\n", sfx,
-                           loc_str(buf, ra, ins->src1, x64, syntax));
-        strbuf_appendf(sb, "    je %s\n", ins->name);
+        x86_emit2(code, X86_CMP, x64 ? 'q' : 'l', x86_imm(0),
+                  x86_op_loc(ra, ins->src1, x64, x64 ? 8 : 4));
+        x86_emit_cc(code, X86_JCC, X86_CC_E, x86_sym(ins->name));
     } else if (ins->op == IR_LABEL) {
-        strbuf_appendf(sb, "%s:\n", ins->name);
+        x86_emit1(code, X86_LABEL, 0, x86_sym(ins->name));
     }
 }
 
 /* Emit stack allocation instruction (IR_ALLOCA). */
-static void emit_alloca(strbuf_t *sb, ir_instr_t *ins,
+static void emit_alloca(x86_insn_list_t *code, ir_instr_t *ins,
                         regalloc_t *ra, int x64,
-                        const char *sfx, const char *sp, const char *ax,
-                        asm_syntax_t syntax)
+                        x86_operand_t sp, x86_operand_t ax)
 {
-    char buf1[32];
-    char buf2[32];
+    char sfx = x64 ? 'q' : 'l';
+    int word = x64 ? 8 : 4;
+    x86_operand_t size = x86_op_loc(ra, ins->src1, x64, word);
     if (x64) {
-        if (syntax == ASM_INTEL) {
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx,
-                           loc_str(buf1, ra, ins->src1, x64, syntax), ax);
-            strbuf_appendf(sb, "    add%s %s, 15\n", sfx, ax);
-            strbuf_appendf(sb, "    and%s %s, -16\n", sfx, ax);
-            strbuf_appendf(sb, "    sub%s %s, %s\n", sfx, sp, ax);
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx,
-                           loc_str(buf2, ra, ins->dest, x64, syntax), sp);
-        } else {
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx,
-                           loc_str(buf1, ra, ins->src1, x64, syntax), ax);
-            strbuf_appendf(sb, "    add%s $15, %s\n", sfx, ax);
-            strbuf_appendf(sb, "    and%s $-16, %s\n", sfx, ax);
-            strbuf_appendf(sb, "    sub%s %s, %s\n", sfx, ax, sp);
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, sp,
-                           loc_str(buf2, ra, ins->dest, x64, syntax));
-        }
+        x86_emit2(code, X86_MOV, sfx, size, ax);
+        x86_emit2(code, X86_ADD, sfx, x86_imm(15), ax);
+        x86_emit2(code, X86_AND, sfx, x86_imm(-16), ax);
+        x86_emit2(code, X86_SUB, sfx, ax, sp);
     } else {
-        if (syntax == ASM_INTEL) {
-            strbuf_appendf(sb, "    sub%s %s, %s\n", sfx, sp,
-                           loc_str(buf1, ra, ins->src1, x64, syntax));
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx,
-                           loc_str(buf2, ra, ins->dest, x64, syntax), sp);
-        } else {
-            strbuf_appendf(sb, "    sub%s %s, %s\n", sfx,
-                           loc_str(buf1, ra, ins->src1, x64, syntax), sp);
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, sp,
-                           loc_str(buf2, ra, ins->dest, x64, syntax));
-        }
+        x86_emit2(code, X86_SUB, sfx, size, sp);
     }
+    x86_emit2(code, X86_MOV, sfx, sp, x86_op_loc(ra, ins->dest, x64, word));
 }
 
 /*
@@ -460,39 +286,38 @@ static void emit_alloca(strbuf_t *sb, ir_instr_t *ins,
  * between 32- and 64-bit mode; the `x64` flag selects the proper suffixes
  * and stack pointer registers.
  */
-void emit_branch_instr(strbuf_t *sb, ir_instr_t *ins,
-                       regalloc_t *ra, int x64,
-                       asm_syntax_t syntax)
+void emit_branch_instr(x86_insn_list_t *code, ir_instr_t *ins,
+                       regalloc_t *ra, int x64)
 {
-    const char *sfx = x64 ? "q" : "l";
-    const char *ax = fmt_reg(x64 ? "%rax" : "%eax", syntax);
-    const char *bp = fmt_reg(x64 ? "%rbp" : "%ebp", syntax);
-    const char *sp = fmt_reg(x64 ? "%rsp" : "%esp", syntax);
+    int word = x64 ? 8 : 4;
+    x86_operand_t ax = x86_reg(X86_AX, word);
+    x86_operand_t bp = x86_reg(X86_BP, word);
+    x86_operand_t sp = x86_reg(X86_SP, word);
 
     switch (ins->op) {
     case IR_RETURN:
     case IR_RETURN_AGG:
-        emit_return(sb, ins, ra, x64, ax, syntax);
+        emit_return(code, ins, ra, x64, ax);
         break;
     case IR_CALL:
     case IR_CALL_NR:
-        emit_call(sb, ins, ra, x64, sfx, ax, sp, syntax);
+        emit_call(code, ins, ra, x64, x86_sym(ins->name), ax, sp);
         break;
     case IR_CALL_PTR:
     case IR_CALL_PTR_NR:
-        emit_call_ptr(sb, ins, ra, x64, sfx, ax, sp, syntax);
+        emit_call(code, ins, ra, x64, x86_op_loc(ra, ins->src1, x64, word),
+                  ax, sp);
         break;
     case IR_FUNC_BEGIN: case IR_FUNC_END:
-        emit_func_frame(sb, ins, ra, x64, sfx, bp, sp, syntax);
+        emit_func_frame(code, ins, ra, x64, bp, sp);
         break;
     case IR_BR: case IR_BCOND: case IR_LABEL:
-        emit_jumps(sb, ins, ra, x64, sfx, syntax);
+        emit_jumps(code, ins, ra, x64);
         break;
     case IR_ALLOCA:
-        emit_alloca(sb, ins, ra, x64, sfx, sp, ax, syntax);
+        emit_alloca(code, ins, ra, x64, sp, ax);
         break;
     default:
         break;
     }
 }
-
@@ -3,114 +3,85 @@
 #include "regalloc_x86.h"
 #include "codegen_x86.h"
 
-/* Helper functions duplicated from codegen_arith.c */
-static const char *reg_str(int reg, asm_syntax_t syntax)
-{
-    const char *name = regalloc_reg_name(reg);
-    if (syntax == ASM_INTEL && name[0] == '%')
-        return name + 1;
-    return name;
-}
-
-static const char *fmt_reg(const char *name, asm_syntax_t syntax)
-{
-    if (syntax == ASM_INTEL && name[0] == '%')
-        return name + 1;
-    return name;
-}
-
 /* Compute the location of the imaginary or real part of a complex value. */
-static const char *loc_str_off(char buf[32], regalloc_t *ra, int id,
-                               int off, int x64, asm_syntax_t syntax)
+static x86_operand_t loc_str_off(regalloc_t *ra, int id, int off, int x64)
 {
     if (!ra || id <= 0)
-        return "";
+        return x86_none();
     int loc = ra->loc[id];
     if (loc >= 0)
-        return reg_str(loc, syntax);
+        return x86_op_reg(loc, 8);
     int size = x64 ? 8 : 4;
-    int disp = -loc * size + off;
-    if (syntax == ASM_INTEL)
-        snprintf(buf, 32, x64 ? "[rbp-%d]" : "[ebp-%d]", disp);
-    else
-        snprintf(buf, 32, "-%d(%s)", disp, x64 ? "%rbp" : "%ebp");
-    return buf;
+    return x86_mem(X86_BP, size, -(long long)(-loc * size + off));
 }
 
-/* Emit an SSE2 move or operation with automatic syntax selection. */
-static void emit_movsd(strbuf_t *sb, const char *src, const char *dest,
-                       asm_syntax_t syntax)
+/* Emit an SSE2 scalar double move or operation. */
+static void emit_movsd(x86_insn_list_t *code, x86_operand_t src,
+                       x86_operand_t dest)
 {
-    x86_emit_mov(sb, "sd", src, dest, syntax);
+    x86_emit2(code, X86_MOVSD, 0, src, dest);
 }
 
-static void emit_op_sd(strbuf_t *sb, const char *op,
-                       const char *src, const char *dest,
-                       asm_syntax_t syntax)
+static void emit_op_sd(x86_insn_list_t *code, x86_opcode_t op,
+                       x86_operand_t src, x86_operand_t dest)
 {
-    x86_emit_op(sb, op, "sd", src, dest, syntax);
+    x86_emit2(code, op, 0, src, dest);
 }
 
 /* Complex add/sub helper using SSE2. */
-void emit_cplx_addsub(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
-                      int x64, const char *op, asm_syntax_t syntax)
+void emit_cplx_addsub(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                      int x64, x86_opcode_t op)
 {
-    char b1[32];
-    char b2[32];
-    char b3[32];
     int r0 = regalloc_xmm_acquire();
     if (r0 < 0) {
         fprintf(stderr, "emit_cplx_addsub: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
     int r1 = regalloc_xmm_acquire();
     if (r1 < 0) {
         regalloc_xmm_release(r0);
         fprintf(stderr, "emit_cplx_addsub: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
-    const char *reg0 = fmt_reg(regalloc_xmm_name(r0), syntax);
-    const char *reg1 = fmt_reg(regalloc_xmm_name(r1), syntax);
+    x86_operand_t reg0 = x86_op_xmm(r0);
+    x86_operand_t reg1 = x86_op_xmm(r1);
 
     /* real part */
-    emit_movsd(sb, loc_str_off(b1, ra, ins->src1, 0, x64, syntax), reg0,
-               syntax);
-    emit_movsd(sb, loc_str_off(b2, ra, ins->src2, 0, x64, syntax), reg1,
-               syntax);
-    emit_op_sd(sb, op, reg1, reg0, syntax);
-    emit_movsd(sb, reg0, loc_str_off(b3, ra, ins->dest, 0, x64, syntax),
-               syntax);
+    emit_movsd(code, loc_str_off(ra, ins->src1, 0, x64), reg0);
+    emit_movsd(code, loc_str_off(ra, ins->src2, 0, x64), reg1);
+    emit_op_sd(code, op, reg1, reg0);
+    emit_movsd(code, reg0, loc_str_off(ra, ins->dest, 0, x64));
 
     /* imag part */
-    emit_movsd(sb, loc_str_off(b1, ra, ins->src1, 8, x64, syntax), reg0,
-               syntax);
-    emit_movsd(sb, loc_str_off(b2, ra, ins->src2, 8, x64, syntax), reg1,
-               syntax);
-    emit_op_sd(sb, op, reg1, reg0, syntax);
-    emit_movsd(sb, reg0, loc_str_off(b3, ra, ins->dest, 8, x64, syntax),
-               syntax);
+    emit_movsd(code, loc_str_off(ra, ins->src1, 8, x64), reg0);
+    emit_movsd(code, loc_str_off(ra, ins->src2, 8, x64), reg1);
+    emit_op_sd(code, op, reg1, reg0);
+    emit_movsd(code, reg0, loc_str_off(ra, ins->dest, 8, x64));
     regalloc_xmm_release(r1);
     regalloc_xmm_release(r0);
 }
 
 /* Complex multiplication using SSE2. */
-void emit_cplx_mul(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
-                   int x64, asm_syntax_t syntax)
+void emit_cplx_mul(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                   int x64)
 {
-    char a[32], c[32], d[32], out[32];
     int r0 = regalloc_xmm_acquire();
     if (r0 < 0) {
         fprintf(stderr, "emit_cplx_mul: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
     int r1 = regalloc_xmm_acquire();
     if (r1 < 0) {
         regalloc_xmm_release(r0);
         fprintf(stderr, "emit_cplx_mul: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
     int r2 = regalloc_xmm_acquire();
@@ -118,7 +89,8 @@ void emit_cplx_mul(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
         regalloc_xmm_release(r1);
         regalloc_xmm_release(r0);
         fprintf(stderr, "emit_cplx_mul: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
     int r3 = regalloc_xmm_acquire();
@@ -127,31 +99,32 @@ void emit_cplx_mul(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
         regalloc_xmm_release(r1);
         regalloc_xmm_release(r0);
         fprintf(stderr, "emit_cplx_mul: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
-    const char *x0 = fmt_reg(regalloc_xmm_name(r0), syntax);
-    const char *x1 = fmt_reg(regalloc_xmm_name(r1), syntax);
-    const char *x2 = fmt_reg(regalloc_xmm_name(r2), syntax);
-    const char *x3 = fmt_reg(regalloc_xmm_name(r3), syntax);
+    x86_operand_t x0 = x86_op_xmm(r0);
+    x86_operand_t x1 = x86_op_xmm(r1);
+    x86_operand_t x2 = x86_op_xmm(r2);
+    x86_operand_t x3 = x86_op_xmm(r3);
 
     /* real part: (a*c - b*d) */
-    emit_movsd(sb, loc_str_off(a, ra, ins->src1, 0, x64, syntax), x0, syntax);
-    emit_movsd(sb, loc_str_off(a, ra, ins->src1, 8, x64, syntax), x1, syntax);
-    emit_movsd(sb, loc_str_off(c, ra, ins->src2, 0, x64, syntax), x2, syntax);
-    emit_movsd(sb, loc_str_off(d, ra, ins->src2, 8, x64, syntax), x3, syntax);
-    emit_op_sd(sb, "mul", x2, x0, syntax);
-    emit_op_sd(sb, "mul", x3, x1, syntax);
-    emit_op_sd(sb, "sub", x1, x0, syntax);
-    emit_movsd(sb, x0, loc_str_off(out, ra, ins->dest, 0, x64, syntax), syntax);
+    emit_movsd(code, loc_str_off(ra, ins->src1, 0, x64), x0);
+    emit_movsd(code, loc_str_off(ra, ins->src1, 8, x64), x1);
+    emit_movsd(code, loc_str_off(ra, ins->src2, 0, x64), x2);
+    emit_movsd(code, loc_str_off(ra, ins->src2, 8, x64), x3);
+    emit_op_sd(code, X86_MULSD, x2, x0);
+    emit_op_sd(code, X86_MULSD, x3, x1);
+    emit_op_sd(code, X86_SUBSD, x1, x0);
+    emit_movsd(code, x0, loc_str_off(ra, ins->dest, 0, x64));
 
     /* imag part: (a*d + b*c) */
-    emit_movsd(sb, loc_str_off(a, ra, ins->src1, 0, x64, syntax), x0, syntax);
-    emit_op_sd(sb, "mul", x3, x0, syntax);
-    emit_movsd(sb, loc_str_off(a, ra, ins->src1, 8, x64, syntax), x1, syntax);
-    emit_op_sd(sb, "mul", x2, x1, syntax);
-    emit_op_sd(sb, "add", x1, x0, syntax);
-    emit_movsd(sb, x0, loc_str_off(out, ra, ins->dest, 8, x64, syntax), syntax);
+    emit_movsd(code, loc_str_off(ra, ins->src1, 0, x64), x0);
+    emit_op_sd(code, X86_MULSD, x3, x0);
+    emit_movsd(code, loc_str_off(ra, ins->src1, 8, x64), x1);
+    emit_op_sd(code, X86_MULSD, x2, x1);
+    emit_op_sd(code, X86_ADDSD, x1, x0);
+    emit_movsd(code, x0, loc_str_off(ra, ins->dest, 8, x64));
     regalloc_xmm_release(r3);
     regalloc_xmm_release(r2);
     regalloc_xmm_release(r1);
@@ -159,21 +132,22 @@ void emit_cplx_mul(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
 }
 
 /* Complex division using SSE2. */
-void emit_cplx_div(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
-                   int x64, asm_syntax_t syntax)
+void emit_cplx_div(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                   int x64)
 {
-    char a[32], c[32], d[32], out[32];
     int r0 = regalloc_xmm_acquire();
     if (r0 < 0) {
         fprintf(stderr, "emit_cplx_div: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
     int r1 = regalloc_xmm_acquire();
     if (r1 < 0) {
         regalloc_xmm_release(r0);
         fprintf(stderr, "emit_cplx_div: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
     int r2 = regalloc_xmm_acquire();
@@ -181,7 +155,8 @@ void emit_cplx_div(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
         regalloc_xmm_release(r1);
         regalloc_xmm_release(r0);
         fprintf(stderr, "emit_cplx_div: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
     int r3 = regalloc_xmm_acquire();
@@ -190,7 +165,8 @@ void emit_cplx_div(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
         regalloc_xmm_release(r1);
         regalloc_xmm_release(r0);
         fprintf(stderr, "emit_cplx_div: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
     int r4 = regalloc_xmm_acquire();
@@ -200,42 +176,43 @@ void emit_cplx_div(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
         regalloc_xmm_release(r1);
         regalloc_xmm_release(r0);
         fprintf(stderr, "emit_cplx_div: XMM register allocation failed\n");
-        strbuf_appendf(sb, "    # XMM register allocation failed\n");
+        x86_emit1(code, X86_COMMENT, 0,
+                  x86_sym("XMM register allocation failed"));
         return;
     }
-    const char *x0 = fmt_reg(regalloc_xmm_name(r0), syntax);
-    const char *x1 = fmt_reg(regalloc_xmm_name(r1), syntax);
-    const char *x2 = fmt_reg(regalloc_xmm_name(r2), syntax);
-    const char *x3 = fmt_reg(regalloc_xmm_name(r3), syntax);
-    const char *x4 = fmt_reg(regalloc_xmm_name(r4), syntax);
+    x86_operand_t x0 = x86_op_xmm(r0);
+    x86_operand_t x1 = x86_op_xmm(r1);
+    x86_operand_t x2 = x86_op_xmm(r2);
+    x86_operand_t x3 = x86_op_xmm(r3);
+    x86_operand_t x4 = x86_op_xmm(r4);
 
     /* denominator c*c + d*d */
-    emit_movsd(sb, loc_str_off(c, ra, ins->src2, 0, x64, syntax), x2, syntax);
-    emit_movsd(sb, loc_str_off(d, ra, ins->src2, 8, x64, syntax), x3, syntax);
-    emit_movsd(sb, x2, x4, syntax);
-    emit_op_sd(sb, "mul", x2, x2, syntax);
-    emit_op_sd(sb, "mul", x3, x3, syntax);
-    emit_op_sd(sb, "add", x3, x2, syntax);
+    emit_movsd(code, loc_str_off(ra, ins->src2, 0, x64), x2);
+    emit_movsd(code, loc_str_off(ra, ins->src2, 8, x64), x3);
+    emit_movsd(code, x2, x4);
+    emit_op_sd(code, X86_MULSD, x2, x2);
+    emit_op_sd(code, X86_MULSD, x3, x3);
+    emit_op_sd(code, X86_ADDSD, x3, x2);
 
     /* real part */
-    emit_movsd(sb, loc_str_off(a, ra, ins->src1, 0, x64, syntax), x0, syntax);
-    emit_op_sd(sb, "mul", x4, x0, syntax);
-    emit_movsd(sb, loc_str_off(a, ra, ins->src1, 8, x64, syntax), x1, syntax);
-    emit_movsd(sb, loc_str_off(d, ra, ins->src2, 8, x64, syntax), x3, syntax);
-    emit_op_sd(sb, "mul", x3, x1, syntax);
-    emit_op_sd(sb, "add", x1, x0, syntax);
-    emit_op_sd(sb, "div", x2, x0, syntax);
-    emit_movsd(sb, x0, loc_str_off(out, ra, ins->dest, 0, x64, syntax), syntax);
+    emit_movsd(code, loc_str_off(ra, ins->src1, 0, x64), x0);
+    emit_op_sd(code, X86_MULSD, x4, x0);
+    emit_movsd(code, loc_str_off(ra, ins->src1, 8, x64), x1);
+    emit_movsd(code, loc_str_off(ra, ins->src2, 8, x64), x3);
+    emit_op_sd(code, X86_MULSD, x3, x1);
+    emit_op_sd(code, X86_ADDSD, x1, x0);
+    emit_op_sd(code, X86_DIVSD, x2, x0);
+    emit_movsd(code, x0, loc_str_off(ra, ins->dest, 0, x64));
 
     /* imag part */
-    emit_movsd(sb, loc_str_off(a, ra, ins->src1, 8, x64, syntax), x0, syntax);
-    emit_op_sd(sb, "mul", x4, x0, syntax);
-    emit_movsd(sb, loc_str_off(a, ra, ins->src1, 0, x64, syntax), x1, syntax);
-    emit_movsd(sb, loc_str_off(d, ra, ins->src2, 8, x64, syntax), x3, syntax);
-    emit_op_sd(sb, "mul", x3, x1, syntax);
-    emit_op_sd(sb, "sub", x1, x0, syntax);
-    emit_op_sd(sb, "div", x2, x0, syntax);
-    emit_movsd(sb, x0, loc_str_off(out, ra, ins->dest, 8, x64, syntax), syntax);
+    emit_movsd(code, loc_str_off(ra, ins->src1, 8, x64), x0);
+    emit_op_sd(code, X86_MULSD, x4, x0);
+    emit_movsd(code, loc_str_off(ra, ins->src1, 0, x64), x1);
+    emit_movsd(code, loc_str_off(ra, ins->src2, 8, x64), x3);
+    emit_op_sd(code, X86_MULSD, x3, x1);
+    emit_op_sd(code, X86_SUBSD, x1, x0);
+    emit_op_sd(code, X86_DIVSD, x2, x0);
+    emit_movsd(code, x0, loc_str_off(ra, ins->dest, 8, x64));
 
     regalloc_xmm_release(r4);
     regalloc_xmm_release(r3);
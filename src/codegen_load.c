@@ -9,14 +9,11 @@
  */
 
 #include <stdio.h>
-#include <stdlib.h>
-#include <errno.h>
-#include <string.h>
 #include "codegen_mem.h"
 #include "codegen_loadstore.h"
 #include "regalloc_x86.h"
 #include "regalloc.h"
-
+#include "codegen_x86.h"
 
 /* Determine operand size from the IR type. */
 static int op_size(type_kind_t t, int x64)
@@ -46,193 +43,73 @@ static int is_signed(type_kind_t t)
 {
     return t == TYPE_CHAR || t == TYPE_SHORT;
 }
-/* Helper to format a register name. */
-static const char *reg_str(int reg, int size, asm_syntax_t syntax)
-{
-    const char *name = (size == 4) ? regalloc_reg_name32(reg)
-                                  : regalloc_reg_name(reg);
-    if (syntax == ASM_INTEL && name[0] == '%')
-        return name + 1;
-    return name;
-}
-
-/* Return subregister name for register `reg` and size. */
-static const char *reg_subreg(int reg, int size, asm_syntax_t syntax)
-{
-    if (reg < 0 || reg >= REGALLOC_NUM_REGS)
-        reg = 0;
-    static const char *regs8_att[REGALLOC_NUM_REGS] =
-        {"%al", "%bl", "%cl", "%dl", "%sil", "%dil"};
-    static const char *regs8_intel[REGALLOC_NUM_REGS] =
-        {"al", "bl", "cl", "dl", "sil", "dil"};
-    static const char *regs16_att[REGALLOC_NUM_REGS] =
-        {"%ax", "%bx", "%cx", "%dx", "%si", "%di"};
-    static const char *regs16_intel[REGALLOC_NUM_REGS] =
-        {"ax", "bx", "cx", "dx", "si", "di"};
-    if (size == 1)
-        return (syntax == ASM_INTEL) ? regs8_intel[reg] : regs8_att[reg];
-    if (size == 2)
-        return (syntax == ASM_INTEL) ? regs16_intel[reg] : regs16_att[reg];
-    return reg_str(reg, size, syntax);
-}
 
-static const char *scratch_subreg(int size, asm_syntax_t syntax)
+/* Return operand `o` moved `off` bytes further into memory. */
+static x86_operand_t mem_off(x86_operand_t o, int off)
 {
-    return reg_subreg(REGALLOC_SCRATCH_REG, size, syntax);
+    o.value += off;
+    return o;
 }
 
-static void emit_ins(strbuf_t *sb, const char *insn,
-                     const char *src, const char *dest,
-                     asm_syntax_t syntax)
+static int is_memop(x86_operand_t o)
 {
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    %s %s, %s\n", insn, dest, src);
-    else
-        strbuf_appendf(sb, "    %s %s, %s\n", insn, src, dest);
-}
-
-static void emit_move_with_spill(strbuf_t *sb, const char *sfx,
-                                 const char *src, const char *dest,
-                                 const char *slot, int spill,
-                                 asm_syntax_t syntax);
-
-/* Format memory operand `base` with additional byte offset. */
-static void fmt_mem_off(char buf[64], const char *base, int off,
-                        asm_syntax_t syntax)
-{
-    if (syntax == ASM_INTEL) {
-        size_t len = strlen(base);
-        if (len >= 2 && base[0] == '[' && base[len - 1] == ']')
-            snprintf(buf, 64, "[%.*s+%d]", (int)(len - 2), base + 1, off);
-        else
-            snprintf(buf, 64, "%s+%d", base, off);
-    } else {
-        const char *paren = strchr(base, '(');
-        if (paren) {
-            char num[32];
-            snprintf(num, sizeof(num), "%.*s", (int)(paren - base), base);
-            long val = strtol(num, NULL, 10);
-            snprintf(buf, 64, "%ld%s", val + off, paren);
-        } else {
-            snprintf(buf, 64, "%s+%d", base, off);
-        }
-    }
+    return o.kind == X86_OPD_MEM;
 }
 
-static int is_memop(const char *s)
-{
-    return s && (strchr(s, '[') || strchr(s, '('));
-}
+static void emit_move_with_spill(x86_insn_list_t *code, char sfx,
+                                 x86_operand_t src, x86_operand_t dest,
+                                 x86_operand_t slot, int spill);
 
-static void emit_typed_load(strbuf_t *sb, type_kind_t type, int x64,
-                            const char *src, const char *dest,
-                            const char *slot, int spill,
-                            asm_syntax_t syntax)
+static void emit_typed_load(x86_insn_list_t *code, type_kind_t type, int x64,
+                            x86_operand_t src, x86_operand_t dest,
+                            x86_operand_t slot, int spill)
 {
     int size = op_size(type, x64);
     if (size == 1 || size == 2) {
-        const char *inst;
-        const char *spill_inst = (size == 1) ? "movb" : "movw";
+        x86_opcode_t op;
         if (size == 1)
-            inst = is_signed(type)
-                       ? (x64 ? "movsbq" : "movsbl")
-                       : (x64 ? "movzbq" : "movzbl");
+            op = is_signed(type) ? X86_MOVSB : X86_MOVZB;
         else
-            inst = is_signed(type)
-                       ? (x64 ? "movswq" : "movswl")
-                       : (x64 ? "movzwq" : "movzwl");
-        emit_ins(sb, inst, src, dest, syntax);
-        if (spill) {
-            const char *low = scratch_subreg(size, syntax);
-            emit_ins(sb, spill_inst, low, slot, syntax);
-        }
+            op = is_signed(type) ? X86_MOVSW : X86_MOVZW;
+        x86_emit2(code, op, x64 ? 'q' : 'l', src, dest);
+        if (spill)
+            x86_emit2(code, X86_MOV, (size == 1) ? 'b' : 'w',
+                      x86_op_subreg(REGALLOC_SCRATCH_REG, size), slot);
     } else if (size == 10 && is_memop(src) && is_memop(spill ? slot : dest)) {
-        const char *dst = spill ? slot : dest;
-        if (syntax == ASM_INTEL) {
-            strbuf_appendf(sb, "    fld tword ptr %s\n", src);
-            strbuf_appendf(sb, "    fstp tword ptr %s\n", dst);
-        } else {
-            strbuf_appendf(sb, "    fldt %s\n", src);
-            strbuf_appendf(sb, "    fstpt %s\n", dst);
-        }
+        x86_emit1(code, X86_FLDT, 0, src);
+        x86_emit1(code, X86_FSTPT, 0, spill ? slot : dest);
     } else if ((size == 16 || size == 20) && is_memop(src) &&
                is_memop(spill ? slot : dest)) {
-        const char *dst = spill ? slot : dest;
+        x86_operand_t dst = spill ? slot : dest;
         int xr = regalloc_xmm_acquire();
         if (xr < 0) {
             fprintf(stderr, "emit_typed_load: XMM register allocation failed\n");
-            strbuf_appendf(sb, "    # XMM register allocation failed\n");
+            x86_emit1(code, X86_COMMENT, 0,
+                      x86_sym("XMM register allocation failed"));
             return;
         }
-        const char *xreg = regalloc_xmm_name(xr);
-        if (syntax == ASM_INTEL) {
-            strbuf_appendf(sb, "    movdqu %s, %s\n", xreg, src);
-            strbuf_appendf(sb, "    movdqu %s, %s\n", dst, xreg);
-        } else {
-            strbuf_appendf(sb, "    movdqu %s, %s\n", src, xreg);
-            strbuf_appendf(sb, "    movdqu %s, %s\n", xreg, dst);
-        }
+        x86_emit2(code, X86_MOVDQU, 0, src, x86_op_xmm(xr));
+        x86_emit2(code, X86_MOVDQU, 0, x86_op_xmm(xr), dst);
         regalloc_xmm_release(xr);
         if (size == 20) {
-            char soff[64];
-            char doff[64];
-            fmt_mem_off(soff, src, 16, syntax);
-            fmt_mem_off(doff, dst, 16, syntax);
-            const char *scratch = reg_str(REGALLOC_SCRATCH_REG, 4, syntax);
-            if (syntax == ASM_INTEL) {
-                strbuf_appendf(sb, "    movl %s, %s\n", scratch, soff);
-                strbuf_appendf(sb, "    movl %s, %s\n", doff, scratch);
-            } else {
-                strbuf_appendf(sb, "    movl %s, %s\n", soff, scratch);
-                strbuf_appendf(sb, "    movl %s, %s\n", scratch, doff);
-            }
+            x86_operand_t scratch = x86_op_reg(REGALLOC_SCRATCH_REG, 4);
+            x86_emit2(code, X86_MOV, 'l', mem_off(src, 16), scratch);
+            x86_emit2(code, X86_MOV, 'l', scratch, mem_off(dst, 16));
         }
     } else {
-        const char *sfx = (size == 8) ? "q" : "l";
-        emit_move_with_spill(sb, sfx, src, dest, slot, spill, syntax);
+        emit_move_with_spill(code, (size == 8) ? 'q' : 'l', src, dest, slot,
+                             spill);
     }
 }
 
 /* Move from `src` to `dest` and optionally spill to `slot`. */
-static void emit_move_with_spill(strbuf_t *sb, const char *sfx,
-                                 const char *src, const char *dest,
-                                 const char *slot, int spill,
-                                 asm_syntax_t syntax)
-{
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, dest, src);
-    else
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, src, dest);
-    if (spill) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, slot, dest);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, dest, slot);
-    }
-}
-
-/* Helper to format a register name. */
-/* Format the location for operand `id`. */
-static const char *loc_str(char buf[32], regalloc_t *ra, int id, int x64,
-                           int size, asm_syntax_t syntax)
+static void emit_move_with_spill(x86_insn_list_t *code, char sfx,
+                                 x86_operand_t src, x86_operand_t dest,
+                                 x86_operand_t slot, int spill)
 {
-    if (!ra || id <= 0)
-        return "";
-    int loc = ra->loc[id];
-    if (loc >= 0)
-        return reg_str(loc, size, syntax);
-    if (x64) {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[rbp-%d]", -loc * 8);
-        else
-            snprintf(buf, 32, "-%d(%%rbp)", -loc * 8);
-    } else {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[ebp-%d]", -loc * 4);
-        else
-            snprintf(buf, 32, "-%d(%%ebp)", -loc * 4);
-    }
-    return buf;
+    x86_emit2(code, X86_MOV, sfx, src, dest);
+    if (spill)
+        x86_emit2(code, X86_MOV, sfx, dest, slot);
 }
 
 /*
@@ -244,20 +121,16 @@ static const char *loc_str(char buf[32], regalloc_t *ra, int id, int x64,
  *   - `name` is the memory operand to load from and does not require a
  *     register.
  */
-void emit_load(strbuf_t *sb, ir_instr_t *ins,
-               regalloc_t *ra, int x64,
-               asm_syntax_t syntax)
+void emit_load(x86_insn_list_t *code, ir_instr_t *ins,
+               regalloc_t *ra, int x64)
 {
-    char destb[32];
-    char mem[32];
     int size = op_size(ins->type, x64);
     int spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest = spill ? reg_str(REGALLOC_SCRATCH_REG, size, syntax)
-                             : loc_str(destb, ra, ins->dest, x64, size, syntax);
-    const char *slot = loc_str(mem, ra, ins->dest, x64, size, syntax);
-    char sbuf[32];
-    const char *src = fmt_stack(sbuf, ins->name, x64, syntax);
-    emit_typed_load(sb, ins->type, x64, src, dest, slot, spill, syntax);
+    x86_operand_t dest = spill ? x86_op_reg(REGALLOC_SCRATCH_REG, size)
+                               : x86_op_loc(ra, ins->dest, x64, size);
+    x86_operand_t slot = x86_op_loc(ra, ins->dest, x64, size);
+    emit_typed_load(code, ins->type, x64, x86_op_name(ins->name, x64),
+                    dest, slot, spill);
 }
 
 /*
@@ -268,44 +141,16 @@ void emit_load(strbuf_t *sb, ir_instr_t *ins,
  *     a register or stack slot.
  *   - `dest` follows the same rules as for emit_load.
  */
-void emit_load_ptr(strbuf_t *sb, ir_instr_t *ins,
-                   regalloc_t *ra, int x64,
-                   asm_syntax_t syntax)
+void emit_load_ptr(x86_insn_list_t *code, ir_instr_t *ins,
+                   regalloc_t *ra, int x64)
 {
-    char b1[32];
-    char destb[32];
-    char mem[32];
     int size = op_size(ins->type, x64);
     int spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest = spill ? reg_str(REGALLOC_SCRATCH_REG, size, syntax)
-                             : loc_str(destb, ra, ins->dest, x64, size, syntax);
-    const char *slot = loc_str(mem, ra, ins->dest, x64, size, syntax);
-    const char *addr = loc_str(b1, ra, ins->src1, x64, x64 ? 8 : 4, syntax);
-    char srcbuf[32];
-    const char *src;
-    if (ra && ins->src1 > 0 && ra->loc[ins->src1] < 0) {
-        /* `src1` spilled: load address into scratch first. */
-        const char *scratch = reg_str(REGALLOC_SCRATCH_REG, x64 ? 8 : 4, syntax);
-        const char *psfx = x64 ? "q" : "l";
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", psfx, scratch, addr);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", psfx, addr, scratch);
-        if (syntax == ASM_INTEL)
-            snprintf(srcbuf, sizeof(srcbuf), "[%s]", scratch);
-        else
-            snprintf(srcbuf, sizeof(srcbuf), "(%s)", scratch);
-        src = srcbuf;
-    } else if (ra && ins->src1 > 0 && ra->loc[ins->src1] >= 0) {
-        if (syntax == ASM_INTEL)
-            snprintf(srcbuf, sizeof(srcbuf), "[%s]", addr);
-        else
-            snprintf(srcbuf, sizeof(srcbuf), "(%s)", addr);
-        src = srcbuf;
-    } else {
-        src = addr;
-    }
-    emit_typed_load(sb, ins->type, x64, src, dest, slot, spill, syntax);
+    x86_operand_t dest = spill ? x86_op_reg(REGALLOC_SCRATCH_REG, size)
+                               : x86_op_loc(ra, ins->dest, x64, size);
+    x86_operand_t slot = x86_op_loc(ra, ins->dest, x64, size);
+    x86_operand_t src = x86_op_ptr(code, ra, ins->src1, x64);
+    emit_typed_load(code, ins->type, x64, src, dest, slot, spill);
 }
 
 /*
@@ -315,69 +160,14 @@ void emit_load_ptr(strbuf_t *sb, ir_instr_t *ins,
  *   - `src1` provides the index value.
  *   - `dest` is handled as in emit_load.
  */
-void emit_load_idx(strbuf_t *sb, ir_instr_t *ins,
-                   regalloc_t *ra, int x64,
-                   asm_syntax_t syntax)
+void emit_load_idx(x86_insn_list_t *code, ir_instr_t *ins,
+                   regalloc_t *ra, int x64)
 {
-    char b1[32];
-    char destb[32];
-    char mem[32];
     int size = op_size(ins->type, x64);
     int spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest = spill ? reg_str(REGALLOC_SCRATCH_REG, size, syntax)
-                             : loc_str(destb, ra, ins->dest, x64, size, syntax);
-    const char *slot = loc_str(mem, ra, ins->dest, x64, size, syntax);
-    char srcbuf[64];
-    char basebuf[32];
-    const char *base = fmt_stack(basebuf, ins->name, x64, syntax);
-    int scale = idx_scale(ins, x64);
-    int manual = (scale != 1 && scale != 2 && scale != 4 && scale != 8);
-    int idx_spill = ra && ins->src1 > 0 && ra->loc[ins->src1] < 0;
-
-    const char *idx;
-    const char *psfx = x64 ? "q" : "l";
-    if (manual) {
-        /* Multiply index into scratch register for arbitrary scales. */
-        const char *scratch = reg_str(REGALLOC_SCRATCH_REG, x64 ? 8 : 4, syntax);
-        const char *src = loc_str(b1, ra, ins->src1, x64, x64 ? 8 : 4, syntax);
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", psfx, scratch, src);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", psfx, src, scratch);
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    imul%s %s, %s, %d\n", psfx, scratch, scratch, scale);
-        else
-            strbuf_appendf(sb, "    imul%s $%d, %s, %s\n", psfx, scale, scratch, scratch);
-        idx = scratch;
-        scale = 1;
-    } else if (idx_spill) {
-        /* Load spilled index into scratch register. */
-        const char *scratch = reg_str(REGALLOC_SCRATCH_REG, x64 ? 8 : 4, syntax);
-        const char *src = loc_str(b1, ra, ins->src1, x64, x64 ? 8 : 4, syntax);
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", psfx, scratch, src);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", psfx, src, scratch);
-        idx = scratch;
-    } else {
-        idx = loc_str(b1, ra, ins->src1, x64, x64 ? 8 : 4, syntax);
-    }
-    if (syntax == ASM_INTEL) {
-        const char *b = base;
-        char inner[32];
-        size_t len = strlen(base);
-        if (len >= 2 && base[0] == '[' && base[len - 1] == ']') {
-            /* Remove surrounding brackets produced by fmt_stack. */
-            snprintf(inner, sizeof(inner), "%.*s", (int)(len - 2), base + 1);
-            b = inner;
-        }
-        if (scale == 1)
-            snprintf(srcbuf, sizeof(srcbuf), "[%s+%s]", b, idx);
-        else
-            snprintf(srcbuf, sizeof(srcbuf), "[%s+%s*%d]", b, idx, scale);
-    } else {
-        snprintf(srcbuf, sizeof(srcbuf), "%s(,%s,%d)", base, idx, scale);
-    }
-    emit_typed_load(sb, ins->type, x64, srcbuf, dest, slot, spill, syntax);
+    x86_operand_t dest = spill ? x86_op_reg(REGALLOC_SCRATCH_REG, size)
+                               : x86_op_loc(ra, ins->dest, x64, size);
+    x86_operand_t slot = x86_op_loc(ra, ins->dest, x64, size);
+    x86_operand_t src = x86_op_indexed(code, ins, ra, x64);
+    emit_typed_load(code, ins->type, x64, src, dest, slot, spill);
 }
-
@@ -1,8 +1,5 @@
 #include "codegen_mem.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <errno.h>
-#include <string.h>
+#include <stddef.h>
 
 /* Current argument stack size for the active call. */
 size_t arg_stack_bytes = 0;
@@ -20,38 +17,12 @@ extern mem_emit_fn mem_emitters[];
  * codegen.c after register allocation has assigned locations to IR
  * values.
  */
-void emit_memory_instr(strbuf_t *sb, ir_instr_t *ins,
-                       regalloc_t *ra, int x64,
-                       asm_syntax_t syntax)
+void emit_memory_instr(x86_insn_list_t *code, ir_instr_t *ins,
+                       regalloc_t *ra, int x64)
 {
     if (!ins || ins->op < 0 || ins->op > IR_LABEL)
         return;
     mem_emit_fn fn = mem_emitters[ins->op];
     if (fn)
-        fn(sb, ins, ra, x64, syntax);
-}
-
-/* Convert "stack:offset" names to frame-pointer relative operands. */
-const char *fmt_stack(char buf[32], const char *name, int x64,
-                      asm_syntax_t syntax)
-{
-    if (strncmp(name, "stack:", 6) != 0)
-        return name;
-    char *end;
-    errno = 0;
-    long off = strtol(name + 6, &end, 10);
-    if (errno || *end != '\0')
-        off = 0;
-    if (x64) {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[rbp-%d]", (int)off);
-        else
-            snprintf(buf, 32, "-%d(%%rbp)", (int)off);
-    } else {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[ebp-%d]", (int)off);
-        else
-            snprintf(buf, 32, "-%d(%%ebp)", (int)off);
-    }
-    return buf;
+        fn(code, ins, ra, x64);
 }
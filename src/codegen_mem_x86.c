@@ -11,9 +11,6 @@
  * See LICENSE for details.
  */
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <errno.h>
 #include <string.h>
 #include "codegen_mem.h"
 #include "codegen_loadstore.h"
@@ -33,120 +30,59 @@
  * move.  The helper is used to implement loads that need to store the
  * result to a stack slot when the destination register was spilled.
  */
-static void emit_move_with_spill(strbuf_t *sb, const char *sfx,
-                                 const char *src, const char *dest,
-                                 const char *slot, int spill,
-                                 asm_syntax_t syntax)
+static void emit_move_with_spill(x86_insn_list_t *code, char sfx,
+                                 x86_operand_t src, x86_operand_t dest,
+                                 x86_operand_t slot, int spill)
 {
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, dest, src);
-    else
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, src, dest);
-    if (spill) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, slot, dest);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, dest, slot);
-    }
-}
-
-/* Format a register name for Intel or AT&T syntax. */
-static const char *reg_str(int reg, const char *sfx, asm_syntax_t syntax)
-{
-    return x86_reg_str(reg, sfx, syntax);
-}
-
-static const char *fmt_reg(const char *name, asm_syntax_t syntax)
-{
-    return x86_fmt_reg(name, syntax);
+    x86_emit2(code, X86_MOV, sfx, src, dest);
+    if (spill)
+        x86_emit2(code, X86_MOV, sfx, dest, slot);
 }
 
 /* Return the temporary register used for bit-field operations. */
-static const char *tmp_reg(int x64, asm_syntax_t syntax)
+static x86_operand_t tmp_reg(int x64)
 {
-    return fmt_reg(x64 ? "%rcx" : "%ecx", syntax);
+    return x86_reg(X86_CX, x64 ? 8 : 4);
 }
 
-static const char *loc_str(char buf[32], regalloc_t *ra, int id, int x64,
-                           const char *sfx, asm_syntax_t syntax)
+/* Return the size in bytes of a register selected by `sfx`. */
+static int sfx_size(char sfx)
 {
-    if (!ra || id <= 0)
-        return "";
-    int loc = ra->loc[id];
-    if (loc >= 0)
-        return reg_str(loc, sfx, syntax);
-    if (x64) {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[rbp-%d]", -loc * 8);
-        else
-            snprintf(buf, 32, "-%d(%%rbp)", -loc * 8);
-    } else {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[ebp-%d]", -loc * 4);
-        else
-            snprintf(buf, 32, "-%d(%%ebp)", -loc * 4);
-    }
-    return buf;
+    return sfx == 'l' ? 4 : 8;
 }
 
 /* Load the destination value into the scratch register and clear
  * the bit-field position using `clear` as mask. */
-static void load_dest_scratch(strbuf_t *sb, const char *sfx,
+static void load_dest_scratch(x86_insn_list_t *code, char sfx,
                               const char *name,
-                              unsigned long long clear,
-                              int x64, asm_syntax_t syntax)
+                              unsigned long long clear, int x64)
 {
-    const char *scratch = reg_str(REGALLOC_SCRATCH_REG, sfx, syntax);
-    char buf[32];
-    const char *src = fmt_stack(buf, name, x64, syntax);
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, scratch, src);
-    else
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, src, scratch);
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    and%s %s, %llu\n", sfx, scratch, clear);
-    else
-        strbuf_appendf(sb, "    and%s $%llu, %s\n", sfx, clear, scratch);
+    x86_operand_t scratch = x86_op_reg(REGALLOC_SCRATCH_REG, sfx_size(sfx));
+    x86_emit2(code, X86_MOV, sfx, x86_op_name(name, x64), scratch);
+    x86_emit2(code, X86_AND, sfx, x86_uimm(clear), scratch);
 }
 
 /* Load the input value, mask it with `mask` and shift by `shift`.  The
  * temporary register %ecx/%rcx is used to hold the intermediate result. */
-static void mask_shift_input(strbuf_t *sb, const char *sfx, const char *val,
-                             unsigned long long mask, unsigned shift,
-                             int x64, asm_syntax_t syntax)
+static void mask_shift_input(x86_insn_list_t *code, char sfx,
+                             x86_operand_t val, unsigned long long mask,
+                             unsigned shift, int x64)
 {
-    const char *reg = tmp_reg(x64, syntax);
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, reg, val);
-    else
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, val, reg);
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    and%s %s, %llu\n", sfx, reg, mask);
-    else
-        strbuf_appendf(sb, "    and%s $%llu, %s\n", sfx, mask, reg);
-    if (shift) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    shl%s %s, %u\n", sfx, reg, shift);
-        else
-            strbuf_appendf(sb, "    shl%s $%u, %s\n", sfx, shift, reg);
-    }
+    x86_operand_t reg = tmp_reg(x64);
+    x86_emit2(code, X86_MOV, sfx, val, reg);
+    x86_emit2(code, X86_AND, sfx, x86_uimm(mask), reg);
+    if (shift)
+        x86_emit2(code, X86_SHL, sfx, x86_imm(shift), reg);
 }
 
 /* OR the prepared value in %ecx/%rcx into the scratch register and
  * store the result back to `name`. */
-static void write_back_value(strbuf_t *sb, const char *sfx,
-                             const char *name, int x64,
-                             asm_syntax_t syntax)
+static void write_back_value(x86_insn_list_t *code, char sfx,
+                             const char *name, int x64)
 {
-    const char *scratch = reg_str(REGALLOC_SCRATCH_REG, sfx, syntax);
-    const char *reg = tmp_reg(x64, syntax);
-    strbuf_appendf(sb, "    or%s %s, %s\n", sfx, reg, scratch);
-    char buf[32];
-    const char *dst = fmt_stack(buf, name, x64, syntax);
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, dst, scratch);
-    else
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, scratch, dst);
+    x86_operand_t scratch = x86_op_reg(REGALLOC_SCRATCH_REG, sfx_size(sfx));
+    x86_emit2(code, X86_OR, sfx, tmp_reg(x64), scratch);
+    x86_emit2(code, X86_MOV, sfx, scratch, x86_op_name(name, x64));
 }
 
 /* ----------------------------------------------------------------------
@@ -159,23 +95,15 @@ static void write_back_value(strbuf_t *sb, const char *sfx,
  * Register allocation expectations:
  *   - `dest` follows the usual load semantics and may be spilled.
  */
-static void emit_const(strbuf_t *sb, ir_instr_t *ins,
-                       regalloc_t *ra, int x64,
-                       asm_syntax_t syntax)
+static void emit_const(x86_insn_list_t *code, ir_instr_t *ins,
+                       regalloc_t *ra, int x64)
 {
-    char destb[32];
-    char mem[32];
-    const char *sfx = x64 ? "q" : "l";
+    char sfx = x64 ? 'q' : 'l';
     int spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest = spill ? reg_str(REGALLOC_SCRATCH_REG, sfx, syntax)
-                             : loc_str(destb, ra, ins->dest, x64, sfx, syntax);
-    const char *slot = loc_str(mem, ra, ins->dest, x64, sfx, syntax);
-    char srcbuf[32];
-    if (syntax == ASM_INTEL)
-        snprintf(srcbuf, sizeof(srcbuf), "%lld", ins->imm);
-    else
-        snprintf(srcbuf, sizeof(srcbuf), "$%lld", ins->imm);
-    emit_move_with_spill(sb, sfx, srcbuf, dest, slot, spill, syntax);
+    x86_operand_t dest = spill ? x86_op_reg(REGALLOC_SCRATCH_REG, sfx_size(sfx))
+                               : x86_op_loc(ra, ins->dest, x64, sfx_size(sfx));
+    x86_operand_t slot = x86_op_loc(ra, ins->dest, x64, sfx_size(sfx));
+    emit_move_with_spill(code, sfx, x86_imm(ins->imm), dest, slot, spill);
 }
 
 /* Load a variable by name (IR_LOAD).
@@ -192,6 +120,13 @@ static void emit_const(strbuf_t *sb, ir_instr_t *ins,
  */
 
 
+/* Return the frame operand of parameter slot `idx`. */
+static x86_operand_t param_slot(long long idx, int x64)
+{
+    int word = x64 ? 8 : 4;
+    return x86_mem(X86_BP, word, (x64 ? 16 : 8) + (int)idx * word);
+}
+
 /*
  * Load a function parameter (IR_LOAD_PARAM).
  *
@@ -199,27 +134,16 @@ static void emit_const(strbuf_t *sb, ir_instr_t *ins,
  *   - `dest` behaves like a normal load destination and may be spilled.
  *   - The parameter value is loaded from the stack based on `imm`.
  */
-static void emit_load_param(strbuf_t *sb, ir_instr_t *ins,
-                            regalloc_t *ra, int x64,
-                            asm_syntax_t syntax)
+static void emit_load_param(x86_insn_list_t *code, ir_instr_t *ins,
+                            regalloc_t *ra, int x64)
 {
-    char destb[32];
-    char mem[32];
-    const char *bp = (syntax == ASM_INTEL)
-                     ? (x64 ? "rbp" : "ebp")
-                     : (x64 ? "%rbp" : "%ebp");
-    const char *sfx = x64 ? "q" : "l";
+    char sfx = x64 ? 'q' : 'l';
     int spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest = spill ? reg_str(REGALLOC_SCRATCH_REG, sfx, syntax)
-                             : loc_str(destb, ra, ins->dest, x64, sfx, syntax);
-    const char *slot = loc_str(mem, ra, ins->dest, x64, sfx, syntax);
-    int off = (x64 ? 16 : 8) + (int)ins->imm * (x64 ? 8 : 4);
-    char srcbuf[32];
-    if (syntax == ASM_INTEL)
-        snprintf(srcbuf, sizeof(srcbuf), "[%s+%d]", bp, off);
-    else
-        snprintf(srcbuf, sizeof(srcbuf), "%d(%s)", off, bp);
-    emit_move_with_spill(sb, sfx, srcbuf, dest, slot, spill, syntax);
+    x86_operand_t dest = spill ? x86_op_reg(REGALLOC_SCRATCH_REG, sfx_size(sfx))
+                               : x86_op_loc(ra, ins->dest, x64, sfx_size(sfx));
+    x86_operand_t slot = x86_op_loc(ra, ins->dest, x64, sfx_size(sfx));
+    emit_move_with_spill(code, sfx, param_slot(ins->imm, x64), dest, slot,
+                         spill);
 }
 
 /*
@@ -230,33 +154,18 @@ static void emit_load_param(strbuf_t *sb, ir_instr_t *ins,
  *   - The destination slot is addressed relative to the frame pointer using
  *     `imm`.
  */
-static void emit_store_param(strbuf_t *sb, ir_instr_t *ins,
-                             regalloc_t *ra, int x64,
-                             asm_syntax_t syntax)
+static void emit_store_param(x86_insn_list_t *code, ir_instr_t *ins,
+                             regalloc_t *ra, int x64)
 {
-    char b1[32];
-    const char *bp = (syntax == ASM_INTEL)
-                     ? (x64 ? "rbp" : "ebp")
-                     : (x64 ? "%rbp" : "%ebp");
-    const char *sfx = x64 ? "q" : "l";
-    int off = (x64 ? 16 : 8) + (int)ins->imm * (x64 ? 8 : 4);
-    const char *src;
+    char sfx = x64 ? 'q' : 'l';
+    x86_operand_t src = x86_op_loc(ra, ins->src1, x64, sfx_size(sfx));
     if (ra && ins->src1 > 0 && ra->loc[ins->src1] < 0) {
         /* `src1` spilled: move through scratch register to avoid mem-to-mem. */
-        const char *scratch = reg_str(REGALLOC_SCRATCH_REG, sfx, syntax);
-        const char *slot = loc_str(b1, ra, ins->src1, x64, sfx, syntax);
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, scratch, slot);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, slot, scratch);
+        x86_operand_t scratch = x86_op_reg(REGALLOC_SCRATCH_REG, sfx_size(sfx));
+        x86_emit2(code, X86_MOV, sfx, src, scratch);
         src = scratch;
-    } else {
-        src = loc_str(b1, ra, ins->src1, x64, sfx, syntax);
     }
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    mov%s [%s+%d], %s\n", sfx, bp, off, src);
-    else
-        strbuf_appendf(sb, "    mov%s %s, %d(%s)\n", sfx, src, off, bp);
+    x86_emit2(code, X86_MOV, sfx, src, param_slot(ins->imm, x64));
 }
 
 /*
@@ -265,46 +174,28 @@ static void emit_store_param(strbuf_t *sb, ir_instr_t *ins,
  * Register allocation expectations:
  *   - `dest` follows normal load semantics and may spill.
  */
-static void emit_addr(strbuf_t *sb, ir_instr_t *ins,
-                      regalloc_t *ra, int x64,
-                      asm_syntax_t syntax)
+static void emit_addr(x86_insn_list_t *code, ir_instr_t *ins,
+                      regalloc_t *ra, int x64)
 {
-    char destb[32];
-    char mem[32];
-    const char *sfx = x64 ? "q" : "l";
+    char sfx = x64 ? 'q' : 'l';
     int spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest = spill ? reg_str(REGALLOC_SCRATCH_REG, sfx, syntax)
-                             : loc_str(destb, ra, ins->dest, x64, sfx, syntax);
-    const char *slot = loc_str(mem, ra, ins->dest, x64, sfx, syntax);
-    char srcbuf[32];
-    const char *name = fmt_stack(srcbuf, ins->name, x64, syntax);
+    x86_operand_t dest = spill ? x86_op_reg(REGALLOC_SCRATCH_REG, sfx_size(sfx))
+                               : x86_op_loc(ra, ins->dest, x64, sfx_size(sfx));
+    x86_operand_t slot = x86_op_loc(ra, ins->dest, x64, sfx_size(sfx));
     if (strncmp(ins->name, "stack:", 6) == 0) {
         /* stack address -> lea */
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    lea%s %s, %s\n", sfx, dest, name);
-        else
-            strbuf_appendf(sb, "    lea%s %s, %s\n", sfx, name, dest);
+        x86_emit2(code, X86_LEA, sfx, x86_op_name(ins->name, x64), dest);
         if (spill)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, slot, dest);
+            x86_emit2(code, X86_MOV, sfx, dest, slot);
         return;
     }
     if (x64) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    movabs %s, %s\n", dest, name);
-        else
-            strbuf_appendf(sb, "    movabsq $%s, %s\n", name, dest);
-        if (spill) {
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, slot, dest);
-            else
-                strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, dest, slot);
-        }
+        x86_emit_op(code, X86_MOVABS, 'q', x86_sym_addr(ins->name), dest);
+        if (spill)
+            x86_emit2(code, X86_MOV, sfx, dest, slot);
     } else {
-        if (syntax == ASM_INTEL)
-            snprintf(srcbuf, sizeof(srcbuf), "%s", name);
-        else
-            snprintf(srcbuf, sizeof(srcbuf), "$%s", name);
-        emit_move_with_spill(sb, sfx, srcbuf, dest, slot, spill, syntax);
+        emit_move_with_spill(code, sfx, x86_sym_addr(ins->name), dest, slot,
+                             spill);
     }
 }
 
@@ -326,39 +217,28 @@ static void emit_addr(strbuf_t *sb, ir_instr_t *ins,
  *   - `dest` may be spilled; REGALLOC_SCRATCH_REG is used when necessary.
  *   - %ecx/%rcx is used as a temporary when masking and shifting.
  */
-static void emit_bfload(strbuf_t *sb, ir_instr_t *ins,
-                        regalloc_t *ra, int x64,
-                        asm_syntax_t syntax)
+static void emit_bfload(x86_insn_list_t *code, ir_instr_t *ins,
+                        regalloc_t *ra, int x64)
 {
-    char destb[32];
-    char mem[32];
-    const char *sfx = x64 ? "q" : "l";
+    char sfx = x64 ? 'q' : 'l';
     int spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest = spill ? reg_str(REGALLOC_SCRATCH_REG, sfx, syntax)
-                             : loc_str(destb, ra, ins->dest, x64, sfx, syntax);
-    const char *slot = loc_str(mem, ra, ins->dest, x64, sfx, syntax);
+    x86_operand_t dest = spill ? x86_op_reg(REGALLOC_SCRATCH_REG, sfx_size(sfx))
+                               : x86_op_loc(ra, ins->dest, x64, sfx_size(sfx));
+    x86_operand_t slot = x86_op_loc(ra, ins->dest, x64, sfx_size(sfx));
     unsigned shift = (unsigned)(ins->imm >> 32);
     unsigned width = (unsigned)(ins->imm & 0xffffffffu);
     /* Mask covering the bit-field width. */
     unsigned long long mask = (width == 64) ? 0xffffffffffffffffULL
                                             : ((1ULL << width) - 1ULL);
-    char nbuf[32];
-    const char *src = fmt_stack(nbuf, ins->name, x64, syntax);
-    emit_move_with_spill(sb, sfx, src, dest, slot, 0, syntax);
+    x86_emit2(code, X86_MOV, sfx, x86_op_name(ins->name, x64), dest);
     if (shift) {
         /* Shift down to align the field with bit 0. */
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    shr%s %s, %u\n", sfx, dest, shift);
-        else
-            strbuf_appendf(sb, "    shr%s $%u, %s\n", sfx, shift, dest);
+        x86_emit2(code, X86_SHR, sfx, x86_imm(shift), dest);
     }
     /* Mask off any unrelated bits. */
-    if (syntax == ASM_INTEL)
-        strbuf_appendf(sb, "    and%s %s, %llu\n", sfx, dest, mask);
-    else
-        strbuf_appendf(sb, "    and%s $%llu, %s\n", sfx, mask, dest);
+    x86_emit2(code, X86_AND, sfx, x86_uimm(mask), dest);
     if (spill)
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, dest, slot);
+        x86_emit2(code, X86_MOV, sfx, dest, slot);
 }
 
 /*
@@ -368,12 +248,10 @@ static void emit_bfload(strbuf_t *sb, ir_instr_t *ins,
  *   - `src1` is the value to insert into the field.
  *   - Uses REGALLOC_SCRATCH_REG and %ecx/%rcx as temporaries when updating the field.
  */
-static void emit_bfstore(strbuf_t *sb, ir_instr_t *ins,
-                         regalloc_t *ra, int x64,
-                         asm_syntax_t syntax)
+static void emit_bfstore(x86_insn_list_t *code, ir_instr_t *ins,
+                         regalloc_t *ra, int x64)
 {
-    char bval[32];
-    const char *sfx = x64 ? "q" : "l";
+    char sfx = x64 ? 'q' : 'l';
     unsigned shift = (unsigned)(ins->imm >> 32);
     unsigned width = (unsigned)(ins->imm & 0xffffffffu);
     /* Mask covering the bit-field width. */
@@ -382,12 +260,12 @@ static void emit_bfstore(strbuf_t *sb, ir_instr_t *ins,
     /* Clear mask to zero out the destination field. */
     unsigned long long clear = ~((unsigned long long)mask << shift);
     /* Load destination and clear the field bits. */
-    load_dest_scratch(sb, sfx, ins->name, clear, x64, syntax);
+    load_dest_scratch(code, sfx, ins->name, clear, x64);
     /* Prepare the input value for insertion. */
-    mask_shift_input(sb, sfx,
-                     loc_str(bval, ra, ins->src1, x64, sfx, syntax),
-                     mask, shift, x64, syntax);
-    write_back_value(sb, sfx, ins->name, x64, syntax);
+    mask_shift_input(code, sfx,
+                     x86_op_loc(ra, ins->src1, x64, sfx_size(sfx)),
+                     mask, shift, x64);
+    write_back_value(code, sfx, ins->name, x64);
 }
 
 /*
@@ -396,14 +274,11 @@ static void emit_bfstore(strbuf_t *sb, ir_instr_t *ins,
  * Register allocation expectations:
  *   - `src1` provides the argument value to push on the stack.
  */
-static void emit_arg(strbuf_t *sb, ir_instr_t *ins,
-                     regalloc_t *ra, int x64,
-                     asm_syntax_t syntax)
+static void emit_arg(x86_insn_list_t *code, ir_instr_t *ins,
+                     regalloc_t *ra, int x64)
 {
-    char b1[32];
-    const char *sp = (syntax == ASM_INTEL)
-                     ? (x64 ? "rsp" : "esp")
-                     : (x64 ? "%rsp" : "%esp");
+    int word = x64 ? 8 : 4;
+    x86_operand_t sp = x86_reg(X86_SP, word);
     type_kind_t t = (type_kind_t)ins->imm;
     size_t sz = x64 ? 8 : 4;
     if (t == TYPE_FLOAT)
@@ -412,112 +287,61 @@ static void emit_arg(strbuf_t *sb, ir_instr_t *ins,
         sz = 8;
     else if (t == TYPE_LDOUBLE)
         sz = x64 ? 16 : 10;
-    static const char *arg_regs[6] = {"%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9"};
-    static const char *xmm_regs[8] = {"%xmm0", "%xmm1", "%xmm2", "%xmm3", "%xmm4", "%xmm5", "%xmm6", "%xmm7"};
+    static const x86_reg_t arg_regs[6] = {
+        X86_DI, X86_SI, X86_DX, X86_CX, X86_R8, X86_R9
+    };
 
     if (x64 && t != TYPE_FLOAT && t != TYPE_DOUBLE && t != TYPE_LDOUBLE &&
         arg_reg_idx < 6) {
-        const char *reg = fmt_reg(arg_regs[arg_reg_idx], syntax);
-        const char *src = loc_str(b1, ra, ins->src1, x64, "q", syntax);
-        const char *sfx = "q";
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, reg, src);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, src, reg);
+        x86_operand_t reg = x86_reg(arg_regs[arg_reg_idx], 8);
+        x86_operand_t src = x86_op_loc(ra, ins->src1, x64, 8);
+        /* the value may already live in the argument register */
+        if (!x86_operand_equal(&src, &reg))
+            x86_emit2(code, X86_MOV, 'q', src, reg);
         arg_reg_idx++;
         return;
     }
 
     if (x64 && (t == TYPE_FLOAT || t == TYPE_DOUBLE) && float_reg_idx < 8) {
-        const char *reg = fmt_reg(xmm_regs[float_reg_idx], syntax);
-        const char *src = loc_str(b1, ra, ins->src1, x64,
-                                   (t == TYPE_FLOAT) ? "l" : "q", syntax);
-        const char *mov = (t == TYPE_FLOAT) ? "movd" : "movq";
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    %s %s, %s\n", mov, reg, src);
-        else
-            strbuf_appendf(sb, "    %s %s, %s\n", mov, src, reg);
+        x86_operand_t src = x86_op_loc(ra, ins->src1, x64,
+                                       (t == TYPE_FLOAT) ? 4 : 8);
+        x86_emit2(code, (t == TYPE_FLOAT) ? X86_MOVD : X86_MOVQ, 0, src,
+                  x86_op_xmm(float_reg_idx));
         float_reg_idx++;
         return;
     }
 
     if (t == TYPE_FLOAT) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    sub %s, 4\n", sp);
-        else
-            strbuf_appendf(sb, "    sub $4, %s\n", sp);
-        const char *src = loc_str(b1, ra, ins->src1, x64, "l", syntax);
-        int tmp_idx = (float_reg_idx < 8) ? float_reg_idx : -1;
-        const char *tmp = (tmp_idx >= 0) ? fmt_reg(xmm_regs[tmp_idx], syntax)
-                                         : NULL;
-        if (tmp) {
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    movd %s, %s\n", tmp, src);
-            else
-                strbuf_appendf(sb, "    movd %s, %s\n", src, tmp);
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    movss [%s], %s\n", sp, tmp);
-            else
-                strbuf_appendf(sb, "    movss %s, (%s)\n", tmp, sp);
+        x86_emit2(code, X86_SUB, 0, x86_imm(4), sp);
+        x86_operand_t src = x86_op_loc(ra, ins->src1, x64, 4);
+        if (float_reg_idx < 8) {
+            x86_operand_t tmp = x86_op_xmm(float_reg_idx);
+            x86_emit2(code, X86_MOVD, 0, src, tmp);
+            x86_emit2(code, X86_MOVSS, 0, tmp, x86_op_deref(sp));
         } else {
-            const char *scratch = fmt_reg("%eax", syntax);
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    movl %s, %s\n", scratch, src);
-            else
-                strbuf_appendf(sb, "    movl %s, %s\n", src, scratch);
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    movl [%s], %s\n", sp, scratch);
-            else
-                strbuf_appendf(sb, "    movl %s, (%s)\n", scratch, sp);
+            x86_operand_t scratch = x86_reg(X86_AX, 4);
+            x86_emit2(code, X86_MOV, 'l', src, scratch);
+            x86_emit2(code, X86_MOV, 'l', scratch, x86_op_deref(sp));
         }
     } else if (t == TYPE_DOUBLE) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    sub %s, 8\n", sp);
-        else
-            strbuf_appendf(sb, "    sub $8, %s\n", sp);
-        const char *src = loc_str(b1, ra, ins->src1, x64, "q", syntax);
-        int tmp_idx = (float_reg_idx < 8) ? float_reg_idx : -1;
-        const char *tmp = (tmp_idx >= 0) ? fmt_reg(xmm_regs[tmp_idx], syntax)
-                                         : NULL;
-        if (tmp) {
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    movq %s, %s\n", tmp, src);
-            else
-                strbuf_appendf(sb, "    movq %s, %s\n", src, tmp);
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    movsd [%s], %s\n", sp, tmp);
-            else
-                strbuf_appendf(sb, "    movsd %s, (%s)\n", tmp, sp);
+        x86_emit2(code, X86_SUB, 0, x86_imm(8), sp);
+        x86_operand_t src = x86_op_loc(ra, ins->src1, x64, 8);
+        if (float_reg_idx < 8) {
+            x86_operand_t tmp = x86_op_xmm(float_reg_idx);
+            x86_emit2(code, X86_MOVQ, 0, src, tmp);
+            x86_emit2(code, X86_MOVSD, 0, tmp, x86_op_deref(sp));
         } else {
-            const char *scratch = fmt_reg("%rax", syntax);
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    movq %s, %s\n", scratch, src);
-            else
-                strbuf_appendf(sb, "    movq %s, %s\n", src, scratch);
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    movq [%s], %s\n", sp, scratch);
-            else
-                strbuf_appendf(sb, "    movq %s, (%s)\n", scratch, sp);
+            x86_operand_t scratch = x86_reg(X86_AX, 8);
+            x86_emit2(code, X86_MOVQ, 0, src, scratch);
+            x86_emit2(code, X86_MOVQ, 0, scratch, x86_op_deref(sp));
         }
     } else if (t == TYPE_LDOUBLE) {
-        size_t pad = x64 ? 16 : 10;
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    sub %s, %zu\n", sp, pad);
-        else
-            strbuf_appendf(sb, "    sub $%zu, %s\n", pad, sp);
-        const char *src = loc_str(b1, ra, ins->src1, x64, "q", syntax);
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    fld tword ptr %s\n", src);
-        else
-            strbuf_appendf(sb, "    fldt %s\n", src);
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    fstp tword ptr [%s]\n", sp);
-        else
-            strbuf_appendf(sb, "    fstpt (%s)\n", sp);
+        x86_emit2(code, X86_SUB, 0, x86_imm((long long)sz), sp);
+        x86_emit1(code, X86_FLDT, 0, x86_op_loc(ra, ins->src1, x64, 8));
+        x86_emit1(code, X86_FSTPT, 0, x86_op_deref(sp));
     } else {
-        const char *sfx = x64 ? "q" : "l";
-        strbuf_appendf(sb, "    push%s %s\n", sfx,
-                       loc_str(b1, ra, ins->src1, x64, sfx, syntax));
+        x86_emit1(code, X86_PUSH, x64 ? 'q' : 'l',
+                  x86_op_loc(ra, ins->src1, x64, word));
     }
     arg_stack_bytes += sz;
 }
@@ -532,35 +356,22 @@ static void emit_arg(strbuf_t *sb, ir_instr_t *ins,
  * Register allocation expectations:
  *   - `dest` may be spilled in which case REGALLOC_SCRATCH_REG is used.
  */
-static void emit_glob_string(strbuf_t *sb, ir_instr_t *ins,
-                             regalloc_t *ra, int x64,
-                             asm_syntax_t syntax)
+static void emit_glob_string(x86_insn_list_t *code, ir_instr_t *ins,
+                             regalloc_t *ra, int x64)
 {
-    char destb[32];
-    char mem[32];
-    const char *sfx = x64 ? "q" : "l";
+    char sfx = x64 ? 'q' : 'l';
     int spill = (ra && ins->dest > 0 && ra->loc[ins->dest] < 0);
-    const char *dest = spill ? reg_str(REGALLOC_SCRATCH_REG, sfx, syntax)
-                             : loc_str(destb, ra, ins->dest, x64, sfx, syntax);
-    const char *slot = loc_str(mem, ra, ins->dest, x64, sfx, syntax);
+    x86_operand_t dest = spill ? x86_op_reg(REGALLOC_SCRATCH_REG, sfx_size(sfx))
+                               : x86_op_loc(ra, ins->dest, x64, sfx_size(sfx));
+    x86_operand_t slot = x86_op_loc(ra, ins->dest, x64, sfx_size(sfx));
+    x86_operand_t addr = x86_sym_addr(ins->name);
     if (x64) {
-        if (syntax == ASM_INTEL)
-            strbuf_appendf(sb, "    movabs %s, %s\n", dest, ins->name);
-        else
-            strbuf_appendf(sb, "    movabsq $%s, %s\n", ins->name, dest);
-        if (spill) {
-            if (syntax == ASM_INTEL)
-                strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, slot, dest);
-            else
-                strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, dest, slot);
-        }
+        x86_emit_op(code, X86_MOVABS, 'q', addr, dest);
+        if (spill)
+            x86_emit2(code, X86_MOV, sfx, dest, slot);
     } else {
-        char srcbuf[32];
-        if (syntax == ASM_INTEL)
-            snprintf(srcbuf, sizeof(srcbuf), "OFFSET FLAT:%s", ins->name);
-        else
-            snprintf(srcbuf, sizeof(srcbuf), "$%s", ins->name);
-        emit_move_with_spill(sb, sfx, srcbuf, dest, slot, spill, syntax);
+        addr.flags |= X86_OPF_FLAT;
+        emit_move_with_spill(code, sfx, addr, dest, slot, spill);
     }
 }
 
@@ -1,76 +1,132 @@
-#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
 #include <string.h>
 #include "codegen_x86.h"
 #include "regalloc_x86.h"
+#include "codegen_loadstore.h"
 
-const char *x86_reg_str(int reg, const char *sfx, asm_syntax_t syntax)
+x86_operand_t x86_op_reg(int reg, int size)
 {
-    const char *name;
-    if (sfx && strcmp(sfx, "l") == 0)
-        name = regalloc_reg_name32(reg);
-    else
-        name = regalloc_reg_name(reg);
-    if (syntax == ASM_INTEL && name[0] == '%')
-        return name + 1;
-    return name;
+    int x64 = regalloc_get_x86_64();
+    if (size == 4) {
+        if (reg < 0 || reg >= REGALLOC_NUM_REGS)
+            reg = X86_AX;
+        return x86_reg((x86_reg_t)reg, 4);
+    }
+    if (reg < 0 || reg >= regalloc_target()->count)
+        reg = X86_AX;
+    return x86_reg((x86_reg_t)reg, x64 ? 8 : 4);
 }
 
-const char *x86_fmt_reg(const char *name, asm_syntax_t syntax)
+x86_operand_t x86_op_subreg(int reg, int size)
 {
-    if (syntax == ASM_INTEL && name[0] == '%')
-        return name + 1;
-    return name;
+    if (size == 1 || size == 2) {
+        if (reg < 0 || reg >= REGALLOC_NUM_REGS)
+            reg = X86_AX;
+        return x86_reg((x86_reg_t)reg, size);
+    }
+    return x86_op_reg(reg, size);
 }
 
-const char *x86_loc_str(char buf[32], regalloc_t *ra, int id, int x64,
-                        const char *sfx, asm_syntax_t syntax)
+x86_operand_t x86_op_loc(regalloc_t *ra, int id, int x64, int size)
 {
     if (!ra || id <= 0)
-        return "";
+        return x86_none();
     int loc = ra->loc[id];
     if (loc >= 0)
-        return x86_reg_str(loc, sfx, syntax);
-    if (x64) {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[rbp-%d]", -loc * 8);
-        else
-            snprintf(buf, 32, "-%d(%%rbp)", -loc * 8);
-    } else {
-        if (syntax == ASM_INTEL)
-            snprintf(buf, 32, "[ebp-%d]", -loc * 4);
-        else
-            snprintf(buf, 32, "-%d(%%ebp)", -loc * 4);
+        return x86_op_reg(loc, size);
+    return x86_op_frame(-loc * (x64 ? 8 : 4), x64);
+}
+
+x86_operand_t x86_op_frame(int off, int x64)
+{
+    return x86_mem(X86_BP, x64 ? 8 : 4, -(long long)off);
+}
+
+x86_operand_t x86_op_name(const char *name, int x64)
+{
+    if (strncmp(name, "stack:", 6) != 0) {
+        x86_operand_t o = x86_mem(X86_NOREG, x64 ? 8 : 4, 0);
+        o.sym = name;
+        return o;
     }
-    return buf;
+    char *end;
+    errno = 0;
+    long off = strtol(name + 6, &end, 10);
+    if (errno || *end != '\0')
+        off = 0;
+    return x86_op_frame((int)off, x64);
+}
+
+x86_operand_t x86_op_xmm(int idx)
+{
+    if (idx < 0 || idx > X86_XMM7 - X86_XMM0)
+        idx = 0;
+    return x86_reg((x86_reg_t)(X86_XMM0 + idx), 16);
 }
 
-void x86_emit_mov(strbuf_t *sb, const char *sfx,
-                  const char *src, const char *dest,
-                  asm_syntax_t syntax)
+x86_operand_t x86_op_deref(x86_operand_t reg)
 {
-    if (syntax == ASM_INTEL) {
-        if (strcmp(sfx, "b") == 0 || strcmp(sfx, "w") == 0 ||
-            strcmp(sfx, "l") == 0 || strcmp(sfx, "q") == 0)
-            strbuf_appendf(sb, "    mov %s, %s\n", dest, src);
-        else
-            strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, dest, src);
-    } else {
-        strbuf_appendf(sb, "    mov%s %s, %s\n", sfx, src, dest);
+    return x86_mem(reg.reg, reg.size, 0);
+}
+
+x86_operand_t x86_op_ptr(x86_insn_list_t *code, regalloc_t *ra, int id,
+                         int x64)
+{
+    int psize = x64 ? 8 : 4;
+    x86_operand_t addr = x86_op_loc(ra, id, x64, psize);
+    if (!ra || id <= 0)
+        return addr;
+    if (ra->loc[id] < 0) {
+        x86_operand_t scratch = x86_op_reg(REGALLOC_SCRATCH_REG, psize);
+        x86_emit2(code, X86_MOV, x64 ? 'q' : 'l', addr, scratch);
+        addr = scratch;
     }
+    return x86_op_deref(addr);
 }
 
-void x86_emit_op(strbuf_t *sb, const char *op, const char *sfx,
-                 const char *src, const char *dest,
-                 asm_syntax_t syntax)
+x86_operand_t x86_op_indexed(x86_insn_list_t *code, ir_instr_t *ins,
+                             regalloc_t *ra, int x64)
 {
-    if (syntax == ASM_INTEL) {
-        if (strcmp(sfx, "b") == 0 || strcmp(sfx, "w") == 0 ||
-            strcmp(sfx, "l") == 0 || strcmp(sfx, "q") == 0)
-            strbuf_appendf(sb, "    %s %s, %s\n", op, dest, src);
-        else
-            strbuf_appendf(sb, "    %s%s %s, %s\n", op, sfx, dest, src);
-    } else {
-        strbuf_appendf(sb, "    %s%s %s, %s\n", op, sfx, src, dest);
+    int psize = x64 ? 8 : 4;
+    char psfx = x64 ? 'q' : 'l';
+    x86_operand_t mem = x86_op_name(ins->name, x64);
+    x86_operand_t idx = x86_op_loc(ra, ins->src1, x64, psize);
+    x86_operand_t scratch = x86_op_reg(REGALLOC_SCRATCH_REG, psize);
+    int scale = idx_scale(ins, x64);
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8) {
+        /* multiply the index for scales without an addressing mode */
+        x86_emit2(code, X86_MOV, psfx, idx, scratch);
+        x86_emit3(code, X86_IMUL, psfx, x86_imm(scale), scratch, scratch);
+        idx = scratch;
+        scale = 1;
+    } else if (ra && ins->src1 > 0 && ra->loc[ins->src1] < 0) {
+        x86_emit2(code, X86_MOV, psfx, idx, scratch);
+        idx = scratch;
+    }
+    if (idx.kind == X86_OPD_REG) {
+        mem.index = idx.reg;
+        mem.scale = (unsigned char)scale;
     }
+    return mem;
 }
 
+void x86_emit_mov(x86_insn_list_t *code, char sfx,
+                  x86_operand_t src, x86_operand_t dest)
+{
+    x86_emit_op(code, X86_MOV, sfx, src, dest);
+}
+
+void x86_emit_op(x86_insn_list_t *code, x86_opcode_t op, char sfx,
+                 x86_operand_t src, x86_operand_t dest)
+{
+    x86_insn_t ins;
+    memset(&ins, 0, sizeof(ins));
+    ins.op = op;
+    ins.sfx = sfx;
+    ins.flags = X86_INSF_BARE;
+    ins.nops = 2;
+    ins.ops[0] = src;
+    ins.ops[1] = dest;
+    x86_emit_insn(code, &ins);
+}
@@ -40,6 +40,7 @@
 #include "compile_stage.h"
 #include "startup.h"
 #include "compile_helpers.h"
+#include "compile_jobs.h"
 
 /* Use binary mode for temporary files on platforms that require it */
 #if defined(_WIN32)
@@ -91,6 +92,8 @@ int run_preprocessor(const cli_options_t *cli)
         const char *src = ((const char **)cli->sources.data)[i];
         preproc_context_t ctx = {0};
         preproc_set_verbose_includes(cli->verbose_includes);
+        preproc_set_include_index(cli->include_index,
+                                  cli->include_index_stats);
         ctx.max_include_depth = cli->max_include_depth;
         char *text = preproc_run(&ctx, src, &cli->include_dirs, &cli->defines,
                                 &cli->undefines, cli->sysroot,
@@ -135,6 +138,8 @@ int generate_dependencies(const cli_options_t *cli)
         const char *src = ((const char **)cli->sources.data)[i];
         preproc_context_t ctx = {0};
         preproc_set_verbose_includes(cli->verbose_includes);
+        preproc_set_include_index(cli->include_index,
+                                  cli->include_index_stats);
         ctx.max_include_depth = cli->max_include_depth;
         char *text = preproc_run(&ctx, src, &cli->include_dirs,
                                  &cli->defines, &cli->undefines, cli->sysroot,
@@ -155,10 +160,35 @@ int generate_dependencies(const cli_options_t *cli)
 }
 
 #ifndef UNIT_TESTING
+/* Compile every source to its own .o file using the job pool. */
+static int compile_objects_parallel(const cli_options_t *cli)
+{
+    size_t count = cli->sources.count;
+    char **objs = vc_alloc_or_exit(count * sizeof(*objs));
+    int ok = 1;
+    size_t made = 0;
+    for (; made < count; made++) {
+        objs[made] = vc_obj_name(((const char **)cli->sources.data)[made]);
+        if (!objs[made]) {
+            vc_oom();
+            ok = 0;
+            break;
+        }
+    }
+    if (ok)
+        ok = compile_jobs_run(cli, objs, compile_pipeline);
+    for (size_t i = 0; i < made; i++)
+        free(objs[i]);
+    free(objs);
+    return ok;
+}
+
 int compile_unit(const char *source, const cli_options_t *cli,
                  const char *output, int compile_obj)
 {
     if (!cli->link && compile_obj && cli->sources.count > 1) {
+        if (cli->jobs > 1)
+            return compile_objects_parallel(cli);
         int ok = 1;
         for (size_t i = 0; i < cli->sources.count && ok; i++) {
             const char *src = ((const char **)cli->sources.data)[i];
@@ -0,0 +1,207 @@
+/*
+ * Parallel compilation of translation units.
+ *
+ * Workers are forked processes rather than threads.  The front end keeps
+ * a fair amount of per-unit state in file scope variables (the label
+ * counter, the semantic globals and the list of emitted inline functions
+ * among others), and a fresh address space per unit isolates all of it
+ * without threading a context through every stage.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "util.h"
+#include "compile_jobs.h"
+#include "compile_helpers.h"
+
+typedef struct {
+    pid_t pid;       /* worker process or 0 once reaped */
+    int ok;          /* worker exited successfully */
+    int signaled;    /* worker was killed by a signal */
+    char *out_path;  /* captured standard output */
+    char *err_path;  /* captured standard error */
+} compile_job_t;
+
+/* Remove and free the capture files of JOB */
+static void job_remove_logs(compile_job_t *job)
+{
+    if (job->out_path) {
+        unlink(job->out_path);
+        free(job->out_path);
+        job->out_path = NULL;
+    }
+    if (job->err_path) {
+        unlink(job->err_path);
+        free(job->err_path);
+        job->err_path = NULL;
+    }
+}
+
+/*
+ * Fork a worker compiling SOURCE into OUTPUT with its standard output and
+ * error redirected to fresh temporary files.  Returns 1 on success.
+ */
+static int start_job(compile_job_t *job, const char *source,
+                     const char *output, const cli_options_t *cli,
+                     compile_job_fn compile)
+{
+    int out_fd = create_temp_file(cli, "vcout", &job->out_path);
+    if (out_fd < 0) {
+        perror("mkostemp");
+        return 0;
+    }
+    int err_fd = create_temp_file(cli, "vcerr", &job->err_path);
+    if (err_fd < 0) {
+        perror("mkostemp");
+        close(out_fd);
+        job_remove_logs(job);
+        return 0;
+    }
+
+    /* anything still buffered would otherwise be written twice */
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(out_fd);
+        close(err_fd);
+        job_remove_logs(job);
+        return 0;
+    }
+    if (pid == 0) {
+        if (dup2(out_fd, STDOUT_FILENO) < 0 ||
+            dup2(err_fd, STDERR_FILENO) < 0)
+            _exit(1);
+        close(out_fd);
+        close(err_fd);
+        int ok = compile(source, cli, output, 1);
+        fflush(NULL);
+        _exit(ok ? 0 : 1);
+    }
+
+    close(out_fd);
+    close(err_fd);
+    job->pid = pid;
+    return 1;
+}
+
+/*
+ * Wait for one of the first COUNT jobs to finish and record its status.
+ * Returns the finished job or NULL when waiting failed.
+ */
+static compile_job_t *wait_job(compile_job_t *jobs, size_t count)
+{
+    for (;;) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("waitpid");
+            return NULL;
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (jobs[i].pid != pid)
+                continue;
+            jobs[i].pid = 0;
+            jobs[i].ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+            jobs[i].signaled = WIFSIGNALED(status);
+            return &jobs[i];
+        }
+    }
+}
+
+/* Copy the contents of the file at PATH to DST */
+static int replay_file(const char *path, FILE *dst)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    char buf[4096];
+    size_t n;
+    int ok = 1;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        if (fwrite(buf, 1, n, dst) != n) {
+            ok = 0;
+            break;
+        }
+    }
+    fclose(f);
+    if (fflush(dst) == EOF)
+        ok = 0;
+    return ok;
+}
+
+int compile_jobs_run(const cli_options_t *cli, char *const *outputs,
+                     compile_job_fn compile)
+{
+    size_t count = cli->sources.count;
+    const char **sources = (const char **)cli->sources.data;
+    size_t max_jobs = cli->jobs ? cli->jobs : 1;
+    compile_job_t *jobs = vc_alloc_or_exit(count * sizeof(*jobs));
+    memset(jobs, 0, count * sizeof(*jobs));
+
+    /*
+     * Units are started in source order and no new unit is started after
+     * a failure, so every unit before the first failing one has run.
+     */
+    size_t started = 0;
+    size_t running = 0;
+    int ok = 1;
+    while (started < count || running) {
+        if (ok && started < count && running < max_jobs) {
+            if (start_job(&jobs[started], sources[started], outputs[started],
+                          cli, compile)) {
+                started++;
+                running++;
+                continue;
+            }
+            ok = 0;
+        }
+        if (!running)
+            break;
+        compile_job_t *done = wait_job(jobs, started);
+        if (!done) {
+            ok = 0;
+            break;
+        }
+        running--;
+        if (!done->ok)
+            ok = 0;
+    }
+
+    /* replay captured output in source order up to the first failure */
+    int replay = 1;
+    for (size_t i = 0; i < started; i++) {
+        if (jobs[i].pid)
+            replay = 0;
+        if (replay) {
+            if (!replay_file(jobs[i].out_path, stdout) ||
+                !replay_file(jobs[i].err_path, stderr))
+                ok = 0;
+            if (jobs[i].signaled)
+                fprintf(stderr, "vc: compiling %s terminated by signal\n",
+                        sources[i]);
+            if (!jobs[i].ok) {
+                ok = 0;
+                replay = 0;
+            }
+        }
+        job_remove_logs(&jobs[i]);
+    }
+    free(jobs);
+    return ok && started == count;
+}
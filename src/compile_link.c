@@ -19,6 +19,7 @@
 #include "startup.h"
 #include "cli.h"
 #include "compile_helpers.h"
+#include "compile_jobs.h"
 
 /*
  * Return a newly allocated object file name for the given source path.
@@ -181,9 +182,33 @@ static int push_object(vector_t *objs, char *obj)
     return 1;
 }
 
+/*
+ * Create a temporary object for every source and compile them on the job
+ * pool.  The objects are pushed in source order so the link order does not
+ * depend on which worker finishes first.
+ */
+static int compile_sources_parallel(const cli_options_t *cli, vector_t *objs)
+{
+    for (size_t i = 0; i < cli->sources.count; i++) {
+        char *obj = NULL;
+        int fd = create_temp_file(cli, "vcobj", &obj);
+        if (fd < 0) {
+            perror("mkostemp");
+            return 0;
+        }
+        close(fd);
+        if (!push_object(objs, obj))
+            return 0;
+    }
+    return compile_jobs_run(cli, (char *const *)objs->data, compile_unit);
+}
+
 /* Compile all CLI sources and append objects to the vector. */
 static int compile_all_sources(const cli_options_t *cli, vector_t *objs)
 {
+    if (cli->jobs > 1 && cli->sources.count > 1)
+        return compile_sources_parallel(cli, objs);
+
     for (size_t i = 0; i < cli->sources.count; i++) {
         const char *src = ((const char **)cli->sources.data)[i];
         char *obj = NULL;
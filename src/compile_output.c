@@ -11,6 +11,8 @@
 #include "ir_core.h"
 #include "ir_dump.h"
 #include "codegen.h"
+#include "asm_x86.h"
+#include "regalloc.h"
 #include "command.h"
 #include "compile_helpers.h"
 
@@ -138,10 +140,56 @@ static int invoke_assembler(const char *asmfile, const char *output,
     return 1;
 }
 
+/*
+ * Object files are encoded by the integrated assembler unless it was
+ * disabled.  Intel syntax is left to nasm and the line information of
+ * --debug and --emit-dwarf to the system assembler.
+ */
+static int use_integrated_as(const cli_options_t *cli)
+{
+    return cli->integrated_as && cli->asm_syntax == ASM_ATT &&
+           !cli->debug && !cli->emit_dwarf;
+}
+
+/*
+ * Generate the assembly into memory and encode it straight into the
+ * object file OUTPUT.  Errors are reported to stderr and 0 is returned.
+ *
+ * The instructions still take a round trip through text: only function
+ * bodies exist as x86_insn_t lists, while global data, .lcomm storage
+ * and the startup stub are written as assembly, so everything goes
+ * through the one parser in asm_x86.c rather than two encoders that
+ * could drift apart.
+ */
+static int assemble_integrated(ir_builder_t *ir, const char *output,
+                               int use_x86_64, const cli_options_t *cli)
+{
+    char *text = NULL;
+    size_t len = 0;
+    FILE *mem = open_memstream(&text, &len);
+    if (!mem) {
+        perror("open_memstream");
+        return 0;
+    }
+    codegen_emit_x86(mem, ir, use_x86_64, cli->asm_syntax);
+    if (fclose(mem) == EOF) {
+        perror("fclose");
+        free(text);
+        return 0;
+    }
+    int ok = asm_x86_assemble(text, len, use_x86_64, output);
+    free(text);
+    if (!ok)
+        fprintf(stderr, "assembly failed\n");
+    return ok;
+}
+
 static int emit_output_file(ir_builder_t *ir, const char *output,
                             int use_x86_64, int compile_obj,
                             const cli_options_t *cli)
 {
+    if (compile_obj && use_integrated_as(cli))
+        return assemble_integrated(ir, output, use_x86_64, cli);
     if (compile_obj) {
         /*
          * Write assembly to a temporary file and run the assembler.
@@ -177,6 +225,12 @@ int compile_output_impl(ir_builder_t *ir, const char *output,
                         int dump_ir, int dump_asm, int use_x86_64,
                         int compile, const cli_options_t *cli)
 {
+    /* -O2 and above color the interference graph unless told otherwise */
+    if (cli->regalloc >= 0)
+        regalloc_set_mode((regalloc_mode_t)cli->regalloc);
+    else
+        regalloc_set_mode(cli->opt_cfg.opt_level >= 2 ? REGALLOC_COLOR
+                                                      : REGALLOC_LINEAR);
     if (dump_ir) {
         char *text = ir_to_string(ir);
         if (text) {
@@ -185,6 +239,13 @@ int compile_output_impl(ir_builder_t *ir, const char *output,
         }
         return 1;
     }
+    if (cli->dump_regalloc) {
+        /* the allocator prints while the assembly is generated */
+        regalloc_set_dump(stdout);
+        free(codegen_ir_to_string(ir, use_x86_64, cli->asm_syntax));
+        regalloc_set_dump(NULL);
+        return 1;
+    }
     if (dump_asm) {
         char *text = codegen_ir_to_string(ir, use_x86_64,
                                           cli->asm_syntax);
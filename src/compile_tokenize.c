@@ -150,7 +150,8 @@ static int read_stdin_source(const cli_options_t *cli,
                              const vector_t *incdirs,
                              const vector_t *defines,
                              const vector_t *undefines,
-                             char **out_path, char **out_text)
+                             char **out_path, token_t **out_toks,
+                             size_t *out_count)
 {
     char *path = NULL;
     int fd = create_temp_file(cli, "vcstdin", &path);
@@ -196,11 +197,14 @@ static int read_stdin_source(const cli_options_t *cli,
 
     preproc_context_t ctx = {0};
     preproc_set_verbose_includes(cli->verbose_includes);
+    preproc_set_include_index(cli->include_index,
+                              cli->include_index_stats);
     ctx.max_include_depth = cli->max_include_depth;
-    char *text = preproc_run(&ctx, path, incdirs, defines, undefines,
-                             cli->sysroot, cli->vc_sysinclude,
-                             cli->internal_libc, cli->use_x86_64);
-    if (!text) {
+    token_t *toks = preproc_run_tokens(&ctx, path, incdirs, defines,
+                                       undefines, cli->sysroot,
+                                       cli->vc_sysinclude, cli->internal_libc,
+                                       cli->use_x86_64, out_count);
+    if (!toks) {
         perror("preproc_run");
         unlink(path);
         free(path);
@@ -212,7 +216,7 @@ static int read_stdin_source(const cli_options_t *cli,
     preproc_context_free(&ctx);
 
     *out_path = path;
-    *out_text = text;
+    *out_toks = toks;
     return 1;
 }
 
@@ -225,27 +229,36 @@ int compile_tokenize_impl(const char *source, const cli_options_t *cli,
     if (tmp_path)
         *tmp_path = NULL;
 
-    char *stdin_path = NULL;
-    char *text = NULL;
+    /*
+     * The preprocessor appends the tokens of each expanded line to the
+     * lexer stream, so no preprocessed source text is produced.
+     */
+    *out_src = NULL;
+
+    token_t *toks = NULL;
+    size_t count = 0;
     if (source && strcmp(source, "-") == 0) {
+        char *stdin_path = NULL;
         if (!read_stdin_source(cli, incdirs, defines, undefines,
-                               &stdin_path, &text))
+                               &stdin_path, &toks, &count))
             return 0;
         if (tmp_path)
             *tmp_path = stdin_path;
         else {
             unlink(stdin_path);
             free(stdin_path);
-            stdin_path = NULL;
         }
     } else {
         preproc_context_t ctx = {0};
         preproc_set_verbose_includes(cli->verbose_includes);
+        preproc_set_include_index(cli->include_index,
+                                  cli->include_index_stats);
         ctx.max_include_depth = cli->max_include_depth;
-        text = preproc_run(&ctx, source, incdirs, defines, undefines,
-                           cli->sysroot, cli->vc_sysinclude,
-                           cli->internal_libc, cli->use_x86_64);
-        if (!text) {
+        toks = preproc_run_tokens(&ctx, source, incdirs, defines, undefines,
+                                  cli->sysroot, cli->vc_sysinclude,
+                                  cli->internal_libc, cli->use_x86_64,
+                                  &count);
+        if (!toks) {
             perror("preproc_run");
             preproc_context_free(&ctx);
             return 0;
@@ -257,7 +270,7 @@ int compile_tokenize_impl(const char *source, const cli_options_t *cli,
                 if (!dup || !vector_push(deps, &dup)) {
                     free(dup);
                     preproc_context_free(&ctx);
-                    free(text);
+                    lexer_free_tokens(toks, count);
                     return 0;
                 }
             }
@@ -268,22 +281,8 @@ int compile_tokenize_impl(const char *source, const cli_options_t *cli,
         preproc_context_free(&ctx);
     }
 
-    size_t count = 0;
-    token_t *toks = lexer_tokenize(text, &count);
-    if (!toks) {
-        fprintf(stderr, "Tokenization failed\n");
-        free(text);
-        if (stdin_path) {
-            unlink(stdin_path);
-            free(stdin_path);
-        }
-        return 0;
-    }
-
-    *out_src = text;
     *out_toks = toks;
     if (out_count)
         *out_count = count;
     return 1;
 }
-
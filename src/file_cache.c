@@ -0,0 +1,196 @@
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+/*
+ * File system lookup cache used by the preprocessor.
+ *
+ * Each queried path gets one entry in an open-addressing hash table.
+ * The entry records the result of realpath() as a pointer to the entry
+ * of the canonical path, whether the file is readable and, for canonical
+ * entries, the loaded text of the file.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "file_cache.h"
+#include "util.h"
+
+/* Initial number of slots in the path table */
+#define FILE_CACHE_INIT_CAP 256
+
+typedef struct file_entry {
+    char *path;                /* lookup key */
+    size_t len;                /* strlen(path) */
+    unsigned hash;             /* hash of path */
+    struct file_entry *canon;  /* canonical entry once resolved */
+    int readable;              /* -1 unknown, 0 unreadable, 1 readable */
+    char *text;                /* cached spliced contents or NULL */
+    size_t text_len;           /* bytes in text including final NUL */
+    size_t *line_offs;         /* start offset of every line */
+    size_t line_count;         /* entries in line_offs */
+    dev_t dev;                 /* identity of the cached contents */
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+} file_entry_t;
+
+static file_entry_t **slots;
+static size_t cap;
+static size_t count;
+
+/* FNV-1a hash of the LEN bytes at NAME */
+static unsigned hash_path(const char *name, size_t len)
+{
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Return the slot holding PATH or the empty slot where it belongs */
+static file_entry_t **find_slot(file_entry_t **tab, size_t tab_cap,
+                                const char *path, size_t len, unsigned hash)
+{
+    size_t mask = tab_cap - 1;
+    size_t i = hash & mask;
+    while (tab[i]) {
+        file_entry_t *e = tab[i];
+        if (e->hash == hash && e->len == len && memcmp(e->path, path, len) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+    return &tab[i];
+}
+
+/* Double the table size, keeping every entry */
+static void grow_table(void)
+{
+    size_t new_cap = cap ? cap * 2 : FILE_CACHE_INIT_CAP;
+    file_entry_t **tab = vc_alloc_or_exit(new_cap * sizeof(*tab));
+    memset(tab, 0, new_cap * sizeof(*tab));
+    for (size_t i = 0; i < cap; i++) {
+        file_entry_t *e = slots[i];
+        if (e)
+            *find_slot(tab, new_cap, e->path, e->len, e->hash) = e;
+    }
+    free(slots);
+    slots = tab;
+    cap = new_cap;
+}
+
+/* Return the entry for PATH, creating it when necessary */
+static file_entry_t *intern_path(const char *path)
+{
+    if ((count + 1) * 4 >= cap * 3)
+        grow_table();
+    size_t len = strlen(path);
+    unsigned hash = hash_path(path, len);
+    file_entry_t **slot = find_slot(slots, cap, path, len, hash);
+    if (*slot)
+        return *slot;
+
+    file_entry_t *e = vc_alloc_or_exit(sizeof(*e));
+    memset(e, 0, sizeof(*e));
+    e->path = vc_alloc_or_exit(len + 1);
+    memcpy(e->path, path, len + 1);
+    e->len = len;
+    e->hash = hash;
+    e->readable = -1;
+    *slot = e;
+    count++;
+    return e;
+}
+
+const char *file_cache_realpath(const char *path)
+{
+    file_entry_t *e = intern_path(path);
+    if (!e->canon) {
+        char *real = realpath(path, NULL);
+        if (real) {
+            e->canon = intern_path(real);
+            free(real);
+        } else {
+            e->canon = e;
+        }
+        e->canon->canon = e->canon;
+    }
+    return e->canon->path;
+}
+
+int file_cache_readable(const char *path)
+{
+    file_entry_t *e = intern_path(path);
+    if (e->readable < 0)
+        e->readable = access(path, R_OK) == 0;
+    return e->readable;
+}
+
+int file_cache_get_lines(const char *canon, char **out_text,
+                         char ***out_lines)
+{
+    file_entry_t *e = intern_path(canon);
+    if (!e->text)
+        return 0;
+
+    struct stat st;
+    if (stat(canon, &st) != 0 || st.st_dev != e->dev || st.st_ino != e->ino ||
+        st.st_size != e->size || st.st_mtime != e->mtime)
+        return 0;
+
+    char *text = vc_alloc_or_exit(e->text_len);
+    memcpy(text, e->text, e->text_len);
+    char **lines = vc_alloc_or_exit(sizeof(char *) * (e->line_count + 1));
+    for (size_t i = 0; i < e->line_count; i++)
+        lines[i] = text + e->line_offs[i];
+    lines[e->line_count] = NULL;
+    *out_text = text;
+    *out_lines = lines;
+    return 1;
+}
+
+void file_cache_put_lines(const char *canon, const char *text, size_t len,
+                          char **lines, const struct stat *st)
+{
+    file_entry_t *e = intern_path(canon);
+    free(e->text);
+    free(e->line_offs);
+
+    size_t n = 0;
+    while (lines[n])
+        n++;
+    e->text = vc_alloc_or_exit(len);
+    memcpy(e->text, text, len);
+    e->line_offs = vc_alloc_or_exit(sizeof(size_t) * (n ? n : 1));
+    for (size_t i = 0; i < n; i++)
+        e->line_offs[i] = (size_t)(lines[i] - text);
+    e->text_len = len;
+    e->line_count = n;
+    e->dev = st->st_dev;
+    e->ino = st->st_ino;
+    e->size = st->st_size;
+    e->mtime = st->st_mtime;
+}
+
+void file_cache_cleanup(void)
+{
+    for (size_t i = 0; i < cap; i++) {
+        file_entry_t *e = slots[i];
+        if (!e)
+            continue;
+        free(e->path);
+        free(e->text);
+        free(e->line_offs);
+        free(e);
+    }
+    free(slots);
+    slots = NULL;
+    cap = 0;
+    count = 0;
+}
@@ -0,0 +1,267 @@
+#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE
+/*
+ * Directory listing index used by find_include_path().
+ *
+ * Every directory consulted is read once with opendir()/readdir() and
+ * its entry names are stored in an open-addressing hash set.  The
+ * directories themselves live in a second hash table keyed by path so
+ * that a lookup of "sys/types.h" below a search directory costs two
+ * hash probes once both levels have been listed.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "include_index.h"
+#include "strbuf.h"
+#include "util.h"
+
+/* Initial slot counts for the directory table and entry sets */
+#define INDEX_DIRS_INIT_CAP 64
+#define INDEX_NAMES_INIT_CAP 32
+
+typedef struct {
+    char *path;      /* directory path without trailing slash */
+    size_t len;      /* strlen(path) */
+    unsigned hash;   /* hash of path */
+    int status;      /* 1 listed, 0 missing, -1 unreadable */
+    char **names;    /* open-addressing set of entry names */
+    size_t cap;      /* slots in names */
+    size_t count;    /* entries stored */
+} index_dir_t;
+
+static bool index_enabled = false;
+static index_dir_t **dirs;
+static size_t dirs_cap;
+static size_t dirs_count;
+
+static struct {
+    size_t dirs_read;  /* directories listed */
+    size_t entries;    /* names stored across all listings */
+    size_t lookups;    /* include_index_lookup() calls */
+    size_t found;      /* names present in a listing */
+    size_t rejected;   /* names answered as missing */
+    size_t fallbacks;  /* names left to the caller to probe */
+} stats;
+
+/* FNV-1a hash of the LEN bytes at NAME */
+static unsigned hash_bytes(const char *name, size_t len)
+{
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Return the slot holding the LEN bytes at NAME in the set NAMES */
+static char **name_slot(char **names, size_t cap, const char *name,
+                        size_t len)
+{
+    size_t mask = cap - 1;
+    size_t i = hash_bytes(name, len) & mask;
+    while (names[i]) {
+        if (strncmp(names[i], name, len) == 0 && names[i][len] == '\0')
+            break;
+        i = (i + 1) & mask;
+    }
+    return &names[i];
+}
+
+/* Add the directory entry NAME to the set of D */
+static void add_name(index_dir_t *d, const char *name)
+{
+    if ((d->count + 1) * 4 >= d->cap * 3) {
+        size_t new_cap = d->cap ? d->cap * 2 : INDEX_NAMES_INIT_CAP;
+        char **tab = vc_alloc_or_exit(new_cap * sizeof(*tab));
+        memset(tab, 0, new_cap * sizeof(*tab));
+        for (size_t i = 0; i < d->cap; i++) {
+            char *n = d->names[i];
+            if (n)
+                *name_slot(tab, new_cap, n, strlen(n)) = n;
+        }
+        free(d->names);
+        d->names = tab;
+        d->cap = new_cap;
+    }
+    size_t len = strlen(name);
+    char **slot = name_slot(d->names, d->cap, name, len);
+    if (*slot)
+        return;
+    *slot = vc_strndup(name, len);
+    if (!*slot) {
+        vc_oom();
+        exit(1);
+    }
+    d->count++;
+    stats.entries++;
+}
+
+/* Read the entries of D from the file system */
+static void list_dir(index_dir_t *d)
+{
+    DIR *dp = opendir(d->path);
+    if (!dp) {
+        d->status = (errno == ENOENT || errno == ENOTDIR) ? 0 : -1;
+        return;
+    }
+    struct dirent *ent;
+    while ((ent = readdir(dp)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+        add_name(d, ent->d_name);
+    }
+    closedir(dp);
+    d->status = 1;
+    stats.dirs_read++;
+}
+
+/* Return the slot for PATH in the directory table TAB */
+static index_dir_t **dir_slot(index_dir_t **tab, size_t cap,
+                              const char *path, size_t len, unsigned hash)
+{
+    size_t mask = cap - 1;
+    size_t i = hash & mask;
+    while (tab[i]) {
+        index_dir_t *d = tab[i];
+        if (d->hash == hash && d->len == len &&
+            memcmp(d->path, path, len) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+    return &tab[i];
+}
+
+/* Return the listing of the LEN byte directory PATH, reading it on demand */
+static index_dir_t *get_dir(const char *path, size_t len)
+{
+    if ((dirs_count + 1) * 4 >= dirs_cap * 3) {
+        size_t new_cap = dirs_cap ? dirs_cap * 2 : INDEX_DIRS_INIT_CAP;
+        index_dir_t **tab = vc_alloc_or_exit(new_cap * sizeof(*tab));
+        memset(tab, 0, new_cap * sizeof(*tab));
+        for (size_t i = 0; i < dirs_cap; i++) {
+            index_dir_t *d = dirs[i];
+            if (d)
+                *dir_slot(tab, new_cap, d->path, d->len, d->hash) = d;
+        }
+        free(dirs);
+        dirs = tab;
+        dirs_cap = new_cap;
+    }
+
+    unsigned hash = hash_bytes(path, len);
+    index_dir_t **slot = dir_slot(dirs, dirs_cap, path, len, hash);
+    if (*slot)
+        return *slot;
+
+    index_dir_t *d = vc_alloc_or_exit(sizeof(*d));
+    memset(d, 0, sizeof(*d));
+    d->path = vc_strndup(path, len);
+    if (!d->path) {
+        vc_oom();
+        exit(1);
+    }
+    d->len = len;
+    d->hash = hash;
+    *slot = d;
+    dirs_count++;
+    list_dir(d);
+    return d;
+}
+
+void include_index_enable(bool flag)
+{
+    index_enabled = flag;
+}
+
+bool include_index_enabled(void)
+{
+    return index_enabled;
+}
+
+int include_index_lookup(const char *dir, const char *name)
+{
+    stats.lookups++;
+    size_t dlen = strlen(dir);
+    while (dlen > 1 && dir[dlen - 1] == '/')
+        dlen--;
+    if (dlen == 0 || name[0] == '/') {
+        stats.fallbacks++;
+        return -1;
+    }
+
+    strbuf_t path;
+    strbuf_init(&path);
+    strbuf_appendf(&path, "%.*s", (int)dlen, dir);
+
+    int result = -1;
+    const char *p = name;
+    for (;;) {
+        const char *slash = strchr(p, '/');
+        size_t n = slash ? (size_t)(slash - p) : strlen(p);
+        if (n == 0 || (n == 1 && p[0] == '.') ||
+            (n == 2 && p[0] == '.' && p[1] == '.'))
+            break;
+
+        index_dir_t *d = get_dir(path.data, path.len);
+        if (d->status < 0)
+            break;
+        if (d->status == 0 || !d->count ||
+            !*name_slot(d->names, d->cap, p, n)) {
+            result = 0;
+            break;
+        }
+        if (!slash) {
+            result = 1;
+            break;
+        }
+        if (path.data[path.len - 1] != '/')
+            strbuf_append(&path, "/");
+        strbuf_appendf(&path, "%.*s", (int)n, p);
+        p = slash + 1;
+    }
+    strbuf_free(&path);
+
+    if (result > 0)
+        stats.found++;
+    else if (result == 0)
+        stats.rejected++;
+    else
+        stats.fallbacks++;
+    return result;
+}
+
+void include_index_print_stats(FILE *fp)
+{
+    fprintf(fp, "include index: %zu directories listed, %zu entries\n",
+            stats.dirs_read, stats.entries);
+    fprintf(fp, "include index: %zu lookups, %zu found, %zu rejected "
+            "without a probe, %zu probed directly\n",
+            stats.lookups, stats.found, stats.rejected, stats.fallbacks);
+}
+
+void include_index_cleanup(void)
+{
+    for (size_t i = 0; i < dirs_cap; i++) {
+        index_dir_t *d = dirs[i];
+        if (!d)
+            continue;
+        for (size_t j = 0; j < d->cap; j++)
+            free(d->names[j]);
+        free(d->names);
+        free(d->path);
+        free(d);
+    }
+    free(dirs);
+    dirs = NULL;
+    dirs_cap = 0;
+    dirs_count = 0;
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,143 @@
+/*
+ * String interning backed by an arena.
+ *
+ * Interned strings are appended to large arena blocks so each new string
+ * costs no individual allocation.  An open-addressing hash set of
+ * pointers into the arena finds existing copies.  The length and hash of
+ * every string are kept next to its pointer so lookups only compare the
+ * bytes of candidates with a matching hash.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "intern.h"
+#include "util.h"
+
+/* Size of each arena block; longer strings get a block of their own */
+#define INTERN_BLOCK_SIZE 65536
+/* Initial number of slots in the hash set */
+#define INTERN_INIT_CAP 1024
+
+typedef struct intern_block {
+    struct intern_block *next; /* previously filled block */
+    size_t used;               /* bytes handed out from data */
+    size_t size;               /* capacity of data */
+    char data[];               /* string storage */
+} intern_block_t;
+
+typedef struct {
+    const char *str; /* interned string or NULL for an empty slot */
+    size_t len;      /* strlen(str) */
+    unsigned hash;   /* hash of str */
+} intern_slot_t;
+
+static intern_block_t *blocks;
+static intern_slot_t *slots;
+static size_t cap;
+static size_t count;
+
+/* FNV-1a hash of the LEN bytes at TEXT */
+static unsigned hash_text(const char *text, size_t len)
+{
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)text[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/* Return the slot for TEXT in TAB */
+static intern_slot_t *find_slot(intern_slot_t *tab, size_t tab_cap,
+                                const char *text, size_t len, unsigned hash)
+{
+    size_t mask = tab_cap - 1;
+    size_t i = hash & mask;
+    while (tab[i].str) {
+        if (tab[i].hash == hash && tab[i].len == len &&
+            memcmp(tab[i].str, text, len) == 0)
+            break;
+        i = (i + 1) & mask;
+    }
+    return &tab[i];
+}
+
+/* Double the hash set, moving every slot */
+static void grow_slots(void)
+{
+    size_t new_cap = cap ? cap * 2 : INTERN_INIT_CAP;
+    intern_slot_t *tab = vc_alloc_or_exit(new_cap * sizeof(*tab));
+    memset(tab, 0, new_cap * sizeof(*tab));
+    for (size_t i = 0; i < cap; i++) {
+        if (slots[i].str)
+            *find_slot(tab, new_cap, slots[i].str, slots[i].len,
+                       slots[i].hash) = slots[i];
+    }
+    free(slots);
+    slots = tab;
+    cap = new_cap;
+}
+
+/* Copy the LEN bytes at TEXT into the arena and NUL terminate them */
+static const char *arena_copy(const char *text, size_t len)
+{
+    if (!blocks || blocks->size - blocks->used < len + 1) {
+        size_t size = len + 1 > INTERN_BLOCK_SIZE ? len + 1 : INTERN_BLOCK_SIZE;
+        intern_block_t *b = vc_alloc_or_exit(sizeof(*b) + size);
+        b->used = 0;
+        b->size = size;
+        b->next = blocks;
+        blocks = b;
+    }
+    char *dst = blocks->data + blocks->used;
+    memcpy(dst, text, len);
+    dst[len] = '\0';
+    blocks->used += len + 1;
+    return dst;
+}
+
+const char *intern_text(const char *text, size_t len)
+{
+    if ((count + 1) * 4 >= cap * 3)
+        grow_slots();
+    unsigned hash = hash_text(text, len);
+    intern_slot_t *slot = find_slot(slots, cap, text, len, hash);
+    if (!slot->str) {
+        slot->str = arena_copy(text, len);
+        slot->len = len;
+        slot->hash = hash;
+        count++;
+    }
+    return slot->str;
+}
+
+const char *intern_str(const char *str)
+{
+    return intern_text(str, strlen(str));
+}
+
+const char *intern_find(const char *str)
+{
+    if (!cap)
+        return NULL;
+    size_t len = strlen(str);
+    intern_slot_t *slot = find_slot(slots, cap, str, len, hash_text(str, len));
+    return slot->str;
+}
+
+void intern_cleanup(void)
+{
+    while (blocks) {
+        intern_block_t *next = blocks->next;
+        free(blocks);
+        blocks = next;
+    }
+    free(slots);
+    slots = NULL;
+    cap = 0;
+    count = 0;
+}
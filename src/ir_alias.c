@@ -0,0 +1,439 @@
+/*
+ * Points-to, effective type and restrict based alias analysis.
+ *
+ * Points-to sets are bit masks over the address taken locals of the
+ * function plus IR_ALIAS_UNKNOWN.  They are solved by iterating over
+ * the instructions until no set grows, which takes a handful of rounds
+ * since sets only flow along def-use chains and through the locals
+ * holding pointers.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "ir_alias.h"
+
+/* Kinds of storage a memory instruction may access */
+enum { LOC_ANY, LOC_NAMED, LOC_PARAM, LOC_PTR };
+
+typedef struct {
+    int kind;
+    const char *name;      /* LOC_NAMED */
+    long long param;       /* LOC_PARAM */
+    uint64_t pts;          /* LOC_PTR, never empty */
+} location_t;
+
+/* Steps followed from an address back to the parameter it is based on */
+#define ALIAS_MAX_BASE_STEPS 64
+
+static int at_func_end(const ir_instr_t *ins)
+{
+    return !ins || ins->op == IR_FUNC_END || ins->op == IR_FUNC_BEGIN;
+}
+
+static int is_local_name(const char *name)
+{
+    return name && strncmp(name, "stack:", 6) == 0;
+}
+
+static size_t name_hash(const char *name)
+{
+    uintptr_t h = (uintptr_t)name;
+    return (size_t)(h ^ (h >> 4) ^ (h >> 12));
+}
+
+/* Return the slot of local NAME: its entry or the empty slot to fill */
+static ir_alias_var_t *var_slot(const ir_alias_t *aa, const char *name)
+{
+    if (!is_local_name(name) || !aa->var_cap)
+        return NULL;
+    size_t mask = aa->var_cap - 1;
+    size_t s = name_hash(name) & mask;
+    while (aa->vars[s].name && aa->vars[s].name != name)
+        s = (s + 1) & mask;
+    return &aa->vars[s];
+}
+
+static ir_alias_var_t *find_var(const ir_alias_t *aa, const char *name)
+{
+    ir_alias_var_t *v = var_slot(aa, name);
+    return v && v->name ? v : NULL;
+}
+
+static ir_alias_var_t *add_var(ir_alias_t *aa, const char *name)
+{
+    ir_alias_var_t *v = var_slot(aa, name);
+    if (v && !v->name) {
+        v->name = name;
+        v->object = -1;
+    }
+    return v;
+}
+
+/* Non-zero for a local only ever accessed by name */
+static int is_tracked(const ir_alias_var_t *v)
+{
+    return v && v->object < 0 && !v->exposed;
+}
+
+static uint64_t value_pts(const ir_alias_t *aa, int v)
+{
+    if (v <= 0)
+        return 0;
+    /* created after the analysis, may hold the address of any local */
+    if (v < aa->lo || (size_t)(v - aa->lo) >= aa->count)
+        return ~(uint64_t)0;
+    return aa->pts[v - aa->lo];
+}
+
+static ir_instr_t *def_of(const ir_alias_t *aa, int v)
+{
+    if (v < aa->lo || v <= 0 || (size_t)(v - aa->lo) >= aa->count)
+        return NULL;
+    return aa->def[v - aa->lo];
+}
+
+/* Points-to set of the value defined by INS */
+static uint64_t def_pts(const ir_alias_t *aa, const ir_instr_t *ins)
+{
+    const ir_alias_var_t *v;
+    switch (ins->op) {
+    case IR_ADDR:
+        v = find_var(aa, ins->name);
+        return v && v->object >= 0 ? (uint64_t)1 << v->object
+                                   : IR_ALIAS_UNKNOWN;
+    case IR_LOAD:
+        v = find_var(aa, ins->name);
+        return is_tracked(v) ? v->pts : IR_ALIAS_UNKNOWN;
+    case IR_PHI: {
+        uint64_t p = 0;
+        ir_phi_arg_t *args = ir_phi_args(ins);
+        for (long long a = 0; a < ins->imm; a++)
+            p |= value_pts(aa, args[a].value);
+        return p;
+    }
+    case IR_PTR_ADD: case IR_COPY: case IR_CAST:
+        return value_pts(aa, ins->src1);
+    case IR_CONST: case IR_PTR_DIFF:
+    case IR_CMPEQ: case IR_CMPNE: case IR_CMPLT: case IR_CMPGT:
+    case IR_CMPLE: case IR_CMPGE: case IR_LOGAND: case IR_LOGOR:
+        return 0;
+    case IR_LOAD_PTR: case IR_LOAD_IDX: case IR_BFLOAD: case IR_LOAD_PARAM:
+    case IR_CALL: case IR_CALL_PTR: case IR_CALL_NR: case IR_CALL_PTR_NR:
+    case IR_ALLOCA: case IR_GLOB_STRING: case IR_GLOB_WSTRING:
+        return IR_ALIAS_UNKNOWN;
+    default:
+        /* integer arithmetic may carry an address in either operand */
+        return value_pts(aa, ins->src1) | value_pts(aa, ins->src2);
+    }
+}
+
+/* Locals whose address INS hands to code outside the analysis */
+static uint64_t escaping(const ir_alias_t *aa, const ir_instr_t *ins)
+{
+    switch (ins->op) {
+    case IR_STORE:
+        if (is_tracked(find_var(aa, ins->name)))
+            return 0;
+        return value_pts(aa, ins->src1);
+    case IR_STORE_PARAM: case IR_BFSTORE: case IR_ARG:
+    case IR_RETURN: case IR_RETURN_AGG:
+        return value_pts(aa, ins->src1);
+    case IR_STORE_IDX: case IR_STORE_PTR:
+        return value_pts(aa, ins->src2);
+    default:
+        return 0;
+    }
+}
+
+/* Record definitions, locals and address taken objects of the function */
+static void scan_function(ir_alias_t *aa)
+{
+    int objects = 0;
+    for (ir_instr_t *i = aa->begin->next; !at_func_end(i); i = i->next) {
+        if (i->dest > 0)
+            aa->def[i->dest - aa->lo] = i;
+        ir_alias_var_t *v = add_var(aa, i->name);
+        if (i->op == IR_ADDR) {
+            if (!v) {
+                aa->params_exposed = 1;
+            } else if (v->object < 0 && !v->exposed) {
+                if (objects < IR_ALIAS_MAX_LOCALS)
+                    v->object = objects++;
+                else
+                    v->exposed = 1;
+            }
+        } else if (i->op == IR_STORE_PARAM) {
+            if (i->imm >= 0 && i->imm < 64)
+                aa->stored |= (uint64_t)1 << i->imm;
+            else
+                aa->stored = ~(uint64_t)0;
+        }
+    }
+}
+
+/* Grow the points-to sets until they no longer change */
+static void solve(ir_alias_t *aa)
+{
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (ir_instr_t *i = aa->begin->next; !at_func_end(i); i = i->next) {
+            uint64_t *set;
+            uint64_t p;
+            if (i->op == IR_STORE) {
+                ir_alias_var_t *v = find_var(aa, i->name);
+                if (!is_tracked(v))
+                    continue;
+                set = &v->pts;
+                p = value_pts(aa, i->src1);
+            } else if (i->dest > 0) {
+                set = &aa->pts[i->dest - aa->lo];
+                p = def_pts(aa, i);
+            } else {
+                continue;
+            }
+            if (p & ~*set) {
+                *set |= p;
+                changed = 1;
+            }
+        }
+    }
+    for (ir_instr_t *i = aa->begin->next; !at_func_end(i); i = i->next)
+        aa->escaped |= escaping(aa, i);
+    aa->escaped &= ~IR_ALIAS_UNKNOWN;
+}
+
+int ir_alias_init(ir_alias_t *aa, ir_instr_t *begin)
+{
+    memset(aa, 0, sizeof(*aa));
+    aa->begin = begin;
+    int lo = INT_MAX, hi = 0;
+    size_t named = 0;
+    for (ir_instr_t *i = begin->next; !at_func_end(i); i = i->next) {
+        if (i->dest > 0 && i->dest < lo)
+            lo = i->dest;
+        if (i->dest > hi)
+            hi = i->dest;
+        if (is_local_name(i->name))
+            named++;
+    }
+    if (hi >= lo) {
+        aa->lo = lo;
+        aa->count = (size_t)(hi - lo) + 1;
+    }
+    size_t cap = 16;
+    while (cap < named * 2)
+        cap *= 2;
+    aa->pts = calloc(aa->count ? aa->count : 1, sizeof(*aa->pts));
+    aa->def = calloc(aa->count ? aa->count : 1, sizeof(*aa->def));
+    aa->vars = calloc(cap, sizeof(*aa->vars));
+    if (!aa->pts || !aa->def || !aa->vars) {
+        ir_alias_free(aa);
+        return 0;
+    }
+    aa->var_cap = cap;
+    scan_function(aa);
+    solve(aa);
+    return 1;
+}
+
+void ir_alias_free(ir_alias_t *aa)
+{
+    free(aa->pts);
+    free(aa->def);
+    free(aa->vars);
+    memset(aa, 0, sizeof(*aa));
+}
+
+static void locate(const ir_alias_t *aa, const ir_instr_t *ins,
+                   location_t *loc)
+{
+    memset(loc, 0, sizeof(*loc));
+    switch (ins->op) {
+    case IR_LOAD: case IR_STORE: case IR_LOAD_IDX: case IR_STORE_IDX:
+    case IR_BFLOAD: case IR_BFSTORE:
+        loc->kind = LOC_NAMED;
+        loc->name = ins->name;
+        break;
+    case IR_LOAD_PARAM: case IR_STORE_PARAM:
+        loc->kind = LOC_PARAM;
+        loc->param = ins->imm;
+        break;
+    case IR_LOAD_PTR: case IR_STORE_PTR:
+        loc->kind = LOC_PTR;
+        loc->pts = value_pts(aa, ins->src1);
+        /* e.g. an integer converted to a pointer */
+        if (!loc->pts)
+            loc->pts = IR_ALIAS_UNKNOWN;
+        break;
+    default:
+        loc->kind = LOC_ANY;
+        break;
+    }
+}
+
+/* Return the points-to bit of variable NAME or 0 */
+static uint64_t named_bit(const ir_alias_t *aa, const char *name)
+{
+    const ir_alias_var_t *v = find_var(aa, name);
+    return v && v->object >= 0 ? (uint64_t)1 << v->object : 0;
+}
+
+/* Return non-zero when unknown pointers may reach variable NAME */
+static int named_exposed(const ir_alias_t *aa, const char *name)
+{
+    if (!is_local_name(name))
+        return 1;
+    const ir_alias_var_t *v = find_var(aa, name);
+    return v && (v->exposed || (aa->escaped & named_bit(aa, name)));
+}
+
+static int overlap(const ir_alias_t *aa, const location_t *a,
+                   const location_t *b)
+{
+    if (a->kind > b->kind) {
+        const location_t *t = a;
+        a = b;
+        b = t;
+    }
+    switch (a->kind) {
+    case LOC_NAMED:
+        if (b->kind == LOC_NAMED)
+            return a->name == b->name;
+        if (b->kind == LOC_PARAM)
+            return 0;
+        return (b->pts & named_bit(aa, a->name)) ||
+               ((b->pts & IR_ALIAS_UNKNOWN) && named_exposed(aa, a->name));
+    case LOC_PARAM:
+        if (b->kind == LOC_PARAM)
+            return a->param == b->param;
+        return (b->pts & IR_ALIAS_UNKNOWN) && aa->params_exposed;
+    case LOC_PTR: {
+        uint64_t reach = aa->escaped | IR_ALIAS_UNKNOWN;
+        if (a->pts & b->pts & ~IR_ALIAS_UNKNOWN)
+            return 1;
+        return ((a->pts & IR_ALIAS_UNKNOWN) && (b->pts & reach)) ||
+               ((b->pts & IR_ALIAS_UNKNOWN) && (a->pts & reach));
+    }
+    default:
+        return 1;
+    }
+}
+
+/*
+ * Return the index of the parameter the address V is computed from or
+ * -1.  Parameters assigned in the function or possibly written through
+ * a pointer no longer identify what they pointed to on entry.
+ */
+static long long base_param(const ir_alias_t *aa, int v)
+{
+    for (int step = 0; step < ALIAS_MAX_BASE_STEPS; step++) {
+        const ir_instr_t *d = def_of(aa, v);
+        if (!d)
+            return -1;
+        if (d->op == IR_PTR_ADD || d->op == IR_CAST) {
+            v = d->src1;
+            continue;
+        }
+        if (d->op != IR_LOAD_PARAM || aa->params_exposed || d->imm < 0 ||
+            d->imm >= 64 || (aa->stored >> d->imm) & 1)
+            return -1;
+        return d->imm;
+    }
+    return -1;
+}
+
+/*
+ * Accesses based on different parameters do not overlap when one of
+ * them is restrict qualified: an object modified through a restrict
+ * pointer is only accessed through pointers based on it.
+ */
+static int restrict_disjoint(const ir_alias_t *aa, const ir_instr_t *a,
+                             const ir_instr_t *b)
+{
+    if (!a->is_restrict && !b->is_restrict)
+        return 0;
+    long long pa = base_param(aa, a->src1);
+    long long pb = base_param(aa, b->src1);
+    return pa >= 0 && pb >= 0 && pa != pb;
+}
+
+static int is_bitfield(const ir_instr_t *ins)
+{
+    return ins->op == IR_BFLOAD || ins->op == IR_BFSTORE;
+}
+
+int ir_may_alias(const ir_alias_t *aa, const ir_instr_t *a,
+                 const ir_instr_t *b)
+{
+    location_t la, lb;
+    locate(aa, a, &la);
+    locate(aa, b, &lb);
+    if (!overlap(aa, &la, &lb))
+        return 0;
+    if (la.kind == LOC_ANY || lb.kind == LOC_ANY)
+        return 1;
+    if (la.kind == LOC_PTR && lb.kind == LOC_PTR &&
+        restrict_disjoint(aa, a, b))
+        return 0;
+    /* named accesses of one variable may pun through a union */
+    if ((la.kind == LOC_PTR || lb.kind == LOC_PTR) && !is_bitfield(a) &&
+        !is_bitfield(b) && !ir_types_may_alias(a->type, b->type))
+        return 0;
+    return 1;
+}
+
+int ir_call_may_access(const ir_alias_t *aa, const ir_instr_t *mem)
+{
+    location_t loc;
+    locate(aa, mem, &loc);
+    switch (loc.kind) {
+    case LOC_NAMED:
+        return named_exposed(aa, loc.name);
+    case LOC_PARAM:
+        return aa->params_exposed;
+    case LOC_PTR:
+        return (loc.pts & (aa->escaped | IR_ALIAS_UNKNOWN)) != 0;
+    default:
+        return 1;
+    }
+}
+
+/* Map TYPE to the representative of the types it may alias */
+static type_kind_t alias_class(type_kind_t t)
+{
+    switch (t) {
+    case TYPE_UINT: case TYPE_ENUM:
+        return TYPE_INT;
+    case TYPE_USHORT:
+        return TYPE_SHORT;
+    case TYPE_ULONG:
+        return TYPE_LONG;
+    case TYPE_ULLONG:
+        return TYPE_LLONG;
+    default:
+        return t;
+    }
+}
+
+static int aliases_all(type_kind_t t)
+{
+    switch (t) {
+    case TYPE_CHAR: case TYPE_UCHAR: case TYPE_VOID: case TYPE_ARRAY:
+    case TYPE_STRUCT: case TYPE_UNION: case TYPE_UNKNOWN:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int ir_types_may_alias(type_kind_t a, type_kind_t b)
+{
+    if (aliases_all(a) || aliases_all(b))
+        return 1;
+    return alias_class(a) == alias_class(b);
+}
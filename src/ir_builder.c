@@ -1,14 +1,116 @@
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include "ir_builder.h"
+#include "ir_defuse.h"
 #include "util.h"
+#include "intern.h"
+
+/* First chunk size; later chunks double up to IR_ARENA_MAX_CHUNK */
+#define IR_ARENA_MIN_CHUNK 4096
+#define IR_ARENA_MAX_CHUNK 262144
+
+/* Alignment of every arena allocation */
+typedef union {
+    long long ll;
+    long double ld;
+    void *p;
+} ir_arena_align_t;
+
+#define IR_ARENA_ALIGN sizeof(ir_arena_align_t)
+/* Chunk header rounded up so the payload stays aligned */
+#define IR_ARENA_HEADER \
+    ((sizeof(ir_arena_chunk_t) + IR_ARENA_ALIGN - 1) & ~(IR_ARENA_ALIGN - 1))
+
+/* Link a new chunk able to hold at least SIZE bytes */
+static ir_arena_chunk_t *arena_new_chunk(ir_arena_t *a, size_t size)
+{
+    if (!a->next_size)
+        a->next_size = IR_ARENA_MIN_CHUNK;
+    size_t cap = size > a->next_size ? size : a->next_size;
+    ir_arena_chunk_t *c = malloc(IR_ARENA_HEADER + cap);
+    if (!c)
+        return NULL;
+    c->used = 0;
+    c->size = cap;
+    if (cap > a->next_size && a->chunks) {
+        /* oversized request: keep filling the current chunk afterwards */
+        c->next = a->chunks->next;
+        a->chunks->next = c;
+    } else {
+        c->next = a->chunks;
+        a->chunks = c;
+        if (a->next_size < IR_ARENA_MAX_CHUNK)
+            a->next_size *= 2;
+    }
+    return c;
+}
+
+void *ir_arena_alloc(ir_builder_t *b, size_t size)
+{
+    ir_arena_t *a = &b->arena;
+    if (size > SIZE_MAX - IR_ARENA_HEADER - IR_ARENA_ALIGN)
+        return NULL;
+    size = (size + IR_ARENA_ALIGN - 1) & ~(IR_ARENA_ALIGN - 1);
+    ir_arena_chunk_t *c = a->chunks;
+    if (!c || c->size - c->used < size) {
+        c = arena_new_chunk(a, size);
+        if (!c)
+            return NULL;
+    }
+    void *p = (char *)c + IR_ARENA_HEADER + c->used;
+    c->used += size;
+    return p;
+}
+
+char *ir_arena_strdup(ir_builder_t *b, const char *str)
+{
+    size_t len = strlen(str);
+    char *p = ir_arena_alloc(b, len + 1);
+    if (p)
+        memcpy(p, str, len + 1);
+    return p;
+}
+
+ir_instr_t *ir_alloc_instr(ir_builder_t *b)
+{
+    ir_instr_t *ins = b->arena.free_instrs;
+    if (ins)
+        b->arena.free_instrs = ins->next;
+    else
+        ins = ir_arena_alloc(b, sizeof(*ins));
+    if (ins)
+        memset(ins, 0, sizeof(*ins));
+    return ins;
+}
+
+void ir_release_instr(ir_builder_t *b, ir_instr_t *ins)
+{
+    if (b->defuse)
+        ir_defuse_forget(b->defuse, ins);
+    /* the data payload stays in the arena until the builder is freed */
+    ins->data = NULL;
+    ins->next = b->arena.free_instrs;
+    b->arena.free_instrs = ins;
+}
+
+void ir_arena_release(ir_arena_t *a)
+{
+    while (a->chunks) {
+        ir_arena_chunk_t *next = a->chunks->next;
+        free(a->chunks);
+        a->chunks = next;
+    }
+    a->next_size = 0;
+    a->free_instrs = NULL;
+}
 
 /* Allocate and append a blank instruction */
 ir_instr_t *append_instr(ir_builder_t *b)
 {
-    ir_instr_t *ins = calloc(1, sizeof(*ins));
+    ir_instr_t *ins = ir_alloc_instr(b);
     if (!ins)
         return NULL;
     ins->dest = -1;
@@ -26,6 +128,8 @@ ir_instr_t *append_instr(ir_builder_t *b)
     else
         b->tail->next = ins;
     b->tail = ins;
+    if (b->defuse)
+        ir_defuse_note(b->defuse, ins);
     return ins;
 }
 
@@ -58,27 +162,22 @@ void remove_instr(ir_builder_t *b, ir_instr_t *ins)
         b->head = cur->next;
     if (b->tail == cur)
         b->tail = prev;
-    free(cur->name);
-    free(cur->data);
-    free(cur);
+    ir_release_instr(b, cur);
 }
 
 /* Lookup or create an alias set for the given variable name */
 int get_alias(ir_builder_t *b, const char *name)
 {
+    const char *key = intern_str(name);
     alias_ent_t *e = b->aliases;
-    while (e && strcmp(e->name, name) != 0)
+    while (e && e->name != key)
         e = e->next;
     if (e)
         return e->set;
     e = malloc(sizeof(*e));
     if (!e)
         return 0;
-    e->name = vc_strdup(name);
-    if (!e->name) {
-        free(e);
-        return 0;
-    }
+    e->name = key;
     e->set = b->next_alias_id++;
     e->next = b->aliases;
     b->aliases = e;
@@ -91,7 +190,7 @@ ir_instr_t *ir_insert_after(ir_builder_t *b, ir_instr_t *pos)
     if (!b)
         return NULL;
 
-    ir_instr_t *ins = calloc(1, sizeof(*ins));
+    ir_instr_t *ins = ir_alloc_instr(b);
     if (!ins)
         return NULL;
     ins->dest = -1;
@@ -115,7 +214,72 @@ ir_instr_t *ir_insert_after(ir_builder_t *b, ir_instr_t *pos)
         if (b->tail == pos)
             b->tail = ins;
     }
+    if (b->defuse)
+        ir_defuse_note(b->defuse, ins);
+
+    return ins;
+}
+
+ir_instr_t *ir_insert_phi(ir_builder_t *b, ir_instr_t *pos,
+                          type_kind_t type, size_t count)
+{
+    ir_phi_arg_t *args = NULL;
+    if (count) {
+        args = ir_arena_alloc(b, count * sizeof(*args));
+        if (!args)
+            return NULL;
+    }
+    ir_instr_t *ins = ir_insert_after(b, pos);
+    if (!ins)
+        return NULL;
+    ins->op = IR_PHI;
+    ins->dest = (int)b->next_value_id++;
+    ins->type = type;
+    ins->imm = 0;
+    ins->data = (char *)args;
+    return ins;
+}
 
+void ir_phi_add_arg(ir_instr_t *phi, int value, ir_instr_t *pred)
+{
+    ir_phi_arg_t *args = ir_phi_args(phi);
+    args[phi->imm].value = value;
+    args[phi->imm].pred = pred;
+    phi->imm++;
+}
+
+ir_phi_arg_t *ir_phi_args(const ir_instr_t *phi)
+{
+    return (ir_phi_arg_t *)(void *)phi->data;
+}
+
+ir_instr_t *ir_insert_copy(ir_builder_t *b, ir_instr_t *pos, int dest,
+                           int src, type_kind_t type)
+{
+    ir_instr_t *ins = ir_insert_after(b, pos);
+    if (!ins)
+        return NULL;
+    ins->op = IR_COPY;
+    ins->dest = dest;
+    ins->src1 = src;
+    ins->type = type;
     return ins;
 }
 
+int ir_has_value_operands(const ir_instr_t *ins)
+{
+    switch (ins->op) {
+    case IR_GLOB_STRING:
+    case IR_GLOB_WSTRING:
+    case IR_GLOB_VAR:
+    case IR_GLOB_ARRAY:
+    case IR_GLOB_UNION:
+    case IR_GLOB_STRUCT:
+    case IR_GLOB_ADDR:
+    case IR_FUNC_BEGIN:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
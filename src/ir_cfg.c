@@ -0,0 +1,557 @@
+/*
+ * Control flow graph construction.
+ *
+ * Blocks are rebuilt per function from the instruction list so passes
+ * that edit a single function only pay for that function.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "ir_cfg.h"
+
+/* Return non-zero when control never falls through OP */
+static int is_terminator(ir_op_t op)
+{
+    switch (op) {
+    case IR_BR:
+    case IR_BCOND:
+    case IR_RETURN:
+    case IR_RETURN_AGG:
+    case IR_CALL_NR:
+    case IR_CALL_PTR_NR:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Return non-zero when INS lies past the end of its function */
+static int is_func_end(const ir_instr_t *ins)
+{
+    return !ins || ins->op == IR_FUNC_END || ins->op == IR_FUNC_BEGIN;
+}
+
+static size_t label_slot(const char *label, size_t cap)
+{
+    uintptr_t h = (uintptr_t)label;
+    h ^= h >> 7;
+    h *= (uintptr_t)2654435761u;
+    return (size_t)(h ^ (h >> 13)) & (cap - 1);
+}
+
+/* Release the block storage of FN */
+static void function_clear(ir_function_t *fn)
+{
+    free(fn->blocks);
+    free(fn->edges);
+    free(fn->label_map);
+    free(fn->idom);
+    free(fn->rpo);
+    free(fn->dom_start);
+    free(fn->dom_child);
+    free(fn->loops);
+    free(fn->loop_blocks);
+    free(fn->loop_of);
+    fn->blocks = NULL;
+    fn->edges = NULL;
+    fn->label_map = NULL;
+    fn->idom = NULL;
+    fn->rpo = NULL;
+    fn->dom_start = NULL;
+    fn->dom_child = NULL;
+    fn->loops = NULL;
+    fn->loop_blocks = NULL;
+    fn->loop_of = NULL;
+    fn->loop_count = 0;
+    fn->block_count = 0;
+    fn->label_cap = 0;
+    fn->rpo_count = 0;
+}
+
+/* Index the labelled blocks of FN for ir_cfg_label_block() */
+static int build_label_map(ir_function_t *fn, size_t labels)
+{
+    if (!labels)
+        return 1;
+    size_t cap = 8;
+    while (cap < labels * 2)
+        cap *= 2;
+    fn->label_map = calloc(cap, sizeof(*fn->label_map));
+    if (!fn->label_map)
+        return 0;
+    fn->label_cap = cap;
+    for (size_t i = 0; i < fn->block_count; i++) {
+        const char *label = fn->blocks[i].label;
+        if (!label)
+            continue;
+        size_t s = label_slot(label, cap);
+        while (fn->label_map[s])
+            s = (s + 1) & (cap - 1);
+        fn->label_map[s] = i + 1;
+    }
+    return 1;
+}
+
+/* Fill in successor and predecessor edges of every block */
+static int build_edges(ir_function_t *fn)
+{
+    size_t total = 0;
+    for (size_t i = 0; i < fn->block_count; i++) {
+        ir_block_t *bb = &fn->blocks[i];
+        ir_instr_t *last = bb->last;
+        int falls = !is_terminator(last->op) || last->op == IR_BCOND;
+        if (last->op == IR_BR || last->op == IR_BCOND) {
+            ir_block_t *target = ir_cfg_label_block(fn, last->name);
+            if (target)
+                bb->succs[bb->succ_count++] = target->id;
+        }
+        if (falls && i + 1 < fn->block_count &&
+            !(bb->succ_count && bb->succs[0] == i + 1))
+            bb->succs[bb->succ_count++] = i + 1;
+        for (size_t s = 0; s < bb->succ_count; s++)
+            fn->blocks[bb->succs[s]].pred_count++;
+        total += bb->succ_count;
+    }
+
+    if (total) {
+        fn->edges = malloc(total * sizeof(*fn->edges));
+        if (!fn->edges)
+            return 0;
+    }
+    size_t off = 0;
+    for (size_t i = 0; i < fn->block_count; i++) {
+        fn->blocks[i].preds = fn->edges + off;
+        off += fn->blocks[i].pred_count;
+        fn->blocks[i].pred_count = 0;
+    }
+    for (size_t i = 0; i < fn->block_count; i++) {
+        ir_block_t *bb = &fn->blocks[i];
+        for (size_t s = 0; s < bb->succ_count; s++) {
+            ir_block_t *succ = &fn->blocks[bb->succs[s]];
+            succ->preds[succ->pred_count++] = i;
+        }
+    }
+    return 1;
+}
+
+int ir_cfg_rebuild_function(ir_function_t *fn)
+{
+    function_clear(fn);
+    fn->dirty = 0;
+
+    /* count blocks first so the array is allocated once */
+    size_t count = 0;
+    size_t labels = 0;
+    int open = 0;
+    ir_instr_t *ins = fn->begin->next;
+    for (; !is_func_end(ins); ins = ins->next) {
+        if (ins->op == IR_LABEL) {
+            labels++;
+            open = 0;
+        }
+        if (!open) {
+            count++;
+            open = 1;
+        }
+        if (is_terminator(ins->op))
+            open = 0;
+    }
+    fn->end = ins && ins->op == IR_FUNC_END ? ins : NULL;
+    if (!count)
+        return 1;
+
+    fn->blocks = calloc(count, sizeof(*fn->blocks));
+    if (!fn->blocks)
+        return 0;
+
+    ir_block_t *cur = NULL;
+    ir_instr_t *prev = fn->begin;
+    for (ins = fn->begin->next; !is_func_end(ins); prev = ins, ins = ins->next) {
+        if (cur && (ins->op == IR_LABEL || is_terminator(cur->last->op)))
+            cur = NULL;
+        if (!cur) {
+            cur = &fn->blocks[fn->block_count];
+            cur->id = fn->block_count++;
+            cur->first = ins;
+            cur->prev = prev;
+            cur->label = ins->op == IR_LABEL ? ins->name : NULL;
+        }
+        cur->last = ins;
+    }
+
+    if (!build_label_map(fn, labels) || !build_edges(fn)) {
+        function_clear(fn);
+        return 0;
+    }
+    return 1;
+}
+
+/* Store the blocks reachable from the entry of FN in reverse postorder */
+static int compute_rpo(ir_function_t *fn)
+{
+    size_t n = fn->block_count;
+    fn->rpo = malloc(n * sizeof(*fn->rpo));
+    size_t *stack = malloc(n * sizeof(*stack));
+    /* 0 unvisited, k + 1 while on the stack with k successors visited */
+    size_t *state = calloc(n, sizeof(*state));
+    if (!fn->rpo || !stack || !state) {
+        free(stack);
+        free(state);
+        return 0;
+    }
+
+    size_t top = 0;
+    size_t count = 0;
+    size_t *order = fn->rpo;
+    stack[top++] = 0;
+    state[0] = 1;
+    while (top) {
+        ir_block_t *bb = &fn->blocks[stack[top - 1]];
+        size_t k = state[bb->id] - 1;
+        if (k < bb->succ_count) {
+            state[bb->id]++;
+            size_t s = bb->succs[k];
+            if (!state[s]) {
+                state[s] = 1;
+                stack[top++] = s;
+            }
+            continue;
+        }
+        order[count++] = bb->id;
+        top--;
+    }
+    /* reverse the postorder in place */
+    for (size_t i = 0; i < count / 2; i++) {
+        size_t t = order[i];
+        order[i] = order[count - 1 - i];
+        order[count - 1 - i] = t;
+    }
+    fn->rpo_count = count;
+    free(stack);
+    free(state);
+    return 1;
+}
+
+/* Store the children of every block in the dominator tree of FN */
+static int build_dom_tree(ir_function_t *fn)
+{
+    size_t n = fn->block_count;
+    fn->dom_start = calloc(n + 1, sizeof(*fn->dom_start));
+    fn->dom_child = malloc(n * sizeof(*fn->dom_child));
+    if (!fn->dom_start || !fn->dom_child)
+        return 0;
+    for (size_t b = 1; b < n; b++)
+        if (fn->idom[b] != IR_CFG_NO_BLOCK)
+            fn->dom_start[fn->idom[b] + 1]++;
+    for (size_t b = 0; b < n; b++)
+        fn->dom_start[b + 1] += fn->dom_start[b];
+    /* filling advances each start to the next block's, shift them back */
+    for (size_t b = 1; b < n; b++) {
+        size_t d = fn->idom[b];
+        if (d != IR_CFG_NO_BLOCK)
+            fn->dom_child[fn->dom_start[d]++] = b;
+    }
+    for (size_t b = n; b > 0; b--)
+        fn->dom_start[b] = fn->dom_start[b - 1];
+    fn->dom_start[0] = 0;
+    return 1;
+}
+
+int ir_cfg_dominators(ir_function_t *fn)
+{
+    free(fn->idom);
+    free(fn->rpo);
+    free(fn->dom_start);
+    free(fn->dom_child);
+    fn->idom = NULL;
+    fn->rpo = NULL;
+    fn->dom_start = NULL;
+    fn->dom_child = NULL;
+    fn->rpo_count = 0;
+    size_t n = fn->block_count;
+    if (!n)
+        return 1;
+    if (!compute_rpo(fn))
+        return 0;
+
+    /* Cooper, Harvey and Kennedy: iterate to a fixed point in RPO */
+    size_t *index = malloc(n * sizeof(*index));
+    fn->idom = malloc(n * sizeof(*fn->idom));
+    if (!index || !fn->idom) {
+        free(index);
+        return 0;
+    }
+    for (size_t i = 0; i < n; i++) {
+        index[i] = IR_CFG_NO_BLOCK;
+        fn->idom[i] = IR_CFG_NO_BLOCK;
+    }
+    for (size_t i = 0; i < fn->rpo_count; i++)
+        index[fn->rpo[i]] = i;
+    fn->idom[0] = 0;
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (size_t i = 1; i < fn->rpo_count; i++) {
+            ir_block_t *bb = &fn->blocks[fn->rpo[i]];
+            size_t dom = IR_CFG_NO_BLOCK;
+            for (size_t p = 0; p < bb->pred_count; p++) {
+                size_t a = bb->preds[p];
+                if (fn->idom[a] == IR_CFG_NO_BLOCK)
+                    continue;
+                if (dom == IR_CFG_NO_BLOCK) {
+                    dom = a;
+                    continue;
+                }
+                size_t b = dom;
+                while (a != b) {
+                    while (index[a] > index[b])
+                        a = fn->idom[a];
+                    while (index[b] > index[a])
+                        b = fn->idom[b];
+                }
+                dom = a;
+            }
+            if (fn->idom[bb->id] != dom) {
+                fn->idom[bb->id] = dom;
+                changed = 1;
+            }
+        }
+    }
+    fn->idom[0] = IR_CFG_NO_BLOCK;
+    free(index);
+    return build_dom_tree(fn);
+}
+
+int ir_cfg_dominates(const ir_function_t *fn, size_t a, size_t b)
+{
+    if (!fn->idom)
+        return 0;
+    if (b != 0 && fn->idom[b] == IR_CFG_NO_BLOCK)
+        return 0; /* unreachable */
+    while (b != a) {
+        if (b == 0)
+            return 0;
+        b = fn->idom[b];
+    }
+    return 1;
+}
+
+static int is_reachable(const ir_function_t *fn, size_t b)
+{
+    return b == 0 || fn->idom[b] != IR_CFG_NO_BLOCK;
+}
+
+/* Smaller loops first; nested loops are strictly smaller than their parent */
+static int cmp_loop_size(const void *a, const void *b)
+{
+    const ir_loop_t *x = a, *y = b;
+    if (x->block_count != y->block_count)
+        return x->block_count < y->block_count ? -1 : 1;
+    return x->header < y->header ? -1 : x->header > y->header;
+}
+
+/*
+ * Collect the members of the loop headed by H into STORE at offset
+ * *LEN, growing it as needed.  MARK holds H + 1 for members.  Returns
+ * the number of members or 0 on allocation failure.
+ */
+static size_t collect_loop(ir_function_t *fn, size_t h, size_t *mark,
+                           size_t *work, size_t **store, size_t *len,
+                           size_t *cap, size_t *latches)
+{
+    ir_block_t *hb = &fn->blocks[h];
+    size_t top = 0;
+    mark[h] = h + 1;
+    *latches = 0;
+    for (size_t p = 0; p < hb->pred_count; p++) {
+        size_t t = hb->preds[p];
+        if (!is_reachable(fn, t) || !ir_cfg_dominates(fn, h, t))
+            continue;
+        (*latches)++;
+        if (mark[t] != h + 1) {
+            mark[t] = h + 1;
+            work[top++] = t;
+        }
+    }
+    while (top) {
+        ir_block_t *bb = &fn->blocks[work[--top]];
+        for (size_t p = 0; p < bb->pred_count; p++) {
+            size_t q = bb->preds[p];
+            if (mark[q] != h + 1 && is_reachable(fn, q)) {
+                mark[q] = h + 1;
+                work[top++] = q;
+            }
+        }
+    }
+
+    /* members follow the header in reverse postorder */
+    size_t count = 0;
+    for (size_t i = 0; i < fn->rpo_count; i++) {
+        size_t b = fn->rpo[i];
+        if (mark[b] != h + 1)
+            continue;
+        if (*len == *cap) {
+            size_t ncap = *cap ? *cap * 2 : 64;
+            size_t *n = realloc(*store, ncap * sizeof(*n));
+            if (!n)
+                return 0;
+            *store = n;
+            *cap = ncap;
+        }
+        (*store)[(*len)++] = b;
+        count++;
+    }
+    return count;
+}
+
+int ir_cfg_loops(ir_function_t *fn)
+{
+    free(fn->loops);
+    free(fn->loop_blocks);
+    free(fn->loop_of);
+    fn->loops = NULL;
+    fn->loop_blocks = NULL;
+    fn->loop_of = NULL;
+    fn->loop_count = 0;
+    size_t n = fn->block_count;
+    if (!n)
+        return 1;
+    if (!fn->idom && !ir_cfg_dominators(fn))
+        return 0;
+
+    size_t *mark = calloc(n, sizeof(*mark));
+    size_t *work = malloc(n * sizeof(*work));
+    size_t *start = malloc(n * sizeof(*start));
+    fn->loop_of = malloc(n * sizeof(*fn->loop_of));
+    fn->loops = malloc(n * sizeof(*fn->loops));
+    size_t len = 0, cap = 0;
+    int ok = mark && work && start && fn->loop_of && fn->loops;
+    for (size_t i = 0; ok && i < fn->rpo_count; i++) {
+        size_t h = fn->rpo[i];
+        ir_block_t *hb = &fn->blocks[h];
+        int header = 0;
+        for (size_t p = 0; p < hb->pred_count && !header; p++)
+            header = is_reachable(fn, hb->preds[p]) &&
+                     ir_cfg_dominates(fn, h, hb->preds[p]);
+        if (!header)
+            continue;
+        /* members are located by offset until the storage stops moving */
+        start[fn->loop_count] = len;
+        ir_loop_t *l = &fn->loops[fn->loop_count++];
+        l->header = h;
+        l->block_count = collect_loop(fn, h, mark, work, &fn->loop_blocks,
+                                      &len, &cap, &l->latch_count);
+        ok = l->block_count != 0;
+    }
+    free(mark);
+    free(work);
+    if (!ok) {
+        free(start);
+        free(fn->loops);
+        free(fn->loop_blocks);
+        free(fn->loop_of);
+        fn->loops = NULL;
+        fn->loop_blocks = NULL;
+        fn->loop_of = NULL;
+        fn->loop_count = 0;
+        return 0;
+    }
+
+    for (size_t i = 0; i < fn->loop_count; i++)
+        fn->loops[i].blocks = fn->loop_blocks + start[i];
+    free(start);
+    qsort(fn->loops, fn->loop_count, sizeof(*fn->loops), cmp_loop_size);
+    for (size_t b = 0; b < n; b++)
+        fn->loop_of[b] = IR_CFG_NO_BLOCK;
+    /* outer loops are assigned first and overwritten by the inner ones */
+    for (size_t i = fn->loop_count; i > 0; i--) {
+        ir_loop_t *l = &fn->loops[i - 1];
+        l->parent = fn->loop_of[l->header];
+        l->depth = l->parent == IR_CFG_NO_BLOCK ? 1
+                                                : fn->loops[l->parent].depth + 1;
+        for (size_t k = 0; k < l->block_count; k++)
+            fn->loop_of[l->blocks[k]] = i - 1;
+    }
+    return 1;
+}
+
+int ir_cfg_loop_contains(const ir_function_t *fn, size_t l, size_t b)
+{
+    if (!fn->loop_of || b >= fn->block_count)
+        return 0;
+    for (size_t k = fn->loop_of[b]; k != IR_CFG_NO_BLOCK; k = fn->loops[k].parent)
+        if (k == l)
+            return 1;
+    return 0;
+}
+
+int ir_cfg_build(ir_builder_t *ir, ir_cfg_t *cfg)
+{
+    cfg->funcs = NULL;
+    cfg->func_count = 0;
+
+    size_t count = 0;
+    for (ir_instr_t *ins = ir->head; ins; ins = ins->next)
+        if (ins->op == IR_FUNC_BEGIN)
+            count++;
+    if (!count)
+        return 1;
+
+    cfg->funcs = calloc(count, sizeof(*cfg->funcs));
+    if (!cfg->funcs)
+        return 0;
+    for (ir_instr_t *ins = ir->head; ins; ins = ins->next) {
+        if (ins->op != IR_FUNC_BEGIN)
+            continue;
+        ir_function_t *fn = &cfg->funcs[cfg->func_count++];
+        fn->name = ins->name;
+        fn->begin = ins;
+        if (!ir_cfg_rebuild_function(fn)) {
+            ir_cfg_free(cfg);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int ir_cfg_refresh(ir_cfg_t *cfg)
+{
+    for (size_t i = 0; i < cfg->func_count; i++)
+        if (cfg->funcs[i].dirty && !ir_cfg_rebuild_function(&cfg->funcs[i]))
+            return 0;
+    return 1;
+}
+
+void ir_cfg_invalidate(ir_cfg_t *cfg)
+{
+    for (size_t i = 0; i < cfg->func_count; i++)
+        cfg->funcs[i].dirty = 1;
+}
+
+ir_block_t *ir_cfg_label_block(const ir_function_t *fn, const char *label)
+{
+    if (!label || !fn->label_cap)
+        return NULL;
+    size_t s = label_slot(label, fn->label_cap);
+    while (fn->label_map[s]) {
+        ir_block_t *bb = &fn->blocks[fn->label_map[s] - 1];
+        if (bb->label == label)
+            return bb;
+        s = (s + 1) & (fn->label_cap - 1);
+    }
+    return NULL;
+}
+
+void ir_cfg_free(ir_cfg_t *cfg)
+{
+    for (size_t i = 0; i < cfg->func_count; i++)
+        function_clear(&cfg->funcs[i]);
+    free(cfg->funcs);
+    cfg->funcs = NULL;
+    cfg->func_count = 0;
+}
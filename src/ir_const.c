@@ -6,6 +6,7 @@
 #include "ir_builder.h"
 #include "label.h"
 #include "util.h"
+#include "intern.h"
 #include "error.h"
 
 ir_value_t ir_build_const(ir_builder_t *b, long long value)
@@ -26,7 +27,7 @@ ir_value_t ir_build_cplx_const(ir_builder_t *b, double real, double imag)
         return (ir_value_t){0};
     ins->op = IR_CPLX_CONST;
     ins->dest = alloc_value_id(b);
-    double *vals = malloc(2 * sizeof(double));
+    double *vals = ir_arena_alloc(b, 2 * sizeof(double));
     if (!vals) {
         remove_instr(b, ins);
         return (ir_value_t){0};
@@ -50,13 +51,9 @@ ir_value_t ir_build_string(ir_builder_t *b, const char *str, size_t len)
         remove_instr(b, ins);
         return (ir_value_t){0};
     }
-    ins->name = vc_strdup(fmt);
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return (ir_value_t){0};
-    }
+    ins->name = intern_str(fmt);
     size_t sz = len + 1;
-    ins->data = malloc(sz);
+    ins->data = ir_arena_alloc(b, sz);
     if (!ins->data) {
         remove_instr(b, ins);
         return (ir_value_t){0};
@@ -82,7 +79,7 @@ ir_value_t ir_build_wstring(ir_builder_t *b, const char *str)
         remove_instr(b, ins);
         return (ir_value_t){0};
     }
-    long long *vals = malloc((len + 1) * sizeof(long long));
+    long long *vals = ir_arena_alloc(b, (len + 1) * sizeof(long long));
     if (!vals) {
         remove_instr(b, ins);
         return (ir_value_t){0};
@@ -93,16 +90,10 @@ ir_value_t ir_build_wstring(ir_builder_t *b, const char *str)
     char label[32];
     const char *fmt = label_format("LWstr", ins->dest, label);
     if (!fmt) {
-        free(vals);
-        remove_instr(b, ins);
-        return (ir_value_t){0};
-    }
-    ins->name = vc_strdup(fmt);
-    if (!ins->name) {
-        free(vals);
         remove_instr(b, ins);
         return (ir_value_t){0};
     }
+    ins->name = intern_str(fmt);
     ins->imm = (long long)(len + 1);
     ins->data = (char *)vals;
     return (ir_value_t){ins->dest};
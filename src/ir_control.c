@@ -3,6 +3,7 @@
 #include "ir_control.h"
 #include "ir_builder.h"
 #include "util.h"
+#include "intern.h"
 
 void ir_build_arg(ir_builder_t *b, ir_value_t val, type_kind_t type)
 {
@@ -41,11 +42,7 @@ ir_value_t ir_build_call(ir_builder_t *b, const char *name, size_t arg_count)
         return (ir_value_t){0};
     ins->op = IR_CALL;
     ins->dest = alloc_value_id(b);
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return (ir_value_t){0};
-    }
+    ins->name = intern_str(name ? name : "");
     ins->imm = (long long)arg_count;
     return (ir_value_t){ins->dest};
 }
@@ -56,11 +53,7 @@ ir_value_t ir_build_call_nr(ir_builder_t *b, const char *name, size_t arg_count)
     if (!ins)
         return (ir_value_t){0};
     ins->op = IR_CALL_NR;
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return (ir_value_t){0};
-    }
+    ins->name = intern_str(name ? name : "");
     ins->imm = (long long)arg_count;
     return (ir_value_t){0};
 }
@@ -94,11 +87,7 @@ ir_instr_t *ir_build_func_begin(ir_builder_t *b, const char *name)
     if (!ins)
         return NULL;
     ins->op = IR_FUNC_BEGIN;
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return NULL;
-    }
+    ins->name = intern_str(name ? name : "");
     ins->imm = 0;
     return ins;
 }
@@ -117,11 +106,7 @@ void ir_build_br(ir_builder_t *b, const char *label)
     if (!ins)
         return;
     ins->op = IR_BR;
-    ins->name = vc_strdup(label ? label : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return;
-    }
+    ins->name = intern_str(label ? label : "");
 }
 
 void ir_build_bcond(ir_builder_t *b, ir_value_t cond, const char *label)
@@ -131,11 +116,7 @@ void ir_build_bcond(ir_builder_t *b, ir_value_t cond, const char *label)
         return;
     ins->op = IR_BCOND;
     ins->src1 = cond.id;
-    ins->name = vc_strdup(label ? label : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return;
-    }
+    ins->name = intern_str(label ? label : "");
 }
 
 void ir_build_label(ir_builder_t *b, const char *label)
@@ -144,9 +125,5 @@ void ir_build_label(ir_builder_t *b, const char *label)
     if (!ins)
         return;
     ins->op = IR_LABEL;
-    ins->name = vc_strdup(label ? label : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return;
-    }
+    ins->name = intern_str(label ? label : "");
 }
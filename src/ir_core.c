@@ -18,9 +18,11 @@
 #include <stdint.h>
 #include "ir_core.h"
 #include "ir_builder.h"
+#include "ir_defuse.h"
 #include "label.h"
 #include "strbuf.h"
 #include "util.h"
+#include "intern.h"
 #include "ast.h"
 #include "error.h"
 
@@ -37,6 +39,10 @@ void ir_builder_init(ir_builder_t *b)
     b->cur_column = 0;
     b->aliases = NULL;
     b->next_alias_id = 1;
+    b->arena.chunks = NULL;
+    b->arena.next_size = 0;
+    b->arena.free_instrs = NULL;
+    b->defuse = NULL;
 }
 
 void ir_builder_set_loc(ir_builder_t *b, const char *file, size_t line, size_t column)
@@ -49,23 +55,18 @@ void ir_builder_set_loc(ir_builder_t *b, const char *file, size_t line, size_t c
 /* Free all instructions owned by the builder. */
 void ir_builder_free(ir_builder_t *b)
 {
-    ir_instr_t *ins = b->head;
-    while (ins) {
-        ir_instr_t *next = ins->next;
-        free(ins->name);
-        free(ins->data);
-        free(ins);
-        ins = next;
-    }
+    ir_arena_release(&b->arena);
     b->head = b->tail = NULL;
     b->next_value_id = 0;
     while (b->aliases) {
         alias_ent_t *n = b->aliases->next;
-        free((char *)b->aliases->name);
         free(b->aliases);
         b->aliases = n;
     }
     b->next_alias_id = 0;
+    if (b->defuse)
+        b->defuse->ir = NULL;
+    b->defuse = NULL;
 }
 /*
  * Emit a binary arithmetic or comparison instruction. Operands are in
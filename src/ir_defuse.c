@@ -0,0 +1,248 @@
+/*
+ * Def-use index over IR values.
+ *
+ * Use entries live in one array and are chained per value, so adding,
+ * moving and dropping a use only touches the lists of the values
+ * involved.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ir_defuse.h"
+
+/* Make the per value arrays cover ids below NEED */
+static int ensure_values(ir_defuse_t *du, size_t need)
+{
+    if (need <= du->value_cap)
+        return 1;
+    size_t cap = du->value_cap ? du->value_cap : 64;
+    while (cap < need)
+        cap *= 2;
+    ir_instr_t **def = realloc(du->def, cap * sizeof(*def));
+    if (!def)
+        return 0;
+    du->def = def;
+    int *head = realloc(du->head, cap * sizeof(*head));
+    if (!head)
+        return 0;
+    du->head = head;
+    size_t *count = realloc(du->count, cap * sizeof(*count));
+    if (!count)
+        return 0;
+    du->count = count;
+    for (size_t v = du->value_cap; v < cap; v++) {
+        def[v] = NULL;
+        head[v] = -1;
+        count[v] = 0;
+    }
+    du->value_cap = cap;
+    return 1;
+}
+
+static int add_use(ir_defuse_t *du, int value, ir_instr_t *ins)
+{
+    if (value <= 0)
+        return 1;
+    if (!ensure_values(du, (size_t)value + 1))
+        return 0;
+    int u = du->free_use;
+    if (u >= 0) {
+        du->free_use = du->uses[u].next;
+    } else {
+        if (du->use_len == du->use_cap) {
+            size_t cap = du->use_cap ? du->use_cap * 2 : 256;
+            ir_use_t *uses = realloc(du->uses, cap * sizeof(*uses));
+            if (!uses)
+                return 0;
+            du->uses = uses;
+            du->use_cap = cap;
+        }
+        u = (int)du->use_len++;
+    }
+    du->uses[u].ins = ins;
+    du->uses[u].next = du->head[value];
+    du->head[value] = u;
+    du->count[value]++;
+    return 1;
+}
+
+/* Unlink one use of VALUE by INS */
+static void drop_use(ir_defuse_t *du, int value, ir_instr_t *ins)
+{
+    if (value <= 0 || (size_t)value >= du->value_cap)
+        return;
+    int *link = &du->head[value];
+    while (*link >= 0 && du->uses[*link].ins != ins)
+        link = &du->uses[*link].next;
+    if (*link < 0)
+        return;
+    int u = *link;
+    *link = du->uses[u].next;
+    du->uses[u].next = du->free_use;
+    du->free_use = u;
+    du->count[value]--;
+}
+
+/* Record the definition and operands of INS */
+static int index_instr(ir_defuse_t *du, ir_instr_t *ins)
+{
+    if (ins->dest > 0) {
+        if (!ensure_values(du, (size_t)ins->dest + 1))
+            return 0;
+        if (!du->def[ins->dest])
+            du->def[ins->dest] = ins;
+    }
+    if (!ir_has_value_operands(ins))
+        return 1;
+    if (ins->op == IR_PHI) {
+        ir_phi_arg_t *args = ir_phi_args(ins);
+        for (long long a = 0; a < ins->imm; a++)
+            if (!add_use(du, args[a].value, ins))
+                return 0;
+    }
+    return add_use(du, ins->src1, ins) && add_use(du, ins->src2, ins);
+}
+
+static void flush_pending(ir_defuse_t *du)
+{
+    ir_instr_t *ins = du->pending;
+    du->pending = NULL;
+    if (ins && !index_instr(du, ins))
+        du->valid = 0;
+}
+
+int ir_defuse_init(ir_defuse_t *du, ir_builder_t *ir)
+{
+    memset(du, 0, sizeof(*du));
+    du->free_use = -1;
+    du->valid = 1;
+    if (!ensure_values(du, ir->next_value_id)) {
+        ir_defuse_free(du);
+        return 0;
+    }
+    for (ir_instr_t *ins = ir->head; ins; ins = ins->next) {
+        if (!index_instr(du, ins)) {
+            ir_defuse_free(du);
+            return 0;
+        }
+    }
+    du->ir = ir;
+    ir->defuse = du;
+    return 1;
+}
+
+void ir_defuse_free(ir_defuse_t *du)
+{
+    if (du->ir && du->ir->defuse == du)
+        du->ir->defuse = NULL;
+    free(du->def);
+    free(du->head);
+    free(du->count);
+    free(du->uses);
+    memset(du, 0, sizeof(*du));
+    du->free_use = -1;
+}
+
+ir_instr_t *ir_defuse_def(ir_defuse_t *du, int value)
+{
+    flush_pending(du);
+    if (value <= 0 || (size_t)value >= du->value_cap)
+        return NULL;
+    return du->def[value];
+}
+
+int ir_defuse_first_use(ir_defuse_t *du, int value)
+{
+    flush_pending(du);
+    if (value <= 0 || (size_t)value >= du->value_cap)
+        return -1;
+    return du->head[value];
+}
+
+size_t ir_defuse_use_count(ir_defuse_t *du, int value)
+{
+    flush_pending(du);
+    if (value <= 0 || (size_t)value >= du->value_cap)
+        return 0;
+    return du->count[value];
+}
+
+int ir_defuse_set_src(ir_defuse_t *du, ir_instr_t *ins, int which, int value)
+{
+    flush_pending(du);
+    int *slot = which == 1 ? &ins->src1 : &ins->src2;
+    if (*slot == value)
+        return 1;
+    if (!add_use(du, value, ins))
+        return 0;
+    drop_use(du, *slot, ins);
+    *slot = value;
+    return 1;
+}
+
+int ir_replace_all_uses(ir_defuse_t *du, int old, int new_value)
+{
+    flush_pending(du);
+    if (old <= 0 || old == new_value || (size_t)old >= du->value_cap ||
+        du->head[old] < 0)
+        return 1;
+    if (new_value > 0 && !ensure_values(du, (size_t)new_value + 1))
+        return 0;
+
+    int last = -1;
+    for (int u = du->head[old]; u >= 0; u = du->uses[u].next) {
+        ir_instr_t *ins = du->uses[u].ins;
+        if (ins->src1 == old)
+            ins->src1 = new_value;
+        if (ins->src2 == old)
+            ins->src2 = new_value;
+        if (ins->op == IR_PHI) {
+            ir_phi_arg_t *args = ir_phi_args(ins);
+            for (long long a = 0; a < ins->imm; a++)
+                if (args[a].value == old)
+                    args[a].value = new_value;
+        }
+        last = u;
+    }
+
+    if (new_value > 0) {
+        du->uses[last].next = du->head[new_value];
+        du->head[new_value] = du->head[old];
+        du->count[new_value] += du->count[old];
+    } else {
+        du->uses[last].next = du->free_use;
+        du->free_use = du->head[old];
+    }
+    du->head[old] = -1;
+    du->count[old] = 0;
+    return 1;
+}
+
+void ir_defuse_note(ir_defuse_t *du, ir_instr_t *ins)
+{
+    flush_pending(du);
+    du->pending = ins;
+}
+
+void ir_defuse_forget(ir_defuse_t *du, ir_instr_t *ins)
+{
+    if (du->pending == ins) {
+        du->pending = NULL;
+        return;
+    }
+    if (ins->dest > 0 && (size_t)ins->dest < du->value_cap &&
+        du->def[ins->dest] == ins)
+        du->def[ins->dest] = NULL;
+    if (!ir_has_value_operands(ins))
+        return;
+    if (ins->op == IR_PHI) {
+        ir_phi_arg_t *args = ir_phi_args(ins);
+        for (long long a = 0; a < ins->imm; a++)
+            drop_use(du, args[a].value, ins);
+    }
+    drop_use(du, ins->src1, ins);
+    drop_use(du, ins->src2, ins);
+}
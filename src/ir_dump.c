@@ -87,6 +87,8 @@ static const char *op_name(ir_op_t op)
     case IR_BR: return "IR_BR";
     case IR_BCOND: return "IR_BCOND";
     case IR_LABEL: return "IR_LABEL";
+    case IR_PHI: return "IR_PHI";
+    case IR_COPY: return "IR_COPY";
     }
     return "";
 }
@@ -119,18 +121,28 @@ char *ir_to_string(ir_builder_t *ir)
             continue;
         }
 
+        /* flags and linkage fields carry no spill slot */
+        int vals = ir_has_value_operands(ins);
         strbuf_appendf(&sb, "%s dest=%d", op_name(ins->op), ins->dest);
         if (ins->dest > 0 && ra.loc[ins->dest] < 0)
             strbuf_appendf(&sb, "[slot%d]", -ra.loc[ins->dest]);
         strbuf_appendf(&sb, " src1=%d", ins->src1);
-        if (ins->src1 > 0 && ra.loc[ins->src1] < 0)
+        if (vals && ins->src1 > 0 && ra.loc[ins->src1] < 0)
             strbuf_appendf(&sb, "[slot%d]", -ra.loc[ins->src1]);
         strbuf_appendf(&sb, " src2=%d", ins->src2);
-        if (ins->src2 > 0 && ra.loc[ins->src2] < 0)
+        if (vals && ins->src2 > 0 && ra.loc[ins->src2] < 0)
             strbuf_appendf(&sb, "[slot%d]", -ra.loc[ins->src2]);
-        strbuf_appendf(&sb, " imm=%lld name=%s data=%s", ins->imm,
-                       ins->name ? ins->name : "",
-                       ins->data ? ins->data : "");
+        if (ins->op == IR_PHI) {
+            /* the payload holds the incoming values, not a string */
+            strbuf_appendf(&sb, " imm=%lld args=", ins->imm);
+            ir_phi_arg_t *args = ir_phi_args(ins);
+            for (long long i = 0; i < ins->imm; i++)
+                strbuf_appendf(&sb, "%s%d", i ? "," : "", args[i].value);
+        } else {
+            strbuf_appendf(&sb, " imm=%lld name=%s data=%s", ins->imm,
+                           ins->name ? ins->name : "",
+                           ins->data ? ins->data : "");
+        }
         if (ins->alias_set)
             strbuf_appendf(&sb, " alias=%d", ins->alias_set);
         if (ins->is_restrict)
@@ -11,12 +11,14 @@
 
 #include <stdlib.h>
 #include "ir_global.h"
+#include "ir_builder.h"
 #include "util.h"
+#include "intern.h"
 
 /* Helper to append a blank instruction */
-static ir_instr_t *append_instr(ir_builder_t *b)
+static ir_instr_t *append_glob_instr(ir_builder_t *b)
 {
-    ir_instr_t *ins = calloc(1, sizeof(*ins));
+    ir_instr_t *ins = ir_alloc_instr(b);
     if (!ins)
         return NULL;
     ins->dest = -1;
@@ -38,11 +40,11 @@ static ir_instr_t *append_instr(ir_builder_t *b)
 void ir_build_glob_var(ir_builder_t *b, const char *name, long long value,
                        int is_static, size_t alignment)
 {
-    ir_instr_t *ins = append_instr(b);
+    ir_instr_t *ins = append_glob_instr(b);
     if (!ins)
         return;
     ins->op = IR_GLOB_VAR;
-    ins->name = vc_strdup(name ? name : "");
+    ins->name = intern_str(name ? name : "");
     ins->imm = value;
     ins->src1 = is_static;
     ins->src2 = (int)alignment;
@@ -56,29 +58,19 @@ int ir_build_glob_array(ir_builder_t *b, const char *name,
                         const long long *values, size_t count,
                         int is_static, size_t alignment)
 {
-    ir_instr_t *ins = append_instr(b);
+    ir_instr_t *ins = append_glob_instr(b);
     if (!ins)
         return 0;
     ins->op = IR_GLOB_ARRAY;
-    ins->name = vc_strdup(name ? name : "");
+    ins->name = intern_str(name ? name : "");
     ins->imm = (long long)count;
     ins->src1 = is_static;
     ins->src2 = (int)alignment;
     if (count) {
-        long long *vals = malloc(count * sizeof(long long));
+        long long *vals = ir_arena_alloc(b, count * sizeof(long long));
         if (!vals) {
             /* allocation failed: remove appended instruction */
-            ir_instr_t *prev = NULL;
-            for (ir_instr_t *cur = b->head; cur && cur != ins; cur = cur->next)
-                prev = cur;
-            if (prev)
-                prev->next = ins->next;
-            else
-                b->head = ins->next;
-            if (b->tail == ins)
-                b->tail = prev;
-            free(ins->name);
-            free(ins);
+            remove_instr(b, ins);
             return 0;
         }
         for (size_t i = 0; i < count; i++)
@@ -92,11 +84,11 @@ int ir_build_glob_array(ir_builder_t *b, const char *name,
 void ir_build_glob_union(ir_builder_t *b, const char *name, int size,
                          int is_static, size_t alignment)
 {
-    ir_instr_t *ins = append_instr(b);
+    ir_instr_t *ins = append_glob_instr(b);
     if (!ins)
         return;
     ins->op = IR_GLOB_UNION;
-    ins->name = vc_strdup(name ? name : "");
+    ins->name = intern_str(name ? name : "");
     ins->imm = size;
     ins->src1 = is_static;
     ins->src2 = (int)alignment;
@@ -106,11 +98,11 @@ void ir_build_glob_union(ir_builder_t *b, const char *name, int size,
 void ir_build_glob_struct(ir_builder_t *b, const char *name, int size,
                           int is_static, size_t alignment)
 {
-    ir_instr_t *ins = append_instr(b);
+    ir_instr_t *ins = append_glob_instr(b);
     if (!ins)
         return;
     ins->op = IR_GLOB_STRUCT;
-    ins->name = vc_strdup(name ? name : "");
+    ins->name = intern_str(name ? name : "");
     ins->imm = size;
     ins->src1 = is_static;
     ins->src2 = (int)alignment;
@@ -120,12 +112,12 @@ void ir_build_glob_struct(ir_builder_t *b, const char *name, int size,
 void ir_build_glob_addr(ir_builder_t *b, const char *name,
                         const char *target, int is_static)
 {
-    ir_instr_t *ins = append_instr(b);
+    ir_instr_t *ins = append_glob_instr(b);
     if (!ins)
         return;
     ins->op = IR_GLOB_ADDR;
-    ins->name = vc_strdup(name ? name : "");
-    ins->data = vc_strdup(target ? target : "");
+    ins->name = intern_str(name ? name : "");
+    ins->data = ir_arena_strdup(b, target ? target : "");
     ins->src1 = is_static;
 }
 
@@ -3,6 +3,7 @@
 #include "ir_memory.h"
 #include "ir_builder.h"
 #include "util.h"
+#include "intern.h"
 #include "error.h"
 
 ir_value_t ir_build_load(ir_builder_t *b, const char *name, type_kind_t type)
@@ -12,11 +13,7 @@ ir_value_t ir_build_load(ir_builder_t *b, const char *name, type_kind_t type)
         return (ir_value_t){0};
     ins->op = IR_LOAD;
     ins->dest = alloc_value_id(b);
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return (ir_value_t){0};
-    }
+    ins->name = intern_str(name ? name : "");
     if (name)
         ins->alias_set = get_alias(b, name);
     ins->type = type;
@@ -30,11 +27,7 @@ ir_value_t ir_build_load_vol(ir_builder_t *b, const char *name, type_kind_t type
         return (ir_value_t){0};
     ins->op = IR_LOAD;
     ins->dest = alloc_value_id(b);
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return (ir_value_t){0};
-    }
+    ins->name = intern_str(name ? name : "");
     ins->is_volatile = 1;
     if (name)
         ins->alias_set = get_alias(b, name);
@@ -50,11 +43,7 @@ void ir_build_store(ir_builder_t *b, const char *name, type_kind_t type,
         return;
     ins->op = IR_STORE;
     ins->src1 = val.id;
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return;
-    }
+    ins->name = intern_str(name ? name : "");
     if (name)
         ins->alias_set = get_alias(b, name);
     ins->type = type;
@@ -68,11 +57,7 @@ void ir_build_store_vol(ir_builder_t *b, const char *name, type_kind_t type,
         return;
     ins->op = IR_STORE;
     ins->src1 = val.id;
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return;
-    }
+    ins->name = intern_str(name ? name : "");
     ins->is_volatile = 1;
     if (name)
         ins->alias_set = get_alias(b, name);
@@ -110,11 +95,7 @@ ir_value_t ir_build_addr(ir_builder_t *b, const char *name)
         return (ir_value_t){0};
     ins->op = IR_ADDR;
     ins->dest = alloc_value_id(b);
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return (ir_value_t){0};
-    }
+    ins->name = intern_str(name ? name : "");
     return (ir_value_t){ins->dest};
 }
 
@@ -201,11 +182,7 @@ ir_value_t ir_build_load_idx(ir_builder_t *b, const char *name, ir_value_t idx,
     ins->op = IR_LOAD_IDX;
     ins->dest = alloc_value_id(b);
     ins->src1 = idx.id;
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return (ir_value_t){0};
-    }
+    ins->name = intern_str(name ? name : "");
     if (name)
         ins->alias_set = get_alias(b, name);
     ins->type = type;
@@ -221,11 +198,7 @@ ir_value_t ir_build_load_idx_vol(ir_builder_t *b, const char *name, ir_value_t i
     ins->op = IR_LOAD_IDX;
     ins->dest = alloc_value_id(b);
     ins->src1 = idx.id;
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return (ir_value_t){0};
-    }
+    ins->name = intern_str(name ? name : "");
     ins->is_volatile = 1;
     if (name)
         ins->alias_set = get_alias(b, name);
@@ -242,11 +215,7 @@ void ir_build_store_idx(ir_builder_t *b, const char *name, ir_value_t idx,
     ins->op = IR_STORE_IDX;
     ins->src1 = idx.id;
     ins->src2 = val.id;
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return;
-    }
+    ins->name = intern_str(name ? name : "");
     if (name)
         ins->alias_set = get_alias(b, name);
     ins->type = type;
@@ -261,11 +230,7 @@ void ir_build_store_idx_vol(ir_builder_t *b, const char *name, ir_value_t idx,
     ins->op = IR_STORE_IDX;
     ins->src1 = idx.id;
     ins->src2 = val.id;
-    ins->name = vc_strdup(name ? name : "");
-    if (!ins->name) {
-        remove_instr(b, ins);
-        return;
-    }
+    ins->name = intern_str(name ? name : "");
     ins->is_volatile = 1;
     if (name)
         ins->alias_set = get_alias(b, name);
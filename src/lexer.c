@@ -5,7 +5,6 @@
  * See LICENSE for details.
  */
 
-#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -15,61 +14,68 @@
 #include "util.h"
 #include "error.h"
 #include "lexer_internal.h"
+#include "intern.h"
 
-typedef struct {
-    const char *op;
-    token_type_t tok;
-} punct_entry_t;
-
-/* ordered longest to shortest for greedy matching */
-static const punct_entry_t punct_table[] = {
-    { "...", TOK_ELLIPSIS },
-    { "<<=", TOK_SHLEQ },
-    { ">>=", TOK_SHREQ },
-    { "==",  TOK_EQ },
-    { "!=",  TOK_NEQ },
-    { "&&",  TOK_LOGAND },
-    { "||",  TOK_LOGOR },
-    { "<<",  TOK_SHL },
-    { ">>",  TOK_SHR },
-    { "<=",  TOK_LE },
-    { ">=",  TOK_GE },
-    { "->",  TOK_ARROW },
-    { "++",  TOK_INC },
-    { "--",  TOK_DEC },
-    { "+=",  TOK_PLUSEQ },
-    { "-=",  TOK_MINUSEQ },
-    { "*=",  TOK_STAREQ },
-    { "/=",  TOK_SLASHEQ },
-    { "%=",  TOK_PERCENTEQ },
-    { "&=",  TOK_AMPEQ },
-    { "|=",  TOK_PIPEEQ },
-    { "^=",  TOK_CARETEQ },
-    { "!",   TOK_NOT }
+#define S LEX_SPACE
+#define D (LEX_DIGIT | LEX_XDIGIT)
+#define X (LEX_ALPHA | LEX_XDIGIT)
+#define A LEX_ALPHA
+
+/* Class of every byte; see lexer_internal.h */
+const unsigned char lexer_char_class[256] = {
+    /* 0x00 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0,
+    /* 0x10 */ 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0x20 */ S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    /* 0x30 */ D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0,
+    /* 0x40 */ 0, X, X, X, X, X, X, A, A, A, A, A, A, A, A, A,
+    /* 0x50 */ A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, A,
+    /* 0x60 */ 0, X, X, X, X, X, X, A, A, A, A, A, A, A, A, A,
+    /* 0x70 */ A, A, A, A, A, A, A, A, A, A, A, 0, 0, 0, 0, 0
 };
 
-/* Iterate the keyword table and return the matching token type, or
- * TOK_IDENT if the text is not a keyword.
- */
+#undef S
+#undef D
+#undef X
+#undef A
+
+/* Return non-zero for tokens whose text is decoded literal contents */
+static int token_owns_text(token_type_t type)
+{
+    return type == TOK_STRING || type == TOK_WIDE_STRING ||
+           type == TOK_CHAR || type == TOK_WIDE_CHAR;
+}
 
-/* Helper to create and append a token to the vector */
+/*
+ * Helper to create and append a token to the vector.  Literal contents
+ * are copied for the token while all other text is interned.
+ */
 int append_token(vector_t *vec, token_type_t type, const char *lexeme,
                  size_t len, size_t line, size_t column)
 {
-    char *text = vc_strndup(lexeme, len);
+    int owned = token_owns_text(type);
+    const char *text = owned ? vc_strndup(lexeme, len)
+                             : intern_text(lexeme, len);
     if (!text) {
         vc_oom();
         return 0;
     }
-    token_t tok = { type, text, line, column };
+    token_t tok = { type, text, line, column, owned };
     if (!vector_push(vec, &tok)) {
-        free(text);
+        if (owned)
+            free((char *)text);
         vc_oom();
         return 0;
     }
     return 1;
 }
 
+/* Release the text of TOK when the token owns it */
+static void free_token_text(token_t *tok)
+{
+    if (tok->owned)
+        free((char *)tok->lexeme);
+}
+
 /* Parse a line marker of the form '# <num> "file"' and update counters */
 static int consume_line_marker(const char *src, size_t *i,
                                size_t *line, size_t *col)
@@ -81,10 +87,10 @@ static int consume_line_marker(const char *src, size_t *i,
     if (src[j] != ' ')
         return 0;
     j++;
-    if (!isdigit((unsigned char)src[j]))
+    if (!LEX_IS(src[j], LEX_DIGIT))
         return 0;
     size_t num = 0;
-    while (isdigit((unsigned char)src[j])) {
+    while (LEX_IS(src[j], LEX_DIGIT)) {
         num = num * 10 + (size_t)(src[j] - '0');
         j++;
     }
@@ -143,7 +149,7 @@ static void skip_whitespace(const char *src, size_t *i, size_t *line,
             (*line)++;
             *col = 1;
             (*i)++;
-        } else if (isspace((unsigned char)c)) {
+        } else if (LEX_IS(c, LEX_SPACE)) {
             (*i)++;
             (*col)++;
         } else {
@@ -152,54 +158,122 @@ static void skip_whitespace(const char *src, size_t *i, size_t *line,
     }
 }
 
-/* Convert punctuation characters to tokens */
-static int read_punct(char c, vector_t *tokens, size_t line, size_t column)
-{
-    token_type_t type = TOK_UNKNOWN;
-    switch (c) {
-    case '+': type = TOK_PLUS; break;
-    case '-': type = TOK_MINUS; break;
-    case '.': type = TOK_DOT; break;
-    case '&': type = TOK_AMP; break;
-    case '|': type = TOK_PIPE; break;
-    case '^': type = TOK_CARET; break;
-    case '*': type = TOK_STAR; break;
-    case '/': type = TOK_SLASH; break;
-    case '%': type = TOK_PERCENT; break;
-    case '=': type = TOK_ASSIGN; break;
-    case '<': type = TOK_LT; break;
-    case '>': type = TOK_GT; break;
-    case ';': type = TOK_SEMI; break;
-    case ',': type = TOK_COMMA; break;
-    case '(': type = TOK_LPAREN; break;
-    case ')': type = TOK_RPAREN; break;
-    case '{': type = TOK_LBRACE; break;
-    case '}': type = TOK_RBRACE; break;
-    case '[': type = TOK_LBRACKET; break;
-    case ']': type = TOK_RBRACKET; break;
-    case '?': type = TOK_QMARK; break;
-    case ':': type = TOK_COLON; break;
-    default: type = TOK_UNKNOWN; break;
-    }
-    return append_token(tokens, type, &c, 1, line, column);
-}
-
-
-static int scan_punct_table(const char *src, size_t *i, size_t *col,
-                            vector_t *tokens, size_t line)
+/*
+ * Recognize the punctuator at S.  The first character selects the
+ * candidates and at most two further characters decide the longest
+ * match, so no table of operators is searched.  The length is stored in
+ * LEN; characters that start no punctuator yield TOK_UNKNOWN.
+ */
+static token_type_t match_punct(const char *s, size_t *len)
 {
-    for (size_t p = 0; p < sizeof(punct_table) / sizeof(punct_table[0]); p++) {
-        const punct_entry_t *entry = &punct_table[p];
-        size_t len = strlen(entry->op);
-        if (strncmp(src + *i, entry->op, len) == 0) {
-            if (!append_token(tokens, entry->tok, entry->op, len, line, *col))
-                return -1;
-            *i += len;
-            *col += len;
-            return 1;
+    char c1 = s[1];
+    *len = 1;
+    switch (s[0]) {
+    case '.':
+        if (c1 == '.' && s[2] == '.') {
+            *len = 3;
+            return TOK_ELLIPSIS;
         }
+        return TOK_DOT;
+    case '<':
+        if (c1 == '<') {
+            *len = 2;
+            if (s[2] == '=') {
+                *len = 3;
+                return TOK_SHLEQ;
+            }
+            return TOK_SHL;
+        }
+        if (c1 == '=') {
+            *len = 2;
+            return TOK_LE;
+        }
+        return TOK_LT;
+    case '>':
+        if (c1 == '>') {
+            *len = 2;
+            if (s[2] == '=') {
+                *len = 3;
+                return TOK_SHREQ;
+            }
+            return TOK_SHR;
+        }
+        if (c1 == '=') {
+            *len = 2;
+            return TOK_GE;
+        }
+        return TOK_GT;
+    case '-':
+        *len = 2;
+        if (c1 == '>')
+            return TOK_ARROW;
+        if (c1 == '-')
+            return TOK_DEC;
+        if (c1 == '=')
+            return TOK_MINUSEQ;
+        *len = 1;
+        return TOK_MINUS;
+    case '+':
+        *len = 2;
+        if (c1 == '+')
+            return TOK_INC;
+        if (c1 == '=')
+            return TOK_PLUSEQ;
+        *len = 1;
+        return TOK_PLUS;
+    case '&':
+        *len = 2;
+        if (c1 == '&')
+            return TOK_LOGAND;
+        if (c1 == '=')
+            return TOK_AMPEQ;
+        *len = 1;
+        return TOK_AMP;
+    case '|':
+        *len = 2;
+        if (c1 == '|')
+            return TOK_LOGOR;
+        if (c1 == '=')
+            return TOK_PIPEEQ;
+        *len = 1;
+        return TOK_PIPE;
+    case '=':
+    case '!':
+    case '*':
+    case '/':
+    case '%':
+    case '^':
+        if (c1 == '=') {
+            *len = 2;
+            switch (s[0]) {
+            case '=': return TOK_EQ;
+            case '!': return TOK_NEQ;
+            case '*': return TOK_STAREQ;
+            case '/': return TOK_SLASHEQ;
+            case '%': return TOK_PERCENTEQ;
+            default: return TOK_CARETEQ;
+            }
+        }
+        switch (s[0]) {
+        case '=': return TOK_ASSIGN;
+        case '!': return TOK_NOT;
+        case '*': return TOK_STAR;
+        case '/': return TOK_SLASH;
+        case '%': return TOK_PERCENT;
+        default: return TOK_CARET;
+        }
+    case ';': return TOK_SEMI;
+    case ',': return TOK_COMMA;
+    case '(': return TOK_LPAREN;
+    case ')': return TOK_RPAREN;
+    case '{': return TOK_LBRACE;
+    case '}': return TOK_RBRACE;
+    case '[': return TOK_LBRACKET;
+    case ']': return TOK_RBRACKET;
+    case '?': return TOK_QMARK;
+    case ':': return TOK_COLON;
+    default: return TOK_UNKNOWN;
     }
-    return 0;
 }
 
 /* wrapper to scan numeric literals */
@@ -233,13 +307,12 @@ static int scan_char_tokens(const char *src, size_t *i, size_t *col,
 static int scan_punctuation(const char *src, size_t *i, size_t *col,
                             vector_t *tokens, size_t line)
 {
-    int res = scan_punct_table(src, i, col, tokens, line);
-    if (res)
-        return res;
-    char c = src[*i];
-    if (!read_punct(c, tokens, line, *col))
+    size_t len;
+    token_type_t type = match_punct(src + *i, &len);
+    if (!append_token(tokens, type, src + *i, len, line, *col))
         return -1;
-    (*i)++; (*col)++;
+    *i += len;
+    *col += len;
     return 1;
 }
 
@@ -292,44 +365,95 @@ static token_t *cleanup_error_tokens(vector_t *vec)
 {
     token_t *tokens = (token_t *)vec->data;
     for (size_t j = 0; j < vec->count; j++)
-        free(tokens[j].lexeme);
+        free_token_text(&tokens[j]);
     vector_free(vec);
     return NULL;
 }
 
 /* Public API */
 
-/* Tokenize the entire source string */
-token_t *lexer_tokenize(const char *src, size_t *out_count)
+void lexer_stream_init(lexer_stream_t *ls)
 {
-    vector_t vec;
-    vector_init(&vec, sizeof(token_t));
-
-    /*
-     * Scan tokens sequentially until scan_next_token reports end of
-     * input. A negative return value indicates a lexing error and
-     * triggers cleanup of any tokens already produced.
-     */
+    vector_init(&ls->tokens, sizeof(token_t));
+    ls->line = 1;
+    ls->column = 1;
+}
 
-    size_t i = 0, line = 1, col = 1;
+int lexer_stream_feed(lexer_stream_t *ls, const char *text)
+{
     /*
      * Repeatedly scan tokens. The loop stops when scan_next_token
      * returns 0 (no more input) or a negative value for an error.
      */
+    size_t i = 0;
     while (1) {
-        int res = scan_next_token(src, &i, &line, &col, &vec);
+        int res = scan_next_token(text, &i, &ls->line, &ls->column,
+                                  &ls->tokens);
         if (res < 0)
-            return cleanup_error_tokens(&vec); /* propagate scanning error */
+            return 0;
         if (res == 0)
-            break; /* reached end of input */
+            return 1;
+    }
+}
+
+int lexer_stream_add(lexer_stream_t *ls, const char *text, size_t len,
+                     int label)
+{
+    size_t n = 0;
+    token_type_t type = TOK_UNKNOWN;
+    char c = text[0];
+    if (LEX_IS(c, LEX_ALPHA)) {
+        while (n < len && LEX_IS(text[n], LEX_ALPHA | LEX_DIGIT))
+            n++;
+        type = label ? TOK_LABEL : lookup_keyword(text, len);
+    } else if (!LEX_IS(c, LEX_DIGIT) && c != '"' && c != '\'' &&
+               !(c == '.' && LEX_IS(text[1], LEX_DIGIT)) &&
+               !(c == '/' && (text[1] == '/' || text[1] == '*'))) {
+        type = match_punct(text, &n);
+    }
+    /* literals and spellings of several tokens take the scanning path */
+    if (n != len)
+        return lexer_stream_feed(ls, text);
+
+    token_t tok = { type, text, ls->line, ls->column, 0 };
+    if (!vector_push(&ls->tokens, &tok)) {
+        vc_oom();
+        return 0;
     }
+    ls->column += len;
+    return 1;
+}
 
+token_t *lexer_stream_finish(lexer_stream_t *ls, size_t *out_count)
+{
     /* add explicit EOF marker after the last real token */
-    if (!append_token(&vec, TOK_EOF, "", 0, line, col))
-        return cleanup_error_tokens(&vec);
+    if (!append_token(&ls->tokens, TOK_EOF, "", 0, ls->line, ls->column))
+        return cleanup_error_tokens(&ls->tokens);
     if (out_count)
-        *out_count = vec.count;
-    return (token_t *)vec.data;
+        *out_count = ls->tokens.count;
+    token_t *toks = (token_t *)ls->tokens.data;
+    lexer_stream_init(ls);
+    return toks;
+}
+
+void lexer_stream_free(lexer_stream_t *ls)
+{
+    cleanup_error_tokens(&ls->tokens);
+    lexer_stream_init(ls);
+}
+
+/* Tokenize the entire source string */
+token_t *lexer_tokenize(const char *src, size_t *out_count)
+{
+    lexer_stream_t ls;
+    lexer_stream_init(&ls);
+
+    /* a negative scan result triggers cleanup of any tokens produced */
+    if (!lexer_stream_feed(&ls, src)) {
+        lexer_stream_free(&ls);
+        return NULL;
+    }
+    return lexer_stream_finish(&ls, out_count);
 }
 
 /* Free an array of tokens produced by lexer_tokenize */
@@ -339,7 +463,7 @@ void lexer_free_tokens(token_t *tokens, size_t count)
         return;
 
     for (size_t i = 0; i < count; i++)
-        free(tokens[i].lexeme);
+        free_token_text(&tokens[i]);
     free(tokens);
 }
 
@@ -1,4 +1,3 @@
-#include <ctype.h>
 #include <string.h>
 #include "token.h"
 #include "vector.h"
@@ -8,58 +7,71 @@
 
 typedef struct {
     const char *kw;
+    size_t len;
     token_type_t tok;
 } keyword_t;
 
-static const keyword_t keyword_table[] = {
-    { "if",       TOK_KW_IF },
-    { "else",     TOK_KW_ELSE },
-    { "do",       TOK_KW_DO },
-    { "while",    TOK_KW_WHILE },
-    { "for",      TOK_KW_FOR },
-    { "break",    TOK_KW_BREAK },
-    { "continue", TOK_KW_CONTINUE },
-    { "goto",     TOK_KW_GOTO },
-    { "switch",   TOK_KW_SWITCH },
-    { "case",     TOK_KW_CASE },
-    { "default",  TOK_KW_DEFAULT },
-    { "sizeof",   TOK_KW_SIZEOF },
-    { "int",      TOK_KW_INT },
-    { "char",     TOK_KW_CHAR },
-    { "float",    TOK_KW_FLOAT },
-    { "double",   TOK_KW_DOUBLE },
-    { "short",    TOK_KW_SHORT },
-    { "long",     TOK_KW_LONG },
-    { "bool",     TOK_KW_BOOL },
-    { "_Bool",    TOK_KW_BOOL },
-    { "_Complex", TOK_KW_COMPLEX },
-    { "alignas",  TOK_KW_ALIGNAS },
-    { "_Alignof", TOK_KW_ALIGNOF },
-    { "unsigned", TOK_KW_UNSIGNED },
-    { "void",     TOK_KW_VOID },
-    { "enum",     TOK_KW_ENUM },
-    { "struct",   TOK_KW_STRUCT },
-    { "union",    TOK_KW_UNION },
-    { "typedef",  TOK_KW_TYPEDEF },
-    { "static",   TOK_KW_STATIC },
-    { "extern",   TOK_KW_EXTERN },
-    { "const",    TOK_KW_CONST },
-    { "volatile", TOK_KW_VOLATILE },
-    { "restrict", TOK_KW_RESTRICT },
-    { "register", TOK_KW_REGISTER },
-    { "inline",   TOK_KW_INLINE },
-    { "_Noreturn",       TOK_KW_NORETURN },
-    { "_Static_assert",  TOK_KW_STATIC_ASSERT },
-    { "return",   TOK_KW_RETURN }
+/*
+ * Keywords are found through a perfect hash of the length and the first
+ * and last characters.  The slot of every keyword is computed by the
+ * compiler from KW_SLOT below; two keywords sharing a slot would be a
+ * duplicate designated initializer, which -Wextra (-Woverride-init)
+ * reports, so the table stays collision free when keywords are added.
+ * A lookup costs one hash and at most one memcmp().
+ */
+#define KW_SLOTS 128
+#define KW_SLOT(len, first, last) \
+    (((len) + (unsigned)(first) * 10u + (unsigned)(last) * 3u) & \
+     (KW_SLOTS - 1))
+
+static const keyword_t keyword_table[KW_SLOTS] = {
+    [KW_SLOT(2, 'i', 'f')] = { "if", 2, TOK_KW_IF },
+    [KW_SLOT(4, 'e', 'e')] = { "else", 4, TOK_KW_ELSE },
+    [KW_SLOT(2, 'd', 'o')] = { "do", 2, TOK_KW_DO },
+    [KW_SLOT(5, 'w', 'e')] = { "while", 5, TOK_KW_WHILE },
+    [KW_SLOT(3, 'f', 'r')] = { "for", 3, TOK_KW_FOR },
+    [KW_SLOT(5, 'b', 'k')] = { "break", 5, TOK_KW_BREAK },
+    [KW_SLOT(8, 'c', 'e')] = { "continue", 8, TOK_KW_CONTINUE },
+    [KW_SLOT(4, 'g', 'o')] = { "goto", 4, TOK_KW_GOTO },
+    [KW_SLOT(6, 's', 'h')] = { "switch", 6, TOK_KW_SWITCH },
+    [KW_SLOT(4, 'c', 'e')] = { "case", 4, TOK_KW_CASE },
+    [KW_SLOT(7, 'd', 't')] = { "default", 7, TOK_KW_DEFAULT },
+    [KW_SLOT(6, 's', 'f')] = { "sizeof", 6, TOK_KW_SIZEOF },
+    [KW_SLOT(3, 'i', 't')] = { "int", 3, TOK_KW_INT },
+    [KW_SLOT(4, 'c', 'r')] = { "char", 4, TOK_KW_CHAR },
+    [KW_SLOT(5, 'f', 't')] = { "float", 5, TOK_KW_FLOAT },
+    [KW_SLOT(6, 'd', 'e')] = { "double", 6, TOK_KW_DOUBLE },
+    [KW_SLOT(5, 's', 't')] = { "short", 5, TOK_KW_SHORT },
+    [KW_SLOT(4, 'l', 'g')] = { "long", 4, TOK_KW_LONG },
+    [KW_SLOT(4, 'b', 'l')] = { "bool", 4, TOK_KW_BOOL },
+    [KW_SLOT(5, '_', 'l')] = { "_Bool", 5, TOK_KW_BOOL },
+    [KW_SLOT(8, '_', 'x')] = { "_Complex", 8, TOK_KW_COMPLEX },
+    [KW_SLOT(7, 'a', 's')] = { "alignas", 7, TOK_KW_ALIGNAS },
+    [KW_SLOT(8, '_', 'f')] = { "_Alignof", 8, TOK_KW_ALIGNOF },
+    [KW_SLOT(8, 'u', 'd')] = { "unsigned", 8, TOK_KW_UNSIGNED },
+    [KW_SLOT(4, 'v', 'd')] = { "void", 4, TOK_KW_VOID },
+    [KW_SLOT(4, 'e', 'm')] = { "enum", 4, TOK_KW_ENUM },
+    [KW_SLOT(6, 's', 't')] = { "struct", 6, TOK_KW_STRUCT },
+    [KW_SLOT(5, 'u', 'n')] = { "union", 5, TOK_KW_UNION },
+    [KW_SLOT(7, 't', 'f')] = { "typedef", 7, TOK_KW_TYPEDEF },
+    [KW_SLOT(6, 's', 'c')] = { "static", 6, TOK_KW_STATIC },
+    [KW_SLOT(6, 'e', 'n')] = { "extern", 6, TOK_KW_EXTERN },
+    [KW_SLOT(5, 'c', 't')] = { "const", 5, TOK_KW_CONST },
+    [KW_SLOT(8, 'v', 'e')] = { "volatile", 8, TOK_KW_VOLATILE },
+    [KW_SLOT(8, 'r', 't')] = { "restrict", 8, TOK_KW_RESTRICT },
+    [KW_SLOT(8, 'r', 'r')] = { "register", 8, TOK_KW_REGISTER },
+    [KW_SLOT(6, 'i', 'e')] = { "inline", 6, TOK_KW_INLINE },
+    [KW_SLOT(9, '_', 'n')] = { "_Noreturn", 9, TOK_KW_NORETURN },
+    [KW_SLOT(14, '_', 't')] = { "_Static_assert", 14, TOK_KW_STATIC_ASSERT },
+    [KW_SLOT(6, 'r', 'n')] = { "return", 6, TOK_KW_RETURN }
 };
 
-static token_type_t lookup_keyword(const char *str, size_t len)
+token_type_t lookup_keyword(const char *str, size_t len)
 {
-    for (size_t i = 0; i < sizeof(keyword_table) / sizeof(keyword_table[0]); i++) {
-        const keyword_t *kw = &keyword_table[i];
-        if (strlen(kw->kw) == len && strncmp(kw->kw, str, len) == 0)
-            return kw->tok;
-    }
+    const keyword_t *kw = &keyword_table[KW_SLOT(len, (unsigned char)str[0],
+                                                 (unsigned char)str[len - 1])];
+    if (kw->len == len && memcmp(kw->kw, str, len) == 0)
+        return kw->tok;
     return TOK_IDENT;
 }
 
@@ -67,7 +79,7 @@ static int read_identifier(const char *src, size_t *i, size_t *col,
                            vector_t *tokens, size_t line)
 {
     size_t start = *i;
-    while (isalnum((unsigned char)src[*i]) || src[*i] == '_')
+    while (LEX_IS(src[*i], LEX_ALPHA | LEX_DIGIT))
         (*i)++;
     size_t len = *i - start;
     token_type_t type = TOK_IDENT;
@@ -89,7 +101,7 @@ int scan_identifier(const char *src, size_t *i, size_t *col,
                     vector_t *tokens, size_t line)
 {
     char c = src[*i];
-    if (!isalpha((unsigned char)c) && c != '_')
+    if (!LEX_IS(c, LEX_ALPHA))
         return 0;
     if (!read_identifier(src, i, col, tokens, line))
         return -1;
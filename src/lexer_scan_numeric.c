@@ -1,4 +1,3 @@
-#include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
 #include "token.h"
@@ -17,21 +16,21 @@ static int read_number(const char *src, size_t *i, size_t *col,
 
     if (src[*i] == '0' && (src[*i + 1] == 'x' || src[*i + 1] == 'X')) {
         (*i) += 2;
-        while (isxdigit((unsigned char)src[*i]))
+        while (LEX_IS(src[*i], LEX_XDIGIT))
             (*i)++;
     } else if (src[*i] == '0') {
         (*i)++;
         while (src[*i] >= '0' && src[*i] <= '7')
             (*i)++;
     } else {
-        while (isdigit((unsigned char)src[*i]))
+        while (LEX_IS(src[*i], LEX_DIGIT))
             (*i)++;
     }
 
     if (src[*i] == '.') {
         is_float = 1;
         (*i)++;
-        while (isdigit((unsigned char)src[*i]))
+        while (LEX_IS(src[*i], LEX_DIGIT))
             (*i)++;
     }
 
@@ -40,7 +39,7 @@ static int read_number(const char *src, size_t *i, size_t *col,
         (*i)++;
         if (src[*i] == '+' || src[*i] == '-')
             (*i)++;
-        while (isdigit((unsigned char)src[*i]))
+        while (LEX_IS(src[*i], LEX_DIGIT))
             (*i)++;
     }
 
@@ -267,7 +266,7 @@ static int read_string_lit(const char *src, size_t *i, size_t *col,
 int scan_number(const char *src, size_t *i, size_t *col,
                 vector_t *tokens, size_t line)
 {
-    if (!isdigit((unsigned char)src[*i]))
+    if (!LEX_IS(src[*i], LEX_DIGIT))
         return 0;
     if (!read_number(src, i, col, tokens, line))
         return -1;
@@ -16,6 +16,7 @@
 #include "cli.h"
 #include "compile.h"
 #include "error.h"
+#include "intern.h"
 #include "semantic_stmt.h"
 
 /*
@@ -60,6 +61,9 @@ int main(int argc, char **argv)
         else if (cli.dump_ir)
             printf("Compiling %s (IR dumped to stdout)\n",
                    ((const char **)cli.sources.data)[0]);
+        else if (cli.dump_regalloc)
+            printf("Compiling %s (register allocation dumped to stdout)\n",
+                   ((const char **)cli.sources.data)[0]);
         else if (cli.dump_ast)
             printf("Compiling %s (AST dumped to stdout)\n",
                    ((const char **)cli.sources.data)[0]);
@@ -80,5 +84,6 @@ int main(int argc, char **argv)
 
 cleanup:
     cli_free_opts(&cli);
+    intern_cleanup();
     return ret;
 }
@@ -7,14 +7,12 @@
 
 #include <stdio.h>
 #include "opt.h"
+#include "ir_cfg.h"
 
 /* Pass implementations */
-void propagate_load_consts(ir_builder_t *ir);
-void common_subexpr_elim(ir_builder_t *ir);
-void inline_small_funcs(ir_builder_t *ir);
-void fold_constants(ir_builder_t *ir);
-void opt_licm(ir_builder_t *ir);
-void remove_unreachable_blocks(ir_builder_t *ir);
+void inline_small_funcs(ir_builder_t *ir, const opt_config_t *cfg);
+void fold_constants(ir_builder_t *ir, const opt_config_t *cfg);
+void remove_unreachable_blocks(ir_builder_t *ir, ir_cfg_t *cfg);
 void dead_code_elim(ir_builder_t *ir);
 void compute_alias_sets(ir_builder_t *ir);
 
@@ -27,19 +25,48 @@ void opt_error(const char *msg)
 /* Run enabled optimization passes on the IR */
 void opt_run(ir_builder_t *ir, const opt_config_t *cfg)
 {
-    opt_config_t def = {1, 1, 1, 1, 1};
+    opt_config_t def = {1, 1, 1, 1, 1, 0, 0};
     const opt_config_t *c = cfg ? cfg : &def;
     compute_alias_sets(ir);
-    if (c->const_prop)
-        propagate_load_consts(ir);
-    common_subexpr_elim(ir);
-    if (c->inline_funcs)
-        inline_small_funcs(ir);
+
+    /*
+     * The CFG is built once here.  CSE and folding only rewrite
+     * instructions in place; passes editing the instruction ranges either
+     * update the affected functions or invalidate them.
+     */
+    ir_cfg_t fcfg;
+    if (!ir_cfg_build(ir, &fcfg))
+        opt_error("out of memory");
+    opt_value_number(ir, &fcfg);
+    if (c->inline_funcs) {
+        inline_small_funcs(ir, c);
+        ir_cfg_invalidate(&fcfg);
+    }
+    int have_cfg = ir_cfg_refresh(&fcfg);
+    if (!have_cfg)
+        opt_error("out of memory");
+    if (have_cfg && c->const_prop)
+        opt_sccp(ir, &fcfg, c);
     if (c->fold_constants)
-        fold_constants(ir);
-    opt_licm(ir);
-    remove_unreachable_blocks(ir);
+        fold_constants(ir, c);
+    if (have_cfg) {
+        remove_unreachable_blocks(ir, &fcfg);
+        if (c->mem2reg) {
+            opt_mem2reg(ir, &fcfg);
+            /* loads of promoted locals are single values now */
+            opt_value_number(ir, &fcfg);
+        }
+        /* after mem2reg so induction variables are phis */
+        if (c->opt_level > 0) {
+            opt_licm(ir, &fcfg, c);
+            opt_memory(ir, &fcfg);
+        }
+    }
     if (c->dead_code)
         dead_code_elim(ir);
+    /* the code generator only understands the phi-free form */
+    if (c->mem2reg)
+        opt_out_of_ssa(ir, &fcfg);
+    ir_cfg_free(&fcfg);
 }
 
@@ -11,10 +11,11 @@
 #include "ir_core.h"
 #include "util.h"
 
+/* NAME is interned so entries are matched by pointer */
 static int lookup_alias(alias_ent_t **list, const char *name, int *next_id)
 {
     alias_ent_t *e = *list;
-    while (e && strcmp(e->name, name) != 0)
+    while (e && e->name != name)
         e = e->next;
     if (e)
         return e->set;
@@ -23,12 +24,7 @@ static int lookup_alias(alias_ent_t **list, const char *name, int *next_id)
         opt_error("out of memory");
         return 0;
     }
-    e->name = vc_strdup(name);
-    if (!e->name) {
-        opt_error("out of memory");
-        free(e);
-        return 0;
-    }
+    e->name = name;
     e->set = (*next_id)++;
     e->next = *list;
     *list = e;
@@ -71,7 +67,6 @@ void compute_alias_sets(ir_builder_t *ir)
 
     while (vars) {
         alias_ent_t *n = vars->next;
-        free((char *)vars->name);
         free(vars);
         vars = n;
     }
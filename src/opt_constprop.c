@@ -1,5 +1,20 @@
 /*
- * Constant propagation optimization pass.
+ * Sparse conditional constant propagation.
+ *
+ * Each function is evaluated over its CFG with an optimistic lattice:
+ * a value starts out unknown, becomes a constant when its executable
+ * definitions produce one and drops to varying once they disagree.  A
+ * block only becomes executable when an executable branch can reach it,
+ * so a branch on a known condition keeps the other arm out of the
+ * analysis.  Besides SSA values the lattice covers the scalar variables
+ * accessed by IR_LOAD and IR_STORE; their states are met per block over
+ * the executable incoming edges.  A static global that is never written
+ * or has its address taken anywhere in the translation unit keeps its
+ * initializer, so configuration flags declared that way fold as well.
+ *
+ * Afterwards constant definitions become IR_CONST, branches on known
+ * conditions become jumps or fall through and blocks that never became
+ * executable are removed.
  *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
@@ -7,281 +22,579 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h>
-#include <stdint.h>
 #include "opt.h"
+#include "intern.h"
+
+/* Functions with more variable states than this only track values */
+#define SCCP_MAX_CELLS ((size_t)1 << 18)
+
+enum { LAT_TOP, LAT_CONST, LAT_BOTTOM };
 
-typedef struct var_const {
+typedef struct {
+    int kind;
+    type_kind_t type;   /* type of the store for variable states */
+    long long value;
+} lattice_t;
+
+/* A static scalar global and whether anything may change it */
+typedef struct {
     const char *name;
-    int value;
-    int known;
-    struct var_const *next;
-} var_const_t;
+    long long value;
+    int written;
+} invariant_t;
 
 typedef struct {
+    ir_builder_t *ir;
+    ir_function_t *fn;
+    int x86_64;
+    lattice_t *vals;         /* per value id */
     size_t max_id;
-    int *is_const;
-    int *values;
-    var_const_t *vars;
-} const_track_t;
+    invariant_t *globals;    /* static globals sorted by name */
+    size_t nglobals;
+    const char **vars;       /* tracked variable names, sorted */
+    unsigned char *escapes;  /* variable may be written behind our back */
+    lattice_t *init;         /* state on function entry */
+    size_t nvars;
+    lattice_t *out;          /* state at the end of block b: out[b * nvars] */
+    lattice_t *cur;          /* state while evaluating a block */
+    unsigned char *exec;     /* block is executable */
+    unsigned char *edges;    /* bit s set when succs[s] is executable */
+    int changed;
+} sccp_t;
 
-/* Update destination entry in constant tracking tables */
-static void update_const(const_track_t *ct, ir_instr_t *ins, int val, int cst)
+/* Combine two lattice elements */
+static lattice_t meet(lattice_t a, lattice_t b)
 {
-    size_t max_id = ct->max_id;
-    if (ins->dest >= 0 && (size_t)ins->dest < max_id) {
-        ct->is_const[ins->dest] = cst;
-        if (cst)
-            ct->values[ins->dest] = val;
-    }
+    if (a.kind == LAT_TOP)
+        return b;
+    if (b.kind == LAT_TOP || a.kind == LAT_BOTTOM)
+        return a;
+    if (b.kind == LAT_BOTTOM || a.value != b.value || a.type != b.type)
+        return (lattice_t){LAT_BOTTOM, TYPE_UNKNOWN, 0};
+    return a;
 }
 
-/* Reset all entries in a variable constant list */
-static void clear_var_list(var_const_t *head)
+static int same(lattice_t a, lattice_t b)
 {
-    for (var_const_t *v = head; v; v = v->next)
-        v->known = 0;
+    return a.kind == b.kind &&
+           (a.kind != LAT_CONST || (a.value == b.value && a.type == b.type));
 }
 
-/* Allocate arrays used for constant tracking */
-static int init_const_tracking(const_track_t *ct, ir_builder_t *ir)
+static lattice_t lat_const(long long v)
 {
-    ct->max_id = ir->next_value_id;
-    ct->is_const = calloc(ct->max_id, sizeof(int));
-    ct->values = calloc(ct->max_id, sizeof(int));
-    ct->vars = NULL;
-    if (!ct->is_const || !ct->values) {
-        opt_error("out of memory");
-        free(ct->is_const);
-        free(ct->values);
-        return 0;
-    }
-    return 1;
+    return (lattice_t){LAT_CONST, TYPE_UNKNOWN, v};
+}
+
+static const lattice_t lat_top = {LAT_TOP, TYPE_UNKNOWN, 0};
+static const lattice_t lat_bottom = {LAT_BOTTOM, TYPE_UNKNOWN, 0};
+
+static lattice_t value_of(const sccp_t *st, int v)
+{
+    if (v <= 0 || (size_t)v >= st->max_id)
+        return lat_bottom;
+    return st->vals[v];
 }
 
-/* Free all memory owned by the constant tracker */
-static void free_const_tracking(const_track_t *ct)
+/* Lower the state of value V to include L */
+static void set_value(sccp_t *st, int v, lattice_t l)
 {
-    free(ct->is_const);
-    free(ct->values);
-    while (ct->vars) {
-        var_const_t *next = ct->vars->next;
-        free(ct->vars);
-        ct->vars = next;
+    if (v <= 0 || (size_t)v >= st->max_id)
+        return;
+    lattice_t m = meet(st->vals[v], l);
+    if (!same(m, st->vals[v])) {
+        st->vals[v] = m;
+        st->changed = 1;
     }
 }
 
-/* Evaluate a long double binary op */
-static uint64_t eval_long_float_op(ir_op_t op, long double a, long double b)
+static int cmp_name(const void *a, const void *b)
 {
-    if (sizeof(long double) > sizeof(uint64_t))
-        return 0;
+    const char *x = *(const char *const *)a;
+    const char *y = *(const char *const *)b;
+    return x < y ? -1 : x > y;
+}
 
-    long double res;
+/* Index of tracked variable NAME or -1 */
+static long find_var(const sccp_t *st, const char *name)
+{
+    if (!st->nvars || !name)
+        return -1;
+    const char **hit = bsearch(&name, st->vars, st->nvars, sizeof(*st->vars),
+                               cmp_name);
+    return hit ? (long)(hit - st->vars) : -1;
+}
 
-    switch (op) {
-    case IR_LFADD: res = a + b; break;
-    case IR_LFSUB: res = a - b; break;
-    case IR_LFMUL: res = a * b; break;
-    case IR_LFDIV: res = b != 0.0L ? a / b : 0.0L; break;
-    default:       res = 0.0L; break;
-    }
+static int cmp_global(const void *a, const void *b)
+{
+    const char *x = *(const char *const *)a;
+    const char *y = ((const invariant_t *)b)->name;
+    return x < y ? -1 : x > y;
+}
 
-    uint64_t out = 0;
-    memcpy(&out, &res, sizeof(res) > sizeof(out) ? sizeof(out) : sizeof(res));
-    return out;
+static int cmp_invariant(const void *a, const void *b)
+{
+    const char *x = ((const invariant_t *)a)->name;
+    return cmp_global(&x, b);
 }
 
-/* Handle constant propagation through an IR_STORE instruction */
-static void handle_store(const_track_t *ct, ir_instr_t *ins, int in_loop)
+/* Static global NAME or NULL */
+static invariant_t *find_global(const sccp_t *st, const char *name)
 {
-    var_const_t *v = ct->vars;
-    size_t max_id = ct->max_id;
-    while (v && strcmp(v->name, ins->name) != 0)
-        v = v->next;
-    if (!v) {
-        v = calloc(1, sizeof(*v));
-        if (!v) {
-            opt_error("out of memory");
-            return;
+    if (!st->nglobals || !name)
+        return NULL;
+    return bsearch(&name, st->globals, st->nglobals, sizeof(*st->globals),
+                   cmp_global);
+}
+
+/*
+ * Collect the static scalar globals of IR and mark the ones written,
+ * indexed or referenced by address anywhere in the translation unit.
+ */
+static int collect_globals(sccp_t *st)
+{
+    size_t n = 0, cap = 0;
+    for (ir_instr_t *i = st->ir->head; i; i = i->next) {
+        if (i->op != IR_GLOB_VAR || !i->src1 || i->data)
+            continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 16;
+            invariant_t *tmp = realloc(st->globals, cap * sizeof(*tmp));
+            if (!tmp)
+                return 0;
+            st->globals = tmp;
         }
-        v->name = ins->name;
-        v->next = ct->vars;
-        ct->vars = v;
+        st->globals[n++] = (invariant_t){i->name, i->imm, 0};
     }
-    if (!in_loop && !ins->is_volatile &&
-        (size_t)ins->src1 < max_id && ct->is_const[ins->src1]) {
-        v->known = 1;
-        v->value = ct->values[ins->src1];
-    } else {
-        v->known = 0;
+    if (!n)
+        return 1;
+    qsort(st->globals, n, sizeof(*st->globals), cmp_invariant);
+    st->nglobals = n;
+    for (size_t k = 1; k < n; k++)
+        if (st->globals[k].name == st->globals[k - 1].name)
+            st->globals[k].written = st->globals[k - 1].written = 1;
+
+    for (ir_instr_t *i = st->ir->head; i; i = i->next) {
+        invariant_t *g;
+        if (i->op == IR_GLOB_ADDR)
+            g = find_global(st, intern_str(i->data ? i->data : ""));
+        else if (i->op != IR_LOAD && i->op != IR_GLOB_VAR &&
+                 i->op != IR_LOAD_IDX && i->op != IR_BFLOAD)
+            g = find_global(st, i->name);
+        else
+            continue;
+        if (g)
+            g->written = 1;
     }
+    return 1;
 }
 
-/* Handle constant propagation through an IR_LOAD instruction */
-static void handle_load(const_track_t *ct, ir_instr_t *ins, int in_loop)
+/*
+ * Collect the variables read and written by name in the function.  Only
+ * locals whose address is never taken are private; globals and named
+ * locals may change in calls and stores through pointers.
+ */
+static int collect_vars(sccp_t *st)
 {
-    var_const_t *v = ct->vars;
-    size_t max_id = ct->max_id;
-    while (v && strcmp(v->name, ins->name) != 0)
-        v = v->next;
-    if (!in_loop && !ins->is_volatile && v && v->known) {
-        free(ins->name);
-        ins->name = NULL;
-        ins->op = IR_CONST;
-        ins->imm = v->value;
-        if (ins->dest >= 0 && (size_t)ins->dest < max_id) {
-            ct->is_const[ins->dest] = 1;
-            ct->values[ins->dest] = v->value;
+    ir_function_t *fn = st->fn;
+    size_t n = 0, cap = 0;
+    for (ir_instr_t *i = fn->begin->next; i && i != fn->end; i = i->next) {
+        if ((i->op != IR_LOAD && i->op != IR_STORE) || !i->name)
+            continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 16;
+            const char **tmp = realloc(st->vars, cap * sizeof(*tmp));
+            if (!tmp)
+                return 0;
+            st->vars = tmp;
         }
-    } else if (ins->dest >= 0 && (size_t)ins->dest < max_id) {
-        ct->is_const[ins->dest] = 0;
+        st->vars[n++] = i->name;
     }
+    st->nvars = 0;
+    if (!n)
+        return 1;
+    qsort(st->vars, n, sizeof(*st->vars), cmp_name);
+    size_t u = 1;
+    for (size_t k = 1; k < n; k++)
+        if (st->vars[k] != st->vars[u - 1])
+            st->vars[u++] = st->vars[k];
+    if (u * fn->block_count > SCCP_MAX_CELLS)
+        return 1;
+
+    st->escapes = calloc(u, 1);
+    st->init = malloc(u * sizeof(*st->init));
+    st->out = malloc(u * fn->block_count * sizeof(*st->out));
+    st->cur = malloc(u * sizeof(*st->cur));
+    if (!st->escapes || !st->init || !st->out || !st->cur)
+        return 0;
+    st->nvars = u;
+    for (size_t k = 0; k < u; k++) {
+        invariant_t *g = find_global(st, st->vars[k]);
+        st->init[k] = lat_bottom;
+        st->escapes[k] = strncmp(st->vars[k], "stack:", 6) != 0;
+        if (g && !g->written) {
+            /* typed by the loads reading it */
+            st->init[k] = lat_const(g->value);
+            st->escapes[k] = 0;
+        }
+    }
+    for (ir_instr_t *i = fn->begin->next; i && i != fn->end; i = i->next) {
+        long k = i->op == IR_ADDR ? find_var(st, i->name) : -1;
+        if (k >= 0)
+            st->escapes[k] = 1;
+    }
+    for (size_t k = 0; k < u * fn->block_count; k++)
+        st->out[k] = lat_top;
+    return 1;
 }
 
-/* Update constant tracking information for a single instruction */
-static void propagate_through_instruction(const_track_t *ct, ir_instr_t *ins,
-                                          int in_loop)
+/* Forget the variables a call or a store through a pointer may change */
+static void kill_escaping(sccp_t *st)
 {
-    size_t max_id = ct->max_id;
+    for (size_t k = 0; k < st->nvars; k++)
+        if (st->escapes[k])
+            st->cur[k] = lat_bottom;
+}
+
+/* Return 1 when the edge from block P to block B is executable */
+static int edge_live(const sccp_t *st, size_t p, size_t b)
+{
+    const ir_block_t *bb = &st->fn->blocks[p];
+    for (size_t s = 0; s < bb->succ_count; s++)
+        if (bb->succs[s] == b && (st->edges[p] >> s & 1))
+            return 1;
+    return 0;
+}
+
+/* Mark the edges of block B leading to block TARGET executable */
+static void mark_edge(sccp_t *st, size_t b, size_t target)
+{
+    const ir_block_t *bb = &st->fn->blocks[b];
+    for (size_t s = 0; s < bb->succ_count; s++) {
+        if (bb->succs[s] != target || (st->edges[b] >> s & 1))
+            continue;
+        st->edges[b] |= (unsigned char)(1u << s);
+        st->exec[target] = 1;
+        st->changed = 1;
+    }
+}
+
+/* Merge the incoming phi values arriving over executable edges */
+static lattice_t eval_phi(const sccp_t *st, size_t b, const ir_instr_t *phi)
+{
+    const ir_block_t *bb = &st->fn->blocks[b];
+    const ir_phi_arg_t *args = ir_phi_args(phi);
+    lattice_t l = lat_top;
+    for (long long a = 0; a < phi->imm; a++) {
+        int live = 0;
+        if (!args[a].pred)
+            live = b == 0 || edge_live(st, b - 1, b);
+        for (size_t p = 0; args[a].pred && p < bb->pred_count; p++)
+            if (st->fn->blocks[bb->preds[p]].last == args[a].pred)
+                live = edge_live(st, bb->preds[p], b);
+        if (live)
+            l = meet(l, value_of(st, args[a].value));
+    }
+    return l;
+}
+
+/* Evaluate one instruction against the variable state in st->cur */
+static void eval_instr(sccp_t *st, size_t b, ir_instr_t *ins)
+{
+    lattice_t a, c;
+    long long r;
+    long k;
+
     switch (ins->op) {
     case IR_CONST:
-        if (ins->dest >= 0 && (size_t)ins->dest < max_id) {
-            ct->is_const[ins->dest] = 1;
-            ct->values[ins->dest] = (int)ins->imm;
-        }
+        set_value(st, ins->dest, lat_const(ins->imm));
         break;
-    case IR_STORE:
-    case IR_BFSTORE:
-        handle_store(ct, ins, in_loop);
+    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+    case IR_SHL: case IR_SHR: case IR_AND: case IR_OR: case IR_XOR:
+    case IR_CMPEQ: case IR_CMPNE: case IR_CMPLT:
+    case IR_CMPGT: case IR_CMPLE: case IR_CMPGE:
+    case IR_LOGAND: case IR_LOGOR:
+        a = value_of(st, ins->src1);
+        c = value_of(st, ins->src2);
+        if (a.kind == LAT_BOTTOM || c.kind == LAT_BOTTOM)
+            set_value(st, ins->dest, lat_bottom);
+        else if (a.kind == LAT_CONST && c.kind == LAT_CONST)
+            set_value(st, ins->dest,
+                      opt_eval_int(ins->op, ins->type, a.value, c.value,
+                                   st->x86_64, &r) ? lat_const(r)
+                                                   : lat_bottom);
+        break;
+    case IR_CAST:
+        a = value_of(st, ins->src1);
+        if (a.kind == LAT_BOTTOM)
+            set_value(st, ins->dest, lat_bottom);
+        else if (a.kind == LAT_CONST)
+            set_value(st, ins->dest,
+                      opt_eval_cast(ins->imm, a.value, st->x86_64, &r)
+                          ? lat_const(r) : lat_bottom);
         break;
     case IR_LOAD:
-    case IR_BFLOAD:
-        handle_load(ct, ins, in_loop);
+        k = find_var(st, ins->name);
+        if (k < 0 || ins->is_volatile) {
+            set_value(st, ins->dest, lat_bottom);
+        } else if (st->cur[k].kind == LAT_CONST) {
+            lattice_t v = st->cur[k];
+            if (v.type == TYPE_UNKNOWN && opt_int_width(ins->type, st->x86_64))
+                set_value(st, ins->dest,
+                          lat_const(opt_int_normalize(ins->type, v.value,
+                                                      st->x86_64)));
+            else
+                set_value(st, ins->dest, v.type == ins->type
+                                             ? lat_const(v.value)
+                                             : lat_bottom);
+        } else if (st->cur[k].kind == LAT_BOTTOM) {
+            set_value(st, ins->dest, lat_bottom);
+        }
+        break;
+    case IR_STORE:
+        k = find_var(st, ins->name);
+        if (k < 0)
+            break;
+        a = value_of(st, ins->src1);
+        if (ins->is_volatile || !opt_int_width(ins->type, st->x86_64) ||
+            a.kind == LAT_BOTTOM) {
+            st->cur[k] = lat_bottom;
+        } else if (a.kind == LAT_CONST) {
+            st->cur[k].kind = LAT_CONST;
+            st->cur[k].type = ins->type;
+            st->cur[k].value = opt_int_normalize(ins->type, a.value,
+                                                 st->x86_64);
+        } else {
+            st->cur[k] = lat_top;
+        }
         break;
-    case IR_STORE_PTR:
     case IR_STORE_IDX:
-    case IR_CALL:
-    case IR_CALL_PTR:
-    case IR_CALL_NR:
-    case IR_CALL_PTR_NR:
-    case IR_ARG:
-        clear_var_list(ct->vars);
-        if (ins->dest >= 0 && (size_t)ins->dest < max_id)
-            ct->is_const[ins->dest] = 0;
+    case IR_BFSTORE:
+        k = find_var(st, ins->name);
+        if (k >= 0)
+            st->cur[k] = lat_bottom;
+        kill_escaping(st);
         break;
-    case IR_LOGAND: case IR_LOGOR:
-    case IR_LOAD_PARAM:
-    case IR_ADDR:
-    case IR_LOAD_PTR:
-    case IR_LOAD_IDX:
-    case IR_ALLOCA:
-    case IR_STORE_PARAM:
-    case IR_RETURN:
-    case IR_RETURN_AGG:
-    case IR_FUNC_BEGIN:
-    case IR_FUNC_END:
-    case IR_GLOB_STRING:
-    case IR_GLOB_WSTRING:
-    case IR_GLOB_VAR:
-    case IR_GLOB_ARRAY:
-    case IR_GLOB_UNION:
-    case IR_GLOB_STRUCT:
-    case IR_GLOB_ADDR:
-    case IR_BR:
-    case IR_BCOND:
-    case IR_LABEL:
-    case IR_LFADD: case IR_LFSUB: case IR_LFMUL: case IR_LFDIV:
-        if (sizeof(long double) <= sizeof(int) &&
-            ins->dest >= 0 && (size_t)ins->dest < max_id &&
-            (size_t)ins->src1 < max_id && (size_t)ins->src2 < max_id &&
-            ct->is_const[ins->src1] && ct->is_const[ins->src2]) {
-            int ia = ct->values[ins->src1];
-            int ib = ct->values[ins->src2];
-            long double a = 0.0L;
-            long double b = 0.0L;
-            memcpy(&a, &ia, sizeof(a));
-            memcpy(&b, &ib, sizeof(b));
-            uint64_t r = eval_long_float_op(ins->op, a, b);
-            ct->is_const[ins->dest] = 1;
-            ct->values[ins->dest] = (int)r;
-        } else if (ins->dest >= 0 && (size_t)ins->dest < max_id) {
-            ct->is_const[ins->dest] = 0;
-        }
+    case IR_STORE_PTR:
+    case IR_CALL: case IR_CALL_PTR:
+    case IR_CALL_NR: case IR_CALL_PTR_NR:
+        kill_escaping(st);
+        set_value(st, ins->dest, lat_bottom);
         break;
-    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
-    case IR_SHL: case IR_SHR: case IR_AND: case IR_OR: case IR_XOR:
-    case IR_FADD: case IR_FSUB: case IR_FMUL: case IR_FDIV:
-    case IR_PTR_ADD:
-    case IR_PTR_DIFF:
-    case IR_CMPEQ: case IR_CMPNE: case IR_CMPLT:
-    case IR_CMPGT: case IR_CMPLE: case IR_CMPGE:
-        if (ins->dest >= 0 && (size_t)ins->dest < max_id)
-            ct->is_const[ins->dest] = 0;
-        if (ins->op == IR_FUNC_BEGIN)
-            clear_var_list(ct->vars);
+    case IR_PHI:
+        set_value(st, ins->dest, eval_phi(st, b, ins));
         break;
-    case IR_CAST:
-    case IR_CPLX_CONST:
-    case IR_CPLX_ADD: case IR_CPLX_SUB:
-    case IR_CPLX_MUL: case IR_CPLX_DIV:
-        update_const(ct, ins, 0, 0);
+    default:
+        set_value(st, ins->dest, lat_bottom);
         break;
     }
 }
 
-/* Traverse all instructions applying store/load propagation */
-static int loop_start(ir_instr_t *lbl, ir_instr_t **end_out)
+/* Evaluate block B and mark the successors its terminator can reach */
+static void eval_block(sccp_t *st, size_t b)
 {
-    if (!lbl || lbl->op != IR_LABEL)
-        return 0;
-    ir_instr_t *bcond = lbl->next;
-    if (!bcond || bcond->op != IR_BCOND)
-        return 0;
-    ir_instr_t *br = bcond->next;
-    while (br && !(br->op == IR_BR && br->name && strcmp(br->name, lbl->name) == 0))
-        br = br->next;
-    if (!br)
-        return 0;
-    for (ir_instr_t *i = bcond->next; i && i != br; i = i->next)
-        if (i->op == IR_LABEL)
-            return 0;
-    *end_out = br;
-    return 1;
+    ir_function_t *fn = st->fn;
+    ir_block_t *bb = &fn->blocks[b];
+    size_t nv = st->nvars;
+
+    for (size_t k = 0; k < nv; k++)
+        st->cur[k] = b == 0 ? st->init[k] : lat_top;
+    for (size_t p = 0; p < bb->pred_count; p++) {
+        size_t pb = bb->preds[p];
+        if (!edge_live(st, pb, b))
+            continue;
+        for (size_t k = 0; k < nv; k++)
+            st->cur[k] = meet(st->cur[k], st->out[pb * nv + k]);
+    }
+
+    ir_instr_t *stop = bb->last->next;
+    for (ir_instr_t *i = bb->first; i != stop; i = i->next)
+        eval_instr(st, b, i);
+
+    for (size_t k = 0; k < nv; k++) {
+        lattice_t *o = &st->out[b * nv + k];
+        lattice_t m = meet(*o, st->cur[k]);
+        if (!same(m, *o)) {
+            *o = m;
+            st->changed = 1;
+        }
+    }
+
+    ir_instr_t *term = bb->last;
+    lattice_t cond = term->op == IR_BCOND ? value_of(st, term->src1)
+                                          : lat_bottom;
+    if (cond.kind != LAT_CONST) {
+        for (size_t s = 0; s < bb->succ_count; s++)
+            mark_edge(st, b, bb->succs[s]);
+    } else if (cond.value == 0) {
+        ir_block_t *target = ir_cfg_label_block(fn, term->name);
+        if (target)
+            mark_edge(st, b, target->id);
+    } else if (b + 1 < fn->block_count) {
+        mark_edge(st, b, b + 1);
+    }
 }
 
-static void process_instructions(ir_builder_t *ir, const_track_t *ct)
+/* Return 1 when the constant V can be materialized by the code generator */
+static int fits_target(const sccp_t *st, long long v)
 {
-    int in_loop = 0;
-    ir_instr_t *loop_end = NULL;
-    for (ir_instr_t *ins = ir->head; ins; ins = ins->next) {
-        if (!in_loop && ins->op == IR_LABEL && loop_start(ins, &loop_end))
-            in_loop = 1;
-
-        propagate_through_instruction(ct, ins, in_loop);
+    return st->x86_64 || (v >= -0x80000000LL && v <= 0xffffffffLL);
+}
 
-        if (in_loop && ins == loop_end)
-            in_loop = 0;
+/* Replace the definitions found constant by IR_CONST */
+static void rewrite_values(sccp_t *st)
+{
+    ir_function_t *fn = st->fn;
+    for (size_t b = 0; b < fn->block_count; b++) {
+        if (!st->exec[b])
+            continue;
+        ir_block_t *bb = &fn->blocks[b];
+        ir_instr_t *stop = bb->last->next;
+        for (ir_instr_t *i = bb->first; i != stop; i = i->next) {
+            switch (i->op) {
+            case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+            case IR_SHL: case IR_SHR: case IR_AND: case IR_OR: case IR_XOR:
+            case IR_CMPEQ: case IR_CMPNE: case IR_CMPLT:
+            case IR_CMPGT: case IR_CMPLE: case IR_CMPGE:
+            case IR_LOGAND: case IR_LOGOR:
+            case IR_CAST: case IR_LOAD:
+                break;
+            default:
+                continue;
+            }
+            lattice_t l = value_of(st, i->dest);
+            if (l.kind != LAT_CONST || !fits_target(st, l.value))
+                continue;
+            i->op = IR_CONST;
+            i->imm = l.value;
+            i->src1 = i->src2 = 0;
+            i->name = NULL;
+        }
     }
 }
 
-/* Top level constant propagation pass */
 /*
- * Step 1: initialize constant tracking tables
- * Step 2: process store/load instructions
- * Step 3: free tracking tables
+ * Fold the branches on known conditions and unlink the blocks that never
+ * became executable.  Returns 1 when the instruction ranges changed.
  */
-void propagate_load_consts(ir_builder_t *ir)
+static int prune_blocks(sccp_t *st)
 {
-    if (!ir)
-        return;
+    ir_builder_t *ir = st->ir;
+    ir_function_t *fn = st->fn;
+    int changed = 0;
+    ir_instr_t *keep = fn->begin;
+    for (size_t b = 0; b < fn->block_count; b++) {
+        ir_block_t *bb = &fn->blocks[b];
+        ir_instr_t *last = bb->last;
+        ir_instr_t *stop = last->next;
+        if (!st->exec[b]) {
+            if (ir->tail == last)
+                ir->tail = keep;
+            for (ir_instr_t *i = bb->first; i != stop;) {
+                ir_instr_t *next = i->next;
+                ir_release_instr(ir, i);
+                i = next;
+            }
+            keep->next = stop;
+            changed = 1;
+            continue;
+        }
+        lattice_t cond = last->op == IR_BCOND ? value_of(st, last->src1)
+                                              : lat_bottom;
+        if (cond.kind == LAT_CONST && cond.value == 0) {
+            /* always taken */
+            last->op = IR_BR;
+            last->src1 = 0;
+        } else if (cond.kind == LAT_CONST) {
+            /* never taken, fall through */
+            ir_instr_t *p = keep;
+            while (p->next != last)
+                p = p->next;
+            p->next = stop;
+            if (ir->tail == last)
+                ir->tail = p;
+            ir_release_instr(ir, last);
+            keep = p;
+            changed = 1;
+            continue;
+        }
+        keep = last;
+    }
+    return changed;
+}
 
-    const_track_t ct;
-    if (!init_const_tracking(&ct, ir))
-        return;
+/* Run the analysis on one function and apply its results */
+static int sccp_function(sccp_t *st)
+{
+    ir_function_t *fn = st->fn;
+    if (!fn->block_count)
+        return 1;
+    if (!ir_cfg_dominators(fn) || !collect_vars(st))
+        return 0;
+    st->exec = calloc(fn->block_count, 1);
+    st->edges = calloc(fn->block_count, 1);
+    if (!st->exec || !st->edges)
+        return 0;
 
-    process_instructions(ir, &ct);
+    st->exec[0] = 1;
+    do {
+        st->changed = 0;
+        for (size_t r = 0; r < fn->rpo_count; r++)
+            if (st->exec[fn->rpo[r]])
+                eval_block(st, fn->rpo[r]);
+    } while (st->changed);
 
-    free_const_tracking(&ct);
+    rewrite_values(st);
+    /* phis name their incoming edges, leave promoted bodies to DCE */
+    if (fn->begin->src1 & IR_FUNC_PROMOTED)
+        return 1;
+    if (prune_blocks(st))
+        return ir_cfg_rebuild_function(fn);
+    return 1;
 }
 
+/* Release the per-function state of ST */
+static void reset_function(sccp_t *st)
+{
+    free(st->escapes);
+    free(st->init);
+    free(st->out);
+    free(st->cur);
+    free(st->exec);
+    free(st->edges);
+    st->escapes = NULL;
+    st->init = NULL;
+    st->out = st->cur = NULL;
+    st->exec = st->edges = NULL;
+    st->nvars = 0;
+}
+
+void opt_sccp(ir_builder_t *ir, ir_cfg_t *cfg, const opt_config_t *opts)
+{
+    if (!ir || !cfg)
+        return;
+    sccp_t st;
+    memset(&st, 0, sizeof(st));
+    st.ir = ir;
+    st.x86_64 = opts ? opts->x86_64 : 0;
+    st.max_id = ir->next_value_id;
+    /* every value starts out unknown */
+    st.vals = calloc(st.max_id ? st.max_id : 1, sizeof(*st.vals));
+    if (!st.vals || !collect_globals(&st)) {
+        opt_error("out of memory");
+        free(st.vals);
+        free(st.globals);
+        return;
+    }
+    for (size_t f = 0; f < cfg->func_count; f++) {
+        st.fn = &cfg->funcs[f];
+        int ok = sccp_function(&st);
+        reset_function(&st);
+        if (!ok) {
+            opt_error("out of memory");
+            break;
+        }
+    }
+    free(st.vars);
+    free(st.globals);
+    free(st.vals);
+}
@@ -1,22 +1,24 @@
 /*
- * Common subexpression elimination pass.
+ * Common subexpression elimination by value numbering.
+ *
+ * Pure expressions are hash-consed on their opcode, operands, immediate
+ * and type while walking the dominator tree of each function.  Constants
+ * take part as well, so equal constants share one value and so do the
+ * address computations built from them.  A table
+ * entry stays visible in the blocks dominated by its definition and is
+ * withdrawn when the walk leaves that subtree, so a value is only reused
+ * where it is guaranteed to have been computed.  Redundant instructions
+ * are redirected through a replacement map and left for dead code
+ * elimination.
  *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
  */
 
 #include <stdlib.h>
+#include <stdint.h>
 #include "opt.h"
 
-typedef struct expr_entry {
-    ir_op_t op;
-    int src1;
-    int src2;
-    long long imm;
-    int dest;
-    struct expr_entry *next;
-} expr_entry_t;
-
 static int is_commutative(ir_op_t op)
 {
     switch (op) {
@@ -33,6 +35,7 @@ static int is_commutative(ir_op_t op)
 static int is_pure_op(ir_op_t op)
 {
     switch (op) {
+    case IR_CONST:
     case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
     case IR_SHL: case IR_SHR: case IR_AND: case IR_OR: case IR_XOR:
     case IR_FADD: case IR_FSUB: case IR_FMUL: case IR_FDIV:
@@ -47,57 +50,172 @@ static int is_pure_op(ir_op_t op)
     }
 }
 
-void common_subexpr_elim(ir_builder_t *ir)
+/* Scoped hash table of the expressions available in the current block */
+typedef struct {
+    ir_instr_t **slots;     /* open addressed, NULL when empty */
+    size_t cap;             /* power of two */
+    size_t *undo;           /* slots filled, in insertion order, cap entries */
+    size_t undo_len;
+    int *repl;              /* value id -> value computing the same */
+    size_t max_id;
+} vn_table_t;
+
+/* Return the operands of INS in canonical order */
+static void key_operands(const ir_instr_t *ins, int *a, int *b)
 {
-    if (!ir)
-        return;
+    *a = ins->src1;
+    *b = ins->src2;
+    if (is_commutative(ins->op) && *a > *b) {
+        int t = *a;
+        *a = *b;
+        *b = t;
+    }
+}
 
-    expr_entry_t *list = NULL;
+static size_t expr_hash(const ir_instr_t *ins)
+{
+    int a, b;
+    key_operands(ins, &a, &b);
+    uint64_t h = (uint64_t)ins->op * 0x9e3779b97f4a7c15u;
+    h ^= (uint64_t)(unsigned)a + 0x7f4a7c15u + (h << 6) + (h >> 2);
+    h ^= (uint64_t)(unsigned)b + 0x7f4a7c15u + (h << 6) + (h >> 2);
+    h ^= (uint64_t)ins->imm + 0x7f4a7c15u + (h << 6) + (h >> 2);
+    h ^= (uint64_t)ins->type + (h << 6) + (h >> 2);
+    return (size_t)(h ^ (h >> 29));
+}
 
-    for (ir_instr_t *ins = ir->head; ins; ins = ins->next) {
-        if (!is_pure_op(ins->op))
-            continue;
+static int same_expr(const ir_instr_t *x, const ir_instr_t *y)
+{
+    int xa, xb, ya, yb;
+    key_operands(x, &xa, &xb);
+    key_operands(y, &ya, &yb);
+    return x->op == y->op && xa == ya && xb == yb && x->imm == y->imm &&
+           x->type == y->type;
+}
 
-        int a = ins->src1;
-        int b = ins->src2;
-        if (is_commutative(ins->op) && a > b) {
-            int t = a; a = b; b = t;
+static int resolve(const vn_table_t *t, int v)
+{
+    if (v > 0 && (size_t)v < t->max_id && t->repl[v])
+        return t->repl[v];
+    return v;
+}
+
+/* Redirect the operands of INS, including phi arguments */
+static void resolve_operands(const vn_table_t *t, ir_instr_t *ins)
+{
+    ins->src1 = resolve(t, ins->src1);
+    ins->src2 = resolve(t, ins->src2);
+    if (ins->op == IR_PHI) {
+        ir_phi_arg_t *args = ir_phi_args(ins);
+        for (long long a = 0; a < ins->imm; a++)
+            args[a].value = resolve(t, args[a].value);
+    }
+}
+
+/* Number the instructions of block BB against the visible expressions */
+static void number_block(vn_table_t *t, const ir_block_t *bb)
+{
+    ir_instr_t *stop = bb->last->next;
+    for (ir_instr_t *ins = bb->first; ins != stop; ins = ins->next) {
+        if (!ir_has_value_operands(ins))
+            continue;
+        resolve_operands(t, ins);
+        if (!is_pure_op(ins->op) || ins->dest <= 0 ||
+            (size_t)ins->dest >= t->max_id)
+            continue;
+        size_t s = expr_hash(ins) & (t->cap - 1);
+        while (t->slots[s] && !same_expr(t->slots[s], ins))
+            s = (s + 1) & (t->cap - 1);
+        if (t->slots[s]) {
+            t->repl[ins->dest] = t->slots[s]->dest;
+        } else {
+            t->slots[s] = ins;
+            t->undo[t->undo_len++] = s;
         }
+    }
+}
 
-        expr_entry_t *e;
-        for (e = list; e; e = e->next) {
-            if (e->op == ins->op && e->src1 == a && e->src2 == b &&
-                e->imm == ins->imm) {
-                int old = e->dest;
-                for (ir_instr_t *u = ins->next; u; u = u->next) {
-                    if (u->src1 == ins->dest)
-                        u->src1 = old;
-                    if (u->src2 == ins->dest)
-                        u->src2 = old;
-                }
-                break;
+/*
+ * Walk the dominator tree of FN numbering every reachable block.  The
+ * table entries are removed in reverse insertion order, which keeps the
+ * probe sequences of the remaining entries intact.
+ */
+static int number_function(vn_table_t *t, ir_function_t *fn)
+{
+    size_t n = fn->block_count;
+    size_t *stack = malloc(n * sizeof(*stack));
+    size_t *next = malloc(n * sizeof(*next));
+    size_t *mark = malloc(n * sizeof(*mark));
+    int ok = stack && next && mark;
+    if (ok) {
+        size_t top = 0;
+        stack[top++] = 0;
+        next[0] = fn->dom_start[0];
+        mark[0] = t->undo_len;
+        number_block(t, &fn->blocks[0]);
+        while (top) {
+            size_t b = stack[top - 1];
+            if (next[b] < fn->dom_start[b + 1]) {
+                size_t c = fn->dom_child[next[b]++];
+                next[c] = fn->dom_start[c];
+                mark[c] = t->undo_len;
+                stack[top++] = c;
+                number_block(t, &fn->blocks[c]);
+                continue;
             }
+            while (t->undo_len > mark[b])
+                t->slots[t->undo[--t->undo_len]] = NULL;
+            top--;
         }
-        if (!e) {
-            e = malloc(sizeof(*e));
-            if (!e) {
-                opt_error("out of memory");
-                break;
-            }
-            e->op = ins->op;
-            e->src1 = a;
-            e->src2 = b;
-            e->imm = ins->imm;
-            e->dest = ins->dest;
-            e->next = list;
-            list = e;
+        /* uses outside the tree, e.g. in unreachable blocks */
+        for (ir_instr_t *ins = fn->begin->next; ins != fn->end;
+             ins = ins->next) {
+            if (ir_has_value_operands(ins))
+                resolve_operands(t, ins);
         }
     }
+    free(stack);
+    free(next);
+    free(mark);
+    return ok;
+}
 
-    while (list) {
-        expr_entry_t *n = list->next;
-        free(list);
-        list = n;
+void opt_value_number(ir_builder_t *ir, ir_cfg_t *cfg)
+{
+    if (!ir || !cfg)
+        return;
+
+    vn_table_t t = {0};
+    t.max_id = ir->next_value_id;
+    t.repl = calloc(t.max_id ? t.max_id : 1, sizeof(*t.repl));
+    if (!t.repl) {
+        opt_error("out of memory");
+        return;
     }
+    for (size_t f = 0; f < cfg->func_count; f++) {
+        ir_function_t *fn = &cfg->funcs[f];
+        if (!fn->block_count)
+            continue;
+        size_t count = 0;
+        for (ir_instr_t *ins = fn->begin->next; ins != fn->end; ins = ins->next)
+            count++;
+        size_t cap = 16;
+        while (cap < count * 2)
+            cap *= 2;
+        if (cap > t.cap) {
+            free(t.slots);
+            free(t.undo);
+            t.cap = cap;
+            t.slots = calloc(cap, sizeof(*t.slots));
+            t.undo = malloc(cap * sizeof(*t.undo));
+        }
+        if (!t.slots || !t.undo || !ir_cfg_dominators(fn) ||
+            !number_function(&t, fn)) {
+            opt_error("out of memory");
+            break;
+        }
+    }
+    free(t.slots);
+    free(t.undo);
+    free(t.repl);
 }
-
@@ -7,6 +7,7 @@
 
 #include <stdlib.h>
 #include "opt.h"
+#include "ir_defuse.h"
 
 /* Check whether an instruction produces a side effect */
 static int has_side_effect(ir_instr_t *ins)
@@ -39,67 +40,90 @@ static int has_side_effect(ir_instr_t *ins)
     case IR_LOAD_IDX:
     case IR_BFLOAD:
     case IR_LOAD_PTR:
-        return ins->is_volatile || ins->op == IR_LOAD_PTR;
+        return ins->is_volatile;
     default:
         return 0;
     }
 }
 
-/* Remove instructions whose results are unused */
+/* Mark VALUE dead when nothing reads it and its definition is pure */
+static void push_if_dead(ir_defuse_t *du, unsigned char *dead, int *work,
+                         size_t *top, size_t max_id, int value)
+{
+    if (value <= 0 || (size_t)value >= max_id || dead[value] ||
+        ir_defuse_use_count(du, value))
+        return;
+    ir_instr_t *def = ir_defuse_def(du, value);
+    if (!def || has_side_effect(def))
+        return;
+    dead[value] = 1;
+    work[(*top)++] = value;
+}
+
+/*
+ * Remove instructions whose results are unused.  Values without uses
+ * seed a worklist; retiring a definition drops the uses of its operands,
+ * which may in turn leave them without readers.
+ */
 void dead_code_elim(ir_builder_t *ir)
 {
     if (!ir)
         return;
 
     size_t max_id = ir->next_value_id;
-    int count = 0;
-    for (ir_instr_t *i = ir->head; i; i = i->next)
-        count++;
-
-    ir_instr_t **list = malloc((size_t)count * sizeof(*list));
-    if (!list) {
+    ir_defuse_t du;
+    if (!ir_defuse_init(&du, ir)) {
         opt_error("out of memory");
         return;
     }
-
-    int idx = 0;
-    for (ir_instr_t *i = ir->head; i; i = i->next)
-        list[idx++] = i;
-
-    int *used = calloc(max_id, sizeof(int));
-    if (!used) {
+    unsigned char *dead = calloc(max_id ? max_id : 1, 1);
+    int *work = malloc((max_id ? max_id : 1) * sizeof(*work));
+    if (!dead || !work) {
         opt_error("out of memory");
-        free(list);
+        free(dead);
+        free(work);
+        ir_defuse_free(&du);
         return;
     }
 
-    for (int i = count - 1; i >= 0; i--) {
-        ir_instr_t *ins = list[i];
-        int dest = ins->dest;
-        int side = has_side_effect(ins);
-
-        if (dest >= 0 && !side && !used[dest]) {
-            if (i == 0)
-                ir->head = ins->next;
-            else
-                list[i - 1]->next = ins->next;
-
-            if (ins == ir->tail)
-                ir->tail = (i == 0) ? NULL : list[i - 1];
+    size_t top = 0;
+    for (ir_instr_t *i = ir->head; i; i = i->next)
+        push_if_dead(&du, dead, work, &top, max_id, i->dest);
 
-            free(ins->name);
-            free(ins->data);
-            free(ins);
+    while (top) {
+        ir_instr_t *def = ir_defuse_def(&du, work[--top]);
+        ir_defuse_forget(&du, def);
+        if (!ir_has_value_operands(def))
             continue;
+        if (def->op == IR_PHI) {
+            /* phi arguments may be defined after the phi on a back edge */
+            ir_phi_arg_t *args = ir_phi_args(def);
+            for (long long a = 0; a < def->imm; a++)
+                push_if_dead(&du, dead, work, &top, max_id, args[a].value);
         }
+        push_if_dead(&du, dead, work, &top, max_id, def->src1);
+        push_if_dead(&du, dead, work, &top, max_id, def->src2);
+    }
+    ir_defuse_free(&du);
 
-        if (ins->src1 >= 0 && (size_t)ins->src1 < max_id)
-            used[ins->src1] = 1;
-        if (ins->src2 >= 0 && (size_t)ins->src2 < max_id)
-            used[ins->src2] = 1;
+    ir_instr_t *prev = NULL;
+    ir_instr_t *ins = ir->head;
+    while (ins) {
+        ir_instr_t *next = ins->next;
+        if (ins->dest > 0 && dead[ins->dest] && !has_side_effect(ins)) {
+            if (prev)
+                prev->next = next;
+            else
+                ir->head = next;
+            if (ins == ir->tail)
+                ir->tail = prev;
+            ir_release_instr(ir, ins);
+        } else {
+            prev = ins;
+        }
+        ins = next;
     }
 
-    free(used);
-    free(list);
+    free(work);
+    free(dead);
 }
-
@@ -1,6 +1,10 @@
 /*
  * Constant folding optimization pass.
  *
+ * Integer operations are evaluated in 64 bits and the result is truncated
+ * to the width of the instruction type, so folding matches the
+ * arithmetic the generated code performs.
+ *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
  */
@@ -10,30 +14,117 @@
 #include <stdint.h>
 #include "opt.h"
 
-/* Evaluate a binary integer op for constant folding */
-static int eval_int_op(ir_op_t op, int a, int b)
+int opt_int_width(type_kind_t type, int x86_64)
+{
+    switch (type) {
+    case TYPE_BOOL:
+        return 1;
+    case TYPE_CHAR: case TYPE_UCHAR:
+        return 8;
+    case TYPE_SHORT: case TYPE_USHORT:
+        return 16;
+    case TYPE_INT: case TYPE_UINT: case TYPE_ENUM:
+        return 32;
+    case TYPE_LONG: case TYPE_ULONG: case TYPE_PTR:
+        return x86_64 ? 64 : 32;
+    case TYPE_LLONG: case TYPE_ULLONG:
+        return 64;
+    default:
+        return 0;
+    }
+}
+
+/* Return 1 for integer types compared and divided without sign */
+static int is_unsigned_int(type_kind_t type)
+{
+    switch (type) {
+    case TYPE_UINT: case TYPE_UCHAR: case TYPE_USHORT: case TYPE_ULONG:
+    case TYPE_ULLONG: case TYPE_BOOL: case TYPE_PTR:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+long long opt_int_normalize(type_kind_t type, long long value, int x86_64)
 {
+    int w = opt_int_width(type, x86_64);
+    if (type == TYPE_BOOL)
+        return value != 0;
+    if (w == 0 || w >= 64)
+        return value;
+    unsigned long long mask = (1ULL << w) - 1;
+    unsigned long long u = (unsigned long long)value & mask;
+    if (!is_unsigned_int(type) && (u >> (w - 1)) & 1)
+        u |= ~mask;
+    return (long long)u;
+}
+
+int opt_eval_int(ir_op_t op, type_kind_t type, long long a, long long b,
+                 int x86_64, long long *out)
+{
+    int w = opt_int_width(type, x86_64);
+    if (!w)
+        return 0;
+    int uns = is_unsigned_int(type);
+    a = opt_int_normalize(type, a, x86_64);
+    b = opt_int_normalize(type, b, x86_64);
+    unsigned long long ua = (unsigned long long)a;
+    unsigned long long ub = (unsigned long long)b;
+    long long min = w >= 64 ? INT64_MIN : -(1LL << (w - 1));
+    long long r;
+
     switch (op) {
-    case IR_ADD: return a + b;
-    case IR_SUB: return a - b;
-    case IR_MUL: return a * b;
-    case IR_DIV: return b != 0 ? a / b : 0;
-    case IR_MOD: return b != 0 ? a % b : 0;
-    case IR_SHL: return a << b;
-    case IR_SHR: return a >> b;
-    case IR_AND: return a & b;
-    case IR_OR:  return a | b;
-    case IR_XOR: return a ^ b;
-    case IR_CMPEQ: return a == b;
-    case IR_CMPNE: return a != b;
-    case IR_CMPLT: return a < b;
-    case IR_CMPGT: return a > b;
-    case IR_CMPLE: return a <= b;
-    case IR_CMPGE: return a >= b;
-    case IR_LOGAND: return (a && b);
-    case IR_LOGOR:  return (a || b);
-    default: return 0;
+    case IR_ADD: r = (long long)(ua + ub); break;
+    case IR_SUB: r = (long long)(ua - ub); break;
+    case IR_MUL: r = (long long)(ua * ub); break;
+    case IR_DIV:
+    case IR_MOD:
+        /* leave traps and undefined results to run time */
+        if (b == 0 || (!uns && a == min && b == -1))
+            return 0;
+        if (op == IR_DIV)
+            r = uns ? (long long)(ua / ub) : a / b;
+        else
+            r = uns ? (long long)(ua % ub) : a % b;
+        break;
+    case IR_SHL:
+    case IR_SHR:
+        if (b < 0 || b >= w)
+            return 0;
+        if (op == IR_SHL)
+            r = (long long)(ua << b);
+        else
+            r = uns ? (long long)(ua >> b) : a >> b;
+        break;
+    case IR_AND: r = a & b; break;
+    case IR_OR:  r = a | b; break;
+    case IR_XOR: r = a ^ b; break;
+    /* comparisons produce an int whatever the operand type */
+    case IR_CMPEQ: *out = a == b; return 1;
+    case IR_CMPNE: *out = a != b; return 1;
+    case IR_CMPLT: *out = uns ? ua < ub : a < b; return 1;
+    case IR_CMPGT: *out = uns ? ua > ub : a > b; return 1;
+    case IR_CMPLE: *out = uns ? ua <= ub : a <= b; return 1;
+    case IR_CMPGE: *out = uns ? ua >= ub : a >= b; return 1;
+    case IR_LOGAND: *out = a && b; return 1;
+    case IR_LOGOR:  *out = a || b; return 1;
+    default:
+        return 0;
     }
+    *out = opt_int_normalize(type, r, x86_64);
+    return 1;
+}
+
+int opt_eval_cast(long long imm, long long value, int x86_64, long long *out)
+{
+    type_kind_t src = (type_kind_t)(imm >> 32);
+    type_kind_t dst = (type_kind_t)(unsigned)(imm & 0xffffffffLL);
+    if (!opt_int_width(src, x86_64) || !opt_int_width(dst, x86_64))
+        return 0;
+    *out = opt_int_normalize(dst, opt_int_normalize(src, value, x86_64),
+                             x86_64);
+    return 1;
 }
 
 /* Evaluate a binary floating point op for constant folding */
@@ -80,233 +171,174 @@ static uint64_t eval_long_float_op(ir_op_t op, long double a, long double b)
     return out;
 }
 
-/* Evaluate pointer addition for constant folding */
-static int eval_ptr_add(int base, int idx, int esz)
+/* Constant tracking state of the folding pass */
+typedef struct {
+    size_t max_id;
+    int *is_const;
+    long long *values;
+    int x86_64;
+} fold_t;
+
+/* Update destination entry in constant tracking tables */
+static void update_const(fold_t *f, ir_instr_t *ins, long long val, int cst)
 {
-    return base + idx * esz;
+    if (ins->dest >= 0 && (size_t)ins->dest < f->max_id) {
+        f->is_const[ins->dest] = cst;
+        if (cst)
+            f->values[ins->dest] = val;
+    }
 }
 
-/* Evaluate pointer difference for constant folding */
-static int eval_ptr_diff(int a, int b, int esz)
+/* Return 1 when value V is a known constant */
+static int known(const fold_t *f, int v)
 {
-    return esz ? (a - b) / esz : 0;
+    return v >= 0 && (size_t)v < f->max_id && f->is_const[v];
 }
 
-/* Update destination entry in constant tracking tables */
-static void update_const(ir_instr_t *ins, int val, int cst,
-                         size_t max_id, int *is_const, int *values)
+/* Turn INS into an IR_CONST of VAL */
+static void make_const(fold_t *f, ir_instr_t *ins, long long val)
 {
-    if (ins->dest >= 0 && (size_t)ins->dest < max_id) {
-        is_const[ins->dest] = cst;
-        if (cst)
-            values[ins->dest] = val;
-    }
+    ins->op = IR_CONST;
+    ins->imm = val;
+    ins->src1 = ins->src2 = 0;
+    update_const(f, ins, val, 1);
 }
 
 /* Try folding an integer binary operation */
-static void fold_int_instr(ir_instr_t *ins, size_t max_id,
-                           int *is_const, int *values)
+static void fold_int_instr(fold_t *f, ir_instr_t *ins)
 {
-    if ((size_t)ins->src1 < max_id && (size_t)ins->src2 < max_id &&
-        is_const[ins->src1] && is_const[ins->src2]) {
-        int a = values[ins->src1];
-        int b = values[ins->src2];
-        int result = eval_int_op(ins->op, a, b);
-        ins->op = IR_CONST;
-        ins->imm = (long long)result;
-        ins->src1 = ins->src2 = 0;
-        update_const(ins, result, 1, max_id, is_const, values);
-    } else {
-        update_const(ins, 0, 0, max_id, is_const, values);
-    }
+    long long result;
+    if (known(f, ins->src1) && known(f, ins->src2) &&
+        opt_eval_int(ins->op, ins->type, f->values[ins->src1],
+                     f->values[ins->src2], f->x86_64, &result))
+        make_const(f, ins, result);
+    else
+        update_const(f, ins, 0, 0);
 }
 
 /* Try folding a floating point binary operation */
-static void fold_float_instr(ir_instr_t *ins, size_t max_id,
-                             int *is_const, int *values)
+static void fold_float_instr(fold_t *f, ir_instr_t *ins)
 {
-    if ((size_t)ins->src1 < max_id && (size_t)ins->src2 < max_id &&
-        is_const[ins->src1] && is_const[ins->src2]) {
-        int a = values[ins->src1];
-        int b = values[ins->src2];
-        int result = eval_float_op(ins->op, a, b);
-        ins->op = IR_CONST;
-        ins->imm = (long long)result;
-        ins->src1 = ins->src2 = 0;
-        update_const(ins, result, 1, max_id, is_const, values);
-    } else {
-        update_const(ins, 0, 0, max_id, is_const, values);
-    }
+    if (known(f, ins->src1) && known(f, ins->src2))
+        make_const(f, ins, eval_float_op(ins->op, (int)f->values[ins->src1],
+                                         (int)f->values[ins->src2]));
+    else
+        update_const(f, ins, 0, 0);
 }
 
 /* Try folding a long double binary operation */
-static void fold_long_float_instr(ir_instr_t *ins, size_t max_id,
-                                  int *is_const, int *values)
+static void fold_long_float_instr(fold_t *f, ir_instr_t *ins)
 {
-    if (sizeof(long double) > sizeof(int)) {
-        update_const(ins, 0, 0, max_id, is_const, values);
+    if (sizeof(long double) > sizeof(long long)) {
+        update_const(f, ins, 0, 0);
         return;
     }
-    if ((size_t)ins->src1 < max_id && (size_t)ins->src2 < max_id &&
-        is_const[ins->src1] && is_const[ins->src2]) {
-        int ia = values[ins->src1];
-        int ib = values[ins->src2];
+    if (known(f, ins->src1) && known(f, ins->src2)) {
+        long long ia = f->values[ins->src1];
+        long long ib = f->values[ins->src2];
         long double a = 0.0L;
         long double b = 0.0L;
         memcpy(&a, &ia, sizeof(a));
         memcpy(&b, &ib, sizeof(b));
-        uint64_t result = eval_long_float_op(ins->op, a, b);
-        ins->op = IR_CONST;
-        ins->imm = (long long)result;
-        ins->src1 = ins->src2 = 0;
-        update_const(ins, (int)result, 1, max_id, is_const, values);
+        make_const(f, ins, (long long)eval_long_float_op(ins->op, a, b));
     } else {
-        update_const(ins, 0, 0, max_id, is_const, values);
+        update_const(f, ins, 0, 0);
     }
 }
 
-/* Try folding a cast operation */
-static void fold_cast_instr(ir_instr_t *ins, size_t max_id,
-                            int *is_const, int *values)
+/* Try folding a conversion between integer types */
+static void fold_cast_instr(fold_t *f, ir_instr_t *ins)
 {
-    if ((size_t)ins->src1 < max_id && is_const[ins->src1]) {
-        int val = values[ins->src1];
-        ins->op = IR_CONST;
-        ins->imm = val;
-        ins->src1 = ins->src2 = 0;
-        update_const(ins, val, 1, max_id, is_const, values);
-    } else {
-        update_const(ins, 0, 0, max_id, is_const, values);
-    }
+    long long result;
+    if (known(f, ins->src1) &&
+        opt_eval_cast(ins->imm, f->values[ins->src1], f->x86_64, &result))
+        make_const(f, ins, result);
+    else
+        update_const(f, ins, 0, 0);
 }
 
 /* Try folding pointer addition */
-static void fold_ptr_add_instr(ir_instr_t *ins, size_t max_id,
-                               int *is_const, int *values)
+static void fold_ptr_add_instr(fold_t *f, ir_instr_t *ins)
 {
-    if ((size_t)ins->src1 < max_id && (size_t)ins->src2 < max_id &&
-        is_const[ins->src1] && is_const[ins->src2]) {
-        int base = values[ins->src1];
-        int idx = values[ins->src2];
-        int result = eval_ptr_add(base, idx, (int)ins->imm);
-        ins->op = IR_CONST;
-        ins->imm = result;
-        ins->src1 = ins->src2 = 0;
-        update_const(ins, result, 1, max_id, is_const, values);
+    if (known(f, ins->src1) && known(f, ins->src2)) {
+        unsigned long long base = (unsigned long long)f->values[ins->src1];
+        unsigned long long idx = (unsigned long long)f->values[ins->src2];
+        make_const(f, ins, opt_int_normalize(TYPE_PTR,
+                       (long long)(base + idx * (unsigned long long)ins->imm),
+                       f->x86_64));
     } else {
-        update_const(ins, 0, 0, max_id, is_const, values);
+        update_const(f, ins, 0, 0);
     }
 }
 
 /* Try folding pointer difference */
-static void fold_ptr_diff_instr(ir_instr_t *ins, size_t max_id,
-                                int *is_const, int *values)
+static void fold_ptr_diff_instr(fold_t *f, ir_instr_t *ins)
 {
-    if ((size_t)ins->src1 < max_id && (size_t)ins->src2 < max_id &&
-        is_const[ins->src1] && is_const[ins->src2]) {
-        int a = values[ins->src1];
-        int b = values[ins->src2];
-        int result = eval_ptr_diff(a, b, (int)ins->imm);
-        ins->op = IR_CONST;
-        ins->imm = result;
-        ins->src1 = ins->src2 = 0;
-        update_const(ins, result, 1, max_id, is_const, values);
+    if (known(f, ins->src1) && known(f, ins->src2) && ins->imm > 0) {
+        long long diff = (long long)((unsigned long long)f->values[ins->src1] -
+                                     (unsigned long long)f->values[ins->src2]);
+        make_const(f, ins, opt_int_normalize(TYPE_LONG, diff / ins->imm,
+                                             f->x86_64));
     } else {
-        update_const(ins, 0, 0, max_id, is_const, values);
+        update_const(f, ins, 0, 0);
     }
 }
 
 /* Perform simple constant folding */
-void fold_constants(ir_builder_t *ir)
+void fold_constants(ir_builder_t *ir, const opt_config_t *cfg)
 {
     if (!ir)
         return;
-    size_t max_id = ir->next_value_id;
-    int *is_const = calloc(max_id, sizeof(int));
-    int *values = calloc(max_id, sizeof(int));
-    if (!is_const || !values) {
+    fold_t f;
+    f.max_id = ir->next_value_id;
+    f.is_const = calloc(f.max_id, sizeof(int));
+    f.values = calloc(f.max_id, sizeof(long long));
+    f.x86_64 = cfg ? cfg->x86_64 : 0;
+    if (!f.is_const || !f.values) {
         opt_error("out of memory");
-        free(is_const);
-        free(values);
+        free(f.is_const);
+        free(f.values);
         return;
     }
 
     for (ir_instr_t *ins = ir->head; ins; ins = ins->next) {
         switch (ins->op) {
         case IR_CONST:
-            update_const(ins, (int)ins->imm, 1, max_id, is_const, values);
+            update_const(&f, ins, ins->imm, 1);
             break;
         case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
         case IR_SHL: case IR_SHR: case IR_AND: case IR_OR: case IR_XOR:
         case IR_CMPEQ: case IR_CMPNE: case IR_CMPLT:
         case IR_CMPGT: case IR_CMPLE: case IR_CMPGE:
         case IR_LOGAND: case IR_LOGOR:
-            fold_int_instr(ins, max_id, is_const, values);
+            fold_int_instr(&f, ins);
             break;
         case IR_CAST:
-            fold_cast_instr(ins, max_id, is_const, values);
+            fold_cast_instr(&f, ins);
             break;
         case IR_FADD: case IR_FSUB: case IR_FMUL: case IR_FDIV:
-            fold_float_instr(ins, max_id, is_const, values);
+            fold_float_instr(&f, ins);
             break;
         case IR_LFADD: case IR_LFSUB: case IR_LFMUL: case IR_LFDIV:
-            fold_long_float_instr(ins, max_id, is_const, values);
-            break;
-        case IR_CPLX_CONST:
-        case IR_CPLX_ADD: case IR_CPLX_SUB:
-        case IR_CPLX_MUL: case IR_CPLX_DIV:
-            update_const(ins, 0, 0, max_id, is_const, values);
-            break;
-        case IR_LOAD:
-        case IR_LOAD_IDX:
-        case IR_BFLOAD:
-            update_const(ins, 0, 0, max_id, is_const, values);
-            break;
-        case IR_STORE:
-        case IR_LOAD_PARAM:
-        case IR_STORE_IDX:
-        case IR_BFSTORE:
-            update_const(ins, 0, 0, max_id, is_const, values);
-            break;
-        case IR_STORE_PARAM:
-        case IR_ADDR:
-        case IR_LOAD_PTR:
-        case IR_STORE_PTR:
-            update_const(ins, 0, 0, max_id, is_const, values);
+            fold_long_float_instr(&f, ins);
             break;
         case IR_PTR_ADD:
-            fold_ptr_add_instr(ins, max_id, is_const, values);
+            fold_ptr_add_instr(&f, ins);
             break;
         case IR_PTR_DIFF:
-            fold_ptr_diff_instr(ins, max_id, is_const, values);
-            break;
-        case IR_ALLOCA:
-            update_const(ins, 0, 0, max_id, is_const, values);
+            fold_ptr_diff_instr(&f, ins);
             break;
         case IR_RETURN:
         case IR_RETURN_AGG:
+        case IR_BCOND: case IR_LABEL: case IR_BR:
             /* nothing to do */
             break;
-        case IR_GLOB_STRING:
-        case IR_GLOB_WSTRING:
-        case IR_GLOB_VAR:
-        case IR_GLOB_ARRAY:
-        case IR_GLOB_UNION:
-        case IR_GLOB_STRUCT:
-        case IR_GLOB_ADDR:
-            update_const(ins, 0, 0, max_id, is_const, values);
-            break;
-        case IR_CALL: case IR_CALL_PTR:
-        case IR_CALL_NR: case IR_CALL_PTR_NR:
-        case IR_FUNC_BEGIN: case IR_FUNC_END: case IR_ARG:
-            update_const(ins, 0, 0, max_id, is_const, values);
-            break;
-        case IR_BCOND: case IR_LABEL: case IR_BR:
+        default:
+            update_const(&f, ins, 0, 0);
             break;
         }
     }
 
-    free(is_const);
-    free(values);
+    free(f.is_const);
+    free(f.values);
 }
-
@@ -1,235 +1,619 @@
 /*
- * Simple function inlining pass.
+ * Function inlining pass.
  *
- * Replaces calls to small functions with short bodies.  Functions
- * consisting of two parameter loads and a single arithmetic operation
- * are currently inlined directly into the call site.
+ * The functions of the translation unit form a call graph whose strongly
+ * connected components are visited bottom-up, so every callee has
+ * received its own inlined calls before it is copied into a caller and
+ * recursive cycles are never expanded.  A call is replaced by the callee
+ * body when its estimated cost, the body size minus the call overhead
+ * and the loads of parameters bound to constants, stays under a limit
+ * that depends on the `inline` and `static` specifiers, and the caller
+ * has not yet used up its growth budget.
+ *
+ * Callee labels are renamed, stack locals are moved past the caller's
+ * frame and returns become branches to a label after the copy with the
+ * result passed through a fresh stack slot.  A body ending in its only
+ * return passes the value directly.
  *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
  */
 
-#define _POSIX_C_SOURCE 200809L
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <errno.h>
-#include <sys/types.h>
-#include <ctype.h>
-#include <limits.h>
 #include <stdint.h>
 #include "opt.h"
-#include "error.h"
-#include "util.h"
+#include "ir_builder.h"
+#include "ir_defuse.h"
+#include "intern.h"
+#include "label.h"
 #include "opt_inline_helpers.h"
 
+/* Instructions saved besides the arguments: call, prologue and epilogue */
+#define INLINE_CALL_COST 4
+/* Cost limits for callees at -O2, with internal linkage and marked inline */
+#define INLINE_LIMIT 12
+#define INLINE_LIMIT_STATIC 24
+#define INLINE_LIMIT_HINT 48
+/* A caller may grow by its own size but at least by this much */
+#define INLINE_GROWTH_MIN 64
+
+typedef struct {
+    const char *name;
+    size_t func;
+} name_ent_t;
+
+typedef struct {
+    ir_builder_t *ir;
+    ir_defuse_t *du;
+    const opt_config_t *cfg;
+    inline_func_t *funcs;
+    size_t count;
+    name_ent_t *by_name; /* functions sorted by name pointer */
+    size_t *edge_start; /* call graph in compressed rows */
+    size_t *edges;
+    int *scc;           /* component of every function */
+    int *index;         /* Tarjan state */
+    int *low;
+    size_t *stack;
+    size_t sp;
+    char *on_stack;
+    int next_index;
+    int next_scc;
+    size_t *order;      /* functions in bottom-up component order */
+    size_t ordered;
+} inliner_t;
+
+typedef struct {
+    const char *old_name;
+    const char *new_name;
+} label_map_t;
 
-/* Remove instruction at list[index] from both array and linked list */
-static void remove_instr(ir_builder_t *ir, ir_instr_t **list, int *count, int index)
+static int cmp_name(const void *a, const void *b)
 {
-    ir_instr_t *prev = (index > 0) ? list[index - 1] : NULL;
-    ir_instr_t *ins = list[index];
-    ir_instr_t *next = ins->next;
-    if (prev)
-        prev->next = next;
-    else
-        ir->head = next;
-    if (ins == ir->tail)
-        ir->tail = prev;
-    free(ins->name);
-    free(ins->data);
-    free(ins);
-    for (int i = index; i < *count - 1; i++)
-        list[i] = list[i + 1];
-    (*count)--;
+    uintptr_t x = (uintptr_t)((const name_ent_t *)a)->name;
+    uintptr_t y = (uintptr_t)((const name_ent_t *)b)->name;
+    return (x > y) - (x < y);
 }
 
-/* Recompute tail pointer after all changes */
-static void recompute_tail(ir_builder_t *ir)
+/* Return the index of the function called NAME or -1 */
+static long find_func(const inliner_t *in, const char *name)
 {
-    ir_instr_t *t = ir->head;
-    if (!t) { ir->tail = NULL; return; }
-    while (t->next) t = t->next;
-    ir->tail = t;
+    size_t lo = 0, hi = in->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        const char *n = in->by_name[mid].name;
+        if (n == name)
+            return (long)in->by_name[mid].func;
+        if ((uintptr_t)n < (uintptr_t)name)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
 }
 
-typedef struct {
-    int old_id;
-    int new_id;
-    ir_instr_t *ins;
-} map_entry_t;
+static int is_direct_call(const ir_instr_t *ins)
+{
+    return ins->op == IR_CALL || ins->op == IR_CALL_NR;
+}
 
-static int gather_call_args(ir_instr_t **list, int idx, int argc, int *args)
+/* Record the direct calls between the collected functions */
+static int build_call_graph(inliner_t *in)
 {
-    for (int a = 0; a < argc; a++) {
-        ir_instr_t *arg = list[idx - argc + a];
-        if (!arg || arg->op != IR_ARG)
-            return 0;
-        args[a] = arg->src1;
+    size_t n = in->count, total = 0;
+    in->edge_start = calloc(n + 1, sizeof(*in->edge_start));
+    if (!in->edge_start)
+        return 0;
+    for (size_t f = 0; f < n; f++) {
+        in->edge_start[f] = total;
+        for (ir_instr_t *it = in->funcs[f].begin; it != in->funcs[f].end;
+             it = it->next)
+            if (is_direct_call(it) && find_func(in, it->name) >= 0)
+                total++;
     }
+    in->edge_start[n] = total;
+    in->edges = malloc((total ? total : 1) * sizeof(*in->edges));
+    if (!in->edges)
+        return 0;
+    size_t e = 0;
+    for (size_t f = 0; f < n; f++)
+        for (ir_instr_t *it = in->funcs[f].begin; it != in->funcs[f].end;
+             it = it->next) {
+            long callee = is_direct_call(it) ? find_func(in, it->name) : -1;
+            if (callee >= 0)
+                in->edges[e++] = (size_t)callee;
+        }
     return 1;
 }
 
-static void replace_value_uses(ir_instr_t **list, int start, int count,
-                              int old, int new)
+/* Tarjan's algorithm; components complete callees first */
+static void strong_connect(inliner_t *in, size_t v)
 {
-    for (int u = start; u < count; u++) {
-        if (list[u]->src1 == old)
-            list[u]->src1 = new;
-        if (list[u]->src2 == old)
-            list[u]->src2 = new;
+    in->index[v] = in->low[v] = in->next_index++;
+    in->stack[in->sp++] = v;
+    in->on_stack[v] = 1;
+    for (size_t e = in->edge_start[v]; e < in->edge_start[v + 1]; e++) {
+        size_t w = in->edges[e];
+        if (in->index[w] < 0) {
+            strong_connect(in, w);
+            if (in->low[w] < in->low[v])
+                in->low[v] = in->low[w];
+        } else if (in->on_stack[w] && in->index[w] < in->low[v]) {
+            in->low[v] = in->index[w];
+        }
     }
+    if (in->low[v] != in->index[v])
+        return;
+    size_t w;
+    do {
+        w = in->stack[--in->sp];
+        in->on_stack[w] = 0;
+        in->scc[w] = in->next_scc;
+        in->order[in->ordered++] = w;
+    } while (w != v);
+    in->next_scc++;
 }
 
-static int map_lookup(map_entry_t *map, size_t count, int old)
+static int order_components(inliner_t *in)
 {
-    for (size_t i = 0; i < count; i++)
-        if (map[i].old_id == old)
-            return map[i].new_id;
-    return old;
+    size_t n = in->count;
+    in->scc = malloc(n * sizeof(*in->scc));
+    in->index = malloc(n * sizeof(*in->index));
+    in->low = malloc(n * sizeof(*in->low));
+    in->stack = malloc(n * sizeof(*in->stack));
+    in->on_stack = calloc(n, 1);
+    in->order = malloc(n * sizeof(*in->order));
+    if (!in->scc || !in->index || !in->low || !in->stack ||
+        !in->on_stack || !in->order)
+        return 0;
+    for (size_t f = 0; f < n; f++)
+        in->index[f] = -1;
+    for (size_t f = 0; f < n; f++)
+        if (in->index[f] < 0)
+            strong_connect(in, f);
+    return 1;
 }
 
-static int insert_inline_body(ir_builder_t *ir, ir_instr_t *call,
-                              inline_func_t *fn, int argc, int *args,
-                              int *ret_val)
+/*
+ * An argument of type ARG may stand in for a parameter of type PARAM
+ * when both occupy the same register without conversion.
+ */
+static int arg_matches(type_kind_t arg, type_kind_t param)
 {
-    map_entry_t map[32];
-    size_t mcount = 0;
-    ir_instr_t *pos = call;
-    *ret_val = call->dest;
+    if (arg == param)
+        return 1;
+    switch (param) {
+    case TYPE_INT: case TYPE_UINT: case TYPE_ENUM:
+        return arg == TYPE_INT || arg == TYPE_UINT || arg == TYPE_ENUM ||
+               arg == TYPE_CHAR || arg == TYPE_UCHAR ||
+               arg == TYPE_SHORT || arg == TYPE_USHORT || arg == TYPE_BOOL;
+    case TYPE_LONG: case TYPE_ULONG: case TYPE_PTR:
+        return arg == TYPE_LONG || arg == TYPE_ULONG || arg == TYPE_PTR;
+    case TYPE_LLONG: case TYPE_ULLONG:
+        return arg == TYPE_LLONG || arg == TYPE_ULLONG;
+    default:
+        return 0;
+    }
+}
 
-    for (size_t k = 0; k < fn->count; k++) {
-        ir_instr_t *orig = &fn->body[k];
-        if (orig->op == IR_LOAD_PARAM) {
-            if (orig->imm >= argc)
-                return 0;
-            map[mcount++] = (map_entry_t){orig->dest, args[orig->imm], NULL};
-            continue;
-        }
-        if (orig->op == IR_RETURN || orig->op == IR_RETURN_AGG) {
-            *ret_val = map_lookup(map, mcount, orig->src1);
-            for (size_t m = 0; m < mcount; m++) {
-                if (map[m].old_id == orig->src1 && map[m].ins) {
-                    map[m].ins->dest = call->dest;
-                    map[m].new_id = call->dest;
-                    *ret_val = call->dest;
-                    break;
-                }
-            }
-            continue;
-        }
+/* The IR_ARG carrying parameter P of a call with ARGC arguments */
+static ir_instr_t *arg_for_param(const inliner_t *in, ir_instr_t **args,
+                                 int argc, int p)
+{
+    /* 32-bit calls push the last argument first */
+    return in->cfg->x86_64 ? args[p] : args[argc - 1 - p];
+}
+
+/* Cost limit for calls to FN, or -1 when it is not considered */
+static int cost_limit(const inliner_t *in, const inline_func_t *fn)
+{
+    int flags = (int)fn->begin->src1;
+    if (flags & IR_FUNC_INLINE)
+        return INLINE_LIMIT_HINT;
+    if (in->cfg->opt_level < 2)
+        return -1;
+    return (flags & IR_FUNC_STATIC) ? INLINE_LIMIT_STATIC : INLINE_LIMIT;
+}
+
+/* Decide whether CALL, with its arguments in ARGS, is worth expanding */
+static int should_inline(inliner_t *in, const inline_func_t *callee,
+                         ir_instr_t *call, ir_instr_t **args, int argc)
+{
+    if (!callee->inlinable || callee->param_count > argc)
+        return 0;
+    int limit = cost_limit(in, callee);
+    if (limit < 0)
+        return 0;
+    if (ir_defuse_use_count(in->du, call->dest) &&
+        (callee->void_return || !callee->returns))
+        return 0;
+    for (int a = 0; a < argc; a++) {
+        type_kind_t t = (type_kind_t)args[a]->imm;
+        if (t == TYPE_STRUCT || t == TYPE_UNION)
+            return 0;
+    }
 
-        ir_instr_t *ni = ir_insert_after(ir, pos);
-        if (!ni)
+    long cost = (long)callee->size - argc - INLINE_CALL_COST;
+    for (int p = 0; p < callee->param_count; p++) {
+        ir_instr_t *arg = arg_for_param(in, args, argc, p);
+        if (callee->param_type[p] != TYPE_UNKNOWN &&
+            !arg_matches((type_kind_t)arg->imm, callee->param_type[p]))
             return 0;
-        ni->op = orig->op;
-        ni->imm = orig->imm;
-        ni->src1 = map_lookup(map, mcount, orig->src1);
-        ni->src2 = map_lookup(map, mcount, orig->src2);
-        ni->name = NULL;
-        ni->data = NULL;
-        ni->is_volatile = 0;
-        ni->dest = (int)ir->next_value_id++;
-        map[mcount++] = (map_entry_t){orig->dest, ni->dest, ni};
-        pos = ni;
+        ir_instr_t *def = ir_defuse_def(in->du, arg->src1);
+        if (def && def->op == IR_CONST)
+            cost -= callee->param_loads[p];
     }
+    return cost <= limit;
+}
 
-    return 1;
+/* Bytes reserved for a spilled parameter or return value of type T */
+static long long slot_size(type_kind_t t)
+{
+    return t == TYPE_LDOUBLE ? 16 : 8;
 }
 
-/* Build an array containing all IR instructions in order */
-static ir_instr_t **gather_call_list(ir_builder_t *ir, int *count)
+/* Reserve a slot at the bottom of the frame of BEGIN and return its name */
+static const char *new_slot(ir_instr_t *begin, type_kind_t t)
 {
-    *count = 0;
-    for (ir_instr_t *it = ir->head; it; it = it->next)
-        (*count)++;
-    if (*count == 0)
+    long long off = (begin->imm + 7) / 8 * 8 + slot_size(t);
+    begin->imm = off;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "stack:%lld", off);
+    return intern_str(buf);
+}
+
+/* Rename a callee label for one expansion */
+static const char *map_label(label_map_t **map, size_t *count, size_t *cap,
+                             const char *name)
+{
+    for (size_t i = 0; i < *count; i++)
+        if ((*map)[i].old_name == name)
+            return (*map)[i].new_name;
+    if (*count == *cap) {
+        size_t n = *cap ? *cap * 2 : 8;
+        label_map_t *tmp = realloc(*map, n * sizeof(*tmp));
+        if (!tmp)
+            return NULL;
+        *map = tmp;
+        *cap = n;
+    }
+    char buf[32];
+    const char *fmt = label_format_suffix("L", label_next_id(), "_inl", buf);
+    if (!fmt)
         return NULL;
+    (*map)[*count].old_name = name;
+    (*map)[*count].new_name = intern_str(fmt);
+    return (*map)[(*count)++].new_name;
+}
 
-    ir_instr_t **list = malloc((size_t)(*count) * sizeof(*list));
-    if (!list) {
-        opt_error("out of memory");
+/* Insert a blank OP after *POS and make it the new position */
+static ir_instr_t *emit_after(ir_builder_t *ir, ir_instr_t **pos, ir_op_t op,
+                              const ir_instr_t *loc)
+{
+    ir_instr_t *ins = ir_insert_after(ir, *pos);
+    if (!ins)
         return NULL;
-    }
+    ins->op = op;
+    ins->src1 = ins->src2 = 0;
+    ins->imm = 0;
+    ins->type = TYPE_INT;
+    ins->file = loc->file;
+    ins->line = loc->line;
+    ins->column = loc->column;
+    *pos = ins;
+    return ins;
+}
 
-    int idx = 0;
-    for (ir_instr_t *it = ir->head; it; it = it->next)
-        list[idx++] = it;
+/* Emit a load of SLOT into VALUE or a store of VALUE to SLOT */
+static int emit_slot(ir_builder_t *ir, ir_instr_t **pos, const ir_instr_t *loc,
+                     ir_op_t op, const char *slot, type_kind_t t, int value)
+{
+    ir_instr_t *ins = emit_after(ir, pos, op, loc);
+    if (!ins)
+        return 0;
+    ins->type = t;
+    ins->name = slot;
+    ins->alias_set = get_alias(ir, slot);
+    if (op == IR_LOAD)
+        ins->dest = value;
+    else
+        ins->src1 = value;
+    return 1;
+}
 
-    return list;
+/* Translate a value of CALLEE into the copy */
+static int map_value(const inline_func_t *callee, const int *vmap, int v)
+{
+    if (v < callee->min_value || v > callee->max_value || v <= 0)
+        return v;
+    int m = vmap[v - callee->min_value];
+    return m ? m : v;
 }
 
-/* Inline a single call instruction if it matches an eligible function */
-static int inline_call(ir_builder_t *ir, ir_instr_t **list, int *count, int i,
-                       inline_func_t *funcs, size_t func_count)
+/*
+ * Copy the body of CALLEE after BEFORE in place of CALL, whose arguments
+ * have already been unlinked.  ARGV holds the argument value of every
+ * parameter.  Returns the last inserted instruction or NULL.
+ */
+static ir_instr_t *expand_call(inliner_t *in, inline_func_t *caller,
+                               const inline_func_t *callee, ir_instr_t *call,
+                               ir_instr_t *before, const int *argv)
 {
-    ir_instr_t *ins = list[i];
-    if (ins->op != IR_CALL)
-        return 0;
+    ir_builder_t *ir = in->ir;
+    int used = ir_defuse_use_count(in->du, call->dest) > 0;
+    int direct = callee->tail_return;
+    ir_instr_t *pos = before;
+
+    /* callee locals go below the caller's, keeping their alignment */
+    long long base = (caller->begin->imm + 15) / 16 * 16;
+    caller->begin->imm = base + callee->begin->imm;
+
+    const char *param_slot[INLINE_MAX_PARAMS] = {0};
+    for (int p = 0; p < callee->param_count; p++) {
+        if (!(callee->written & (1u << p)))
+            continue;
+        param_slot[p] = new_slot(caller->begin, callee->param_type[p]);
+        if (!emit_slot(ir, &pos, call, IR_STORE, param_slot[p],
+                       callee->param_type[p], argv[p]))
+            return NULL;
+    }
+    const char *ret_slot = (!direct && used)
+                           ? new_slot(caller->begin, callee->ret_type) : NULL;
+
+    size_t span = callee->max_value >= callee->min_value && callee->min_value
+                  ? (size_t)(callee->max_value - callee->min_value + 1) : 1;
+    int *vmap = calloc(span, sizeof(*vmap));
+    if (!vmap)
+        return NULL;
+
+    /* values may be read before their definition in list order */
+    for (ir_instr_t *it = callee->begin->next; it != callee->end; it = it->next) {
+        if (it->dest <= 0)
+            continue;
+        if (it->op == IR_LOAD_PARAM && !param_slot[it->imm])
+            vmap[it->dest - callee->min_value] = argv[it->imm];
+        else
+            vmap[it->dest - callee->min_value] = alloc_value_id(ir);
+    }
 
-    inline_func_t *fn = NULL;
-    for (size_t j = 0; j < func_count; j++) {
-        if (strcmp(funcs[j].name, ins->name) == 0) {
-            fn = &funcs[j];
+    label_map_t *labels = NULL;
+    size_t nlabels = 0, label_cap = 0;
+    const char *end_label = NULL;
+    int result = 0, ok = 1;
+    if (!direct) {
+        char buf[32];
+        const char *fmt = label_format_suffix("L", label_next_id(), "_inl", buf);
+        end_label = fmt ? intern_str(fmt) : NULL;
+        ok = end_label != NULL;
+    }
+
+    for (ir_instr_t *it = callee->begin->next; ok && it != callee->end;
+         it = it->next) {
+        ir_instr_t *ni;
+        switch (it->op) {
+        case IR_LOAD_PARAM:
+            if (param_slot[it->imm])
+                ok = emit_slot(ir, &pos, it, IR_LOAD, param_slot[it->imm],
+                               it->type, map_value(callee, vmap, it->dest));
+            continue;
+        case IR_STORE_PARAM:
+            ok = emit_slot(ir, &pos, it, IR_STORE, param_slot[it->imm],
+                           it->type, map_value(callee, vmap, it->src1));
+            continue;
+        case IR_RETURN:
+            if (direct) {
+                result = map_value(callee, vmap, it->src1);
+                continue;
+            }
+            if (ret_slot &&
+                !emit_slot(ir, &pos, it, IR_STORE, ret_slot, callee->ret_type,
+                           map_value(callee, vmap, it->src1))) {
+                ok = 0;
+                continue;
+            }
+            ni = emit_after(ir, &pos, IR_BR, it);
+            if (ni)
+                ni->name = end_label;
+            ok = ni != NULL;
+            continue;
+        default:
             break;
         }
-    }
-    if (!fn || ins->imm != fn->param_count || i < (int)fn->param_count)
-        return 0;
 
-    int argc = (int)fn->param_count;
-    if (argc > 8)
-        return 0; /* limit to small functions */
+        ni = emit_after(ir, &pos, it->op, it);
+        if (!ni) {
+            ok = 0;
+            continue;
+        }
+        ni->type = it->type;
+        ni->imm = it->imm;
+        ni->data = it->data;
+        ni->is_volatile = it->is_volatile;
+        ni->is_restrict = it->is_restrict;
+        ni->alias_set = it->alias_set;
+        ni->name = it->name;
+        if (it->dest > 0)
+            ni->dest = map_value(callee, vmap, it->dest);
+        if (ir_has_value_operands(it)) {
+            ni->src1 = map_value(callee, vmap, it->src1);
+            ni->src2 = map_value(callee, vmap, it->src2);
+        } else {
+            ni->src1 = it->src1;
+            ni->src2 = it->src2;
+        }
 
-    int args[8];
-    if (!gather_call_args(list, i, argc, args))
-        return 0;
+        char buf[32];
+        if (it->op == IR_LABEL || it->op == IR_BR || it->op == IR_BCOND) {
+            ni->name = map_label(&labels, &nlabels, &label_cap, it->name);
+            ok = ni->name != NULL;
+        } else if (it->op == IR_GLOB_STRING || it->op == IR_GLOB_WSTRING) {
+            const char *fmt = label_format(it->op == IR_GLOB_STRING
+                                           ? "Lstr" : "LWstr", ni->dest, buf);
+            ni->name = fmt ? intern_str(fmt) : NULL;
+            ok = ni->name != NULL;
+        } else if (it->name && strncmp(it->name, "stack:", 6) == 0) {
+            snprintf(buf, sizeof(buf), "stack:%lld",
+                     base + strtoll(it->name + 6, NULL, 10));
+            ni->name = intern_str(buf);
+            ni->alias_set = get_alias(ir, ni->name);
+        }
+    }
 
-    for (int a = 0; a < argc; a++) {
-        remove_instr(ir, list, count, i - 1);
-        i--;
+    if (ok && !direct) {
+        ir_instr_t *lab = emit_after(ir, &pos, IR_LABEL, call);
+        if (lab)
+            lab->name = end_label;
+        ok = lab != NULL;
+        if (ok && ret_slot) {
+            result = alloc_value_id(ir);
+            ok = emit_slot(ir, &pos, call, IR_LOAD, ret_slot,
+                           callee->ret_type, result);
+        }
+    }
+    free(labels);
+    free(vmap);
+    if (!ok)
+        return NULL;
+    if (used && !ir_replace_all_uses(in->du, call->dest, result))
+        return NULL;
+    return pos;
+}
+
+/* Unlink the LEN instructions following PREV */
+static void unlink_after(ir_builder_t *ir, ir_instr_t *prev, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        ir_instr_t *ins = prev->next;
+        prev->next = ins->next;
+        if (ir->tail == ins)
+            ir->tail = prev;
+        ir_release_instr(ir, ins);
     }
+}
 
-    int ret_val;
-    if (!insert_inline_body(ir, ins, fn, argc, args, &ret_val))
-        return 0;
+/* Expand the calls of function F that pass the cost model */
+static int inline_caller(inliner_t *in, size_t f)
+{
+    inline_func_t *caller = &in->funcs[f];
+    size_t size = caller->size;
+    size_t limit = size + (size > INLINE_GROWTH_MIN ? size : INLINE_GROWTH_MIN);
+
+    ir_instr_t **run = NULL;     /* consecutive IR_ARG instructions */
+    size_t run_len = 0, run_cap = 0;
+    ir_instr_t *run_prev = NULL; /* instruction before the run */
+    int argv[INLINE_MAX_PARAMS];
 
-    replace_value_uses(list, i + 1, *count, ins->dest, ret_val);
+    ir_instr_t *prev = caller->begin;
+    for (ir_instr_t *ins = prev->next; ins != caller->end;
+         prev = ins, ins = ins->next) {
+        if (ins->op == IR_ARG) {
+            if (run_len == run_cap) {
+                size_t n = run_cap ? run_cap * 2 : 8;
+                ir_instr_t **tmp = realloc(run, n * sizeof(*tmp));
+                if (!tmp) {
+                    free(run);
+                    return 0;
+                }
+                run = tmp;
+                run_cap = n;
+            }
+            if (!run_len)
+                run_prev = prev;
+            run[run_len++] = ins;
+            continue;
+        }
+
+        size_t have = run_len;
+        run_len = 0;
+        if (ins->op != IR_CALL || ins->imm < 0 || (size_t)ins->imm > have)
+            continue;
+        long c = find_func(in, ins->name);
+        if (c < 0 || in->scc[c] == in->scc[f])
+            continue;
+        const inline_func_t *callee = &in->funcs[c];
+        int argc = (int)ins->imm;
+        ir_instr_t **args = argc ? run + (have - (size_t)argc) : NULL;
+        if (size + callee->size > limit ||
+            !should_inline(in, callee, ins, args, argc))
+            continue;
 
-    free(ins->name);
-    ins->name = NULL;
-    remove_instr(ir, list, count, i);
+        for (int p = 0; p < callee->param_count; p++)
+            argv[p] = arg_for_param(in, args, argc, p)->src1;
+        ir_instr_t *before = !argc ? prev
+                             : have == (size_t)argc ? run_prev : args[-1];
+        unlink_after(in->ir, before, (size_t)argc);
+        ir_instr_t *last = expand_call(in, caller, callee, ins, before, argv);
+        if (!last) {
+            free(run);
+            return 0;
+        }
+        unlink_after(in->ir, last, 1);
+        size += callee->size;
+        ins = last;
+    }
+    free(run);
     return 1;
 }
 
-void inline_small_funcs(ir_builder_t *ir)
+static void free_inliner(inliner_t *in)
+{
+    free(in->by_name);
+    free(in->edge_start);
+    free(in->edges);
+    free(in->scc);
+    free(in->index);
+    free(in->low);
+    free(in->stack);
+    free(in->on_stack);
+    free(in->order);
+    free(in->funcs);
+}
+
+void inline_small_funcs(ir_builder_t *ir, const opt_config_t *cfg)
 {
-    if (!ir)
+    if (!ir || !cfg)
         return;
 
-    inline_func_t *funcs = NULL;
-    size_t func_count = 0;
-    if (!collect_funcs(ir, &funcs, &func_count))
+    inliner_t in;
+    memset(&in, 0, sizeof(in));
+    in.ir = ir;
+    in.cfg = cfg;
+    if (!collect_funcs(ir, &in.funcs, &in.count) || in.count == 0) {
+        free(in.funcs);
         return;
+    }
 
-    int count = 0;
-    ir_instr_t **list = gather_call_list(ir, &count);
-    if (!list) {
-        for (size_t j = 0; j < func_count; j++)
-            free(funcs[j].body);
-        free(funcs);
+    in.by_name = malloc(in.count * sizeof(*in.by_name));
+    if (!in.by_name) {
+        opt_error("out of memory");
+        free_inliner(&in);
         return;
     }
+    for (size_t f = 0; f < in.count; f++)
+        in.by_name[f] = (name_ent_t){in.funcs[f].name, f};
+    qsort(in.by_name, in.count, sizeof(*in.by_name), cmp_name);
 
-    for (int i = 0; i < count; i++) {
-        if (inline_call(ir, list, &count, i, funcs, func_count))
-            i--; /* restart from previous position after modification */
+    ir_defuse_t du;
+    if (!build_call_graph(&in) || !order_components(&in) ||
+        !ir_defuse_init(&du, ir)) {
+        opt_error("out of memory");
+        free_inliner(&in);
+        return;
     }
+    in.du = &du;
 
-    recompute_tail(ir);
-    free(list);
-    for (size_t j = 0; j < func_count; j++)
-        free(funcs[j].body);
-    free(funcs);
-}
+    for (size_t i = 0; i < in.ordered; i++) {
+        size_t f = in.order[i];
+        if (!inline_caller(&in, f)) {
+            opt_error("out of memory");
+            break;
+        }
+        /* later callers copy the body as it is now */
+        inline_analyze(&in.funcs[f]);
+    }
 
+    ir_defuse_free(&du);
+    free_inliner(&in);
+}
@@ -5,135 +5,18 @@
  * See LICENSE for details.
  */
 
-#define _POSIX_C_SOURCE 200809L
 #include <stdlib.h>
-#include <string.h>
-#include <stdio.h>
-#include <errno.h>
-#include <sys/types.h>
-#include <ctype.h>
-#include <limits.h>
 #include <stdint.h>
 #include "opt.h"
-#include "error.h"
-#include "util.h"
 #include "opt_inline_helpers.h"
 
-/* --- local helpers for parsing inline hints ----------------------------- */
-
-static void strip_comments(char *s, int *in_comment)
-{
-    if (*in_comment) {
-        char *end = strstr(s, "*/");
-        if (!end) {
-            *s = '\0';
-            return;
-        }
-        memmove(s, end + 2, strlen(end + 2) + 1);
-        *in_comment = 0;
-    }
-    while (!*in_comment) {
-        char *start = strstr(s, "/*");
-        if (!start)
-            break;
-        char *end = strstr(start + 2, "*/");
-        if (end) {
-            memmove(start, end + 2, strlen(end + 2) + 1);
-        } else {
-            *start = '\0';
-            *in_comment = 1;
-            break;
-        }
-    }
-    char *slash = strstr(s, "//");
-    if (slash)
-        *slash = '\0';
-}
-
-static int tokens_have_inline(const char *prefix)
+/* Return 1 when values of type T cannot be returned through a register */
+static int is_aggregate(type_kind_t t)
 {
-    char *buf = vc_strdup(prefix);
-    if (!buf)
-        return -1;
-    int result = 0;
-    char *tok = strtok(buf, " \t\r\n*");
-    while (tok) {
-        if (strcmp(tok, "inline") == 0) {
-            result = 1;
-            break;
-        }
-        tok = strtok(NULL, " \t\r\n*");
-    }
-    free(buf);
-    return result;
-}
-
-static int parse_inline_hint(const char *file, const char *name)
-{
-    char *line = NULL;
-    FILE *f = fopen(file, "r");
-    if (!f) {
-        /* errno is preserved for callers */
-        return -1;
-    }
-
-    size_t len = 0;
-    ssize_t nread;
-    int in_comment = 0;
-    int result = 0;
-    int rc = 0;
-
-    while ((nread = getline(&line, &len, f)) != -1) {
-        strip_comments(line, &in_comment);
-        if (in_comment)
-            continue;
-        char *pos = strstr(line, name);
-        if (!pos)
-            continue;
-        if (pos > line && (isalnum((unsigned char)pos[-1]) || pos[-1] == '_'))
-            continue;
-        char *after = pos + strlen(name);
-        while (isspace((unsigned char)*after))
-            after++;
-        if (*after != '(')
-            continue;
-        char *close = strchr(after, ')');
-        if (!close || !strchr(close, '{'))
-            continue;
-        size_t pre_len = (size_t)(pos - line);
-        char *prefix = vc_strndup(line, pre_len);
-        if (!prefix) {
-            errno = ENOMEM;
-            rc = -1;
-            goto cleanup;
-        }
-        int r = tokens_have_inline(prefix);
-        free(prefix);
-        if (r < 0) {
-            errno = ENOMEM;
-            rc = -1;
-            goto cleanup;
-        }
-        result = r;
-        break;
-    }
-
-    if (ferror(f))
-        rc = -1;
-
-cleanup:
-    free(line);
-    fclose(f);
-    return rc ? -1 : result;
-}
-
-static int is_simple_op(ir_op_t op)
-{
-    switch (op) {
-    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
-    case IR_MOD: case IR_FADD: case IR_FSUB: case IR_FMUL:
-    case IR_FDIV: case IR_LFADD: case IR_LFSUB: case IR_LFMUL:
-    case IR_LFDIV:
+    switch (t) {
+    case TYPE_STRUCT: case TYPE_UNION: case TYPE_ARRAY:
+    case TYPE_FLOAT_COMPLEX: case TYPE_DOUBLE_COMPLEX:
+    case TYPE_LDOUBLE_COMPLEX:
         return 1;
     default:
         return 0;
@@ -142,50 +25,73 @@ static int is_simple_op(ir_op_t op)
 
 /* --- exported helpers --------------------------------------------------- */
 
-int clone_inline_body(ir_instr_t *begin, ir_instr_t **out, size_t *count)
+void inline_analyze(inline_func_t *fn)
 {
-    *out = NULL;
-    *count = 0;
-    if (!begin || begin->op != IR_FUNC_BEGIN)
-        return 0;
-
-    size_t n = 0;
-    int arith = 0;
-    for (ir_instr_t *it = begin->next; it && it->op != IR_FUNC_END; it = it->next) {
-        if (is_simple_op(it->op)) {
-            if (++arith > 4)
-                return 0;
-        } else if (it->op != IR_LOAD_PARAM && it->op != IR_CONST &&
-                   it->op != IR_RETURN && it->op != IR_RETURN_AGG) {
-            return 0;
-        }
-        n++;
-    }
-
-    ir_instr_t *end = begin->next;
-    while (end && end->op != IR_FUNC_END)
-        end = end->next;
-    if (!end)
-        return 0;
-
-    if (n == 0)
-        return 0;
-
-    ir_instr_t *buf = malloc(n * sizeof(*buf));
-    if (!buf) {
-        opt_error("out of memory");
-        return 0;
+    fn->size = 0;
+    fn->inlinable = 1;
+    fn->param_count = 0;
+    fn->written = 0;
+    fn->returns = 0;
+    fn->void_return = 0;
+    fn->tail_return = 0;
+    fn->ret_type = TYPE_VOID;
+    fn->min_value = 0;
+    fn->max_value = 0;
+    for (int p = 0; p < INLINE_MAX_PARAMS; p++) {
+        fn->param_loads[p] = 0;
+        fn->param_type[p] = TYPE_UNKNOWN;
     }
-
-    ir_instr_t *src = begin->next;
-    for (size_t i = 0; i < n; i++, src = src->next) {
-        buf[i] = *src;
-        buf[i].next = NULL;
+    /* the address would name a global once copied into a caller */
+    if (fn->begin->src1 & IR_FUNC_PARAM_ADDR)
+        fn->inlinable = 0;
+
+    ir_instr_t *last = NULL;
+    for (ir_instr_t *it = fn->begin->next; it != fn->end; it = it->next) {
+        if (it->dest > 0) {
+            if (!fn->min_value || it->dest < fn->min_value)
+                fn->min_value = it->dest;
+            if (it->dest > fn->max_value)
+                fn->max_value = it->dest;
+        }
+        switch (it->op) {
+        case IR_LABEL:
+            continue;
+        case IR_LOAD_PARAM:
+        case IR_STORE_PARAM:
+            if (it->imm < 0 || it->imm >= INLINE_MAX_PARAMS) {
+                fn->inlinable = 0;
+                break;
+            }
+            if (it->imm + 1 > fn->param_count)
+                fn->param_count = (int)it->imm + 1;
+            fn->param_type[it->imm] = it->type;
+            if (it->op == IR_STORE_PARAM)
+                fn->written |= 1u << it->imm;
+            else
+                fn->param_loads[it->imm]++;
+            break;
+        case IR_RETURN:
+            fn->returns++;
+            if (it->src1 <= 0)
+                fn->void_return = 1;
+            else if (is_aggregate(it->type))
+                fn->inlinable = 0;
+            else
+                fn->ret_type = it->type;
+            break;
+        case IR_ALLOCA: case IR_RETURN_AGG: case IR_PHI:
+        case IR_GLOB_VAR: case IR_GLOB_ARRAY: case IR_GLOB_UNION:
+        case IR_GLOB_STRUCT: case IR_GLOB_ADDR:
+        case IR_FUNC_BEGIN: case IR_FUNC_END:
+            fn->inlinable = 0;
+            break;
+        default:
+            break;
+        }
+        fn->size++;
+        last = it;
     }
-
-    *out = buf;
-    *count = n;
-    return 1;
+    fn->tail_return = fn->returns == 1 && last && last->op == IR_RETURN;
 }
 
 int collect_funcs(ir_builder_t *ir, inline_func_t **out, size_t *count)
@@ -196,40 +102,12 @@ int collect_funcs(ir_builder_t *ir, inline_func_t **out, size_t *count)
     for (ir_instr_t *ins = ir->head; ins; ins = ins->next) {
         if (ins->op != IR_FUNC_BEGIN)
             continue;
-        ir_instr_t *body = NULL;
-        size_t body_count = 0;
-        if (!clone_inline_body(ins, &body, &body_count))
-            continue;
-
-        int param_count = 0;
-        for (size_t i = 0; i < body_count; i++)
-            if (body[i].op == IR_LOAD_PARAM && body[i].imm + 1 > param_count)
-                param_count = (int)(body[i].imm + 1);
+        ir_instr_t *end = ins->next;
+        while (end && end->op != IR_FUNC_END)
+            end = end->next;
+        if (!end)
+            break;
 
-        int is_inline = 0;
-        const char *src_file = ins->next ? ins->next->file : NULL;
-        if (src_file && strcmp(src_file, "-") != 0) {
-            int r = parse_inline_hint(src_file, ins->name);
-            if (r > 0) {
-                is_inline = 1;
-            } else if (r < 0) {
-                if (errno != ENAMETOOLONG) {
-                    char msg[256];
-                    snprintf(msg, sizeof(msg),
-                             "could not open %s for inline check: %s",
-                             src_file, strerror(errno));
-                    opt_error(msg);
-                }
-                free(*out);
-                *out = NULL;
-                free(body);
-                return 0;
-            }
-        }
-        if (!is_inline) {
-            free(body);
-            continue;
-        }
         if (*count == cap) {
             size_t max_cap = SIZE_MAX / sizeof(**out);
             size_t new_cap;
@@ -238,7 +116,7 @@ int collect_funcs(ir_builder_t *ir, inline_func_t **out, size_t *count)
                     opt_error("too many inline functions");
                     free(*out);
                     *out = NULL;
-                    free(body);
+                    *count = 0;
                     return 0;
                 }
                 new_cap = cap * 2;
@@ -250,15 +128,20 @@ int collect_funcs(ir_builder_t *ir, inline_func_t **out, size_t *count)
             inline_func_t *tmp = realloc(*out, new_cap * sizeof(**out));
             if (!tmp) {
                 opt_error("out of memory");
-                free(body);
+                free(*out);
+                *out = NULL;
+                *count = 0;
                 return 0;
             }
             *out = tmp;
             cap = new_cap;
         }
-        (*out)[(*count)++] =
-            (inline_func_t){ins->name, body, body_count, param_count};
+        inline_func_t *fn = &(*out)[(*count)++];
+        fn->name = ins->name;
+        fn->begin = ins;
+        fn->end = end;
+        inline_analyze(fn);
+        ins = end;
     }
     return 1;
 }
-
@@ -1,5 +1,20 @@
 /*
- * Loop invariant code motion pass.
+ * Loop invariant code motion and strength reduction.
+ *
+ * Loops are the natural loops found by ir_cfg_loops(), visited innermost
+ * first so code hoisted out of an inner loop is considered again for the
+ * loops around it.  Every loop is first given a preheader: a block
+ * outside the loop whose only successor is the header and which is the
+ * only way into the header from outside.  Pure computations whose
+ * operands are defined outside the loop and loads of memory that, as
+ * told by ir_alias.h, no write or call in the loop may reach are moved
+ * to the end of the preheader.  Loads through pointers and divisions
+ * that may trap only move when they run on every iteration.
+ *
+ * In functions in SSA form, multiplications and pointer additions
+ * scaled by a basic induction variable are then replaced by a value of
+ * their own, started in the preheader and advanced by a constant step
+ * next to the induction variable.
  *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
@@ -7,12 +22,53 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include "opt.h"
+#include "ir_alias.h"
+#include "label.h"
+#include "intern.h"
+
+/* Induction expressions reduced per loop, each keeps a register busy */
+#define LICM_MAX_REDUCED 4
+
+/* Stamp of instructions selected for hoisting */
+#define LICM_HOISTED UINT_MAX
+
+typedef struct {
+    ir_builder_t *ir;
+    ir_function_t *fn;
+    int x86_64;
+    ir_instr_t **def;       /* defining instruction of every value */
+    unsigned *stamp;        /* `cur` for values defined in the loop */
+    size_t cap;             /* entries in def and stamp */
+    unsigned cur;
+    ir_alias_t aa;          /* alias queries of the current function */
+    ir_instr_t **stores;    /* memory writes of the current loop */
+    size_t store_count;
+    size_t store_cap;
+    int has_call;
+    ir_instr_t **moves;     /* instructions selected for hoisting */
+    size_t move_count;
+    size_t move_cap;
+} licm_t;
+
+/* Basic induction variable `phi = [init, phi + step]` of a header */
+typedef struct {
+    ir_instr_t *phi;
+    ir_instr_t *inc;        /* the update flowing along the back edge */
+    int init;
+    long long step;
+} indvar_t;
+
+static int at_func_end(const ir_instr_t *ins)
+{
+    return !ins || ins->op == IR_FUNC_END || ins->op == IR_FUNC_BEGIN;
+}
 
 static int is_pure_op(ir_op_t op)
 {
     switch (op) {
-    case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV: case IR_MOD:
+    case IR_ADD: case IR_SUB: case IR_MUL:
     case IR_SHL: case IR_SHR: case IR_AND: case IR_OR: case IR_XOR:
     case IR_FADD: case IR_FSUB: case IR_FMUL: case IR_FDIV:
     case IR_LFADD: case IR_LFSUB: case IR_LFMUL: case IR_LFDIV:
@@ -20,77 +76,669 @@ static int is_pure_op(ir_op_t op)
     case IR_CMPEQ: case IR_CMPNE: case IR_CMPLT: case IR_CMPGT:
     case IR_CMPLE: case IR_CMPGE:
     case IR_LOGAND: case IR_LOGOR:
-    case IR_CONST:
+    case IR_CAST: case IR_CONST: case IR_ADDR:
         return 1;
     default:
         return 0;
     }
 }
 
-static void hoist(ir_instr_t *ins, ir_instr_t *before,
-                  ir_builder_t *ir)
+/* Types whose loads are kept in a single register */
+static int is_scalar_type(type_kind_t t)
 {
-    if (before) {
-        ins->next = before->next;
-        before->next = ins;
-    } else {
-        ins->next = ir->head;
-        ir->head = ins;
+    switch (t) {
+    case TYPE_BOOL: case TYPE_CHAR: case TYPE_UCHAR:
+    case TYPE_SHORT: case TYPE_USHORT: case TYPE_INT: case TYPE_UINT:
+    case TYPE_LONG: case TYPE_ULONG: case TYPE_ENUM: case TYPE_PTR:
+        return 1;
+    default:
+        return 0;
     }
 }
 
-void opt_licm(ir_builder_t *ir)
+static int is_indvar_type(type_kind_t t)
 {
-    if (!ir)
-        return;
+    return t == TYPE_INT || t == TYPE_UINT || t == TYPE_LONG ||
+           t == TYPE_ULONG;
+}
 
-    ir_instr_t *prev = NULL;
-    for (ir_instr_t *lbl = ir->head; lbl; prev = lbl, lbl = lbl->next) {
-        if (lbl->op != IR_LABEL)
+static int push_ptr(ir_instr_t ***arr, size_t *count, size_t *cap,
+                    ir_instr_t *ins)
+{
+    if (*count == *cap) {
+        size_t n = *cap ? *cap * 2 : 16;
+        ir_instr_t **a = realloc(*arr, n * sizeof(*a));
+        if (!a)
+            return 0;
+        *arr = a;
+        *cap = n;
+    }
+    (*arr)[(*count)++] = ins;
+    return 1;
+}
+
+/* Grow the per value tables to cover every value id allocated so far */
+static int ensure_cap(licm_t *st)
+{
+    size_t need = st->ir->next_value_id;
+    if (need <= st->cap)
+        return 1;
+    size_t n = st->cap ? st->cap : 64;
+    while (n < need)
+        n *= 2;
+    ir_instr_t **def = realloc(st->def, n * sizeof(*def));
+    if (!def)
+        return 0;
+    st->def = def;
+    unsigned *stamp = realloc(st->stamp, n * sizeof(*stamp));
+    if (!stamp)
+        return 0;
+    st->stamp = stamp;
+    memset(st->def + st->cap, 0, (n - st->cap) * sizeof(*def));
+    memset(st->stamp + st->cap, 0, (n - st->cap) * sizeof(*stamp));
+    st->cap = n;
+    return 1;
+}
+
+static ir_instr_t *def_of(const licm_t *st, int v)
+{
+    return v > 0 && (size_t)v < st->cap ? st->def[v] : NULL;
+}
+
+static int in_loop(const licm_t *st, int v)
+{
+    return v > 0 && (size_t)v < st->cap && st->stamp[v] == st->cur;
+}
+
+/* Record the definitions of the current function */
+static int scan_function(licm_t *st)
+{
+    if (!ensure_cap(st))
+        return 0;
+    for (ir_instr_t *i = st->fn->begin->next; !at_func_end(i); i = i->next)
+        if (i->dest > 0 && (size_t)i->dest < st->cap)
+            st->def[i->dest] = i;
+    return 1;
+}
+
+/* Return non-zero when no write in the loop may change what LOAD reads */
+static int load_is_invariant(const licm_t *st, const ir_instr_t *load)
+{
+    if (st->has_call && ir_call_may_access(&st->aa, load))
+        return 0;
+    for (size_t k = 0; k < st->store_count; k++)
+        if (ir_may_alias(&st->aa, st->stores[k], load))
+            return 0;
+    return 1;
+}
+
+/* Return non-zero when block B of loop L runs on every iteration */
+static int runs_every_iteration(const licm_t *st, size_t l, size_t b)
+{
+    const ir_function_t *fn = st->fn;
+    const ir_loop_t *loop = &fn->loops[l];
+    /* a call may leave the function before B is reached */
+    if (st->has_call)
+        return 0;
+    for (size_t k = 0; k < loop->block_count; k++) {
+        const ir_block_t *bb = &fn->blocks[loop->blocks[k]];
+        int exits = bb->succ_count == 0;
+        for (size_t s = 0; s < bb->succ_count && !exits; s++)
+            exits = !ir_cfg_loop_contains(fn, l, bb->succs[s]);
+        if (exits && !ir_cfg_dominates(fn, b, bb->id))
+            return 0;
+    }
+    return 1;
+}
+
+/* Return non-zero when dividing by V can never trap */
+static int is_safe_divisor(const licm_t *st, int v)
+{
+    const ir_instr_t *d = def_of(st, v);
+    return d && d->op == IR_CONST && d->imm != 0 && d->imm != -1;
+}
+
+/* Return non-zero when INS in block B can move to the preheader of L */
+static int can_hoist(const licm_t *st, size_t l, size_t b,
+                     const ir_instr_t *ins)
+{
+    if (ins->dest <= 0)
+        return 0;
+    switch (ins->op) {
+    case IR_DIV: case IR_MOD:
+        if (in_loop(st, ins->src1) || in_loop(st, ins->src2))
+            return 0;
+        return is_safe_divisor(st, ins->src2) ||
+               runs_every_iteration(st, l, b);
+    case IR_LOAD: case IR_LOAD_IDX:
+        if (ins->is_volatile || !is_scalar_type(ins->type) ||
+            (ins->op == IR_LOAD_IDX && in_loop(st, ins->src1)))
+            return 0;
+        return load_is_invariant(st, ins);
+    case IR_LOAD_PARAM:
+        return is_scalar_type(ins->type) && load_is_invariant(st, ins);
+    case IR_LOAD_PTR:
+        if (ins->is_volatile || !is_scalar_type(ins->type) ||
+            in_loop(st, ins->src1))
+            return 0;
+        return load_is_invariant(st, ins) && runs_every_iteration(st, l, b);
+    default:
+        if (!is_pure_op(ins->op))
+            return 0;
+        return !in_loop(st, ins->src1) && !in_loop(st, ins->src2);
+    }
+}
+
+/* Stamp the values of loop L and collect its memory writes */
+static int scan_loop(licm_t *st, size_t l)
+{
+    ir_function_t *fn = st->fn;
+    ir_loop_t *loop = &fn->loops[l];
+    if (!ensure_cap(st))
+        return 0;
+    if (++st->cur == LICM_HOISTED) {
+        memset(st->stamp, 0, st->cap * sizeof(*st->stamp));
+        st->cur = 1;
+    }
+    st->store_count = 0;
+    st->has_call = 0;
+    for (size_t k = 0; k < loop->block_count; k++) {
+        ir_block_t *bb = &fn->blocks[loop->blocks[k]];
+        for (ir_instr_t *i = bb->first;; i = i->next) {
+            if (i->dest > 0 && (size_t)i->dest < st->cap)
+                st->stamp[i->dest] = st->cur;
+            switch (i->op) {
+            case IR_STORE: case IR_STORE_IDX: case IR_BFSTORE:
+            case IR_STORE_PARAM: case IR_STORE_PTR:
+                if (!push_ptr(&st->stores, &st->store_count, &st->store_cap,
+                              i))
+                    return 0;
+                break;
+            case IR_CALL: case IR_CALL_PTR: case IR_CALL_NR:
+            case IR_CALL_PTR_NR:
+                st->has_call = 1;
+                break;
+            default:
+                break;
+            }
+            if (i == bb->last)
+                break;
+        }
+    }
+    return 1;
+}
+
+/* Return the preheader of loop L or NULL when it needs one */
+static ir_block_t *find_preheader(ir_function_t *fn, size_t l)
+{
+    ir_block_t *hb = &fn->blocks[fn->loops[l].header];
+    ir_block_t *pre = NULL;
+    if (hb->id == 0)
+        return NULL;
+    for (size_t p = 0; p < hb->pred_count; p++) {
+        if (ir_cfg_loop_contains(fn, l, hb->preds[p]))
             continue;
-        ir_instr_t *bcond = lbl->next;
-        if (!bcond || bcond->op != IR_BCOND)
+        if (pre)
+            return NULL;
+        pre = &fn->blocks[hb->preds[p]];
+    }
+    return pre && pre->succ_count == 1 ? pre : NULL;
+}
+
+/* Return the instruction after which code is added to PRE */
+static ir_instr_t *preheader_tail(const ir_block_t *pre)
+{
+    if (pre->last->op != IR_BR && pre->last->op != IR_BCOND)
+        return pre->last;
+    ir_instr_t *pos = pre->prev;
+    while (pos->next != pre->last)
+        pos = pos->next;
+    return pos;
+}
+
+static ir_instr_t *insert_op(ir_builder_t *ir, ir_instr_t *pos, ir_op_t op,
+                             const char *name)
+{
+    ir_instr_t *ins = ir_insert_after(ir, pos);
+    if (ins) {
+        ins->op = op;
+        ins->name = name;
+    }
+    return ins;
+}
+
+/*
+ * Move the header phi arguments arriving from outside loop L to the new
+ * preheader LABEL.  Edges are identified as in ir_phi_arg_t; BACK is the
+ * branch that replaced a back edge falling through into the header.
+ */
+static int split_header_phis(ir_builder_t *ir, ir_block_t *hb,
+                             ir_instr_t *label, ir_instr_t *back)
+{
+    for (ir_instr_t *phi = hb->first->next; phi && phi->op == IR_PHI;
+         phi = phi->next) {
+        ir_phi_arg_t *args = ir_phi_args(phi);
+        size_t nout = 0, nin = 0;
+        int same = 1;
+        int value = 0;
+        for (long long a = 0; a < phi->imm; a++) {
+            if (!args[a].pred && back)
+                args[a].pred = back;
+            if (args[a].pred && args[a].pred->name != label->name)
+                continue;
+            same = same && (!nout || args[a].value == value);
+            value = args[a].value;
+            nout++;
+        }
+        if (!nout)
             continue;
-        ir_instr_t *br = bcond->next;
-        while (br && !(br->op == IR_BR && br->name &&
-                       strcmp(br->name, lbl->name) == 0))
-            br = br->next;
-        if (!br)
+        if (!same) {
+            ir_instr_t *merge = ir_insert_phi(ir, label, phi->type, nout);
+            if (!merge)
+                return 0;
+            for (long long a = 0; a < phi->imm; a++)
+                if (!args[a].pred || args[a].pred->name == label->name)
+                    ir_phi_add_arg(merge, args[a].value, args[a].pred);
+            value = merge->dest;
+        }
+        for (long long a = 0; a < phi->imm; a++)
+            if (args[a].pred && args[a].pred->name != label->name)
+                args[nin++] = args[a];
+        args[nin].value = value;
+        args[nin].pred = NULL;
+        phi->imm = (long long)nin + 1;
+    }
+    return 1;
+}
+
+/*
+ * Insert a labelled block falling through into the header of loop L and
+ * route every edge entering the loop through it.
+ */
+static int create_preheader(licm_t *st, size_t l)
+{
+    ir_function_t *fn = st->fn;
+    ir_block_t *hb = &fn->blocks[fn->loops[l].header];
+    char buf[32];
+    const char *name = label_format("Lpre", label_next_id(), buf);
+    if (!name)
+        return 0;
+    name = intern_str(name);
+
+    ir_instr_t *pos = hb->prev;
+    ir_instr_t *back = NULL;
+    if (hb->id > 0 && pos->op != IR_BR &&
+        ir_cfg_loop_contains(fn, l, hb->id - 1)) {
+        const ir_block_t *pb = &fn->blocks[hb->id - 1];
+        for (size_t s = 0; s < pb->succ_count; s++)
+            if (pb->succs[s] == hb->id)
+                back = pos;
+        if (back) {
+            back = insert_op(st->ir, pos, IR_BR, hb->label);
+            if (!back)
+                return 0;
+            pos = back;
+        }
+    }
+    ir_instr_t *label = insert_op(st->ir, pos, IR_LABEL, name);
+    if (!label)
+        return 0;
+    for (size_t p = 0; p < hb->pred_count; p++) {
+        if (ir_cfg_loop_contains(fn, l, hb->preds[p]))
             continue;
-        /* ensure no other labels inside */
-        int has_label = 0;
-        for (ir_instr_t *i = bcond->next; i && i != br; i = i->next)
-            if (i->op == IR_LABEL)
-                has_label = 1;
-        if (has_label)
+        ir_instr_t *term = fn->blocks[hb->preds[p]].last;
+        if ((term->op == IR_BR || term->op == IR_BCOND) &&
+            term->name == hb->label)
+            term->name = name;
+    }
+    return split_header_phis(st->ir, hb, label, back);
+}
+
+/* Give every loop of the function a preheader */
+static int add_preheaders(licm_t *st)
+{
+    ir_function_t *fn = st->fn;
+    /* each round fixes one loop, the bound only guards against surprises */
+    size_t rounds = fn->loop_count + 1;
+    for (size_t l = 0; l < fn->loop_count && rounds; l++) {
+        if (find_preheader(fn, l))
             continue;
+        if (!create_preheader(st, l) || !ir_cfg_rebuild_function(fn) ||
+            !ir_cfg_loops(fn))
+            return 0;
+        rounds--;
+        l = (size_t)-1;
+    }
+    return 1;
+}
 
-        size_t max_id = ir->next_value_id;
-        int *defined = calloc(max_id, sizeof(int));
-        if (!defined)
-            return;
-        for (ir_instr_t *i = bcond->next; i && i != br; i = i->next) {
-            int invariant = is_pure_op(i->op);
-            if (invariant) {
-                if (i->src1 > 0 && (size_t)i->src1 < max_id && defined[i->src1])
-                    invariant = 0;
-                if (i->src2 > 0 && (size_t)i->src2 < max_id && defined[i->src2])
-                    invariant = 0;
+/*
+ * Select the invariant instructions of loop L in dominance order and
+ * move them behind POS.  Returns the number moved or -1 on failure.
+ */
+static int hoist_loop(licm_t *st, size_t l, ir_instr_t *pos)
+{
+    ir_function_t *fn = st->fn;
+    ir_loop_t *loop = &fn->loops[l];
+    st->move_count = 0;
+    for (size_t k = 0; k < loop->block_count; k++) {
+        ir_block_t *bb = &fn->blocks[loop->blocks[k]];
+        for (ir_instr_t *i = bb->first;; i = i->next) {
+            if (can_hoist(st, l, bb->id, i)) {
+                if (!push_ptr(&st->moves, &st->move_count, &st->move_cap, i))
+                    return -1;
+                st->stamp[i->dest] = LICM_HOISTED;
             }
-            if (invariant) {
-                /* remove from list */
-                ir_instr_t *next = i->next;
-                bcond->next = next;
-                if (br == i)
+            if (i == bb->last)
+                break;
+        }
+    }
+    if (!st->move_count)
+        return 0;
+
+    ir_instr_t *prev = fn->begin;
+    for (ir_instr_t *i = prev->next; !at_func_end(i); i = prev->next) {
+        if (i->dest > 0 && (size_t)i->dest < st->cap &&
+            st->stamp[i->dest] == LICM_HOISTED) {
+            prev->next = i->next;
+            st->stamp[i->dest] = 0;
+            continue;
+        }
+        prev = i;
+    }
+    for (size_t k = 0; k < st->move_count; k++) {
+        ir_instr_t *i = st->moves[k];
+        i->next = pos->next;
+        pos->next = i;
+        pos = i;
+    }
+    return (int)st->move_count;
+}
+
+/* Append a new value computed by OP after *POS and advance *POS */
+static ir_instr_t *emit_value(licm_t *st, ir_instr_t **pos, ir_op_t op,
+                              type_kind_t type, int src1, int src2,
+                              long long imm)
+{
+    ir_instr_t *ins = ir_insert_after(st->ir, *pos);
+    if (!ins)
+        return NULL;
+    ins->op = op;
+    ins->dest = (int)st->ir->next_value_id++;
+    ins->src1 = src1;
+    ins->src2 = src2;
+    ins->imm = imm;
+    ins->type = type;
+    *pos = ins;
+    if (!ensure_cap(st))
+        return NULL;
+    st->def[ins->dest] = ins;
+    return ins;
+}
+
+/* Recognize PHI as a basic induction variable of the current loop */
+static int find_indvar(const licm_t *st, ir_instr_t *phi, indvar_t *iv)
+{
+    if (phi->imm != 2 || !is_indvar_type(phi->type))
+        return 0;
+    ir_phi_arg_t *args = ir_phi_args(phi);
+    for (int k = 0; k < 2; k++) {
+        int init = args[1 - k].value;
+        ir_instr_t *inc = def_of(st, args[k].value);
+        if (!inc || !in_loop(st, inc->dest) || in_loop(st, init) ||
+            inc->type != phi->type)
+            continue;
+        int other;
+        if ((inc->op == IR_ADD || inc->op == IR_SUB) && inc->src1 == phi->dest)
+            other = inc->src2;
+        else if (inc->op == IR_ADD && inc->src2 == phi->dest)
+            other = inc->src1;
+        else
+            continue;
+        const ir_instr_t *c = def_of(st, other);
+        if (!c || c->op != IR_CONST || c->imm < -65536 || c->imm > 65536)
+            continue;
+        iv->phi = phi;
+        iv->inc = inc;
+        iv->init = init;
+        iv->step = inc->op == IR_SUB ? -c->imm : c->imm;
+        return 1;
+    }
+    return 0;
+}
+
+/* Return non-zero when INS scales the induction variable IV */
+static int is_iv_expr(const licm_t *st, const indvar_t *iv,
+                      const ir_instr_t *ins)
+{
+    int v = iv->phi->dest;
+    if (ins->op == IR_PTR_ADD)
+        return ins->src2 == v && !in_loop(st, ins->src1) && ins->imm > 0 &&
+               llabs(iv->step * ins->imm) <= INT_MAX;
+    if (ins->op != IR_MUL || ins->type != iv->phi->type)
+        return 0;
+    return (ins->src1 == v && !in_loop(st, ins->src2)) ||
+           (ins->src2 == v && !in_loop(st, ins->src1));
+}
+
+/*
+ * Compute the start and step of the induction variable replacing EXPR
+ * behind *POS.  Returns 0 on allocation failure.
+ */
+static int emit_start_step(licm_t *st, const indvar_t *iv,
+                           const ir_instr_t *expr, ir_instr_t **pos,
+                           int *start, int *step)
+{
+    ir_instr_t *s, *c;
+    if (expr->op == IR_PTR_ADD) {
+        s = emit_value(st, pos, IR_PTR_ADD, expr->type, expr->src1, iv->init,
+                       expr->imm);
+        c = s ? emit_value(st, pos, IR_CONST, TYPE_INT, 0, 0,
+                           iv->step * expr->imm)
+              : NULL;
+    } else {
+        int k = expr->src1 == iv->phi->dest ? expr->src2 : expr->src1;
+        const ir_instr_t *kc = def_of(st, k);
+        long long prod;
+        s = emit_value(st, pos, IR_MUL, expr->type, iv->init, k, 0);
+        if (s && kc && kc->op == IR_CONST &&
+            opt_eval_int(IR_MUL, expr->type, iv->step, kc->imm, st->x86_64,
+                         &prod)) {
+            c = emit_value(st, pos, IR_CONST, expr->type, 0, 0, prod);
+        } else {
+            c = s ? emit_value(st, pos, IR_CONST, expr->type, 0, 0, iv->step)
+                  : NULL;
+            c = c ? emit_value(st, pos, IR_MUL, expr->type, c->dest, k, 0)
+                  : NULL;
+        }
+    }
+    if (!c)
+        return 0;
+    *start = s->dest;
+    *step = c->dest;
+    return 1;
+}
+
+/*
+ * Replace EXPR by a phi in header HB starting at its value for the
+ * initial induction variable and advanced next to the update of IV.
+ * Returns the phi or NULL on allocation failure.
+ */
+static ir_instr_t *reduce_expr(licm_t *st, ir_block_t *hb,
+                               const indvar_t *iv, const ir_instr_t *expr,
+                               ir_instr_t **pos)
+{
+    int start, step;
+    if (!emit_start_step(st, iv, expr, pos, &start, &step))
+        return NULL;
+    int ptr = expr->op == IR_PTR_ADD;
+    ir_instr_t *phi = ir_insert_phi(st->ir, hb->first,
+                                    ptr ? TYPE_PTR : expr->type, 2);
+    if (!phi || !ensure_cap(st))
+        return NULL;
+    st->def[phi->dest] = phi;
+    ir_instr_t *at = iv->inc;
+    ir_instr_t *next = emit_value(st, &at, ptr ? IR_PTR_ADD : IR_ADD,
+                                  expr->type, phi->dest, step, ptr ? 1 : 0);
+    if (!next)
+        return NULL;
+    ir_phi_arg_t *args = ir_phi_args(iv->phi);
+    for (int k = 0; k < 2; k++)
+        ir_phi_add_arg(phi, args[k].value == iv->inc->dest ? next->dest : start,
+                       args[k].pred);
+    return phi;
+}
+
+/*
+ * Replace `base + iv * scale` and `iv * k` in loop L by induction
+ * variables of their own, adding their setup behind POS.  Returns the
+ * number of expressions replaced or -1 on allocation failure.
+ */
+static int reduce_loop(licm_t *st, size_t l, ir_instr_t *pos)
+{
+    ir_function_t *fn = st->fn;
+    ir_loop_t *loop = &fn->loops[l];
+    ir_block_t *hb = &fn->blocks[loop->header];
+    ir_instr_t *expr[LICM_MAX_REDUCED];
+    indvar_t ivs[LICM_MAX_REDUCED];
+    int count = 0;
+
+    for (ir_instr_t *phi = hb->first->next; phi && phi->op == IR_PHI;
+         phi = phi->next) {
+        indvar_t iv;
+        if (!find_indvar(st, phi, &iv))
+            continue;
+        for (size_t k = 0; k < loop->block_count; k++) {
+            ir_block_t *bb = &fn->blocks[loop->blocks[k]];
+            for (ir_instr_t *i = bb->first;; i = i->next) {
+                if (count < LICM_MAX_REDUCED && is_iv_expr(st, &iv, i)) {
+                    expr[count] = i;
+                    ivs[count++] = iv;
+                }
+                if (i == bb->last)
                     break;
-                hoist(i, prev, ir);
-                i = bcond; /* restart from bcond */
-            } else {
-                if (i->dest > 0 && (size_t)i->dest < max_id)
-                    defined[i->dest] = 1;
-                bcond = i;
             }
         }
-        free(defined);
     }
+
+    int from[LICM_MAX_REDUCED], to[LICM_MAX_REDUCED];
+    for (int k = 0; k < count; k++) {
+        ir_instr_t *phi = reduce_expr(st, hb, &ivs[k], expr[k], &pos);
+        if (!phi)
+            return -1;
+        from[k] = expr[k]->dest;
+        to[k] = phi->dest;
+    }
+    for (ir_instr_t *i = fn->begin->next; count && !at_func_end(i);
+         i = i->next) {
+        if (i->op == IR_PHI) {
+            ir_phi_arg_t *args = ir_phi_args(i);
+            for (long long a = 0; a < i->imm; a++)
+                for (int k = 0; k < count; k++)
+                    if (args[a].value == from[k])
+                        args[a].value = to[k];
+        } else if (ir_has_value_operands(i)) {
+            for (int k = 0; k < count; k++) {
+                if (i->src1 == from[k])
+                    i->src1 = to[k];
+                if (i->src2 == from[k])
+                    i->src2 = to[k];
+            }
+        }
+    }
+    return count;
+}
+
+/* Locate the loop headed by LABEL after the function was rebuilt */
+static size_t loop_of_label(const ir_function_t *fn, const char *label)
+{
+    const ir_block_t *hb = ir_cfg_label_block(fn, label);
+    if (!hb || !fn->loop_of)
+        return IR_CFG_NO_BLOCK;
+    size_t l = fn->loop_of[hb->id];
+    return l != IR_CFG_NO_BLOCK && fn->loops[l].header == hb->id
+               ? l : IR_CFG_NO_BLOCK;
+}
+
+static int refresh(ir_function_t *fn)
+{
+    return ir_cfg_rebuild_function(fn) && ir_cfg_loops(fn);
+}
+
+/* Optimize the loop headed by LABEL.  Returns 0 on allocation failure. */
+static int optimize_loop(licm_t *st, const char *label)
+{
+    ir_function_t *fn = st->fn;
+    size_t l = loop_of_label(fn, label);
+    ir_block_t *pre = l != IR_CFG_NO_BLOCK ? find_preheader(fn, l) : NULL;
+    if (!pre)
+        return 1;
+    if (!scan_loop(st, l))
+        return 0;
+    int moved = hoist_loop(st, l, preheader_tail(pre));
+    if (moved < 0)
+        return 0;
+    if (!(fn->begin->src1 & IR_FUNC_PROMOTED))
+        return !moved || refresh(fn);
+
+    if (moved) {
+        if (!refresh(fn))
+            return 0;
+        l = loop_of_label(fn, label);
+        pre = l != IR_CFG_NO_BLOCK ? find_preheader(fn, l) : NULL;
+        if (!pre || !scan_loop(st, l))
+            return pre == NULL;
+    }
+    int reduced = reduce_loop(st, l, preheader_tail(pre));
+    if (reduced < 0)
+        return 0;
+    return !reduced || refresh(fn);
+}
+
+static int optimize_function(licm_t *st)
+{
+    ir_function_t *fn = st->fn;
+    if (!ir_cfg_loops(fn))
+        return 0;
+    if (!fn->loop_count)
+        return 1;
+    if (!add_preheaders(st) || !scan_function(st) ||
+        !ir_alias_init(&st->aa, fn->begin))
+        return 0;
+
+    /* loops are tracked by header label while the blocks are rebuilt */
+    size_t count = fn->loop_count;
+    const char **labels = malloc(count * sizeof(*labels));
+    if (!labels)
+        return 0;
+    for (size_t l = 0; l < count; l++)
+        labels[l] = fn->blocks[fn->loops[l].header].label;
+    int ok = 1;
+    for (size_t l = 0; ok && l < count; l++)
+        ok = !labels[l] || optimize_loop(st, labels[l]);
+    free(labels);
+    ir_alias_free(&st->aa);
+    return ok;
+}
+
+void opt_licm(ir_builder_t *ir, ir_cfg_t *cfg, const opt_config_t *opts)
+{
+    if (!ir || !cfg)
+        return;
+
+    licm_t st;
+    memset(&st, 0, sizeof(st));
+    st.ir = ir;
+    st.x86_64 = opts ? opts->x86_64 : 0;
+    for (size_t f = 0; f < cfg->func_count; f++) {
+        st.fn = &cfg->funcs[f];
+        if (st.fn->block_count && !optimize_function(&st)) {
+            opt_error("out of memory");
+            break;
+        }
+    }
+    free(st.def);
+    free(st.stamp);
+    free(st.stores);
+    free(st.moves);
 }
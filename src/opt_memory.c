@@ -0,0 +1,290 @@
+/*
+ * Redundant load and dead store elimination.
+ *
+ * Both work on one basic block at a time with the queries of
+ * ir_alias.h.  A load reading the same location as an earlier load of
+ * the block, with no write or call in between that may change it,
+ * reuses the earlier value; the later load is left for dead code
+ * elimination.  A store overwritten by a later store to the same
+ * location before anything may read it is removed.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "opt.h"
+#include "ir_alias.h"
+#include "ir_defuse.h"
+
+/* Loads and stores remembered per block, the oldest are forgotten */
+#define MEM_MAX_TRACKED 32
+
+typedef struct {
+    ir_instr_t *ins;
+    ir_instr_t *prev;       /* instruction linked before a pending store */
+} mem_entry_t;
+
+typedef struct {
+    ir_builder_t *ir;
+    ir_function_t *fn;
+    ir_defuse_t du;
+    ir_alias_t aa;
+    ir_instr_t *loads[MEM_MAX_TRACKED];    /* values available */
+    size_t load_count;
+    mem_entry_t stores[MEM_MAX_TRACKED];   /* not read since written */
+    size_t store_count;
+} mem_state_t;
+
+static int is_call(ir_op_t op)
+{
+    return op == IR_CALL || op == IR_CALL_PTR || op == IR_CALL_NR ||
+           op == IR_CALL_PTR_NR;
+}
+
+static int is_load(ir_op_t op)
+{
+    return op == IR_LOAD || op == IR_LOAD_IDX || op == IR_LOAD_PTR ||
+           op == IR_LOAD_PARAM || op == IR_BFLOAD;
+}
+
+static int is_store(ir_op_t op)
+{
+    return op == IR_STORE || op == IR_STORE_IDX || op == IR_STORE_PTR ||
+           op == IR_STORE_PARAM || op == IR_BFSTORE;
+}
+
+/* Instructions that neither access memory nor end the block */
+static int is_memory_free(ir_op_t op)
+{
+    switch (op) {
+    case IR_CONST: case IR_ADD: case IR_SUB: case IR_MUL: case IR_DIV:
+    case IR_MOD: case IR_SHL: case IR_SHR: case IR_AND: case IR_OR:
+    case IR_XOR: case IR_CAST: case IR_FADD: case IR_FSUB: case IR_FMUL:
+    case IR_FDIV: case IR_LFADD: case IR_LFSUB: case IR_LFMUL: case IR_LFDIV:
+    case IR_PTR_ADD: case IR_PTR_DIFF:
+    case IR_CMPEQ: case IR_CMPNE: case IR_CMPLT: case IR_CMPGT:
+    case IR_CMPLE: case IR_CMPGE: case IR_LOGAND: case IR_LOGOR:
+    case IR_GLOB_STRING: case IR_GLOB_WSTRING: case IR_ADDR:
+    case IR_ALLOCA: case IR_PHI: case IR_COPY:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Types whose accesses the code generator performs as one move */
+static int is_scalar_type(type_kind_t t)
+{
+    switch (t) {
+    case TYPE_INT: case TYPE_UINT: case TYPE_CHAR: case TYPE_UCHAR:
+    case TYPE_SHORT: case TYPE_USHORT: case TYPE_LONG: case TYPE_ULONG:
+    case TYPE_LLONG: case TYPE_ULLONG: case TYPE_BOOL: case TYPE_FLOAT:
+    case TYPE_DOUBLE: case TYPE_PTR: case TYPE_ENUM: case TYPE_UNKNOWN:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Return non-zero when the pointers X and Y are equal.  Besides equal
+ * values this accepts two identical IR_PTR_ADDs, which remain distinct
+ * when their base became equal only through a reused load.
+ */
+static int same_address(mem_state_t *st, int x, int y)
+{
+    if (x == y)
+        return 1;
+    const ir_instr_t *dx = ir_defuse_def(&st->du, x);
+    const ir_instr_t *dy = ir_defuse_def(&st->du, y);
+    return dx && dy && dx->op == IR_PTR_ADD && dy->op == IR_PTR_ADD &&
+           dx->src1 == dy->src1 && dx->src2 == dy->src2 &&
+           dx->imm == dy->imm && dx->type == dy->type;
+}
+
+/*
+ * Return non-zero when the accesses A and B cover exactly the same
+ * bytes.  Loads and stores of one kind share their operand layout
+ * except for the value a store writes.
+ */
+static int same_location(mem_state_t *st, const ir_instr_t *a,
+                         const ir_instr_t *b)
+{
+    if (a->type != b->type || a->imm != b->imm || a->name != b->name)
+        return 0;
+    switch (a->op) {
+    case IR_LOAD: case IR_STORE:
+        return b->op == IR_LOAD || b->op == IR_STORE;
+    case IR_LOAD_PARAM:
+        return b->op == IR_LOAD_PARAM;
+    case IR_LOAD_IDX: case IR_STORE_IDX:
+        return (b->op == IR_LOAD_IDX || b->op == IR_STORE_IDX) &&
+               a->src1 == b->src1;
+    case IR_LOAD_PTR: case IR_STORE_PTR:
+        return (b->op == IR_LOAD_PTR || b->op == IR_STORE_PTR) &&
+               same_address(st, a->src1, b->src1);
+    default:
+        return 0;
+    }
+}
+
+static int is_tracked(const ir_instr_t *ins)
+{
+    return !ins->is_volatile && is_scalar_type(ins->type) &&
+           ins->op != IR_BFLOAD && ins->op != IR_BFSTORE &&
+           ins->op != IR_STORE_PARAM;
+}
+
+/* Forget the available loads WRITE may change */
+static void kill_loads(mem_state_t *st, const ir_instr_t *write)
+{
+    size_t n = 0;
+    for (size_t k = 0; k < st->load_count; k++) {
+        ir_instr_t *l = st->loads[k];
+        int hit = is_call(write->op) ? ir_call_may_access(&st->aa, l)
+                                     : ir_may_alias(&st->aa, write, l);
+        if (!hit)
+            st->loads[n++] = l;
+    }
+    st->load_count = n;
+}
+
+/* Forget the pending stores READ may observe */
+static void keep_stores(mem_state_t *st, const ir_instr_t *read)
+{
+    size_t n = 0;
+    for (size_t k = 0; k < st->store_count; k++) {
+        const ir_instr_t *s = st->stores[k].ins;
+        int hit = is_call(read->op) || read->op == IR_ARG
+                      ? ir_call_may_access(&st->aa, s)
+                      : ir_may_alias(&st->aa, read, s);
+        if (!hit)
+            st->stores[n++] = st->stores[k];
+    }
+    st->store_count = n;
+}
+
+/* Reuse an available load for LOAD or make LOAD available */
+static int reuse_load(mem_state_t *st, ir_instr_t *load)
+{
+    for (size_t k = 0; k < st->load_count; k++) {
+        ir_instr_t *prior = st->loads[k];
+        if (same_location(st, prior, load))
+            return ir_replace_all_uses(&st->du, load->dest, prior->dest);
+    }
+    if (st->load_count == MEM_MAX_TRACKED) {
+        memmove(st->loads, st->loads + 1,
+                (MEM_MAX_TRACKED - 1) * sizeof(*st->loads));
+        st->load_count--;
+    }
+    st->loads[st->load_count++] = load;
+    return 1;
+}
+
+/*
+ * Unlink the pending store K.  POS is the instruction before the store
+ * being added and moves back when it was the removed one.
+ */
+static void drop_store(mem_state_t *st, size_t k, ir_instr_t **pos)
+{
+    ir_instr_t *dead = st->stores[k].ins;
+    ir_instr_t *prev = st->stores[k].prev;
+    prev->next = dead->next;
+    for (size_t j = 0; j < st->store_count; j++)
+        if (st->stores[j].prev == dead)
+            st->stores[j].prev = prev;
+    if (*pos == dead)
+        *pos = prev;
+    st->store_count--;
+    memmove(st->stores + k, st->stores + k + 1,
+            (st->store_count - k) * sizeof(*st->stores));
+    ir_release_instr(st->ir, dead);
+    st->fn->dirty = 1;
+}
+
+static void add_store(mem_state_t *st, ir_instr_t *store, ir_instr_t *prev)
+{
+    for (size_t k = 0; k < st->store_count; k++) {
+        if (same_location(st, st->stores[k].ins, store)) {
+            drop_store(st, k, &prev);
+            break;
+        }
+    }
+    if (st->store_count == MEM_MAX_TRACKED) {
+        st->store_count--;
+        memmove(st->stores, st->stores + 1,
+                st->store_count * sizeof(*st->stores));
+    }
+    st->stores[st->store_count].ins = store;
+    st->stores[st->store_count].prev = prev;
+    st->store_count++;
+}
+
+static int optimize_block(mem_state_t *st, ir_block_t *bb)
+{
+    st->load_count = 0;
+    st->store_count = 0;
+    ir_instr_t *prev = bb->prev;
+    ir_instr_t *stop = bb->last->next;
+    for (ir_instr_t *i = bb->first; i != stop; prev = i, i = i->next) {
+        if (is_memory_free(i->op))
+            continue;
+        if (is_load(i->op)) {
+            keep_stores(st, i);
+            if (is_tracked(i) && i->dest > 0 && !reuse_load(st, i))
+                return 0;
+        } else if (is_store(i->op)) {
+            /* a bit-field store reads the rest of its unit */
+            if (i->op == IR_BFSTORE)
+                keep_stores(st, i);
+            kill_loads(st, i);
+            if (is_tracked(i))
+                add_store(st, i, prev);
+        } else if (is_call(i->op)) {
+            keep_stores(st, i);
+            kill_loads(st, i);
+        } else if (i->op == IR_ARG) {
+            keep_stores(st, i);
+        } else {
+            /* labels, branches, returns and anything unknown */
+            st->load_count = 0;
+            st->store_count = 0;
+        }
+    }
+    return 1;
+}
+
+static int optimize_function(mem_state_t *st)
+{
+    if (!ir_alias_init(&st->aa, st->fn->begin))
+        return 0;
+    int ok = 1;
+    for (size_t b = 0; ok && b < st->fn->block_count; b++)
+        ok = optimize_block(st, &st->fn->blocks[b]);
+    ir_alias_free(&st->aa);
+    return ok;
+}
+
+void opt_memory(ir_builder_t *ir, ir_cfg_t *cfg)
+{
+    if (!ir || !cfg)
+        return;
+
+    mem_state_t st;
+    memset(&st, 0, sizeof(st));
+    st.ir = ir;
+    if (!ir_cfg_refresh(cfg) || !ir_defuse_init(&st.du, ir)) {
+        opt_error("out of memory");
+        return;
+    }
+    for (size_t f = 0; f < cfg->func_count; f++) {
+        st.fn = &cfg->funcs[f];
+        if (st.fn->block_count && !optimize_function(&st)) {
+            opt_error("out of memory");
+            break;
+        }
+    }
+    ir_defuse_free(&st.du);
+}
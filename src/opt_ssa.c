@@ -0,0 +1,805 @@
+/*
+ * SSA construction and destruction.
+ *
+ * opt_mem2reg() turns scalar locals that are only ever loaded and stored
+ * by name into SSA values.  Phi nodes are placed at the iterated
+ * dominance frontier of the blocks storing to a local and the loads are
+ * renamed to the reaching definition while walking the dominator tree.
+ * opt_out_of_ssa() replaces the phis with IR_COPY instructions on the
+ * incoming edges before register allocation, splitting edges that leave
+ * a conditional branch.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "opt.h"
+#include "label.h"
+#include "intern.h"
+
+/* A local considered for promotion */
+typedef struct {
+    const char *name;   /* interned "stack:N" */
+    type_kind_t type;
+    int ok;             /* cleared when the local cannot be promoted */
+    int global;         /* loaded before being stored in some block */
+    size_t stamp;       /* last block storing to the local + 1 */
+} ssa_var_t;
+
+typedef struct {
+    ssa_var_t *vars;
+    size_t count;
+    size_t *map;        /* open addressed name -> index + 1 */
+    size_t cap;         /* power of two */
+} var_table_t;
+
+/* Rename state of one dominator tree walk */
+typedef struct {
+    ir_builder_t *ir;
+    ir_function_t *fn;
+    var_table_t *tab;
+    int *cur;           /* reaching value of every local, 0 when undefined */
+    int *repl;          /* replacement of removed load results */
+    size_t repl_count;
+    int phi_base;       /* first value id used by the placed phis */
+    int phi_count;
+    size_t *phi_var;    /* local of every placed phi */
+    int undef;          /* value used for undefined locals */
+    size_t *undo_var;   /* saved reaching values, restored on the way up */
+    int *undo_val;
+    size_t undo_len;
+    size_t undo_cap;
+} rename_t;
+
+static int is_promotable_type(type_kind_t t)
+{
+    switch (t) {
+    case TYPE_INT: case TYPE_UINT: case TYPE_LONG: case TYPE_ULONG:
+    case TYPE_ENUM: case TYPE_PTR:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int is_local_name(const char *name)
+{
+    return name && strncmp(name, "stack:", 6) == 0;
+}
+
+static size_t name_slot(const char *name, size_t cap)
+{
+    size_t h = (size_t)(uintptr_t)name;
+    h ^= h >> 7;
+    h *= 2654435761u;
+    return (h ^ (h >> 13)) & (cap - 1);
+}
+
+/* Return the table entry for NAME, creating it if needed, or NULL */
+static ssa_var_t *var_get(var_table_t *tab, const char *name, int create)
+{
+    size_t s = name_slot(name, tab->cap);
+    while (tab->map[s]) {
+        ssa_var_t *v = &tab->vars[tab->map[s] - 1];
+        if (v->name == name)
+            return v;
+        s = (s + 1) & (tab->cap - 1);
+    }
+    if (!create)
+        return NULL;
+    ssa_var_t *v = &tab->vars[tab->count++];
+    memset(v, 0, sizeof(*v));
+    v->name = name;
+    tab->map[s] = tab->count;
+    return v;
+}
+
+/* Return the promoted local accessed by INS or NULL */
+static ssa_var_t *promoted_var(var_table_t *tab, const ir_instr_t *ins)
+{
+    if ((ins->op != IR_LOAD && ins->op != IR_STORE) || !is_local_name(ins->name))
+        return NULL;
+    ssa_var_t *v = var_get(tab, ins->name, 0);
+    return v && v->ok ? v : NULL;
+}
+
+/* Return non-zero when INS lies past the end of its function */
+static int at_func_end(const ir_instr_t *ins)
+{
+    return !ins || ins->op == IR_FUNC_END || ins->op == IR_FUNC_BEGIN;
+}
+
+/*
+ * Collect the locals of FN into TAB.  A local qualifies when every
+ * reference is a plain IR_LOAD or IR_STORE of one scalar type.  Returns
+ * the number of promotable locals or -1 on allocation failure.
+ */
+static int collect_vars(ir_function_t *fn, var_table_t *tab)
+{
+    size_t refs = 0;
+    for (ir_instr_t *i = fn->begin->next; !at_func_end(i); i = i->next)
+        if (is_local_name(i->name))
+            refs++;
+    if (!refs)
+        return 0;
+    tab->cap = 8;
+    while (tab->cap < refs * 2)
+        tab->cap *= 2;
+    tab->vars = malloc(refs * sizeof(*tab->vars));
+    tab->map = calloc(tab->cap, sizeof(*tab->map));
+    if (!tab->vars || !tab->map)
+        return -1;
+
+    for (ir_instr_t *i = fn->begin->next; !at_func_end(i); i = i->next) {
+        if (!is_local_name(i->name))
+            continue;
+        int plain = (i->op == IR_LOAD || i->op == IR_STORE) &&
+                    !i->is_volatile && is_promotable_type(i->type);
+        ssa_var_t *v = var_get(tab, i->name, 0);
+        if (!v) {
+            v = var_get(tab, i->name, 1);
+            v->type = i->type;
+            v->ok = plain;
+        } else if (!plain || v->type != i->type) {
+            v->ok = 0;
+        }
+    }
+    int count = 0;
+    for (size_t k = 0; k < tab->count; k++)
+        count += tab->vars[k].ok;
+    return count;
+}
+
+/*
+ * Drop conditional branches to the label directly following them so
+ * every edge into a block is identified by a distinct instruction.
+ */
+static void drop_branches_to_next(ir_builder_t *ir, ir_function_t *fn)
+{
+    ir_instr_t *prev = fn->begin;
+    for (ir_instr_t *i = prev->next; !at_func_end(i); i = prev->next) {
+        if (i->op == IR_BCOND && i->next && i->next->op == IR_LABEL &&
+            i->next->name == i->name) {
+            prev->next = i->next;
+            ir_release_instr(ir, i);
+            continue;
+        }
+        prev = i;
+    }
+}
+
+/*
+ * Compute the dominance frontier of every block of FN as lists stored
+ * in DF with block B's entries in DF[START[B]] .. DF[START[B + 1]].
+ * Returns 0 on allocation failure.
+ */
+static int dominance_frontiers(const ir_function_t *fn, size_t **start_out,
+                               size_t **df_out)
+{
+    size_t n = fn->block_count;
+    size_t *start = calloc(n + 1, sizeof(*start));
+    size_t *mark = malloc(n * sizeof(*mark));
+    size_t *df = NULL;
+    if (!start || !mark)
+        goto fail;
+
+    /* the first pass counts, the second fills in */
+    for (int pass = 0; pass < 2; pass++) {
+        size_t *fill = NULL;
+        if (pass) {
+            for (size_t b = 0; b < n; b++)
+                start[b + 1] += start[b];
+            df = malloc((start[n] ? start[n] : 1) * sizeof(*df));
+            fill = malloc((n ? n : 1) * sizeof(*fill));
+            if (!df || !fill) {
+                free(fill);
+                goto fail;
+            }
+            memcpy(fill, start, n * sizeof(*fill));
+        }
+        for (size_t b = 0; b < n; b++)
+            mark[b] = IR_CFG_NO_BLOCK;
+        for (size_t b = 0; b < n; b++) {
+            const ir_block_t *bb = &fn->blocks[b];
+            if (bb->pred_count < 2 || fn->idom[b] == IR_CFG_NO_BLOCK)
+                continue;
+            for (size_t p = 0; p < bb->pred_count; p++) {
+                size_t r = bb->preds[p];
+                if (r && fn->idom[r] == IR_CFG_NO_BLOCK)
+                    continue;
+                while (r != IR_CFG_NO_BLOCK && r != fn->idom[b]) {
+                    if (mark[r] != b) {
+                        mark[r] = b;
+                        if (pass)
+                            df[fill[r]++] = b;
+                        else
+                            start[r + 1]++;
+                    }
+                    r = fn->idom[r];
+                }
+            }
+        }
+        free(fill);
+    }
+    free(mark);
+    *start_out = start;
+    *df_out = df;
+    return 1;
+
+fail:
+    free(start);
+    free(mark);
+    free(df);
+    return 0;
+}
+
+/*
+ * Record the blocks storing to each promoted local and flag locals that
+ * are live across blocks.  DEFS receives (local, block) pairs grouped by
+ * local with local K's blocks at DEFS[DSTART[K]] .. DEFS[DSTART[K + 1]].
+ */
+static int collect_defs(ir_function_t *fn, var_table_t *tab,
+                        size_t **dstart_out, size_t **defs_out)
+{
+    size_t *dstart = calloc(tab->count + 1, sizeof(*dstart));
+    if (!dstart)
+        return 0;
+    for (int pass = 0; pass < 2; pass++) {
+        size_t *defs = NULL;
+        size_t *fill = NULL;
+        if (pass) {
+            for (size_t k = 0; k < tab->count; k++)
+                dstart[k + 1] += dstart[k];
+            defs = malloc((dstart[tab->count] ? dstart[tab->count] : 1) *
+                          sizeof(*defs));
+            fill = malloc(tab->count * sizeof(*fill));
+            if (!defs || !fill) {
+                free(defs);
+                free(fill);
+                free(dstart);
+                return 0;
+            }
+            memcpy(fill, dstart, tab->count * sizeof(*fill));
+            *defs_out = defs;
+        }
+        for (size_t k = 0; k < tab->count; k++)
+            tab->vars[k].stamp = 0;
+        for (size_t b = 0; b < fn->block_count; b++) {
+            ir_block_t *bb = &fn->blocks[b];
+            for (ir_instr_t *i = bb->first;; i = i->next) {
+                ssa_var_t *v = promoted_var(tab, i);
+                if (v && i->op == IR_LOAD && v->stamp != b + 1)
+                    v->global = 1;
+                if (v && i->op == IR_STORE && v->stamp != b + 1) {
+                    v->stamp = b + 1;
+                    size_t k = (size_t)(v - tab->vars);
+                    if (pass)
+                        defs[fill[k]++] = b;
+                    else
+                        dstart[k + 1]++;
+                }
+                if (i == bb->last)
+                    break;
+            }
+        }
+        free(fill);
+    }
+    *dstart_out = dstart;
+    return 1;
+}
+
+/*
+ * Insert the phis of every local live across blocks.  Returns the
+ * number of phis placed or -1 on allocation failure.
+ */
+static int place_phis(rename_t *st, const size_t *dfstart, const size_t *df,
+                      const size_t *dstart, const size_t *defs)
+{
+    ir_function_t *fn = st->fn;
+    var_table_t *tab = st->tab;
+    size_t n = fn->block_count;
+    size_t *has_phi = malloc(n * sizeof(*has_phi));
+    size_t *queued = malloc(n * sizeof(*queued));
+    size_t *work = malloc(n * sizeof(*work));
+    /* at most one phi per local and block */
+    size_t cap = 0;
+    for (size_t k = 0; k < tab->count; k++)
+        if (tab->vars[k].ok && tab->vars[k].global)
+            cap += n;
+    st->phi_var = malloc((cap ? cap : 1) * sizeof(*st->phi_var));
+    if (!has_phi || !queued || !work || !st->phi_var) {
+        free(has_phi);
+        free(queued);
+        free(work);
+        return -1;
+    }
+    for (size_t b = 0; b < n; b++)
+        has_phi[b] = queued[b] = 0;
+
+    st->phi_base = (int)st->ir->next_value_id;
+    int placed = 0;
+    for (size_t k = 0; k < tab->count; k++) {
+        ssa_var_t *v = &tab->vars[k];
+        if (!v->ok || !v->global)
+            continue;
+        size_t top = 0;
+        for (size_t d = dstart[k]; d < dstart[k + 1]; d++) {
+            queued[defs[d]] = k + 1;
+            work[top++] = defs[d];
+        }
+        while (top) {
+            size_t b = work[--top];
+            for (size_t f = dfstart[b]; f < dfstart[b + 1]; f++) {
+                size_t y = df[f];
+                if (has_phi[y] == k + 1)
+                    continue;
+                has_phi[y] = k + 1;
+                ir_block_t *bb = &fn->blocks[y];
+                ir_instr_t *phi = ir_insert_phi(st->ir, bb->first, v->type,
+                                                bb->pred_count);
+                if (!phi) {
+                    free(has_phi);
+                    free(queued);
+                    free(work);
+                    return -1;
+                }
+                st->phi_var[placed++] = k;
+                if (queued[y] != k + 1) {
+                    queued[y] = k + 1;
+                    work[top++] = y;
+                }
+            }
+        }
+    }
+    st->phi_count = placed;
+    free(has_phi);
+    free(queued);
+    free(work);
+    return placed;
+}
+
+/* Return the local defined by PHI or -1 for phis placed elsewhere */
+static long phi_local(const rename_t *st, const ir_instr_t *phi)
+{
+    if (phi->dest < st->phi_base || phi->dest >= st->phi_base + st->phi_count)
+        return -1;
+    return (long)st->phi_var[phi->dest - st->phi_base];
+}
+
+static int reaching(const rename_t *st, size_t k)
+{
+    return st->cur[k] ? st->cur[k] : st->undef;
+}
+
+static int push_def(rename_t *st, size_t k, int value)
+{
+    if (st->undo_len == st->undo_cap) {
+        size_t cap = st->undo_cap ? st->undo_cap * 2 : 64;
+        size_t *vars = realloc(st->undo_var, cap * sizeof(*vars));
+        if (!vars)
+            return 0;
+        st->undo_var = vars;
+        int *vals = realloc(st->undo_val, cap * sizeof(*vals));
+        if (!vals)
+            return 0;
+        st->undo_val = vals;
+        st->undo_cap = cap;
+    }
+    st->undo_var[st->undo_len] = k;
+    st->undo_val[st->undo_len++] = st->cur[k];
+    st->cur[k] = value;
+    return 1;
+}
+
+static int resolve(const rename_t *st, int value)
+{
+    if (value > 0 && (size_t)value < st->repl_count && st->repl[value])
+        return st->repl[value];
+    return value;
+}
+
+/* Rename the loads and stores of block B and fill in successor phis */
+static int rename_block(rename_t *st, size_t b)
+{
+    ir_function_t *fn = st->fn;
+    ir_block_t *bb = &fn->blocks[b];
+    ir_instr_t *term = bb->last;
+    if (term->op != IR_BR && term->op != IR_BCOND)
+        term = NULL;
+
+    ir_instr_t *prev = bb->prev;
+    ir_instr_t *stop = bb->last->next;
+    for (ir_instr_t *i = bb->first; i != stop; i = prev->next) {
+        if (i->op == IR_PHI) {
+            long k = phi_local(st, i);
+            if (k >= 0 && !push_def(st, (size_t)k, i->dest))
+                return 0;
+            prev = i;
+            continue;
+        }
+        if (ir_has_value_operands(i)) {
+            i->src1 = resolve(st, i->src1);
+            i->src2 = resolve(st, i->src2);
+        }
+        ssa_var_t *v = promoted_var(st->tab, i);
+        if (!v) {
+            prev = i;
+            continue;
+        }
+        size_t k = (size_t)(v - st->tab->vars);
+        if (i->op == IR_LOAD)
+            st->repl[i->dest] = reaching(st, k);
+        else if (!push_def(st, k, i->src1))
+            return 0;
+        prev->next = i->next;
+        if (st->ir->tail == i)
+            st->ir->tail = prev;
+        ir_release_instr(st->ir, i);
+    }
+
+    for (size_t s = 0; s < bb->succ_count; s++) {
+        ir_block_t *succ = &fn->blocks[bb->succs[s]];
+        if (!succ->label)
+            continue;
+        ir_instr_t *key = term && term->name == succ->label ? term : NULL;
+        for (ir_instr_t *i = succ->first->next; i && i->op == IR_PHI;
+             i = i->next) {
+            long k = phi_local(st, i);
+            if (k >= 0)
+                ir_phi_add_arg(i, reaching(st, (size_t)k), key);
+        }
+    }
+    return 1;
+}
+
+/* Walk the dominator tree of the function renaming every block */
+static int rename_function(rename_t *st)
+{
+    ir_function_t *fn = st->fn;
+    size_t n = fn->block_count;
+    size_t *stack = malloc(n * sizeof(*stack));
+    size_t *next = malloc(n * sizeof(*next));
+    size_t *mark = malloc(n * sizeof(*mark));
+    int ok = stack && next && mark;
+    if (ok) {
+        size_t top = 0;
+        stack[top++] = 0;
+        next[0] = fn->dom_start[0];
+        mark[0] = st->undo_len;
+        ok = rename_block(st, 0);
+        while (ok && top) {
+            size_t b = stack[top - 1];
+            if (next[b] < fn->dom_start[b + 1]) {
+                size_t c = fn->dom_child[next[b]++];
+                next[c] = fn->dom_start[c];
+                mark[c] = st->undo_len;
+                stack[top++] = c;
+                ok = rename_block(st, c);
+                continue;
+            }
+            while (st->undo_len > mark[b]) {
+                st->undo_len--;
+                st->cur[st->undo_var[st->undo_len]] = st->undo_val[st->undo_len];
+            }
+            top--;
+        }
+    }
+    free(stack);
+    free(next);
+    free(mark);
+    return ok;
+}
+
+/*
+ * Redirect remaining uses of removed loads and delete phis whose result
+ * is never needed.  Returns 0 on allocation failure.
+ */
+static int finish_function(rename_t *st)
+{
+    ir_builder_t *ir = st->ir;
+    ir_function_t *fn = st->fn;
+    size_t max_id = ir->next_value_id;
+    unsigned char *live = calloc(max_id, 1);
+    if (!live)
+        return 0;
+    for (ir_instr_t *i = fn->begin->next; !at_func_end(i); i = i->next) {
+        if (i->op == IR_PHI || !ir_has_value_operands(i))
+            continue;
+        i->src1 = resolve(st, i->src1);
+        i->src2 = resolve(st, i->src2);
+        if (i->src1 > 0 && (size_t)i->src1 < max_id)
+            live[i->src1] = 1;
+        if (i->src2 > 0 && (size_t)i->src2 < max_id)
+            live[i->src2] = 1;
+    }
+
+    /* a phi is needed when anything other than a dead phi uses it */
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (ir_instr_t *i = fn->begin->next; !at_func_end(i); i = i->next) {
+            if (i->op != IR_PHI || !live[i->dest])
+                continue;
+            ir_phi_arg_t *args = ir_phi_args(i);
+            for (long long a = 0; a < i->imm; a++) {
+                int v = args[a].value;
+                if (v > 0 && (size_t)v < max_id && !live[v]) {
+                    live[v] = 1;
+                    changed = 1;
+                }
+            }
+        }
+    }
+
+    ir_instr_t *prev = fn->begin;
+    for (ir_instr_t *i = prev->next; !at_func_end(i); i = prev->next) {
+        if (i->op == IR_PHI && !live[i->dest]) {
+            prev->next = i->next;
+            if (ir->tail == i)
+                ir->tail = prev;
+            ir_release_instr(ir, i);
+            continue;
+        }
+        prev = i;
+    }
+    free(live);
+    return 1;
+}
+
+/* Promote the locals of FN.  Returns 0 on allocation failure. */
+static int promote_function(ir_builder_t *ir, ir_function_t *fn)
+{
+    var_table_t tab = {0};
+    rename_t st;
+    memset(&st, 0, sizeof(st));
+    size_t *dfstart = NULL, *df = NULL, *dstart = NULL, *defs = NULL;
+    int ok = 0;
+
+    int found = collect_vars(fn, &tab);
+    if (found <= 0) {
+        ok = found == 0;
+        goto done;
+    }
+
+    /*
+     * Value standing in for locals read before any store.  It also keeps
+     * the entry block free of labels and therefore of predecessors.
+     */
+    ir_instr_t *undef = ir_insert_after(ir, fn->begin);
+    if (!undef)
+        goto done;
+    undef->op = IR_CONST;
+    undef->dest = (int)ir->next_value_id++;
+    undef->type = TYPE_INT;
+    undef->imm = 0;
+    drop_branches_to_next(ir, fn);
+    if (!ir_cfg_rebuild_function(fn) || !ir_cfg_dominators(fn))
+        goto done;
+
+    st.ir = ir;
+    st.fn = fn;
+    st.tab = &tab;
+    st.undef = undef->dest;
+    if (!dominance_frontiers(fn, &dfstart, &df) ||
+        !collect_defs(fn, &tab, &dstart, &defs) ||
+        place_phis(&st, dfstart, df, dstart, defs) < 0)
+        goto done;
+    /* the phis only extend block ranges, the dominator tree is unchanged */
+    if (!ir_cfg_rebuild_function(fn) || !ir_cfg_dominators(fn))
+        goto done;
+
+    st.cur = calloc(tab.count, sizeof(*st.cur));
+    st.repl_count = ir->next_value_id;
+    st.repl = calloc(st.repl_count, sizeof(*st.repl));
+    if (!st.cur || !st.repl || !rename_function(&st) || !finish_function(&st))
+        goto done;
+    fn->begin->src1 |= IR_FUNC_PROMOTED;
+    ok = ir_cfg_rebuild_function(fn);
+
+done:
+    free(tab.vars);
+    free(tab.map);
+    free(dfstart);
+    free(df);
+    free(dstart);
+    free(defs);
+    free(st.phi_var);
+    free(st.cur);
+    free(st.repl);
+    free(st.undo_var);
+    free(st.undo_val);
+    return ok;
+}
+
+void opt_mem2reg(ir_builder_t *ir, ir_cfg_t *cfg)
+{
+    if (!ir || !cfg)
+        return;
+    for (size_t f = 0; f < cfg->func_count; f++) {
+        ir_function_t *fn = &cfg->funcs[f];
+        if (!fn->block_count)
+            continue;
+        if (!promote_function(ir, fn)) {
+            opt_error("out of memory");
+            return;
+        }
+    }
+}
+
+/* Return the argument of PHI flowing in along the edge named by KEY */
+static int phi_incoming(const ir_instr_t *phi, const ir_instr_t *key,
+                        const ir_instr_t *alt)
+{
+    ir_phi_arg_t *args = ir_phi_args(phi);
+    for (long long a = 0; a < phi->imm; a++)
+        if (args[a].pred == key)
+            return args[a].value;
+    for (long long a = 0; alt && a < phi->imm; a++)
+        if (args[a].pred == alt)
+            return args[a].value;
+    return 0;
+}
+
+/*
+ * Insert the copies for one incoming edge after POS and return the last
+ * instruction inserted.  Sources that are themselves results of the
+ * block's phis are read into temporaries first so the copies behave as
+ * if they all happened at once.
+ */
+static ir_instr_t *emit_edge_copies(ir_builder_t *ir, ir_instr_t *pos,
+                                    ir_instr_t **phis, int *tmp, size_t count,
+                                    const ir_instr_t *key,
+                                    const ir_instr_t *alt)
+{
+    for (size_t p = 0; p < count; p++) {
+        int src = phi_incoming(phis[p], key, alt);
+        tmp[p] = src;
+        for (size_t q = 0; src && q < count; q++) {
+            if (q != p && phis[q]->dest == src) {
+                int t = (int)ir->next_value_id++;
+                ir_instr_t *c = ir_insert_copy(ir, pos, t, src, phis[p]->type);
+                if (!c)
+                    return NULL;
+                pos = c;
+                tmp[p] = t;
+                break;
+            }
+        }
+    }
+    for (size_t p = 0; p < count; p++) {
+        if (!tmp[p] || tmp[p] == phis[p]->dest)
+            continue;
+        ir_instr_t *c = ir_insert_copy(ir, pos, phis[p]->dest, tmp[p],
+                                       phis[p]->type);
+        if (!c)
+            return NULL;
+        pos = c;
+    }
+    return pos;
+}
+
+static ir_instr_t *insert_branch(ir_builder_t *ir, ir_instr_t *pos,
+                                 ir_op_t op, const char *label)
+{
+    ir_instr_t *ins = ir_insert_after(ir, pos);
+    if (ins) {
+        ins->op = op;
+        ins->name = label;
+    }
+    return ins;
+}
+
+/* Replace the phis of block H by copies on its incoming edges */
+static int lower_block_phis(ir_builder_t *ir, ir_function_t *fn, size_t h,
+                            ir_instr_t **phis, int *tmp, size_t count)
+{
+    ir_block_t *hb = &fn->blocks[h];
+    ir_instr_t *pos = hb->prev;
+    int falls = 0;
+    for (size_t p = 0; p < hb->pred_count; p++)
+        if (hb->preds[p] + 1 == h && fn->blocks[h - 1].last->op != IR_BR)
+            falls = 1;
+    if (falls) {
+        /* a conditional branch to the next block uses both edges */
+        ir_instr_t *alt = NULL;
+        if (fn->blocks[h - 1].last->op == IR_BCOND)
+            alt = fn->blocks[h - 1].last;
+        pos = emit_edge_copies(ir, pos, phis, tmp, count, NULL, alt);
+        if (!pos)
+            return 0;
+    }
+
+    int split = 0;
+    for (size_t p = 0; p < hb->pred_count; p++) {
+        ir_block_t *pb = &fn->blocks[hb->preds[p]];
+        ir_instr_t *term = pb->last;
+        if (term->name != hb->label)
+            continue;
+        if (term->op == IR_BR) {
+            ir_instr_t *before = pb->prev;
+            while (before->next != term)
+                before = before->next;
+            if (!emit_edge_copies(ir, before, phis, tmp, count, term, NULL))
+                return 0;
+        } else if (term->op == IR_BCOND) {
+            /* the edge is critical: route it through a block of its own */
+            char buf[32];
+            const char *name = label_format("Lssa", label_next_id(), buf);
+            if (!name)
+                return 0;
+            if (falls && !split) {
+                pos = insert_branch(ir, pos, IR_BR, hb->label);
+                if (!pos)
+                    return 0;
+            }
+            split = 1;
+            ir_instr_t *lab = insert_branch(ir, pos, IR_LABEL, intern_str(name));
+            if (!lab)
+                return 0;
+            term->name = lab->name;
+            pos = emit_edge_copies(ir, lab, phis, tmp, count, term, NULL);
+            if (!pos)
+                return 0;
+            pos = insert_branch(ir, pos, IR_BR, hb->label);
+            if (!pos)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/* Lower the phis of FN.  Returns 0 on allocation failure. */
+static int lower_function(ir_builder_t *ir, ir_function_t *fn)
+{
+    size_t count = 0;
+    for (ir_instr_t *i = fn->begin->next; !at_func_end(i); i = i->next)
+        if (i->op == IR_PHI)
+            count++;
+    if (!count)
+        return 1;
+    ir_instr_t **phis = malloc(count * sizeof(*phis));
+    int *tmp = malloc(count * sizeof(*tmp));
+    int ok = phis && tmp && ir_cfg_rebuild_function(fn);
+    for (size_t h = 0; ok && h < fn->block_count; h++) {
+        ir_block_t *hb = &fn->blocks[h];
+        if (!hb->label)
+            continue;
+        size_t n = 0;
+        for (ir_instr_t *i = hb->first->next; i && i->op == IR_PHI; i = i->next)
+            phis[n++] = i;
+        if (n)
+            ok = lower_block_phis(ir, fn, h, phis, tmp, n);
+    }
+    free(phis);
+    free(tmp);
+    if (!ok)
+        return 0;
+
+    ir_instr_t *prev = fn->begin;
+    for (ir_instr_t *i = prev->next; !at_func_end(i); i = prev->next) {
+        if (i->op == IR_PHI) {
+            prev->next = i->next;
+            if (ir->tail == i)
+                ir->tail = prev;
+            ir_release_instr(ir, i);
+            continue;
+        }
+        prev = i;
+    }
+    return ir_cfg_rebuild_function(fn);
+}
+
+void opt_out_of_ssa(ir_builder_t *ir, ir_cfg_t *cfg)
+{
+    if (!ir || !cfg)
+        return;
+    for (size_t f = 0; f < cfg->func_count; f++) {
+        if (!lower_function(ir, &cfg->funcs[f])) {
+            opt_error("out of memory");
+            return;
+        }
+    }
+}
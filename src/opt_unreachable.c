@@ -1,6 +1,9 @@
 /*
  * Unreachable block elimination pass.
  *
+ * Blocks not reachable from the entry block of their function are
+ * removed, including loops that are only entered from dead code.
+ *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
  */
@@ -10,133 +13,76 @@
 #include "opt.h"
 #include "util.h"
 
-/* Simple array for storing referenced labels */
-typedef struct label_ref {
-    char *name;
-    struct label_ref *next;
-} label_ref_t;
-
-static int label_referenced(label_ref_t *list, const char *name)
-{
-    for (; list; list = list->next)
-        if (strcmp(list->name, name) == 0)
-            return 1;
-    return 0;
-}
-
-static void free_label_refs(label_ref_t *list)
+/* Mark every block reachable from the entry of FN in SEEN */
+static int mark_reachable(const ir_function_t *fn, unsigned char *seen)
 {
-    while (list) {
-        label_ref_t *n = list->next;
-        free(list->name);
-        free(list);
-        list = n;
+    size_t *stack = malloc(fn->block_count * sizeof(*stack));
+    if (!stack)
+        return 0;
+    size_t top = 0;
+    stack[top++] = 0;
+    seen[0] = 1;
+    while (top) {
+        const ir_block_t *bb = &fn->blocks[stack[--top]];
+        for (size_t s = 0; s < bb->succ_count; s++) {
+            size_t id = bb->succs[s];
+            if (!seen[id]) {
+                seen[id] = 1;
+                stack[top++] = id;
+            }
+        }
     }
+    free(stack);
+    return 1;
 }
 
-/* Remove unreachable instructions within functions */
-void remove_unreachable_blocks(ir_builder_t *ir)
+/* Unlink and release the unreachable blocks of FN */
+static int remove_function_blocks(ir_builder_t *ir, ir_function_t *fn)
 {
-    if (!ir)
-        return;
-
-    label_ref_t *labels = NULL;
-    label_ref_t **label_tail = &labels;
+    if (fn->block_count < 2)
+        return 1;
+    unsigned char *seen = calloc(fn->block_count, 1);
+    if (!seen || !mark_reachable(fn, seen)) {
+        free(seen);
+        return 0;
+    }
 
-    /* collect all branch target labels */
-    for (ir_instr_t *ins = ir->head; ins; ins = ins->next) {
-        if (ins->op == IR_BR || ins->op == IR_BCOND) {
-            label_ref_t *e = malloc(sizeof(*e));
-            if (!e) {
-                opt_error("out of memory");
-                free_label_refs(labels);
-                return;
-            }
-            e->name = vc_strdup(ins->name ? ins->name : "");
-            if (!e->name) {
-                opt_error("out of memory");
-                free(e);
-                free_label_refs(labels);
-                return;
-            }
-            e->next = NULL;
-            *label_tail = e;
-            label_tail = &e->next;
+    int changed = 0;
+    ir_instr_t *keep = fn->begin;
+    for (size_t i = 0; i < fn->block_count; i++) {
+        ir_block_t *bb = &fn->blocks[i];
+        if (seen[i]) {
+            keep = bb->last;
+            continue;
+        }
+        ir_instr_t *stop = bb->last->next;
+        if (ir->tail == bb->last)
+            ir->tail = keep;
+        for (ir_instr_t *ins = bb->first; ins != stop;) {
+            ir_instr_t *next = ins->next;
+            ir_release_instr(ir, ins);
+            ins = next;
         }
+        keep->next = stop;
+        changed = 1;
     }
+    free(seen);
 
-    int in_func = 0;
-    int reachable = 1;
-    ir_instr_t *prev = NULL;
-    ir_instr_t *cur = ir->head;
+    if (changed)
+        return ir_cfg_rebuild_function(fn);
+    return 1;
+}
 
-    while (cur) {
-        ir_instr_t *next = cur->next;
+/* Remove unreachable instructions within functions */
+void remove_unreachable_blocks(ir_builder_t *ir, ir_cfg_t *cfg)
+{
+    if (!ir || !cfg)
+        return;
 
-        switch (cur->op) {
-        case IR_FUNC_BEGIN:
-            in_func = 1;
-            reachable = 1;
-            prev = cur;
-            break;
-        case IR_FUNC_END:
-            in_func = 0;
-            reachable = 1;
-            prev = cur;
-            break;
-        case IR_BR:
-            reachable = 0;
-            prev = cur;
-            break;
-        case IR_RETURN:
-        case IR_RETURN_AGG:
-        case IR_CALL_NR:
-        case IR_CALL_PTR_NR:
-            reachable = 0;
-            prev = cur;
-            break;
-        case IR_BCOND:
-            /* record already done */
-            prev = cur;
-            break;
-        case IR_LABEL:
-            if (label_referenced(labels, cur->name))
-                reachable = 1;
-            if (!reachable) {
-                if (prev)
-                    prev->next = next;
-                else
-                    ir->head = next;
-                if (ir->tail == cur)
-                    ir->tail = prev;
-                free(cur->name);
-                free(cur->data);
-                free(cur);
-                cur = prev; /* compensate for increment */
-            } else {
-                prev = cur;
-            }
-            break;
-        default:
-            if (in_func && !reachable) {
-                if (prev)
-                    prev->next = next;
-                else
-                    ir->head = next;
-                if (ir->tail == cur)
-                    ir->tail = prev;
-                free(cur->name);
-                free(cur->data);
-                free(cur);
-                cur = prev; /* stay */
-            } else {
-                prev = cur;
-            }
-            break;
+    for (size_t i = 0; i < cfg->func_count; i++) {
+        if (!remove_function_blocks(ir, &cfg->funcs[i])) {
+            opt_error("out of memory");
+            return;
         }
-
-        cur = next;
     }
-
-    free_label_refs(labels);
 }
@@ -196,7 +196,7 @@ static int parse_param_decl(parser_t *p, symtable_t *symtab,
         return 0;
     }
     p->pos++;
-    char *tmp_name = ptok->lexeme;
+    const char *tmp_name = ptok->lexeme;
 
     if (!vector_push(names_v, &tmp_name) ||
         !vector_push(types_v, &pt) ||
@@ -324,7 +324,7 @@ func_t *parser_parse_func(parser_t *p, symtable_t *symtab,
     if (!tok || tok->type != TOK_IDENT)
         return NULL;
     p->pos++;
-    char *name = tok->lexeme;
+    const char *name = tok->lexeme;
 
     char **param_names = NULL;
     type_kind_t *param_types = NULL;
@@ -20,7 +20,7 @@ stmt_t *parser_parse_enum_decl(parser_t *p)
 {
     token_t *kw = &p->tokens[p->pos - 1];
     token_t *tok = peek(p);
-    char *tag = NULL;
+    const char *tag = NULL;
     if (tok && tok->type == TOK_IDENT) {
         p->pos++;
         tag = tok->lexeme;
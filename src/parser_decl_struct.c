@@ -214,7 +214,7 @@ static stmt_t *parse_aggr_var_decl(parser_t *p, int is_union)
     if (!name_tok || name_tok->type != TOK_IDENT)
         goto fail;
     p->pos++;
-    char *name = name_tok->lexeme;
+    const char *name = name_tok->lexeme;
     if (!match(p, TOK_SEMI))
         goto fail;
 
@@ -258,7 +258,7 @@ stmt_t *parser_parse_union_decl(parser_t *p)
     if (!tok || tok->type != TOK_IDENT)
         return NULL;
     p->pos++;
-    char *tag = tok->lexeme;
+    const char *tag = tok->lexeme;
     if (!match(p, TOK_LBRACE))
         return NULL;
 
@@ -297,7 +297,7 @@ stmt_t *parser_parse_struct_decl(parser_t *p)
     if (!tok || tok->type != TOK_IDENT)
         return NULL;
     p->pos++;
-    char *tag = tok->lexeme;
+    const char *tag = tok->lexeme;
     if (!match(p, TOK_LBRACE))
         return NULL;
 
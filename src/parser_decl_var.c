@@ -48,7 +48,7 @@ static int parse_decl_specs(parser_t *p, int *is_extern, int *is_static,
 static void parse_pointer_suffix(parser_t *p, type_kind_t *type,
                                  int *is_restrict);
 static void parse_align_spec(parser_t *p, expr_t **align_expr);
-static int parse_array_suffix(parser_t *p, type_kind_t *type, char **name,
+static int parse_array_suffix(parser_t *p, type_kind_t *type, const char **name,
                               size_t *arr_size, expr_t **size_expr);
 static int parse_braced_initializer(parser_t *p, init_entry_t **init_list,
                                     size_t *init_count);
@@ -139,7 +139,7 @@ static int parse_decl_specs(parser_t *p, int *is_extern, int *is_static,
 }
 
 /* Parse the identifier and optional array size suffix. */
-static int parse_array_suffix(parser_t *p, type_kind_t *type, char **name,
+static int parse_array_suffix(parser_t *p, type_kind_t *type, const char **name,
                               size_t *arr_size, expr_t **size_expr)
 {
     token_t *tok = peek(p);
@@ -258,7 +258,7 @@ stmt_t *parser_parse_static_assert(parser_t *p)
         return NULL;
     }
     p->pos++;
-    char *str = msg->lexeme;
+    const char *str = msg->lexeme;
     if (!match(p, TOK_RPAREN) || !match(p, TOK_SEMI)) {
         ast_free_expr(expr);
         return NULL;
@@ -288,7 +288,7 @@ stmt_t *parser_parse_var_decl(parser_t *p)
     type_kind_t decl_type_base = t;
     while (1) {
         type_kind_t dt = decl_type_base;
-        char *name;
+        const char *name;
         size_t arr_size;
         expr_t *size_expr;
         type_kind_t *param_types = NULL;
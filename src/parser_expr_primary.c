@@ -95,7 +95,7 @@ static expr_t *parse_identifier_expr(parser_t *p)
             return parse_offsetof(p);
         }
         p->pos++; /* consume identifier */
-        char *name = tok->lexeme;
+        const char *name = tok->lexeme;
         vector_t args_v;
         if (!parse_argument_list(p, &args_v))
             return NULL;
@@ -217,7 +217,7 @@ static stmt_t *parse_jump_stmt(parser_t *p)
         if (!id || id->type != TOK_IDENT)
             return NULL;
         p->pos++;
-        char *name = id->lexeme;
+        const char *name = id->lexeme;
         if (!match(p, TOK_SEMI))
             return NULL;
         return ast_make_goto(name, kw_tok->line, kw_tok->column);
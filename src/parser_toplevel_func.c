@@ -336,6 +336,8 @@ int parse_function_or_var(parser_t *p, symtable_t *funcs,
 
     if (parse_function_prototype(p, funcs, name, t, tag_name,
                                  spec_pos, is_inline, is_noreturn, out_func)) {
+        if (out_func && *out_func)
+            (*out_func)->is_static = is_static;
         free(tag_name);
         return 1;
     }
@@ -110,7 +110,7 @@ size_t basic_type_size(type_kind_t t)
 }
 
 /* Attempt to parse a function pointer suffix like '(*name)(int, float)'. */
-int parse_func_ptr_suffix(parser_t *p, char **name,
+int parse_func_ptr_suffix(parser_t *p, const char **name,
                           type_kind_t **param_types, size_t *param_count,
                           int *is_variadic)
 {
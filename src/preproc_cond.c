@@ -15,7 +15,7 @@
 
 /* Push a new state for #ifdef/#ifndef directives.  When "neg" is non-zero
  * the condition is inverted as for #ifndef. */
-int cond_push_ifdef_common(char *line, vector_t *macros,
+int cond_push_ifdef_common(char *line, macro_table_t *macros,
                            vector_t *conds, int neg,
                            preproc_context_t *ctx)
 {
@@ -44,21 +44,21 @@ int cond_push_ifdef_common(char *line, vector_t *macros,
 }
 
 /* Push a new state for an #ifdef directive */
-int cond_push_ifdef(char *line, vector_t *macros, vector_t *conds,
+int cond_push_ifdef(char *line, macro_table_t *macros, vector_t *conds,
                     preproc_context_t *ctx)
 {
     return cond_push_ifdef_common(line, macros, conds, 0, ctx);
 }
 
 /* Push a new state for an #ifndef directive */
-int cond_push_ifndef(char *line, vector_t *macros, vector_t *conds,
+int cond_push_ifndef(char *line, macro_table_t *macros, vector_t *conds,
                      preproc_context_t *ctx)
 {
     return cond_push_ifdef_common(line, macros, conds, 1, ctx);
 }
 
 /* Expand macros in a conditional expression except within defined() */
-static int expand_cond_expr(const char *expr, vector_t *macros, strbuf_t *out,
+static int expand_cond_expr(const char *expr, macro_table_t *macros, strbuf_t *out,
                             preproc_context_t *ctx)
 {
     strbuf_init(out);
@@ -142,7 +142,7 @@ static int expand_cond_expr(const char *expr, vector_t *macros, strbuf_t *out,
 }
 
 /* Push a new state for a generic #if expression */
-int cond_push_ifexpr(char *line, const char *dir, vector_t *macros,
+int cond_push_ifexpr(char *line, const char *dir, macro_table_t *macros,
                      vector_t *conds, const vector_t *incdirs, vector_t *stack,
                      preproc_context_t *ctx)
 {
@@ -171,7 +171,7 @@ int cond_push_ifexpr(char *line, const char *dir, vector_t *macros,
 }
 
 /* Handle an #elif directive */
-void cond_handle_elif(char *line, const char *dir, vector_t *macros,
+void cond_handle_elif(char *line, const char *dir, macro_table_t *macros,
                       vector_t *conds, const vector_t *incdirs,
                       vector_t *stack, preproc_context_t *ctx)
 {
@@ -223,7 +223,7 @@ void cond_handle_endif(vector_t *conds)
 }
 
 /* Dispatch conditional directives to the specific helper handlers. */
-int handle_conditional(char *line, const char *dir, vector_t *macros,
+int handle_conditional(char *line, const char *dir, macro_table_t *macros,
                        vector_t *conds, const vector_t *incdirs,
                        vector_t *stack, preproc_context_t *ctx)
 {
@@ -75,21 +75,21 @@ static void strip_comments(char *s, int *in_comment)
 
 
 /* forward declaration for recursive include handling */
-int process_file(const char *path, vector_t *macros,
+int process_file(const char *path, macro_table_t *macros,
                         vector_t *conds, strbuf_t *out,
                         const vector_t *incdirs, vector_t *stack,
                         preproc_context_t *ctx, size_t idx);
 
 /* Small helpers used by process_file */
 
-static int handle_directive(char *line, const char *dir, vector_t *macros,
+static int handle_directive(char *line, const char *dir, macro_table_t *macros,
                             vector_t *conds, strbuf_t *out,
                             const vector_t *incdirs, vector_t *stack,
                             preproc_context_t *ctx);
 
 /* Process one line of input.  Leading whitespace is skipped before
  * dispatching to the directive handlers. */
-int process_line(char *line, const char *dir, vector_t *macros,
+int process_line(char *line, const char *dir, macro_table_t *macros,
                         vector_t *conds, strbuf_t *out,
                         const vector_t *incdirs, vector_t *stack,
                         preproc_context_t *ctx)
@@ -111,7 +111,7 @@ int process_line(char *line, const char *dir, vector_t *macros,
 }
 
 /* Remove a macro defined earlier when #undef is seen. */
-static int handle_undef_directive(char *line, const char *dir, vector_t *macros,
+static int handle_undef_directive(char *line, const char *dir, macro_table_t *macros,
                                   vector_t *conds, strbuf_t *out,
                                   const vector_t *incdirs,
                                   vector_t *stack,
@@ -131,7 +131,7 @@ static int handle_undef_directive(char *line, const char *dir, vector_t *macros,
 
 /* Emit an error message and abort preprocessing when active. */
 static int handle_error_directive(char *line, const char *dir,
-                                  vector_t *macros, vector_t *conds,
+                                  macro_table_t *macros, vector_t *conds,
                                   strbuf_t *out,
                                   const vector_t *incdirs,
                                   vector_t *stack,
@@ -164,7 +164,7 @@ static int handle_error_directive(char *line, const char *dir,
 
 /* Emit a warning message but continue preprocessing when active. */
 static int handle_warning_directive(char *line, const char *dir,
-                                    vector_t *macros, vector_t *conds,
+                                    macro_table_t *macros, vector_t *conds,
                                     strbuf_t *out,
                                     const vector_t *incdirs,
                                     vector_t *stack,
@@ -181,7 +181,7 @@ static int handle_warning_directive(char *line, const char *dir,
     return 1;
 }
 
-int handle_pragma_directive(char *line, const char *dir, vector_t *macros,
+int handle_pragma_directive(char *line, const char *dir, macro_table_t *macros,
                             vector_t *conds, strbuf_t *out,
                             const vector_t *incdirs, vector_t *stack,
                             preproc_context_t *ctx)
@@ -301,7 +301,7 @@ int handle_pragma_directive(char *line, const char *dir, vector_t *macros,
 
 /* Update conditional state based on #if/#else/#endif directives. */
 static int handle_conditional_directive(char *line, const char *dir,
-                                        vector_t *macros, vector_t *conds,
+                                        macro_table_t *macros, vector_t *conds,
                                         strbuf_t *out,
                                         const vector_t *incdirs,
                                         vector_t *stack,
@@ -311,29 +311,96 @@ static int handle_conditional_directive(char *line, const char *dir,
     return handle_conditional(line, dir, macros, conds, incdirs, stack, ctx);
 }
 
+/*
+ * Return the line after the current one when it is a text line a macro
+ * call may continue on, otherwise NULL.
+ */
+static char *next_text_line(preproc_context_t *ctx)
+{
+    if (!ctx->lines)
+        return NULL;
+    char *next = ctx->lines[ctx->line_index + 1];
+    if (!next || (!ctx->in_comment && *skip_ws(next) == '#'))
+        return NULL;
+    return next;
+}
+
+/*
+ * Expand the tokens of LINE into RES.  A macro call whose arguments
+ * continue on the following text lines takes those lines along; their
+ * number is stored in JOINED.
+ */
+static int expand_text_line(char *line, macro_table_t *macros, vector_t *res,
+                            size_t *joined, preproc_context_t *ctx)
+{
+    vector_t toks, held;
+    vector_init(&toks, sizeof(pp_token_t));
+    vector_init(&held, sizeof(pp_token_t));
+    *joined = 0;
+    int ok = pp_lex(line, &toks);
+    while (ok) {
+        char *next = next_text_line(ctx);
+        held.count = 0;
+        ok = expand_open_token_list(toks.data, toks.count, macros, res,
+                                    next ? &held : NULL, ctx);
+        if (!ok || !held.count)
+            break;
+        ctx->line_index++;
+        (*joined)++;
+        long line_no = (long)(ctx->line_index + 1) + ctx->line_delta;
+        preproc_set_location(ctx, ctx->file,
+                             line_no < 0 ? 0 : (size_t)line_no, 1);
+        strip_comments(next, &ctx->in_comment);
+        toks.count = 0;
+        for (size_t i = 0; ok && i < held.count; i++) {
+            if (!vector_push(&toks, &((pp_token_t *)held.data)[i])) {
+                vc_oom();
+                ok = 0;
+            }
+        }
+        ok = ok && pp_lex(next, &toks);
+    }
+    vector_free(&toks);
+    vector_free(&held);
+    return ok;
+}
+
 /*
  * Expand a regular text line and append it to the output when the current
  * conditional stack is active.
  */
-static int handle_text_line(char *line, const char *dir, vector_t *macros,
+static int handle_text_line(char *line, const char *dir, macro_table_t *macros,
                             vector_t *conds, strbuf_t *out,
                             const vector_t *incdirs, vector_t *stack,
                             preproc_context_t *ctx)
 {
-    (void)dir; (void)incdirs; (void)stack; (void)ctx;
-    int ok = 1;
-    if (is_active(conds)) {
-        strbuf_t tmp;
-        strbuf_init(&tmp);
-        if (!expand_line(line, macros, &tmp, 0, 0, ctx)) {
-            ok = 0;
-        } else if (strbuf_append(&tmp, "\n") != 0) {
-            ok = 0;
-        }
-        if (ok && strbuf_append(out, tmp.data) != 0)
+    (void)dir; (void)incdirs; (void)stack;
+    if (!is_active(conds))
+        return 1;
+
+    vector_t res;
+    size_t joined;
+    vector_init(&res, sizeof(pp_token_t));
+    int ok = expand_text_line(line, macros, &res, &joined, ctx);
+    if (ok && ctx->tokens) {
+        /* text from earlier directives comes first */
+        if (out->len && !lexer_stream_feed(ctx->tokens, out->data))
             ok = 0;
-        strbuf_free(&tmp);
+        out->len = 0;
+        out->data[0] = '\0';
+        ok = ok && pp_emit_line(ctx->tokens, res.data, res.count);
+        /* keep the line numbers of the lines a call took along */
+        for (size_t i = 0; ok && i < joined; i++)
+            ok = pp_emit_line(ctx->tokens, NULL, 0);
+        if (!ok)
+            fprintf(stderr, "Tokenization failed\n");
+    } else if (ok) {
+        ok = pp_print_tokens(out, res.data, res.count) &&
+             strbuf_append(out, "\n") == 0;
+        for (size_t i = 0; ok && i < joined; i++)
+            ok = strbuf_append(out, "\n") == 0;
     }
+    vector_free(&res);
     return ok;
 }
 
@@ -342,9 +409,9 @@ static int handle_text_line(char *line, const char *dir, vector_t *macros,
  * specific handler for the directive and falls back to text expansion when the
  * line is not a recognised directive.
  */
-typedef int (*directive_fn_t)(char *, const char *, vector_t *, vector_t *,
-                              strbuf_t *, const vector_t *, vector_t *,
-                              preproc_context_t *);
+typedef int (*directive_fn_t)(char *, const char *, macro_table_t *,
+                              vector_t *, strbuf_t *, const vector_t *,
+                              vector_t *, preproc_context_t *);
 
 enum { SPACE_NONE, SPACE_BLANK, SPACE_ANY };
 
@@ -416,7 +483,7 @@ static const directive_entry_t *lookup_directive(const char *line)
     return NULL;
 }
 
-static int handle_directive(char *line, const char *dir, vector_t *macros,
+static int handle_directive(char *line, const char *dir, macro_table_t *macros,
                             vector_t *conds, strbuf_t *out,
                             const vector_t *incdirs, vector_t *stack,
                             preproc_context_t *ctx)
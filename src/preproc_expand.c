@@ -1,11 +1,11 @@
 #define _POSIX_C_SOURCE 200809L
 /*
- * Macro table management and expansion logic.
+ * Macro expansion on pp-tokens.
  *
- * This module stores macro definitions and performs textual replacement
- * during preprocessing.  Macros may be object-like or take parameters,
- * supporting the `#` stringize and `##` token pasting operators.  Macro
- * bodies are expanded recursively so definitions can reference other macros.
+ * This module performs macro replacement during preprocessing.  Macros
+ * may be object-like or take parameters, supporting the `#` stringize and
+ * `##` token pasting operators.  Replacement lists are rescanned so
+ * definitions can reference other macros.
  *
  * Part of vc under the BSD 2-Clause license.
  * See LICENSE for details.
@@ -17,13 +17,12 @@
 #include "preproc_macros.h"
 #include "preproc_cond.h"
 #include <stdio.h>
-#include <errno.h>
 #include "util.h"
 #include "vector.h"
 #include "strbuf.h"
+#include "intern.h"
 #include "preproc_args.h"
 #include "preproc_builtin.h"
-#include "preproc_macro_utils.h"
 #include "preproc_paste.h"
 
 #define MAX_MACRO_DEPTH 4096
@@ -31,260 +30,126 @@
 /*
  * Expansion algorithm overview
  * ----------------------------
- * Lines are scanned token by token.  When a potential macro name is
- * seen, `parse_macro_invocation` validates the call and dispatches to a
- * builtin or user-defined macro.  User-defined macros are expanded
- * recursively through `expand_user_macro` which, after optional argument
- * parsing, invokes the macro body via `expand_macro_call`.
+ * The tokens of a line are read one at a time.  When a macro name is
+ * seen its arguments are collected, substituted into the body by
+ * `expand_params` and the result is pushed back in front of the unread
+ * tokens followed by a PP_END marker.  The macro stays disabled until the
+ * marker is read again, so the replacement is rescanned together with the
+ * rest of the line and names of disabled macros are painted with
+ * PP_NO_EXPAND for good.  Arguments are expanded on their own before
+ * substitution unless they are operands of # or ##.
  *
- * Each recursive expansion increments the DEPTH parameter.  To guard
- * against infinite recursion, calls fail when DEPTH reaches
- * `MAX_MACRO_DEPTH`.  Callers must propagate negative return values to
- * signal fatal errors while a zero return indicates malformed input
- * that should be copied verbatim.
+ * The number of macros being rescanned, plus the nesting of argument
+ * expansions, is the DEPTH checked against MAX_MACRO_DEPTH.  Functions
+ * return 1 on success, 0 for input that is not a macro invocation and a
+ * negative value for fatal errors.
  */
 
-/* check expanded size against context limit */
-static int check_expand_limit(strbuf_t *sb, preproc_context_t *ctx)
+typedef struct {
+    const pp_token_t *in;   /* tokens not yet read */
+    size_t in_count;        /* number of tokens at in */
+    vector_t pending;       /* pushed back tokens, the last is read first */
+    vector_t *out;          /* expanded tokens */
+    size_t out_len;         /* bytes of output text produced */
+    int depth;              /* nesting checked against MAX_MACRO_DEPTH */
+    const char *ws;         /* whitespace left by an empty replacement */
+    unsigned ws_len;
+    macro_table_t *macros;
+    preproc_context_t *ctx;
+    vector_t *held;         /* receives a call left open by the input */
+} expand_state_t;
+
+static int expand_tokens(expand_state_t *st);
+
+/* Read the next token including PP_END markers */
+static int read_token(expand_state_t *st, pp_token_t *tok)
 {
-    if (ctx->max_expand_size && sb->len > ctx->max_expand_size) {
-        fprintf(stderr, "Macro expansion size limit exceeded\n");
-        return 0;
+    if (st->pending.count) {
+        *tok = ((pp_token_t *)st->pending.data)[--st->pending.count];
+        return 1;
     }
+    if (!st->in_count)
+        return 0;
+    *tok = *st->in++;
+    st->in_count--;
     return 1;
 }
 
-static int expand_macro_call(macro_t *m, char **args, vector_t *macros,
-                             strbuf_t *out, int depth,
-                             preproc_context_t *ctx)
-{
-    strbuf_t tmp;
-    strbuf_init(&tmp);
-    int ok;
-    if (m->params.count || m->variadic) {
-        char *body = expand_params(m->value, &m->params, args, m->variadic);
-        ok = expand_line(body, macros, &tmp, preproc_get_column(ctx), depth, ctx);
-        free(body);
-    } else {
-        ok = expand_line(m->value, macros, &tmp, preproc_get_column(ctx), depth, ctx);
-    }
-    if (ok) {
-        strbuf_append(out, tmp.data ? tmp.data : "");
-        if (!check_expand_limit(out, ctx)) {
-            strbuf_free(&tmp);
-            return 0;
-        }
-    }
-    strbuf_free(&tmp);
-    return ok;
-}
-
-/* Emit a literal character and advance the input index. */
-static void emit_plain_char(const char *line, size_t *pos, strbuf_t *out)
-{
-    strbuf_appendf(out, "%c", line[*pos]);
-    (*pos)++;
-}
-
-/* Copy a quoted string or character literal verbatim. */
-static void emit_quoted(const char *line, size_t *pos, char quote,
-                        strbuf_t *out)
+/*
+ * Read the next token, re-enabling macros whose replacement has ended.
+ * The whitespace before a macro that expanded to nothing moves to the
+ * token following it.
+ */
+static int next_token(expand_state_t *st, pp_token_t *tok)
 {
-    strbuf_appendf(out, "%c", quote);
-    (*pos)++;
-    while (line[*pos]) {
-        char c = line[*pos];
-        strbuf_appendf(out, "%c", c);
-        (*pos)++;
-        if (c == '\\' && line[*pos]) {
-            strbuf_appendf(out, "%c", line[*pos]);
-            (*pos)++;
-            continue;
+    while (read_token(st, tok)) {
+        if (tok->kind != PP_END) {
+            if (!tok->ws_len) {
+                tok->ws = st->ws;
+                tok->ws_len = st->ws_len;
+            }
+            st->ws_len = 0;
+            return 1;
         }
-        if (c == quote)
-            break;
-    }
-}
-
-/* Copy a parenthesized macro invocation starting at *pos into OUT.
- * The scan skips over quoted strings and character literals so that
- * commas and parentheses within them do not terminate the argument
- * list.  *pos is updated to point just past the closing parenthesis. */
-static void emit_macro_invocation(const char *line, size_t *pos,
-                                  strbuf_t *out)
-{
-    size_t p = *pos;
-    size_t depth = 0;
-    do {
-        char c = line[p];
-        if (c == '"' || c == '\'') {
-            emit_quoted(line, &p, c, out);
-            continue;
+        if (tok->ws_len) {
+            st->ws = tok->ws;
+            st->ws_len = tok->ws_len;
         }
-        strbuf_appendf(out, "%c", c);
-        if (c == '(')
-            depth++;
-        else if (c == ')')
-            depth--;
-        p++;
-    } while (line[p - 1] && depth > 0);
-    *pos = p;
-}
-
-
-/* Return the macro whose name matches "name" (len bytes) */
-static macro_t *find_macro(vector_t *macros, const char *name, size_t len)
-{
-    for (size_t i = 0; i < macros->count; i++) {
-        macro_t *m = &((macro_t *)macros->data)[i];
-        if (strlen(m->name) == len && strncmp(m->name, name, len) == 0)
-            return m;
+        tok->macro->expanding = 0;
+        st->depth--;
     }
-    return NULL;
+    return 0;
 }
 
-
-static void free_macro_args(char **ap, char *va, int variadic)
+/*
+ * Release ST.  An error leaves replacements unread, so the macros of
+ * their end markers are enabled again.
+ */
+static void finish_state(expand_state_t *st)
 {
-    if (variadic) {
-        free(va);
-        free(ap);
+    pp_token_t t;
+    while (read_token(st, &t)) {
+        if (t.kind == PP_END)
+            t.macro->expanding = 0;
     }
+    vector_free(&st->pending);
 }
 
-/*
- * Parse the arguments for macro M starting at *pos in LINE.
- *
- * When successful the argument array and optional variadic string are
- * returned via *out_ap and *out_va and the argument vector is stored
- * in *out_args for later cleanup.  *pos is updated to the index after
- * the closing parenthesis.  Returns 1 on success, 0 when the call is
- * malformed and -1 on failure.
- */
-static int parse_macro_arguments(macro_t *m, const char *line, size_t *pos,
-                                 char ***out_ap, char **out_va,
-                                 vector_t *out_args)
+static int unread_token(expand_state_t *st, const pp_token_t *tok)
 {
-    if (!parse_macro_arg_vector(line, pos, out_args, m->params.count,
-                                m->variadic))
+    if (!vector_push(&st->pending, tok)) {
+        vc_oom();
         return 0;
-
-    if (!handle_varargs(out_args, m->params.count, m->variadic,
-                        out_ap, out_va)) {
-        free_arg_vector(out_args);
-        return -1;
     }
     return 1;
 }
 
-/*
- * Expand the body of macro M using the provided argument array.
- * The result is appended to OUT.  Returns 1 on success or -1 on
- * expansion failure.
- */
-static int invoke_macro_body(macro_t *m, char **ap, vector_t *macros,
-                             strbuf_t *out, int depth,
-                             preproc_context_t *ctx)
+/* Push COUNT tokens back so that TOKS[0] is read first */
+static int unread_tokens(expand_state_t *st, const pp_token_t *toks,
+                         size_t count)
 {
-    if (!expand_macro_call(m, ap, macros, out, depth + 1, ctx))
-        return -1;
+    while (count) {
+        if (!unread_token(st, &toks[--count]))
+            return 0;
+    }
     return 1;
 }
 
-/*
- * Attempt to parse and expand a macro invocation starting at *pos.
- * On success the resulting text is appended to "out" and *pos is
- * updated to the index following the macro call.  Returns non-zero
- * when a macro expansion occurred.
- */
-
-/* Expand a user-defined macro.  "pos" should point to the index right
- * after the macro name.  When expansion succeeds *pos is updated to the
- * index after the invocation and 1 is returned.  If the invocation was
- * malformed zero is returned.  On failure a negative value is returned. */
-static int expand_user_macro(macro_t *m, const char *line, size_t *pos,
-                             vector_t *macros, strbuf_t *out, int depth,
-                             preproc_context_t *ctx)
+/* Append TOK to the output, checking the expansion size limit */
+static int emit_token(expand_state_t *st, const pp_token_t *tok)
 {
-    if (m->expanding) {
-        int saved_errno = errno;
-        size_t p = *pos;
-        strbuf_append(out, m->name);
-        if ((m->params.count || m->variadic) && line[p] == '(')
-            emit_macro_invocation(line, &p, out);
-        *pos = p;
-        errno = saved_errno;
-        return 1;
-    }
-
-    size_t p = *pos;        /* position just after the macro name */
-
-    /* Parse the invocation arguments when the macro expects them. */
-    vector_t args;
-    char **ap = NULL;
-    char *va = NULL;
-    int r = 1;
-    if (m->params.count || m->variadic) {
-        r = parse_macro_arguments(m, line, &p, &ap, &va, &args);
-        if (r <= 0)
-            return r;
-    }
-
-    m->expanding = 1;
-
-    /* Invoke the macro body once arguments have been collected. */
-    if (invoke_macro_body(m, ap, macros, out, depth, ctx) < 0) {
-        if (m->params.count || m->variadic) {
-            free_macro_args(ap, va, m->variadic);
-            free_arg_vector(&args);
-        }
-        m->expanding = 0;
-        return -1;
+    st->out_len += tok->ws_len + tok->len;
+    if (st->ctx->max_expand_size && st->out_len > st->ctx->max_expand_size) {
+        fprintf(stderr, "Macro expansion size limit exceeded\n");
+        return 0;
     }
-
-    if (m->params.count || m->variadic) {
-        free_macro_args(ap, va, m->variadic);
-        free_arg_vector(&args);
+    if (!vector_push(st->out, tok)) {
+        vc_oom();
+        return 0;
     }
-    *pos = p;
-    m->expanding = 0;
     return 1;
 }
 
-/* Scan an identifier starting at POS and return the index after it.
- * "out_len" receives the identifier length when non-NULL.  Returns POS
- * when no identifier is present. */
-static size_t read_macro_ident(const char *line, size_t pos, size_t *out_len)
-{
-    size_t len = parse_ident(line + pos);
-    if (!len)
-        return pos;
-    if (out_len)
-        *out_len = len;
-    return pos + len;
-}
-
-/* Dispatch the identifier between builtin and user-defined macros. */
-static int dispatch_macro(const char *line, size_t start, size_t end,
-                          size_t len, vector_t *macros, strbuf_t *out,
-                          size_t column, int depth, size_t *pos,
-                          preproc_context_t *ctx)
-{
-    int r = handle_builtin_macro(line + start, len, end, column, out, pos, ctx);
-    if (r)
-        return r;
-
-    macro_t *m = find_macro(macros, line + start, len);
-    if (!m)
-        return 0;
-
-    preproc_set_location(ctx, NULL, preproc_get_line(ctx), column);
-    size_t p = end;
-    r = expand_user_macro(m, line, &p, macros, out, depth, ctx);
-    if (r > 0)
-        *pos = p;
-    return r;
-}
 /*
  * Append the character represented by the escape sequence starting with
  * backslash C.  Additional characters are read from S beginning at *I and the
@@ -362,129 +227,318 @@ static char *decode_string_literal(const char *s, size_t len)
     return res;
 }
 
-/* Recognize and expand the _Pragma operator. */
-static int handle_pragma_operator(const char *line, size_t *pos,
-                                 strbuf_t *out)
+/*
+ * Recognize the _Pragma operator after its name has been read.  The
+ * pragma becomes a line of its own in the output.
+ */
+static int handle_pragma_operator(expand_state_t *st, const pp_token_t *name)
 {
-    size_t start = *pos;
-    size_t len = parse_ident(line + start);
-    if (len != 7 || strncmp(line + start, "_Pragma", 7) != 0)
+    if (name->len != 7 || strcmp(name->text, "_Pragma") != 0)
         return 0;
-    size_t p = start + len;
-    while (line[p] == ' ' || line[p] == '\t')
-        p++;
-    if (line[p] != '(')
+    pp_token_t open, str, close;
+    if (!next_token(st, &open))
         return 0;
-    p++;
-    while (line[p] == ' ' || line[p] == '\t')
-        p++;
-    if (line[p] != '"')
+    if (!pp_is_punct(&open, "(")) {
+        if (!unread_token(st, &open))
+            return -1;
+        return 0;
+    }
+    if (!next_token(st, &str))
+        return unread_token(st, &open) ? 0 : -1;
+    if (str.kind != PP_STRING || str.text[0] != '"') {
+        if (!unread_token(st, &str) || !unread_token(st, &open))
+            return -1;
         return 0;
-    p++;
-    size_t str_start = p;
-    while (line[p]) {
-        if (line[p] == '\\' && line[p + 1]) {
-            p += 2;
-            continue;
-        }
-        if (line[p] == '"')
-            break;
-        p++;
     }
-    if (line[p] != '"')
+    if (!next_token(st, &close) || !pp_is_punct(&close, ")"))
         return -1;
-    size_t str_len = p - str_start;
-    char *pragma = decode_string_literal(line + str_start, str_len);
+
+    char *pragma = decode_string_literal(str.text + 1, str.len - 2);
     if (!pragma)
         return -1;
-    p++;
-    while (line[p] == ' ' || line[p] == '\t')
-        p++;
-    if (line[p] != ')') {
-        free(pragma);
-        return -1;
-    }
-    p++;
-    int r = strbuf_appendf(out, "\n#pragma %s\n", pragma);
+    strbuf_t sb;
+    strbuf_init(&sb);
+    int ok = strbuf_appendf(&sb, "\n#pragma %s\n", pragma) == 0;
     free(pragma);
-    if (r != 0)
+    if (ok) {
+        pp_token_t raw = { intern_text(sb.data, sb.len), "", (unsigned)sb.len,
+                           0, PP_RAW, 0, -1, NULL };
+        ok = emit_token(st, &raw);
+    }
+    strbuf_free(&sb);
+    return ok ? 1 : -1;
+}
+
+/* Expand __FILE__, __LINE__ and the other builtin macros */
+static int handle_builtin(expand_state_t *st, const pp_token_t *name)
+{
+    /* every builtin name starts with two underscores */
+    if (name->text[0] != '_' || name->text[1] != '_')
+        return 0;
+    strbuf_t sb;
+    strbuf_init(&sb);
+    size_t pos;
+    int r = handle_builtin_macro(name->text, name->len, 0,
+                                 preproc_get_column(st->ctx), &sb, &pos,
+                                 st->ctx);
+    if (r) {
+        vector_t toks;
+        vector_init(&toks, sizeof(pp_token_t));
+        r = pp_lex(sb.data ? sb.data : "", &toks) ? 1 : -1;
+        pp_token_t *t = toks.data;
+        for (size_t i = 0; r > 0 && i < toks.count; i++) {
+            t[i].ws = i ? "" : name->ws;
+            t[i].ws_len = i ? 0 : name->ws_len;
+            if (!emit_token(st, &t[i]))
+                r = -1;
+        }
+        vector_free(&toks);
+    }
+    strbuf_free(&sb);
+    return r;
+}
+
+/* Fully expand argument A on its own */
+static int expand_arg(expand_state_t *st, macro_arg_t *a)
+{
+    if (a->have_expanded)
+        return 1;
+    vector_init(&a->expanded, sizeof(pp_token_t));
+    a->have_expanded = 1;
+    if (st->depth + 1 >= MAX_MACRO_DEPTH) {
+        fprintf(stderr, "Macro expansion limit exceeded\n");
+        return 0;
+    }
+    expand_state_t sub = { a->toks, a->count, {0}, &a->expanded, 0,
+                           st->depth + 1, "", 0, st->macros, st->ctx,
+                           NULL };
+    vector_init(&sub.pending, sizeof(pp_token_t));
+    int ok = expand_tokens(&sub);
+    finish_state(&sub);
+    return ok;
+}
+
+/*
+ * Read the tokens of a macro call from the opening parenthesis to the
+ * matching closing one into CALL.  Returns 0 when the line ends first.
+ */
+static int read_macro_call(expand_state_t *st, vector_t *call)
+{
+    int nest = 0;
+    pp_token_t t;
+    while (next_token(st, &t)) {
+        if (!vector_push(call, &t)) {
+            vc_oom();
+            return 0;
+        }
+        if (pp_is_punct(&t, "("))
+            nest++;
+        else if (pp_is_punct(&t, ")") && --nest == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * Move NAME and the COUNT tokens of its unfinished call at CALL to
+ * ST->held so the call can continue with more input.
+ */
+static int hold_call(expand_state_t *st, const pp_token_t *name,
+                     const pp_token_t *call, size_t count)
+{
+    if (!vector_push(st->held, name)) {
+        vc_oom();
         return -1;
-    *pos = p;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (!vector_push(st->held, &call[i])) {
+            vc_oom();
+            return -1;
+        }
+    }
     return 1;
 }
 
 /*
- * Attempt to expand a macro invocation starting at *pos.
- *
- * Returns 1 when a macro was successfully expanded, 0 when no
- * invocation was present and -1 on failure.  The recursion depth is
- * checked against MAX_MACRO_DEPTH and exceeding it reports an error.
+ * Substitute the arguments into the body of M and push the result back
+ * for rescanning with M disabled.  NAME supplies the whitespace of the
+ * first replacement token.
  */
-static int parse_macro_invocation(const char *line, size_t *pos,
-                                  vector_t *macros, strbuf_t *out,
-                                  size_t column, int depth,
-                                  preproc_context_t *ctx)
+static int push_replacement(expand_state_t *st, macro_t *m,
+                            const pp_token_t *name, vector_t *args)
 {
-    if (depth >= MAX_MACRO_DEPTH) {
+    if (!prepare_macro_body(m))
+        return -1;
+    const pp_token_t *b = m->body.data;
+    for (size_t i = 0; i < m->body.count; i++) {
+        if (b[i].param >= 0 && !(b[i].flags & PP_RAW_ARG) &&
+            !expand_arg(st, &((macro_arg_t *)args->data)[b[i].param]))
+            return -1;
+    }
+
+    vector_t repl;
+    vector_init(&repl, sizeof(pp_token_t));
+    if (!expand_params(m, args->data, &repl)) {
+        vector_free(&repl);
+        return -1;
+    }
+    pp_token_t end = { m->name, "", 0, 0, PP_END, 0, -1, m };
+    if (repl.count) {
+        pp_token_t *first = repl.data;
+        first->ws = name->ws;
+        first->ws_len = name->ws_len;
+    } else {
+        end.ws = name->ws;
+        end.ws_len = name->ws_len;
+    }
+    int ok = st->depth + 1 < MAX_MACRO_DEPTH;
+    if (!ok)
         fprintf(stderr, "Macro expansion limit exceeded\n");
+    ok = ok && unread_token(st, &end) &&
+         unread_tokens(st, repl.data, repl.count);
+    vector_free(&repl);
+    if (!ok)
+        return -1;
+    m->expanding = 1;
+    st->depth++;
+    return 1;
+}
+
+/*
+ * Expand the user-defined macro M whose name NAME has just been read.
+ * A function-like macro not followed by a complete argument list is left
+ * alone and 0 is returned.
+ */
+static int expand_user_macro(expand_state_t *st, macro_t *m,
+                             const pp_token_t *name)
+{
+    vector_t args;
+    vector_init(&args, sizeof(macro_arg_t));
+    if (!m->function_like)
+        return push_replacement(st, m, name, &args);
+
+    /* only a name read from the input itself may wait for more input */
+    int can_hold = st->held && !st->pending.count;
+    vector_t call;
+    vector_init(&call, sizeof(pp_token_t));
+    pp_token_t open;
+    int r = 0;
+    if (!next_token(st, &open)) {
+        vector_free(&call);
+        return can_hold ? hold_call(st, name, NULL, 0) : 0;
+    }
+    if (!unread_token(st, &open)) {
+        vector_free(&call);
         return -1;
     }
+    if (pp_is_punct(&open, "(")) {
+        /* the call is read again below when it turns out malformed */
+        int closed = read_macro_call(st, &call);
+        if (closed &&
+            split_macro_args((pp_token_t *)call.data + 1, call.count - 2,
+                             m->params.count, m->variadic, &args)) {
+            r = push_replacement(st, m, name, &args);
+            free_macro_args(&args);
+        } else if (!closed && can_hold) {
+            r = hold_call(st, name, call.data, call.count);
+        } else if (!unread_tokens(st, call.data, call.count)) {
+            r = -1;
+        }
+    }
+    vector_free(&call);
+    return r;
+}
 
-    size_t start = *pos;
-    int r = handle_pragma_operator(line, pos, out);
+/*
+ * Expand the identifier NAME when it names a builtin or user-defined
+ * macro or is the _Pragma operator.
+ */
+static int expand_ident(expand_state_t *st, pp_token_t *name)
+{
+    int r = handle_pragma_operator(st, name);
+    if (r)
+        return r;
+    r = handle_builtin(st, name);
     if (r)
         return r;
 
-    size_t len;
-    size_t end = read_macro_ident(line, start, &len);
-    if (end == start)
+    macro_t *m = macro_table_lookup(st->macros, name->text, name->len);
+    if (!m)
+        return 0;
+    if (m->expanding) {
+        name->flags |= PP_NO_EXPAND;
         return 0;
+    }
+    return expand_user_macro(st, m, name);
+}
 
-    return dispatch_macro(line, start, end, len, macros, out, column, depth,
-                          pos, ctx);
+/* Expand every token of ST into its output */
+static int expand_tokens(expand_state_t *st)
+{
+    pp_token_t t;
+    while (next_token(st, &t)) {
+        if (t.kind == PP_IDENT && !(t.flags & PP_NO_EXPAND)) {
+            int r = expand_ident(st, &t);
+            if (r < 0)
+                return 0;
+            if (r)
+                continue;
+        }
+        if (!emit_token(st, &t))
+            return 0;
+    }
+    return 1;
 }
 
-/*
- * Expand all macros found in a single line of input.
- * Performs recursive expansion so macro bodies may contain other
- * macros.  Results are appended to the provided output buffer.
- */
-static int expand_token(const char *line, size_t *pos, vector_t *macros,
-                        strbuf_t *out, size_t column, int depth,
-                        preproc_context_t *ctx)
+/* Expand TOKS into OUT, moving a call left open at the end to HELD */
+static int run_expansion(const pp_token_t *toks, size_t count,
+                         macro_table_t *macros, vector_t *out, int depth,
+                         vector_t *held, preproc_context_t *ctx)
 {
-    int r = parse_macro_invocation(line, pos, macros, out, column, depth, ctx);
-    if (r < 0)
+    if (depth >= MAX_MACRO_DEPTH) {
+        fprintf(stderr, "Macro expansion limit exceeded\n");
         return 0;
-    if (!r)
-        emit_plain_char(line, pos, out);
-    return 1;
+    }
+    expand_state_t st = { toks, count, {0}, out, 0, depth, "", 0, macros,
+                          ctx, held };
+    vector_init(&st.pending, sizeof(pp_token_t));
+    int ok = expand_tokens(&st);
+    finish_state(&st);
+    return ok;
+}
+
+int expand_token_list(const pp_token_t *toks, size_t count,
+                      macro_table_t *macros, vector_t *out, int depth,
+                      preproc_context_t *ctx)
+{
+    return run_expansion(toks, count, macros, out, depth, NULL, ctx);
+}
+
+int expand_open_token_list(const pp_token_t *toks, size_t count,
+                           macro_table_t *macros, vector_t *out,
+                           vector_t *held, preproc_context_t *ctx)
+{
+    return run_expansion(toks, count, macros, out, 0, held, ctx);
 }
 
 /*
- * Recursively expand all macros found in LINE and append the result to OUT.
+ * Expand all macros found in LINE and append the resulting text to OUT.
  *
  * Returns 1 on success or 0 if a fatal error occurs.  DEPTH limits the
  * level of nested expansions and is checked against MAX_MACRO_DEPTH.
  */
-int expand_line(const char *line, vector_t *macros, strbuf_t *out,
+int expand_line(const char *line, macro_table_t *macros, strbuf_t *out,
                 size_t column, int depth, preproc_context_t *ctx)
 {
-    if (depth >= MAX_MACRO_DEPTH) {
-        fprintf(stderr, "Macro expansion limit exceeded\n");
-        return 0;
-    }
-    for (size_t i = 0; line[i];) {
-        char c = line[i];
-        if (c == '"' || c == '\'') {
-            emit_quoted(line, &i, c, out);
-            continue;
-        }
-        size_t col = column ? column : i + 1;
-        if (!expand_token(line, &i, macros, out, col, depth, ctx))
-            return 0;
-        if (!check_expand_limit(out, ctx))
-            return 0;
-    }
-    return 1;
+    (void)column;
+    vector_t toks, res;
+    vector_init(&toks, sizeof(pp_token_t));
+    vector_init(&res, sizeof(pp_token_t));
+    int ok = pp_lex(line, &toks) &&
+             expand_token_list(toks.data, toks.count, macros, &res, depth,
+                               ctx) &&
+             pp_print_tokens(out, res.data, res.count);
+    vector_free(&toks);
+    vector_free(&res);
+    return ok;
 }
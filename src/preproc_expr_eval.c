@@ -3,7 +3,7 @@
 #include "preproc_expr_parse.h"
 #include "preproc_utils.h"
 
-static long long eval_internal(const char *s, vector_t *macros,
+static long long eval_internal(const char *s, macro_table_t *macros,
                                const char *dir, const vector_t *incdirs,
                                vector_t *stack)
 {
@@ -19,7 +19,7 @@ static long long eval_internal(const char *s, vector_t *macros,
     return val;
 }
 
-long long eval_expr_full(const char *s, vector_t *macros,
+long long eval_expr_full(const char *s, macro_table_t *macros,
                          const char *dir, const vector_t *incdirs,
                          vector_t *stack)
 {
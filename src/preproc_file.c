@@ -31,6 +31,7 @@
 #include "preproc_include.h"
 #include "preproc_file_io.h"
 #include "preproc_path.h"
+#include "file_cache.h"
 #include "semantic_global.h"
 #include "util.h"
 #include "vector.h"
@@ -38,7 +39,7 @@
 
 
 static int process_file_lines(char **lines, const char *path, const char *dir,
-                              vector_t *macros, vector_t *conds, strbuf_t *out,
+                              macro_table_t *macros, vector_t *conds, strbuf_t *out,
                               const vector_t *incdirs, vector_t *stack,
                               preproc_context_t *ctx)
 {
@@ -77,7 +78,7 @@ static void close_source_file(char *text, char **lines, char *dir,
  * open_source_file(), all lines are processed via process_file_lines()
  * and temporary resources are released by close_source_file().
  */
-int process_file(const char *path, vector_t *macros,
+int process_file(const char *path, macro_table_t *macros,
                         vector_t *conds, strbuf_t *out,
                         const vector_t *incdirs, vector_t *stack,
                         preproc_context_t *ctx, size_t idx)
@@ -89,22 +90,34 @@ int process_file(const char *path, vector_t *macros,
     if (!open_source_file(path, stack, idx, &lines, &dir, &text, ctx))
         return 0;
 
+    /* look for an include guard before the lines are modified in place */
+    char *guard = detect_include_guard(lines);
+
     int ok = process_file_lines(lines, path, dir, macros, conds, out,
                                 incdirs, stack, ctx);
 
+    if (ok && guard) {
+        const include_entry_t *e =
+            &((include_entry_t *)stack->data)[stack->count - 1];
+        ok = include_guard_add(ctx, e->path, guard);
+    }
+    free(guard);
+
     close_source_file(text, lines, dir, stack, ctx);
     return ok;
 }
 
 /* Initialize the vectors used during preprocessing */
-static void init_preproc_vectors(preproc_context_t *ctx, vector_t *macros,
+static void init_preproc_vectors(preproc_context_t *ctx, macro_table_t *macros,
                                  vector_t *conds, vector_t *stack,
                                  strbuf_t *out)
 {
-    vector_init(macros, sizeof(macro_t));
+    macro_table_init(macros);
     vector_init(conds, sizeof(cond_state_t));
     vector_init(stack, sizeof(include_entry_t));
     vector_init(&ctx->pragma_once_files, sizeof(char *));
+    vector_init(&ctx->include_guards, sizeof(include_guard_t));
+    ctx->guard_skips = 0;
     vector_init(&ctx->deps, sizeof(char *));
     vector_init(&ctx->pack_stack, sizeof(size_t));
     ctx->pack_alignment = 0;
@@ -127,12 +140,11 @@ static void init_preproc_vectors(preproc_context_t *ctx, vector_t *macros,
 }
 
 /* Define a simple object-like macro with value VAL */
-static int define_simple_macro(vector_t *macros, const char *name,
+static int define_simple_macro(macro_table_t *macros, const char *name,
                                const char *val)
 {
     vector_t params;
     vector_init(&params, sizeof(char *));
-    remove_macro(macros, name);
     return add_macro(name, val, &params, 0, macros);
 }
 
@@ -143,7 +155,7 @@ typedef struct {
 } macro_def_t;
 
 /* Define all macros in LIST until a NULL name is encountered */
-static int define_macro_list(vector_t *macros, const macro_def_t *list)
+static int define_macro_list(macro_table_t *macros, const macro_def_t *list)
 {
     for (size_t i = 0; list[i].name; i++) {
         if (!define_simple_macro(macros, list[i].name, list[i].value))
@@ -153,7 +165,7 @@ static int define_macro_list(vector_t *macros, const macro_def_t *list)
 }
 
 /* Architecture specific macros mimic GCC for LP64 and ILP32 targets */
-static int define_arch_macros(vector_t *macros, bool use_x86_64)
+static int define_arch_macros(macro_table_t *macros, bool use_x86_64)
 {
     static const macro_def_t arch64[] = {
         {"__x86_64__", "1"},
@@ -171,7 +183,7 @@ static int define_arch_macros(vector_t *macros, bool use_x86_64)
 }
 
 /* Operating system macros used by system headers */
-static int define_host_macros(vector_t *macros)
+static int define_host_macros(macro_table_t *macros)
 {
 #ifdef __linux__
     static const macro_def_t os_list[] = {
@@ -187,7 +199,7 @@ static int define_host_macros(vector_t *macros)
 }
 
 /* Compiler identification macros follow the host GCC values */
-static int define_compiler_macros(vector_t *macros)
+static int define_compiler_macros(macro_table_t *macros)
 {
 #ifdef __GNUC__
 #define STR2(x) #x
@@ -208,7 +220,7 @@ static int define_compiler_macros(vector_t *macros)
 }
 
 /* Misc host feature macros copied when available */
-static int define_feature_macros(vector_t *macros)
+static int define_feature_macros(macro_table_t *macros)
 {
 #define STR2(x) #x
 #define STR(x) STR2(x)
@@ -296,7 +308,7 @@ static int define_feature_macros(vector_t *macros)
 
 /* Add some common builtin macros based on the host compiler. The path to the
  * main source file is used to initialise __BASE_FILE__. */
-static int define_default_macros(vector_t *macros, const char *base_file,
+static int define_default_macros(macro_table_t *macros, const char *base_file,
                                  bool use_x86_64)
 {
     define_simple_macro(macros, "__STDC__", "1");
@@ -310,22 +322,14 @@ static int define_default_macros(vector_t *macros, const char *base_file,
 
     /* Predefined macros for internal bookkeeping */
     if (base_file) {
-        char *canon = realpath(base_file, NULL);
-        if (!canon)
-            canon = vc_strdup(base_file);
-        if (!canon) {
-            vc_oom();
-            return 0;
-        }
+        const char *canon = file_cache_realpath(base_file);
         char quoted[PATH_MAX + 2];
         int n = snprintf(quoted, sizeof(quoted), "\"%s\"", canon);
         if (n < 0 || (size_t)n >= sizeof(quoted)) {
-            free(canon);
             errno = ENAMETOOLONG;
             return 0;
         }
         define_simple_macro(macros, "__BASE_FILE__", quoted);
-        free(canon);
     } else {
         define_simple_macro(macros, "__BASE_FILE__", "\"\"");
     }
@@ -333,7 +337,7 @@ static int define_default_macros(vector_t *macros, const char *base_file,
 }
 
 /* Release vectors and buffers used during preprocessing */
-static void cleanup_preproc_vectors(preproc_context_t *ctx, vector_t *macros,
+static void cleanup_preproc_vectors(preproc_context_t *ctx, macro_table_t *macros,
                                     vector_t *conds, vector_t *stack,
                                     vector_t *search_dirs, strbuf_t *out)
 {
@@ -343,11 +347,12 @@ static void cleanup_preproc_vectors(preproc_context_t *ctx, vector_t *macros,
     }
     vector_free(stack);
     vector_free(conds);
-    free_macro_vector(macros);
+    macro_table_free(macros);
     free_string_vector(search_dirs);
     for (size_t i = 0; i < ctx->pragma_once_files.count; i++)
         free(((char **)ctx->pragma_once_files.data)[i]);
     vector_free(&ctx->pragma_once_files);
+    include_guard_free(ctx);
     strbuf_free(out);
 }
 
@@ -381,7 +386,7 @@ static char *unquote_value(const char *val)
     return NULL;
 }
 
-static int update_macros_from_cli(vector_t *macros, const vector_t *defines,
+static int update_macros_from_cli(macro_table_t *macros, const vector_t *defines,
                                   const vector_t *undefines)
 {
     if (defines) {
@@ -406,7 +411,6 @@ static int update_macros_from_cli(vector_t *macros, const vector_t *defines,
             }
             vector_t params;
             vector_init(&params, sizeof(char *));
-            remove_macro(macros, name);
             if (!add_macro(name, val, &params, 0, macros)) {
                 free(name);
                 free(unquoted);
@@ -428,7 +432,7 @@ static int update_macros_from_cli(vector_t *macros, const vector_t *defines,
 }
 
 /* Wrapper around process_file used by the entry point */
-static int process_input_file(const char *path, vector_t *macros,
+static int process_input_file(const char *path, macro_table_t *macros,
                               vector_t *conds, strbuf_t *out,
                               const vector_t *incdirs, vector_t *stack,
                               preproc_context_t *ctx)
@@ -438,22 +442,26 @@ static int process_input_file(const char *path, vector_t *macros,
 }
 
 /*
- * Entry point used by the compiler.  Sets up include search paths,
- * invokes the file processor and returns the resulting text.
+ * Shared driver for preproc_run() and preproc_run_tokens().  Sets up
+ * include search paths, processes the input file and either stores the
+ * resulting text in *OUT_TEXT or, when OUT_TEXT is NULL, lexes the tail
+ * of the output into ctx->tokens.  Returns 1 on success.
  */
-char *preproc_run(preproc_context_t *ctx, const char *path,
-                  const vector_t *include_dirs,
-                  const vector_t *defines, const vector_t *undefines,
-                  const char *sysroot, const char *vc_sysinclude,
-                  bool internal_libc, bool use_x86_64)
+static int run_preprocessor(preproc_context_t *ctx, const char *path,
+                            const vector_t *include_dirs,
+                            const vector_t *defines,
+                            const vector_t *undefines, const char *sysroot,
+                            const char *vc_sysinclude, bool internal_libc,
+                            bool use_x86_64, char **out_text)
 {
-    vector_t search_dirs, macros, conds, stack;
+    vector_t search_dirs, conds, stack;
+    macro_table_t macros;
     strbuf_t out;
 
     /* Build include search list from CLI options and environment */
     if (!collect_include_dirs(&search_dirs, include_dirs, sysroot,
                               vc_sysinclude, internal_libc))
-        return NULL;
+        return 0;
 
     /* Prepare all vectors used during preprocessing */
     init_preproc_vectors(ctx, &macros, &conds, &stack, &out);
@@ -461,34 +469,81 @@ char *preproc_run(preproc_context_t *ctx, const char *path,
     ctx->counter = 0;
     if (!define_default_macros(&macros, path, use_x86_64)) {
         cleanup_preproc_vectors(ctx, &macros, &conds, &stack, &search_dirs, &out);
-        return NULL;
+        return 0;
     }
     if (!record_dependency(ctx, path)) {
         cleanup_preproc_vectors(ctx, &macros, &conds, &stack, &search_dirs, &out);
-        return NULL;
+        return 0;
     }
 
     /* Apply -D and -U options from the command line */
     if (!update_macros_from_cli(&macros, defines, undefines)) {
         cleanup_preproc_vectors(ctx, &macros, &conds, &stack, &search_dirs, &out);
-        return NULL;
+        return 0;
     }
 
     /* Process the initial source file */
     int ok = process_input_file(path, &macros, &conds, &out,
                                 &search_dirs, &stack, ctx);
+    preproc_report_include_stats(ctx);
 
     int saved_errno = errno;
-    char *res = NULL;
-    if (ok) {
-        res = vc_strdup(out.data ? out.data : "");
-        if (!res)
+    if (ok && out_text) {
+        *out_text = vc_strdup(out.data ? out.data : "");
+        if (!*out_text) {
             vc_oom();
+            ok = 0;
+        }
+    } else if (ok && out.len) {
+        ok = lexer_stream_feed(ctx->tokens, out.data);
+        if (!ok)
+            fprintf(stderr, "Tokenization failed\n");
     }
 
     cleanup_preproc_vectors(ctx, &macros, &conds, &stack, &search_dirs, &out);
     errno = saved_errno;
 
+    return ok;
+}
+
+/*
+ * Entry point used by the compiler.  Sets up include search paths,
+ * invokes the file processor and returns the resulting text.
+ */
+char *preproc_run(preproc_context_t *ctx, const char *path,
+                  const vector_t *include_dirs,
+                  const vector_t *defines, const vector_t *undefines,
+                  const char *sysroot, const char *vc_sysinclude,
+                  bool internal_libc, bool use_x86_64)
+{
+    char *res = NULL;
+    ctx->tokens = NULL;
+    if (!run_preprocessor(ctx, path, include_dirs, defines, undefines,
+                          sysroot, vc_sysinclude, internal_libc, use_x86_64,
+                          &res))
+        return NULL;
     return res;
 }
 
+token_t *preproc_run_tokens(preproc_context_t *ctx, const char *path,
+                            const vector_t *include_dirs,
+                            const vector_t *defines,
+                            const vector_t *undefines, const char *sysroot,
+                            const char *vc_sysinclude, bool internal_libc,
+                            bool use_x86_64, size_t *out_count)
+{
+    lexer_stream_t ls;
+    lexer_stream_init(&ls);
+    ctx->tokens = &ls;
+    int ok = run_preprocessor(ctx, path, include_dirs, defines, undefines,
+                              sysroot, vc_sysinclude, internal_libc,
+                              use_x86_64, NULL);
+    ctx->tokens = NULL;
+    if (!ok) {
+        int saved_errno = errno;
+        lexer_stream_free(&ls);
+        errno = saved_errno;
+        return NULL;
+    }
+    return lexer_stream_finish(&ls, out_count);
+}
@@ -6,22 +6,21 @@
 #include <string.h>
 #include <stdint.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__SSE2__) && defined(__GNUC__)
+#include <emmintrin.h>
+#endif
 
 #include "util.h"
+#include "file_cache.h"
 #include "preproc_file_io.h"
 #include "preproc_macros.h"
 #include "preproc_path.h"
 #include "preproc_file.h"
 #include "preproc_builtin.h"
 
-static char *canonical_path(const char *path)
-{
-    char *canon = realpath(path, NULL);
-    if (!canon)
-        canon = vc_strdup(path);
-    return canon;
-}
-
 /* per-context line tracking */
 
 void line_state_push(preproc_context_t *ctx, const char *file, long delta,
@@ -69,24 +68,19 @@ void preproc_apply_line_directive(preproc_context_t *ctx,
 
 int include_stack_contains(vector_t *stack, const char *path)
 {
-    char *canon = canonical_path(path);
-    if (!canon)
-        return 0;
+    const char *canon = file_cache_realpath(path);
     for (size_t i = 0; i < stack->count; i++) {
         const include_entry_t *e = &((include_entry_t *)stack->data)[i];
-        if (strcmp(e->path, canon) == 0) {
-            free(canon);
+        if (strcmp(e->path, canon) == 0)
             return 1;
-        }
     }
-    free(canon);
     return 0;
 }
 
 int include_stack_push(vector_t *stack, const char *path, size_t idx,
                        preproc_context_t *ctx)
 {
-    char *canon = canonical_path(path);
+    char *canon = vc_strdup(file_cache_realpath(path));
     if (!canon) {
         vc_oom();
         return 0;
@@ -118,113 +112,194 @@ void include_stack_pop(vector_t *stack, preproc_context_t *ctx)
 }
 
 /*
- * Read PATH into a newly allocated buffer while handling CR, CRLF and
- * backslash-newline sequences.  The resulting text is NUL terminated and
- * the length is written to OUT_LEN on success.
+ * Return a pointer to the first newline, backslash or carriage return in
+ * [P, END) or END when there is none.  These are the only bytes the
+ * loader has to look at, so everything in between is copied in bulk.
+ */
+static const char *find_line_special(const char *p, const char *end)
+{
+#if defined(__SSE2__) && defined(__GNUC__)
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i bs = _mm_set1_epi8('\\');
+    const __m128i cr = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(const void *)p);
+        __m128i hit = _mm_or_si128(_mm_cmpeq_epi8(v, nl),
+                                   _mm_or_si128(_mm_cmpeq_epi8(v, bs),
+                                                _mm_cmpeq_epi8(v, cr)));
+        unsigned mask = (unsigned)_mm_movemask_epi8(hit);
+        if (mask)
+            return p + __builtin_ctz(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != '\n' && *p != '\\' && *p != '\r')
+        p++;
+    return p;
+}
+
+/*
+ * Map PATH into memory, or read it into a right-sized buffer when it is
+ * not a regular file that can be mapped.  On success *OUT_DATA and
+ * *OUT_SIZE describe the contents, ST holds the file status and
+ * *OUT_MAPPED tells whether the buffer must be released with munmap()
+ * instead of free().
  */
-static char *load_file_text(const char *path, size_t *out_len)
+static int map_source_file(const char *path, const char **out_data,
+                           size_t *out_size, int *out_mapped,
+                           struct stat *st)
 {
-    FILE *f = fopen(path, "rb");
-    if (!f) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
         perror(path);
-        return NULL;
+        return 0;
     }
 
-    size_t cap = 8192;
-    size_t len = 0;
-    char *text = vc_alloc_or_exit(cap);
+    if (fstat(fd, st) != 0) {
+        perror(path);
+        close(fd);
+        return 0;
+    }
 
-    int c;
-    while ((c = fgetc(f)) != EOF) {
-        if (c == '\\') {
-            int next = fgetc(f);
-            if (next == '\n')
-                continue;
-            if (next == '\r') {
-                int next2 = fgetc(f);
-                if (next2 == '\n')
-                    continue;
-                if (next2 != EOF)
-                    ungetc(next2, f);
+    if (S_ISREG(st->st_mode)) {
+        if ((uintmax_t)st->st_size >= SIZE_MAX) {
+            fprintf(stderr, "vc: file too large\n");
+            close(fd);
+            return 0;
+        }
+        size_t size = (size_t)st->st_size;
+        if (size > 0) {
+            void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                close(fd);
+                *out_data = map;
+                *out_size = size;
+                *out_mapped = 1;
+                return 1;
             }
-            if (next != EOF)
-                ungetc(next, f);
-        } else if (c == '\r') {
-            continue;
         }
+    }
 
-        if (len == SIZE_MAX) {
-            fprintf(stderr, "vc: file too large\n");
-            fclose(f);
-            free(text);
-            return NULL;
-        }
-        if (len + 1 >= cap) {
+    /* pipes and unmappable files: read everything into one buffer */
+    size_t cap = S_ISREG(st->st_mode) && st->st_size > 0 ?
+                 (size_t)st->st_size + 1 : 8192;
+    size_t len = 0;
+    char *buf = vc_alloc_or_exit(cap);
+    for (;;) {
+        if (len == cap) {
             if (cap > SIZE_MAX / 2) {
                 fprintf(stderr, "vc: file too large\n");
-                fclose(f);
-                free(text);
-                return NULL;
+                free(buf);
+                close(fd);
+                return 0;
             }
             cap *= 2;
-            text = vc_realloc_or_exit(text, cap);
+            buf = vc_realloc_or_exit(buf, cap);
         }
-        text[len++] = (char)c;
-    }
-
-    if (ferror(f)) {
-        perror(path);
-        fclose(f);
-        free(text);
-        return NULL;
+        ssize_t n = read(fd, buf + len, cap - len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror(path);
+            free(buf);
+            close(fd);
+            return 0;
+        }
+        if (n == 0)
+            break;
+        len += (size_t)n;
     }
-
-    fclose(f);
-
-    text[len] = '\0';
-    *out_len = len;
-    return text;
+    close(fd);
+    *out_data = buf;
+    *out_size = len;
+    *out_mapped = 0;
+    return 1;
 }
 
 /*
- * Break TEXT of length LEN into an array of NUL terminated lines.
- * The returned array is terminated with a NULL pointer.
+ * Read PATH into a newly allocated buffer while handling CR, CRLF and
+ * backslash-newline sequences and break it into NUL terminated lines in
+ * the same pass.  The returned array in *OUT_LINES points into the
+ * returned text and is terminated with a NULL pointer.  Regular files
+ * are remembered by the file cache so including them again only costs
+ * a copy of the already spliced text.
  */
-static char **split_file_lines(char *text, size_t len)
+static char *load_file_text(const char *path, char ***out_lines)
 {
-    size_t line_count = 1;
-    for (size_t i = 0; i < len; i++)
-        if (text[i] == '\n')
-            line_count++;
-    if (len > 0 && text[len - 1] == '\n')
-        line_count--;
+    const char *canon = file_cache_realpath(path);
+    char *cached;
+    if (file_cache_get_lines(canon, &cached, out_lines))
+        return cached;
+
+    const char *src;
+    size_t size;
+    int mapped;
+    struct stat st;
+    if (!map_source_file(path, &src, &size, &mapped, &st))
+        return NULL;
 
-    char **lines = vc_alloc_or_exit(sizeof(char *) * (line_count + 1));
+    /* splicing only ever removes bytes so SIZE + 1 is enough */
+    char *text = vc_alloc_or_exit(size + 1);
+    size_t line_cap = size / 32 + 2;
+    size_t line_count = 0;
+    char **lines = vc_alloc_or_exit(sizeof(char *) * line_cap);
+    lines[line_count++] = text;
 
-    size_t idx = 0;
-    lines[idx++] = text;
-    for (size_t i = 0; i < len; i++) {
-        if (text[i] == '\n') {
-            text[i] = '\0';
-            if (i + 1 < len)
-                lines[idx++] = &text[i + 1];
+    const char *p = src;
+    const char *end = src + size;
+    size_t len = 0;
+    while (p < end) {
+        const char *q = find_line_special(p, end);
+        memcpy(text + len, p, (size_t)(q - p));
+        len += (size_t)(q - p);
+        if (q == end)
+            break;
+        p = q + 1;
+        if (*q == '\r')
+            continue;
+        if (*q == '\\') {
+            if (p < end && *p == '\n') {
+                p++;
+                continue;
+            }
+            if (end - p >= 2 && p[0] == '\r' && p[1] == '\n') {
+                p += 2;
+                continue;
+            }
+            text[len++] = '\\';
+            continue;
         }
+        /* newline: terminate the line and start the next one */
+        text[len++] = '\0';
+        if (line_count + 1 >= line_cap) {
+            line_cap *= 2;
+            lines = vc_realloc_or_exit(lines, sizeof(char *) * line_cap);
+        }
+        lines[line_count++] = text + len;
     }
-    lines[idx] = NULL;
-    return lines;
+    text[len] = '\0';
+
+    /* a trailing newline does not begin another line */
+    if (line_count > 1 && lines[line_count - 1] == text + len)
+        line_count--;
+    lines[line_count] = NULL;
+
+    if (mapped)
+        munmap((void *)src, size);
+    else
+        free((void *)src);
+
+    if (S_ISREG(st.st_mode))
+        file_cache_put_lines(canon, text, len + 1, lines, &st);
+
+    *out_lines = lines;
+    return text;
 }
 
 /* Read PATH and split it into a NULL terminated list of line pointers. */
 static char *read_file_lines_internal(const char *path, char ***out_lines)
 {
-    size_t len;
-    char *text = load_file_text(path, &len);
-    if (!text)
-        return NULL;
-
-    char **lines = split_file_lines(text, len);
-    *out_lines = lines;
-    return text;
+    return load_file_text(path, out_lines);
 }
 
 char *read_file_lines(const char *path, char ***out_lines)
@@ -307,13 +382,43 @@ int open_source_file(const char *path, vector_t *stack, size_t idx,
     return 1;
 }
 
+/*
+ * Hand every complete line accumulated in OUT to the token stream and
+ * drop it from the buffer.  Any trailing partial line is kept so tokens
+ * never straddle two chunks.  Returns 1 on success or 0 on lexer error.
+ */
+static int flush_output_tokens(strbuf_t *out, preproc_context_t *ctx)
+{
+    size_t n = out->len;
+    while (n && out->data[n - 1] != '\n')
+        n--;
+    if (!n)
+        return 1;
+
+    char saved = out->data[n];
+    out->data[n] = '\0';
+    int ok = lexer_stream_feed(ctx->tokens, out->data);
+    out->data[n] = saved;
+    memmove(out->data, out->data + n, out->len - n + 1);
+    out->len -= n;
+    if (!ok)
+        fprintf(stderr, "Tokenization failed\n");
+    return ok;
+}
+
 int process_all_lines(char **lines, const char *path, const char *dir,
-                      vector_t *macros, vector_t *conds, strbuf_t *out,
+                      macro_table_t *macros, vector_t *conds, strbuf_t *out,
                       const vector_t *incdirs, vector_t *stack,
                       preproc_context_t *ctx)
 {
-    /* defined in preproc_directives.c */
-    for (size_t i = 0; lines[i]; i++) {
+    /* text lines may consume the following lines of a macro call */
+    char **saved_lines = ctx->lines;
+    size_t saved_index = ctx->line_index;
+    int ok = 1;
+    ctx->lines = lines;
+    for (ctx->line_index = 0; ok && lines[ctx->line_index];
+         ctx->line_index++) {
+        size_t i = ctx->line_index;
         long line_tmp = (long)(i + 1) + ctx->line_delta;
         if (line_tmp < 0)
             line_tmp = 0;
@@ -321,11 +426,14 @@ int process_all_lines(char **lines, const char *path, const char *dir,
         preproc_set_location(ctx,
                              ctx->current_file ? ctx->current_file : path,
                              line, 1);
-        if (!process_line(lines[i], dir, macros, conds, out, incdirs, stack,
-                          ctx))
-            return 0;
+        /* defined in preproc_directives.c */
+        ok = process_line(lines[i], dir, macros, conds, out, incdirs, stack,
+                          ctx) &&
+             (!ctx->tokens || flush_output_tokens(out, ctx));
     }
-    return 1;
+    ctx->lines = saved_lines;
+    ctx->line_index = saved_index;
+    return ok;
 }
 
 void cleanup_file_resources(char *text, char **lines, char *dir)
@@ -6,11 +6,11 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdint.h>
-#include <fcntl.h>
 #include <limits.h>
 #include <ctype.h>
 
 #include "util.h"
+#include "file_cache.h"
 #include "preproc_include.h"
 #include "preproc_cond.h"
 #include "preproc_file_io.h"
@@ -55,49 +55,172 @@ static void report_missing_include(const char *line, const char *fname,
     print_include_search_dirs(stderr, endc, dir, incdirs, start);
 }
 
-/* Shared logic for processing an include file */
-static char *fd_realpath(int fd, const char *fallback)
+/*
+ * Skip whitespace and comments starting at P.  IN_COMMENT carries the
+ * block comment state across lines.  Returns a pointer to the first
+ * significant character or to the terminating NUL.
+ */
+static const char *guard_skip_blank(const char *p, int *in_comment)
 {
-    char path[PATH_MAX];
-
-#ifdef F_GETPATH
-    if (fcntl(fd, F_GETPATH, path) == 0) {
-        char *canon = realpath(path, NULL);
-        if (!canon)
-            canon = vc_strdup(path);
-        return canon;
+    for (;;) {
+        if (*in_comment) {
+            const char *end = strstr(p, "*/");
+            if (!end)
+                return p + strlen(p);
+            p = end + 2;
+            *in_comment = 0;
+        }
+        while (isspace((unsigned char)*p))
+            p++;
+        if (p[0] == '/' && p[1] == '*') {
+            *in_comment = 1;
+            p += 2;
+        } else if (p[0] == '/' && p[1] == '/') {
+            return p + strlen(p);
+        } else {
+            return p;
+        }
     }
-#endif
+}
 
-#ifdef __linux__
-    char proc[64];
-    int ret = snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
-    if (ret < 0 || (size_t)ret >= sizeof(proc)) {
-        abort();
+/* Update IN_COMMENT for the remainder of a line starting at P */
+static void guard_track_comments(const char *p, int *in_comment)
+{
+    while (*(p = guard_skip_blank(p, in_comment))) {
+        if (*p == '"' || *p == '\'') {
+            char q = *p++;
+            while (*p && *p != q) {
+                if (*p == '\\' && p[1])
+                    p++;
+                p++;
+            }
+            if (*p)
+                p++;
+        } else {
+            p++;
+        }
+    }
+}
+
+/* Return non-zero when P starts with the directive keyword KW */
+static int guard_directive_is(const char *p, const char *kw)
+{
+    size_t len = strlen(kw);
+    return strncmp(p, kw, len) == 0 &&
+           !isalnum((unsigned char)p[len]) && p[len] != '_';
+}
+
+/* Parse an identifier at *P, advancing past it.  Returns its length. */
+static size_t guard_ident(const char **p)
+{
+    const char *s = *p;
+    if (!isalpha((unsigned char)*s) && *s != '_')
+        return 0;
+    while (isalnum((unsigned char)*s) || *s == '_')
+        s++;
+    size_t len = (size_t)(s - *p);
+    *p = s;
+    return len;
+}
+
+/*
+ * Parse the directive following '#' at P as the opening of an include
+ * guard: either `ifndef NAME` or `if !defined(NAME)`.  Returns the
+ * malloc'd macro name or NULL when the line has another form.
+ */
+static char *guard_parse_open(const char *p, int *in_comment)
+{
+    int negated_defined = 0;
+    if (guard_directive_is(p, "ifndef")) {
+        p += 6;
+    } else if (guard_directive_is(p, "if")) {
+        p = guard_skip_blank(p + 2, in_comment);
+        if (*p != '!')
+            return NULL;
+        p = guard_skip_blank(p + 1, in_comment);
+        if (!guard_directive_is(p, "defined"))
+            return NULL;
+        p += 7;
+        negated_defined = 1;
+    } else {
         return NULL;
     }
-    ssize_t len = readlink(proc, path, sizeof(path) - 1);
-    if (len >= 0) {
-        if (len == (ssize_t)sizeof(path) - 1) {
-            errno = ENAMETOOLONG;
+
+    p = guard_skip_blank(p, in_comment);
+    int paren = negated_defined && *p == '(';
+    if (paren)
+        p = guard_skip_blank(p + 1, in_comment);
+    const char *name = p;
+    size_t len = guard_ident(&p);
+    if (!len)
+        return NULL;
+    p = guard_skip_blank(p, in_comment);
+    if (paren) {
+        if (*p != ')')
             return NULL;
+        p = guard_skip_blank(p + 1, in_comment);
+    }
+    if (*p)
+        return NULL;
+    return vc_strndup(name, len);
+}
+
+/*
+ * Detect the classic include guard pattern in LINES.  The first
+ * significant line must open a conditional on a single macro not being
+ * defined and its matching #endif must be the last significant line
+ * with no #else or #elif at the outer level.  Returns the malloc'd name
+ * of the controlling macro or NULL when the file is not guarded.
+ */
+char *detect_include_guard(char **lines)
+{
+    int in_comment = 0;
+    size_t depth = 0;
+    int closed = 0;
+    char *guard = NULL;
+
+    for (size_t i = 0; lines[i]; i++) {
+        const char *p = guard_skip_blank(lines[i], &in_comment);
+        if (!*p)
+            continue;
+        if (closed || (!guard && *p != '#'))
+            goto not_guarded;
+        if (*p == '#') {
+            const char *d = p + 1;
+            while (*d == ' ' || *d == '\t')
+                d++;
+            if (!guard) {
+                guard = guard_parse_open(d, &in_comment);
+                if (!guard)
+                    goto not_guarded;
+                depth = 1;
+                continue;
+            }
+            if (guard_directive_is(d, "if") || guard_directive_is(d, "ifdef") ||
+                guard_directive_is(d, "ifndef")) {
+                depth++;
+            } else if (guard_directive_is(d, "endif")) {
+                if (--depth == 0)
+                    closed = 1;
+            } else if (depth == 1 && (guard_directive_is(d, "else") ||
+                                      guard_directive_is(d, "elif") ||
+                                      guard_directive_is(d, "elifdef") ||
+                                      guard_directive_is(d, "elifndef"))) {
+                goto not_guarded;
+            }
         }
-        path[len] = '\0';
-        char *canon = realpath(path, NULL);
-        if (!canon)
-            canon = vc_strdup(path);
-        return canon;
+        guard_track_comments(p, &in_comment);
     }
-#endif
+    if (closed)
+        return guard;
 
-    char *canon = realpath(fallback, NULL);
-    if (!canon)
-        canon = vc_strdup(fallback);
-    return canon;
+not_guarded:
+    free(guard);
+    return NULL;
 }
 
 static int process_include_file(const char *fname, const char *chosen,
-                                size_t idx, vector_t *macros, vector_t *conds,
+                                size_t idx, macro_table_t *macros, vector_t *conds,
                                 strbuf_t *out, const vector_t *incdirs,
                                 vector_t *stack, preproc_context_t *ctx)
 {
@@ -109,16 +232,11 @@ static int process_include_file(const char *fname, const char *chosen,
         if (!chosen) {
             ok = 0;
         } else {
-            int fd = open(chosen, O_RDONLY);
-            char *canon = NULL;
-            if (fd >= 0) {
-                canon = fd_realpath(fd, chosen);
-                close(fd);
-            }
-            if (!canon)
-                canon = vc_strdup(chosen);
+            const char *canon = file_cache_realpath(chosen);
 
-            if (!pragma_once_contains(ctx, canon)) {
+            if (include_guard_skip(ctx, canon, macros)) {
+                /* guard macro still defined: the file would expand to nothing */
+            } else if (!pragma_once_contains(ctx, canon)) {
                 if (include_stack_contains(stack, canon)) {
                     fprintf(stderr, "Include cycle detected: %s\n", canon);
                     ok = 0;
@@ -129,7 +247,6 @@ static int process_include_file(const char *fname, const char *chosen,
                     ok = 0;
                 }
             }
-            free(canon);
         }
     }
     vector_free(&subconds);
@@ -137,7 +254,7 @@ static int process_include_file(const char *fname, const char *chosen,
 }
 
 
-int handle_include(char *line, const char *dir, vector_t *macros,
+int handle_include(char *line, const char *dir, macro_table_t *macros,
                    vector_t *conds, strbuf_t *out,
                    const vector_t *incdirs, vector_t *stack,
                    preproc_context_t *ctx)
@@ -171,7 +288,7 @@ int handle_include(char *line, const char *dir, vector_t *macros,
     return result;
 }
 
-int handle_include_next(char *line, const char *dir, vector_t *macros,
+int handle_include_next(char *line, const char *dir, macro_table_t *macros,
                         vector_t *conds, strbuf_t *out,
                         const vector_t *incdirs, vector_t *stack,
                         preproc_context_t *ctx)
@@ -206,26 +323,17 @@ int handle_include_next(char *line, const char *dir, vector_t *macros,
         if (e->dir_index == (size_t)-1) {
             const char *slash = strrchr(e->path, '/');
             if (slash) {
-                char *curdir = vc_strndup(e->path, (size_t)(slash - e->path));
-                if (curdir) {
-                    char *canon_cur = realpath(curdir, NULL);
-                    if (canon_cur) {
-                        free(curdir);
-                        curdir = canon_cur;
-                    }
+                char *dir_path = vc_strndup(e->path, (size_t)(slash - e->path));
+                if (dir_path) {
+                    const char *curdir = file_cache_realpath(dir_path);
                     for (size_t i = 0; i < incdirs->count; i++) {
                         const char *base = ((const char **)incdirs->data)[i];
-                        char *canon_base = realpath(base, NULL);
-                        if (!canon_base)
-                            canon_base = vc_strdup(base);
-                        if (canon_base && strcmp(canon_base, curdir) == 0) {
+                        if (strcmp(file_cache_realpath(base), curdir) == 0) {
                             start_idx = i + 1;
-                            free(canon_base);
                             break;
                         }
-                        free(canon_base);
                     }
-                    free(curdir);
+                    free(dir_path);
                 }
             }
         } else {
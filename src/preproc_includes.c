@@ -23,7 +23,7 @@
 
 
 
-int handle_include_directive(char *line, const char *dir, vector_t *macros,
+int handle_include_directive(char *line, const char *dir, macro_table_t *macros,
                              vector_t *conds, strbuf_t *out,
                              const vector_t *incdirs, vector_t *stack,
                              preproc_context_t *ctx)
@@ -31,7 +31,7 @@ int handle_include_directive(char *line, const char *dir, vector_t *macros,
     return handle_include(line, dir, macros, conds, out, incdirs, stack, ctx);
 }
 
-int handle_line_directive(char *line, const char *dir, vector_t *macros,
+int handle_line_directive(char *line, const char *dir, macro_table_t *macros,
                           vector_t *conds, strbuf_t *out,
                           const vector_t *incdirs, vector_t *stack,
                           preproc_context_t *ctx)
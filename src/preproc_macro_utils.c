@@ -1,56 +1,64 @@
 #define _POSIX_C_SOURCE 200809L
-#include <ctype.h>
 #include <string.h>
 #include "preproc_macro_utils.h"
+#include "intern.h"
+#include "strbuf.h"
+#include "util.h"
 
-size_t parse_ident(const char *s)
-{
-    size_t i = 0;
-    if (!isalpha((unsigned char)s[i]) && s[i] != '_')
-        return 0;
-    i++;
-    while (isalnum((unsigned char)s[i]) || s[i] == '_')
-        i++;
-    return i;
-}
-
-const char *lookup_param(const char *name, size_t len,
-                         const vector_t *params, char **args)
+int lookup_param(const pp_token_t *tok, const vector_t *params,
+                 int variadic)
 {
+    if (tok->kind != PP_IDENT)
+        return -1;
     for (size_t p = 0; p < params->count; p++) {
         const char *param = ((char **)params->data)[p];
-        if (strlen(param) == len && strncmp(param, name, len) == 0)
-            return args[p];
+        if (strcmp(param, tok->text) == 0)
+            return (int)p;
     }
-    return NULL;
+    if (variadic && strcmp(tok->text, "__VA_ARGS__") == 0)
+        return (int)params->count;
+    return -1;
 }
 
-size_t append_stringized_param(const char *value, size_t i,
-                               const vector_t *params, char **args,
-                               int variadic, strbuf_t *sb)
+/*
+ * Whitespace between the tokens becomes one space and only the quotes
+ * and backslashes of string and character literals are escaped.
+ */
+int stringize_tokens(const pp_token_t *toks, size_t count, pp_token_t *out)
 {
-    size_t j = i + 1;
-    while (value[j] == ' ' || value[j] == '\t')
-        j++;
-    size_t len = parse_ident(value + j);
-    if (len) {
-        const char *rep = lookup_param(value + j, len, params, args);
-        if (!rep && variadic && len == 11 &&
-            strncmp(value + j, "__VA_ARGS__", 11) == 0)
-            rep = args[params->count];
-        if (rep) {
-            strbuf_append(sb, "\"");
-            for (size_t k = 0; rep[k]; k++) {
-                char c = rep[k];
-                if (c == '\\' || c == '"')
-                    strbuf_appendf(sb, "\\%c", c);
-                else
-                    strbuf_appendf(sb, "%c", c);
-            }
-            strbuf_append(sb, "\"");
-            return j + len;
+    strbuf_t sb;
+    strbuf_init(&sb);
+    int ok = strbuf_append(&sb, "\"") == 0;
+    for (size_t i = 0; ok && i < count; i++) {
+        const pp_token_t *t = &toks[i];
+        if (i && t->ws_len && strbuf_append(&sb, " ") != 0)
+            ok = 0;
+        if (t->kind != PP_STRING && t->kind != PP_CHAR) {
+            if (ok && strbuf_append(&sb, t->text) != 0)
+                ok = 0;
+            continue;
         }
+        for (const char *c = t->text; ok && *c; c++) {
+            if ((*c == '\\' || *c == '"') && strbuf_append(&sb, "\\") != 0)
+                ok = 0;
+            if (ok && strbuf_appendf(&sb, "%c", *c) < 0)
+                ok = 0;
+        }
+    }
+    if (ok && strbuf_append(&sb, "\"") != 0)
+        ok = 0;
+    if (ok) {
+        out->text = intern_text(sb.data, sb.len);
+        out->len = (unsigned)sb.len;
+        out->ws = "";
+        out->ws_len = 0;
+        out->kind = PP_STRING;
+        out->flags = 0;
+        out->param = -1;
+        out->macro = NULL;
+    } else {
+        vc_oom();
     }
-    strbuf_append(sb, "#");
-    return i + 1;
+    strbuf_free(&sb);
+    return ok;
 }
@@ -1,126 +1,201 @@
 #define _POSIX_C_SOURCE 200809L
-#include <ctype.h>
+/*
+ * Parameter substitution with the # and ## operators.
+ *
+ * Both operators work on pp-tokens: # spells the tokens of an argument as
+ * a string literal and ## joins the spellings of its two operands and
+ * lexes the result again.  An empty argument used with ## is kept as a
+ * placemarker until the body has been processed.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
 #include <string.h>
 #include "preproc_paste.h"
 #include "preproc_macro_utils.h"
 #include "strbuf.h"
 #include "util.h"
 
-static void trim_trailing_ws(strbuf_t *sb)
+static int push_token(vector_t *out, const pp_token_t *tok)
 {
-    while (sb->len > 0 &&
-           (sb->data[sb->len - 1] == ' ' || sb->data[sb->len - 1] == '\t')) {
-        sb->len--;
-        sb->data[sb->len] = '\0';
+    if (!vector_push(out, tok)) {
+        vc_oom();
+        return 0;
     }
+    return 1;
 }
 
-static int append_pasted_tokens(const char *value, size_t i, size_t len,
-                                const char *rep, const vector_t *params,
-                                char **args, int variadic, strbuf_t *sb,
-                                size_t *out_i)
+/* Append COUNT tokens to OUT, the first one taking the whitespace of WS */
+static int append_tokens(vector_t *out, const pp_token_t *toks, size_t count,
+                         const pp_token_t *ws)
 {
-    size_t k = i + len;
-    while (value[k] == ' ' || value[k] == '\t')
-        k++;
-    if (value[k] != '#' || value[k + 1] != '#') {
-        size_t j = i;
-        while (j >= 2 && (value[j-1]==' ' || value[j-1]=='\t'))
-            j--;
-        if (j >= 2 && value[j-2]=='#' && value[j-1]=='#') {
-            trim_trailing_ws(sb);
-            if (sb->len >= 2 && sb->data[sb->len-2]=='#' && sb->data[sb->len-1]=='#') {
-                sb->len -= 2;
-                sb->data[sb->len] = '\0';
-            }
-        } else {
-            return 0;
+    for (size_t i = 0; i < count; i++) {
+        pp_token_t t = toks[i];
+        if (i == 0) {
+            t.ws = ws->ws;
+            t.ws_len = ws->ws_len;
         }
-    } else {
-        k += 2;
-        while (value[k] == ' ' || value[k] == '\t')
-            k++;
+        if (!push_token(out, &t))
+            return 0;
     }
+    return 1;
+}
 
-    if (!value[k]) {
-        trim_trailing_ws(sb);
-        if (rep)
-            strbuf_append(sb, rep);
-        else
-            strbuf_appendf(sb, "%.*s", (int)len, value + i);
-        *out_i = k;
-    } else if (isalpha((unsigned char)value[k]) || value[k] == '_') {
-        size_t l = parse_ident(value + k);
-        const char *rep2 = lookup_param(value + k, l, params, args);
-        if (!rep2 && variadic && l == 11 &&
-            strncmp(value + k, "__VA_ARGS__", 11) == 0)
-            rep2 = args[params->count];
-        trim_trailing_ws(sb);
-        if (rep)
-            strbuf_append(sb, rep);
-        else
-            strbuf_appendf(sb, "%.*s", (int)len, value + i);
-        if (rep2)
-            strbuf_append(sb, rep2);
-        else
-            strbuf_appendf(sb, "%.*s", (int)l, value + k);
-        *out_i = k + l;
-    } else {
-        trim_trailing_ws(sb);
-        if (rep)
-            strbuf_append(sb, rep);
-        else
-            strbuf_appendf(sb, "%.*s", (int)len, value + i);
-        strbuf_appendf(sb, "%c", value[k]);
-        *out_i = k + 1;
+int prepare_macro_body(macro_t *m)
+{
+    if (m->body_ready)
+        return 1;
+    vector_init(&m->body, sizeof(pp_token_t));
+    if (!pp_lex(m->value, &m->body)) {
+        vector_free(&m->body);
+        return 0;
     }
+    pp_token_t *b = m->body.data;
+    size_t n = m->body.count;
+    int fn = m->function_like;
+    for (size_t i = 0; fn && i < n; i++)
+        b[i].param = (short)lookup_param(&b[i], &m->params, m->variadic);
+    for (size_t i = 0; i < n; i++) {
+        if (pp_is_punct(&b[i], "##")) {
+            if (i > 0 && b[i - 1].param >= 0)
+                b[i - 1].flags |= PP_RAW_ARG;
+            if (i + 1 < n && b[i + 1].param >= 0)
+                b[i + 1].flags |= PP_RAW_ARG;
+        } else if (fn && pp_is_punct(&b[i], "#") && i + 1 < n &&
+                   b[i + 1].param >= 0) {
+            b[i + 1].flags |= PP_RAW_ARG;
+        }
+    }
+    m->body_ready = 1;
     return 1;
 }
 
-char *expand_params(const char *value, const vector_t *params, char **args,
-                    int variadic)
+/*
+ * Paste the last token of OUT with the first of the COUNT tokens at RHS
+ * and append the remaining ones.  OP supplies the whitespace when there
+ * is nothing to paste to.  The joined spelling is lexed again; when it
+ * does not form a single token the pieces are kept side by side.
+ */
+static int paste_tokens(vector_t *out, const pp_token_t *rhs, size_t count,
+                        const pp_token_t *op)
 {
+    if (!count)
+        return 1;
+    pp_token_t *lhs = out->count ?
+                      &((pp_token_t *)out->data)[out->count - 1] : NULL;
+    if (!lhs || lhs->kind == PP_PLACEMARKER) {
+        pp_token_t ws = lhs ? *lhs : *op;
+        if (lhs)
+            out->count--;
+        return append_tokens(out, rhs, count, &ws);
+    }
+
     strbuf_t sb;
+    vector_t res;
     strbuf_init(&sb);
-    for (size_t i = 0; value[i];) {
-        if (value[i] == '#' && value[i + 1] != '#') {
-            i = append_stringized_param(value, i, params, args, variadic, &sb);
+    vector_init(&res, sizeof(pp_token_t));
+    int ok = strbuf_appendf(&sb, "%s%s", lhs->text, rhs->text) == 0 &&
+             pp_lex(sb.data, &res);
+    if (ok) {
+        pp_token_t ws = *lhs;
+        pp_token_t *r = res.data;
+        for (size_t i = 0; i < res.count; i++) {
+            r[i].ws = "";
+            r[i].ws_len = 0;
+        }
+        out->count--;
+        ok = append_tokens(out, r, res.count, &ws) &&
+             (count == 1 || append_tokens(out, rhs + 1, count - 1, rhs + 1));
+    }
+    vector_free(&res);
+    strbuf_free(&sb);
+    return ok;
+}
+
+/* Handle "## R" where R is the body token after the operator */
+static int paste_operand(const macro_t *m, macro_arg_t *args,
+                         const pp_token_t *r, int after_comma,
+                         vector_t *out)
+{
+    const pp_token_t *toks = r;
+    size_t count = 1;
+    if (r->param >= 0) {
+        toks = args[r->param].toks;
+        count = args[r->param].count;
+    }
+    /* GNU extension: ", ## __VA_ARGS__" drops the comma for no arguments */
+    if (after_comma && m->variadic && r->param == (int)m->params.count) {
+        if (!count) {
+            out->count--;
+            return 1;
+        }
+        return append_tokens(out, toks, count, r);
+    }
+    return paste_tokens(out, toks, count, r);
+}
+
+/* Drop the placemarkers left by empty operands of ## */
+static void remove_placemarkers(vector_t *out)
+{
+    pp_token_t *t = out->data;
+    size_t n = 0;
+    for (size_t i = 0; i < out->count; i++) {
+        if (t[i].kind != PP_PLACEMARKER)
+            t[n++] = t[i];
+    }
+    out->count = n;
+}
+
+int expand_params(const macro_t *m, macro_arg_t *args, vector_t *out)
+{
+    const pp_token_t *b = m->body.data;
+    size_t n = m->body.count;
+    int fn = m->function_like;
+    for (size_t i = 0; i < n; i++) {
+        const pp_token_t *t = &b[i];
+        if (pp_is_punct(t, "##")) {
+            /* an operator without a right operand is dropped */
+            if (i + 1 == n)
+                continue;
+            int after_comma = i > 0 && pp_is_punct(&b[i - 1], ",");
+            if (!paste_operand(m, args, &b[++i], after_comma, out))
+                return 0;
             continue;
         }
-        if (value[i] == '#' && value[i + 1] == '#') {
-            strbuf_append(&sb, "##");
-            i += 2;
-            while (value[i] == ' ' || value[i] == '\t') {
-                strbuf_appendf(&sb, "%c", value[i]);
-                i++;
-            }
+        if (fn && pp_is_punct(t, "#") && i + 1 < n && b[i + 1].param >= 0) {
+            macro_arg_t *a = &args[b[++i].param];
+            pp_token_t s;
+            if (!stringize_tokens(a->toks, a->count, &s))
+                return 0;
+            s.ws = t->ws;
+            s.ws_len = t->ws_len;
+            if (!push_token(out, &s))
+                return 0;
             continue;
         }
-        size_t len = parse_ident(value + i);
-        if (len) {
-            const char *rep = lookup_param(value + i, len, params, args);
-            if (!rep && variadic && len == 11 &&
-                strncmp(value + i, "__VA_ARGS__", 11) == 0)
-                rep = args[params->count];
-            size_t next;
-            if (append_pasted_tokens(value, i, len, rep, params, args, variadic,
-                                     &sb, &next)) {
-                i = next;
-                continue;
-            }
-            if (rep)
-                strbuf_append(&sb, rep);
-            else
-                strbuf_appendf(&sb, "%.*s", (int)len, value + i);
-            i += len;
+        if (t->param < 0) {
+            if (!push_token(out, t))
+                return 0;
             continue;
         }
-        strbuf_appendf(&sb, "%c", value[i]);
-        i++;
+        macro_arg_t *a = &args[t->param];
+        int ok;
+        if (!(t->flags & PP_RAW_ARG)) {
+            ok = append_tokens(out, a->expanded.data, a->expanded.count, t);
+        } else if (a->count) {
+            ok = append_tokens(out, a->toks, a->count, t);
+        } else {
+            pp_token_t mark = *t;
+            mark.kind = PP_PLACEMARKER;
+            mark.text = "";
+            mark.len = 0;
+            mark.param = -1;
+            ok = push_token(out, &mark);
+        }
+        if (!ok)
+            return 0;
     }
-    char *out = vc_strdup(sb.data ? sb.data : "");
-    strbuf_free(&sb);
-    if (!out)
-        vc_oom();
-    return out;
+    remove_placemarkers(out);
+    return 1;
 }
@@ -10,6 +10,9 @@
 #include "util.h"
 #include "preproc_path.h"
 #include "include_path_cache.h"
+#include "file_cache.h"
+#include "include_index.h"
+#include "preproc_macros.h"
 #include <stdbool.h>
 
 /* Default system include search paths */
@@ -22,25 +25,21 @@
 
 static vector_t extra_sys_dirs;
 static int verbose_includes = 0;
+static int include_index_stats = 0;
 static const char *internal_libc_dir = PROJECT_ROOT "/libc/include";
 
 int record_dependency(preproc_context_t *ctx, const char *path)
 {
-    char *canon = realpath(path, NULL);
-    if (!canon)
-        canon = vc_strdup(path);
-    if (!canon)
-        return 0;
+    const char *real = file_cache_realpath(path);
 
     for (size_t i = 0; i < ctx->deps.count; i++) {
         const char *p = ((const char **)ctx->deps.data)[i];
-        if (strcmp(p, canon) == 0) {
-            free(canon);
+        if (strcmp(p, real) == 0)
             return 1;
-        }
     }
 
-    if (!vector_push(&ctx->deps, &canon)) {
+    char *canon = vc_strdup(real);
+    if (!canon || !vector_push(&ctx->deps, &canon)) {
         free(canon);
         vc_oom();
         return 0;
@@ -52,44 +51,118 @@ int record_dependency(preproc_context_t *ctx, const char *path)
 
 int pragma_once_contains(preproc_context_t *ctx, const char *path)
 {
-    char *canon = realpath(path, NULL);
-    if (!canon)
-        canon = vc_strdup(path);
-    if (!canon)
-        return 0;
+    const char *canon = file_cache_realpath(path);
     for (size_t i = 0; i < ctx->pragma_once_files.count; i++) {
         const char *p = ((const char **)ctx->pragma_once_files.data)[i];
-        if (strcmp(p, canon) == 0) {
-            free(canon);
+        if (strcmp(p, canon) == 0)
             return 1;
-        }
     }
-    free(canon);
     return 0;
 }
 
 int pragma_once_add(preproc_context_t *ctx, const char *path)
 {
-    char *canon = realpath(path, NULL);
-    if (!canon)
-        canon = vc_strdup(path);
-    if (!canon)
+    if (pragma_once_contains(ctx, path))
+        return 1;
+    char *canon = vc_strdup(file_cache_realpath(path));
+    if (!canon || !vector_push(&ctx->pragma_once_files, &canon)) {
+        free(canon);
+        vc_oom();
         return 0;
-    for (size_t i = 0; i < ctx->pragma_once_files.count; i++) {
-        const char *p = ((const char **)ctx->pragma_once_files.data)[i];
-        if (strcmp(p, canon) == 0) {
-            free(canon);
+    }
+    return 1;
+}
+
+/*
+ * Remember that the header at the canonical PATH is wrapped in an
+ * include guard controlled by MACRO.  An existing entry is updated.
+ */
+int include_guard_add(preproc_context_t *ctx, const char *path,
+                      const char *macro)
+{
+    for (size_t i = 0; i < ctx->include_guards.count; i++) {
+        include_guard_t *g = &((include_guard_t *)ctx->include_guards.data)[i];
+        if (strcmp(g->path, path) == 0) {
+            if (strcmp(g->macro, macro) != 0) {
+                char *dup = vc_strdup(macro);
+                if (!dup) {
+                    vc_oom();
+                    return 0;
+                }
+                free(g->macro);
+                g->macro = dup;
+            }
             return 1;
         }
     }
-    if (!vector_push(&ctx->pragma_once_files, &canon)) {
-        free(canon);
+    include_guard_t g = { vc_strdup(path), vc_strdup(macro) };
+    if (!g.path || !g.macro || !vector_push(&ctx->include_guards, &g)) {
+        free(g.path);
+        free(g.macro);
         vc_oom();
         return 0;
     }
     return 1;
 }
 
+/*
+ * Return non-zero when the header at the canonical PATH has a known
+ * include guard whose macro is currently defined.  Including it again
+ * would produce no output, so the caller may skip it without reading
+ * the file.
+ */
+int include_guard_skip(preproc_context_t *ctx, const char *path,
+                       macro_table_t *macros)
+{
+    for (size_t i = 0; i < ctx->include_guards.count; i++) {
+        const include_guard_t *g =
+            &((const include_guard_t *)ctx->include_guards.data)[i];
+        if (strcmp(g->path, path) != 0)
+            continue;
+        if (!is_macro_defined(macros, g->macro))
+            return 0;
+        ctx->guard_skips++;
+        if (verbose_includes)
+            fprintf(stderr, "skipping %s (guarded by %s)\n", path, g->macro);
+        return 1;
+    }
+    return 0;
+}
+
+/* Release the include guard table */
+void include_guard_free(preproc_context_t *ctx)
+{
+    for (size_t i = 0; i < ctx->include_guards.count; i++) {
+        include_guard_t *g = &((include_guard_t *)ctx->include_guards.data)[i];
+        free(g->path);
+        free(g->macro);
+    }
+    vector_free(&ctx->include_guards);
+}
+
+/* Print include statistics when verbose include output is enabled */
+void preproc_report_include_stats(const preproc_context_t *ctx)
+{
+    if (verbose_includes)
+        fprintf(stderr, "include guards: %zu re-reads skipped\n",
+                ctx->guard_skips);
+    if (include_index_stats)
+        include_index_print_stats(stderr);
+}
+
+/*
+ * Return non-zero when FNAME can be read below the search directory
+ * BASE.  PATH holds the joined path.  With the directory index enabled
+ * names missing from the listing are rejected without a system call.
+ */
+static int probe_include(const char *base, const char *fname,
+                         const char *path)
+{
+    if (include_index_enabled() && include_index_lookup(base, fname) == 0)
+        return 0;
+    return file_cache_readable(path);
+}
+
 char *find_include_path(const char *fname, char endc, const char *dir,
                         const vector_t *incdirs, size_t start, size_t *out_idx)
 {
@@ -129,7 +202,7 @@ char *find_include_path(const char *fname, char endc, const char *dir,
         }
         if (verbose_includes)
             fprintf(stderr, "checking %s%s\n", dir, fname);
-        if (access(out_path, R_OK) == 0) {
+        if (probe_include(dir, fname, out_path)) {
             if (out_idx)
                 *out_idx = (size_t)-1;
             if (verbose_includes)
@@ -147,7 +220,7 @@ char *find_include_path(const char *fname, char endc, const char *dir,
         }
         if (verbose_includes)
             fprintf(stderr, "checking %s/%s\n", base, fname);
-        if (access(out_path, R_OK) == 0) {
+        if (probe_include(base, fname, out_path)) {
             if (out_idx)
                 *out_idx = i;
             if (verbose_includes)
@@ -169,7 +242,7 @@ char *find_include_path(const char *fname, char endc, const char *dir,
             }
             if (verbose_includes)
                 fprintf(stderr, "checking %s/%s\n", base, fname);
-            if (access(out_path, R_OK) == 0) {
+            if (probe_include(base, fname, out_path)) {
                 if (out_idx)
                     *out_idx = incdirs->count + i;
                 if (verbose_includes)
@@ -188,7 +261,7 @@ char *find_include_path(const char *fname, char endc, const char *dir,
             }
             if (verbose_includes)
                 fprintf(stderr, "checking %s/%s\n", std_include_dirs[i], fname);
-            if (access(out_path, R_OK) == 0) {
+            if (probe_include(std_include_dirs[i], fname, out_path)) {
                 if (out_idx)
                     *out_idx = incdirs->count + extra_sys_dirs.count + i;
                 if (verbose_includes)
@@ -208,7 +281,7 @@ char *find_include_path(const char *fname, char endc, const char *dir,
         }
         if (verbose_includes)
             fprintf(stderr, "checking %s\n", out_path);
-        if (access(out_path, R_OK) == 0) {
+        if (file_cache_readable(out_path)) {
             if (out_idx)
                 *out_idx = (size_t)-1;
             if (verbose_includes)
@@ -226,7 +299,7 @@ char *find_include_path(const char *fname, char endc, const char *dir,
         }
         if (verbose_includes)
             fprintf(stderr, "checking %s/%s\n", base, fname);
-        if (access(out_path, R_OK) == 0) {
+        if (probe_include(base, fname, out_path)) {
             if (out_idx)
                 *out_idx = incdirs->count + i;
             if (verbose_includes)
@@ -245,7 +318,7 @@ char *find_include_path(const char *fname, char endc, const char *dir,
         }
         if (verbose_includes)
             fprintf(stderr, "checking %s/%s\n", std_include_dirs[i], fname);
-        if (access(out_path, R_OK) == 0) {
+        if (probe_include(std_include_dirs[i], fname, out_path)) {
             if (out_idx)
                 *out_idx = incdirs->count + extra_sys_dirs.count + i;
             if (verbose_includes)
@@ -425,6 +498,12 @@ void preproc_set_verbose_includes(bool flag)
     verbose_includes = flag ? 1 : 0;
 }
 
+void preproc_set_include_index(bool enable, bool stats)
+{
+    include_index_enable(enable || stats);
+    include_index_stats = stats ? 1 : 0;
+}
+
 void preproc_set_internal_libc_dir(const char *path)
 {
     internal_libc_dir = (path && *path) ? path : PROJECT_ROOT "/libc/include";
@@ -433,6 +512,8 @@ void preproc_set_internal_libc_dir(const char *path)
 void preproc_path_cleanup(void)
 {
     include_path_cache_cleanup();
+    file_cache_cleanup();
+    include_index_cleanup();
     free_string_vector(&extra_sys_dirs);
 }
 
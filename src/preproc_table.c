@@ -2,8 +2,8 @@
 /*
  * Macro table management and expansion logic.
  *
- * This module stores macro definitions and performs textual replacement
- * during preprocessing.  Macros may be object-like or take parameters,
+ * This module stores macro definitions used for replacement during
+ * preprocessing.  Macros may be object-like or take parameters,
  * supporting the `#` stringize and `##` token pasting operators.  Macro
  * bodies are expanded recursively so definitions can reference other macros.
  *
@@ -38,12 +38,139 @@ void macro_free(macro_t *m)
         free(((char **)m->params.data)[i]);
     vector_free(&m->params);
     free(m->value);
+    if (m->body_ready)
+        vector_free(&m->body);
 }
+/* Initial number of slots allocated for a macro table */
+#define MACRO_TABLE_INIT_CAP 256
+
+/* Marker left in a slot after its macro has been removed */
+static struct macro macro_tombstone;
+#define MACRO_TOMBSTONE (&macro_tombstone)
+
+/* FNV-1a hash of the LEN bytes at NAME */
+static unsigned hash_name(const char *name, size_t len)
+{
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void macro_table_init(macro_table_t *t)
+{
+    t->slots = NULL;
+    t->cap = 0;
+    t->count = 0;
+    t->used = 0;
+}
+
+void macro_table_free(macro_table_t *t)
+{
+    if (!t)
+        return;
+    for (size_t i = 0; i < t->cap; i++) {
+        macro_t *m = t->slots[i];
+        if (m && m != MACRO_TOMBSTONE) {
+            macro_free(m);
+            free(m);
+        }
+    }
+    free(t->slots);
+    macro_table_init(t);
+}
+
+/*
+ * Return the slot holding the macro NAME or, when absent, the slot where
+ * it would be inserted.  The first tombstone seen along the probe
+ * sequence is preferred for insertion.  The table must be allocated.
+ */
+static macro_t **find_slot(const macro_table_t *t, const char *name,
+                           size_t len, unsigned hash)
+{
+    size_t mask = t->cap - 1;
+    macro_t **tomb = NULL;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        macro_t **slot = &t->slots[i];
+        macro_t *m = *slot;
+        if (!m)
+            return tomb ? tomb : slot;
+        if (m == MACRO_TOMBSTONE) {
+            if (!tomb)
+                tomb = slot;
+        } else if (m->hash == hash && m->name_len == len &&
+                   memcmp(m->name, name, len) == 0) {
+            return slot;
+        }
+    }
+}
+
+/* Grow the slot array, dropping tombstones.  Returns 0 on failure. */
+static int macro_table_rehash(macro_table_t *t, size_t cap)
+{
+    macro_t **slots = calloc(cap, sizeof(*slots));
+    if (!slots)
+        return 0;
+    for (size_t i = 0; i < t->cap; i++) {
+        macro_t *m = t->slots[i];
+        if (!m || m == MACRO_TOMBSTONE)
+            continue;
+        size_t j = m->hash & (cap - 1);
+        while (slots[j])
+            j = (j + 1) & (cap - 1);
+        slots[j] = m;
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->cap = cap;
+    t->used = t->count;
+    return 1;
+}
+
+macro_t *macro_table_lookup(const macro_table_t *t, const char *name,
+                            size_t len)
+{
+    if (!t->count)
+        return NULL;
+    macro_t *m = *find_slot(t, name, len, hash_name(name, len));
+    return m == MACRO_TOMBSTONE ? NULL : m;
+}
+
+/*
+ * Store M in the table, replacing any existing definition with the same
+ * name.  The table takes ownership of M.  Returns 0 on allocation failure.
+ */
+static int macro_table_insert(macro_table_t *t, macro_t *m)
+{
+    /* keep the load factor, tombstones included, below 3/4 */
+    if ((t->used + 1) * 4 > t->cap * 3) {
+        size_t cap = t->cap ? t->cap : MACRO_TABLE_INIT_CAP;
+        while ((t->count + 1) * 2 > cap)
+            cap *= 2;
+        if (!macro_table_rehash(t, cap))
+            return 0;
+    }
+    macro_t **slot = find_slot(t, m->name, m->name_len, m->hash);
+    macro_t *old = *slot;
+    if (old && old != MACRO_TOMBSTONE) {
+        macro_free(old);
+        free(old);
+    } else {
+        if (!old)
+            t->used++;
+        t->count++;
+    }
+    *slot = m;
+    return 1;
+}
+
 /*
  * Return non-zero if a macro with the given name exists in the
- * macro vector.
+ * macro table.
  */
-int is_macro_defined(vector_t *macros, const char *name)
+int is_macro_defined(macro_table_t *macros, const char *name)
 {
     if (strcmp(name, "__FILE__") == 0 || strcmp(name, "__LINE__") == 0 ||
         strcmp(name, "__DATE__") == 0 || strcmp(name, "__TIME__") == 0 ||
@@ -53,33 +180,28 @@ int is_macro_defined(vector_t *macros, const char *name)
         strcmp(name, "__INCLUDE_LEVEL__") == 0)
         return 1;
 
-    for (size_t i = 0; i < macros->count; i++) {
-        macro_t *m = &((macro_t *)macros->data)[i];
-        if (strcmp(m->name, name) == 0)
-            return 1;
-    }
-    return 0;
+    return macro_table_lookup(macros, name, strlen(name)) != NULL;
 }
 
 /*
- * Delete all macros matching the given name from the macro list.
+ * Delete the macro matching the given name from the macro table.
  *
- * Each removed entry is cleaned up with macro_free().  The order of the
- * remaining macros is preserved.
+ * The removed entry is cleaned up with macro_free() and its slot is
+ * marked as a tombstone.
  */
-void remove_macro(vector_t *macros, const char *name)
+void remove_macro(macro_table_t *macros, const char *name)
 {
-    for (size_t i = 0; i < macros->count;) {
-        macro_t *m = &((macro_t *)macros->data)[i];
-        if (strcmp(m->name, name) == 0) {
-            macro_free(m);
-            if (i + 1 < macros->count)
-                memmove(m, m + 1, (macros->count - i - 1) * sizeof(macro_t));
-            macros->count--;
-        } else {
-            i++;
-        }
-    }
+    if (!macros->count)
+        return;
+    size_t len = strlen(name);
+    macro_t **slot = find_slot(macros, name, len, hash_name(name, len));
+    macro_t *m = *slot;
+    if (!m || m == MACRO_TOMBSTONE)
+        return;
+    macro_free(m);
+    free(m);
+    *slot = MACRO_TOMBSTONE;
+    macros->count--;
 }
 
 
@@ -173,41 +295,62 @@ static char *parse_macro_params(char *p, vector_t *out, int *variadic)
     return p;
 }
 
-int add_macro(const char *name, const char *value, vector_t *params,
-              int variadic, vector_t *macros)
+/*
+ * Create a macro and insert it into MACROS.  FUNCTION_LIKE is set for
+ * definitions with a parameter list, which may be empty.
+ */
+static int define_macro(const char *name, const char *value, vector_t *params,
+                        int variadic, int function_like,
+                        macro_table_t *macros)
 {
-    macro_t m;
-    m.name = vc_strdup(name);
-    m.value = NULL;
-    vector_init(&m.params, sizeof(char *));
+    macro_t *m = malloc(sizeof(*m));
+    if (!m) {
+        free_param_vector(params);
+        vc_oom();
+        return 0;
+    }
+    m->name = vc_strdup(name);
+    m->name_len = strlen(name);
+    m->hash = hash_name(name, m->name_len);
+    m->value = NULL;
+    m->body_ready = 0;
+    vector_init(&m->params, sizeof(char *));
     for (size_t i = 0; i < params->count; i++) {
         char *pname = ((char **)params->data)[i];
-        if (!vector_push(&m.params, &pname)) {
+        if (!vector_push(&m->params, &pname)) {
             free(pname);
             for (size_t j = i + 1; j < params->count; j++)
                 free(((char **)params->data)[j]);
             vector_free(params);
-            macro_free(&m);
+            macro_free(m);
+            free(m);
             vc_oom();
             return 0;
         }
     }
     vector_free(params);
-    m.variadic = variadic;
-    m.value = vc_strdup(value);
-    m.expanding = 0;
-    if (!vector_push(macros, &m)) {
-        for (size_t i = 0; i < m.params.count; i++)
-            free(((char **)m.params.data)[i]);
-        m.params.count = 0;
-        macro_free(&m);
+    m->variadic = variadic;
+    m->function_like = function_like;
+    m->value = vc_strdup(value);
+    m->body_ready = 0;
+    m->expanding = 0;
+    if (!macro_table_insert(macros, m)) {
+        macro_free(m);
+        free(m);
         vc_oom();
         return 0;
     }
     return 1;
 }
 
-int handle_define(char *line, vector_t *macros, vector_t *conds)
+int add_macro(const char *name, const char *value, vector_t *params,
+              int variadic, macro_table_t *macros)
+{
+    return define_macro(name, value, params, variadic,
+                        params->count || variadic, macros);
+}
+
+int handle_define(char *line, macro_table_t *macros, vector_t *conds)
 {
     char *n = line + 7;
     n = skip_ws(n);
@@ -216,6 +359,7 @@ int handle_define(char *line, vector_t *macros, vector_t *conds)
         n++;
     vector_t params;
     int variadic = 0;
+    int function_like = *n == '(';
     n = parse_macro_params(n, &params, &variadic);
     if (!n) {
         free_param_vector(&params);
@@ -226,15 +370,15 @@ int handle_define(char *line, vector_t *macros, vector_t *conds)
     char *val = *n ? n : "";
     int ok = 1;
     if (is_active(conds)) {
-        remove_macro(macros, name);
-        ok = add_macro(name, val, &params, variadic, macros);
+        ok = define_macro(name, val, &params, variadic, function_like,
+                          macros);
     } else {
         free_param_vector(&params);
     }
     return ok;
 }
 
-int handle_define_directive(char *line, const char *dir, vector_t *macros,
+int handle_define_directive(char *line, const char *dir, macro_table_t *macros,
                             vector_t *conds, strbuf_t *out,
                             const vector_t *incdirs, vector_t *stack,
                             preproc_context_t *ctx)
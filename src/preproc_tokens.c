@@ -0,0 +1,261 @@
+#define _POSIX_C_SOURCE 200809L
+/*
+ * Preprocessing token lexer and output.
+ *
+ * pp_lex() follows the pp-token grammar: identifiers, preprocessing
+ * numbers, character constants and string literals with their prefixes,
+ * punctuators including # and ##, and single other characters.  The
+ * printer and the lexer stream emitter share one layout so -E output and
+ * the token positions seen by the parser agree.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <string.h>
+#include "preproc_tokens.h"
+#include "lexer_internal.h"
+#include "intern.h"
+#include "util.h"
+
+/* Return the length of the punctuator at S or 0 when there is none */
+static size_t punct_len(const char *s)
+{
+    char c1 = s[1];
+    switch (s[0]) {
+    case '.':
+        return (c1 == '.' && s[2] == '.') ? 3 : 1;
+    case '<':
+    case '>':
+        if (c1 == s[0])
+            return s[2] == '=' ? 3 : 2;
+        return c1 == '=' ? 2 : 1;
+    case '-':
+        return (c1 == '>' || c1 == '-' || c1 == '=') ? 2 : 1;
+    case '+':
+    case '&':
+    case '|':
+        return (c1 == s[0] || c1 == '=') ? 2 : 1;
+    case '#':
+        return c1 == '#' ? 2 : 1;
+    case '=':
+    case '!':
+    case '*':
+    case '/':
+    case '%':
+    case '^':
+        return c1 == '=' ? 2 : 1;
+    case '(': case ')': case '[': case ']': case '{': case '}':
+    case ';': case ',': case '?': case ':': case '~':
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Return the end of the quoted literal starting at P */
+static const char *skip_literal(const char *p)
+{
+    char quote = *p++;
+    while (*p && *p != quote) {
+        if (*p == '\\' && p[1])
+            p++;
+        p++;
+    }
+    return *p ? p + 1 : p;
+}
+
+/* Return the length of a string or character prefix at P or 0 */
+static size_t literal_prefix(const char *p)
+{
+    if (p[0] == 'u' && p[1] == '8' && p[2] == '"')
+        return 2;
+    if ((p[0] == 'L' || p[0] == 'u' || p[0] == 'U') &&
+        (p[1] == '"' || p[1] == '\''))
+        return 1;
+    return 0;
+}
+
+/* Scan one token at P, store its kind in KIND and return its end */
+static const char *scan_pp_token(const char *p, unsigned char *kind)
+{
+    size_t n;
+    if (LEX_IS(*p, LEX_ALPHA)) {
+        n = literal_prefix(p);
+        if (n) {
+            *kind = p[n] == '"' ? PP_STRING : PP_CHAR;
+            return skip_literal(p + n);
+        }
+        *kind = PP_IDENT;
+        while (LEX_IS(*p, LEX_ALPHA | LEX_DIGIT))
+            p++;
+        return p;
+    }
+    if (LEX_IS(*p, LEX_DIGIT) || (*p == '.' && LEX_IS(p[1], LEX_DIGIT))) {
+        *kind = PP_NUMBER;
+        for (p++;; p++) {
+            if ((*p == '+' || *p == '-') &&
+                (p[-1] == 'e' || p[-1] == 'E' || p[-1] == 'p' ||
+                 p[-1] == 'P'))
+                continue;
+            if (!LEX_IS(*p, LEX_ALPHA | LEX_DIGIT) && *p != '.')
+                return p;
+        }
+    }
+    if (*p == '"' || *p == '\'') {
+        *kind = *p == '"' ? PP_STRING : PP_CHAR;
+        return skip_literal(p);
+    }
+    n = punct_len(p);
+    *kind = n ? PP_PUNCT : PP_OTHER;
+    return p + (n ? n : 1);
+}
+
+int pp_lex(const char *text, vector_t *out)
+{
+    const char *p = text;
+    for (;;) {
+        const char *ws = p;
+        while (*p && LEX_IS(*p, LEX_SPACE))
+            p++;
+        if (!*p)
+            return 1;
+        pp_token_t tok;
+        const char *end = scan_pp_token(p, &tok.kind);
+        tok.text = intern_text(p, (size_t)(end - p));
+        tok.len = (unsigned)(end - p);
+        tok.ws = ws;
+        tok.ws_len = (unsigned)(p - ws);
+        tok.flags = 0;
+        tok.param = -1;
+        tok.macro = NULL;
+        if (!vector_push(out, &tok)) {
+            vc_oom();
+            return 0;
+        }
+        p = end;
+    }
+}
+
+int pp_is_punct(const pp_token_t *tok, const char *p)
+{
+    return tok->kind == PP_PUNCT && tok->text[0] == p[0] &&
+           strcmp(tok->text, p) == 0;
+}
+
+/*
+ * Return non-zero when TOK written right after PREV would be read back
+ * as different tokens.  Tokens adjacent in the source never are, so only
+ * boundaries created by macro expansion receive such a space.
+ */
+static int avoid_paste(const pp_token_t *prev, const pp_token_t *tok)
+{
+    char a = prev->text[prev->len - 1];
+    char b = tok->text[0];
+    if (LEX_IS(a, LEX_ALPHA | LEX_DIGIT) && LEX_IS(b, LEX_ALPHA | LEX_DIGIT))
+        return 1;
+    if (prev->kind == PP_NUMBER &&
+        (b == '.' || ((b == '+' || b == '-') && strchr("eEpP", a))))
+        return 1;
+    if (prev->kind == PP_IDENT && (b == '"' || b == '\''))
+        return (prev->len == 1 && strchr("LuU", a)) ||
+               strcmp(prev->text, "u8") == 0;
+    if (prev->kind != PP_PUNCT || tok->kind != PP_PUNCT)
+        return pp_is_punct(prev, ".") && tok->kind == PP_NUMBER;
+    if (a == '/' && (b == '/' || b == '*'))
+        return 1;
+    char buf[6] = {0};
+    memcpy(buf, prev->text, prev->len);
+    buf[prev->len] = b;
+    buf[prev->len + 1] = tok->len > 1 ? tok->text[1] : '\0';
+    return punct_len(buf) > prev->len;
+}
+
+/* Number of columns between PREV and TOK; PREV is NULL at a line start */
+static size_t token_space(const pp_token_t *prev, const pp_token_t *tok)
+{
+    if (tok->ws_len || !prev)
+        return tok->ws_len;
+    return avoid_paste(prev, tok) ? 1 : 0;
+}
+
+int pp_print_tokens(strbuf_t *out, const pp_token_t *toks, size_t count)
+{
+    const pp_token_t *prev = NULL;
+    for (size_t i = 0; i < count; i++) {
+        const pp_token_t *t = &toks[i];
+        if (t->kind == PP_PLACEMARKER || t->kind == PP_END)
+            continue;
+        int r;
+        if (t->kind == PP_RAW) {
+            r = strbuf_append(out, t->text);
+            prev = NULL;
+        } else if (t->ws_len || !prev) {
+            r = strbuf_appendf(out, "%.*s%s", (int)t->ws_len, t->ws, t->text);
+            prev = t;
+        } else {
+            r = strbuf_appendf(out, "%s%s", avoid_paste(prev, t) ? " " : "",
+                               t->text);
+            prev = t;
+        }
+        if (r != 0)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * A line starting with '# <number>' is a line marker the C lexer consumes
+ * as a whole, so such lines are passed on as text.
+ */
+static int is_line_marker(const pp_token_t *toks, size_t count)
+{
+    return count >= 2 && pp_is_punct(&toks[0], "#") && !toks[0].ws_len &&
+           toks[1].kind == PP_NUMBER && toks[1].ws_len == 1 &&
+           toks[1].ws[0] == ' ';
+}
+
+static int emit_marker_line(lexer_stream_t *ls, const pp_token_t *toks,
+                            size_t count)
+{
+    strbuf_t sb;
+    strbuf_init(&sb);
+    int ok = pp_print_tokens(&sb, toks, count) &&
+             strbuf_append(&sb, "\n") == 0 &&
+             lexer_stream_feed(ls, sb.data);
+    strbuf_free(&sb);
+    return ok;
+}
+
+int pp_emit_line(lexer_stream_t *ls, const pp_token_t *toks, size_t count)
+{
+    if (ls->column == 1 && is_line_marker(toks, count))
+        return emit_marker_line(ls, toks, count);
+
+    const pp_token_t *prev = NULL;
+    for (size_t i = 0; i < count; i++) {
+        const pp_token_t *t = &toks[i];
+        if (t->kind == PP_PLACEMARKER || t->kind == PP_END)
+            continue;
+        if (t->kind == PP_RAW) {
+            if (!lexer_stream_feed(ls, t->text))
+                return 0;
+            prev = NULL;
+            continue;
+        }
+        ls->column += token_space(prev, t);
+        /* the C lexer reads 'name:' as a label */
+        int label = t->kind == PP_IDENT && i + 1 < count &&
+                    pp_is_punct(&toks[i + 1], ":") && !toks[i + 1].ws_len;
+        if (!lexer_stream_add(ls, t->text, t->len, label))
+            return 0;
+        prev = t;
+        if (label) {
+            ls->column++;
+            prev = &toks[++i];
+        }
+    }
+    ls->line++;
+    ls->column = 1;
+    return 1;
+}
@@ -1,17 +1,40 @@
 /*
- * Linear scan register allocator.
+ * Linear scan and graph coloring register allocators.
  *
- * This pass assigns each SSA value a physical register or stack slot in a
- * single sweep over the IR.  The algorithm operates roughly as follows:
+ * This pass assigns each SSA value a physical register or stack slot.
+ * Every function is allocated on its own and the algorithm operates
+ * roughly as follows:
  *   1. determine the last instruction that uses every value,
- *   2. build a stack of available registers,
- *   3. walk the instructions in order assigning free registers to new
- *      values and spilling when none remain,
- *   4. recycle registers once their value is no longer referenced.
+ *   2. compute the live interval of every value,
+ *   3. work out which registers each value may live in and what keeping
+ *      it in memory would cost,
+ *   4. visit the intervals of the function in order of their start,
+ *      giving each a free register or spilling the cheapest value, or
+ *      with REGALLOC_COLOR color their interference graph instead,
+ *   5. pack the spilled values into stack slots.
  *
- * A small array of physical registers forms the free pool; values are
- * "spilled" to the stack when it is exhausted.  Lifetimes are tracked via
- * the last-use table so registers can be released as soon as possible.
+ * Most values die in the block defining them and the last-use table is an
+ * exact description of their lifetime.  Values that are live across
+ * blocks or defined more than once, as produced by SSA destruction, get
+ * one range per block they are live in from a backward liveness walk over
+ * the CFG.  Their interval is thereby split at block boundaries: a
+ * register is only occupied during the ranges, so another value may use
+ * it in the holes between them.
+ *
+ * The registers and their classes come from regalloc_target().  A value
+ * only takes a register its lifetime allows: values live across a call
+ * need a callee-saved register, values live across the argument setup
+ * of a call in 64-bit mode avoid the argument registers, values live
+ * across an instruction writing a register implicitly, such as a
+ * division, avoid that register and values accessed as bytes need a
+ * register with a byte form.  When no such
+ * register is free the value with the lowest spill weight goes to the
+ * stack.  The weight counts the uses and definitions of a value, each
+ * multiplied by ten for every loop around it, divided by the length of
+ * its interval.  Spill slots are reused once their value is dead.
+ * Every instruction with a destination, global addresses and string
+ * literals included, starts the lifetime of its value; a value without
+ * a definition point is assumed to be live across every call.
  *
  * Each allocated location is stored in the `regalloc_t` structure where
  * non-negative entries represent a physical register and negative values
@@ -22,17 +45,58 @@
  * See LICENSE for details.
  */
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "regalloc.h"
 #include "regalloc_x86.h"
+#include "ir_cfg.h"
+#include "vector.h"
 
-/*
- * One register is reserved for temporary values during code generation.
- * The allocator itself never hands out this register so that codegen can
- * freely use it for spills.  Its index is exposed via REGALLOC_SCRATCH_REG
- * in regalloc.h.
- */
-#define NUM_ALLOC_REGS (REGALLOC_NUM_REGS - 1)
+/* Constraints on the register of a value */
+#define NEED_BYTE  1        /* accessed through its low byte */
+#define CROSS_CALL 2        /* live across a call */
+#define CROSS_ARG  4        /* live while call arguments are passed */
+#define CROSS_AX   8        /* live across a write of the accumulator */
+#define CROSS_CX   16       /* live across a write of the count register */
+#define CROSS_DX   32       /* live across a write of the data register */
+
+/* Why a value ended up in a stack slot */
+enum {
+    SPILL_NONE,
+    SPILL_NO_REG,           /* every suitable register was taken */
+    SPILL_EVICTED,          /* lost its register to a costlier value */
+    SPILL_CONSTRAINT,       /* no register satisfies its constraints */
+    SPILL_SPAN              /* live past the end of its function */
+};
+
+/* Destination of the allocation dump or NULL */
+static FILE *dump_out;
+
+/* Algorithm selected by regalloc_set_mode */
+static regalloc_mode_t alloc_mode = REGALLOC_LINEAR;
+
+/* Instruction positions FROM to TO, both included */
+typedef struct {
+    int from;
+    int to;
+} live_range_t;
+
+/* Lifetimes, constraints and costs of the values */
+typedef struct {
+    ir_instr_t **instr;     /* instructions by index */
+    size_t count;
+    unsigned char *global;  /* value has the ranges below */
+    unsigned char *need;    /* NEED_ and CROSS_ flags of every value */
+    int *start;             /* first instruction of the interval */
+    int *end;               /* last instruction of the interval */
+    size_t *range_idx;      /* per value offsets into ranges */
+    live_range_t *ranges;   /* block ranges of the globals */
+    size_t range_count;
+    size_t range_cap;
+    double *cost;           /* references weighted by loop depth */
+    unsigned char *hold_scratch; /* per IR_FUNC_BEGIN index */
+} live_ranges_t;
 
 /*
  * Compute the "last use" position for every value in the IR.
@@ -54,6 +118,8 @@ static int *compute_last_use(ir_builder_t *ir, size_t max_id)
 
     int idx = 0;
     for (ir_instr_t *ins = ir->head; ins; ins = ins->next, idx++) {
+        if (!ir_has_value_operands(ins))
+            continue;
         if (ins->src1 > 0 && (size_t)ins->src1 < max_id)
             last[ins->src1] = idx;
         if (ins->src2 > 0 && (size_t)ins->src2 < max_id)
@@ -62,67 +128,512 @@ static int *compute_last_use(ir_builder_t *ir, size_t max_id)
     return last;
 }
 
+static int is_call(const ir_instr_t *ins)
+{
+    return ins->op == IR_CALL || ins->op == IR_CALL_PTR ||
+           ins->op == IR_CALL_NR || ins->op == IR_CALL_PTR_NR;
+}
+
+/* Return non-zero when INS needs the low byte of its operands' registers */
+static int uses_byte_regs(const ir_instr_t *ins)
+{
+    switch (ins->type) {
+    case TYPE_CHAR: case TYPE_UCHAR: case TYPE_BOOL:
+        return 1;
+    default:
+        return ins->op == IR_CAST;
+    }
+}
+
 /*
- * Assign a register or stack slot to the destination of `ins`.
- *
- * The allocator pulls registers from the `free_regs` stack until it runs
- * out, at which point new stack slots are allocated sequentially.  The
- * destination value of `ins` only receives a location if it has a valid id
- * and none was previously assigned.
+ * Return the CROSS_AX, CROSS_CX and CROSS_DX flags of the registers INS
+ * writes implicitly once its operands are read: comparisons leave their
+ * result in %al, division needs %eax:%edx, variable shifts take their
+ * count in %cl and pointer differences divide by the element size.
  */
-static void assign_destination_location(ir_instr_t *ins, int *free_regs,
-                                        int *free_count, regalloc_t *ra,
-                                        int ret_reg_active)
+static unsigned fixed_clobbers(const ir_instr_t *ins)
 {
-    int id = ins->dest;
-    if (id <= 0 || ra->loc[id] != -1)
-        return;
+    switch (ins->op) {
+    case IR_CMPEQ: case IR_CMPNE: case IR_CMPLT: case IR_CMPGT:
+    case IR_CMPLE: case IR_CMPGE: case IR_LOGAND: case IR_LOGOR:
+        return CROSS_AX;
+    case IR_DIV: case IR_MOD:
+        return CROSS_AX | CROSS_DX;
+    case IR_SHL: case IR_SHR:
+        return CROSS_CX;
+    case IR_PTR_DIFF:
+        if (ins->imm && (ins->imm & (ins->imm - 1)))
+            return CROSS_AX | CROSS_CX | CROSS_DX;
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+/* Release the arrays owned by LR */
+static void live_ranges_free(live_ranges_t *lr)
+{
+    free(lr->instr);
+    free(lr->global);
+    free(lr->need);
+    free(lr->start);
+    free(lr->end);
+    free(lr->range_idx);
+    free(lr->ranges);
+    free(lr->cost);
+    free(lr->hold_scratch);
+    memset(lr, 0, sizeof(*lr));
+}
+
+/* Per-block data of compute_live_ranges */
+typedef struct {
+    ir_block_t *block;
+    size_t base;            /* id of the function's first block */
+    int begin;              /* instruction index of the IR_FUNC_BEGIN */
+    int first;              /* instruction index of the first instruction */
+    int last;
+    double weight;          /* cost of a reference, by loop depth */
+} block_pos_t;
+
+/* Scratch arrays of compute_live_ranges */
+typedef struct {
+    ir_cfg_t cfg;
+    block_pos_t *blocks;
+    size_t *blk_of;         /* block of every instruction or (size_t)-1 */
+    int *calls;             /* calls before each index */
+    int *args;              /* IR_ARG instructions before each index */
+    unsigned char *passing; /* an argument is passed before the index */
+    int *fixed[3];          /* implicit writes of ax, cx and dx before each index */
+    size_t *ev_idx;         /* per value offsets into ev */
+    int *ev;                /* instructions referencing each global */
+    size_t *stamp;          /* live-in mark of the value being extended */
+    size_t *seen;           /* referenced mark of the value being extended */
+    size_t *work;
+    size_t *live;           /* blocks the value is live or referenced in */
+    size_t *defines;        /* defining mark of the value being extended */
+} live_scratch_t;
+
+/* Cost of a reference nested DEPTH loops deep */
+static double depth_weight(size_t depth)
+{
+    double w = 1.0;
+    for (size_t d = 0; d < depth && d < 3; d++)
+        w *= 10.0;
+    return w;
+}
+
+/* Number the blocks of every function and record their extent */
+static void number_blocks(ir_builder_t *ir, live_scratch_t *ls,
+                          live_ranges_t *lr)
+{
+    ir_function_t *fn = NULL;
+    size_t f = 0, k = 0, b = 0, idx = 0;
+    int inside = 0, begin = 0;
+    for (ir_instr_t *ins = ir->head; ins; ins = ins->next, idx++) {
+        if (f < ls->cfg.func_count && ins == ls->cfg.funcs[f].begin) {
+            fn = &ls->cfg.funcs[f++];
+            k = 0;
+            begin = (int)idx;
+        }
+        if (fn && k < fn->block_count && ins == fn->blocks[k].first) {
+            size_t loop = fn->loop_of ? fn->loop_of[k] : IR_CFG_NO_BLOCK;
+            ls->blocks[b].block = &fn->blocks[k];
+            ls->blocks[b].base = b - k;
+            ls->blocks[b].first = (int)idx;
+            ls->blocks[b].begin = begin;
+            ls->blocks[b].weight = depth_weight(
+                loop == IR_CFG_NO_BLOCK ? 0 : fn->loops[loop].depth);
+            inside = 1;
+        }
+        lr->instr[idx] = ins;
+        ls->blk_of[idx] = inside ? b : (size_t)-1;
+        if (inside && ins == fn->blocks[k].last) {
+            ls->blocks[b++].last = (int)idx;
+            k++;
+            inside = 0;
+        }
+        ls->calls[idx + 1] = ls->calls[idx] + is_call(ins);
+        ls->args[idx + 1] = ls->args[idx] + (ins->op == IR_ARG);
+        ls->passing[idx + 1] = !is_call(ins) &&
+                               (ins->op == IR_ARG || ls->passing[idx]);
+        unsigned fixed = fixed_clobbers(ins);
+        for (int r = 0; r < 3; r++)
+            ls->fixed[r][idx + 1] = ls->fixed[r][idx] +
+                                    !!(fixed & (CROSS_AX << r));
+    }
+}
+
+/*
+ * Flag the values used outside the block defining them or defined more
+ * than once and add up the weighted references of every value.
+ */
+static void find_globals(const live_scratch_t *ls, size_t max_id,
+                         live_ranges_t *lr)
+{
+    for (size_t idx = 0; idx < lr->count; idx++) {
+        const ir_instr_t *ins = lr->instr[idx];
+        size_t blk = ls->blk_of[idx];
+        if (blk == (size_t)-1)
+            continue;
+        double w = ls->blocks[blk].weight;
+        /* global addresses and strings define a value from no operands */
+        int ops[2] = {0, 0};
+        if (ir_has_value_operands(ins)) {
+            ops[0] = ins->src1;
+            ops[1] = ins->src2;
+        }
+        for (int k = 0; k < 2; k++) {
+            int v = ops[k];
+            if (v <= 0 || (size_t)v >= max_id)
+                continue;
+            lr->cost[v] += w;
+            /* start holds the first definition, -1 for uses before it */
+            if (lr->start[v] < 0 || ls->blk_of[lr->start[v]] != blk)
+                lr->global[v] = 1;
+        }
+        int d = ins->dest;
+        if (d <= 0 || (size_t)d >= max_id)
+            continue;
+        lr->cost[d] += w;
+        if (lr->start[d] < 0)
+            lr->start[d] = (int)idx;
+        else
+            lr->global[d] = 1;
+        if ((int)idx > lr->end[d])
+            lr->end[d] = (int)idx;
+    }
+    /* values used without any definition keep their plain lifetime */
+    for (size_t v = 1; v < max_id; v++)
+        if (lr->start[v] < 0)
+            lr->global[v] = 0;
+}
 
-    if (ret_reg_active && ins->op == IR_LOAD_PARAM && ins->imm == 0) {
-        ra->loc[id] = REGALLOC_RET_REG;
+/* Group the instructions referencing each global value by value */
+static int collect_events(live_scratch_t *ls, size_t max_id,
+                          const live_ranges_t *lr)
+{
+    ls->ev_idx = calloc(max_id + 1, sizeof(*ls->ev_idx));
+    size_t *fill = malloc(max_id * sizeof(*fill));
+    if (!ls->ev_idx || !fill) {
+        free(fill);
+        return 0;
+    }
+    /* the first pass counts, the second fills in */
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass) {
+            for (size_t v = 0; v < max_id; v++)
+                ls->ev_idx[v + 1] += ls->ev_idx[v];
+            size_t total = ls->ev_idx[max_id];
+            ls->ev = malloc((total ? total : 1) * sizeof(*ls->ev));
+            if (!ls->ev) {
+                free(fill);
+                return 0;
+            }
+            memcpy(fill, ls->ev_idx, max_id * sizeof(*fill));
+        }
+        for (size_t idx = 0; idx < lr->count; idx++) {
+            const ir_instr_t *ins = lr->instr[idx];
+            if (ls->blk_of[idx] == (size_t)-1)
+                continue;
+            int ops[3] = {0, 0, ins->dest};
+            if (ir_has_value_operands(ins)) {
+                ops[0] = ins->src1;
+                ops[1] = ins->src2;
+            }
+            for (int k = 0; k < 3; k++) {
+                int v = ops[k];
+                if (v <= 0 || (size_t)v >= max_id || !lr->global[v] ||
+                    (k >= 1 && v == ops[0]) || (k == 2 && v == ops[1]))
+                    continue;
+                if (pass)
+                    ls->ev[fill[v]++] = (int)idx;
+                else
+                    ls->ev_idx[v + 1]++;
+            }
+        }
+    }
+    free(fill);
+    return 1;
+}
+
+static int cmp_size(const void *a, const void *b)
+{
+    size_t x = *(const size_t *)a, y = *(const size_t *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Append the range FROM-TO to the ranges of a value starting at FIRST,
+ * merging it with the previous one when MERGE is set and they touch.
+ */
+static int add_range(live_ranges_t *lr, size_t first, int from, int to,
+                     int merge)
+{
+    if (merge && lr->range_count > first &&
+        lr->ranges[lr->range_count - 1].to + 1 >= from) {
+        lr->ranges[lr->range_count - 1].to = to;
+        return 1;
+    }
+    if (lr->range_count == lr->range_cap) {
+        size_t cap = lr->range_cap ? lr->range_cap * 2 : 64;
+        live_range_t *r = realloc(lr->ranges, cap * sizeof(*r));
+        if (!r)
+            return 0;
+        lr->ranges = r;
+        lr->range_cap = cap;
+    }
+    lr->ranges[lr->range_count].from = from;
+    lr->ranges[lr->range_count].to = to;
+    lr->range_count++;
+    return 1;
+}
+
+/*
+ * Record the constraints of a value whose register must survive the
+ * instructions LO up to but not including HI.
+ */
+static void cross_constraints(const live_scratch_t *ls, int lo, int hi,
+                              unsigned char *need)
+{
+    if (hi <= lo)
         return;
+    if (ls->calls[hi] - ls->calls[lo] > 0)
+        *need |= CROSS_CALL;
+    if (ls->args[hi] - ls->args[lo] > 0 || ls->passing[lo])
+        *need |= CROSS_ARG;
+    for (int r = 0; r < 3; r++)
+        if (ls->fixed[r][hi] - ls->fixed[r][lo] > 0)
+            *need |= CROSS_AX << r;
+}
+
+/* Return non-zero when INS reads value V */
+static int reads_value(const ir_instr_t *ins, int v)
+{
+    return ir_has_value_operands(ins) && (ins->src1 == v || ins->src2 == v);
+}
+
+/*
+ * Compute the ranges of global value V by walking backwards from each
+ * use not preceded by a definition in its block until reaching blocks
+ * defining V.  A block's range starts at the block when V is live on
+ * entry and at its first reference otherwise, and ends at the end of the
+ * block when V is live on exit and at its last reference otherwise.  A
+ * definition not reading V starts a new range, so the copies of SSA
+ * destruction leave a hole between the last use of the old value and the
+ * new one.  Returns 0 on allocation failure.
+ */
+static int extend_interval(live_scratch_t *ls, int v, live_ranges_t *lr)
+{
+    size_t mark = (size_t)v;
+    size_t top = 0, nlive = 0;
+    size_t first = ls->ev_idx[v], end = ls->ev_idx[v + 1];
+
+    /* block of the latest definition seen while scanning in order */
+    size_t open = (size_t)-1;
+    for (size_t e = first; e < end; e++) {
+        const ir_instr_t *ins = lr->instr[ls->ev[e]];
+        size_t blk = ls->blk_of[ls->ev[e]];
+        if (ls->seen[blk] != mark) {
+            ls->seen[blk] = mark;
+            if (ls->stamp[blk] != mark)
+                ls->live[nlive++] = blk;
+        }
+        if (reads_value(ins, v) && open != blk &&
+            ls->stamp[blk] != mark) {
+            ls->stamp[blk] = mark;
+            ls->work[top++] = blk;
+        }
+        if (ins->dest == v) {
+            ls->defines[blk] = mark;
+            open = blk;
+        }
+    }
+    while (top) {
+        block_pos_t *bp = &ls->blocks[ls->work[--top]];
+        for (size_t p = 0; p < bp->block->pred_count; p++) {
+            size_t pb = bp->base + bp->block->preds[p];
+            if (ls->defines[pb] != mark && ls->stamp[pb] != mark) {
+                ls->stamp[pb] = mark;
+                ls->work[top++] = pb;
+                if (ls->seen[pb] != mark)
+                    ls->live[nlive++] = pb;
+            }
+        }
     }
 
-    if (*free_count > 0) {
-        ra->loc[id] = free_regs[--(*free_count)];
-    } else {
-        ra->loc[id] = -(++ra->stack_slots);
+    qsort(ls->live, nlive, sizeof(*ls->live), cmp_size);
+    size_t base = lr->range_count;
+    size_t e = first;
+    for (size_t i = 0; i < nlive; i++) {
+        size_t b = ls->live[i];
+        const block_pos_t *bp = &ls->blocks[b];
+        int live_in = ls->stamp[b] == mark;
+        int live_out = 0;
+        for (size_t s = 0; s < bp->block->succ_count; s++)
+            if (ls->stamp[bp->base + bp->block->succs[s]] == mark)
+                live_out = 1;
+        int from = live_in ? bp->first : -1;
+        int to = from;
+        int merge = 1;
+        for (; e < end && ls->blk_of[ls->ev[e]] == b; e++) {
+            const ir_instr_t *ins = lr->instr[ls->ev[e]];
+            if (from >= 0 && ins->dest == v && !reads_value(ins, v)) {
+                if (!add_range(lr, base, from, to, merge))
+                    return 0;
+                cross_constraints(ls, live_in && merge ? from : from + 1,
+                                  to, &lr->need[v]);
+                merge = 0;
+                from = -1;
+            }
+            if (from < 0)
+                from = ls->ev[e];
+            to = ls->ev[e];
+        }
+        if (live_out)
+            to = bp->last;
+        if (!add_range(lr, base, from, to, merge))
+            return 0;
+        cross_constraints(ls, live_in && merge ? from : from + 1,
+                          live_out ? to + 1 : to, &lr->need[v]);
     }
+    if (lr->range_count > base) {
+        lr->start[v] = lr->ranges[base].from;
+        lr->end[v] = lr->ranges[lr->range_count - 1].to;
+    }
+    return 1;
 }
 
 /*
- * Initialize the stack of available registers.
+ * Record the constraints of the values living in a single block, from
+ * the definition to the last use, of the values accessed as bytes and of
+ * operands the code generator overwrites: the divisor is read after
+ * %eax and %edx are loaded and the result of a shift must not be the
+ * count register.
+ * Besides the SSA values of promoted functions calls are crossed by
+ * temporaries such as the left operand of `f() + g()` and values
+ * hoisted out of a loop ahead of a call.
  */
-static void setup_free_registers(int *free_regs, int *free_count,
-                                 int ret_reg_active)
+static void find_constraints(const live_scratch_t *ls, const int *last,
+                             size_t max_id, live_ranges_t *lr)
 {
-    *free_count = 0;
-    for (int i = 0; i < NUM_ALLOC_REGS; i++) {
-        int r = NUM_ALLOC_REGS - 1 - i; /* allocate from high to low */
-        if (ret_reg_active && r == REGALLOC_RET_REG)
+    for (size_t idx = 0; idx < lr->count; idx++) {
+        const ir_instr_t *ins = lr->instr[idx];
+        if (!uses_byte_regs(ins))
+            continue;
+        int ops[3] = {ins->src1, ins->src2, ins->dest};
+        for (int k = 0; k < 3; k++)
+            if (ops[k] > 0 && (size_t)ops[k] < max_id &&
+                (k == 2 || ir_has_value_operands(ins)))
+                lr->need[ops[k]] |= NEED_BYTE;
+    }
+    for (size_t idx = 0; idx < lr->count; idx++) {
+        const ir_instr_t *ins = lr->instr[idx];
+        if ((ins->op == IR_DIV || ins->op == IR_MOD) &&
+            ins->src2 > 0 && (size_t)ins->src2 < max_id)
+            lr->need[ins->src2] |= CROSS_AX | CROSS_DX;
+        if ((ins->op == IR_SHL || ins->op == IR_SHR) &&
+            ins->dest > 0 && (size_t)ins->dest < max_id)
+            lr->need[ins->dest] |= CROSS_CX;
+    }
+    for (size_t v = 1; v < max_id; v++) {
+        int def = lr->start[v];
+        if (def < 0) {
+            /* without a definition point nothing proves it dead at a call */
+            lr->need[v] |= CROSS_CALL | CROSS_ARG;
             continue;
-        free_regs[(*free_count)++] = r;
+        }
+        if (!lr->global[v])
+            cross_constraints(ls, def + 1, last[v], &lr->need[v]);
+        /* spilled values are reloaded through the scratch register */
+        if (lr->global[v] || (lr->need[v] & CROSS_CALL))
+            lr->hold_scratch[ls->blocks[ls->blk_of[def]].begin] = 1;
     }
 }
 
 /*
- * Release registers whose value will not be needed again.
+ * Compute the ranges of the values live across blocks and the register
+ * constraints and spill costs of every value.  Returns 0 on allocation
+ * failure.
  */
-static void release_unused_regs(ir_instr_t *ins, int idx, int *last,
-                                size_t max_id, regalloc_t *ra,
-                                int *free_regs, int *free_count)
+static int compute_live_ranges(ir_builder_t *ir, const int *last,
+                               size_t max_id, live_ranges_t *lr)
 {
-    if (ins->src1 > 0 && (size_t)ins->src1 < max_id &&
-        ra->loc[ins->src1] >= 0 && last[ins->src1] == idx)
-        free_regs[(*free_count)++] = ra->loc[ins->src1];
-
-    if (ins->src2 > 0 && (size_t)ins->src2 < max_id &&
-        ra->loc[ins->src2] >= 0 && last[ins->src2] == idx)
-        free_regs[(*free_count)++] = ra->loc[ins->src2];
+    memset(lr, 0, sizeof(*lr));
+    live_scratch_t ls;
+    memset(&ls, 0, sizeof(ls));
+    if (!ir_cfg_build(ir, &ls.cfg))
+        return 0;
+    size_t nblocks = 0;
+    size_t count = 0;
+    int ok = 1;
+    for (size_t f = 0; f < ls.cfg.func_count; f++) {
+        nblocks += ls.cfg.funcs[f].block_count;
+        if (ls.cfg.funcs[f].block_count && !ir_cfg_loops(&ls.cfg.funcs[f]))
+            ok = 0;
+    }
+    for (ir_instr_t *ins = ir->head; ins; ins = ins->next)
+        count++;
 
-    if (ins->dest > 0 && (size_t)ins->dest < max_id &&
-        ra->loc[ins->dest] >= 0 && last[ins->dest] == idx)
-        free_regs[(*free_count)++] = ra->loc[ins->dest];
+    lr->count = count;
+    lr->instr = malloc((count + 1) * sizeof(*lr->instr));
+    ls.blocks = calloc(nblocks + 1, sizeof(*ls.blocks));
+    ls.blk_of = malloc((count + 1) * sizeof(*ls.blk_of));
+    ls.calls = calloc(count + 1, sizeof(*ls.calls));
+    ls.args = calloc(count + 1, sizeof(*ls.args));
+    ls.passing = calloc(count + 1, 1);
+    for (int r = 0; r < 3; r++)
+        ls.fixed[r] = calloc(count + 1, sizeof(*ls.fixed[r]));
+    ls.stamp = calloc(nblocks + 1, sizeof(*ls.stamp));
+    ls.seen = calloc(nblocks + 1, sizeof(*ls.seen));
+    ls.work = malloc((nblocks + 1) * sizeof(*ls.work));
+    ls.live = malloc((nblocks + 1) * sizeof(*ls.live));
+    ls.defines = calloc(nblocks + 1, sizeof(*ls.defines));
+    lr->global = calloc(max_id, 1);
+    lr->need = calloc(max_id, 1);
+    lr->start = malloc(max_id * sizeof(int));
+    lr->end = malloc(max_id * sizeof(int));
+    lr->range_idx = calloc(max_id + 1, sizeof(*lr->range_idx));
+    lr->cost = calloc(max_id, sizeof(*lr->cost));
+    lr->hold_scratch = calloc(count + 1, 1);
+    ok = ok && lr->instr && ls.blocks && ls.blk_of && ls.calls && ls.args &&
+         ls.passing && ls.fixed[0] && ls.fixed[1] && ls.fixed[2] &&
+         ls.stamp && ls.seen && ls.work && ls.live && ls.defines &&
+         lr->global && lr->need && lr->start && lr->end && lr->range_idx && lr->cost &&
+         lr->hold_scratch;
+    if (ok) {
+        number_blocks(ir, &ls, lr);
+        for (size_t v = 0; v < max_id; v++) {
+            lr->start[v] = -1;
+            lr->end[v] = last[v];
+        }
+        find_globals(&ls, max_id, lr);
+        ok = collect_events(&ls, max_id, lr);
+    }
+    for (size_t v = 1; ok && v < max_id; v++) {
+        if (lr->global[v])
+            ok = extend_interval(&ls, (int)v, lr);
+        lr->range_idx[v + 1] = lr->range_count;
+    }
+    if (ok)
+        find_constraints(&ls, last, max_id, lr);
+    else
+        live_ranges_free(lr);
+    free(ls.blocks);
+    free(ls.blk_of);
+    free(ls.calls);
+    free(ls.args);
+    free(ls.passing);
+    for (int r = 0; r < 3; r++)
+        free(ls.fixed[r]);
+    free(ls.ev_idx);
+    free(ls.ev);
+    free(ls.stamp);
+    free(ls.seen);
+    free(ls.work);
+    free(ls.live);
+    free(ls.defines);
+    ir_cfg_free(&ls.cfg);
+    return ok;
 }
 
 /*
@@ -141,58 +652,1165 @@ static int find_return_register(ir_builder_t *ir)
     return 0;
 }
 
+/* Live interval of one value during the scan */
+typedef struct {
+    int value;
+    int start;
+    int end;
+    size_t range_first;     /* ranges of a global in live_ranges_t */
+    size_t range_count;     /* 0 for the single range start-end */
+    double weight;          /* spill weight, the lowest is spilled first */
+    unsigned allowed;       /* registers the value may live in */
+    int global;
+    int words;              /* stack slots taken when spilled */
+    int reg;                /* register or -1 */
+    int spill;              /* SPILL_ reason */
+    int evictor;            /* value that took the register */
+    int coalesced;          /* value whose register it shares or 0 */
+} interval_t;
+
+/* Scan state of one function */
+typedef struct {
+    const regalloc_target_t *tgt;
+    const live_ranges_t *lr;
+    regalloc_t *ra;
+    interval_t *iv;         /* intervals by start */
+    size_t count;
+    size_t *active;         /* intervals covering the current position */
+    size_t active_count;
+    size_t *inactive;       /* started intervals inside a hole */
+    size_t inactive_count;
+    int *slot_end;          /* last position of the value in each slot */
+    size_t slot_cap;
+    unsigned pool;          /* registers the function may use */
+    int frame_base;         /* stack slots covered by the locals */
+    int *node_of;           /* graph node of every value or -1 */
+} scan_state_t;
+
+/* Return the ranges of IT and store their number in N */
+static const live_range_t *ranges_of(const scan_state_t *st,
+                                     const interval_t *it,
+                                     live_range_t *one, size_t *n)
+{
+    if (it->range_count) {
+        *n = it->range_count;
+        return st->lr->ranges + it->range_first;
+    }
+    one->from = it->start;
+    one->to = it->end;
+    *n = 1;
+    return one;
+}
+
+/* Return non-zero when IT is live at position POS */
+static int covers(const scan_state_t *st, const interval_t *it, int pos)
+{
+    live_range_t one;
+    size_t n;
+    const live_range_t *r = ranges_of(st, it, &one, &n);
+    for (size_t i = 0; i < n && r[i].from <= pos; i++)
+        if (pos <= r[i].to)
+            return 1;
+    return 0;
+}
+
+/* Return non-zero when A and B are live at a common position */
+static int intersects(const scan_state_t *st, const interval_t *a,
+                      const interval_t *b)
+{
+    live_range_t one_a, one_b;
+    size_t na, nb;
+    const live_range_t *ra = ranges_of(st, a, &one_a, &na);
+    const live_range_t *rb = ranges_of(st, b, &one_b, &nb);
+    size_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        if (ra[i].to < rb[j].from)
+            i++;
+        else if (rb[j].to < ra[i].from)
+            j++;
+        else
+            return 1;
+    }
+    return 0;
+}
+
+/* Registers a value with the constraints NEED may be kept in */
+static unsigned allowed_regs(const regalloc_target_t *tgt, unsigned need)
+{
+    unsigned mask = ~0u;
+    if (need & NEED_BYTE)
+        mask &= tgt->byte_regs;
+    if (need & CROSS_CALL)
+        mask &= tgt->callee_saved;
+    if (need & CROSS_ARG)
+        mask &= ~tgt->arg_regs;
+    for (int r = 0; r < 3; r++)
+        if (need & (CROSS_AX << r))
+            mask &= ~tgt->fixed_regs[r];
+    return mask;
+}
+
 /*
- * Scan the instruction list and assign locations to all SSA values.
+ * Number of stack slots a spilled value defined by DEF occupies.  Wide
+ * values extend from their slot towards the slots numbered below it.
+ */
+static int value_words(const ir_instr_t *def, int word)
+{
+    int size;
+    switch (def->type) {
+    case TYPE_DOUBLE: case TYPE_LLONG: case TYPE_ULLONG:
+    case TYPE_FLOAT_COMPLEX:
+        size = 8;
+        break;
+    case TYPE_LDOUBLE:
+        size = word == 8 ? 16 : 12;
+        break;
+    case TYPE_DOUBLE_COMPLEX:
+        size = 16;
+        break;
+    case TYPE_LDOUBLE_COMPLEX:
+        size = word == 8 ? 32 : 24;
+        break;
+    default:
+        size = word;
+        break;
+    }
+    return (size + word - 1) / word;
+}
+
+static int cmp_interval(const void *a, const void *b)
+{
+    const interval_t *x = a, *y = b;
+    if (x->start != y->start)
+        return (x->start > y->start) - (x->start < y->start);
+    return (x->value > y->value) - (x->value < y->value);
+}
+
+/*
+ * Collect the intervals of the values defined by the instructions BEGIN
+ * up to END, the extent of one function, ordered by their start.
+ */
+static void build_intervals(scan_state_t *st, int begin, int end,
+                            const int *last, size_t max_id,
+                            unsigned char *assigned, int ret_reg_active,
+                            int word)
+{
+    const live_ranges_t *lr = st->lr;
+    st->count = 0;
+    for (int idx = begin; idx < end; idx++) {
+        const ir_instr_t *ins = lr->instr[idx];
+        int id = ins->dest;
+        if (id <= 0 || (size_t)id >= max_id || assigned[id])
+            continue;
+        assigned[id] = 1;
+        if (ret_reg_active && ins->op == IR_LOAD_PARAM && ins->imm == 0) {
+            st->ra->loc[id] = REGALLOC_RET_REG;
+            continue;
+        }
+        interval_t *it = &st->iv[st->count++];
+        memset(it, 0, sizeof(*it));
+        it->value = id;
+        it->global = lr->global[id];
+        if (it->global) {
+            it->start = lr->start[id];
+            it->end = lr->end[id];
+            it->range_first = lr->range_idx[id];
+            it->range_count = lr->range_idx[id + 1] - lr->range_idx[id];
+        } else {
+            it->start = idx;
+            it->end = last[id] > idx ? last[id] : idx;
+        }
+        unsigned cls = it->global ? st->tgt->global_regs
+                                  : st->tgt->local_regs;
+        it->allowed = allowed_regs(st->tgt, lr->need[id]) & cls & st->pool;
+        it->words = value_words(ins, word);
+        it->reg = -1;
+
+        live_range_t one;
+        size_t n;
+        const live_range_t *r = ranges_of(st, it, &one, &n);
+        int length = 0;
+        for (size_t i = 0; i < n; i++)
+            length += r[i].to - r[i].from + 1;
+        it->weight = lr->cost[id] / length;
+        if (it->end >= end)
+            it->spill = SPILL_SPAN;
+        else if (!it->allowed)
+            it->spill = SPILL_CONSTRAINT;
+    }
+    qsort(st->iv, st->count, sizeof(*st->iv), cmp_interval);
+}
+
+/* Return the first register of ORDER in MASK or -1 */
+static int first_reg(const int *order, unsigned mask)
+{
+    for (int i = 0; order[i] >= 0; i++)
+        if (mask & REGALLOC_REG_BIT(order[i]))
+            return order[i];
+    return -1;
+}
+
+/*
+ * Drop the intervals ending before POS and move the others between the
+ * active and inactive sets depending on whether they cover POS.
+ */
+static void advance(scan_state_t *st, int pos)
+{
+    size_t n = 0, old = st->inactive_count;
+    for (size_t i = 0; i < st->active_count; i++) {
+        const interval_t *it = &st->iv[st->active[i]];
+        if (it->end < pos)
+            continue;
+        if (covers(st, it, pos))
+            st->active[n++] = st->active[i];
+        else
+            st->inactive[st->inactive_count++] = st->active[i];
+    }
+    st->active_count = n;
+    n = 0;
+    for (size_t i = 0; i < st->inactive_count; i++) {
+        const interval_t *it = &st->iv[st->inactive[i]];
+        if (it->end < pos)
+            continue;
+        if (i < old && covers(st, it, pos))
+            st->active[st->active_count++] = st->inactive[i];
+        else
+            st->inactive[n++] = st->inactive[i];
+    }
+    st->inactive_count = n;
+}
+
+/*
+ * Give interval K the first free register of its class.  A register held
+ * by an inactive interval is free when K fits in its hole.  When none is
+ * left the active interval with the lowest weight whose register K may
+ * take is spilled instead, unless K itself weighs no more.
+ */
+static void allocate_interval(scan_state_t *st, size_t k)
+{
+    interval_t *cur = &st->iv[k];
+    advance(st, cur->start);
+    if (cur->spill)
+        return;
+
+    unsigned busy = 0, held = 0;
+    for (size_t i = 0; i < st->active_count; i++)
+        busy |= REGALLOC_REG_BIT(st->iv[st->active[i]].reg);
+    for (size_t i = 0; i < st->inactive_count; i++) {
+        const interval_t *it = &st->iv[st->inactive[i]];
+        if (intersects(st, it, cur))
+            held |= REGALLOC_REG_BIT(it->reg);
+    }
+    const int *order = cur->global ? st->tgt->global_order
+                                   : st->tgt->local_order;
+    int r = first_reg(order, cur->allowed & ~busy & ~held);
+    if (r >= 0) {
+        cur->reg = r;
+        st->active[st->active_count++] = k;
+        return;
+    }
+
+    size_t victim = 0;
+    int found = 0;
+    for (size_t i = 0; i < st->active_count; i++) {
+        const interval_t *it = &st->iv[st->active[i]];
+        unsigned bit = REGALLOC_REG_BIT(it->reg);
+        if (!(cur->allowed & bit) || (held & bit))
+            continue;
+        if (!found || it->weight < st->iv[st->active[victim]].weight) {
+            victim = i;
+            found = 1;
+        }
+    }
+    if (!found || st->iv[st->active[victim]].weight >= cur->weight) {
+        cur->spill = SPILL_NO_REG;
+        return;
+    }
+    interval_t *out = &st->iv[st->active[victim]];
+    cur->reg = out->reg;
+    out->reg = -1;
+    out->spill = SPILL_EVICTED;
+    out->evictor = cur->value;
+    st->active[victim] = k;
+}
+
+/*
+ * Graph coloring allocator.
  *
- * Registers are drawn from a small stack of free registers and spilled to
- * the stack once none remain.  As soon as the scan passes the last
- * reference of a value its register is released for reuse.
+ * The intervals of a function become the nodes of an interference graph
+ * with an edge between every two values live at a common position.  Two
+ * values that only meet at copies between them or at two-address
+ * instructions whose first operand dies where the result is defined get a
+ * move instead of an edge, so the pair may share a register and the code
+ * generator leaves the move out.
+ *
+ * Iterated register coalescing (George and Appel) then removes nodes of
+ * low degree, merges move related nodes when the Briggs or George test
+ * shows the graph stays colorable, freezes moves that cannot be merged
+ * and, when only nodes of high degree are left, picks the one with the
+ * least weight per neighbour as a potential spill.  Each node has its own
+ * number of colors, the registers its constraints allow, and merging two
+ * nodes keeps the registers both allow.  Nodes are colored in reverse
+ * order of removal, preferring the register of a colored move partner,
+ * then the register an instruction wants the value in.  A node without a
+ * color left is spilled; the code generator reloads spilled operands
+ * itself, so nothing is rewritten.
  */
-static void scan_instructions(ir_builder_t *ir, int *last, size_t max_id,
-                              regalloc_t *ra, int ret_reg_active)
+
+/* Functions with more intervals are allocated by linear scan */
+#define COLOR_MAX_NODES 2048
+
+/* Node states of the coloring allocator */
+enum {
+    NODE_INITIAL,
+    NODE_SIMPLIFY,          /* low degree, no pending moves */
+    NODE_FREEZE,            /* low degree with moves */
+    NODE_SPILL,             /* high degree */
+    NODE_STACK,             /* removed from the graph */
+    NODE_COALESCED,         /* merged into its alias */
+    NODE_COLORED,
+    NODE_SPILLED
+};
+
+/* Move states of the coloring allocator */
+enum {
+    MOVE_WORK,              /* waiting to be coalesced */
+    MOVE_ACTIVE,            /* not coalescable yet */
+    MOVE_COALESCED,
+    MOVE_CONSTRAINED,       /* ends interfere or share no register */
+    MOVE_FROZEN             /* given up */
+};
+
+/* Move between the nodes A and B */
+typedef struct {
+    int a;
+    int b;
+    int state;
+} color_move_t;
+
+/* Coloring state of one function */
+typedef struct {
+    scan_state_t *st;
+    int n;                  /* nodes, the intervals of the function */
+    unsigned char *matrix;  /* interference bit of every pair of nodes */
+    vector_t *adj;          /* neighbours of every node */
+    vector_t *node_moves;   /* moves of every node */
+    vector_t moves;         /* color_move_t */
+    int *degree;
+    int *alias;             /* node a coalesced node was merged into */
+    unsigned char *state;   /* NODE_ */
+    int *hint;              /* register an instruction wants or -1 */
+    unsigned char *global;  /* colored in the order of the global class */
+    double *weight;         /* spill weight of the merged values */
+    int *simplify;          /* nodes to remove */
+    int simplify_count;
+    int *work;              /* moves to coalesce */
+    int work_count;
+    int *stack;             /* removed nodes */
+    int stack_count;
+} color_state_t;
+
+/* Number of registers in MASK */
+static int reg_count(unsigned mask)
 {
-    int free_regs[NUM_ALLOC_REGS];
-    int free_count = 0;
-    setup_free_registers(free_regs, &free_count, ret_reg_active);
+    int n = 0;
+    for (; mask; mask &= mask - 1)
+        n++;
+    return n;
+}
 
-    int idx = 0;
-    for (ir_instr_t *ins = ir->head; ins; ins = ins->next, idx++) {
-        assign_destination_location(ins, free_regs, &free_count, ra,
-                                    ret_reg_active);
-        release_unused_regs(ins, idx, last, max_id, ra, free_regs,
-                            &free_count);
+/* Number of registers node K may take */
+static int node_colors(const color_state_t *cs, int k)
+{
+    return reg_count(cs->st->iv[k].allowed);
+}
+
+static int interferes(const color_state_t *cs, int a, int b)
+{
+    size_t bit = (size_t)a * (size_t)cs->n + (size_t)b;
+    return (cs->matrix[bit >> 3] >> (bit & 7)) & 1;
+}
+
+/* Add an interference edge between A and B.  Returns 0 on allocation failure. */
+static int add_edge(color_state_t *cs, int a, int b)
+{
+    if (a == b || interferes(cs, a, b))
+        return 1;
+    size_t ab = (size_t)a * (size_t)cs->n + (size_t)b;
+    size_t ba = (size_t)b * (size_t)cs->n + (size_t)a;
+    cs->matrix[ab >> 3] |= (unsigned char)(1u << (ab & 7));
+    cs->matrix[ba >> 3] |= (unsigned char)(1u << (ba & 7));
+    if (!vector_push(&cs->adj[a], &b) || !vector_push(&cs->adj[b], &a))
+        return 0;
+    cs->degree[a]++;
+    cs->degree[b]++;
+    return 1;
+}
+
+/*
+ * Return non-zero when INS may compute its result in the register of its
+ * first operand: copies, and the instructions the code generator emits as
+ * a move of the first operand to the result followed by a two-address
+ * operation on a second operand kept elsewhere.
+ */
+static int is_move(const ir_instr_t *ins, int word)
+{
+    switch (ins->op) {
+    case IR_COPY:
+        return value_words(ins, word) == 1;
+    case IR_ADD: case IR_SUB: case IR_MUL:
+    case IR_AND: case IR_OR: case IR_XOR: case IR_SHL: case IR_SHR:
+        return ins->src2 != ins->dest && value_words(ins, word) == 1;
+    default:
+        return 0;
+    }
+}
+
+/*
+ * Return non-zero when A and B are only live at common positions holding
+ * a move from one to the other, the only way values related by a copy
+ * and its inverse meet after SSA destruction.
+ */
+static int meet_at_moves(const scan_state_t *st, const interval_t *a,
+                         const interval_t *b, int word)
+{
+    live_range_t one_a, one_b;
+    size_t na, nb;
+    const live_range_t *ra = ranges_of(st, a, &one_a, &na);
+    const live_range_t *rb = ranges_of(st, b, &one_b, &nb);
+    size_t i = 0, j = 0;
+    while (i < na && j < nb) {
+        int lo = ra[i].from > rb[j].from ? ra[i].from : rb[j].from;
+        int hi = ra[i].to < rb[j].to ? ra[i].to : rb[j].to;
+        if (lo < hi)
+            return 0;
+        if (lo == hi) {
+            const ir_instr_t *ins = st->lr->instr[lo];
+            if (!is_move(ins, word) ||
+                !((ins->dest == a->value && ins->src1 == b->value) ||
+                  (ins->dest == b->value && ins->src1 == a->value)))
+                return 0;
+        }
+        if (ra[i].to < rb[j].to)
+            i++;
+        else
+            j++;
+    }
+    return 1;
+}
+
+/*
+ * Connect the intervals that are live at a common position, visiting them
+ * by start with the intervals that have not ended yet, and record a move
+ * between values that only meet at moves.  Returns 0 on allocation
+ * failure.
+ */
+static int build_graph(color_state_t *cs, int word)
+{
+    scan_state_t *st = cs->st;
+    size_t active = 0;
+    for (int k = 0; k < cs->n; k++) {
+        const interval_t *cur = &st->iv[k];
+        if (cur->spill)
+            continue;
+        size_t keep = 0;
+        for (size_t i = 0; i < active; i++) {
+            int j = (int)st->active[i];
+            const interval_t *it = &st->iv[j];
+            if (it->end < cur->start)
+                continue;
+            st->active[keep++] = (size_t)j;
+            if (!intersects(st, it, cur))
+                continue;
+            if (meet_at_moves(st, it, cur, word)) {
+                color_move_t mv = {j, k, MOVE_WORK};
+                int m = (int)cs->moves.count;
+                if (!vector_push(&cs->moves, &mv) ||
+                    !vector_push(&cs->node_moves[j], &m) ||
+                    !vector_push(&cs->node_moves[k], &m))
+                    return 0;
+            } else if (!add_edge(cs, j, k)) {
+                return 0;
+            }
+        }
+        active = keep;
+        st->active[active++] = (size_t)k;
+    }
+    return 1;
+}
+
+/* Lowest register in MASK or -1 */
+static int lowest_reg(unsigned mask)
+{
+    for (int r = 0; r < REGALLOC_NUM_REGS; r++)
+        if (mask & REGALLOC_REG_BIT(r))
+            return r;
+    return -1;
+}
+
+/* Register N of ORDER or -1 */
+static int nth_reg(const int *order, int n)
+{
+    for (int i = 0; order[i] >= 0; i++)
+        if (i == n)
+            return order[i];
+    return -1;
+}
+
+/* Set the hint of value V to register R unless it has one */
+static void hint_value(color_state_t *cs, int v, int r)
+{
+    if (v <= 0 || r < 0)
+        return;
+    int k = cs->st->node_of[v];
+    if (k >= 0 && cs->hint[k] < 0)
+        cs->hint[k] = r;
+}
+
+/*
+ * Record the registers the instructions BEGIN up to END want their
+ * operands and results in: the return register for return values and
+ * call results, the accumulator and data register around division, the
+ * count register for shifts and in 64-bit mode the argument registers.
+ */
+static void find_hints(color_state_t *cs, int begin, int end)
+{
+    const regalloc_target_t *tgt = cs->st->tgt;
+    int acc = lowest_reg(tgt->fixed_regs[0]);
+    int count = lowest_reg(tgt->fixed_regs[1]);
+    int data = lowest_reg(tgt->fixed_regs[2]);
+    int arg = 0;
+    for (int idx = begin; idx < end; idx++) {
+        const ir_instr_t *ins = cs->st->lr->instr[idx];
+        type_kind_t t = (type_kind_t)ins->imm;
+        switch (ins->op) {
+        case IR_RETURN:
+            hint_value(cs, ins->src1, REGALLOC_RET_REG);
+            break;
+        case IR_DIV: case IR_MOD:
+            hint_value(cs, ins->src1, acc);
+            hint_value(cs, ins->dest, ins->op == IR_DIV ? acc : data);
+            break;
+        case IR_SHL: case IR_SHR:
+            hint_value(cs, ins->src2, count);
+            break;
+        case IR_ARG:
+            /* floating point arguments travel in SSE registers */
+            if (t != TYPE_FLOAT && t != TYPE_DOUBLE && t != TYPE_LDOUBLE)
+                hint_value(cs, ins->src1, nth_reg(tgt->arg_order, arg++));
+            break;
+        default:
+            if (is_call(ins)) {
+                hint_value(cs, ins->dest, REGALLOC_RET_REG);
+                arg = 0;
+            }
+            break;
+        }
+    }
+}
+
+/* Node a coalesced node K ended up in */
+static int get_alias(const color_state_t *cs, int k)
+{
+    while (cs->state[k] == NODE_COALESCED)
+        k = cs->alias[k];
+    return k;
+}
+
+/* Return non-zero while node K is part of the graph */
+static int in_graph(const color_state_t *cs, int k)
+{
+    return cs->state[k] != NODE_STACK && cs->state[k] != NODE_COALESCED;
+}
+
+/* Return non-zero when node K has moves that may still be coalesced */
+static int move_related(const color_state_t *cs, int k)
+{
+    const int *m = cs->node_moves[k].data;
+    const color_move_t *mv = cs->moves.data;
+    for (size_t i = 0; i < cs->node_moves[k].count; i++)
+        if (mv[m[i]].state == MOVE_WORK || mv[m[i]].state == MOVE_ACTIVE)
+            return 1;
+    return 0;
+}
+
+static void push_simplify(color_state_t *cs, int k)
+{
+    cs->state[k] = NODE_SIMPLIFY;
+    cs->simplify[cs->simplify_count++] = k;
+}
+
+/* Retry the moves of node K that could not be coalesced so far */
+static void enable_moves(color_state_t *cs, int k)
+{
+    const int *m = cs->node_moves[k].data;
+    color_move_t *mv = cs->moves.data;
+    for (size_t i = 0; i < cs->node_moves[k].count; i++) {
+        if (mv[m[i]].state == MOVE_ACTIVE) {
+            mv[m[i]].state = MOVE_WORK;
+            cs->work[cs->work_count++] = m[i];
+        }
+    }
+}
+
+/* Lower the degree of node K after a neighbour left the graph */
+static void decrement_degree(color_state_t *cs, int k)
+{
+    cs->degree[k]--;
+    if (cs->state[k] != NODE_SPILL || cs->degree[k] >= node_colors(cs, k))
+        return;
+    enable_moves(cs, k);
+    const int *adj = cs->adj[k].data;
+    for (size_t i = 0; i < cs->adj[k].count; i++)
+        if (in_graph(cs, adj[i]))
+            enable_moves(cs, adj[i]);
+    if (move_related(cs, k))
+        cs->state[k] = NODE_FREEZE;
+    else
+        push_simplify(cs, k);
+}
+
+/* Let node K be removed once it has neither moves nor a high degree */
+static void add_work_list(color_state_t *cs, int k)
+{
+    if (cs->state[k] == NODE_FREEZE && !move_related(cs, k) &&
+        cs->degree[k] < node_colors(cs, k))
+        push_simplify(cs, k);
+}
+
+/*
+ * Briggs test: merging U and V into a node that may take the registers
+ * ALLOWED leaves it with fewer neighbours of high degree than registers.
+ */
+static int briggs_ok(const color_state_t *cs, int u, int v, unsigned allowed)
+{
+    int nodes[2] = {u, v};
+    int high = 0;
+    for (int s = 0; s < 2; s++) {
+        const int *adj = cs->adj[nodes[s]].data;
+        for (size_t i = 0; i < cs->adj[nodes[s]].count; i++) {
+            int t = adj[i];
+            /* common neighbours are counted once */
+            if (!in_graph(cs, t) || (s && interferes(cs, t, u)))
+                continue;
+            if (cs->degree[t] >= node_colors(cs, t))
+                high++;
+        }
+    }
+    return high < reg_count(allowed);
+}
+
+/* George test: every neighbour of V of high degree interferes with U */
+static int george_ok(const color_state_t *cs, int u, int v)
+{
+    const int *adj = cs->adj[v].data;
+    for (size_t i = 0; i < cs->adj[v].count; i++) {
+        int t = adj[i];
+        if (in_graph(cs, t) && cs->degree[t] >= node_colors(cs, t) &&
+            !interferes(cs, t, u))
+            return 0;
+    }
+    return 1;
+}
+
+/* Merge node V into U.  Returns 0 on allocation failure. */
+static int combine(color_state_t *cs, int u, int v)
+{
+    interval_t *iu = &cs->st->iv[u];
+    const interval_t *iv = &cs->st->iv[v];
+    cs->state[v] = NODE_COALESCED;
+    cs->alias[v] = u;
+    for (size_t i = 0; i < cs->node_moves[v].count; i++)
+        if (!vector_push(&cs->node_moves[u],
+                         (const int *)cs->node_moves[v].data + i))
+            return 0;
+    enable_moves(cs, v);
+    iu->allowed &= iv->allowed;
+    cs->weight[u] += cs->weight[v];
+    cs->global[u] |= cs->global[v];
+    if (cs->hint[u] < 0 || !(iu->allowed & REGALLOC_REG_BIT(cs->hint[u])))
+        cs->hint[u] = cs->hint[v];
+    for (size_t i = 0; i < cs->adj[v].count; i++) {
+        int t = ((const int *)cs->adj[v].data)[i];
+        if (!in_graph(cs, t))
+            continue;
+        if (!add_edge(cs, t, u))
+            return 0;
+        decrement_degree(cs, t);
+    }
+    if (cs->state[u] == NODE_FREEZE && cs->degree[u] >= node_colors(cs, u))
+        cs->state[u] = NODE_SPILL;
+    return 1;
+}
+
+/*
+ * Try to coalesce the next move of the worklist.  Moves whose ends
+ * interfere or share no register are dropped, the others are merged when
+ * the George or the Briggs test allows it and kept for later otherwise.
+ * Returns 0 on allocation failure.
+ */
+static int coalesce(color_state_t *cs)
+{
+    color_move_t *mv = (color_move_t *)cs->moves.data +
+                       cs->work[--cs->work_count];
+    if (mv->state != MOVE_WORK)
+        return 1;
+    int u = get_alias(cs, mv->a);
+    int v = get_alias(cs, mv->b);
+    unsigned au = cs->st->iv[u].allowed, av = cs->st->iv[v].allowed;
+    if (u == v) {
+        mv->state = MOVE_COALESCED;
+        add_work_list(cs, u);
+        return 1;
+    }
+    if (interferes(cs, u, v) || !(au & av)) {
+        mv->state = MOVE_CONSTRAINED;
+        add_work_list(cs, u);
+        add_work_list(cs, v);
+        return 1;
+    }
+    /* George's test holds when the surviving node keeps its registers */
+    if (!((au & ~av) == 0 && george_ok(cs, u, v))) {
+        if ((av & ~au) == 0 && george_ok(cs, v, u)) {
+            int t = u;
+            u = v;
+            v = t;
+        } else if (!briggs_ok(cs, u, v, au & av)) {
+            mv->state = MOVE_ACTIVE;
+            return 1;
+        }
+    }
+    mv->state = MOVE_COALESCED;
+    if (!combine(cs, u, v))
+        return 0;
+    add_work_list(cs, u);
+    return 1;
+}
+
+/* Give up coalescing the moves of node U */
+static void freeze_moves(color_state_t *cs, int u)
+{
+    const int *m = cs->node_moves[u].data;
+    color_move_t *mv = cs->moves.data;
+    for (size_t i = 0; i < cs->node_moves[u].count; i++) {
+        color_move_t *cur = &mv[m[i]];
+        if (cur->state != MOVE_WORK && cur->state != MOVE_ACTIVE)
+            continue;
+        cur->state = MOVE_FROZEN;
+        int x = get_alias(cs, cur->a), y = get_alias(cs, cur->b);
+        int v = x == get_alias(cs, u) ? y : x;
+        if (cs->state[v] == NODE_FREEZE && !move_related(cs, v) &&
+            cs->degree[v] < node_colors(cs, v))
+            push_simplify(cs, v);
+    }
+}
+
+/* Node of high degree with the least weight per neighbour or -1 */
+static int cheapest_spill(const color_state_t *cs)
+{
+    int best = -1;
+    for (int k = 0; k < cs->n; k++) {
+        if (cs->state[k] != NODE_SPILL)
+            continue;
+        if (best < 0 || cs->weight[k] * cs->degree[best] <
+                            cs->weight[best] * cs->degree[k])
+            best = k;
+    }
+    return best;
+}
+
+/* First node in STATE or -1 */
+static int find_node(const color_state_t *cs, int state)
+{
+    for (int k = 0; k < cs->n; k++)
+        if (cs->state[k] == state)
+            return k;
+    return -1;
+}
+
+/*
+ * Remove every node from the graph, pushing it on the stack.  Returns 0
+ * on allocation failure.
+ */
+static int simplify_graph(color_state_t *cs)
+{
+    for (;;) {
+        int k;
+        if (cs->simplify_count) {
+            k = cs->simplify[--cs->simplify_count];
+            if (cs->state[k] != NODE_SIMPLIFY)
+                continue;
+            cs->state[k] = NODE_STACK;
+            cs->stack[cs->stack_count++] = k;
+            const int *adj = cs->adj[k].data;
+            for (size_t i = 0; i < cs->adj[k].count; i++)
+                if (in_graph(cs, adj[i]))
+                    decrement_degree(cs, adj[i]);
+        } else if (cs->work_count) {
+            if (!coalesce(cs))
+                return 0;
+        } else if ((k = find_node(cs, NODE_FREEZE)) >= 0 ||
+                   (k = cheapest_spill(cs)) >= 0) {
+            push_simplify(cs, k);
+            freeze_moves(cs, k);
+        } else {
+            return 1;
+        }
     }
 }
 
+/*
+ * Pop the nodes off the stack and give each a register none of its
+ * colored neighbours has, preferring the register of a move partner and
+ * then its hint.  Merged nodes take the register of their alias.
+ */
+static void assign_colors(color_state_t *cs)
+{
+    scan_state_t *st = cs->st;
+    while (cs->stack_count) {
+        int k = cs->stack[--cs->stack_count];
+        interval_t *it = &st->iv[k];
+        unsigned ok = it->allowed;
+        const int *adj = cs->adj[k].data;
+        for (size_t i = 0; i < cs->adj[k].count; i++) {
+            int a = get_alias(cs, adj[i]);
+            if (cs->state[a] == NODE_COLORED)
+                ok &= ~REGALLOC_REG_BIT(st->iv[a].reg);
+        }
+        if (!ok) {
+            cs->state[k] = NODE_SPILLED;
+            it->spill = SPILL_NO_REG;
+            continue;
+        }
+        int r = -1;
+        const int *m = cs->node_moves[k].data;
+        const color_move_t *mv = cs->moves.data;
+        for (size_t i = 0; i < cs->node_moves[k].count && r < 0; i++) {
+            int x = get_alias(cs, mv[m[i]].a), y = get_alias(cs, mv[m[i]].b);
+            int other = x == k ? y : x;
+            if (cs->state[other] == NODE_COLORED &&
+                (ok & REGALLOC_REG_BIT(st->iv[other].reg)))
+                r = st->iv[other].reg;
+        }
+        if (r < 0 && cs->hint[k] >= 0 && (ok & REGALLOC_REG_BIT(cs->hint[k])))
+            r = cs->hint[k];
+        if (r < 0)
+            r = first_reg(cs->global[k] ? st->tgt->global_order
+                                        : st->tgt->local_order, ok);
+        if (r < 0)
+            r = lowest_reg(ok);
+        it->reg = r;
+        cs->state[k] = NODE_COLORED;
+    }
+    for (int k = 0; k < cs->n; k++) {
+        if (cs->state[k] != NODE_COALESCED)
+            continue;
+        const interval_t *rep = &st->iv[get_alias(cs, k)];
+        st->iv[k].reg = rep->reg;
+        st->iv[k].coalesced = rep->value;
+        if (rep->reg < 0)
+            st->iv[k].spill = SPILL_NO_REG;
+    }
+}
+
+/* Release the arrays of CS */
+static void color_state_free(color_state_t *cs)
+{
+    for (int k = 0; cs->adj && k < cs->n; k++)
+        vector_free(&cs->adj[k]);
+    for (int k = 0; cs->node_moves && k < cs->n; k++)
+        vector_free(&cs->node_moves[k]);
+    vector_free(&cs->moves);
+    free(cs->matrix);
+    free(cs->adj);
+    free(cs->node_moves);
+    free(cs->degree);
+    free(cs->alias);
+    free(cs->state);
+    free(cs->hint);
+    free(cs->global);
+    free(cs->weight);
+    free(cs->simplify);
+    free(cs->work);
+    free(cs->stack);
+}
+
+/*
+ * Allocate the intervals of the function spanning the instructions BEGIN
+ * up to END by coloring its interference graph.  Returns 0 on allocation
+ * failure.
+ */
+static int color_function(scan_state_t *st, int begin, int end, int word)
+{
+    color_state_t cs;
+    memset(&cs, 0, sizeof(cs));
+    size_t n = st->count;
+    cs.st = st;
+    cs.n = (int)n;
+    vector_init(&cs.moves, sizeof(color_move_t));
+    cs.matrix = calloc((n * n + 7) / 8 + 1, 1);
+    cs.adj = calloc(n + 1, sizeof(*cs.adj));
+    cs.node_moves = calloc(n + 1, sizeof(*cs.node_moves));
+    cs.degree = calloc(n + 1, sizeof(*cs.degree));
+    cs.alias = malloc((n + 1) * sizeof(*cs.alias));
+    cs.state = malloc(n + 1);
+    cs.hint = malloc((n + 1) * sizeof(*cs.hint));
+    cs.global = malloc(n + 1);
+    cs.weight = malloc((n + 1) * sizeof(*cs.weight));
+    cs.simplify = malloc((n + 1) * sizeof(*cs.simplify));
+    cs.stack = malloc((n + 1) * sizeof(*cs.stack));
+    int ok = cs.matrix && cs.adj && cs.node_moves && cs.degree && cs.alias &&
+             cs.state && cs.hint && cs.global && cs.weight && cs.simplify &&
+             cs.stack;
+    for (size_t k = 0; ok && k < n; k++) {
+        const interval_t *it = &st->iv[k];
+        vector_init(&cs.adj[k], sizeof(int));
+        vector_init(&cs.node_moves[k], sizeof(int));
+        cs.alias[k] = (int)k;
+        cs.state[k] = it->spill ? NODE_SPILLED : NODE_INITIAL;
+        cs.hint[k] = -1;
+        cs.global[k] = (unsigned char)it->global;
+        cs.weight[k] = it->weight;
+        st->node_of[it->value] = (int)k;
+    }
+    if (ok) {
+        find_hints(&cs, begin, end);
+        ok = build_graph(&cs, word);
+    }
+    if (ok) {
+        cs.work = malloc((cs.moves.count + 1) * sizeof(*cs.work));
+        ok = cs.work != NULL;
+    }
+    if (ok) {
+        for (size_t m = 0; m < cs.moves.count; m++)
+            cs.work[cs.work_count++] = (int)m;
+        for (int k = 0; k < cs.n; k++) {
+            if (cs.state[k] != NODE_INITIAL)
+                continue;
+            if (cs.degree[k] >= node_colors(&cs, k))
+                cs.state[k] = NODE_SPILL;
+            else if (move_related(&cs, k))
+                cs.state[k] = NODE_FREEZE;
+            else
+                push_simplify(&cs, k);
+        }
+        ok = simplify_graph(&cs);
+    }
+    if (ok)
+        assign_colors(&cs);
+    for (size_t k = 0; k < n; k++)
+        st->node_of[st->iv[k].value] = -1;
+    color_state_free(&cs);
+    return ok;
+}
+
+/* Return non-zero when an interval of the function was spilled */
+static int has_spills(const scan_state_t *st)
+{
+    for (size_t k = 0; k < st->count; k++)
+        if (st->iv[k].reg < 0)
+            return 1;
+    return 0;
+}
+
+/*
+ * Store the locations of the function's values.  Spilled intervals are
+ * visited by start and take the lowest slots whose previous values are
+ * dead.  Returns 0 on allocation failure.
+ */
+static int assign_slots(scan_state_t *st)
+{
+    size_t used = 0;
+    for (size_t k = 0; k < st->count; k++) {
+        const interval_t *it = &st->iv[k];
+        if (it->reg >= 0) {
+            st->ra->loc[it->value] = it->reg;
+            continue;
+        }
+        size_t w = (size_t)it->words;
+        size_t n = w;       /* the value takes slots n - w + 1 to n */
+        for (;; n++) {
+            size_t s = n - w + 1;
+            while (s <= n && (s > used || st->slot_end[s - 1] < it->start))
+                s++;
+            if (s > n)
+                break;
+        }
+        if (n > st->slot_cap) {
+            size_t cap = st->slot_cap ? st->slot_cap * 2 : 16;
+            while (cap < n)
+                cap *= 2;
+            int *p = realloc(st->slot_end, cap * sizeof(*p));
+            if (!p)
+                return 0;
+            st->slot_end = p;
+            st->slot_cap = cap;
+        }
+        for (size_t s = n - w + 1; s <= n; s++)
+            st->slot_end[s - 1] = it->end;
+        if (n > used)
+            used = n;
+        st->ra->loc[it->value] = -(st->frame_base + (int)n);
+    }
+    if ((int)used > st->ra->stack_slots)
+        st->ra->stack_slots = (int)used;
+    return 1;
+}
+
+/* Print the intervals and locations of the function at HEAD */
+static void dump_function(const scan_state_t *st, const ir_instr_t *head)
+{
+    fprintf(dump_out, "function %s\n",
+            head->op == IR_FUNC_BEGIN && head->name ? head->name
+                                                    : "(global)");
+    for (size_t k = 0; k < st->count; k++) {
+        const interval_t *it = &st->iv[k];
+        live_range_t one;
+        size_t n;
+        const live_range_t *r = ranges_of(st, it, &one, &n);
+        fprintf(dump_out, "  v%d", it->value);
+        for (size_t i = 0; i < n; i++)
+            fprintf(dump_out, " [%d,%d]", r[i].from, r[i].to);
+        unsigned need = st->lr->need[it->value];
+        if (need)
+            fprintf(dump_out, " {%s%s%s%s%s%s }",
+                    need & CROSS_CALL ? " call" : "",
+                    need & CROSS_ARG ? " args" : "",
+                    need & NEED_BYTE ? " byte" : "",
+                    need & CROSS_AX ? " ax" : "",
+                    need & CROSS_CX ? " cx" : "",
+                    need & CROSS_DX ? " dx" : "");
+        fprintf(dump_out, " weight %.3g: ", it->weight);
+        int loc = st->ra->loc[it->value];
+        if (loc >= 0 && it->coalesced) {
+            fprintf(dump_out, "%s, coalesced with v%d\n",
+                    regalloc_reg_name(loc), it->coalesced);
+            continue;
+        }
+        if (loc >= 0) {
+            fprintf(dump_out, "%s\n", regalloc_reg_name(loc));
+            continue;
+        }
+        fprintf(dump_out, "slot %d, ", -loc);
+        switch (it->spill) {
+        case SPILL_EVICTED:
+            fprintf(dump_out, "evicted by v%d\n", it->evictor);
+            break;
+        case SPILL_CONSTRAINT:
+            fprintf(dump_out, "no register satisfies its constraints\n");
+            break;
+        case SPILL_SPAN:
+            fprintf(dump_out, "live past the end of the function\n");
+            break;
+        default:
+            fprintf(dump_out, "no free register\n");
+            break;
+        }
+    }
+}
+
+/*
+ * Allocate the values of each function in turn.  Instructions before the
+ * first function form a region of their own.  Returns 0 on allocation
+ * failure.
+ */
+static int scan_functions(const int *last, size_t max_id, regalloc_t *ra,
+                          int ret_reg_active, const live_ranges_t *lr)
+{
+    scan_state_t st;
+    memset(&st, 0, sizeof(st));
+    st.tgt = regalloc_target();
+    st.lr = lr;
+    st.ra = ra;
+    unsigned char *assigned = calloc(max_id, 1);
+    st.iv = malloc((lr->count + 1) * sizeof(*st.iv));
+    st.active = malloc((lr->count + 1) * sizeof(*st.active));
+    st.inactive = malloc((lr->count + 1) * sizeof(*st.inactive));
+    int ok = assigned && st.iv && st.active && st.inactive;
+    if (ok && alloc_mode == REGALLOC_COLOR) {
+        st.node_of = malloc(max_id * sizeof(*st.node_of));
+        ok = st.node_of != NULL;
+        for (size_t v = 0; ok && v < max_id; v++)
+            st.node_of[v] = -1;
+    }
+    int word = regalloc_get_x86_64() ? 8 : 4;
+
+    size_t begin = 0;
+    while (ok && begin < lr->count) {
+        size_t end = begin + 1;
+        while (end < lr->count && lr->instr[end]->op != IR_FUNC_BEGIN)
+            end++;
+        const ir_instr_t *head = lr->instr[begin];
+        st.frame_base = head->op == IR_FUNC_BEGIN
+                            ? (int)((head->imm + word - 1) / word) : 0;
+        st.pool = st.tgt->local_regs | st.tgt->global_regs;
+        if (ret_reg_active)
+            st.pool &= ~REGALLOC_REG_BIT(REGALLOC_RET_REG);
+        /* spilled globals are reloaded through the scratch register */
+        if (lr->hold_scratch[begin])
+            st.pool &= ~REGALLOC_REG_BIT(REGALLOC_SCRATCH_REG);
+        for (;;) {
+            st.active_count = 0;
+            st.inactive_count = 0;
+            build_intervals(&st, (int)begin, (int)end, last, max_id, assigned,
+                            ret_reg_active, word);
+            if (st.node_of && st.count <= COLOR_MAX_NODES) {
+                ok = color_function(&st, (int)begin, (int)end, word);
+            } else {
+                for (size_t k = 0; k < st.count; k++)
+                    allocate_interval(&st, k);
+            }
+            /*
+             * Spilled values are loaded and computed through the scratch
+             * register, so it must not hold a value of a function that
+             * spills.  Allocate again without it.
+             */
+            if (!ok || !(st.pool & REGALLOC_REG_BIT(REGALLOC_SCRATCH_REG)) ||
+                !has_spills(&st))
+                break;
+            st.pool &= ~REGALLOC_REG_BIT(REGALLOC_SCRATCH_REG);
+            for (size_t idx = begin; idx < end; idx++) {
+                int id = lr->instr[idx]->dest;
+                if (id > 0 && (size_t)id < max_id)
+                    assigned[id] = 0;
+            }
+        }
+        ok = ok && assign_slots(&st);
+        if (ok && dump_out && st.count)
+            dump_function(&st, head);
+        begin = end;
+    }
+    free(assigned);
+    free(st.iv);
+    free(st.active);
+    free(st.inactive);
+    free(st.slot_end);
+    free(st.node_of);
+    return ok;
+}
+
 /*
  * Populate `ra` with locations for every value defined in `ir`.
  *
- * Lifetimes are determined by `compute_last_use` which walks the IR once and
- * records the index of the final instruction that touches each value.  During
- * allocation this table is consulted so that when the scan reaches a value's
- * last use its register can immediately be freed.
+ * Lifetimes are determined by `compute_last_use`, which records the index
+ * of the final instruction touching each value, and by the CFG liveness
+ * of `compute_live_ranges` for values live across blocks.  The intervals
+ * of each function are then visited in order of their start.  A new
+ * interval takes the first free register in the preference order of its
+ * class that satisfies its constraints.  The optional return register is
+ * left out when necessary and so is the scratch register in functions
+ * with values live across blocks or calls.
  *
- * The free register pool is maintained as a simple stack.  All allocatable
- * registers are pushed in descending order and popped whenever a new value is
- * defined.  When a value dies its register is pushed back for reuse.  The
- * optional return register is skipped when necessary so the scratch register is
- * always available.
- *
- * If the stack runs out, new values are spilled to sequential stack slots.
- * Each slot increments `ra->stack_slots` and is encoded as a negative number in
- * `ra->loc` (-(slot + 1)).  Stack slots persist for the duration of the scan
- * but their contents may be reloaded by later passes.
+ * If no register is left the value with the lowest spill weight among
+ * the competitors is placed in a stack slot.  With REGALLOC_COLOR the
+ * intervals of a function are instead colored by color_function(), which
+ * also merges values related by copies.  Slots are numbered per
+ * function past its locals, encoded as negative numbers in `ra->loc` and
+ * shared by values whose lifetimes do not overlap; `ra->stack_slots`
+ * reports the largest count used by any function.
  */
 void regalloc_run(ir_builder_t *ir, regalloc_t *ra)
 {
-    /*
-     * Allocation proceeds in a single linear pass.  First the last use of
-     * every value is computed so registers can be released as soon as the
-     * allocator walks past that point.  During the scan each destination is
-     * given a register from the free stack or spilled to a new stack slot if
-     * none remain.  Freed registers are pushed back onto the stack for reuse.
-     */
-
     size_t max_id = ir->next_value_id;
     ra->loc = malloc(max_id * sizeof(int));
     ra->stack_slots = 0;
@@ -210,7 +1828,18 @@ void regalloc_run(ir_builder_t *ir, regalloc_t *ra)
 
     int ret_reg_active = find_return_register(ir);
 
-    scan_instructions(ir, last, max_id, ra, ret_reg_active);
+    live_ranges_t lr;
+    if (!compute_live_ranges(ir, last, max_id, &lr)) {
+        free(ra->loc);
+        ra->loc = NULL;
+        free(last);
+        return;
+    }
+    if (!scan_functions(last, max_id, ra, ret_reg_active, &lr)) {
+        free(ra->loc);
+        ra->loc = NULL;
+    }
+    live_ranges_free(&lr);
     free(last);
 }
 
@@ -226,3 +1855,15 @@ void regalloc_free(regalloc_t *ra)
     ra->loc = NULL;
     ra->stack_slots = 0;
 }
+
+/* Print the intervals and spill decisions of later runs to OUT */
+void regalloc_set_dump(FILE *out)
+{
+    dump_out = out;
+}
+
+/* Allocate later runs with MODE */
+void regalloc_set_mode(regalloc_mode_t mode)
+{
+    alloc_mode = mode;
+}
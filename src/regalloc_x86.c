@@ -20,9 +20,20 @@ static int use_x86_64 = 0;
 /* Assembly syntax flavor for register names. */
 static asm_syntax_t current_syntax = ASM_ATT;
 
-/* register names for 32-bit mode */
+/* register names for 32-bit mode and 32-bit halves in 64-bit mode */
 static const char *phys_regs_32[REGALLOC_NUM_REGS] = {
-    "%eax", "%ebx", "%ecx", "%edx", "%esi", "%edi"
+    "%eax", "%ebx", "%ecx", "%edx", "%esi", "%edi",
+    "%r8d", "%r9d", "%r10d", "%r11d", "%r12d", "%r13d", "%r14d", "%r15d"
+};
+
+static const char *phys_regs_16[REGALLOC_NUM_REGS] = {
+    "%ax", "%bx", "%cx", "%dx", "%si", "%di",
+    "%r8w", "%r9w", "%r10w", "%r11w", "%r12w", "%r13w", "%r14w", "%r15w"
+};
+
+static const char *phys_regs_8[REGALLOC_NUM_REGS] = {
+    "%al", "%bl", "%cl", "%dl", "%sil", "%dil",
+    "%r8b", "%r9b", "%r10b", "%r11b", "%r12b", "%r13b", "%r14b", "%r15b"
 };
 
 /* xmm register names */
@@ -36,9 +47,73 @@ static bool xmm_free_flags[NUM_XMM_REGS];
 
 /* register names for 64-bit mode */
 static const char *phys_regs_64[REGALLOC_NUM_REGS] = {
-    "%rax", "%rbx", "%rcx", "%rdx", "%rsi", "%rdi"
+    "%rax", "%rbx", "%rcx", "%rdx", "%rsi", "%rdi",
+    "%r8", "%r9", "%r10", "%r11", "%r12", "%r13", "%r14", "%r15"
+};
+
+#define R(r) REGALLOC_REG_BIT(r)
+
+enum { EAX, EBX, ECX, EDX, ESI, EDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+/*
+ * cdecl: %eax serves as scratch register and %ebx as the second one.
+ * %edi has no byte form and is kept for values live across blocks.
+ */
+static const int local_order_32[] = {EAX, EBX, ECX, EDX, ESI, -1};
+static const int global_order_32[] = {EDI, ESI, -1};
+static const int no_args[] = {-1};
+
+static const regalloc_target_t target_32 = {
+    6,
+    R(EAX) | R(EBX) | R(ECX) | R(EDX) | R(ESI),
+    R(ESI) | R(EDI),
+    local_order_32,
+    global_order_32,
+    R(EAX) | R(ECX) | R(EDX),
+    R(EBX) | R(ESI) | R(EDI),
+    0,
+    no_args,
+    R(EAX) | R(EBX) | R(ECX) | R(EDX),
+    EBX,
+    {R(EAX), R(ECX), R(EDX)}
 };
 
+/*
+ * System V AMD64: %rax, %rcx and %rdx are used implicitly by division,
+ * shifts and the scratch sequences of the code generator and %r11 is the
+ * second scratch register, which leaves ten registers to allocate.
+ * Caller-saved ones come first so values not live across a call avoid
+ * the save in the prologue.
+ */
+static const int order_64[] = {
+    R10, R8, R9, ESI, EDI, EBX, R12, R13, R14, R15, -1
+};
+static const int arg_order_64[] = {EDI, ESI, EDX, ECX, R8, R9, -1};
+
+#define POOL_64 (R(EBX) | R(ESI) | R(EDI) | R(R8) | R(R9) | R(R10) | \
+                 R(R12) | R(R13) | R(R14) | R(R15))
+
+static const regalloc_target_t target_64 = {
+    REGALLOC_NUM_REGS,
+    POOL_64,
+    POOL_64,
+    order_64,
+    order_64,
+    R(EAX) | R(ECX) | R(EDX) | R(ESI) | R(EDI) | R(R8) | R(R9) | R(R10) |
+        R(R11),
+    R(EBX) | R(R12) | R(R13) | R(R14) | R(R15),
+    R(EDI) | R(ESI) | R(EDX) | R(ECX) | R(R8) | R(R9),
+    arg_order_64,
+    (1u << REGALLOC_NUM_REGS) - 1,
+    R11,
+    {R(EAX), R(ECX), R(EDX)}
+};
+
+const regalloc_target_t *regalloc_target(void)
+{
+    return use_x86_64 ? &target_64 : &target_32;
+}
+
 /*
  * Translate an allocator register index into the textual name of the
  * underlying CPU register.
@@ -52,7 +127,7 @@ const char *regalloc_reg_name(int idx)
 {
     const char **regs = use_x86_64 ? phys_regs_64 : phys_regs_32;
     const char *name;
-    if (idx >= 0 && idx < REGALLOC_NUM_REGS)
+    if (idx >= 0 && idx < regalloc_target()->count)
         name = regs[idx];
     else
         name = use_x86_64 ? "%rax" : "%eax";
@@ -79,6 +154,28 @@ const char *regalloc_reg_name32(int idx)
     return name;
 }
 
+/* Return the 16-bit textual CPU register name for index `idx`. */
+const char *regalloc_reg_name16(int idx)
+{
+    const char *name = "%ax";
+    if (idx >= 0 && idx < REGALLOC_NUM_REGS)
+        name = phys_regs_16[idx];
+    if (current_syntax == ASM_INTEL && name[0] == '%')
+        return name + 1;
+    return name;
+}
+
+/* Return the 8-bit textual CPU register name for index `idx`. */
+const char *regalloc_reg_name8(int idx)
+{
+    const char *name = "%al";
+    if (idx >= 0 && idx < REGALLOC_NUM_REGS)
+        name = phys_regs_8[idx];
+    if (current_syntax == ASM_INTEL && name[0] == '%')
+        return name + 1;
+    return name;
+}
+
 /* Return textual name of an XMM register. */
 const char *regalloc_xmm_name(int idx)
 {
@@ -137,6 +234,12 @@ void regalloc_set_x86_64(int enable)
     use_x86_64 = enable ? 1 : 0;
 }
 
+/* Return the mode selected by regalloc_set_x86_64. */
+int regalloc_get_x86_64(void)
+{
+    return use_x86_64;
+}
+
 /* Set the assembly syntax style used for register names. */
 void regalloc_set_asm_syntax(asm_syntax_t syntax)
 {
@@ -15,6 +15,7 @@
 #include "semantic_expr.h"
 #include "semantic.h"
 #include "util.h"
+#include "intern.h"
 #include "label.h"
 #include "error.h"
 
@@ -44,16 +45,14 @@ void label_table_init(label_table_t *t) { t->head = NULL; }
 
 /*
  * Free all memory used by a label table.  Each entry is removed from
- * the linked list, its strings are released and finally the table head
- * is cleared.
+ * the linked list and released; the interned names it refers to stay
+ * valid.  Finally the table head is cleared.
  */
 void label_table_free(label_table_t *t)
 {
     label_entry_t *e = t->head;
     while (e) {
         label_entry_t *n = e->next;
-        free(e->name);
-        free(e->ir_name);
         free(e);
         e = n;
     }
@@ -66,8 +65,9 @@ void label_table_free(label_table_t *t)
  */
 const char *label_table_get(label_table_t *t, const char *name)
 {
+    const char *key = intern_find(name);
     for (label_entry_t *e = t->head; e; e = e->next) {
-        if (strcmp(e->name, name) == 0)
+        if (e->name == key)
             return e->ir_name;
     }
     return NULL;
@@ -86,24 +86,14 @@ const char *label_table_get_or_add(label_table_t *t, const char *name)
     label_entry_t *e = malloc(sizeof(*e));
     if (!e)
         return NULL;
-    e->name = vc_strdup(name);
-    if (!e->name) {
-        free(e);
-        return NULL;
-    }
     char buf[32];
     const char *fmt = label_format("Luser", label_next_id(), buf);
     if (!fmt) {
-        free(e->name);
-        free(e);
-        return NULL;
-    }
-    e->ir_name = vc_strdup(fmt);
-    if (!e->ir_name) {
-        free(e->name);
         free(e);
         return NULL;
     }
+    e->name = intern_str(name);
+    e->ir_name = intern_str(fmt);
     e->next = t->head;
     t->head = e;
     return e->ir_name;
@@ -11,6 +11,7 @@
 #include "ir_core.h"
 #include "label.h"
 #include "error.h"
+#include "intern.h"
 
 /* Compute the size in bytes of a symbol for stack allocation */
 static size_t local_sym_size(symbol_t *sym)
@@ -173,8 +174,7 @@ static symbol_t *register_var_symbol(stmt_t *stmt, symtable_t *vars)
         sym->stack_offset = semantic_stack_offset;
         char sbuf[32];
         snprintf(sbuf, sizeof(sbuf), "stack:%d", sym->stack_offset);
-        free(sym->ir_name);
-        sym->ir_name = vc_strdup(sbuf);
+        sym->ir_name = intern_str(sbuf);
     }
 
     return sym;
@@ -14,8 +14,27 @@
 #include "semantic_control.h"
 #include "symtable.h"
 #include "label.h"
+#include "intern.h"
 #include "error.h"
 
+/*
+ * Return non-zero when the body following BEGIN takes the address of one
+ * of the parameters of FUNC.  Such an IR_ADDR names the parameter, which
+ * only means something inside this function.
+ */
+static int takes_param_addr(const func_t *func, const ir_instr_t *begin)
+{
+    for (const ir_instr_t *i = begin->next; i; i = i->next) {
+        if (i->op != IR_ADDR)
+            continue;
+        for (size_t p = 0; p < func->param_count; p++)
+            if (func->param_names[p] &&
+                i->name == intern_find(func->param_names[p]))
+                return 1;
+    }
+    return 0;
+}
+
 int emit_func_ir(func_t *func, symtable_t *funcs, symtable_t *globals,
                  ir_builder_t *ir)
 {
@@ -36,6 +55,16 @@ int emit_func_ir(func_t *func, symtable_t *funcs, symtable_t *globals,
                            func->param_is_restrict ? func->param_is_restrict[i] : 0);
 
     ir_instr_t *func_begin = ir_build_func_begin(ir, func->name);
+    if (func_begin) {
+        /* a prototype may carry the specifiers the definition omits */
+        symbol_t *sym = funcs ? symtable_lookup(funcs, func->name) : NULL;
+        if (func->is_inline || (sym && sym->is_inline))
+            func_begin->src1 |= IR_FUNC_INLINE;
+        if (func->is_noreturn || (sym && sym->is_noreturn))
+            func_begin->src1 |= IR_FUNC_NORETURN;
+        if (func->is_static)
+            func_begin->src1 |= IR_FUNC_STATIC;
+    }
 
     label_table_t labels;
     label_table_init(&labels);
@@ -47,6 +76,8 @@ int emit_func_ir(func_t *func, symtable_t *funcs, symtable_t *globals,
 
     if (func_begin && !semantic_stack_zero)
         func_begin->imm = semantic_stack_offset;
+    if (func_begin && takes_param_addr(func, func_begin))
+        func_begin->src1 |= IR_FUNC_PARAM_ADDR;
     ir_build_func_end(ir);
 
     label_table_free(&labels);
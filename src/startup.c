@@ -10,12 +10,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "asm_x86.h"
 #include "cli.h"
 #include "command.h"
 #include "startup.h"
 #include "compile_helpers.h"
+#include "util.h"
 
 /* Use binary mode for temporary files on platforms that require it */
 #if defined(_WIN32)
@@ -147,6 +150,11 @@ int assemble_startup_obj(const char *asm_path, int use_x86_64,
         char *argv[] = {(char *)get_as(1), "-f", (char *)fmt,
                         (char *)asm_path, "-o", objname, NULL};
         rc = command_run(argv);
+    } else if (cli->integrated_as) {
+        char *text = vc_read_file(asm_path);
+        rc = text && asm_x86_assemble(text, strlen(text), use_x86_64,
+                                      objname);
+        free(text);
     } else {
         const char *arch_flag = use_x86_64 ? "-m64" : "-m32";
         char *argv[] = {(char *)get_as(0), "-x", "assembler", (char *)arch_flag,
@@ -9,13 +9,15 @@
 #include <string.h>
 #include "symtable.h"
 #include "util.h"
+#include "intern.h"
 
 /*
  * Allocate and initialise a new symbol entry.
  *
  * The returned symbol is not inserted into any list;
  * callers add it to either the local `head` list or the
- * `globals` list.
+ * `globals` list.  Both names are interned so lookups compare
+ * them by pointer.
  */
 symbol_t *symtable_create_symbol(const char *name, const char *ir_name)
 {
@@ -23,23 +25,9 @@ symbol_t *symtable_create_symbol(const char *name, const char *ir_name)
     if (!sym)
         return NULL;
 
-    sym->name = vc_strdup(name ? name : "");
-    if (!sym->name) {
-        free(sym);
-        return NULL;
-    }
-
+    sym->name = intern_str(name ? name : "");
     const char *in = ir_name ? ir_name : name;
-    if (in) {
-        sym->ir_name = vc_strdup(in);
-        if (!sym->ir_name) {
-            free(sym->name);
-            free(sym);
-            return NULL;
-        }
-    } else {
-        sym->ir_name = NULL;
-    }
+    sym->ir_name = in ? intern_str(in) : NULL;
 
     sym->param_index = -1;
     sym->alias_type = TYPE_UNKNOWN;
@@ -84,8 +72,6 @@ static void free_symbol_list(symbol_t *sym)
 {
     while (sym) {
         symbol_t *next = sym->next;
-        free(sym->name);
-        free(sym->ir_name);
         for (size_t i = 0; i < sym->member_count; i++)
             free(sym->members[i].name);
         free(sym->members);
@@ -120,12 +106,13 @@ void symtable_free(symtable_t *table)
  */
 symbol_t *symtable_lookup(symtable_t *table, const char *name)
 {
+    const char *key = intern_find(name);
     for (symbol_t *sym = table->head; sym; sym = sym->next) {
-        if (strcmp(sym->name, name) == 0)
+        if (sym->name == key)
             return sym;
     }
     for (symbol_t *sym = table->globals; sym; sym = sym->next) {
-        if (strcmp(sym->name, name) == 0)
+        if (sym->name == key)
             return sym;
     }
     return NULL;
@@ -205,9 +192,10 @@ int symtable_add_typedef_global(symtable_t *table, const char *name,
                                 type_kind_t type, size_t array_size,
                                 size_t elem_size)
 {
+    const char *key = intern_find(name);
     (void)array_size;
     for (symbol_t *sym = table->globals; sym; sym = sym->next) {
-        if (strcmp(sym->name, name) == 0)
+        if (sym->name == key)
             return 0;
     }
     symbol_t *sym = symtable_create_symbol(name, name);
@@ -228,7 +216,6 @@ void symtable_pop_scope(symtable_t *table, symbol_t *old_head)
     while (table->head != old_head) {
         symbol_t *sym = table->head;
         table->head = sym->next;
-        free(sym->name);
         free(sym->param_types);
         free(sym);
     }
@@ -9,6 +9,7 @@
 #include <string.h>
 #include "symtable.h"
 #include "util.h"
+#include "intern.h"
 
 /* Insert a global variable into the table. */
 int symtable_add_global(symtable_t *table, const char *name, const char *ir_name,
@@ -17,8 +18,9 @@ int symtable_add_global(symtable_t *table, const char *name, const char *ir_name
                         int is_static, int is_register, int is_const, int is_volatile,
                         int is_restrict)
 {
+    const char *key = intern_find(name);
     for (symbol_t *sym = table->globals; sym; sym = sym->next) {
-        if (strcmp(sym->name, name) == 0)
+        if (sym->name == key)
             return 0;
     }
     symbol_t *sym = symtable_create_symbol(name, ir_name ? ir_name : name);
@@ -61,8 +63,6 @@ int symtable_add_func(symtable_t *table, const char *name, type_kind_t ret_type,
         sym->param_types = malloc(param_count * sizeof(*sym->param_types));
         sym->param_struct_sizes = malloc(param_count * sizeof(*sym->param_struct_sizes));
         if (!sym->param_types || !sym->param_struct_sizes) {
-            free(sym->name);
-            free(sym->ir_name);
             free(sym->param_types);
             free(sym->param_struct_sizes);
             free(sym);
@@ -88,8 +88,9 @@ int symtable_add_func(symtable_t *table, const char *name, type_kind_t ret_type,
  */
 symbol_t *symtable_lookup_global(symtable_t *table, const char *name)
 {
+    const char *key = intern_find(name);
     for (symbol_t *sym = table->globals; sym; sym = sym->next) {
-        if (strcmp(sym->name, name) == 0)
+        if (sym->name == key)
             return sym;
     }
     return NULL;
@@ -10,6 +10,7 @@
 #include <stdint.h>
 #include "symtable.h"
 #include "util.h"
+#include "intern.h"
 
 /* Insert an enum constant in the current scope */
 int symtable_add_enum(symtable_t *table, const char *name, int value)
@@ -30,8 +31,9 @@ int symtable_add_enum(symtable_t *table, const char *name, int value)
 /* Insert an enum constant in the global scope */
 int symtable_add_enum_global(symtable_t *table, const char *name, int value)
 {
+    const char *key = intern_find(name);
     for (symbol_t *sym = table->globals; sym; sym = sym->next) {
-        if (strcmp(sym->name, name) == 0)
+        if (sym->name == key)
             return 0;
     }
     symbol_t *sym = symtable_create_symbol(name, name);
@@ -62,8 +64,9 @@ int symtable_add_enum_tag(symtable_t *table, const char *tag)
 /* Record an enum tag in the global scope */
 int symtable_add_enum_tag_global(symtable_t *table, const char *tag)
 {
+    const char *key = intern_find(tag);
     for (symbol_t *sym = table->globals; sym; sym = sym->next) {
-        if (strcmp(sym->name, tag) == 0)
+        if (sym->name == key)
             return 0;
     }
     symbol_t *sym = symtable_create_symbol(tag, tag);
@@ -87,15 +90,11 @@ int symtable_add_union(symtable_t *table, const char *tag,
     sym->type = TYPE_UNION;
     if (member_count) {
         if (member_count > SIZE_MAX / sizeof(*sym->members)) {
-            free(sym->name);
-            free(sym->ir_name);
             free(sym);
             return 0;
         }
         sym->members = malloc(member_count * sizeof(*sym->members));
         if (!sym->members) {
-            free(sym->name);
-            free(sym->ir_name);
             free(sym);
             return 0;
         }
@@ -105,8 +104,6 @@ int symtable_add_union(symtable_t *table, const char *tag,
                 for (size_t j = 0; j < i; j++)
                     free(sym->members[j].name);
                 free(sym->members);
-                free(sym->name);
-                free(sym->ir_name);
                 free(sym);
                 return 0;
             }
@@ -133,8 +130,9 @@ int symtable_add_union(symtable_t *table, const char *tag,
 int symtable_add_union_global(symtable_t *table, const char *tag,
                               union_member_t *members, size_t member_count)
 {
+    const char *key = intern_find(tag);
     for (symbol_t *sym = table->globals; sym; sym = sym->next) {
-        if (strcmp(sym->name, tag) == 0)
+        if (sym->name == key)
             return 0;
     }
     symbol_t *sym = symtable_create_symbol(tag, tag);
@@ -143,15 +141,11 @@ int symtable_add_union_global(symtable_t *table, const char *tag,
     sym->type = TYPE_UNION;
     if (member_count) {
         if (member_count > SIZE_MAX / sizeof(*sym->members)) {
-            free(sym->name);
-            free(sym->ir_name);
             free(sym);
             return 0;
         }
         sym->members = malloc(member_count * sizeof(*sym->members));
         if (!sym->members) {
-            free(sym->name);
-            free(sym->ir_name);
             free(sym);
             return 0;
         }
@@ -161,8 +155,6 @@ int symtable_add_union_global(symtable_t *table, const char *tag,
                 for (size_t j = 0; j < i; j++)
                     free(sym->members[j].name);
                 free(sym->members);
-                free(sym->name);
-                free(sym->ir_name);
                 free(sym);
                 return 0;
             }
@@ -191,14 +183,15 @@ int symtable_add_union_global(symtable_t *table, const char *tag,
  */
 symbol_t *symtable_lookup_union(symtable_t *table, const char *tag)
 {
+    const char *key = intern_find(tag);
     for (symbol_t *sym = table->head; sym; sym = sym->next) {
         if (sym->type == TYPE_UNION && sym->member_count > 0 &&
-            strcmp(sym->name, tag) == 0)
+            sym->name == key)
             return sym;
     }
     for (symbol_t *sym = table->globals; sym; sym = sym->next) {
         if (sym->type == TYPE_UNION && sym->member_count > 0 &&
-            strcmp(sym->name, tag) == 0)
+            sym->name == key)
             return sym;
     }
     return NULL;
@@ -216,15 +209,11 @@ int symtable_add_struct(symtable_t *table, const char *tag,
     sym->type = TYPE_STRUCT;
     if (member_count) {
         if (member_count > SIZE_MAX / sizeof(*sym->struct_members)) {
-            free(sym->name);
-            free(sym->ir_name);
             free(sym);
             return 0;
         }
         sym->struct_members = malloc(member_count * sizeof(*sym->struct_members));
         if (!sym->struct_members) {
-            free(sym->name);
-            free(sym->ir_name);
             free(sym);
             return 0;
         }
@@ -234,8 +223,6 @@ int symtable_add_struct(symtable_t *table, const char *tag,
                 for (size_t j = 0; j < i; j++)
                     free(sym->struct_members[j].name);
                 free(sym->struct_members);
-                free(sym->name);
-                free(sym->ir_name);
                 free(sym);
                 return 0;
             }
@@ -271,8 +258,9 @@ int symtable_add_struct(symtable_t *table, const char *tag,
 int symtable_add_struct_global(symtable_t *table, const char *tag,
                                struct_member_t *members, size_t member_count)
 {
+    const char *key = intern_find(tag);
     for (symbol_t *sym = table->globals; sym; sym = sym->next) {
-        if (strcmp(sym->name, tag) == 0)
+        if (sym->name == key)
             return 0;
     }
     symbol_t *sym = symtable_create_symbol(tag, tag);
@@ -281,15 +269,11 @@ int symtable_add_struct_global(symtable_t *table, const char *tag,
     sym->type = TYPE_STRUCT;
     if (member_count) {
         if (member_count > SIZE_MAX / sizeof(*sym->struct_members)) {
-            free(sym->name);
-            free(sym->ir_name);
             free(sym);
             return 0;
         }
         sym->struct_members = malloc(member_count * sizeof(*sym->struct_members));
         if (!sym->struct_members) {
-            free(sym->name);
-            free(sym->ir_name);
             free(sym);
             return 0;
         }
@@ -299,8 +283,6 @@ int symtable_add_struct_global(symtable_t *table, const char *tag,
                 for (size_t j = 0; j < i; j++)
                     free(sym->struct_members[j].name);
                 free(sym->struct_members);
-                free(sym->name);
-                free(sym->ir_name);
                 free(sym);
                 return 0;
             }
@@ -338,14 +320,15 @@ int symtable_add_struct_global(symtable_t *table, const char *tag,
  */
 symbol_t *symtable_lookup_struct(symtable_t *table, const char *tag)
 {
+    const char *key = intern_find(tag);
     for (symbol_t *sym = table->head; sym; sym = sym->next) {
         if (sym->type == TYPE_STRUCT && sym->struct_member_count > 0 &&
-            strcmp(sym->name, tag) == 0)
+            sym->name == key)
             return sym;
     }
     for (symbol_t *sym = table->globals; sym; sym = sym->next) {
         if (sym->type == TYPE_STRUCT && sym->struct_member_count > 0 &&
-            strcmp(sym->name, tag) == 0)
+            sym->name == key)
             return sym;
     }
     return NULL;
@@ -24,14 +24,12 @@
 #include <fcntl.h>
 #include "util.h"
 #include "ast_stmt.h"
-#include "preproc_macros.h"
 
 #ifdef UNIT_TESTING
 /*
  * Provide stub implementations so unit test binaries that only link a
  * subset of the sources still resolve these symbols.
  */
-void macro_free(macro_t *m) { (void)m; }
 #ifndef NO_VECTOR_FREE_STUB
 void vector_free(vector_t *v) { (void)v; }
 #endif
@@ -211,21 +209,6 @@ void free_string_vector(vector_t *v)
     vector_free(v);
 }
 
-/*
- * Release all macros stored in a vector and free the vector itself.
- *
- * Each macro must have been created by add_macro() so that macro_free()
- * can correctly release the heap allocated strings.
- */
-void free_macro_vector(vector_t *v)
-{
-    if (!v)
-        return;
-    for (size_t i = 0; i < v->count; i++)
-        macro_free(&((macro_t *)v->data)[i]);
-    vector_free(v);
-}
-
 /*
  * Release all functions stored in a vector and free the vector itself.
  *
@@ -0,0 +1,543 @@
+/*
+ * Machine instruction lists of the x86 backend.
+ *
+ * Instructions are appended by the codegen emitters and rendered to
+ * assembly text in one pass by x86_insn_list_print().  The printer owns
+ * every syntax difference between AT&T and Intel output: operand order,
+ * register and immediate prefixes, memory operand layout and the
+ * spelling of the x87 memory forms.
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#include <string.h>
+#include "x86_insn.h"
+
+#define NUM_GPRS (X86_BP + 1)
+
+static const char *names64[NUM_GPRS] = {
+    "rax", "rbx", "rcx", "rdx", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15", "rsp", "rbp"
+};
+
+static const char *names32[NUM_GPRS] = {
+    "eax", "ebx", "ecx", "edx", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d",
+    "esp", "ebp"
+};
+
+static const char *names16[NUM_GPRS] = {
+    "ax", "bx", "cx", "dx", "si", "di",
+    "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w",
+    "sp", "bp"
+};
+
+static const char *names8[NUM_GPRS] = {
+    "al", "bl", "cl", "dl", "sil", "dil",
+    "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b",
+    "spl", "bpl"
+};
+
+static const char *xmm_names[8] = {
+    "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7"
+};
+
+static const char *cc_names[] = {
+    "e", "ne", "l", "le", "g", "ge", "b", "be", "a", "ae"
+};
+
+/* AT&T mnemonics, indexed by x86_opcode_t up to X86_FDIVP */
+static const char *mnemonics[] = {
+    [X86_MOV] = "mov", [X86_MOVABS] = "movabs", [X86_MOVZB] = "movzb",
+    [X86_MOVZW] = "movzw", [X86_MOVSB] = "movsb", [X86_MOVSW] = "movsw",
+    [X86_LEA] = "lea", [X86_PUSH] = "push", [X86_POP] = "pop",
+    [X86_XCHG] = "xchg",
+    [X86_ADD] = "add", [X86_SUB] = "sub", [X86_IMUL] = "imul",
+    [X86_DIV] = "div", [X86_IDIV] = "idiv", [X86_NEG] = "neg",
+    [X86_AND] = "and", [X86_OR] = "or", [X86_XOR] = "xor",
+    [X86_SAL] = "sal", [X86_SAR] = "sar", [X86_SHL] = "shl",
+    [X86_SHR] = "shr", [X86_CMP] = "cmp", [X86_SETCC] = "set",
+    [X86_CLTD] = "cltd", [X86_CQTO] = "cqto",
+    [X86_JMP] = "jmp", [X86_JCC] = "j", [X86_CALL] = "call",
+    [X86_RET] = "ret",
+    [X86_MOVD] = "movd", [X86_MOVQ] = "movq", [X86_MOVSS] = "movss",
+    [X86_MOVSD] = "movsd", [X86_MOVDQU] = "movdqu",
+    [X86_ADDSS] = "addss", [X86_SUBSS] = "subss", [X86_MULSS] = "mulss",
+    [X86_DIVSS] = "divss", [X86_ADDSD] = "addsd", [X86_SUBSD] = "subsd",
+    [X86_MULSD] = "mulsd", [X86_DIVSD] = "divsd",
+    [X86_CVTSI2SS] = "cvtsi2ss", [X86_CVTSI2SD] = "cvtsi2sd",
+    [X86_CVTTSS2SI] = "cvttss2si", [X86_CVTTSD2SI] = "cvttsd2si",
+    [X86_CVTSS2SD] = "cvtss2sd", [X86_CVTSD2SS] = "cvtsd2ss",
+    [X86_FLDT] = "fldt", [X86_FSTPT] = "fstpt", [X86_FADDP] = "faddp",
+    [X86_FSUBP] = "fsubp", [X86_FMULP] = "fmulp", [X86_FDIVP] = "fdivp"
+};
+
+x86_operand_t x86_none(void)
+{
+    x86_operand_t o;
+    memset(&o, 0, sizeof(o));
+    o.kind = X86_OPD_NONE;
+    o.reg = X86_NOREG;
+    o.index = X86_NOREG;
+    o.scale = 1;
+    o.label = -1;
+    return o;
+}
+
+x86_operand_t x86_reg(x86_reg_t reg, int size)
+{
+    x86_operand_t o = x86_none();
+    o.kind = X86_OPD_REG;
+    o.reg = reg;
+    o.size = (unsigned char)size;
+    return o;
+}
+
+x86_operand_t x86_imm(long long value)
+{
+    x86_operand_t o = x86_none();
+    o.kind = X86_OPD_IMM;
+    o.value = value;
+    return o;
+}
+
+x86_operand_t x86_uimm(unsigned long long value)
+{
+    x86_operand_t o = x86_imm((long long)value);
+    o.flags = X86_OPF_UNSIGNED;
+    return o;
+}
+
+x86_operand_t x86_sym_addr(const char *sym)
+{
+    x86_operand_t o = x86_none();
+    o.kind = X86_OPD_IMM;
+    o.sym = sym;
+    return o;
+}
+
+x86_operand_t x86_sym(const char *sym)
+{
+    x86_operand_t o = x86_none();
+    o.kind = X86_OPD_SYM;
+    o.sym = sym;
+    return o;
+}
+
+x86_operand_t x86_label(int id, const char *suffix)
+{
+    x86_operand_t o = x86_sym(suffix);
+    o.label = id;
+    return o;
+}
+
+x86_operand_t x86_mem(x86_reg_t base, int size, long long disp)
+{
+    x86_operand_t o = x86_none();
+    o.kind = X86_OPD_MEM;
+    o.reg = base;
+    o.size = (unsigned char)size;
+    o.value = disp;
+    return o;
+}
+
+static int str_equal(const char *a, const char *b)
+{
+    if (!a || !b)
+        return a == b;
+    return strcmp(a, b) == 0;
+}
+
+int x86_operand_equal(const x86_operand_t *a, const x86_operand_t *b)
+{
+    if (a->kind != b->kind)
+        return 0;
+    switch (a->kind) {
+    case X86_OPD_NONE:
+        return 1;
+    case X86_OPD_REG:
+        return a->reg == b->reg && a->size == b->size;
+    case X86_OPD_IMM:
+        return a->value == b->value && str_equal(a->sym, b->sym) &&
+               a->flags == b->flags;
+    case X86_OPD_MEM:
+        return a->reg == b->reg && a->index == b->index &&
+               a->size == b->size && a->scale == b->scale &&
+               a->value == b->value && str_equal(a->sym, b->sym);
+    case X86_OPD_SYM:
+        return a->label == b->label && str_equal(a->sym, b->sym);
+    }
+    return 0;
+}
+
+void x86_insn_list_init(x86_insn_list_t *list)
+{
+    vector_init(&list->insns, sizeof(x86_insn_t));
+}
+
+void x86_insn_list_free(x86_insn_list_t *list)
+{
+    vector_free(&list->insns);
+}
+
+int x86_emit_insn(x86_insn_list_t *list, const x86_insn_t *ins)
+{
+    return vector_push(&list->insns, ins);
+}
+
+/* Append OP with the first NOPS entries of OPS */
+static int emit_ops(x86_insn_list_t *list, x86_opcode_t op, char sfx,
+                    int nops, const x86_operand_t *ops)
+{
+    x86_insn_t ins;
+    memset(&ins, 0, sizeof(ins));
+    ins.op = op;
+    ins.sfx = sfx;
+    ins.nops = (unsigned char)nops;
+    for (int i = 0; i < nops; i++)
+        ins.ops[i] = ops[i];
+    return x86_emit_insn(list, &ins);
+}
+
+int x86_emit0(x86_insn_list_t *list, x86_opcode_t op, char sfx)
+{
+    return emit_ops(list, op, sfx, 0, NULL);
+}
+
+int x86_emit1(x86_insn_list_t *list, x86_opcode_t op, char sfx,
+              x86_operand_t a)
+{
+    return emit_ops(list, op, sfx, 1, &a);
+}
+
+int x86_emit2(x86_insn_list_t *list, x86_opcode_t op, char sfx,
+              x86_operand_t src, x86_operand_t dest)
+{
+    x86_operand_t ops[2] = {src, dest};
+    return emit_ops(list, op, sfx, 2, ops);
+}
+
+int x86_emit3(x86_insn_list_t *list, x86_opcode_t op, char sfx,
+              x86_operand_t a, x86_operand_t b, x86_operand_t c)
+{
+    x86_operand_t ops[3] = {a, b, c};
+    return emit_ops(list, op, sfx, 3, ops);
+}
+
+int x86_emit_cc(x86_insn_list_t *list, x86_opcode_t op, x86_cc_t cc,
+                x86_operand_t a)
+{
+    x86_insn_t ins;
+    memset(&ins, 0, sizeof(ins));
+    ins.op = op;
+    ins.cc = (unsigned char)cc;
+    ins.nops = 1;
+    ins.ops[0] = a;
+    return x86_emit_insn(list, &ins);
+}
+
+/* ------------------------------------------------------------------
+ * Printing
+ * ------------------------------------------------------------------ */
+
+/* Output is staged here and handed to the string buffer in chunks */
+typedef struct {
+    strbuf_t *sb;
+    char buf[256];
+    size_t len;
+    int err;
+} outbuf_t;
+
+static void flush_out(outbuf_t *l)
+{
+    l->buf[l->len] = '\0';
+    if (l->len && strbuf_append(l->sb, l->buf) < 0)
+        l->err = 1;
+    l->len = 0;
+}
+
+static void put_char(outbuf_t *l, char c)
+{
+    if (l->len == sizeof(l->buf) - 1)
+        flush_out(l);
+    l->buf[l->len++] = c;
+}
+
+static void put_str(outbuf_t *l, const char *s)
+{
+    if (!s)
+        return;
+    size_t n = strlen(s);
+    if (n > sizeof(l->buf) - 1 - l->len) {
+        flush_out(l);
+        if (n >= sizeof(l->buf)) {
+            if (strbuf_append(l->sb, s) < 0)
+                l->err = 1;
+            return;
+        }
+    }
+    memcpy(l->buf + l->len, s, n);
+    l->len += n;
+}
+
+static void put_unsigned(outbuf_t *l, unsigned long long v)
+{
+    char tmp[24];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + (int)(v % 10));
+        v /= 10;
+    } while (v);
+    while (n)
+        put_char(l, tmp[--n]);
+}
+
+static void put_signed(outbuf_t *l, long long v)
+{
+    if (v < 0) {
+        put_char(l, '-');
+        put_unsigned(l, 0ULL - (unsigned long long)v);
+    } else {
+        put_unsigned(l, (unsigned long long)v);
+    }
+}
+
+/* Write V with an explicit sign */
+static void put_disp(outbuf_t *l, long long v)
+{
+    if (v >= 0)
+        put_char(l, '+');
+    put_signed(l, v);
+}
+
+static const char *reg_name(x86_reg_t reg, int size)
+{
+    if (reg >= X86_XMM0 && reg <= X86_XMM7)
+        return xmm_names[reg - X86_XMM0];
+    if (reg < 0 || reg >= NUM_GPRS)
+        return "";
+    switch (size) {
+    case 1: return names8[reg];
+    case 2: return names16[reg];
+    case 4: return names32[reg];
+    default: return names64[reg];
+    }
+}
+
+static void put_reg(outbuf_t *l, x86_reg_t reg, int size, asm_syntax_t syntax)
+{
+    if (syntax != ASM_INTEL)
+        put_char(l, '%');
+    put_str(l, reg_name(reg, size));
+}
+
+/* Symbol or generated label name */
+static void put_sym(outbuf_t *l, const x86_operand_t *o)
+{
+    if (o->label >= 0) {
+        put_char(l, 'L');
+        put_signed(l, o->label);
+    }
+    put_str(l, o->sym);
+}
+
+/* Memory operand in AT&T form: sym+disp(base,index,scale) */
+static void put_mem_att(outbuf_t *l, const x86_operand_t *o)
+{
+    int regs = o->reg != X86_NOREG || o->index != X86_NOREG;
+    if (o->sym) {
+        put_str(l, o->sym);
+        if (o->value)
+            put_disp(l, o->value);
+    } else if (o->reg == X86_BP && o->value <= 0) {
+        /* frame slots keep their "-N" form, including -0 */
+        put_char(l, '-');
+        put_signed(l, -o->value);
+    } else if (o->value || !regs) {
+        put_signed(l, o->value);
+    }
+    if (!regs)
+        return;
+    put_char(l, '(');
+    if (o->reg != X86_NOREG)
+        put_reg(l, o->reg, o->size, ASM_ATT);
+    if (o->index != X86_NOREG) {
+        put_char(l, ',');
+        put_reg(l, o->index, o->size, ASM_ATT);
+        put_char(l, ',');
+        put_unsigned(l, o->scale);
+    }
+    put_char(l, ')');
+}
+
+/* Memory operand in Intel form: [base+sym+disp+index*scale] */
+static void put_mem_intel(outbuf_t *l, const x86_operand_t *o)
+{
+    if (o->reg == X86_NOREG && o->index == X86_NOREG) {
+        /* plain symbol references stay unbracketed */
+        if (o->sym) {
+            put_str(l, o->sym);
+            if (o->value)
+                put_disp(l, o->value);
+        } else {
+            put_signed(l, o->value);
+        }
+        return;
+    }
+    int first = 1;
+    put_char(l, '[');
+    if (o->reg != X86_NOREG) {
+        put_reg(l, o->reg, o->size, ASM_INTEL);
+        first = 0;
+    }
+    if (o->sym) {
+        if (!first)
+            put_char(l, '+');
+        put_str(l, o->sym);
+        first = 0;
+    }
+    if (o->reg == X86_BP && !o->sym && o->value <= 0) {
+        put_char(l, '-');
+        put_signed(l, -o->value);
+    } else if (first) {
+        if (o->value) {
+            put_signed(l, o->value);
+            first = 0;
+        }
+    } else if (o->value) {
+        put_disp(l, o->value);
+    }
+    if (o->index != X86_NOREG) {
+        if (!first)
+            put_char(l, '+');
+        put_reg(l, o->index, o->size, ASM_INTEL);
+        if (o->scale != 1) {
+            put_char(l, '*');
+            put_unsigned(l, o->scale);
+        }
+    }
+    put_char(l, ']');
+}
+
+static void put_operand(outbuf_t *l, const x86_operand_t *o,
+                        asm_syntax_t syntax)
+{
+    switch (o->kind) {
+    case X86_OPD_NONE:
+        break;
+    case X86_OPD_REG:
+        put_reg(l, o->reg, o->size, syntax);
+        break;
+    case X86_OPD_IMM:
+        if (syntax != ASM_INTEL)
+            put_char(l, '$');
+        else if (o->sym && (o->flags & X86_OPF_FLAT))
+            put_str(l, "OFFSET FLAT:");
+        if (o->sym) {
+            put_str(l, o->sym);
+            if (o->value)
+                put_disp(l, o->value);
+        } else if (o->flags & X86_OPF_UNSIGNED) {
+            put_unsigned(l, (unsigned long long)o->value);
+        } else {
+            put_signed(l, o->value);
+        }
+        break;
+    case X86_OPD_MEM:
+        if (syntax == ASM_INTEL)
+            put_mem_intel(l, o);
+        else
+            put_mem_att(l, o);
+        break;
+    case X86_OPD_SYM:
+        put_sym(l, o);
+        if (o->label < 0 && o->value)
+            put_disp(l, o->value);
+        break;
+    }
+}
+
+static void put_directive(outbuf_t *l, const x86_insn_t *ins)
+{
+    const x86_operand_t *o = &ins->ops[0];
+    switch (ins->op) {
+    case X86_LABEL:
+        put_sym(l, o);
+        put_char(l, ':');
+        break;
+    case X86_GLOBL:
+        put_str(l, ".globl ");
+        put_sym(l, o);
+        break;
+    case X86_TYPE_FUNC:
+        put_str(l, ".type ");
+        put_sym(l, o);
+        put_str(l, ", @function");
+        break;
+    case X86_SIZE_FUNC:
+        put_str(l, ".size ");
+        put_sym(l, o);
+        put_str(l, ", .-");
+        put_sym(l, o);
+        break;
+    case X86_LOC:
+        put_str(l, ".loc 1 ");
+        put_signed(l, o->value);
+        put_char(l, ' ');
+        put_signed(l, ins->ops[1].value);
+        break;
+    case X86_COMMENT:
+        put_str(l, "    # ");
+        put_str(l, o->sym);
+        break;
+    default:
+        break;
+    }
+}
+
+static void put_insn(outbuf_t *l, const x86_insn_t *ins, asm_syntax_t syntax)
+{
+    int intel = syntax == ASM_INTEL;
+    put_str(l, "    ");
+    if (intel && ins->op == X86_FLDT) {
+        put_str(l, "fld tword ptr");
+    } else if (intel && ins->op == X86_FSTPT) {
+        put_str(l, "fstp tword ptr");
+    } else {
+        put_str(l, mnemonics[ins->op]);
+        if (ins->op == X86_SETCC || ins->op == X86_JCC)
+            put_str(l, cc_names[ins->cc]);
+        if (ins->sfx && !(intel && (ins->flags & X86_INSF_BARE)))
+            put_char(l, ins->sfx);
+    }
+    for (int i = 0; i < ins->nops; i++) {
+        /* Intel lists the destination first */
+        const x86_operand_t *o = &ins->ops[intel ? ins->nops - 1 - i : i];
+        put_str(l, i ? ", " : " ");
+        if (!intel && o->kind != X86_OPD_SYM &&
+            (ins->op == X86_CALL || ins->op == X86_JMP))
+            put_char(l, '*');
+        put_operand(l, o, syntax);
+    }
+}
+
+int x86_insn_list_print(strbuf_t *sb, const x86_insn_list_t *list,
+                        asm_syntax_t syntax)
+{
+    const x86_insn_t *insns = list->insns.data;
+    outbuf_t l;
+    l.sb = sb;
+    l.len = 0;
+    l.err = 0;
+    for (size_t i = 0; i < list->insns.count && !l.err; i++) {
+        const x86_insn_t *ins = &insns[i];
+        if (ins->op >= X86_LABEL)
+            put_directive(&l, ins);
+        else
+            put_insn(&l, ins, syntax);
+        put_char(&l, '\n');
+    }
+    flush_out(&l);
+    return l.err ? -1 : 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * Value numbering compile-time benchmark.
+ *
+ * Builds the IR a generated 50k line translation unit would lower to and
+ * times the common subexpression pass over it.  Each function is a chain
+ * of labelled blocks repeating the same few expressions, so most of them
+ * are redundant and every block boundary has to be respected:
+ *
+ *     make bench
+ *     tests/bench/cse_bench [LINES] [ITERATIONS]
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_const.h"
+#include "ir_memory.h"
+#include "ir_cfg.h"
+#include "opt.h"
+
+#define LINES_PER_FUNC 100
+#define LINES_PER_BLOCK 10
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/*
+ * Emit one function of LINES statements of the form
+ *     x = (a * b) + (b * a) + i;
+ * split into blocks that branch to the next label on a parameter.
+ */
+static void build_func(ir_builder_t *ir, size_t idx, int lines)
+{
+    char name[32];
+    char label[48];
+    snprintf(name, sizeof(name), "f%zu", idx);
+    ir_build_func_begin(ir, name);
+    ir_value_t a = ir_build_load_param(ir, 0, TYPE_INT);
+    ir_value_t b = ir_build_load_param(ir, 1, TYPE_INT);
+    for (int i = 0; i < lines; i++) {
+        if (i && i % LINES_PER_BLOCK == 0) {
+            snprintf(label, sizeof(label), "L%zu_%d", idx, i);
+            ir_build_bcond(ir, a, label);
+            ir_build_label(ir, label);
+        }
+        ir_value_t m1 = ir_build_binop(ir, IR_MUL, a, b, TYPE_INT);
+        ir_value_t m2 = ir_build_binop(ir, IR_MUL, b, a, TYPE_INT);
+        ir_value_t s = ir_build_binop(ir, IR_ADD, m1, m2, TYPE_INT);
+        ir_value_t c = ir_build_const(ir, i % LINES_PER_BLOCK);
+        ir_build_store(ir, "stack:4", TYPE_INT,
+                       ir_build_binop(ir, IR_ADD, s, c, TYPE_INT));
+    }
+    ir_build_return(ir, ir_build_load(ir, "stack:4", TYPE_INT), TYPE_INT);
+    ir_build_func_end(ir);
+}
+
+static void build_unit(ir_builder_t *ir, int lines)
+{
+    ir_builder_init(ir);
+    size_t funcs = (size_t)(lines + LINES_PER_FUNC - 1) / LINES_PER_FUNC;
+    for (size_t f = 0; f < funcs; f++)
+        build_func(ir, f, LINES_PER_FUNC);
+}
+
+static size_t count_instrs(ir_builder_t *ir)
+{
+    size_t n = 0;
+    for (ir_instr_t *i = ir->head; i; i = i->next)
+        n++;
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    int lines = argc > 1 ? atoi(argv[1]) : 50000;
+    int iters = argc > 2 ? atoi(argv[2]) : 10;
+    if (lines <= 0)
+        lines = LINES_PER_FUNC;
+    if (iters <= 0)
+        iters = 1;
+
+    size_t instrs = 0;
+    double best = 0.0;
+    for (int i = 0; i < iters; i++) {
+        ir_builder_t ir;
+        ir_cfg_t cfg;
+        build_unit(&ir, lines);
+        instrs = count_instrs(&ir);
+        if (!ir_cfg_build(&ir, &cfg)) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        double start = now_sec();
+        opt_value_number(&ir, &cfg);
+        double elapsed = now_sec() - start;
+        ir_cfg_free(&cfg);
+        ir_builder_free(&ir);
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    printf("%d lines, %zu instructions\n", lines, instrs);
+    printf("best of %d: %.3f ms, %.1f ns/instruction\n", iters, best * 1e3,
+           instrs ? best * 1e9 / (double)instrs : 0.0);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Lexer throughput microbenchmark.
+ *
+ * Tokenizes a file repeatedly and reports the rate in megabytes per
+ * second.  Feed it preprocessed text so that the numbers reflect the
+ * work the compiler does after the preprocessor, for example:
+ *
+ *     gcc -E -Iinclude -DPROJECT_ROOT='"."' src/parser_expr.c > /tmp/big.i
+ *     make bench
+ *     tests/bench/lexer_bench /tmp/big.i 50
+ *
+ * Part of vc under the BSD 2-Clause license.
+ * See LICENSE for details.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "token.h"
+
+/* Read the whole file at PATH into a NUL terminated buffer */
+static char *read_all(const char *path, size_t *out_len)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    size_t cap = 1 << 16, len = 0;
+    char *buf = malloc(cap);
+    size_t n;
+    while (buf && (n = fread(buf + len, 1, cap - len - 1, f)) > 0) {
+        len += n;
+        if (cap - len - 1 == 0) {
+            char *tmp = realloc(buf, cap * 2);
+            if (!tmp) {
+                free(buf);
+                buf = NULL;
+                break;
+            }
+            buf = tmp;
+            cap *= 2;
+        }
+    }
+    fclose(f);
+    if (!buf)
+        return NULL;
+    buf[len] = '\0';
+    *out_len = len;
+    return buf;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s FILE [ITERATIONS]\n", argv[0]);
+        return 1;
+    }
+    int iters = argc > 2 ? atoi(argv[2]) : 20;
+    if (iters <= 0)
+        iters = 1;
+
+    size_t len;
+    char *src = read_all(argv[1], &len);
+    if (!src)
+        return 1;
+
+    size_t count = 0;
+    double best = 0.0;
+    for (int i = 0; i < iters; i++) {
+        double start = now_sec();
+        token_t *toks = lexer_tokenize(src, &count);
+        double elapsed = now_sec() - start;
+        if (!toks) {
+            fprintf(stderr, "tokenization failed\n");
+            free(src);
+            return 1;
+        }
+        lexer_free_tokens(toks, count);
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+
+    double mb = (double)len / (1024.0 * 1024.0);
+    printf("%s: %zu bytes, %zu tokens\n", argv[1], len, count);
+    printf("best of %d: %.3f ms, %.1f MB/s\n", iters, best * 1e3,
+           best > 0.0 ? mb / best : 0.0);
+    free(src);
+    return 0;
+}
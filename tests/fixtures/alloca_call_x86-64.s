@@ -1,23 +1,24 @@
 caller:
     pushq %rbp
     movq %rsp, %rbp
-    movq 16(%rbp), %rax
-    movq $1, %rbx
-    movl %eax, %ecx
-    imull %ebx, %ecx
-    movq %rcx, %rax
+    subq $16, %rsp
+    movq %rbx, -8(%rbp)
+    movq 16(%rbp), %r10
+    movq $1, %r8
+    movl %r10d, %r9d
+    imull %r8d, %r9d
+    movq %r9, %rax
     addq $15, %rax
     andq $-16, %rax
     subq %rax, %rsp
     movq %rsp, %rbx
     call callee
-    movq %rax, %rcx
-    movq $0, %rax
-    movq $0, %rdx
-    movq %rax, %rsi
-    imulq $1, %rsi
-    addq %rbx, %rsi
-    movl %edx, (%rsi)
+    movq %rax, %r10
+    movq $0, %r10
+    movq %r10, %r8
+    addq %rbx, %r8
+    movl %r10d, (%r8)
+    movq -8(%rbp), %rbx
     movq %rbp, %rsp
     popq %rbp
     ret
@@ -0,0 +1,12 @@
+int printf(const char *fmt, ...);
+
+int h(int x)
+{
+    return x * 2;
+}
+
+int main(void)
+{
+    printf("%d\n", h(3));
+    return 0;
+}
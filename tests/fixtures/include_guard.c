@@ -0,0 +1,4 @@
+#include "guard.h"
+#include "guard.h"
+#include "guard.h"
+int main() { return 0; }
@@ -19,7 +19,7 @@ multi:
 main:
     pushl %ebp
     movl %esp, %ebp
-    movl $10, %ecx
+    movl $8, %ecx
     movl %ecx, %eax
     ret
     movl %ebp, %esp
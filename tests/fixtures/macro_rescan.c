@@ -0,0 +1,18 @@
+#define CAT(a, b) a ## b
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define ONE 1
+#define f(x) (x + 1)
+#define g f
+#define self self + 1
+#define LOG(fmt, ...) printf(fmt, ## __VA_ARGS__)
+int CAT(var, ONE) = XSTR(ONE);
+const char *s = STR("a\n" 'b' c);
+int a = g(2);
+int b = self;
+int c = CAT(, ONE) CAT(ONE, );
+LOG("x");
+LOG("%d", 1);
+#define none() int
+none() d = f
+(1);
@@ -0,0 +1,5 @@
+/* header protected by a classic include guard */
+#ifndef GUARD_H
+#define GUARD_H
+int guard_var;
+#endif /* GUARD_H */
@@ -21,7 +21,7 @@ $CC -Iinclude -Wall -Wextra -std=c99 \
     src/parser_expr_primary.c src/parser_expr_binary.c \
     src/parser_stmt.c src/parser_types.c src/symtable_core.c \
     src/symtable_globals.c src/symtable_struct.c src/ast_clone.c \
-    src/ast_expr.c src/ast_stmt_create.c src/ast_stmt_free.c src/lexer.c util_unit.o \
+    src/ast_expr.c src/ast_stmt_create.c src/ast_stmt_free.c src/lexer.c src/intern.c util_unit.o \
     src/vector.c src/error.c src/token_names.c src/parser_toplevel_func.c \
     src/parser_toplevel_var.c src/parser_expr_ops.c src/parser_expr_literal.c \
     src/lexer_ident.c src/lexer_scan_numeric.c src/ast_expr_binary.c \
@@ -73,12 +73,13 @@ $CC -Iinclude -Wall -Wextra -std=c99 -c src/ast_stmt_create.c -o ast_stmt_create
 $CC -Iinclude -Wall -Wextra -std=c99 -c src/ast_stmt_free.c -o ast_stmt_free_fail.o
 $CC -Iinclude -Wall -Wextra -std=c99 -Dvector_push=test_vector_push \
     -c src/lexer.c -o lexer_alloc.o
+$CC -Iinclude -Wall -Wextra -std=c99 -c src/intern.c -o intern_alloc.o
 $CC -Iinclude -Wall -Wextra -std=c99 -c src/vector.c -o vector_alloc.o
 $CC -Iinclude -Wall -Wextra -std=c99 -DUNIT_TESTING -c src/util.c -o util_alloc.o
 $CC -Iinclude -Wall -Wextra -std=c99 -c src/error.c -o error_alloc.o
 $CC -Iinclude -Wall -Wextra -std=c99 -c "$DIR/unit/test_parser_alloc_fail.c" -o "$DIR/test_parser_alloc_fail.o"
-$CC -o "$DIR/parser_alloc_tests" parser_core_fail.o parser_init_fail.o parser_decl_var_fail.o parser_decl_struct_fail.o parser_decl_enum_fail.o parser_flow_fail.o parser_toplevel_fail.o parser_expr_fail.o parser_expr_primary_fail.o parser_expr_binary_fail.o parser_stmt_fail.o parser_types_fail.o parser_toplevel_func_fail.o parser_toplevel_var_fail.o parser_expr_ops_fail.o parser_expr_literal_fail.o lexer_ident_fail.o lexer_scan_numeric_fail.o ast_expr_binary_fail.o ast_expr_control_fail.o ast_expr_literal_fail.o ast_expr_type_fail.o token_names_fail.o preproc_table_fail.o symtable_core_fail.o symtable_globals_fail.o symtable_struct_fail.o ast_clone_fail.o ast_expr_fail.o ast_stmt_create_fail.o ast_stmt_free_fail.o lexer_alloc.o vector_alloc.o util_alloc.o error_alloc.o "$DIR/test_parser_alloc_fail.o"
-rm -f parser_core_fail.o parser_init_fail.o parser_decl_var_fail.o parser_decl_struct_fail.o parser_decl_enum_fail.o parser_flow_fail.o parser_toplevel_fail.o parser_expr_fail.o parser_expr_primary_fail.o parser_expr_binary_fail.o parser_stmt_fail.o parser_types_fail.o parser_toplevel_func_fail.o parser_toplevel_var_fail.o parser_expr_ops_fail.o parser_expr_literal_fail.o lexer_ident_fail.o lexer_scan_numeric_fail.o ast_expr_binary_fail.o ast_expr_control_fail.o ast_expr_literal_fail.o ast_expr_type_fail.o token_names_fail.o preproc_table_fail.o symtable_core_fail.o symtable_globals_fail.o symtable_struct_fail.o ast_clone_fail.o ast_expr_fail.o ast_stmt_create_fail.o ast_stmt_free_fail.o lexer_alloc.o vector_alloc.o util_alloc.o error_alloc.o "$DIR/test_parser_alloc_fail.o"
+$CC -o "$DIR/parser_alloc_tests" parser_core_fail.o parser_init_fail.o parser_decl_var_fail.o parser_decl_struct_fail.o parser_decl_enum_fail.o parser_flow_fail.o parser_toplevel_fail.o parser_expr_fail.o parser_expr_primary_fail.o parser_expr_binary_fail.o parser_stmt_fail.o parser_types_fail.o parser_toplevel_func_fail.o parser_toplevel_var_fail.o parser_expr_ops_fail.o parser_expr_literal_fail.o lexer_ident_fail.o lexer_scan_numeric_fail.o ast_expr_binary_fail.o ast_expr_control_fail.o ast_expr_literal_fail.o ast_expr_type_fail.o token_names_fail.o preproc_table_fail.o symtable_core_fail.o symtable_globals_fail.o symtable_struct_fail.o ast_clone_fail.o ast_expr_fail.o ast_stmt_create_fail.o ast_stmt_free_fail.o lexer_alloc.o intern_alloc.o vector_alloc.o util_alloc.o error_alloc.o "$DIR/test_parser_alloc_fail.o"
+rm -f parser_core_fail.o parser_init_fail.o parser_decl_var_fail.o parser_decl_struct_fail.o parser_decl_enum_fail.o parser_flow_fail.o parser_toplevel_fail.o parser_expr_fail.o parser_expr_primary_fail.o parser_expr_binary_fail.o parser_stmt_fail.o parser_types_fail.o parser_toplevel_func_fail.o parser_toplevel_var_fail.o parser_expr_ops_fail.o parser_expr_literal_fail.o lexer_ident_fail.o lexer_scan_numeric_fail.o ast_expr_binary_fail.o ast_expr_control_fail.o ast_expr_literal_fail.o ast_expr_type_fail.o token_names_fail.o preproc_table_fail.o symtable_core_fail.o symtable_globals_fail.o symtable_struct_fail.o ast_clone_fail.o ast_expr_fail.o ast_stmt_create_fail.o ast_stmt_free_fail.o lexer_alloc.o intern_alloc.o vector_alloc.o util_alloc.o error_alloc.o "$DIR/test_parser_alloc_fail.o"
 # build ir_core unit test binary with malloc wrapper
 $CC -Iinclude -Wall -Wextra -std=c99 -Dmalloc=test_malloc -Dcalloc=test_calloc -c src/ir_core.c -o ir_core_test.o
 $CC -Iinclude -Wall -Wextra -std=c99 -Dmalloc=test_malloc -Dcalloc=test_calloc -c src/util.c -o util_ircore.o
@@ -110,7 +111,7 @@ $CC -Iinclude -Wall -Wextra -std=c99 \
 # build for-loop IR order test
 $CC -Iinclude -Wall -Wextra -std=c99 \
     -o "$DIR/for_loop_tests" "$DIR/unit/test_for_loop.c" \
-    src/lexer.c src/lexer_ident.c src/lexer_scan_numeric.c \
+    src/lexer.c src/intern.c src/lexer_ident.c src/lexer_scan_numeric.c \
     src/parser_core.c src/parser_init.c src/parser_decl_var.c \
     src/parser_decl_struct.c src/parser_decl_enum.c src/parser_flow.c \
     src/parser_toplevel.c src/parser_expr.c src/parser_expr_primary.c \
@@ -210,8 +211,6 @@ $CC -o "$DIR/preproc_counter_wrap" preproc_builtin_wrap.o strbuf_wrap.o util_wra
 rm -f preproc_builtin_wrap.o strbuf_wrap.o util_wrap.o "$DIR/test_preproc_counter_wrap.o"
 # build collect_funcs overflow regression test
 $CC -Iinclude -Wall -Wextra -std=c99 "$DIR/unit/test_collect_funcs_overflow.c" -o "$DIR/collect_funcs_overflow"
-# build parse_inline_hint descriptor close test
-$CC -Iinclude -Wall -Wextra -std=c99 -o "$DIR/parse_inline_hint_tests" "$DIR/unit/test_parse_inline_hint.c"
 # build waitpid EINTR regression test
 $CC -Iinclude -Wall -Wextra -std=c99 -c src/strbuf.c -o strbuf_eintr_impl.o
 $CC -Iinclude -Wall -Wextra -std=c99 -c src/util.c -o util_eintr.o
@@ -694,7 +693,6 @@ rm -f ir_licm.o util_licm.o label_licm.o error_licm.o opt_main_licm.o \
 "$DIR/append_env_paths_semicolon"
 "$DIR/append_env_paths_both"
 "$DIR/append_env_paths_fail"
-"$DIR/parse_inline_hint_tests"
 "$DIR/temp_file_tests"
 "$DIR/compile_obj_fail"
 "$DIR/vc_names_tests"
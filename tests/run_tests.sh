@@ -34,7 +34,7 @@ for cfile in "$DIR"/fixtures/*.c; do
     base=$(basename "$cfile" .c)
 
     case "$base" in
-        *_x86-64|struct_*|bitfield_rw|include_search|include_angle|include_env|macro_bad_define|preproc_blank|macro_cli|macro_cli_quote|include_once|include_once_link|include_next|include_next_quote|libm_program|union_example|varargs_double|include_stdio|libc_puts|libc_puts_large|libc_printf|local_program|local_assign|libc_fileio|libc_short_write|libc_write_fail|libc_exit_fail|loops|mixed_args|alloca_call|many_params)
+        *_x86-64|struct_*|bitfield_rw|include_search|include_angle|include_env|macro_bad_define|preproc_blank|macro_rescan|macro_cli|macro_cli_quote|include_once|include_once_link|include_guard|include_next|include_next_quote|libm_program|union_example|varargs_double|include_stdio|libc_puts|libc_puts_large|libc_printf|local_program|local_assign|libc_fileio|libc_short_write|libc_write_fail|libc_exit_fail|loops|mixed_args|alloca_call|many_params|call_string_arg)
             continue;;
     esac
     compile_fixture "$cfile" "$DIR/fixtures/$base.s"
@@ -277,6 +277,22 @@ else
 fi
 rm -f "$exe" "$exe.s" "$exe.o" "$exe.log" "$out" 2>/dev/null || true
 
+# verify a string argument loaded before a nested call survives the call
+asm_chk=$(safe_mktemp)
+if "$BINARY" --x86-64 -o "${asm_chk}" "$DIR/fixtures/call_string_arg.c" >/dev/null 2>&1; then
+    if ! awk '/^main:/ { m = 1 }
+              m && /movabsq \$Lstr/ { r = $NF }
+              m && /call h$/ && r !~ /^%(rbx|r12|r13|r14|r15)$/ { bad = 1 }
+              END { exit bad }' "${asm_chk}"; then
+        echo "Test call_string_arg failed"
+        fail=1
+    fi
+else
+    echo "Test call_string_arg failed"
+    fail=1
+fi
+rm -f "${asm_chk}"
+
 # negative test for parse error message
 err=$(safe_mktemp)
 out=$(safe_mktemp)
@@ -373,6 +389,7 @@ cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_load_store_spill.c" \
     "$DIR/../src/codegen_load.c" "$DIR/../src/codegen_store.c" \
     "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/load_store_spill"
 if ! "$DIR/load_store_spill" >/dev/null; then
     echo "Test load_store_spill failed"
@@ -385,6 +402,7 @@ cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_store_ptr_stack.c" \
     "$DIR/../src/codegen_store.c" \
     "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/store_ptr_stack"
 if ! "$DIR/store_ptr_stack" >/dev/null; then
     echo "Test store_ptr_stack failed"
@@ -397,6 +415,7 @@ cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_load_ptr_stack.c" \
     "$DIR/../src/codegen_load.c" \
     "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/load_ptr_stack"
 if ! "$DIR/load_ptr_stack" >/dev/null; then
     echo "Test load_ptr_stack failed"
@@ -408,6 +427,7 @@ rm -f "$DIR/load_ptr_stack"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_ptr_diff_zero.c" \
     "$DIR/../src/codegen_arith_int.c" "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/ptr_diff_zero"
 if ! "$DIR/ptr_diff_zero" >/dev/null; then
     echo "Test ptr_diff_zero failed"
@@ -419,6 +439,7 @@ rm -f "$DIR/ptr_diff_zero"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_ptr_add_spill.c" \
     "$DIR/../src/codegen_arith_int.c" "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/ptr_add_spill"
 if ! "$DIR/ptr_add_spill" >/dev/null; then
     echo "Test ptr_add_spill failed"
@@ -430,6 +451,7 @@ rm -f "$DIR/ptr_add_spill"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_div_spill.c" \
     "$DIR/../src/codegen_arith_int.c" "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/div_spill"
 if ! "$DIR/div_spill" >/dev/null; then
     echo "Test div_spill failed"
@@ -441,6 +463,7 @@ rm -f "$DIR/div_spill"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_cast_mem2mem.c" \
     "$DIR/../src/codegen_arith_float.c" "$DIR/../src/strbuf.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/regalloc_x86.c" -o "$DIR/cast_mem2mem"
 if ! "$DIR/cast_mem2mem" >/dev/null; then
     echo "Test cast_mem2mem failed"
@@ -452,6 +475,7 @@ rm -f "$DIR/cast_mem2mem"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_cmp_spill.c" \
     "$DIR/../src/codegen_arith_int.c" "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/cmp_spill"
 if ! "$DIR/cmp_spill" >/dev/null; then
     echo "Test cmp_spill failed"
@@ -463,6 +487,7 @@ rm -f "$DIR/cmp_spill"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_cmp_intel.c" \
     "$DIR/../src/codegen_arith_int.c" "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/cmp_intel"
 if ! "$DIR/cmp_intel" >/dev/null; then
     echo "Test cmp_intel failed"
@@ -474,6 +499,7 @@ rm -f "$DIR/cmp_intel"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_cmp_signed.c" \
     "$DIR/../src/codegen_arith_int.c" "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/cmp_signed"
 if ! "$DIR/cmp_signed" >/dev/null; then
     echo "Test cmp_signed failed"
@@ -487,6 +513,7 @@ cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/../src/codegen_mem_x86.c" "$DIR/../src/codegen_mem_common.c" \
     "$DIR/../src/codegen_load.c" "$DIR/../src/codegen_store.c" \
     "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/glob_string"
 if ! "$DIR/glob_string" >/dev/null; then
     echo "Test glob_string failed"
@@ -494,19 +521,26 @@ if ! "$DIR/glob_string" >/dev/null; then
 fi
 rm -f "$DIR/glob_string"
 
+# compiler sources linked into the unit tests below; each test adds its own file
+SRC="$DIR/../src"
+IR_SRCS="$SRC/ir_core.c $SRC/ir_builder.c $SRC/ir_defuse.c $SRC/ir_const.c \
+    $SRC/ir_memory.c $SRC/ir_control.c $SRC/ir_global.c \
+    $SRC/strbuf.c $SRC/intern.c $SRC/vector.c $SRC/util.c $SRC/label.c $SRC/error.c"
+REGALLOC_SRCS="$SRC/regalloc.c $SRC/regalloc_x86.c $SRC/ir_cfg.c $IR_SRCS"
+CODEGEN_SRCS="$SRC/codegen.c $SRC/codegen_mem_common.c $SRC/codegen_mem_x86.c \
+    $SRC/codegen_load.c $SRC/codegen_store.c \
+    $SRC/codegen_arith_int.c $SRC/codegen_arith_float.c \
+    $SRC/codegen_branch.c $SRC/codegen_float.c $SRC/codegen_complex.c \
+    $SRC/codegen_x86.c $SRC/x86_insn.c $REGALLOC_SRCS"
+OPT_SRCS="$SRC/ir_cfg.c $SRC/ir_alias.c \
+    $SRC/opt.c $SRC/opt_constprop.c $SRC/opt_cse.c $SRC/opt_fold.c \
+    $SRC/opt_licm.c $SRC/opt_memory.c $SRC/opt_dce.c \
+    $SRC/opt_inline.c $SRC/opt_inline_helpers.c \
+    $SRC/opt_unreachable.c $SRC/opt_alias.c $SRC/opt_ssa.c $IR_SRCS"
+
 # verify global string emission with embedded NUL
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
-    "$DIR/unit/test_glob_string_nul.c" \
-    "$DIR/../src/codegen.c" \
-    "$DIR/../src/codegen_mem_common.c" "$DIR/../src/codegen_mem_x86.c" \
-    "$DIR/../src/codegen_load.c" "$DIR/../src/codegen_store.c" \
-    "$DIR/../src/codegen_arith_int.c" "$DIR/../src/codegen_arith_float.c" \
-    "$DIR/../src/codegen_branch.c" "$DIR/../src/codegen_float.c" \
-    "$DIR/../src/codegen_complex.c" "$DIR/../src/codegen_x86.c" \
-    "$DIR/../src/regalloc.c" "$DIR/../src/regalloc_x86.c" \
-    "$DIR/../src/strbuf.c" "$DIR/../src/ir_const.c" "$DIR/../src/ir_builder.c" \
-    "$DIR/../src/ir_core.c" "$DIR/../src/ir_global.c" \
-    "$DIR/../src/vector.c" "$DIR/../src/util.c" "$DIR/../src/label.c" "$DIR/../src/error.c" \
+    "$DIR/unit/test_glob_string_nul.c" $CODEGEN_SRCS \
     -o "$DIR/glob_string_nul"
 if ! "$DIR/glob_string_nul" >/dev/null; then
     echo "Test glob_string_nul failed"
@@ -514,12 +548,215 @@ if ! "$DIR/glob_string_nul" >/dev/null; then
 fi
 rm -f "$DIR/glob_string_nul"
 
+# verify macro table lookup, redefinition and removal
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_macro_table.c" \
+    "$DIR/../src/preproc_table.c" "$DIR/../src/preproc_expand.c" "$DIR/../src/preproc_tokens.c" \
+    "$DIR/../src/preproc_args.c" "$DIR/../src/preproc_paste.c" "$DIR/../src/preproc_builtin.c" \
+    "$DIR/../src/preproc_macro_utils.c" "$DIR/../src/lexer.c" "$DIR/../src/lexer_ident.c" \
+    "$DIR/../src/lexer_scan_numeric.c" "$DIR/../src/strbuf.c" "$DIR/../src/intern.c" \
+    "$DIR/../src/vector.c" "$DIR/../src/util.c" "$DIR/../src/error.c" \
+    -o "$DIR/macro_table"
+if ! "$DIR/macro_table" >/dev/null 2>&1; then
+    echo "Test macro_table failed"
+    fail=1
+fi
+rm -f "$DIR/macro_table"
+
+# verify realpath interning and cached file contents
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING \
+    "$DIR/unit/test_file_cache.c" \
+    "$DIR/../src/file_cache.c" "$DIR/../src/util.c" \
+    -o "$DIR/file_cache"
+if ! "$DIR/file_cache" >/dev/null 2>&1; then
+    echo "Test file_cache failed"
+    fail=1
+fi
+rm -f "$DIR/file_cache"
+
+# verify string interner identity and table growth
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING \
+    "$DIR/unit/test_intern.c" \
+    "$DIR/../src/intern.c" "$DIR/../src/util.c" \
+    -o "$DIR/intern"
+if ! "$DIR/intern" >/dev/null 2>&1; then
+    echo "Test intern failed"
+    fail=1
+fi
+rm -f "$DIR/intern"
+
+# verify register classes and callee-saved registers of both targets
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_regalloc_target.c" $CODEGEN_SRCS \
+    -o "$DIR/regalloc_target"
+if ! "$DIR/regalloc_target" >/dev/null; then
+    echo "Test regalloc_target failed"
+    fail=1
+fi
+rm -f "$DIR/regalloc_target"
+
+# verify live intervals, spill weights and stack slot sharing
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_regalloc_intervals.c" $REGALLOC_SRCS \
+    -o "$DIR/regalloc_intervals"
+if ! "$DIR/regalloc_intervals" >/dev/null; then
+    echo "Test regalloc_intervals failed"
+    fail=1
+fi
+rm -f "$DIR/regalloc_intervals"
+
+# verify coalescing and fixed register constraints of the allocators
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_regalloc_color.c" $REGALLOC_SRCS \
+    -o "$DIR/regalloc_color"
+if ! "$DIR/regalloc_color" >/dev/null; then
+    echo "Test regalloc_color failed"
+    fail=1
+fi
+rm -f "$DIR/regalloc_color"
+
+# verify encoding, jump relaxation, relocations and sections of the assembler
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_asm_x86.c" \
+    "$DIR/../src/asm_x86.c" "$DIR/../src/asm_x86_encode.c" "$DIR/../src/asm_elf.c" \
+    "$DIR/../src/intern.c" "$DIR/../src/vector.c" "$DIR/../src/util.c" \
+    "$DIR/../src/label.c" "$DIR/../src/error.c" \
+    -o "$DIR/asm_x86"
+if ! "$DIR/asm_x86" >/dev/null 2>&1; then
+    echo "Test asm_x86 failed"
+    fail=1
+fi
+rm -f "$DIR/asm_x86"
+
+# verify AT&T and Intel printing of machine instruction lists
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_x86_insn.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/strbuf.c" "$DIR/../src/vector.c" \
+    "$DIR/../src/util.c" "$DIR/../src/error.c" \
+    -o "$DIR/x86_insn"
+if ! "$DIR/x86_insn" >/dev/null 2>&1; then
+    echo "Test x86_insn failed"
+    fail=1
+fi
+rm -f "$DIR/x86_insn"
+
+# verify the IR arena allocator
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_ir_arena.c" $IR_SRCS \
+    -o "$DIR/ir_arena"
+if ! "$DIR/ir_arena" >/dev/null; then
+    echo "Test ir_arena failed"
+    fail=1
+fi
+rm -f "$DIR/ir_arena"
+
+# verify the def-use index and use replacement
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_ir_defuse.c" $IR_SRCS \
+    -o "$DIR/ir_defuse"
+if ! "$DIR/ir_defuse" >/dev/null; then
+    echo "Test ir_defuse failed"
+    fail=1
+fi
+rm -f "$DIR/ir_defuse"
+
+# verify CFG construction and preheader hoisting
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_ir_cfg.c" $OPT_SRCS \
+    -o "$DIR/ir_cfg"
+if ! "$DIR/ir_cfg" >/dev/null; then
+    echo "Test ir_cfg failed"
+    fail=1
+fi
+rm -f "$DIR/ir_cfg"
+
+# verify SSA construction and destruction
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_opt_ssa.c" $OPT_SRCS \
+    -o "$DIR/opt_ssa"
+if ! "$DIR/opt_ssa" >/dev/null; then
+    echo "Test opt_ssa failed"
+    fail=1
+fi
+rm -f "$DIR/opt_ssa"
+
+# verify dominator scoped value numbering
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_opt_cse.c" $OPT_SRCS \
+    -o "$DIR/opt_cse"
+if ! "$DIR/opt_cse" >/dev/null; then
+    echo "Test opt_cse failed"
+    fail=1
+fi
+rm -f "$DIR/opt_cse"
+
+# verify inline candidates come from the IR_FUNC_BEGIN flags
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_collect_inline_funcs.c" $OPT_SRCS \
+    -o "$DIR/collect_inline_funcs"
+if ! "$DIR/collect_inline_funcs" >/dev/null; then
+    echo "Test collect_inline_funcs failed"
+    fail=1
+fi
+rm -f "$DIR/collect_inline_funcs"
+
+# verify call graph ordered inlining of multi block callees
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_opt_inline.c" $OPT_SRCS \
+    -o "$DIR/opt_inline"
+if ! "$DIR/opt_inline" >/dev/null; then
+    echo "Test opt_inline failed"
+    fail=1
+fi
+rm -f "$DIR/opt_inline"
+
+# verify sparse conditional constant propagation and branch folding
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_opt_sccp.c" $OPT_SRCS \
+    -o "$DIR/opt_sccp"
+if ! "$DIR/opt_sccp" >/dev/null; then
+    echo "Test opt_sccp failed"
+    fail=1
+fi
+rm -f "$DIR/opt_sccp"
+
+# verify loop invariant code motion and strength reduction
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_opt_loop.c" $OPT_SRCS \
+    -o "$DIR/opt_loop"
+if ! "$DIR/opt_loop" >/dev/null; then
+    echo "Test opt_loop failed"
+    fail=1
+fi
+rm -f "$DIR/opt_loop"
+
+# verify redundant load and dead store elimination
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_opt_memory.c" $OPT_SRCS \
+    -o "$DIR/opt_memory"
+if ! "$DIR/opt_memory" >/dev/null; then
+    echo "Test opt_memory failed"
+    fail=1
+fi
+rm -f "$DIR/opt_memory"
+
+# verify points-to, restrict and type based alias queries
+cc -I "$DIR/../include" -Wall -Wextra -std=c99 -DUNIT_TESTING -DNO_VECTOR_FREE_STUB \
+    "$DIR/unit/test_ir_alias.c" "$DIR/../src/ir_alias.c" $IR_SRCS \
+    -o "$DIR/ir_alias"
+if ! "$DIR/ir_alias" >/dev/null; then
+    echo "Test ir_alias failed"
+    fail=1
+fi
+rm -f "$DIR/ir_alias"
+
 # verify address emission uses movabs in x86-64 mode
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_addr_movabs.c" \
     "$DIR/../src/codegen_mem_x86.c" "$DIR/../src/codegen_mem_common.c" \
     "$DIR/../src/codegen_load.c" "$DIR/../src/codegen_store.c" \
     "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/addr_movabs"
 if ! "$DIR/addr_movabs" >/dev/null; then
     echo "Test addr_movabs failed"
@@ -531,6 +768,7 @@ rm -f "$DIR/addr_movabs"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_load_store_idx_scale.c" \
     "$DIR/../src/codegen_load.c" "$DIR/../src/codegen_store.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/load_store_idx_scale"
 if ! "$DIR/load_store_idx_scale" >/dev/null; then
     echo "Test load_store_idx_scale failed"
@@ -542,6 +780,7 @@ rm -f "$DIR/load_store_idx_scale"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_load_idx_spill.c" \
     "$DIR/../src/codegen_load.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/load_idx_spill"
 if ! "$DIR/load_idx_spill" >/dev/null; then
     echo "Test load_idx_spill failed"
@@ -553,6 +792,7 @@ rm -f "$DIR/load_idx_spill"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_store_idx_spill.c" \
     "$DIR/../src/codegen_store.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/store_idx_spill"
 if ! "$DIR/store_idx_spill" >/dev/null; then
     echo "Test store_idx_spill failed"
@@ -564,6 +804,7 @@ rm -f "$DIR/store_idx_spill"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_ldouble_load_store.c" \
     "$DIR/../src/codegen_load.c" "$DIR/../src/codegen_store.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/ldouble_load_store"
 if ! "$DIR/ldouble_load_store" >/dev/null; then
     echo "Test ldouble_load_store failed"
@@ -575,6 +816,7 @@ rm -f "$DIR/ldouble_load_store"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_complex_load_store.c" \
     "$DIR/../src/codegen_load.c" "$DIR/../src/codegen_store.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/complex_load_store"
 if ! "$DIR/complex_load_store" >/dev/null; then
     echo "Test complex_load_store failed"
@@ -586,6 +828,7 @@ rm -f "$DIR/complex_load_store"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_emit_cast_int64.c" \
     "$DIR/../src/codegen_arith_float.c" "$DIR/../src/strbuf.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/regalloc_x86.c" -o "$DIR/emit_cast_int64"
 if ! "$DIR/emit_cast_int64" >/dev/null; then
     echo "Test emit_cast_int64 failed"
@@ -597,6 +840,7 @@ rm -f "$DIR/emit_cast_int64"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_emit_cast_float_int.c" \
     "$DIR/../src/codegen_arith_float.c" "$DIR/../src/strbuf.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/regalloc_x86.c" -o "$DIR/emit_cast_float_int"
 if ! "$DIR/emit_cast_float_int" >/dev/null; then
     echo "Test emit_cast_float_int failed"
@@ -608,6 +852,7 @@ rm -f "$DIR/emit_cast_float_int"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_emit_float_binop.c" \
     "$DIR/../src/codegen_float.c" "$DIR/../src/strbuf.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/regalloc_x86.c" -o "$DIR/emit_float_binop"
 if ! "$DIR/emit_float_binop" >/dev/null; then
     echo "Test emit_float_binop failed"
@@ -619,6 +864,7 @@ rm -f "$DIR/emit_float_binop"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_return_double.c" \
     "$DIR/../src/codegen_branch.c" "$DIR/../src/strbuf.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/regalloc_x86.c" -o "$DIR/return_double"
 if ! "$DIR/return_double" >/dev/null; then
     echo "Test return_double failed"
@@ -630,6 +876,7 @@ rm -f "$DIR/return_double"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_emit_cplx_add.c" \
     "$DIR/../src/codegen_complex.c" "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/emit_cplx_add"
 if ! "$DIR/emit_cplx_add" >/dev/null; then
     echo "Test emit_cplx_add failed"
@@ -641,6 +888,7 @@ rm -f "$DIR/emit_cplx_add"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_shift_rcx.c" \
     "$DIR/../src/codegen_arith_int.c" "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/shift_rcx"
 if ! "$DIR/shift_rcx" >/dev/null; then
     echo "Test shift_rcx failed"
@@ -652,6 +900,7 @@ rm -f "$DIR/shift_rcx"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_code_gen_32bit_as.c" \
     "$DIR/../src/codegen_arith_int.c" "$DIR/../src/codegen_x86.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/code_gen_32bit_as"
 if ! "$DIR/code_gen_32bit_as" >/dev/null; then
     echo "Test code_gen_32bit_as failed"
@@ -663,6 +912,7 @@ rm -f "$DIR/code_gen_32bit_as"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_xmm_fallback.c" \
     "$DIR/../src/codegen_float.c" "$DIR/../src/codegen_complex.c" \
+    "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/codegen_x86.c" "$DIR/../src/strbuf.c" "$DIR/../src/regalloc_x86.c" -o "$DIR/xmm_fallback"
 if ! "$DIR/xmm_fallback" >/dev/null; then
     echo "Test xmm_fallback failed"
@@ -674,6 +924,7 @@ rm -f "$DIR/xmm_fallback"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_store_xmm_fallback.c" \
     "$DIR/../src/codegen_store.c" "$DIR/../src/strbuf.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/regalloc_x86.c" -o "$DIR/store_xmm_fallback"
 if ! "$DIR/store_xmm_fallback" >/dev/null; then
     echo "Test store_xmm_fallback failed"
@@ -685,6 +936,7 @@ rm -f "$DIR/store_xmm_fallback"
 cc -I "$DIR/../include" -Wall -Wextra -std=c99 \
     "$DIR/unit/test_call_stack_cleanup.c" \
     "$DIR/../src/codegen_branch.c" "$DIR/../src/strbuf.c" \
+    "$DIR/../src/codegen_x86.c" "$DIR/../src/x86_insn.c" "$DIR/../src/vector.c" \
     "$DIR/../src/regalloc_x86.c" -o "$DIR/call_stack_cleanup"
 if ! "$DIR/call_stack_cleanup" >/dev/null; then
     echo "Test call_stack_cleanup failed"
@@ -968,6 +1220,29 @@ if ! grep -q "IR_CONST" "${ir_out}"; then
 fi
 rm -f "${ir_out}"
 
+# test --dump-regalloc option
+ra_out=$(safe_mktemp)
+"$BINARY" --dump-regalloc "$DIR/fixtures/simple_add.c" > "${ra_out}"
+if ! grep -q "^function main" "${ra_out}" || ! grep -q "weight" "${ra_out}"; then
+    echo "Test dump_regalloc failed"
+    fail=1
+fi
+"$BINARY" --regalloc=color --dump-regalloc "$DIR/fixtures/simple_add.c" > "${ra_out}"
+if ! grep -q "^function main" "${ra_out}"; then
+    echo "Test regalloc_color_dump failed"
+    fail=1
+fi
+err=$(safe_mktemp)
+set +e
+"$BINARY" --regalloc=greedy --dump-regalloc "$DIR/fixtures/simple_add.c" > "${ra_out}" 2> "${err}"
+ret=$?
+set -e
+if [ $ret -eq 0 ] || ! grep -q "Unknown register allocator" "${err}"; then
+    echo "Test invalid_regalloc failed"
+    fail=1
+fi
+rm -f "${ra_out}" "${err}"
+
 # verify restrict pointers are marked in IR
 ir_restrict=$(safe_mktemp)
 "$BINARY" --dump-ir "$DIR/fixtures/restrict_load.c" > "${ir_restrict}"
@@ -1004,6 +1279,15 @@ if ! diff -u "$DIR/fixtures/preproc_blank.expected" "${pp_blank}"; then
 fi
 rm -f "${pp_blank}"
 
+# verify # and ## work on tokens and replacements are rescanned
+pp_rescan=$(safe_mktemp)
+"$BINARY" -E "$DIR/fixtures/macro_rescan.c" > "${pp_rescan}"
+if ! diff -u "$DIR/fixtures/macro_rescan.expected" "${pp_rescan}"; then
+    echo "Test preprocess_macro_rescan failed"
+    fail=1
+fi
+rm -f "${pp_rescan}"
+
 # verify #pragma once prevents repeated includes
 pp_once=$(safe_mktemp)
 "$BINARY" -I "$DIR/includes" -E "$DIR/fixtures/include_once.c" > "${pp_once}"
@@ -1022,6 +1306,28 @@ if ! diff -u "$DIR/fixtures/include_once_link.expected" "${pp_link}"; then
 fi
 rm -f "${pp_link}"
 
+# verify include guards skip re-reading a header
+pp_guard=$(safe_mktemp)
+err=$(safe_mktemp)
+"$BINARY" -I "$DIR/includes" --verbose-includes -E "$DIR/fixtures/include_guard.c" > "${pp_guard}" 2> "$err"
+if [ "$(grep -c guard_var "${pp_guard}")" -ne 1 ] || \
+   ! grep -q "include guards: 2 re-reads skipped" "$err"; then
+    echo "Test include_guard failed"
+    fail=1
+fi
+rm -f "${pp_guard}" "$err"
+
+# verify the include directory index resolves headers like direct probes
+pp_index=$(safe_mktemp)
+err=$(safe_mktemp)
+"$BINARY" -I "$DIR/includes" --include-index-stats -E "$DIR/fixtures/include_once.c" > "${pp_index}" 2> "$err"
+if ! diff -u "$DIR/fixtures/include_once.expected" "${pp_index}" || \
+   ! grep -q "include index: .* 2 found" "$err"; then
+    echo "Test include_index failed"
+    fail=1
+fi
+rm -f "${pp_index}" "$err"
+
 # verify _Pragma handling in glibc headers does not hit expansion limit
 if [ -f /usr/include/sys/cdefs.h ]; then
     header=/usr/include/sys/cdefs.h
@@ -1203,6 +1509,38 @@ if ! od -An -t x1 "${libm_exe}" | head -n 1 | grep -q "7f 45 4c 46"; then
 fi
 rm -f "${libm_exe}"
 
+# compile several units in parallel with -j and VC_JOBS
+jobs_dir=$(safe_mktemp -d)
+jobs_bin=$(cd "$(dirname "$BINARY")" && pwd)/vc
+printf 'int answer(void);\nint main(void) { return answer(); }\n' > "${jobs_dir}/main.c"
+printf 'int answer(void) { return 42; }\n' > "${jobs_dir}/answer.c"
+printf 'int f(void) { return missing_a; }\n' > "${jobs_dir}/bad_a.c"
+printf 'int g(void) { return missing_b; }\n' > "${jobs_dir}/bad_b.c"
+"$BINARY" --x86-64 -j 2 --link -o "${jobs_dir}/prog" \
+    "${jobs_dir}/main.c" "${jobs_dir}/answer.c" > /dev/null 2>&1
+set +e
+"${jobs_dir}/prog"
+ret=$?
+set -e
+if [ $ret -ne 42 ]; then
+    echo "Test parallel_jobs_link failed"
+    fail=1
+fi
+# objects from multi-source -c land in the working directory
+set +e
+(cd "${jobs_dir}" && "$jobs_bin" --x86-64 -c -o unused answer.c bad_a.c \
+    bad_b.c 2> seq.err)
+(cd "${jobs_dir}" && VC_JOBS=3 "$jobs_bin" --x86-64 -c -o unused answer.c \
+    bad_a.c bad_b.c 2> par.err)
+ret=$?
+set -e
+if [ $ret -eq 0 ] || ! cmp -s "${jobs_dir}/seq.err" "${jobs_dir}/par.err" ||
+   ! grep -q "missing_a" "${jobs_dir}/par.err"; then
+    echo "Test parallel_jobs_diagnostics failed"
+    fail=1
+fi
+rm -rf "${jobs_dir}"
+
 # build and run simple program with internal libc (32-bit and 64-bit)
 if [ $SKIP_LIBC_TESTS -eq 0 ]; then
     if [ $CAN_COMPILE_32 -eq 0 ]; then
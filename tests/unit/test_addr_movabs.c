@@ -15,6 +15,7 @@ int main(void) {
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins;
     strbuf_t sb;
+    x86_insn_list_t code;
     int fail = 0;
 
     regalloc_set_x86_64(1);
@@ -28,7 +29,10 @@ int main(void) {
 
     strbuf_init(&sb);
     regalloc_set_asm_syntax(ASM_ATT);
-    mem_emitters[IR_ADDR](&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    mem_emitters[IR_ADDR](&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!contains(sb.data, "movabs")) {
         printf("ATT missing movabs: %s\n", sb.data);
         fail = 1;
@@ -37,7 +41,10 @@ int main(void) {
 
     strbuf_init(&sb);
     regalloc_set_asm_syntax(ASM_INTEL);
-    mem_emitters[IR_ADDR](&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    mem_emitters[IR_ADDR](&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!contains(sb.data, "movabs")) {
         printf("Intel missing movabs: %s\n", sb.data);
         fail = 1;
@@ -49,7 +56,10 @@ int main(void) {
 
     strbuf_init(&sb);
     regalloc_set_asm_syntax(ASM_ATT);
-    mem_emitters[IR_ADDR](&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    mem_emitters[IR_ADDR](&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!contains(sb.data, "movabs") || !contains(sb.data, "movq")) {
         printf("ATT spill failed: %s\n", sb.data);
         fail = 1;
@@ -58,7 +68,10 @@ int main(void) {
 
     strbuf_init(&sb);
     regalloc_set_asm_syntax(ASM_INTEL);
-    mem_emitters[IR_ADDR](&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    mem_emitters[IR_ADDR](&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!contains(sb.data, "movabs") || !contains(sb.data, "movq")) {
         printf("Intel spill failed: %s\n", sb.data);
         fail = 1;
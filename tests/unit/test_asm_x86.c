@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <string.h>
+#include "asm_x86.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+/* Assemble TEXT into OBJ, returning 1 on success */
+static int assemble(const char *text, int x64, asm_object_t *obj)
+{
+    asm_object_init(obj);
+    return asm_x86_assemble_object(text, strlen(text), x64, obj);
+}
+
+static asm_section_t *find_section(asm_object_t *obj, const char *name)
+{
+    for (size_t i = 0; i < obj->sections.count; i++) {
+        asm_section_t *sec = ASM_SECTION(obj, i);
+        if (strcmp(sec->name, name) == 0)
+            return sec;
+    }
+    return NULL;
+}
+
+static int section_is(asm_section_t *sec, const unsigned char *bytes,
+                      size_t len)
+{
+    return sec && sec->size == len && memcmp(sec->data, bytes, len) == 0;
+}
+
+static asm_reloc_t *reloc_at(asm_section_t *sec, size_t i)
+{
+    if (!sec || i >= sec->relocs.count)
+        return NULL;
+    return &((asm_reloc_t *)sec->relocs.data)[i];
+}
+
+/* Register, immediate and memory operands encode like GNU as */
+static void test_encodings(void)
+{
+    asm_object_t obj;
+    static const unsigned char want[] = {
+        0xb8, 0x05, 0x00, 0x00, 0x00,       /* movl $5, %eax */
+        0x48, 0x01, 0xd8,                   /* addq %rbx, %rax */
+        0x48, 0x8b, 0x45, 0xf8,             /* movq -8(%rbp), %rax */
+        0x44, 0x89, 0x04, 0x24,             /* movl %r8d, (%rsp) */
+        0x48, 0x83, 0xec, 0x10,             /* subq $16, %rsp */
+        0xc3                                /* ret */
+    };
+    ASSERT(assemble(".text\n"
+                    "    movl $5, %eax\n"
+                    "    addq %rbx, %rax\n"
+                    "    movq -8(%rbp), %rax\n"
+                    "    movl %r8d, (%rsp)\n"
+                    "    subq $16, %rsp\n"
+                    "    ret\n", 1, &obj));
+    ASSERT(section_is(find_section(&obj, ".text"), want, sizeof(want)));
+    asm_object_free(&obj);
+}
+
+/* Jumps stay short until their target moves out of rel8 range */
+static void test_relaxation(void)
+{
+    asm_object_t obj;
+    static const unsigned char near[] = { 0xeb, 0x01, 0x90, 0xc3 };
+    ASSERT(assemble(".text\n    jmp .L1\n    nop\n.L1:\n    ret\n", 1, &obj));
+    ASSERT(section_is(find_section(&obj, ".text"), near, sizeof(near)));
+    asm_object_free(&obj);
+
+    ASSERT(assemble(".text\n    jne .L1\n    .zero 200\n.L1:\n    ret\n",
+                    1, &obj));
+    asm_section_t *text = find_section(&obj, ".text");
+    ASSERT(text && text->size == 6 + 200 + 1);
+    if (text && text->size >= 6) {
+        ASSERT(text->data[0] == 0x0f && text->data[1] == 0x85);
+        ASSERT(text->data[2] == 200 && text->data[3] == 0);
+    }
+    asm_object_free(&obj);
+}
+
+/* References to undefined symbols become relocations */
+static void test_relocations(void)
+{
+    asm_object_t obj;
+    ASSERT(assemble(".text\n"
+                    "    call foo\n"
+                    "    movl x(%rip), %eax\n"
+                    ".data\n"
+                    "    .quad y+8\n", 1, &obj));
+    asm_section_t *text = find_section(&obj, ".text");
+    asm_reloc_t *r = reloc_at(text, 0);
+    ASSERT(r && r->offset == 1 && r->kind == ASM_RELOC_PLT32 && r->addend == -4);
+    r = reloc_at(text, 1);
+    ASSERT(r && r->offset == 7 && r->kind == ASM_RELOC_PC32 && r->addend == -4);
+    if (r && r->symbol >= 0)
+        ASSERT(strcmp(ASM_SYMBOL(&obj, r->symbol)->name, "x") == 0);
+    r = reloc_at(find_section(&obj, ".data"), 0);
+    ASSERT(r && r->offset == 0 && r->kind == ASM_RELOC_ABS64 && r->addend == 8);
+    asm_object_free(&obj);
+
+    /* i386 keeps the addend in the field and uses the moffs form */
+    static const unsigned char moffs[] = { 0xa1, 0x04, 0x00, 0x00, 0x00 };
+    ASSERT(assemble(".text\n    movl x+4, %eax\n", 0, &obj));
+    text = find_section(&obj, ".text");
+    ASSERT(section_is(text, moffs, sizeof(moffs)));
+    r = reloc_at(text, 0);
+    ASSERT(r && r->offset == 1 && r->kind == ASM_RELOC_ABS32);
+    asm_object_free(&obj);
+}
+
+/* .rodata is read-only data and .bss reserves zeros without contents */
+static void test_sections(void)
+{
+    asm_object_t obj;
+    static const unsigned char ro[] = { 'h', 'i', 0, 0, 7, 0, 0, 0 };
+    ASSERT(assemble(".section .rodata\n"
+                    "msg:\n    .asciz \"hi\"\n"
+                    "    .align 4\n    .long 7\n"
+                    ".bss\n    .zero 8\n"
+                    ".text\n    .lcomm buf, 64, 16\n"
+                    "    movl buf(%rip), %eax\n", 1, &obj));
+    asm_section_t *rodata = find_section(&obj, ".rodata");
+    ASSERT(section_is(rodata, ro, sizeof(ro)));
+    ASSERT(rodata && rodata->type == ASM_SHT_PROGBITS &&
+           rodata->flags == ASM_SHF_ALLOC && rodata->align == 4);
+    asm_section_t *bss = find_section(&obj, ".bss");
+    ASSERT(bss && bss->type == ASM_SHT_NOBITS && !bss->data);
+    ASSERT(bss && bss->size == 16 + 64 && bss->align == 16);
+    ASSERT(bss && bss->flags == (ASM_SHF_ALLOC | ASM_SHF_WRITE));
+    asm_reloc_t *r = reloc_at(find_section(&obj, ".text"), 0);
+    ASSERT(r && r->symbol < 0 && r->addend == 16 - 4);
+    if (r && bss)
+        ASSERT(ASM_SECTION(&obj, r->section) == bss);
+    asm_object_free(&obj);
+
+    /* .bss has no bytes to hold data or relocation fields */
+    ASSERT(!assemble(".bss\n    .byte 1\n", 1, &obj));
+    asm_object_free(&obj);
+    ASSERT(!assemble(".bss\n    .quad x\n", 1, &obj));
+    asm_object_free(&obj);
+    ASSERT(!assemble(".section .rodata\n.section .rodata, \"aw\"\n",
+                     1, &obj));
+    asm_object_free(&obj);
+}
+
+/* Unsupported input is rejected */
+static void test_errors(void)
+{
+    asm_object_t obj;
+    ASSERT(!assemble(".text\n    frobnicate %eax\n", 1, &obj));
+    asm_object_free(&obj);
+    ASSERT(!assemble(".text\n    movq %rax, %rbx, %rcx\n", 1, &obj));
+    asm_object_free(&obj);
+    /* a symbol cannot address a frame slot */
+    ASSERT(!assemble(".text\n    movl x(%rbp), %eax\n", 1, &obj));
+    asm_object_free(&obj);
+    ASSERT(!assemble(".text\n    movl x+4(%ebp), %eax\n", 0, &obj));
+    asm_object_free(&obj);
+    ASSERT(assemble(".text\n    movl 8+16(%rbp), %eax\n", 1, &obj));
+    asm_object_free(&obj);
+}
+
+int main(void)
+{
+    test_encodings();
+    test_relaxation();
+    test_relocations();
+    test_sections();
+    test_errors();
+    if (failures == 0)
+        printf("All asm_x86 tests passed\n");
+    else
+        printf("%d asm_x86 test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
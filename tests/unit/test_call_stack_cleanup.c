@@ -24,6 +24,7 @@ static int check(const char *out, const char *exp, const char *name) {
 
 int main(void) {
     strbuf_t sb;
+    x86_insn_list_t code;
     int locs[2] = {0};
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     int fail = 0;
@@ -34,7 +35,10 @@ int main(void) {
     ir_instr_t ins = { .op = IR_CALL, .imm = 0, .name = "foo", .type = TYPE_INT, .dest = 0 };
     arg_stack_bytes = 4;
     strbuf_init(&sb);
-    emit_branch_instr(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_branch_instr(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "    call foo\n    addl $4, %esp\n", "direct");
     strbuf_free(&sb);
 
@@ -45,7 +49,10 @@ int main(void) {
     ins.src1 = 1;
     arg_stack_bytes = 8;
     strbuf_init(&sb);
-    emit_branch_instr(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_branch_instr(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "    subq $8, %rsp\n    call *%rcx\n    addq $16, %rsp\n", "indirect");
     strbuf_free(&sb);
 
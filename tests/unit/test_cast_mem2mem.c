@@ -18,13 +18,17 @@ int main(void) {
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins;
     strbuf_t sb;
+    x86_insn_list_t code;
 
     ins.dest = 2;
     ins.src1 = 1;
     ins.imm = ((unsigned long long)TYPE_INT << 32) | TYPE_INT;
 
     strbuf_init(&sb);
-    emit_cast(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "movq -8(%rbp), %rax") ||
         !strstr(sb.data, "movq %rax, -16(%rbp)")) {
         printf("ATT: unexpected output: %s\n", sb.data);
@@ -33,7 +37,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_cast(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "movq rax, [rbp-8]") ||
         !strstr(sb.data, "movq [rbp-16], rax")) {
         printf("Intel: unexpected output: %s\n", sb.data);
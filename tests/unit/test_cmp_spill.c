@@ -6,20 +6,18 @@
 #include "regalloc.h"
 
 /* Stubs required by codegen_arith_int.c */
-const char *label_format_suffix(char buf[32], const char *prefix, int id,
-                                const char *suffix) { (void)buf; (void)prefix; (void)id; (void)suffix; return ""; }
-void emit_float_binop(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                      asm_syntax_t syntax) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; }
-void emit_long_float_binop(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
-                           int x64, asm_syntax_t syntax) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; }
-void emit_cplx_addsub(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                      asm_syntax_t syntax, const char *op) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; (void)op; }
-void emit_cplx_mul(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                   asm_syntax_t syntax) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; }
-void emit_cplx_div(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                   asm_syntax_t syntax) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; }
-void emit_cast(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-               asm_syntax_t syntax) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; }
+void emit_float_binop(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                      int x64, x86_opcode_t op) { (void)code; (void)ins; (void)ra; (void)x64; (void)op; }
+void emit_long_float_binop(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                           int x64, x86_opcode_t op) { (void)code; (void)ins; (void)ra; (void)x64; (void)op; }
+void emit_cplx_addsub(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                      int x64, x86_opcode_t op) { (void)code; (void)ins; (void)ra; (void)x64; (void)op; }
+void emit_cplx_mul(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                   int x64) { (void)code; (void)ins; (void)ra; (void)x64; }
+void emit_cplx_div(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                   int x64) { (void)code; (void)ins; (void)ra; (void)x64; }
+void emit_cast(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+               int x64) { (void)code; (void)ins; (void)ra; (void)x64; }
 int label_next_id(void) { return 0; }
 void *vc_alloc_or_exit(size_t sz) { return malloc(sz); }
 void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
@@ -31,6 +29,7 @@ int main(void) {
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins;
     strbuf_t sb;
+    x86_insn_list_t code;
 
     ins.op = IR_CMPEQ;
     ins.src1 = 1;
@@ -44,7 +43,10 @@ int main(void) {
     ra.loc[3] = 2; /* %ecx */
 
     strbuf_init(&sb);
-    emit_cmp(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cmp(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!contains(sb.data, "movzbl %al, %ecx") || contains(sb.data, "movb")) {
         printf("register ATT failed: %s\n", sb.data);
         return 1;
@@ -55,7 +57,10 @@ int main(void) {
     ra.loc[3] = -1; /* stack slot */
 
     strbuf_init(&sb);
-    emit_cmp(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cmp(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     const char *out = sb.data;
     if (!contains(out, "movb %al, -4(%ebp)") ||
         !contains(out, "movzbl %al, %eax") ||
@@ -72,7 +77,10 @@ int main(void) {
     ra.loc[3] = 2;  /* %ecx */
 
     strbuf_init(&sb);
-    emit_cmp(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cmp(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "movl -4(%ebp), %eax") ||
         !contains(out, "cmpl -8(%ebp), %eax") ||
@@ -86,7 +94,10 @@ int main(void) {
     ra.loc[3] = -3; /* stack slot */
 
     strbuf_init(&sb);
-    emit_cmp(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cmp(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "movl -4(%ebp), %eax") ||
         !contains(out, "cmpl -8(%ebp), %eax") ||
@@ -6,34 +6,18 @@
 #include "regalloc_x86.h"
 
 /* Stub implementations required by codegen_arith_int.c */
-const char *label_format_suffix(char buf[32], const char *prefix, int id,
-                                const char *suffix) {
-    (void)buf; (void)prefix; (void)id; (void)suffix; return "";
-}
-void emit_float_binop(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                      asm_syntax_t syntax) {
-    (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax;
-}
-void emit_long_float_binop(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
-                           int x64, asm_syntax_t syntax) {
-    (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax;
-}
-void emit_cplx_addsub(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                      asm_syntax_t syntax, const char *op) {
-    (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; (void)op;
-}
-void emit_cplx_mul(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                   asm_syntax_t syntax) {
-    (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax;
-}
-void emit_cplx_div(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                   asm_syntax_t syntax) {
-    (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax;
-}
-void emit_cast(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-               asm_syntax_t syntax) {
-    (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax;
-}
+void emit_float_binop(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                      int x64, x86_opcode_t op) { (void)code; (void)ins; (void)ra; (void)x64; (void)op; }
+void emit_long_float_binop(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                           int x64, x86_opcode_t op) { (void)code; (void)ins; (void)ra; (void)x64; (void)op; }
+void emit_cplx_addsub(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                      int x64, x86_opcode_t op) { (void)code; (void)ins; (void)ra; (void)x64; (void)op; }
+void emit_cplx_mul(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                   int x64) { (void)code; (void)ins; (void)ra; (void)x64; }
+void emit_cplx_div(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                   int x64) { (void)code; (void)ins; (void)ra; (void)x64; }
+void emit_cast(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+               int x64) { (void)code; (void)ins; (void)ra; (void)x64; }
 int label_next_id(void) { return 0; }
 void *vc_alloc_or_exit(size_t sz) { return malloc(sz); }
 void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
@@ -43,6 +27,7 @@ int main(void) {
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins = { .op = IR_SHL, .src1 = 1, .src2 = 2, .dest = 3, .type = TYPE_INT };
     strbuf_t sb;
+    x86_insn_list_t code;
     char asmfile[L_tmpnam];
     char obj[sizeof asmfile + 2];
     char cmd[sizeof asmfile + sizeof obj + 10];
@@ -54,7 +39,10 @@ int main(void) {
     ra.loc[3] = 2; /* %ecx */
 
     strbuf_init(&sb);
-    emit_shift(&sb, &ins, &ra, 0, "shl", ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_shift(&code, &ins, &ra, 0, X86_SHL);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
 
     if (!tmpnam(asmfile)) {
         perror("tmpnam");
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_memory.h"
+#include "intern.h"
+#include "opt.h"
+#include "opt_inline_helpers.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+/* emit `name(a, b) { return a + b; }` with the given FUNC_BEGIN flags */
+static void build_add(ir_builder_t *ir, const char *name, int flags)
+{
+    ir_instr_t *begin = ir_build_func_begin(ir, name);
+    begin->src1 = flags;
+    ir_value_t a = ir_build_load_param(ir, 0, TYPE_INT);
+    ir_value_t b = ir_build_load_param(ir, 1, TYPE_INT);
+    ir_build_return(ir, ir_build_binop(ir, IR_ADD, a, b, TYPE_INT), TYPE_INT);
+    ir_build_func_end(ir);
+}
+
+/* every definition is collected with its flags left on IR_FUNC_BEGIN */
+static void test_flags(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_builder_set_loc(&ir, "/nonexistent/source.c", 1, 1);
+    build_add(&ir, "plain", 0);
+    build_add(&ir, "hinted", IR_FUNC_INLINE | IR_FUNC_STATIC);
+    build_add(&ir, "fatal", IR_FUNC_NORETURN);
+
+    inline_func_t *funcs = NULL;
+    size_t count = 0;
+    ASSERT(collect_funcs(&ir, &funcs, &count));
+    ASSERT(count == 3);
+    if (count == 3) {
+        ASSERT(funcs[1].name == intern_str("hinted"));
+        ASSERT(funcs[1].begin->src1 == (IR_FUNC_INLINE | IR_FUNC_STATIC));
+        ASSERT(funcs[1].end->op == IR_FUNC_END);
+        ASSERT(funcs[1].param_count == 2);
+        ASSERT(funcs[1].size == 4);
+        ASSERT(funcs[1].inlinable && funcs[1].tail_return);
+    }
+    free(funcs);
+    ir_builder_free(&ir);
+}
+
+/* stores to parameters are noted, dynamic stack allocation is refused */
+static void test_analyze(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "dec");
+    ir_value_t a = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_build_store_param(&ir, 0, TYPE_INT,
+                         ir_build_binop(&ir, IR_SUB, a, ir_build_const(&ir, 1),
+                                        TYPE_INT));
+    ir_build_bcond(&ir, a, "L1");
+    ir_build_return(&ir, ir_build_load_param(&ir, 0, TYPE_INT), TYPE_INT);
+    ir_build_label(&ir, "L1");
+    ir_build_return(&ir, a, TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_build_func_begin(&ir, "vla");
+    ir_build_alloca(&ir, ir_build_load_param(&ir, 0, TYPE_INT));
+    ir_build_func_end(&ir);
+
+    inline_func_t *funcs = NULL;
+    size_t count = 0;
+    ASSERT(collect_funcs(&ir, &funcs, &count));
+    ASSERT(count == 2);
+    if (count == 2) {
+        ASSERT(funcs[0].inlinable);
+        ASSERT(funcs[0].written == 1u);
+        ASSERT(funcs[0].param_loads[0] == 2);
+        ASSERT(funcs[0].returns == 2 && !funcs[0].tail_return);
+        ASSERT(funcs[0].size == 8);
+        ASSERT(!funcs[1].inlinable);
+    }
+    free(funcs);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_flags();
+    test_analyze();
+    if (failures == 0)
+        printf("All collect_inline_funcs tests passed\n");
+    else
+        printf("%d collect_inline_funcs test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
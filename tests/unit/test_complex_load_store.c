@@ -6,17 +6,6 @@
 #include "strbuf.h"
 #include "regalloc_x86.h"
 
-const char *fmt_stack(char buf[32], const char *name, int x64, asm_syntax_t syntax) {
-    if (strncmp(name, "stack:", 6) != 0)
-        return name;
-    long off = strtol(name + 6, NULL, 10);
-    if (syntax == ASM_INTEL)
-        snprintf(buf, 32, x64 ? "[rbp-%ld]" : "[ebp-%ld]", off);
-    else
-        snprintf(buf, 32, x64 ? "-%ld(%%rbp)" : "-%ld(%%ebp)", off);
-    return buf;
-}
-
 void *vc_alloc_or_exit(size_t sz) { return malloc(sz); }
 void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
 
@@ -30,6 +19,7 @@ static int check(const char *out, const char *exp, const char *name) {
 
 int main(void) {
     strbuf_t sb;
+    x86_insn_list_t code;
     int fail = 0;
     int locs[2] = {0, -1};
     regalloc_t ra = { .loc = locs };
@@ -46,12 +36,18 @@ int main(void) {
 
     strbuf_init(&sb);
     regalloc_set_asm_syntax(ASM_ATT);
-    emit_load(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_load(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "    movdqu -32(%rbp), %xmm0\n    movdqu %xmm0, -8(%rbp)\n", "cplx load ATT");
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
     regalloc_xmm_reset();
     regalloc_set_asm_syntax(ASM_INTEL);
-    emit_load(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_load(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "    movdqu xmm0, [rbp-32]\n    movdqu [rbp-8], xmm0\n", "cplx load Intel");
     strbuf_free(&sb);
 
@@ -62,12 +58,18 @@ int main(void) {
     strbuf_init(&sb);
     regalloc_xmm_reset();
     regalloc_set_asm_syntax(ASM_ATT);
-    emit_store(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_store(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "    movdqu -8(%rbp), %xmm0\n    movdqu %xmm0, -48(%rbp)\n", "cplx store ATT");
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
     regalloc_xmm_reset();
     regalloc_set_asm_syntax(ASM_INTEL);
-    emit_store(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_store(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "    movdqu xmm0, [rbp-8]\n    movdqu [rbp-48], xmm0\n", "cplx store Intel");
     strbuf_free(&sb);
 
@@ -6,20 +6,18 @@
 #include "regalloc.h"
 
 /* Stubs required by codegen_arith_int.c */
-const char *label_format_suffix(char buf[32], const char *prefix, int id,
-                                const char *suffix) { (void)buf; (void)prefix; (void)id; (void)suffix; return ""; }
-void emit_float_binop(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                      asm_syntax_t syntax) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; }
-void emit_long_float_binop(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra,
-                           int x64, asm_syntax_t syntax) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; }
-void emit_cplx_addsub(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                      asm_syntax_t syntax, const char *op) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; (void)op; }
-void emit_cplx_mul(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                   asm_syntax_t syntax) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; }
-void emit_cplx_div(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-                   asm_syntax_t syntax) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; }
-void emit_cast(strbuf_t *sb, ir_instr_t *ins, regalloc_t *ra, int x64,
-               asm_syntax_t syntax) { (void)sb; (void)ins; (void)ra; (void)x64; (void)syntax; }
+void emit_float_binop(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                      int x64, x86_opcode_t op) { (void)code; (void)ins; (void)ra; (void)x64; (void)op; }
+void emit_long_float_binop(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                           int x64, x86_opcode_t op) { (void)code; (void)ins; (void)ra; (void)x64; (void)op; }
+void emit_cplx_addsub(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                      int x64, x86_opcode_t op) { (void)code; (void)ins; (void)ra; (void)x64; (void)op; }
+void emit_cplx_mul(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                   int x64) { (void)code; (void)ins; (void)ra; (void)x64; }
+void emit_cplx_div(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+                   int x64) { (void)code; (void)ins; (void)ra; (void)x64; }
+void emit_cast(x86_insn_list_t *code, ir_instr_t *ins, regalloc_t *ra,
+               int x64) { (void)code; (void)ins; (void)ra; (void)x64; }
 int label_next_id(void) { return 0; }
 void *vc_alloc_or_exit(size_t sz) { return malloc(sz); }
 void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
@@ -31,6 +29,7 @@ int main(void) {
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins;
     strbuf_t sb;
+    x86_insn_list_t code;
     const char *out;
 
     ins.op = IR_DIV;
@@ -45,7 +44,10 @@ int main(void) {
 
     /* Signed division */
     strbuf_init(&sb);
-    emit_div(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_div(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "idivl %ecx") ||
         !contains(out, "movl %eax, -4(%ebp)")) {
@@ -55,7 +57,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_div(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_div(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "idivl ecx") ||
         !contains(out, "mov [ebp-4], eax")) {
@@ -67,7 +72,10 @@ int main(void) {
     /* Unsigned division */
     ins.type = TYPE_UINT;
     strbuf_init(&sb);
-    emit_div(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_div(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "divl %ecx") ||
         !contains(out, "xorl %edx, %edx") ||
@@ -78,7 +86,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_div(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_div(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "divl ecx") ||
         !contains(out, "xor edx, edx") ||
@@ -93,7 +104,10 @@ int main(void) {
     ins.type = TYPE_INT;
     ra.loc[3] = -1; /* spilled destination */
     strbuf_init(&sb);
-    emit_mod(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_mod(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "idivl %ecx") ||
         !contains(out, "movl %edx, -4(%ebp)")) {
@@ -103,7 +117,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_mod(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_mod(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "idivl ecx") ||
         !contains(out, "mov [ebp-4], edx")) {
@@ -115,7 +132,10 @@ int main(void) {
     /* Unsigned modulus with spilled destination */
     ins.type = TYPE_UINT;
     strbuf_init(&sb);
-    emit_mod(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_mod(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "divl %ecx") ||
         !contains(out, "xorl %edx, %edx") ||
@@ -126,7 +146,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_mod(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_mod(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "divl ecx") ||
         !contains(out, "xor edx, edx") ||
@@ -140,7 +163,10 @@ int main(void) {
     ins.type = TYPE_INT;
     ra.loc[3] = 1;  /* %ebx holds result */
     strbuf_init(&sb);
-    emit_mod(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_mod(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "idivl %ecx") ||
         !contains(out, "movl %edx, %ebx")) {
@@ -150,7 +176,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_mod(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_mod(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "idivl ecx") ||
         !contains(out, "mov ebx, edx")) {
@@ -162,7 +191,10 @@ int main(void) {
     /* Unsigned modulus */
     ins.type = TYPE_UINT;
     strbuf_init(&sb);
-    emit_mod(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_mod(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "divl %ecx") ||
         !contains(out, "xorl %edx, %edx") ||
@@ -173,7 +205,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_mod(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_mod(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     out = sb.data;
     if (!contains(out, "divl ecx") ||
         !contains(out, "xor edx, edx") ||
@@ -30,6 +30,7 @@ static int check(const char *got, const char *expect, const char *msg) {
 int main(void) {
     ir_instr_t ins = {0};
     strbuf_t sb;
+    x86_insn_list_t code;
     regalloc_t ra;
     int locs[3] = {0};
     int fail = 0;
@@ -48,68 +49,116 @@ int main(void) {
     ins.src1 = 0;
 
     ins.imm = ((long long)TYPE_FLOAT << 32) | TYPE_INT;
-    emit_cast(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttss2si %xmm0, %eax", "float->int ATT");
     sb.len = 0; sb.data[0] = '\0';
-    emit_cast(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttss2si eax, xmm0", "float->int Intel");
     sb.len = 0; sb.data[0] = '\0';
 
     ins.imm = ((long long)TYPE_FLOAT << 32) | TYPE_UINT;
-    emit_cast(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttss2si %xmm0, %eax", "float->uint ATT");
     sb.len = 0; sb.data[0] = '\0';
-    emit_cast(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttss2si eax, xmm0", "float->uint Intel");
     sb.len = 0; sb.data[0] = '\0';
 
     ins.imm = ((long long)TYPE_DOUBLE << 32) | TYPE_INT;
-    emit_cast(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttsd2si %xmm0, %eax", "double->int ATT");
     sb.len = 0; sb.data[0] = '\0';
-    emit_cast(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttsd2si eax, xmm0", "double->int Intel");
     sb.len = 0; sb.data[0] = '\0';
 
     ins.imm = ((long long)TYPE_DOUBLE << 32) | TYPE_UINT;
-    emit_cast(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttsd2si %xmm0, %eax", "double->uint ATT");
     sb.len = 0; sb.data[0] = '\0';
-    emit_cast(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttsd2si eax, xmm0", "double->uint Intel");
     sb.len = 0; sb.data[0] = '\0';
 
     /* 64-bit targets */
     regalloc_set_x86_64(1);
     ins.imm = ((long long)TYPE_FLOAT << 32) | TYPE_LLONG;
-    emit_cast(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttss2siq %xmm0, %rax", "float->llong ATT");
     sb.len = 0; sb.data[0] = '\0';
-    emit_cast(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttss2siq rax, xmm0", "float->llong Intel");
     sb.len = 0; sb.data[0] = '\0';
 
     ins.imm = ((long long)TYPE_FLOAT << 32) | TYPE_ULLONG;
-    emit_cast(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttss2siq %xmm0, %rax", "float->ullong ATT");
     sb.len = 0; sb.data[0] = '\0';
-    emit_cast(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttss2siq rax, xmm0", "float->ullong Intel");
     sb.len = 0; sb.data[0] = '\0';
 
     ins.imm = ((long long)TYPE_DOUBLE << 32) | TYPE_LLONG;
-    emit_cast(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttsd2siq %xmm0, %rax", "double->llong ATT");
     sb.len = 0; sb.data[0] = '\0';
-    emit_cast(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttsd2siq rax, xmm0", "double->llong Intel");
     sb.len = 0; sb.data[0] = '\0';
 
     ins.imm = ((long long)TYPE_DOUBLE << 32) | TYPE_ULLONG;
-    emit_cast(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttsd2siq %xmm0, %rax", "double->ullong ATT");
     sb.len = 0; sb.data[0] = '\0';
-    emit_cast(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "cvttsd2siq rax, xmm0", "double->ullong Intel");
 
     strbuf_free(&sb);
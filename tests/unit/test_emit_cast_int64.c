@@ -22,19 +22,26 @@ void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
 int main(void) {
     ir_instr_t ins = {0};
     strbuf_t sb;
+    x86_insn_list_t code;
     int fail = 0;
 
     regalloc_xmm_reset();
     strbuf_init(&sb);
 
     ins.imm = ((long long)TYPE_LLONG << 32) | TYPE_FLOAT;
-    emit_cast(&sb, &ins, NULL, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, NULL, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "cvtsi2ssq")) {
         printf("int64->float ATT failed: %s\n", sb.data);
         fail = 1;
     }
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
-    emit_cast(&sb, &ins, NULL, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, NULL, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "cvtsi2ssq")) {
         printf("int64->float Intel failed: %s\n", sb.data);
         fail = 1;
@@ -42,13 +49,19 @@ int main(void) {
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
 
     ins.imm = ((long long)TYPE_LLONG << 32) | TYPE_DOUBLE;
-    emit_cast(&sb, &ins, NULL, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, NULL, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "cvtsi2sdq")) {
         printf("int64->double ATT failed: %s\n", sb.data);
         fail = 1;
     }
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
-    emit_cast(&sb, &ins, NULL, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, NULL, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "cvtsi2sdq")) {
         printf("int64->double Intel failed: %s\n", sb.data);
         fail = 1;
@@ -56,13 +69,19 @@ int main(void) {
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
 
     ins.imm = ((long long)TYPE_FLOAT << 32) | TYPE_LLONG;
-    emit_cast(&sb, &ins, NULL, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, NULL, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "cvttss2siq")) {
         printf("float->int64 ATT failed: %s\n", sb.data);
         fail = 1;
     }
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
-    emit_cast(&sb, &ins, NULL, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, NULL, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "cvttss2siq")) {
         printf("float->int64 Intel failed: %s\n", sb.data);
         fail = 1;
@@ -70,13 +89,19 @@ int main(void) {
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
 
     ins.imm = ((long long)TYPE_DOUBLE << 32) | TYPE_LLONG;
-    emit_cast(&sb, &ins, NULL, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, NULL, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "cvttsd2siq")) {
         printf("double->int64 ATT failed: %s\n", sb.data);
         fail = 1;
     }
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
-    emit_cast(&sb, &ins, NULL, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cast(&code, &ins, NULL, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "cvttsd2siq")) {
         printf("double->int64 Intel failed: %s\n", sb.data);
         fail = 1;
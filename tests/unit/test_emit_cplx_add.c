@@ -11,6 +11,7 @@ void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
 int main(void) {
     ir_instr_t ins = {0};
     strbuf_t sb;
+    x86_insn_list_t code;
     int fail = 0;
     int locs[4] = {0, -1, -2, -3};
     regalloc_t ra = { .loc = locs };
@@ -25,7 +26,10 @@ int main(void) {
     regalloc_set_x86_64(1);
     regalloc_xmm_reset();
     regalloc_set_asm_syntax(ASM_ATT);
-    emit_cplx_addsub(&sb, &ins, &ra, 1, "add", ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cplx_addsub(&code, &ins, &ra, 1, X86_ADDSD);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     int count = 0;
     for (char *p = sb.data; (p = strstr(p, "addsd %xmm1, %xmm0")); p += 1)
         count++;
@@ -38,7 +42,10 @@ int main(void) {
     /* Intel syntax */
     regalloc_xmm_reset();
     regalloc_set_asm_syntax(ASM_INTEL);
-    emit_cplx_addsub(&sb, &ins, &ra, 1, "add", ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_cplx_addsub(&code, &ins, &ra, 1, X86_ADDSD);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     count = 0;
     for (char *p = sb.data; (p = strstr(p, "addsd xmm0, xmm1")); p += 1)
         count++;
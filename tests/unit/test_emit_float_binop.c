@@ -19,6 +19,7 @@ static int check(const char *s, const char *sub, const char *msg) {
 int main(void) {
     ir_instr_t ins = {0};
     strbuf_t sb;
+    x86_insn_list_t code;
     int locs[4] = {0, -1, -2, -3};
     regalloc_t ra = { .loc = locs };
     int fail = 0;
@@ -33,15 +34,21 @@ int main(void) {
     /* ATT syntax */
     regalloc_xmm_reset();
     regalloc_set_asm_syntax(ASM_ATT);
-    emit_float_binop(&sb, &ins, &ra, 1, "addss", ASM_ATT);
-    fail |= check(sb.data, "addss %xmm0, %xmm1", "ATT op order");
-    fail |= check(sb.data, "movss %xmm1, -24(%rbp)", "ATT dest register");
+    x86_insn_list_init(&code);
+    emit_float_binop(&code, &ins, &ra, 1, X86_ADDSS);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
+    fail |= check(sb.data, "addss %xmm1, %xmm0", "ATT op order");
+    fail |= check(sb.data, "movss %xmm0, -24(%rbp)", "ATT dest register");
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
 
     /* Intel syntax */
     regalloc_xmm_reset();
     regalloc_set_asm_syntax(ASM_INTEL);
-    emit_float_binop(&sb, &ins, &ra, 1, "addss", ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_float_binop(&code, &ins, &ra, 1, X86_ADDSS);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "addss xmm0, xmm1", "Intel op order");
     fail |= check(sb.data, "movss [rbp-24], xmm0", "Intel dest register");
 
@@ -0,0 +1,95 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "file_cache.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static void test_realpath_interned(void)
+{
+    char dir[] = "/tmp/fcdXXXXXX";
+    ASSERT(mkdtemp(dir) != NULL);
+    char path[64], dotted[80];
+    snprintf(path, sizeof(path), "%s/a.h", dir);
+    snprintf(dotted, sizeof(dotted), "%s/./a.h", dir);
+    FILE *f = fopen(path, "w");
+    ASSERT(f != NULL);
+    if (f)
+        fclose(f);
+
+    const char *c1 = file_cache_realpath(path);
+    const char *c2 = file_cache_realpath(dotted);
+    ASSERT(c1 == c2);
+    ASSERT(file_cache_realpath(c1) == c1);
+    ASSERT(file_cache_readable(dotted));
+
+    /* negative answers are remembered as well */
+    char missing[80];
+    snprintf(missing, sizeof(missing), "%s/none.h", dir);
+    ASSERT(!file_cache_readable(missing));
+    ASSERT(strcmp(file_cache_realpath(missing), missing) == 0);
+
+    unlink(path);
+    rmdir(dir);
+    file_cache_cleanup();
+}
+
+static void test_contents(void)
+{
+    char tmpl[] = "/tmp/fccXXXXXX";
+    int fd = mkstemp(tmpl);
+    ASSERT(fd >= 0);
+    if (fd < 0)
+        return;
+    ASSERT(write(fd, "ab\ncd", 5) == 5);
+    close(fd);
+
+    struct stat st;
+    ASSERT(stat(tmpl, &st) == 0);
+    const char *canon = file_cache_realpath(tmpl);
+    char *text, **lines;
+    ASSERT(!file_cache_get_lines(canon, &text, &lines));
+
+    char buf[] = "ab\0cd";
+    char *src_lines[] = { buf, buf + 3, NULL };
+    file_cache_put_lines(canon, buf, sizeof(buf), src_lines, &st);
+    ASSERT(file_cache_get_lines(canon, &text, &lines));
+    ASSERT(text != buf);
+    ASSERT(strcmp(lines[0], "ab") == 0);
+    ASSERT(strcmp(lines[1], "cd") == 0);
+    ASSERT(lines[2] == NULL);
+    free(lines);
+    free(text);
+
+    /* a changed file is not served from the cache */
+    FILE *f = fopen(tmpl, "a");
+    ASSERT(f != NULL);
+    if (f) {
+        fputs("ef\n", f);
+        fclose(f);
+    }
+    ASSERT(!file_cache_get_lines(canon, &text, &lines));
+
+    unlink(tmpl);
+    file_cache_cleanup();
+}
+
+int main(void)
+{
+    test_realpath_interned();
+    test_contents();
+    if (failures == 0)
+        printf("All file_cache tests passed\n");
+    else
+        printf("%d file_cache test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
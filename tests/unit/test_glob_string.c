@@ -18,6 +18,7 @@ int main(void) {
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins;
     strbuf_t sb;
+    x86_insn_list_t code;
 
     ra.loc[1] = 0; /* destination register */
 
@@ -27,7 +28,10 @@ int main(void) {
 
     /* 32-bit emission */
     strbuf_init(&sb);
-    emit_memory_instr(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_memory_instr(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     const char *exp_att = "    movl $s, %eax\n";
     if (strcmp(sb.data, exp_att) != 0) {
         printf("glob_string ATT unexpected: %s\n", sb.data);
@@ -36,7 +40,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_memory_instr(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_memory_instr(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     const char *exp_intel = "    movl eax, OFFSET FLAT:s\n";
     if (strcmp(sb.data, exp_intel) != 0) {
         printf("glob_string Intel unexpected: %s\n", sb.data);
@@ -49,7 +56,10 @@ int main(void) {
 
     strbuf_init(&sb);
     regalloc_set_asm_syntax(ASM_ATT);
-    emit_memory_instr(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_memory_instr(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!contains(sb.data, "movabs")) {
         printf("glob_string x64 ATT missing movabs: %s\n", sb.data);
         return 1;
@@ -58,7 +68,10 @@ int main(void) {
 
     strbuf_init(&sb);
     regalloc_set_asm_syntax(ASM_INTEL);
-    emit_memory_instr(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_memory_instr(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!contains(sb.data, "movabs")) {
         printf("glob_string x64 Intel missing movabs: %s\n", sb.data);
         return 1;
@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static void test_identity(void)
+{
+    char buf[] = "counter";
+    const char *a = intern_str("counter");
+    const char *b = intern_text("counter + 1", 7);
+    const char *c = intern_str(buf);
+    ASSERT(a == b);
+    ASSERT(a == c);
+    ASSERT(a != buf);
+    ASSERT(strcmp(a, "counter") == 0);
+
+    /* prefixes and the empty string are distinct entries */
+    ASSERT(intern_str("count") != a);
+    ASSERT(intern_str("") == intern_text("x", 0));
+
+    ASSERT(intern_find("counter") == a);
+    ASSERT(intern_find("never_interned") == NULL);
+    intern_cleanup();
+    ASSERT(intern_find("counter") == NULL);
+}
+
+static void test_growth(void)
+{
+    /* enough names to resize the set and fill several arena blocks */
+    enum { N = 20000 };
+    const char **names = malloc(N * sizeof(*names));
+    char buf[32];
+    ASSERT(names != NULL);
+    if (!names)
+        return;
+    for (int i = 0; i < N; i++) {
+        snprintf(buf, sizeof(buf), "name_%d", i);
+        names[i] = intern_str(buf);
+    }
+    for (int i = 0; i < N; i++) {
+        snprintf(buf, sizeof(buf), "name_%d", i);
+        ASSERT(intern_find(buf) == names[i]);
+        ASSERT(strcmp(names[i], buf) == 0);
+    }
+    /* a string longer than one arena block still interns */
+    size_t len = 100000;
+    char *big = malloc(len + 1);
+    ASSERT(big != NULL);
+    if (big) {
+        memset(big, 'x', len);
+        big[len] = '\0';
+        const char *p = intern_str(big);
+        ASSERT(strlen(p) == len);
+        ASSERT(intern_text(big, len) == p);
+        free(big);
+    }
+    free(names);
+    intern_cleanup();
+}
+
+int main(void)
+{
+    test_identity();
+    test_growth();
+    if (failures == 0)
+        printf("All intern tests passed\n");
+    else
+        printf("%d intern test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
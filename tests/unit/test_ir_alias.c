@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_const.h"
+#include "ir_memory.h"
+#include "ir_alias.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+/* the instruction defining VALUE */
+static ir_instr_t *def_of(ir_builder_t *ir, ir_value_t value)
+{
+    for (ir_instr_t *i = ir->head; i; i = i->next)
+        if (i->dest == value.id)
+            return i;
+    return NULL;
+}
+
+/* pointers to different locals never meet, unknown ones miss private locals */
+static void test_points_to(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_instr_t *begin = ir_build_func_begin(&ir, "f");
+    ir_value_t pa = ir_build_addr(&ir, "stack:4");
+    ir_value_t pb = ir_build_addr(&ir, "stack:8");
+    ir_value_t pa1 = ir_build_ptr_add(&ir, pa, ir_build_const(&ir, 1), 4);
+    ir_build_store_ptr(&ir, pa1, ir_build_const(&ir, 1));
+    ir_instr_t *sa = ir.tail;
+    ir_instr_t *lb = def_of(&ir, ir_build_load_ptr(&ir, pb));
+    ir_instr_t *na = def_of(&ir, ir_build_load(&ir, "stack:4", TYPE_INT));
+    ir_instr_t *nb = def_of(&ir, ir_build_load(&ir, "stack:8", TYPE_INT));
+    ir_instr_t *g = def_of(&ir, ir_build_load(&ir, "G", TYPE_INT));
+    ir_value_t p = ir_build_load_param(&ir, 0, TYPE_PTR);
+    ir_build_store_ptr(&ir, p, ir_build_const(&ir, 2));
+    ir_instr_t *sp = ir.tail;
+    ir_build_return(&ir, ir_build_const(&ir, 0), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    ir_alias_t aa;
+    ASSERT(ir_alias_init(&aa, begin));
+    ASSERT(!ir_may_alias(&aa, sa, lb));
+    ASSERT(ir_may_alias(&aa, sa, na));
+    ASSERT(!ir_may_alias(&aa, sa, nb));
+    ASSERT(!ir_may_alias(&aa, sa, g));
+    ASSERT(!ir_may_alias(&aa, sp, na));
+    ASSERT(!ir_may_alias(&aa, sp, lb));
+    ASSERT(ir_may_alias(&aa, sp, g));
+    ASSERT(!ir_call_may_access(&aa, na));
+    ASSERT(ir_call_may_access(&aa, g));
+    ir_alias_free(&aa);
+    ir_builder_free(&ir);
+}
+
+/* a local passed to a call or stored in a global is reachable from anywhere */
+static void test_escape(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_instr_t *begin = ir_build_func_begin(&ir, "f");
+    ir_value_t pa = ir_build_addr(&ir, "stack:4");
+    ir_build_store(&ir, "stack:12", TYPE_PTR, pa);
+    ir_value_t held = ir_build_load(&ir, "stack:12", TYPE_PTR);
+    ir_build_arg(&ir, held, TYPE_PTR);
+    ir_build_call(&ir, "g", 1);
+    ir_value_t pb = ir_build_addr(&ir, "stack:8");
+    ir_build_store(&ir, "G", TYPE_PTR, pb);
+    ir_value_t pc = ir_build_addr(&ir, "stack:16");
+    ir_instr_t *na = def_of(&ir, ir_build_load(&ir, "stack:4", TYPE_INT));
+    ir_instr_t *nb = def_of(&ir, ir_build_load(&ir, "stack:8", TYPE_INT));
+    ir_instr_t *nc = def_of(&ir, ir_build_load(&ir, "stack:16", TYPE_INT));
+    ir_instr_t *lc = def_of(&ir, ir_build_load_ptr(&ir, pc));
+    ir_value_t p = ir_build_load_param(&ir, 0, TYPE_PTR);
+    ir_build_store_ptr(&ir, p, ir_build_const(&ir, 2));
+    ir_instr_t *sp = ir.tail;
+    ir_build_return(&ir, ir_build_const(&ir, 0), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    ir_alias_t aa;
+    ASSERT(ir_alias_init(&aa, begin));
+    ASSERT(ir_may_alias(&aa, sp, na));
+    ASSERT(ir_may_alias(&aa, sp, nb));
+    ASSERT(!ir_may_alias(&aa, sp, nc));
+    ASSERT(!ir_may_alias(&aa, sp, lc));
+    ASSERT(ir_call_may_access(&aa, na));
+    ASSERT(ir_call_may_access(&aa, nb));
+    ASSERT(!ir_call_may_access(&aa, lc));
+    ir_alias_free(&aa);
+    ir_builder_free(&ir);
+}
+
+/*
+ * Restrict separates accesses based on different parameters until one
+ * of the parameters is assigned.
+ */
+static void test_restrict(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_instr_t *begin = ir_build_func_begin(&ir, "f");
+    ir_value_t p = ir_build_load_param(&ir, 0, TYPE_PTR);
+    ir_value_t q = ir_build_load_param(&ir, 1, TYPE_PTR);
+    ir_value_t r = ir_build_load_param(&ir, 2, TYPE_PTR);
+    ir_value_t q4 = ir_build_ptr_add(&ir, q, ir_build_const(&ir, 1), 4);
+    ir_build_store_ptr_res(&ir, p, ir_build_const(&ir, 1));
+    ir_instr_t *sp = ir.tail;
+    ir_instr_t *lq = def_of(&ir, ir_build_load_ptr(&ir, q4));
+    ir_instr_t *lp = def_of(&ir, ir_build_load_ptr(&ir, p));
+    ir_instr_t *lr = def_of(&ir, ir_build_load_ptr_res(&ir, r));
+    ir_build_store_param(&ir, 2, TYPE_PTR, q);
+    ir_build_return(&ir, ir_build_const(&ir, 0), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    ir_alias_t aa;
+    ASSERT(ir_alias_init(&aa, begin));
+    ASSERT(!ir_may_alias(&aa, sp, lq));
+    ASSERT(ir_may_alias(&aa, sp, lp));
+    ASSERT(ir_may_alias(&aa, sp, lr));
+    ASSERT(ir_may_alias(&aa, lq, lr));
+    ir_alias_free(&aa);
+    ir_builder_free(&ir);
+}
+
+/* accesses through pointers with incompatible types do not overlap */
+static void test_types(void)
+{
+    ASSERT(ir_types_may_alias(TYPE_INT, TYPE_UINT));
+    ASSERT(ir_types_may_alias(TYPE_INT, TYPE_ENUM));
+    ASSERT(ir_types_may_alias(TYPE_UCHAR, TYPE_DOUBLE));
+    ASSERT(ir_types_may_alias(TYPE_UNKNOWN, TYPE_FLOAT));
+    ASSERT(!ir_types_may_alias(TYPE_INT, TYPE_FLOAT));
+    ASSERT(!ir_types_may_alias(TYPE_LONG, TYPE_INT));
+    ASSERT(!ir_types_may_alias(TYPE_PTR, TYPE_DOUBLE));
+
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_instr_t *begin = ir_build_func_begin(&ir, "f");
+    ir_value_t p = ir_build_load_param(&ir, 0, TYPE_PTR);
+    ir_value_t q = ir_build_load_param(&ir, 1, TYPE_PTR);
+    ir_build_store_ptr(&ir, p, ir_build_const(&ir, 1));
+    ir_instr_t *sp = ir.tail;
+    ir_instr_t *lq = def_of(&ir, ir_build_load_ptr(&ir, q));
+    ir_instr_t *g = def_of(&ir, ir_build_load(&ir, "G", TYPE_DOUBLE));
+    ir_build_return(&ir, ir_build_const(&ir, 0), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    ir_alias_t aa;
+    ASSERT(ir_alias_init(&aa, begin));
+    ASSERT(ir_may_alias(&aa, sp, lq));
+    sp->type = TYPE_INT;
+    lq->type = TYPE_FLOAT;
+    ASSERT(!ir_may_alias(&aa, sp, lq));
+    ASSERT(!ir_may_alias(&aa, sp, g));
+    lq->type = TYPE_UINT;
+    ASSERT(ir_may_alias(&aa, sp, lq));
+    ir_alias_free(&aa);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_points_to();
+    test_escape();
+    test_restrict();
+    test_types();
+    if (failures == 0)
+        printf("All ir_alias tests passed\n");
+    else
+        printf("%d ir_alias test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
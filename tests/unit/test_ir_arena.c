@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static void test_many_instrs(void)
+{
+    ir_builder_t b;
+    ir_builder_init(&b);
+    /* enough instructions to span several chunks */
+    for (int i = 0; i < 50000; i++)
+        ir_build_const(&b, i);
+    long long expect = 0;
+    int ok = 1;
+    for (ir_instr_t *ins = b.head; ins; ins = ins->next)
+        if (ins->op != IR_CONST || ins->imm != expect++)
+            ok = 0;
+    ASSERT(ok);
+    ASSERT(expect == 50000);
+    ir_builder_free(&b);
+    ASSERT(b.head == NULL && b.tail == NULL);
+    ASSERT(b.arena.chunks == NULL);
+}
+
+static void test_reuse_removed(void)
+{
+    ir_builder_t b;
+    ir_builder_init(&b);
+    ir_build_const(&b, 1);
+    ir_build_const(&b, 2);
+    ir_instr_t *second = b.tail;
+    remove_instr(&b, second);
+    ASSERT(b.tail == b.head);
+    ir_instr_t *ins = append_instr(&b);
+    ASSERT(ins == second);
+    ASSERT(ins->data == NULL && ins->name == NULL && ins->next == NULL);
+    ASSERT(ins->dest == -1);
+    ir_builder_free(&b);
+}
+
+static void test_payloads(void)
+{
+    ir_builder_t b;
+    ir_builder_init(&b);
+    ir_build_string(&b, "hello", 5);
+    ASSERT(b.tail && strcmp(b.tail->data, "hello") == 0);
+
+    /* larger than any regular chunk */
+    size_t big = 1u << 20;
+    char *p = ir_arena_alloc(&b, big);
+    ASSERT(p != NULL);
+    if (p) {
+        memset(p, 0xab, big);
+        ASSERT(((uintptr_t)p % sizeof(long double)) == 0);
+    }
+    /* the regular chunk is still used after the oversized one */
+    char *s = ir_arena_strdup(&b, "x");
+    ASSERT(s && strcmp(s, "x") == 0);
+    ASSERT(s && (uintptr_t)s % sizeof(long long) == 0);
+    ASSERT(strcmp(b.tail->data, "hello") == 0);
+    ir_builder_free(&b);
+}
+
+int main(void)
+{
+    test_many_instrs();
+    test_reuse_removed();
+    test_payloads();
+    if (failures == 0)
+        printf("All ir_arena tests passed\n");
+    else
+        printf("%d ir_arena test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_const.h"
+#include "ir_memory.h"
+#include "ir_cfg.h"
+#include "intern.h"
+#include "opt.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static int has_edge(const ir_block_t *from, const ir_block_t *to)
+{
+    int succ = 0, pred = 0;
+    for (size_t i = 0; i < from->succ_count; i++)
+        if (from->succs[i] == to->id)
+            succ = 1;
+    for (size_t i = 0; i < to->pred_count; i++)
+        if (to->preds[i] == from->id)
+            pred = 1;
+    return succ && pred;
+}
+
+/* if/else diamond followed by code after a return */
+static void test_diamond(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t c = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_build_bcond(&ir, c, "Lelse");
+    ir_build_const(&ir, 1);
+    ir_build_br(&ir, "Ljoin");
+    ir_build_label(&ir, "Lelse");
+    ir_build_const(&ir, 2);
+    ir_build_label(&ir, "Ljoin");
+    ir_value_t r = ir_build_const(&ir, 3);
+    ir_build_return(&ir, r, TYPE_INT);
+    ir_build_const(&ir, 4);
+    ir_build_func_end(&ir);
+
+    ir_cfg_t cfg;
+    ASSERT(ir_cfg_build(&ir, &cfg));
+    ASSERT(cfg.func_count == 1);
+    ir_function_t *fn = &cfg.funcs[0];
+    ASSERT(fn->name == intern_str("f"));
+    ASSERT(fn->end == ir.tail);
+    ASSERT(fn->block_count == 5);
+    if (fn->block_count == 5) {
+        ir_block_t *b = fn->blocks;
+        ASSERT(b[0].first->op == IR_LOAD_PARAM && b[0].last->op == IR_BCOND);
+        ASSERT(b[0].prev == fn->begin);
+        ASSERT(b[1].label == NULL && b[1].last->op == IR_BR);
+        ASSERT(b[2].label == intern_str("Lelse"));
+        ASSERT(ir_cfg_label_block(fn, intern_str("Ljoin")) == &b[3]);
+        ASSERT(ir_cfg_label_block(fn, intern_str("Lnone")) == NULL);
+        ASSERT(b[0].succ_count == 2);
+        ASSERT(has_edge(&b[0], &b[2]) && has_edge(&b[0], &b[1]));
+        ASSERT(has_edge(&b[1], &b[3]) && has_edge(&b[2], &b[3]));
+        ASSERT(b[3].pred_count == 2 && b[3].succ_count == 0);
+        ASSERT(b[4].pred_count == 0 && b[4].first->op == IR_CONST);
+    }
+    ir_cfg_free(&cfg);
+    ir_builder_free(&ir);
+}
+
+/* rebuilding a dirty function picks up edits to the list */
+static void test_refresh(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "g");
+    ir_build_label(&ir, "L1");
+    ir_build_br(&ir, "L1");
+    ir_build_func_end(&ir);
+    ir_build_func_begin(&ir, "h");
+    ir_build_func_end(&ir);
+
+    ir_cfg_t cfg;
+    ASSERT(ir_cfg_build(&ir, &cfg));
+    ASSERT(cfg.func_count == 2);
+    ir_function_t *fn = &cfg.funcs[0];
+    ASSERT(fn->block_count == 1);
+    ASSERT(fn->blocks[0].pred_count == 1 && fn->blocks[0].preds[0] == 0);
+    ASSERT(cfg.funcs[1].block_count == 0);
+
+    ir_instr_t *ins = ir_insert_after(&ir, fn->blocks[0].last);
+    ins->op = IR_LABEL;
+    ins->name = intern_str("L2");
+    ir_cfg_invalidate(&cfg);
+    ASSERT(ir_cfg_refresh(&cfg));
+    ASSERT(fn->block_count == 2 && !fn->dirty);
+    ASSERT(ir_cfg_label_block(fn, intern_str("L2")) == &fn->blocks[1]);
+    ir_cfg_free(&cfg);
+    ir_builder_free(&ir);
+}
+
+/* hoisted instructions keep their order in the preheader */
+static void test_licm_order(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "k");
+    ir_value_t c = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_build_label(&ir, "L1");
+    ir_build_bcond(&ir, c, "L2");
+    ir_value_t one = ir_build_const(&ir, 1);
+    ir_build_binop(&ir, IR_ADD, one, one, TYPE_INT);
+    ir_build_br(&ir, "L1");
+    ir_build_label(&ir, "L2");
+    ir_build_return(&ir, c, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    ir_cfg_t cfg;
+    ASSERT(ir_cfg_build(&ir, &cfg));
+    opt_config_t o1 = {1, 1, 1, 1, 1, 0, 0};
+    opt_licm(&ir, &cfg, &o1);
+    ir_instr_t *i = ir.head->next->next;
+    ASSERT(i && i->op == IR_CONST);
+    ASSERT(i && i->next && i->next->op == IR_ADD);
+    ASSERT(i && i->next && i->next->next->op == IR_LABEL);
+    ASSERT(cfg.funcs[0].blocks[0].last == i->next);
+    ir_cfg_free(&cfg);
+    ir_builder_free(&ir);
+}
+
+/* nested loops are found inner first and know their enclosing loop */
+static void test_loops(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "n");
+    ir_value_t c = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_build_label(&ir, "L1");
+    ir_build_bcond(&ir, c, "L4");
+    ir_build_label(&ir, "L2");
+    ir_build_bcond(&ir, c, "L3");
+    ir_build_br(&ir, "L2");
+    ir_build_label(&ir, "L3");
+    ir_build_br(&ir, "L1");
+    ir_build_label(&ir, "L4");
+    ir_build_return(&ir, c, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    ir_cfg_t cfg;
+    ASSERT(ir_cfg_build(&ir, &cfg));
+    ir_function_t *fn = &cfg.funcs[0];
+    ASSERT(fn->block_count == 6);
+    ASSERT(ir_cfg_loops(fn));
+    ASSERT(fn->loop_count == 2);
+    if (fn->loop_count == 2) {
+        const ir_loop_t *in = &fn->loops[0];
+        const ir_loop_t *out = &fn->loops[1];
+        ASSERT(in->header == 2 && in->block_count == 2);
+        ASSERT(in->parent == 1 && in->depth == 2 && in->latch_count == 1);
+        ASSERT(out->header == 1 && out->block_count == 4);
+        ASSERT(out->parent == IR_CFG_NO_BLOCK && out->depth == 1);
+        ASSERT(out->blocks[0] == 1);
+        ASSERT(fn->loop_of[3] == 0 && fn->loop_of[4] == 1);
+        ASSERT(fn->loop_of[0] == IR_CFG_NO_BLOCK);
+        ASSERT(ir_cfg_loop_contains(fn, 1, 3));
+        ASSERT(!ir_cfg_loop_contains(fn, 0, 4));
+        ASSERT(!ir_cfg_loop_contains(fn, 1, 5));
+    }
+    ir_cfg_free(&cfg);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_diamond();
+    test_refresh();
+    test_licm_order();
+    test_loops();
+    if (failures == 0)
+        printf("All ir_cfg tests passed\n");
+    else
+        printf("%d ir_cfg test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
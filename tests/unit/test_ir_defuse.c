@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_defuse.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static int used_by(ir_defuse_t *du, int value, ir_instr_t *ins)
+{
+    for (int u = ir_defuse_first_use(du, value); u >= 0; u = du->uses[u].next)
+        if (du->uses[u].ins == ins)
+            return 1;
+    return 0;
+}
+
+/* the builder keeps the index current while emitting and removing */
+static void test_builder_updates(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_defuse_t du;
+    ASSERT(ir_defuse_init(&du, &ir));
+    ASSERT(ir.defuse == &du);
+
+    ir_build_func_begin(&ir, "f");
+    ir_value_t a = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_value_t b = ir_build_const(&ir, 2);
+    ir_value_t m = ir_build_binop(&ir, IR_MUL, a, a, TYPE_INT);
+    ir_value_t s = ir_build_binop(&ir, IR_ADD, m, b, TYPE_INT);
+    ir_build_return(&ir, s, TYPE_INT);
+    ir_instr_t *ret = ir.tail;
+
+    ASSERT(ir_defuse_use_count(&du, a.id) == 2);
+    ASSERT(ir_defuse_use_count(&du, s.id) == 1);
+    ASSERT(used_by(&du, s.id, ret));
+    ir_instr_t *add = ir_defuse_def(&du, s.id);
+    ASSERT(add && add->op == IR_ADD);
+
+    /* dropping the add withdraws its operands */
+    remove_instr(&ir, add);
+    ASSERT(ir_defuse_def(&du, s.id) == NULL);
+    ASSERT(ir_defuse_use_count(&du, m.id) == 0);
+    ASSERT(ir_defuse_use_count(&du, b.id) == 0);
+
+    ASSERT(ir_defuse_set_src(&du, ret, 1, m.id));
+    ASSERT(ret->src1 == m.id);
+    ASSERT(ir_defuse_use_count(&du, s.id) == 0);
+    ASSERT(ir_defuse_use_count(&du, m.id) == 1);
+
+    ir_defuse_free(&du);
+    ASSERT(ir.defuse == NULL);
+    ir_builder_free(&ir);
+}
+
+/* RAUW rewrites every operand and phi argument and moves the uses */
+static void test_replace_all_uses(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "g");
+    ir_value_t a = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_value_t b = ir_build_load_param(&ir, 1, TYPE_INT);
+    ir_value_t x = ir_build_binop(&ir, IR_SUB, a, a, TYPE_INT);
+    ir_value_t y = ir_build_binop(&ir, IR_ADD, x, b, TYPE_INT);
+    ir_instr_t *phi = ir_insert_phi(&ir, ir.tail, TYPE_INT, 2);
+    ir_phi_add_arg(phi, a.id, NULL);
+    ir_phi_add_arg(phi, y.id, NULL);
+    ir_build_return(&ir, y, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    /* indexing an existing list sees the phi arguments */
+    ir_defuse_t du;
+    ASSERT(ir_defuse_init(&du, &ir));
+    ASSERT(ir_defuse_use_count(&du, a.id) == 3);
+    ASSERT(ir_defuse_use_count(&du, b.id) == 1);
+
+    ASSERT(ir_replace_all_uses(&du, a.id, b.id));
+    ASSERT(ir_defuse_use_count(&du, a.id) == 0);
+    ASSERT(ir_defuse_use_count(&du, b.id) == 4);
+    ir_instr_t *sub = ir_defuse_def(&du, x.id);
+    ASSERT(sub && sub->src1 == b.id && sub->src2 == b.id);
+    ASSERT(ir_phi_args(phi)[0].value == b.id);
+    ASSERT(ir_phi_args(phi)[1].value == y.id);
+
+    ir_defuse_free(&du);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_builder_updates();
+    test_replace_all_uses();
+    if (failures == 0)
+        printf("All ir_defuse tests passed\n");
+    else
+        printf("%d ir_defuse test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
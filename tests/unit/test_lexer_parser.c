@@ -77,6 +77,32 @@ static void test_lexer_comments(void)
     lexer_free_tokens(toks, count);
 }
 
+/* Feeding line-aligned chunks yields the same tokens as one pass. */
+static void test_lexer_stream_chunks(void)
+{
+    const char *src = "int a;\n# 7 \"x.h\"\nlong b = 1 + 2;\n";
+    size_t count = 0;
+    token_t *whole = lexer_tokenize(src, &count);
+
+    lexer_stream_t ls;
+    lexer_stream_init(&ls);
+    ASSERT(lexer_stream_feed(&ls, "int a;\n"));
+    ASSERT(lexer_stream_feed(&ls, "# 7 \"x.h\"\n"));
+    ASSERT(lexer_stream_feed(&ls, "long b = 1 + 2;\n"));
+    size_t scount = 0;
+    token_t *toks = lexer_stream_finish(&ls, &scount);
+    ASSERT(scount == count);
+    for (size_t i = 0; i < count && i < scount; i++) {
+        ASSERT(toks[i].type == whole[i].type);
+        ASSERT(strcmp(toks[i].lexeme, whole[i].lexeme) == 0);
+        ASSERT(toks[i].line == whole[i].line);
+        ASSERT(toks[i].column == whole[i].column);
+    }
+    ASSERT(toks[3].line == 7);
+    lexer_free_tokens(toks, scount);
+    lexer_free_tokens(whole, count);
+}
+
 /* Tokenise the percent operator. */
 static void test_lexer_percent(void)
 {
@@ -87,6 +113,48 @@ static void test_lexer_percent(void)
     lexer_free_tokens(toks, count);
 }
 
+/* Punctuators are matched greedily, longest first. */
+static void test_lexer_punctuators(void)
+{
+    const char *src = "... .. <<= >>= << >> <= >= -> -- -= ++ += && &= "
+                      "|| |= == != *= /= %= ^= ! = < > - + & | * / % ^";
+    static const token_type_t expect[] = {
+        TOK_ELLIPSIS, TOK_DOT, TOK_DOT, TOK_SHLEQ, TOK_SHREQ, TOK_SHL,
+        TOK_SHR, TOK_LE, TOK_GE, TOK_ARROW, TOK_DEC, TOK_MINUSEQ, TOK_INC,
+        TOK_PLUSEQ, TOK_LOGAND, TOK_AMPEQ, TOK_LOGOR, TOK_PIPEEQ, TOK_EQ,
+        TOK_NEQ, TOK_STAREQ, TOK_SLASHEQ, TOK_PERCENTEQ, TOK_CARETEQ,
+        TOK_NOT, TOK_ASSIGN, TOK_LT, TOK_GT, TOK_MINUS, TOK_PLUS, TOK_AMP,
+        TOK_PIPE, TOK_STAR, TOK_SLASH, TOK_PERCENT, TOK_CARET, TOK_EOF
+    };
+    size_t n = sizeof(expect) / sizeof(expect[0]);
+    size_t count = 0;
+    token_t *toks = lexer_tokenize(src, &count);
+    ASSERT(count == n);
+    for (size_t i = 0; i < n && i < count; i++)
+        ASSERT(toks[i].type == expect[i]);
+    ASSERT(strcmp(toks[3].lexeme, "<<=") == 0);
+    lexer_free_tokens(toks, count);
+}
+
+/* Keywords are recognised exactly; near misses stay identifiers. */
+static void test_lexer_keywords(void)
+{
+    const char *src = "_Static_assert _Noreturn return iff i_ ret double_ "
+                      "_Bool bool _Complex _Alignof alignas";
+    static const token_type_t expect[] = {
+        TOK_KW_STATIC_ASSERT, TOK_KW_NORETURN, TOK_KW_RETURN, TOK_IDENT,
+        TOK_IDENT, TOK_IDENT, TOK_IDENT, TOK_KW_BOOL, TOK_KW_BOOL,
+        TOK_KW_COMPLEX, TOK_KW_ALIGNOF, TOK_KW_ALIGNAS, TOK_EOF
+    };
+    size_t n = sizeof(expect) / sizeof(expect[0]);
+    size_t count = 0;
+    token_t *toks = lexer_tokenize(src, &count);
+    ASSERT(count == n);
+    for (size_t i = 0; i < n && i < count; i++)
+        ASSERT(toks[i].type == expect[i]);
+    lexer_free_tokens(toks, count);
+}
+
 /* Lexer support for new type keywords such as short, long and bool. */
 static void test_lexer_new_types(void)
 {
@@ -798,7 +866,10 @@ int main(void)
 {
     test_lexer_basic();
     test_lexer_comments();
+    test_lexer_stream_chunks();
     test_lexer_percent();
+    test_lexer_punctuators();
+    test_lexer_keywords();
     test_lexer_new_types();
     test_lexer_complex_kw();
     test_lexer_imag_number();
@@ -6,12 +6,6 @@
 #include "regalloc.h"
 
 /* Provide minimal stubs to satisfy linker requirements. */
-const char *fmt_stack(char buf[32], const char *name, int x64,
-                      asm_syntax_t syntax) {
-    (void)buf; (void)x64; (void)syntax;
-    return name;
-}
-
 void *vc_alloc_or_exit(size_t sz) { return malloc(sz); }
 void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
 
@@ -20,6 +14,7 @@ int main(void) {
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins;
     strbuf_t sb;
+    x86_insn_list_t code;
 
     ra.loc[1] = -1; /* pointer in stack slot */
     ra.loc[2] = 1;  /* destination register %ebx */
@@ -29,7 +24,10 @@ int main(void) {
     ins.type = TYPE_INT;
 
     strbuf_init(&sb);
-    emit_load_ptr(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_load_ptr(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     const char *exp_att = "    movl -4(%ebp), %eax\n    movl (%eax), %ebx\n";
     if (strcmp(sb.data, exp_att) != 0) {
         printf("load ATT unexpected: %s\n", sb.data);
@@ -38,7 +36,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_load_ptr(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_load_ptr(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     const char *exp_intel = "    movl eax, [ebp-4]\n    movl ebx, [eax]\n";
     if (strcmp(sb.data, exp_intel) != 0) {
         printf("load Intel unexpected: %s\n", sb.data);
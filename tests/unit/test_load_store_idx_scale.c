@@ -6,16 +6,6 @@
 #include "regalloc.h"
 
 /* Provide minimal stubs required by codegen helpers. */
-const char *fmt_stack(char buf[32], const char *name, int x64,
-                      asm_syntax_t syntax) {
-    (void)x64;
-    if (syntax == ASM_INTEL) {
-        snprintf(buf, 32, "[%s]", name);
-        return buf;
-    }
-    return name;
-}
-
 void *vc_alloc_or_exit(size_t sz) { return malloc(sz); }
 void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
 
@@ -24,6 +14,7 @@ int main(void) {
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins;
     strbuf_t sb;
+    x86_insn_list_t code;
 
     ra.loc[1] = 0; /* index register */
     ra.loc[2] = 1; /* dest/value register */
@@ -36,7 +27,10 @@ int main(void) {
 
     /* 32-bit load */
     strbuf_init(&sb);
-    emit_load_idx(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_load_idx(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "base(,") || !strstr(sb.data, ",4)")) {
         printf("load idx 32 ATT failed: %s\n", sb.data);
         return 1;
@@ -44,7 +38,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_load_idx(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_load_idx(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!(strstr(sb.data, "[base+") && strstr(sb.data, "*4]") && !strstr(sb.data, "[[base"))) {
         printf("load idx 32 Intel failed: %s\n", sb.data);
         return 1;
@@ -55,7 +52,10 @@ int main(void) {
     ins.op = IR_STORE_IDX;
     ins.src2 = 2;
     strbuf_init(&sb);
-    emit_store_idx(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_store_idx(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "base(,") || !strstr(sb.data, ",4)")) {
         printf("store idx 32 ATT failed: %s\n", sb.data);
         return 1;
@@ -63,7 +63,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_store_idx(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_store_idx(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!(strstr(sb.data, "[base+") && strstr(sb.data, "*4]") && !strstr(sb.data, "[[base"))) {
         printf("store idx 32 Intel failed: %s\n", sb.data);
         return 1;
@@ -73,7 +76,10 @@ int main(void) {
     /* 64-bit load */
     ins.imm = 8;
     strbuf_init(&sb);
-    emit_load_idx(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_load_idx(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "base(,") || !strstr(sb.data, ",8)")) {
         printf("load idx 64 ATT failed: %s\n", sb.data);
         return 1;
@@ -81,7 +87,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_load_idx(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_load_idx(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!(strstr(sb.data, "[base+") && strstr(sb.data, "*8]") && !strstr(sb.data, "[[base"))) {
         printf("load idx 64 Intel failed: %s\n", sb.data);
         return 1;
@@ -90,7 +99,10 @@ int main(void) {
 
     /* 64-bit store */
     strbuf_init(&sb);
-    emit_store_idx(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_store_idx(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "base(,") || !strstr(sb.data, ",8)")) {
         printf("store idx 64 ATT failed: %s\n", sb.data);
         return 1;
@@ -98,7 +110,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_store_idx(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_store_idx(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!(strstr(sb.data, "[base+") && strstr(sb.data, "*8]") && !strstr(sb.data, "[[base"))) {
         printf("store idx 64 Intel failed: %s\n", sb.data);
         return 1;
@@ -118,7 +133,10 @@ int main(void) {
         /* load */
         ins.op = IR_LOAD_IDX;
         strbuf_init(&sb);
-        emit_load_idx(&sb, &ins, &ra, 1, ASM_ATT);
+        x86_insn_list_init(&code);
+        emit_load_idx(&code, &ins, &ra, 1);
+        x86_insn_list_print(&sb, &code, ASM_ATT);
+        x86_insn_list_free(&code);
         if (!strstr(sb.data, expect_att)) {
             printf("load idx %s failed: %s\n", names[i], sb.data);
             return 1;
@@ -126,7 +144,10 @@ int main(void) {
         strbuf_free(&sb);
 
         strbuf_init(&sb);
-        emit_load_idx(&sb, &ins, &ra, 1, ASM_INTEL);
+        x86_insn_list_init(&code);
+        emit_load_idx(&code, &ins, &ra, 1);
+        x86_insn_list_print(&sb, &code, ASM_INTEL);
+        x86_insn_list_free(&code);
         if (!strstr(sb.data, "[base+") ||
             (sizes[i] != 1 && !strstr(sb.data, expect_intel)) ||
             (sizes[i] == 1 && strstr(sb.data, "*"))) {
@@ -139,7 +160,10 @@ int main(void) {
         ins.op = IR_STORE_IDX;
         ins.src2 = 2;
         strbuf_init(&sb);
-        emit_store_idx(&sb, &ins, &ra, 1, ASM_ATT);
+        x86_insn_list_init(&code);
+        emit_store_idx(&code, &ins, &ra, 1);
+        x86_insn_list_print(&sb, &code, ASM_ATT);
+        x86_insn_list_free(&code);
         if (!strstr(sb.data, expect_att)) {
             printf("store idx %s failed: %s\n", names[i], sb.data);
             return 1;
@@ -147,7 +171,10 @@ int main(void) {
         strbuf_free(&sb);
 
         strbuf_init(&sb);
-        emit_store_idx(&sb, &ins, &ra, 1, ASM_INTEL);
+        x86_insn_list_init(&code);
+        emit_store_idx(&code, &ins, &ra, 1);
+        x86_insn_list_print(&sb, &code, ASM_INTEL);
+        x86_insn_list_free(&code);
         if (!strstr(sb.data, "[base+") ||
             (sizes[i] != 1 && !strstr(sb.data, expect_intel)) ||
             (sizes[i] == 1 && strstr(sb.data, "*"))) {
@@ -163,7 +190,10 @@ int main(void) {
     /* load */
     ins.op = IR_LOAD_IDX;
     strbuf_init(&sb);
-    emit_load_idx(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_load_idx(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "imulq") || !strstr(sb.data, "$3") ||
         !strstr(sb.data, ",1)") || strstr(sb.data, ",3)")) {
         printf("load idx manual ATT failed: %s\n", sb.data);
@@ -172,7 +202,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_load_idx(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_load_idx(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "imulq") || !strstr(sb.data, ", 3") ||
         !strstr(sb.data, "[base+") || strstr(sb.data, "*3") ||
         strstr(sb.data, "[[base")) {
@@ -185,7 +218,10 @@ int main(void) {
     ins.op = IR_STORE_IDX;
     ins.src2 = 2;
     strbuf_init(&sb);
-    emit_store_idx(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_store_idx(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "imulq") || !strstr(sb.data, "$3") ||
         !strstr(sb.data, ",1)") || strstr(sb.data, ",3)")) {
         printf("store idx manual ATT failed: %s\n", sb.data);
@@ -194,7 +230,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_store_idx(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_store_idx(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (!strstr(sb.data, "imulq") || !strstr(sb.data, ", 3") ||
         !strstr(sb.data, "[base+") || strstr(sb.data, "*3") ||
         strstr(sb.data, "[[base")) {
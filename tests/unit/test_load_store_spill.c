@@ -6,12 +6,6 @@
 #include "regalloc.h"
 
 /* Provide minimal stubs to satisfy linker requirements. */
-const char *fmt_stack(char buf[32], const char *name, int x64,
-                      asm_syntax_t syntax) {
-    (void)buf; (void)x64; (void)syntax;
-    return name;
-}
-
 void *vc_alloc_or_exit(size_t sz) { return malloc(sz); }
 void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
 
@@ -24,6 +18,7 @@ int main(void) {
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins;
     strbuf_t sb;
+    x86_insn_list_t code;
 
     /* Test load from spilled address */
     ra.loc[1] = -1; /* address in stack slot */
@@ -34,7 +29,10 @@ int main(void) {
     ins.type = TYPE_INT;
 
     strbuf_init(&sb);
-    emit_load_ptr(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_load_ptr(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (has_invalid(sb.data)) {
         printf("load ATT failed: %s\n", sb.data);
         return 1;
@@ -42,7 +40,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_load_ptr(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_load_ptr(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (has_invalid(sb.data)) {
         printf("load Intel failed: %s\n", sb.data);
         return 1;
@@ -58,7 +59,10 @@ int main(void) {
     ins.type = TYPE_INT;
 
     strbuf_init(&sb);
-    emit_store_ptr(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_store_ptr(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (has_invalid(sb.data)) {
         printf("store ATT failed: %s\n", sb.data);
         return 1;
@@ -66,7 +70,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_store_ptr(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_store_ptr(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (has_invalid(sb.data)) {
         printf("store Intel failed: %s\n", sb.data);
         return 1;
@@ -14,7 +14,7 @@ static int failures = 0;
     } \
 } while (0)
 
-static void add_str_macro(vector_t *macros)
+static void add_str_macro(macro_table_t *macros)
 {
     vector_t params;
     vector_init(&params, sizeof(char *));
@@ -25,7 +25,7 @@ static void add_str_macro(vector_t *macros)
 
 int main(void)
 {
-    vector_t macros; vector_init(&macros, sizeof(macro_t));
+    macro_table_t macros; macro_table_init(&macros);
     add_str_macro(&macros);
 
     strbuf_t sb; strbuf_init(&sb);
@@ -35,8 +35,7 @@ int main(void)
     ASSERT(strcmp(sb.data, "\"\\\"a\\\\\\\"b\\\\\\\\c\\\"\"") == 0);
     strbuf_free(&sb);
 
-    macro_free(&((macro_t *)macros.data)[0]);
-    vector_free(&macros);
+    macro_table_free(&macros);
 
     if (failures == 0)
         printf("All macro_stringize_escape tests passed\n");
@@ -0,0 +1,77 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "preproc_macros.h"
+#include "vector.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static void define(macro_table_t *macros, const char *name, const char *val)
+{
+    vector_t params;
+    vector_init(&params, sizeof(char *));
+    ASSERT(add_macro(name, val, &params, 0, macros));
+}
+
+/* redefinition replaces the previous body without adding an entry */
+static void test_redefine(void)
+{
+    macro_table_t macros;
+    macro_table_init(&macros);
+    define(&macros, "FOO", "1");
+    define(&macros, "FOO", "2");
+    ASSERT(macros.count == 1);
+    macro_t *m = macro_table_lookup(&macros, "FOO", 3);
+    ASSERT(m && strcmp(m->value, "2") == 0);
+    ASSERT(macro_table_lookup(&macros, "FOOBAR", 3) == m);
+    ASSERT(!macro_table_lookup(&macros, "FO", 2));
+    macro_table_free(&macros);
+}
+
+/* undef leaves other entries reachable across tombstones and growth */
+static void test_undef_many(void)
+{
+    macro_table_t macros;
+    macro_table_init(&macros);
+    char name[32];
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "M%d", i);
+        define(&macros, name, "x");
+    }
+    for (int i = 0; i < 5000; i += 2) {
+        snprintf(name, sizeof(name), "M%d", i);
+        remove_macro(&macros, name);
+    }
+    ASSERT(macros.count == 2500);
+    for (int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "M%d", i);
+        ASSERT(is_macro_defined(&macros, name) == (i & 1));
+    }
+    for (int i = 0; i < 5000; i += 2) {
+        snprintf(name, sizeof(name), "M%d", i);
+        define(&macros, name, "y");
+    }
+    ASSERT(macros.count == 5000);
+    remove_macro(&macros, "UNDEFINED");
+    ASSERT(macros.count == 5000);
+    macro_table_free(&macros);
+    ASSERT(macros.count == 0 && !is_macro_defined(&macros, "M1"));
+}
+
+int main(void)
+{
+    test_redefine();
+    test_undef_many();
+    if (failures == 0)
+        printf("All macro_table tests passed\n");
+    else
+        printf("%d macro_table test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
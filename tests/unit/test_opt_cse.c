@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_const.h"
+#include "ir_memory.h"
+#include "ir_cfg.h"
+#include "opt.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static ir_instr_t *find_return(ir_builder_t *ir, int nth)
+{
+    for (ir_instr_t *i = ir->head; i; i = i->next)
+        if (i->op == IR_RETURN && nth-- == 0)
+            return i;
+    return NULL;
+}
+
+static void run_vn(ir_builder_t *ir)
+{
+    ir_cfg_t cfg;
+    ASSERT(ir_cfg_build(ir, &cfg));
+    opt_value_number(ir, &cfg);
+    ir_cfg_free(&cfg);
+}
+
+/* a*b and b*a in one block are the same value, a*b as long is not */
+static void test_local(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t a = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_value_t b = ir_build_load_param(&ir, 1, TYPE_INT);
+    ir_value_t m1 = ir_build_binop(&ir, IR_MUL, a, b, TYPE_INT);
+    ir_value_t m2 = ir_build_binop(&ir, IR_MUL, b, a, TYPE_INT);
+    ir_value_t m3 = ir_build_binop(&ir, IR_MUL, a, b, TYPE_LLONG);
+    ir_value_t s1 = ir_build_binop(&ir, IR_SUB, a, b, TYPE_INT);
+    ir_value_t s2 = ir_build_binop(&ir, IR_SUB, b, a, TYPE_INT);
+    ir_build_return(&ir, ir_build_binop(&ir, IR_ADD, m2, m3, TYPE_INT),
+                    TYPE_INT);
+    ir_build_return(&ir, ir_build_binop(&ir, IR_ADD, s1, s2, TYPE_INT),
+                    TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_vn(&ir);
+    ir_instr_t *r0 = find_return(&ir, 0);
+    ir_instr_t *r1 = find_return(&ir, 1);
+    ir_instr_t *add0 = NULL, *add1 = NULL;
+    for (ir_instr_t *i = ir.head; i; i = i->next) {
+        if (i->op == IR_ADD && r0 && i->dest == r0->src1)
+            add0 = i;
+        if (i->op == IR_ADD && r1 && i->dest == r1->src1)
+            add1 = i;
+    }
+    ASSERT(add0 && add0->src1 == m1.id && add0->src2 == m3.id);
+    ASSERT(add1 && add1->src1 == s1.id && add1->src2 == s2.id);
+    ir_builder_free(&ir);
+}
+
+/*
+ * a+b computed in the entry block is reused at the join, a*b computed
+ * only on the then path is not.
+ */
+static void test_dominator_scope(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "g");
+    ir_value_t a = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_value_t b = ir_build_load_param(&ir, 1, TYPE_INT);
+    ir_value_t sum = ir_build_binop(&ir, IR_ADD, a, b, TYPE_INT);
+    ir_build_bcond(&ir, a, "Lelse");
+    ir_value_t prod = ir_build_binop(&ir, IR_MUL, a, b, TYPE_INT);
+    ir_build_store(&ir, "stack:4", TYPE_INT, prod);
+    ir_build_br(&ir, "Ljoin");
+    ir_build_label(&ir, "Lelse");
+    ir_build_store(&ir, "stack:4", TYPE_INT, ir_build_const(&ir, 0));
+    ir_build_label(&ir, "Ljoin");
+    ir_value_t sum2 = ir_build_binop(&ir, IR_ADD, b, a, TYPE_INT);
+    ir_value_t prod2 = ir_build_binop(&ir, IR_MUL, a, b, TYPE_INT);
+    ir_build_return(&ir, ir_build_binop(&ir, IR_ADD, sum2, prod2, TYPE_INT),
+                    TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_vn(&ir);
+    ir_instr_t *ret = find_return(&ir, 0);
+    ir_instr_t *add = NULL;
+    for (ir_instr_t *i = ir.head; i; i = i->next)
+        if (i->op == IR_ADD && ret && i->dest == ret->src1)
+            add = i;
+    ASSERT(add && add->src1 == sum.id);
+    ASSERT(add && add->src2 == prod2.id && prod2.id != prod.id);
+    ir_builder_free(&ir);
+}
+
+/*
+ * int x; int f(void){return 0;} int g(void){return (x+1)*(x+2);}
+ * g has more pure instructions than f but needs no larger table.
+ */
+static void test_table_reuse(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_build_return(&ir, ir_build_const(&ir, 0), TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_build_func_begin(&ir, "g");
+    ir_value_t x1 = ir_build_load(&ir, "x", TYPE_INT);
+    ir_value_t a = ir_build_binop(&ir, IR_ADD, x1, ir_build_const(&ir, 1),
+                                  TYPE_INT);
+    ir_value_t x2 = ir_build_load(&ir, "x", TYPE_INT);
+    ir_value_t b = ir_build_binop(&ir, IR_ADD, x2, ir_build_const(&ir, 2),
+                                  TYPE_INT);
+    ir_value_t m = ir_build_binop(&ir, IR_MUL, a, b, TYPE_INT);
+    ir_build_return(&ir, m, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_vn(&ir);
+    ir_instr_t *ret = find_return(&ir, 1);
+    ASSERT(ret && ret->src1 == m.id);
+    ir_builder_free(&ir);
+}
+
+/* equal constants share a value, so do p+0 and p+0 built from them */
+static void test_constants(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "h");
+    ir_value_t p = ir_build_load_param(&ir, 0, TYPE_PTR);
+    ir_value_t z1 = ir_build_const(&ir, 0);
+    ir_value_t a1 = ir_build_ptr_add(&ir, p, z1, 4);
+    ir_value_t z2 = ir_build_const(&ir, 0);
+    ir_value_t a2 = ir_build_ptr_add(&ir, p, z2, 4);
+    ir_value_t one = ir_build_const(&ir, 1);
+    ir_build_store_ptr(&ir, a1, one);
+    ir_build_store_ptr(&ir, a2, ir_build_const(&ir, 2));
+    ir_build_return(&ir, z2, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_vn(&ir);
+    ir_instr_t *st[2] = {NULL, NULL};
+    int n = 0;
+    for (ir_instr_t *i = ir.head; i; i = i->next)
+        if (i->op == IR_STORE_PTR && n < 2)
+            st[n++] = i;
+    ASSERT(st[0] && st[1] && st[0]->src1 == a1.id && st[1]->src1 == a1.id);
+    ASSERT(st[1] && st[1]->src2 != one.id);
+    ir_instr_t *ret = find_return(&ir, 0);
+    ASSERT(ret && ret->src1 == z1.id);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_local();
+    test_dominator_scope();
+    test_table_reuse();
+    test_constants();
+    if (failures == 0)
+        printf("All opt_cse tests passed\n");
+    else
+        printf("%d opt_cse test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
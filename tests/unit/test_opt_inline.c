@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_const.h"
+#include "ir_memory.h"
+#include "intern.h"
+#include "opt.h"
+
+void inline_small_funcs(ir_builder_t *ir, const opt_config_t *cfg);
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static const opt_config_t o1 = {1, 1, 1, 1, 1, 0, 0};
+static const opt_config_t o2 = {2, 1, 1, 1, 1, 1, 0};
+
+static ir_instr_t *find_func(ir_builder_t *ir, const char *name)
+{
+    for (ir_instr_t *i = ir->head; i; i = i->next)
+        if (i->op == IR_FUNC_BEGIN && i->name == intern_str(name))
+            return i;
+    return NULL;
+}
+
+/* count instructions with opcode OP in the function starting at BEGIN */
+static int count_ops(ir_instr_t *begin, ir_op_t op)
+{
+    int n = 0;
+    for (ir_instr_t *i = begin->next; i && i->op != IR_FUNC_END; i = i->next)
+        n += i->op == op;
+    return n;
+}
+
+static ir_value_t call2(ir_builder_t *ir, const char *name, long long a,
+                        long long b)
+{
+    ir_value_t va = ir_build_const(ir, a);
+    ir_value_t vb = ir_build_const(ir, b);
+    /* 32-bit calls push the last argument first */
+    ir_build_arg(ir, vb, TYPE_INT);
+    ir_build_arg(ir, va, TYPE_INT);
+    return ir_build_call(ir, name, 2);
+}
+
+/* the first argument binds to parameter 0 whatever the push order */
+static void test_argument_order(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_instr_t *b = ir_build_func_begin(&ir, "sub");
+    b->src1 = IR_FUNC_INLINE;
+    ir_value_t x = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_value_t y = ir_build_load_param(&ir, 1, TYPE_INT);
+    ir_build_return(&ir, ir_build_binop(&ir, IR_SUB, x, y, TYPE_INT), TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_build_func_begin(&ir, "main");
+    ir_build_return(&ir, call2(&ir, "sub", 5, 2), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    inline_small_funcs(&ir, &o1);
+    ir_instr_t *m = find_func(&ir, "main");
+    ASSERT(m && count_ops(m, IR_CALL) == 0 && count_ops(m, IR_ARG) == 0);
+    ir_instr_t *sub = NULL, *ret = NULL;
+    for (ir_instr_t *i = m ? m->next : NULL; i && i->op != IR_FUNC_END;
+         i = i->next) {
+        if (i->op == IR_SUB)
+            sub = i;
+        if (i->op == IR_RETURN)
+            ret = i;
+    }
+    ASSERT(sub && ret && ret->src1 == sub->dest);
+    ir_instr_t *lhs = NULL;
+    for (ir_instr_t *i = ir.head; i && sub; i = i->next)
+        if (i->dest == sub->src1)
+            lhs = i;
+    ASSERT(lhs && lhs->op == IR_CONST && lhs->imm == 5);
+    ir_builder_free(&ir);
+}
+
+/*
+ * A callee with branches, a local and two returns is copied with fresh
+ * labels, its local moved below the caller's and the result passed
+ * through a slot.
+ */
+static void test_multi_block(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_instr_t *b = ir_build_func_begin(&ir, "pick");
+    b->src1 = IR_FUNC_INLINE;
+    b->imm = 4;
+    ir_value_t p = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_build_store(&ir, "stack:4", TYPE_INT, p);
+    ir_build_bcond(&ir, p, "L1_else");
+    ir_build_return(&ir, ir_build_load(&ir, "stack:4", TYPE_INT), TYPE_INT);
+    ir_build_label(&ir, "L1_else");
+    ir_build_return(&ir, ir_build_load_param(&ir, 1, TYPE_INT), TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_instr_t *m = ir_build_func_begin(&ir, "main");
+    m->imm = 4;
+    ir_build_store(&ir, "stack:4", TYPE_INT, ir_build_const(&ir, 1));
+    ir_build_return(&ir, call2(&ir, "pick", 3, 4), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    inline_small_funcs(&ir, &o1);
+    ASSERT(count_ops(m, IR_CALL) == 0);
+    ASSERT(count_ops(m, IR_BR) == 2);
+    ASSERT(m->imm >= 16 + 4 + 4);
+    int moved = 0, labels = 0;
+    for (ir_instr_t *i = m->next; i->op != IR_FUNC_END; i = i->next) {
+        if (i->op == IR_LABEL) {
+            labels++;
+            ASSERT(i->name != intern_str("L1_else"));
+        }
+        if (i->op == IR_STORE && i->name == intern_str("stack:20"))
+            moved = 1;
+    }
+    ASSERT(labels == 2 && moved);
+    ir_builder_free(&ir);
+}
+
+/* recursive cycles stay calls, their callers still get one level copied */
+static void test_recursion(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_instr_t *f = ir_build_func_begin(&ir, "f");
+    ir_value_t a = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_build_arg(&ir, a, TYPE_INT);
+    ir_build_return(&ir, ir_build_call(&ir, "f", 1), TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_build_func_begin(&ir, "main");
+    ir_build_arg(&ir, ir_build_const(&ir, 1), TYPE_INT);
+    ir_build_return(&ir, ir_build_call(&ir, "f", 1), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    inline_small_funcs(&ir, &o1);
+    ASSERT(count_ops(find_func(&ir, "main"), IR_CALL) == 1);
+    inline_small_funcs(&ir, &o2);
+    ASSERT(count_ops(f, IR_CALL) == 1);
+    ir_instr_t *m = find_func(&ir, "main");
+    ASSERT(count_ops(m, IR_CALL) == 1 && count_ops(m, IR_ARG) == 1);
+    ir_builder_free(&ir);
+}
+
+/* callees are visited first, so a chain collapses into its caller */
+static void test_bottom_up(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "main");
+    ir_build_return(&ir, call2(&ir, "outer", 1, 2), TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_instr_t *o = ir_build_func_begin(&ir, "outer");
+    o->src1 = IR_FUNC_STATIC;
+    ir_value_t x = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_value_t y = ir_build_load_param(&ir, 1, TYPE_INT);
+    ir_build_arg(&ir, x, TYPE_INT);
+    ir_build_arg(&ir, y, TYPE_INT);
+    ir_build_return(&ir, ir_build_call(&ir, "inner", 2), TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_build_func_begin(&ir, "inner");
+    ir_value_t p = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_value_t q = ir_build_load_param(&ir, 1, TYPE_INT);
+    ir_build_return(&ir, ir_build_binop(&ir, IR_MUL, p, q, TYPE_INT), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    inline_small_funcs(&ir, &o2);
+    ir_instr_t *m = find_func(&ir, "main");
+    ASSERT(count_ops(o, IR_CALL) == 0);
+    ASSERT(count_ops(m, IR_CALL) == 0 && count_ops(m, IR_MUL) == 1);
+    ir_builder_free(&ir);
+}
+
+/* large bodies are left alone unless the caller has budget and a hint */
+static void test_cost_limit(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "big");
+    ir_value_t v = ir_build_load_param(&ir, 0, TYPE_INT);
+    for (int k = 0; k < 30; k++)
+        v = ir_build_binop(&ir, IR_MUL, v, ir_build_load_param(&ir, 1, TYPE_INT),
+                           TYPE_INT);
+    ir_build_return(&ir, v, TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_instr_t *m = ir_build_func_begin(&ir, "main");
+    ir_value_t r = call2(&ir, "big", 2, 3);
+    ir_build_return(&ir, r, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    inline_small_funcs(&ir, &o2);
+    ASSERT(count_ops(m, IR_CALL) == 1);
+    ir_builder_free(&ir);
+}
+
+/*
+ * static int f(int x){int *p; p=&x; p[0]=p[0]+1; return x;}
+ * The IR_ADDR naming x is only meaningful inside f, so f is kept out
+ * of line even when declared inline.
+ */
+static void test_param_address(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_instr_t *b = ir_build_func_begin(&ir, "f");
+    b->src1 = IR_FUNC_STATIC | IR_FUNC_INLINE | IR_FUNC_PARAM_ADDR;
+    ir_value_t p = ir_build_addr(&ir, "x");
+    ir_value_t v = ir_build_load_ptr(&ir, p);
+    ir_build_store_ptr(&ir, p, ir_build_binop(&ir, IR_ADD, v,
+                                              ir_build_const(&ir, 1),
+                                              TYPE_INT));
+    ir_build_return(&ir, ir_build_load_param(&ir, 0, TYPE_INT), TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_instr_t *g = ir_build_func_begin(&ir, "g");
+    ir_build_arg(&ir, ir_build_load_param(&ir, 0, TYPE_INT), TYPE_INT);
+    ir_value_t r1 = ir_build_call(&ir, "f", 1);
+    ir_build_arg(&ir, ir_build_const(&ir, 5), TYPE_INT);
+    ir_value_t r2 = ir_build_call(&ir, "f", 1);
+    ir_build_return(&ir, ir_build_binop(&ir, IR_ADD, r1, r2, TYPE_INT),
+                    TYPE_INT);
+    ir_build_func_end(&ir);
+
+    inline_small_funcs(&ir, &o1);
+    ASSERT(count_ops(g, IR_CALL) == 2);
+    inline_small_funcs(&ir, &o2);
+    ASSERT(count_ops(g, IR_CALL) == 2);
+    ASSERT(count_ops(g, IR_ADDR) == 0);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_argument_order();
+    test_multi_block();
+    test_recursion();
+    test_bottom_up();
+    test_cost_limit();
+    test_param_address();
+    if (failures == 0)
+        printf("All opt_inline tests passed\n");
+    else
+        printf("%d opt_inline test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_const.h"
+#include "ir_memory.h"
+#include "ir_cfg.h"
+#include "intern.h"
+#include "opt.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static const opt_config_t o1 = {1, 1, 1, 1, 1, 0, 0};
+static const opt_config_t o2 = {2, 1, 1, 1, 1, 1, 0};
+
+static void run_loop_opt(ir_builder_t *ir, const opt_config_t *cfg)
+{
+    ir_cfg_t fcfg;
+    ASSERT(ir_cfg_build(ir, &fcfg));
+    if (cfg->mem2reg)
+        opt_mem2reg(ir, &fcfg);
+    opt_licm(ir, &fcfg, cfg);
+    ir_cfg_free(&fcfg);
+}
+
+/* the instruction defining VALUE */
+static ir_instr_t *def_of(ir_builder_t *ir, int value)
+{
+    for (ir_instr_t *i = ir->head; i; i = i->next)
+        if (i->dest == value)
+            return i;
+    return NULL;
+}
+
+/* non-zero when the definition of VALUE precedes label NAME */
+static int before_label(ir_builder_t *ir, int value, const char *name)
+{
+    name = intern_str(name);
+    for (ir_instr_t *i = ir->head; i; i = i->next) {
+        if (i->dest == value)
+            return 1;
+        if (i->op == IR_LABEL && i->name == name)
+            return 0;
+    }
+    return 0;
+}
+
+/*
+ * Non-zero when VALUE is a header phi starting at BASE + init * 4 before
+ * label L1 and advancing by four bytes on the back edge.
+ */
+static int reduced_pointer(ir_builder_t *ir, int value, int base)
+{
+    ir_instr_t *phi = def_of(ir, value);
+    if (!phi || phi->op != IR_PHI || phi->imm != 2)
+        return 0;
+    ir_phi_arg_t *args = ir_phi_args(phi);
+    int started = 0, bumped = 0;
+    for (int k = 0; k < 2; k++) {
+        ir_instr_t *d = def_of(ir, args[k].value);
+        if (!d || d->op != IR_PTR_ADD)
+            continue;
+        if (d->src1 == phi->dest && d->imm == 1) {
+            ir_instr_t *step = def_of(ir, d->src2);
+            bumped = step && step->op == IR_CONST && step->imm == 4;
+        } else if (d->src1 == base && d->imm == 4) {
+            started = before_label(ir, d->dest, "L1");
+        }
+    }
+    return started && bumped;
+}
+
+/*
+ * Loads of names the loop never writes leave the loop, the global
+ * stored in the body and the dereference that only runs on some
+ * iterations stay.
+ */
+static void test_hoist(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_build_store(&ir, "stack:4", TYPE_INT, ir_build_const(&ir, 0));
+    ir_build_label(&ir, "L1");
+    ir_value_t i = ir_build_load(&ir, "stack:4", TYPE_INT);
+    ir_value_t n = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_build_bcond(&ir, ir_build_binop(&ir, IR_CMPLT, i, n, TYPE_INT), "L2");
+    ir_value_t g = ir_build_load(&ir, "G", TYPE_INT);
+    ir_value_t h = ir_build_load(&ir, "H", TYPE_INT);
+    ir_value_t p = ir_build_load_param(&ir, 1, TYPE_PTR);
+    ir_value_t d = ir_build_load_ptr(&ir, p);
+    ir_value_t s = ir_build_binop(&ir, IR_ADD, g, h, TYPE_INT);
+    ir_build_store(&ir, "H", TYPE_INT,
+                   ir_build_binop(&ir, IR_ADD, s, d, TYPE_INT));
+    ir_value_t i2 = ir_build_load(&ir, "stack:4", TYPE_INT);
+    ir_build_store(&ir, "stack:4", TYPE_INT,
+                   ir_build_binop(&ir, IR_ADD, i2, ir_build_const(&ir, 1),
+                                  TYPE_INT));
+    ir_build_br(&ir, "L1");
+    ir_build_label(&ir, "L2");
+    ir_build_return(&ir, ir_build_const(&ir, 0), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_loop_opt(&ir, &o1);
+    ASSERT(before_label(&ir, n.id, "L1"));
+    ASSERT(before_label(&ir, g.id, "L1"));
+    ASSERT(before_label(&ir, p.id, "L1"));
+    ASSERT(!before_label(&ir, h.id, "L1"));
+    ASSERT(!before_label(&ir, d.id, "L1"));
+    ASSERT(!before_label(&ir, i.id, "L1"));
+    ir_builder_free(&ir);
+}
+
+/* a call in the loop may write any global but not an unexposed local */
+static void test_call(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_build_store(&ir, "stack:4", TYPE_INT, ir_build_const(&ir, 0));
+    ir_build_store(&ir, "stack:8", TYPE_INT, ir_build_const(&ir, 3));
+    ir_build_label(&ir, "L1");
+    ir_value_t i = ir_build_load(&ir, "stack:4", TYPE_INT);
+    ir_build_bcond(&ir, i, "L2");
+    ir_value_t g = ir_build_load(&ir, "G", TYPE_INT);
+    ir_value_t k = ir_build_load(&ir, "stack:8", TYPE_INT);
+    ir_build_store(&ir, "stack:4", TYPE_INT,
+                   ir_build_binop(&ir, IR_ADD, g, k, TYPE_INT));
+    ir_build_call(&ir, "g", 0);
+    ir_build_br(&ir, "L1");
+    ir_build_label(&ir, "L2");
+    ir_build_return(&ir, i, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_loop_opt(&ir, &o1);
+    ASSERT(!before_label(&ir, g.id, "L1"));
+    ASSERT(before_label(&ir, k.id, "L1"));
+    ir_builder_free(&ir);
+}
+
+/*
+ * After SSA construction the address p + i * 4 becomes a pointer of its
+ * own, started in the preheader and bumped by four bytes each iteration.
+ */
+static void test_strength_reduce(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_build_store(&ir, "stack:4", TYPE_INT, ir_build_const(&ir, 0));
+    ir_build_label(&ir, "L1");
+    ir_value_t i = ir_build_load(&ir, "stack:4", TYPE_INT);
+    ir_value_t n = ir_build_load_param(&ir, 1, TYPE_INT);
+    ir_build_bcond(&ir, ir_build_binop(&ir, IR_CMPLT, i, n, TYPE_INT), "L2");
+    ir_value_t p = ir_build_load_param(&ir, 0, TYPE_PTR);
+    ir_value_t i2 = ir_build_load(&ir, "stack:4", TYPE_INT);
+    ir_value_t a = ir_build_ptr_add(&ir, p, i2, 4);
+    ir_build_store_ptr(&ir, a, ir_build_const(&ir, 0));
+    ir_value_t i3 = ir_build_load(&ir, "stack:4", TYPE_INT);
+    ir_build_store(&ir, "stack:4", TYPE_INT,
+                   ir_build_binop(&ir, IR_ADD, i3, ir_build_const(&ir, 1),
+                                  TYPE_INT));
+    ir_build_br(&ir, "L1");
+    ir_build_label(&ir, "L2");
+    ir_build_return(&ir, ir_build_const(&ir, 0), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_loop_opt(&ir, &o2);
+    ir_instr_t *store = NULL;
+    for (ir_instr_t *it = ir.head; it; it = it->next)
+        if (it->op == IR_STORE_PTR)
+            store = it;
+    ASSERT(store && reduced_pointer(&ir, store->src1, p.id));
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_hoist();
+    test_call();
+    test_strength_reduce();
+    if (failures == 0)
+        printf("All opt_loop tests passed\n");
+    else
+        printf("%d opt_loop test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
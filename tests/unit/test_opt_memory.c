@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_const.h"
+#include "ir_memory.h"
+#include "ir_cfg.h"
+#include "opt.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static void run_memory_opt(ir_builder_t *ir)
+{
+    ir_cfg_t cfg;
+    ASSERT(ir_cfg_build(ir, &cfg));
+    opt_memory(ir, &cfg);
+    ir_cfg_free(&cfg);
+}
+
+/* the instruction defining VALUE */
+static ir_instr_t *def_of(ir_builder_t *ir, ir_value_t value)
+{
+    for (ir_instr_t *i = ir->head; i; i = i->next)
+        if (i->dest == value.id)
+            return i;
+    return NULL;
+}
+
+/* number of stores writing the constant VALUE */
+static int stores_of(ir_builder_t *ir, long long value)
+{
+    int n = 0;
+    for (ir_instr_t *i = ir->head; i; i = i->next) {
+        if (i->op != IR_STORE && i->op != IR_STORE_PTR)
+            continue;
+        int v = i->op == IR_STORE ? i->src1 : i->src2;
+        for (ir_instr_t *d = ir->head; d; d = d->next)
+            if (d->dest == v && d->op == IR_CONST && d->imm == value)
+                n++;
+    }
+    return n;
+}
+
+/*
+ * A second load of G reuses the first, a write through a pointer in
+ * between or a volatile access prevents that.
+ */
+static void test_loads(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t a = ir_build_load(&ir, "G", TYPE_INT);
+    ir_value_t b = ir_build_load(&ir, "G", TYPE_INT);
+    ir_value_t s = ir_build_binop(&ir, IR_ADD, a, b, TYPE_INT);
+    ir_value_t p = ir_build_load_param(&ir, 0, TYPE_PTR);
+    ir_build_store_ptr(&ir, p, s);
+    ir_value_t c = ir_build_load(&ir, "G", TYPE_INT);
+    ir_value_t v = ir_build_load_vol(&ir, "G", TYPE_INT);
+    ir_value_t w = ir_build_load_vol(&ir, "G", TYPE_INT);
+    ir_value_t t = ir_build_binop(&ir, IR_ADD, c, v, TYPE_INT);
+    ir_value_t u = ir_build_binop(&ir, IR_ADD, t, w, TYPE_INT);
+    ir_build_return(&ir, u, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_memory_opt(&ir);
+    ir_instr_t *add = def_of(&ir, s);
+    ASSERT(add->src1 == a.id && add->src2 == a.id);
+    ir_instr_t *add2 = def_of(&ir, t);
+    ASSERT(add2->src1 == c.id && add2->src2 == v.id);
+    ASSERT(def_of(&ir, u)->src2 == w.id);
+    ir_builder_free(&ir);
+}
+
+/*
+ * Overwritten stores disappear unless something may read them first:
+ * a load of the same name, a call for a global or a load through an
+ * unknown pointer.
+ */
+static void test_stores(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_build_store(&ir, "G", TYPE_INT, ir_build_const(&ir, 1));
+    ir_build_store(&ir, "G", TYPE_INT, ir_build_const(&ir, 2));
+    ir_value_t g = ir_build_load(&ir, "G", TYPE_INT);
+    ir_build_store(&ir, "G", TYPE_INT, ir_build_const(&ir, 3));
+    ir_build_call(&ir, "h", 0);
+    ir_build_store(&ir, "G", TYPE_INT, ir_build_const(&ir, 4));
+    ir_build_store(&ir, "stack:4", TYPE_INT, ir_build_const(&ir, 5));
+    ir_build_call(&ir, "h", 0);
+    ir_value_t p = ir_build_load_param(&ir, 0, TYPE_PTR);
+    ir_build_store_ptr(&ir, p, ir_build_const(&ir, 6));
+    ir_value_t q = ir_build_load_ptr(&ir, ir_build_load_param(&ir, 1, TYPE_PTR));
+    ir_build_store_ptr(&ir, p, ir_build_const(&ir, 7));
+    ir_build_store(&ir, "stack:4", TYPE_INT, g);
+    ir_build_store(&ir, "G", TYPE_INT, q);
+    ir_build_return(&ir, ir_build_const(&ir, 0), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_memory_opt(&ir);
+    ASSERT(stores_of(&ir, 1) == 0);
+    ASSERT(stores_of(&ir, 2) == 1);
+    ASSERT(stores_of(&ir, 3) == 1);
+    ASSERT(stores_of(&ir, 4) == 1);
+    ASSERT(stores_of(&ir, 5) == 0);
+    ASSERT(stores_of(&ir, 6) == 1);
+    ASSERT(stores_of(&ir, 7) == 1);
+    ir_builder_free(&ir);
+}
+
+/*
+ * void f(int *p){p[0]=1; p[0]=2;} as emitted at -O0.  Value numbering
+ * gives both indexes one constant and the reused load of p makes the
+ * two address computations equal, so the first store is dead.
+ */
+static void test_pointer_store(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t i1 = ir_build_const(&ir, 0);
+    ir_value_t c1 = ir_build_const(&ir, 1);
+    ir_value_t p1 = ir_build_load_param(&ir, 0, TYPE_PTR);
+    ir_build_store_ptr(&ir, ir_build_ptr_add(&ir, p1, i1, 4), c1);
+    ir_value_t i2 = ir_build_const(&ir, 0);
+    ir_value_t c2 = ir_build_const(&ir, 2);
+    ir_value_t p2 = ir_build_load_param(&ir, 0, TYPE_PTR);
+    ir_build_store_ptr(&ir, ir_build_ptr_add(&ir, p2, i2, 4), c2);
+    ir_build_return(&ir, ir_build_const(&ir, 0), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    ir_cfg_t cfg;
+    ASSERT(ir_cfg_build(&ir, &cfg));
+    opt_value_number(&ir, &cfg);
+    opt_memory(&ir, &cfg);
+    ir_cfg_free(&cfg);
+    ASSERT(stores_of(&ir, 1) == 0);
+    ASSERT(stores_of(&ir, 2) == 1);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_loads();
+    test_stores();
+    test_pointer_store();
+    if (failures == 0)
+        printf("All opt_memory tests passed\n");
+    else
+        printf("%d opt_memory test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_const.h"
+#include "ir_memory.h"
+#include "ir_global.h"
+#include "intern.h"
+#include "opt.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static const opt_config_t o1 = {1, 1, 1, 1, 1, 0, 0};
+static const opt_config_t o1_64 = {1, 1, 1, 1, 1, 0, 1};
+
+static void run_sccp(ir_builder_t *ir, const opt_config_t *cfg)
+{
+    ir_cfg_t fcfg;
+    ASSERT(ir_cfg_build(ir, &fcfg));
+    opt_sccp(ir, &fcfg, cfg);
+    ir_cfg_free(&fcfg);
+}
+
+/* count instructions with opcode OP in the function starting at BEGIN */
+static int count_ops(ir_instr_t *begin, ir_op_t op)
+{
+    int n = 0;
+    for (ir_instr_t *i = begin->next; i && i->op != IR_FUNC_END; i = i->next)
+        n += i->op == op;
+    return n;
+}
+
+/* the instruction defining VALUE */
+static ir_instr_t *def_of(ir_builder_t *ir, int value)
+{
+    for (ir_instr_t *i = ir->head; i; i = i->next)
+        if (i->dest == value)
+            return i;
+    return NULL;
+}
+
+static ir_instr_t *find_op(ir_instr_t *begin, ir_op_t op)
+{
+    for (ir_instr_t *i = begin->next; i && i->op != IR_FUNC_END; i = i->next)
+        if (i->op == op)
+            return i;
+    return NULL;
+}
+
+/* a branch on a local flag stored as zero keeps only the taken arm */
+static void test_flag_branch(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_instr_t *f = ir_build_func_begin(&ir, "f");
+    ir_build_store(&ir, "stack:4", TYPE_INT, ir_build_const(&ir, 0));
+    ir_build_bcond(&ir, ir_build_load(&ir, "stack:4", TYPE_INT), "L1");
+    ir_build_call(&ir, "trace", 0);
+    ir_build_store(&ir, "stack:8", TYPE_INT, ir_build_const(&ir, 5));
+    ir_build_br(&ir, "L2");
+    ir_build_label(&ir, "L1");
+    ir_build_store(&ir, "stack:8", TYPE_INT, ir_build_const(&ir, 7));
+    ir_build_label(&ir, "L2");
+    ir_build_return(&ir, ir_build_load(&ir, "stack:8", TYPE_INT), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_sccp(&ir, &o1);
+    ASSERT(count_ops(f, IR_BCOND) == 0);
+    ASSERT(count_ops(f, IR_CALL) == 0);
+    ASSERT(count_ops(f, IR_LOAD) == 0);
+    ir_instr_t *ret = find_op(f, IR_RETURN);
+    ir_instr_t *v = ret ? def_of(&ir, ret->src1) : NULL;
+    ASSERT(v && v->op == IR_CONST && v->imm == 7);
+    ir_builder_free(&ir);
+}
+
+/*
+ * A local untouched by the loop survives the back edge and the call in
+ * the body, the induction variable and a global written before the call
+ * do not.
+ */
+static void test_loop(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_instr_t *f = ir_build_func_begin(&ir, "f");
+    ir_build_store(&ir, "stack:4", TYPE_INT, ir_build_const(&ir, 0));
+    ir_build_store(&ir, "stack:8", TYPE_INT, ir_build_const(&ir, 3));
+    ir_build_store(&ir, "G", TYPE_INT, ir_build_const(&ir, 4));
+    ir_build_label(&ir, "L1");
+    ir_value_t i = ir_build_load(&ir, "stack:4", TYPE_INT);
+    ir_value_t n = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_build_bcond(&ir, ir_build_binop(&ir, IR_CMPLT, i, n, TYPE_INT), "L2");
+    ir_value_t i2 = ir_build_load(&ir, "stack:4", TYPE_INT);
+    ir_build_store(&ir, "stack:4", TYPE_INT,
+                   ir_build_binop(&ir, IR_ADD, i2, ir_build_const(&ir, 1),
+                                  TYPE_INT));
+    ir_build_call(&ir, "g", 0);
+    ir_build_br(&ir, "L1");
+    ir_build_label(&ir, "L2");
+    ir_value_t x = ir_build_load(&ir, "stack:8", TYPE_INT);
+    ir_value_t g = ir_build_load(&ir, "G", TYPE_INT);
+    ir_build_return(&ir, ir_build_binop(&ir, IR_ADD, x, g, TYPE_INT),
+                    TYPE_INT);
+    ir_build_func_end(&ir);
+
+    run_sccp(&ir, &o1);
+    ASSERT(count_ops(f, IR_BCOND) == 1);
+    ASSERT(def_of(&ir, i.id)->op == IR_LOAD);
+    ASSERT(def_of(&ir, x.id)->op == IR_CONST && def_of(&ir, x.id)->imm == 3);
+    ASSERT(def_of(&ir, g.id)->op == IR_LOAD);
+    ir_builder_free(&ir);
+}
+
+/* arithmetic wraps at the width of its type and 64-bit results survive */
+static void test_widths(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t big = ir_build_const(&ir, 1 << 20);
+    ir_value_t wide = ir_build_binop(&ir, IR_MUL, big, big, TYPE_LLONG);
+    ir_value_t half = ir_build_const(&ir, 65536);
+    ir_value_t narrow = ir_build_binop(&ir, IR_MUL, half, half, TYPE_INT);
+    ir_value_t minus = ir_build_const(&ir, -1);
+    ir_value_t ucmp = ir_build_binop(&ir, IR_CMPGT, minus, half, TYPE_UINT);
+    ir_value_t zero = ir_build_const(&ir, 0);
+    ir_value_t div = ir_build_binop(&ir, IR_DIV, big, zero, TYPE_INT);
+    ir_build_store(&ir, "stack:8", TYPE_CHAR, ir_build_const(&ir, 300));
+    ir_value_t c = ir_build_load(&ir, "stack:8", TYPE_CHAR);
+    ir_value_t s = ir_build_binop(&ir, IR_ADD, wide, narrow, TYPE_LLONG);
+    ir_value_t t = ir_build_binop(&ir, IR_ADD, ucmp, div, TYPE_INT);
+    ir_build_return(&ir, ir_build_binop(&ir, IR_ADD, s, t, TYPE_LLONG),
+                    TYPE_LLONG);
+    ir_build_func_end(&ir);
+
+    run_sccp(&ir, &o1_64);
+    ir_instr_t *d = def_of(&ir, wide.id);
+    ASSERT(d->op == IR_CONST && d->imm == 1LL << 40);
+    d = def_of(&ir, narrow.id);
+    ASSERT(d->op == IR_CONST && d->imm == 0);
+    d = def_of(&ir, ucmp.id);
+    ASSERT(d->op == IR_CONST && d->imm == 1);
+    ASSERT(def_of(&ir, div.id)->op == IR_DIV);
+    d = def_of(&ir, c.id);
+    ASSERT(d->op == IR_CONST && d->imm == 44);
+    ir_builder_free(&ir);
+}
+
+/* static globals never written in the unit fold to their initializer */
+static void test_static_flags(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_glob_var(&ir, "verbose", 0, 1, 4);
+    ir_build_glob_var(&ir, "level", 2, 1, 4);
+    ir_instr_t *f = ir_build_func_begin(&ir, "f");
+    ir_build_bcond(&ir, ir_build_load(&ir, "verbose", TYPE_INT), "L1");
+    ir_build_call(&ir, "log", 0);
+    ir_build_label(&ir, "L1");
+    ir_value_t l = ir_build_load(&ir, "level", TYPE_INT);
+    ir_build_return(&ir, l, TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_build_func_begin(&ir, "set");
+    ir_build_store(&ir, "level", TYPE_INT, ir_build_const(&ir, 3));
+    ir_build_func_end(&ir);
+
+    run_sccp(&ir, &o1);
+    ASSERT(count_ops(f, IR_BCOND) == 0 && count_ops(f, IR_CALL) == 0);
+    ASSERT(def_of(&ir, l.id)->op == IR_LOAD);
+    ASSERT(intern_str("level") == def_of(&ir, l.id)->name);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_flag_branch();
+    test_loop();
+    test_widths();
+    test_static_flags();
+    if (failures == 0)
+        printf("All opt_sccp tests passed\n");
+    else
+        printf("%d opt_sccp test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
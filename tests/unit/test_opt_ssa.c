@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_const.h"
+#include "ir_memory.h"
+#include "ir_cfg.h"
+#include "intern.h"
+#include "opt.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+static size_t count_op(ir_builder_t *ir, ir_op_t op, const char *name)
+{
+    size_t n = 0;
+    for (ir_instr_t *i = ir->head; i; i = i->next)
+        if (i->op == op && (!name || i->name == intern_str(name)))
+            n++;
+    return n;
+}
+
+/* x = c ? 1 : 2 through a local followed by return x */
+static void build_diamond(ir_builder_t *ir)
+{
+    ir_builder_init(ir);
+    ir_build_func_begin(ir, "f");
+    ir_value_t c = ir_build_load_param(ir, 0, TYPE_INT);
+    ir_build_bcond(ir, c, "Lelse");
+    ir_build_store(ir, "stack:4", TYPE_INT, ir_build_const(ir, 1));
+    ir_build_br(ir, "Ljoin");
+    ir_build_label(ir, "Lelse");
+    ir_build_store(ir, "stack:4", TYPE_INT, ir_build_const(ir, 2));
+    ir_build_label(ir, "Ljoin");
+    ir_value_t x = ir_build_load(ir, "stack:4", TYPE_INT);
+    ir_build_return(ir, x, TYPE_INT);
+    ir_build_func_end(ir);
+}
+
+static void test_dominators(void)
+{
+    ir_builder_t ir;
+    build_diamond(&ir);
+    ir_cfg_t cfg;
+    ASSERT(ir_cfg_build(&ir, &cfg));
+    ir_function_t *fn = &cfg.funcs[0];
+    ASSERT(fn->block_count == 4);
+    ASSERT(ir_cfg_dominators(fn));
+    if (fn->block_count == 4 && fn->idom) {
+        ASSERT(fn->idom[0] == IR_CFG_NO_BLOCK);
+        ASSERT(fn->idom[1] == 0 && fn->idom[2] == 0 && fn->idom[3] == 0);
+        ASSERT(fn->rpo_count == 4 && fn->rpo[0] == 0);
+        ASSERT(ir_cfg_dominates(fn, 0, 3));
+        ASSERT(!ir_cfg_dominates(fn, 1, 3));
+        ASSERT(fn->dom_start[0] == 0 && fn->dom_start[1] == 3);
+        ASSERT(fn->dom_start[4] == 3 && fn->dom_child[2] == 3);
+    }
+    ir_cfg_free(&cfg);
+    ir_builder_free(&ir);
+}
+
+/* the join receives a phi which is lowered to copies on both edges */
+static void test_diamond_phi(void)
+{
+    ir_builder_t ir;
+    build_diamond(&ir);
+    ir_cfg_t cfg;
+    ASSERT(ir_cfg_build(&ir, &cfg));
+    opt_mem2reg(&ir, &cfg);
+    ASSERT(count_op(&ir, IR_LOAD, "stack:4") == 0);
+    ASSERT(count_op(&ir, IR_STORE, "stack:4") == 0);
+    ASSERT(count_op(&ir, IR_PHI, NULL) == 1);
+    ASSERT(ir.head->src1 & IR_FUNC_PROMOTED);
+
+    ir_instr_t *phi = NULL;
+    ir_instr_t *ret = NULL;
+    for (ir_instr_t *i = ir.head; i; i = i->next) {
+        if (i->op == IR_PHI)
+            phi = i;
+        if (i->op == IR_RETURN)
+            ret = i;
+    }
+    ASSERT(phi && ret && ret->src1 == phi->dest);
+    ASSERT(phi && phi->imm == 2);
+
+    opt_out_of_ssa(&ir, &cfg);
+    ASSERT(count_op(&ir, IR_PHI, NULL) == 0);
+    ASSERT(count_op(&ir, IR_COPY, NULL) == 2);
+    for (ir_instr_t *i = ir.head; i; i = i->next)
+        if (i->op == IR_COPY)
+            ASSERT(ret && i->dest == ret->src1);
+    ir_cfg_free(&cfg);
+    ir_builder_free(&ir);
+}
+
+/* loop counters get a phi at the header, volatile and escaping locals stay */
+static void test_loop(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "g");
+    ir_build_store(&ir, "stack:4", TYPE_INT, ir_build_const(&ir, 0));
+    ir_build_store_vol(&ir, "stack:8", TYPE_INT, ir_build_const(&ir, 0));
+    ir_build_addr(&ir, "stack:12");
+    ir_build_store(&ir, "stack:12", TYPE_INT, ir_build_const(&ir, 0));
+    ir_build_label(&ir, "Lhead");
+    ir_value_t i = ir_build_load(&ir, "stack:4", TYPE_INT);
+    ir_value_t n = ir_build_load_param(&ir, 0, TYPE_INT);
+    ir_value_t c = ir_build_binop(&ir, IR_CMPLT, i, n, TYPE_INT);
+    ir_build_bcond(&ir, c, "Lend");
+    ir_value_t i2 = ir_build_load(&ir, "stack:4", TYPE_INT);
+    ir_value_t next = ir_build_binop(&ir, IR_ADD, i2, ir_build_const(&ir, 1),
+                                     TYPE_INT);
+    ir_build_store(&ir, "stack:4", TYPE_INT, next);
+    ir_build_br(&ir, "Lhead");
+    ir_build_label(&ir, "Lend");
+    ir_build_return(&ir, ir_build_load(&ir, "stack:4", TYPE_INT), TYPE_INT);
+    ir_build_func_end(&ir);
+
+    ir_cfg_t cfg;
+    ASSERT(ir_cfg_build(&ir, &cfg));
+    opt_mem2reg(&ir, &cfg);
+    ASSERT(count_op(&ir, IR_LOAD, "stack:4") == 0);
+    ASSERT(count_op(&ir, IR_STORE, "stack:4") == 0);
+    ASSERT(count_op(&ir, IR_STORE, "stack:8") == 1);
+    ASSERT(count_op(&ir, IR_STORE, "stack:12") == 1);
+    ASSERT(count_op(&ir, IR_PHI, NULL) == 1);
+
+    ir_instr_t *phi = NULL;
+    for (ir_instr_t *k = ir.head; k; k = k->next)
+        if (k->op == IR_PHI)
+            phi = k;
+    ASSERT(phi && phi->imm == 2);
+    if (phi && phi->imm == 2) {
+        ir_phi_arg_t *args = ir_phi_args(phi);
+        int back = args[0].pred ? 0 : 1;
+        ASSERT(args[back].pred && args[back].pred->op == IR_BR);
+        ASSERT(args[back].value == next.id);
+        ASSERT(args[1 - back].pred == NULL);
+    }
+
+    opt_out_of_ssa(&ir, &cfg);
+    ASSERT(count_op(&ir, IR_PHI, NULL) == 0);
+    ASSERT(count_op(&ir, IR_COPY, NULL) == 2);
+    ir_cfg_free(&cfg);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_dominators();
+    test_diamond_phi();
+    test_loop();
+    if (failures == 0)
+        printf("All opt_ssa tests passed\n");
+    else
+        printf("%d opt_ssa test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -13,26 +13,17 @@ static int failures = 0;
     } \
 } while (0)
 
-static void push_macro(vector_t *macros, const char *name, const char *value)
+static void push_macro(macro_table_t *macros, const char *name,
+                       const char *value)
 {
-    macro_t m;
-    m.name = strdup(name);
-    vector_init(&m.params, sizeof(char *));
-    m.variadic = 0;
-    m.value = strdup(value);
-    vector_push(macros, &m);
-}
-
-static void free_macros(vector_t *macros)
-{
-    for (size_t i = 0; i < macros->count; i++)
-        macro_free(&((macro_t *)macros->data)[i]);
-    vector_free(macros);
+    vector_t params;
+    vector_init(&params, sizeof(char *));
+    add_macro(name, value, &params, 0, macros);
 }
 
 static void test_features_expr(void)
 {
-    vector_t macros; vector_init(&macros, sizeof(macro_t));
+    macro_table_t macros; macro_table_init(&macros);
 
     ASSERT(eval_expr_full("defined FOO", &macros, NULL, NULL, NULL) == 0);
     ASSERT(eval_expr_full("(11 << 16) + 1 >= (10 << 16) + 1", &macros,
@@ -41,30 +32,30 @@ static void test_features_expr(void)
     ASSERT(eval_expr_full("1 ? 2 : 3", &macros, NULL, NULL, NULL));
     ASSERT(eval_expr_full("0 ? 2 : 3", &macros, NULL, NULL, NULL));
 
-    vector_free(&macros);
+    macro_table_free(&macros);
 }
 
 static void test_large_constants(void)
 {
-    vector_t macros; vector_init(&macros, sizeof(macro_t));
+    macro_table_t macros; macro_table_init(&macros);
 
     ASSERT(eval_expr_full("4294967296", &macros, NULL, NULL, NULL) == 4294967296LL);
     ASSERT(eval_expr_full("9223372036854775807", &macros, NULL, NULL, NULL) == 9223372036854775807LL);
     ASSERT(eval_expr_full("-9223372036854775807 - 1", &macros, NULL, NULL, NULL) == (-9223372036854775807LL - 1LL));
 
-    vector_free(&macros);
+    macro_table_free(&macros);
 }
 
 static void test_shift_clamp(void)
 {
-    vector_t macros; vector_init(&macros, sizeof(macro_t));
+    macro_table_t macros; macro_table_init(&macros);
 
     ASSERT(eval_expr_full("1 << 70", &macros, NULL, NULL, NULL) == (long long)(1ULL << 63));
     ASSERT(eval_expr_full("8 >> 70", &macros, NULL, NULL, NULL) == 0);
     ASSERT(eval_expr_full("1 << -1", &macros, NULL, NULL, NULL) == 1);
     ASSERT(eval_expr_full("8 >> -2", &macros, NULL, NULL, NULL) == 8);
 
-    vector_free(&macros);
+    macro_table_free(&macros);
 }
 
 int main(void)
@@ -14,7 +14,7 @@ static int failures = 0;
     } \
 } while (0)
 
-static void add_echo_macro(vector_t *macros)
+static void add_echo_macro(macro_table_t *macros)
 {
     vector_t params;
     vector_init(&params, sizeof(char *));
@@ -25,7 +25,7 @@ static void add_echo_macro(vector_t *macros)
 
 static void run_case(const char *call, const char *expect)
 {
-    vector_t macros; vector_init(&macros, sizeof(macro_t));
+    macro_table_t macros; macro_table_init(&macros);
     add_echo_macro(&macros);
 
     strbuf_t sb; strbuf_init(&sb);
@@ -35,8 +35,7 @@ static void run_case(const char *call, const char *expect)
     ASSERT(strcmp(sb.data, expect) == 0);
     strbuf_free(&sb);
 
-    macro_free(&((macro_t *)macros.data)[0]);
-    vector_free(&macros);
+    macro_table_free(&macros);
 }
 
 int main(void)
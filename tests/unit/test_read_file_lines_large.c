@@ -13,8 +13,41 @@ static int failures = 0;
     } \
 } while (0)
 
+/* CR, CRLF and backslash splices around the vectorized scan boundaries */
+static void test_splice_edges(void)
+{
+    static const char src[] =
+        "a\r\n"
+        "abcdefghijklmnopq\\\r\nrstuvwxyz0123456789\n"
+        "back\\slash\\\n"
+        "\\\r\n"
+        "end\\";
+    char tmpl[] = "/tmp/rfeXXXXXX";
+    int fd = mkstemp(tmpl);
+    ASSERT(fd >= 0);
+    if (fd < 0)
+        return;
+    ASSERT(write(fd, src, sizeof(src) - 1) == (ssize_t)(sizeof(src) - 1));
+    close(fd);
+
+    char **lines = NULL;
+    char *text = read_file_lines(tmpl, &lines);
+    ASSERT(text != NULL);
+    if (text) {
+        ASSERT(strcmp(lines[0], "a") == 0);
+        ASSERT(strcmp(lines[1], "abcdefghijklmnopqrstuvwxyz0123456789") == 0);
+        ASSERT(strcmp(lines[2], "back\\slashend\\") == 0);
+        ASSERT(lines[3] == NULL);
+    }
+    free(lines);
+    free(text);
+    unlink(tmpl);
+}
+
 int main(void)
 {
+    test_splice_edges();
+
     char tmpl[] = "/tmp/rflXXXXXX";
     int fd = mkstemp(tmpl);
     ASSERT(fd >= 0);
@@ -0,0 +1,163 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_memory.h"
+#include "regalloc.h"
+#include "regalloc_x86.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+int is_intlike(type_kind_t t) { (void)t; return 0; }
+
+/* Copy SRC into a fresh value at the end of the instruction list */
+static ir_value_t copy_value(ir_builder_t *ir, ir_value_t src)
+{
+    ir_value_t v = { (int)ir->next_value_id++ };
+    ir_insert_copy(ir, ir->tail, v.id, src.id, TYPE_INT);
+    return v;
+}
+
+/* A chain of copies ends up in a single register */
+static void test_copy_chain(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t x = ir_build_load(&ir, "X", TYPE_INT);
+    ir_value_t y = copy_value(&ir, x);
+    ir_value_t z = copy_value(&ir, y);
+    ir_build_store(&ir, "Z", TYPE_INT, z);
+    ir_build_func_end(&ir);
+
+    regalloc_set_x86_64(1);
+    regalloc_set_mode(REGALLOC_COLOR);
+    regalloc_t ra;
+    regalloc_run(&ir, &ra);
+    ASSERT(ra.loc[x.id] >= 0);
+    ASSERT(ra.loc[y.id] == ra.loc[x.id]);
+    ASSERT(ra.loc[z.id] == ra.loc[x.id]);
+    regalloc_free(&ra);
+    regalloc_set_mode(REGALLOC_LINEAR);
+    ir_builder_free(&ir);
+}
+
+/*
+ * The increment of a loop counter and the copy closing the loop, as left
+ * by SSA destruction, share the counter's register.  Linear scan keeps
+ * them apart.
+ */
+static void test_loop_copy(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t one = ir_build_load(&ir, "ONE", TYPE_INT);
+    ir_value_t i = copy_value(&ir, ir_build_load(&ir, "N", TYPE_INT));
+    ir_build_label(&ir, "L");
+    ir_value_t next = ir_build_binop(&ir, IR_SUB, i, one, TYPE_INT);
+    ir_instr_t *back = ir_insert_copy(&ir, ir.tail, i.id, next.id, TYPE_INT);
+    ASSERT(back != NULL);
+    ir_build_bcond(&ir, i, "L");
+    ir_build_return(&ir, one, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    regalloc_set_x86_64(1);
+    regalloc_set_mode(REGALLOC_COLOR);
+    regalloc_t ra;
+    regalloc_run(&ir, &ra);
+    ASSERT(ra.loc[i.id] >= 0);
+    ASSERT(ra.loc[next.id] == ra.loc[i.id]);
+    ASSERT(ra.loc[one.id] >= 0 && ra.loc[one.id] != ra.loc[i.id]);
+    regalloc_free(&ra);
+
+    regalloc_set_mode(REGALLOC_LINEAR);
+    regalloc_run(&ir, &ra);
+    ASSERT(ra.loc[next.id] != ra.loc[i.id]);
+    regalloc_free(&ra);
+    ir_builder_free(&ir);
+}
+
+/*
+ * In 32-bit mode the divisor avoids %eax and %edx, the result of a shift
+ * avoids %ecx and values live across either avoid the registers they
+ * write, whichever algorithm runs.
+ */
+static void test_fixed_registers(void)
+{
+    for (int mode = REGALLOC_LINEAR; mode <= REGALLOC_COLOR; mode++) {
+        ir_builder_t ir;
+        ir_builder_init(&ir);
+        ir_build_func_begin(&ir, "f");
+        ir_value_t a = ir_build_load(&ir, "A", TYPE_INT);
+        ir_value_t b = ir_build_load(&ir, "B", TYPE_INT);
+        ir_value_t s = ir_build_load(&ir, "S", TYPE_INT);
+        ir_value_t q = ir_build_binop(&ir, IR_DIV, a, b, TYPE_INT);
+        ir_value_t t = ir_build_binop(&ir, IR_SHL, q, s, TYPE_INT);
+        ir_value_t u = ir_build_binop(&ir, IR_ADD, t, b, TYPE_INT);
+        ir_build_store(&ir, "U", TYPE_INT, u);
+        ir_build_func_end(&ir);
+
+        regalloc_set_x86_64(0);
+        regalloc_set_mode((regalloc_mode_t)mode);
+        regalloc_t ra;
+        regalloc_run(&ir, &ra);
+        const regalloc_target_t *tgt = regalloc_target();
+        unsigned div = tgt->fixed_regs[0] | tgt->fixed_regs[2];
+        unsigned count = tgt->fixed_regs[1];
+        int lb = ra.loc[b.id], lt = ra.loc[t.id], ls = ra.loc[s.id];
+        ASSERT(lb < 0 || !(div & REGALLOC_REG_BIT(lb)));
+        ASSERT(lt < 0 || !(count & REGALLOC_REG_BIT(lt)));
+        /* s waits across the division, b across the shift */
+        ASSERT(ls < 0 || !(div & REGALLOC_REG_BIT(ls)));
+        ASSERT(lb < 0 || !(count & REGALLOC_REG_BIT(lb)));
+        regalloc_free(&ra);
+        ir_builder_free(&ir);
+    }
+    regalloc_set_mode(REGALLOC_LINEAR);
+}
+
+/* A returned value is colored with the return register when it is free */
+static void test_return_hint(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t a = ir_build_load(&ir, "A", TYPE_INT);
+    ir_value_t b = ir_build_load(&ir, "B", TYPE_INT);
+    ir_value_t c = ir_build_binop(&ir, IR_XOR, a, b, TYPE_INT);
+    ir_build_return(&ir, c, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    regalloc_set_x86_64(0);
+    regalloc_set_mode(REGALLOC_COLOR);
+    regalloc_t ra;
+    regalloc_run(&ir, &ra);
+    ASSERT(ra.loc[c.id] == REGALLOC_RET_REG);
+    ASSERT(ra.loc[a.id] == REGALLOC_RET_REG);
+    ASSERT(ra.loc[b.id] >= 0 && ra.loc[b.id] != REGALLOC_RET_REG);
+    regalloc_free(&ra);
+    regalloc_set_mode(REGALLOC_LINEAR);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_copy_chain();
+    test_loop_copy();
+    test_fixed_registers();
+    test_return_hint();
+    if (failures == 0)
+        printf("All regalloc_color tests passed\n");
+    else
+        printf("%d regalloc_color test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
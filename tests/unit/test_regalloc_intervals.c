@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_memory.h"
+#include "regalloc.h"
+#include "regalloc_x86.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+int is_intlike(type_kind_t t) { (void)t; return 0; }
+
+/* Sum N values loaded up front so they are all live at once */
+static void build_wave(ir_builder_t *ir, ir_value_t *v, int n)
+{
+    for (int i = 0; i < n; i++)
+        v[i] = ir_build_load(ir, "G", TYPE_INT);
+    ir_value_t sum = v[0];
+    for (int i = 1; i < n; i++)
+        sum = ir_build_binop(ir, IR_ADD, sum, v[i], TYPE_INT);
+    ir_build_store(ir, "G", TYPE_INT, sum);
+}
+
+/*
+ * Values spilled at different times share stack slots, and the scratch
+ * register spilled values go through holds none of the function's values.
+ */
+static void test_slot_reuse(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t a[8], b[8];
+    build_wave(&ir, a, 8);
+    build_wave(&ir, b, 8);
+    ir_build_return(&ir, a[0], TYPE_INT);
+    ir_build_func_end(&ir);
+
+    regalloc_set_x86_64(0);
+    regalloc_t ra;
+    regalloc_run(&ir, &ra);
+    int spilled = 0;
+    for (int i = 0; i < 8; i++)
+        spilled += (ra.loc[a[i].id] < 0) + (ra.loc[b[i].id] < 0);
+    ASSERT(spilled > 0);
+    ASSERT(ra.stack_slots > 0 && ra.stack_slots < spilled);
+    for (int i = 0; i < 8; i++) {
+        ASSERT(ra.loc[a[i].id] != REGALLOC_SCRATCH_REG);
+        ASSERT(ra.loc[b[i].id] != REGALLOC_SCRATCH_REG);
+    }
+    for (int i = 0; i < 8; i++)
+        for (int j = 0; j < 8; j++)
+            if (i != j && ra.loc[b[i].id] < 0)
+                ASSERT(ra.loc[b[i].id] != ra.loc[b[j].id]);
+    regalloc_free(&ra);
+    ir_builder_free(&ir);
+}
+
+/*
+ * Of three values live across a loop the one only used after the loop
+ * goes to the stack, and the dump names the value that took its register.
+ */
+static void test_loop_weight(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t a = ir_build_load(&ir, "A", TYPE_INT);
+    ir_value_t b = ir_build_load(&ir, "B", TYPE_INT);
+    ir_value_t c = ir_build_load(&ir, "C", TYPE_INT);
+    ir_build_label(&ir, "L");
+    ir_value_t t = ir_build_binop(&ir, IR_ADD, b, c, TYPE_INT);
+    ir_build_store(&ir, "T", TYPE_INT, t);
+    ir_build_bcond(&ir, t, "L");
+    ir_build_return(&ir, a, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    regalloc_set_x86_64(0);
+    FILE *dump = tmpfile();
+    ASSERT(dump != NULL);
+    regalloc_set_dump(dump);
+    regalloc_t ra;
+    regalloc_run(&ir, &ra);
+    regalloc_set_dump(NULL);
+    ASSERT(ra.loc[a.id] < 0);
+    ASSERT(ra.loc[b.id] >= 0);
+    ASSERT(ra.loc[c.id] >= 0);
+    regalloc_free(&ra);
+
+    if (dump) {
+        char buf[1024];
+        size_t n = 0;
+        rewind(dump);
+        n = fread(buf, 1, sizeof(buf) - 1, dump);
+        buf[n] = '\0';
+        char want[32];
+        snprintf(want, sizeof(want), "evicted by v%d", c.id);
+        ASSERT(strstr(buf, "function f\n") != NULL);
+        ASSERT(strstr(buf, want) != NULL);
+        fclose(dump);
+    }
+    ir_builder_free(&ir);
+}
+
+/*
+ * Values live only on the two arms of a branch share the registers of
+ * the global class through the holes in each other's intervals.
+ */
+static void test_hole(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t x = ir_build_load(&ir, "X", TYPE_INT);
+    ir_value_t y = ir_build_load(&ir, "Y", TYPE_INT);
+    ir_build_bcond(&ir, x, "A");
+    ir_value_t z = ir_build_load(&ir, "Z", TYPE_INT);
+    ir_value_t u = ir_build_load(&ir, "U", TYPE_INT);
+    ir_build_br(&ir, "C");
+    ir_build_label(&ir, "A");
+    ir_build_store(&ir, "Y", TYPE_INT, y);
+    ir_build_return(&ir, x, TYPE_INT);
+    ir_build_label(&ir, "C");
+    ir_build_store(&ir, "U", TYPE_INT, u);
+    ir_build_return(&ir, z, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    regalloc_set_x86_64(0);
+    regalloc_t ra;
+    regalloc_run(&ir, &ra);
+    unsigned global = regalloc_target()->global_regs;
+    ASSERT(ra.loc[x.id] >= 0 && (global & REGALLOC_REG_BIT(ra.loc[x.id])));
+    ASSERT(ra.loc[y.id] >= 0 && (global & REGALLOC_REG_BIT(ra.loc[y.id])));
+    ASSERT(ra.loc[z.id] == ra.loc[x.id] || ra.loc[z.id] == ra.loc[y.id]);
+    ASSERT(ra.loc[u.id] == ra.loc[x.id] || ra.loc[u.id] == ra.loc[y.id]);
+    ASSERT(ra.stack_slots == 0);
+    regalloc_free(&ra);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_slot_reuse();
+    test_loop_weight();
+    test_hole();
+    if (failures == 0)
+        printf("All regalloc_intervals tests passed\n");
+    else
+        printf("%d regalloc_intervals test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir_core.h"
+#include "ir_builder.h"
+#include "ir_control.h"
+#include "ir_memory.h"
+#include "ir_const.h"
+#include "codegen.h"
+#include "regalloc.h"
+#include "regalloc_x86.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+int is_intlike(type_kind_t t) { (void)t; return 0; }
+
+static int in_mask(int loc, unsigned mask)
+{
+    return loc >= 0 && (mask & REGALLOC_REG_BIT(loc));
+}
+
+/* A value live across a call takes a callee-saved register */
+static void test_call_crossing(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t v = ir_build_load(&ir, "G", TYPE_INT);
+    ir_value_t r = ir_build_call(&ir, "h", 0);
+    ir_value_t s = ir_build_binop(&ir, IR_ADD, v, r, TYPE_INT);
+    ir_build_return(&ir, s, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    regalloc_set_x86_64(1);
+    regalloc_t ra;
+    regalloc_run(&ir, &ra);
+    ASSERT(in_mask(ra.loc[v.id], regalloc_target()->callee_saved));
+    regalloc_free(&ra);
+
+    regalloc_set_x86_64(0);
+    regalloc_run(&ir, &ra);
+    ASSERT(in_mask(ra.loc[v.id], regalloc_target()->callee_saved));
+    regalloc_free(&ra);
+    ir_builder_free(&ir);
+}
+
+/*
+ * Addresses of strings and globals have no value operands but are just as
+ * live across a call, and the dump reports the crossing.
+ */
+static void test_call_crossing_address(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t s = ir_build_string(&ir, "%d", 2);
+    ir_value_t g = ir_build_addr(&ir, "G");
+    ir_value_t r = ir_build_call(&ir, "h", 0);
+    ir_build_arg(&ir, s, TYPE_PTR);
+    ir_build_arg(&ir, g, TYPE_PTR);
+    ir_build_arg(&ir, r, TYPE_INT);
+    ir_value_t t = ir_build_call(&ir, "printf", 3);
+    ir_build_return(&ir, t, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    regalloc_set_x86_64(1);
+    FILE *dump = tmpfile();
+    ASSERT(dump != NULL);
+    regalloc_set_dump(dump);
+    regalloc_t ra;
+    regalloc_run(&ir, &ra);
+    regalloc_set_dump(NULL);
+    ASSERT(in_mask(ra.loc[s.id], regalloc_target()->callee_saved));
+    ASSERT(in_mask(ra.loc[g.id], regalloc_target()->callee_saved));
+    regalloc_free(&ra);
+
+    if (dump) {
+        char buf[1024];
+        char want[32];
+        rewind(dump);
+        size_t n = fread(buf, 1, sizeof(buf) - 1, dump);
+        buf[n] = '\0';
+        snprintf(want, sizeof(want), "  v%d [", s.id);
+        char *line = strstr(buf, want);
+        ASSERT(line && strstr(line, "{ call") &&
+               strstr(line, "{ call") < strchr(line, '\n'));
+        fclose(dump);
+    }
+
+    regalloc_set_x86_64(0);
+    regalloc_run(&ir, &ra);
+    ASSERT(in_mask(ra.loc[s.id], regalloc_target()->callee_saved));
+    ASSERT(in_mask(ra.loc[g.id], regalloc_target()->callee_saved));
+    regalloc_free(&ra);
+    ir_builder_free(&ir);
+}
+
+/* Values live while arguments are passed avoid the argument registers */
+static void test_arg_regs(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t a = ir_build_load(&ir, "A", TYPE_INT);
+    ir_value_t b = ir_build_load(&ir, "B", TYPE_INT);
+    ir_build_arg(&ir, a, TYPE_INT);
+    ir_value_t c = ir_build_load(&ir, "C", TYPE_INT);
+    ir_build_arg(&ir, b, TYPE_INT);
+    ir_build_arg(&ir, c, TYPE_INT);
+    ir_value_t r = ir_build_call(&ir, "h", 3);
+    ir_build_return(&ir, r, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    regalloc_set_x86_64(1);
+    regalloc_t ra;
+    regalloc_run(&ir, &ra);
+    unsigned args = regalloc_target()->arg_regs;
+    ASSERT(!in_mask(ra.loc[b.id], args));
+    ASSERT(!in_mask(ra.loc[c.id], args));
+    regalloc_free(&ra);
+    ir_builder_free(&ir);
+}
+
+/*
+ * Nine values live at once fit the 64-bit pool, %r8-%r15 included, while
+ * 32-bit code never sees those registers and keeps bytes in registers
+ * with a byte form.
+ */
+static void test_pressure(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t v[9];
+    for (int i = 0; i < 9; i++)
+        v[i] = ir_build_load(&ir, "G", i == 8 ? TYPE_CHAR : TYPE_INT);
+    ir_value_t sum = v[0];
+    for (int i = 1; i < 9; i++)
+        sum = ir_build_binop(&ir, IR_ADD, sum, v[i], TYPE_INT);
+    ir_build_return(&ir, sum, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    regalloc_set_x86_64(1);
+    regalloc_t ra;
+    regalloc_run(&ir, &ra);
+    int high = 0;
+    for (int i = 0; i < 9; i++) {
+        ASSERT(ra.loc[v[i].id] >= 0);
+        high += ra.loc[v[i].id] >= 6;
+    }
+    ASSERT(high > 0);
+    ASSERT(ra.stack_slots == 0);
+    regalloc_free(&ra);
+
+    regalloc_set_x86_64(0);
+    regalloc_run(&ir, &ra);
+    for (int i = 0; i < 9; i++)
+        ASSERT(ra.loc[v[i].id] < 6);
+    int loc = ra.loc[v[8].id];
+    ASSERT(loc < 0 || in_mask(loc, regalloc_target()->byte_regs));
+    regalloc_free(&ra);
+    ir_builder_free(&ir);
+}
+
+/* The prologue saves the callee-saved registers a function writes */
+static void test_prologue(void)
+{
+    ir_builder_t ir;
+    ir_builder_init(&ir);
+    ir_build_func_begin(&ir, "f");
+    ir_value_t v = ir_build_load(&ir, "G", TYPE_INT);
+    ir_value_t r = ir_build_call(&ir, "h", 0);
+    ir_value_t s = ir_build_binop(&ir, IR_ADD, v, r, TYPE_INT);
+    ir_build_return(&ir, s, TYPE_INT);
+    ir_build_func_end(&ir);
+    ir_build_func_begin(&ir, "g");
+    ir_value_t k = ir_build_load(&ir, "G", TYPE_INT);
+    ir_build_return(&ir, k, TYPE_INT);
+    ir_build_func_end(&ir);
+
+    char *out = codegen_ir_to_string(&ir, 1, ASM_ATT);
+    ASSERT(out != NULL);
+    if (out) {
+        char *g = strstr(out, "\ng:");
+        ASSERT(g != NULL);
+        if (g) {
+            char *save = strstr(out, "    movq %rbx, -8(%rbp)\n");
+            char *restore = strstr(out, "    movq -8(%rbp), %rbx\n");
+            ASSERT(save && save < g);
+            ASSERT(restore && restore > save && restore < g);
+            ASSERT(strstr(g, "%rbx") == NULL);
+        }
+        free(out);
+    }
+    regalloc_set_x86_64(0);
+    ir_builder_free(&ir);
+}
+
+int main(void)
+{
+    test_call_crossing();
+    test_call_crossing_address();
+    test_arg_regs();
+    test_pressure();
+    test_prologue();
+    if (failures == 0)
+        printf("All regalloc_target tests passed\n");
+    else
+        printf("%d regalloc_target test(s) failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -24,6 +24,7 @@ static int check(const char *out, const char *exp, const char *name) {
 
 int main(void) {
     strbuf_t sb;
+    x86_insn_list_t code;
     int locs[2] = {0, -1};
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins = { .op = IR_RETURN, .src1 = 1, .type = TYPE_DOUBLE };
@@ -33,12 +34,18 @@ int main(void) {
     regalloc_set_x86_64(1);
 
     regalloc_set_asm_syntax(ASM_ATT);
-    emit_branch_instr(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_branch_instr(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "    movsd -8(%rbp), %xmm0\n    ret\n", "ATT");
     sb.len = 0; if (sb.data) sb.data[0] = '\0';
 
     regalloc_set_asm_syntax(ASM_INTEL);
-    emit_branch_instr(&sb, &ins, &ra, 1, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_branch_instr(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     fail |= check(sb.data, "    movsd xmm0, [rbp-8]\n    ret\n", "Intel");
 
     strbuf_free(&sb);
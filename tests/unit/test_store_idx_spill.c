@@ -6,16 +6,6 @@
 #include "regalloc.h"
 
 /* Provide minimal stubs required by codegen helpers. */
-const char *fmt_stack(char buf[32], const char *name, int x64,
-                      asm_syntax_t syntax) {
-    (void)x64;
-    if (syntax == ASM_INTEL) {
-        snprintf(buf, 32, "[%s]", name);
-        return buf;
-    }
-    return name;
-}
-
 void *vc_alloc_or_exit(size_t sz) { return malloc(sz); }
 void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
 
@@ -28,6 +18,7 @@ int main(void) {
     regalloc_t ra = { .loc = locs, .stack_slots = 0 };
     ir_instr_t ins;
     strbuf_t sb;
+    x86_insn_list_t code;
 
     /* index in stack slot, value in register */
     ra.loc[1] = -1; /* spilled index */
@@ -40,7 +31,10 @@ int main(void) {
     ins.imm = 4;
 
     strbuf_init(&sb);
-    emit_store_idx(&sb, &ins, &ra, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_store_idx(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (has_invalid(sb.data) || !strstr(sb.data, "(,%eax,")) {
         printf("store idx spill ATT failed: %s\n", sb.data);
         return 1;
@@ -48,7 +42,10 @@ int main(void) {
     strbuf_free(&sb);
 
     strbuf_init(&sb);
-    emit_store_idx(&sb, &ins, &ra, 0, ASM_INTEL);
+    x86_insn_list_init(&code);
+    emit_store_idx(&code, &ins, &ra, 0);
+    x86_insn_list_print(&sb, &code, ASM_INTEL);
+    x86_insn_list_free(&code);
     if (has_invalid(sb.data) || !strstr(sb.data, "+eax*")) {
         printf("store idx spill Intel failed: %s\n", sb.data);
         return 1;
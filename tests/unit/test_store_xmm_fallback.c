@@ -5,18 +5,6 @@
 #include "strbuf.h"
 #include "regalloc_x86.h"
 
-/* Minimal fmt_stack to interpret "stack:" operands. */
-const char *fmt_stack(char buf[32], const char *name, int x64, asm_syntax_t syntax) {
-    if (strncmp(name, "stack:", 6) != 0)
-        return name;
-    long off = strtol(name + 6, NULL, 10);
-    if (syntax == ASM_INTEL)
-        snprintf(buf, 32, x64 ? "[rbp-%ld]" : "[ebp-%ld]", off);
-    else
-        snprintf(buf, 32, x64 ? "-%ld(%%rbp)" : "-%ld(%%ebp)", off);
-    return buf;
-}
-
 void *vc_alloc_or_exit(size_t sz) { return malloc(sz); }
 void *vc_realloc_or_exit(void *p, size_t sz) { return realloc(p, sz); }
 
@@ -27,6 +15,7 @@ static int has_fail(const char *s) {
 int main(void) {
     ir_instr_t ins = {0};
     strbuf_t sb;
+    x86_insn_list_t code;
     int locs[2] = {0};
     regalloc_t ra = { .loc = locs };
 
@@ -44,7 +33,10 @@ int main(void) {
     ins.type = TYPE_DOUBLE_COMPLEX; /* 16 bytes */
 
     strbuf_init(&sb);
-    emit_store(&sb, &ins, &ra, 1, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_store(&code, &ins, &ra, 1);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!has_fail(sb.data)) {
         printf("store xmm fallback missing: %s\n", sb.data);
         return 1;
@@ -99,16 +99,13 @@ static void test_parse_variadic(void)
 
 static void test_variadic_expand(void)
 {
-    vector_t macros;
-    vector_init(&macros, sizeof(macro_t));
-    macro_t m;
-    m.name = strdup("LOG");
-    vector_init(&m.params, sizeof(char *));
+    macro_table_t macros;
+    macro_table_init(&macros);
+    vector_t params;
+    vector_init(&params, sizeof(char *));
     char *p = strdup("fmt");
-    vector_push(&m.params, &p);
-    m.variadic = 1;
-    m.value = strdup("printf(fmt, __VA_ARGS__)");
-    vector_push(&macros, &m);
+    vector_push(&params, &p);
+    add_macro("LOG", "printf(fmt, __VA_ARGS__)", &params, 1, &macros);
 
     strbuf_t sb;
     strbuf_init(&sb);
@@ -118,8 +115,7 @@ static void test_variadic_expand(void)
     ASSERT(strcmp(sb.data, "printf(\"%d\", 1)") == 0);
     strbuf_free(&sb);
 
-    macro_free(&((macro_t *)macros.data)[0]);
-    vector_free(&macros);
+    macro_table_free(&macros);
 }
 
 int main(void)
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <string.h>
+#include "x86_insn.h"
+
+static int failures = 0;
+#define ASSERT(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "Assertion failed: %s (%s:%d)\n", #cond, __FILE__, __LINE__); \
+        failures++; \
+    } \
+} while (0)
+
+/* Print CODE in SYNTAX and compare the text with EXPECT */
+static int prints(const x86_insn_list_t *code, asm_syntax_t syntax,
+                  const char *expect)
+{
+    strbuf_t sb;
+    strbuf_init(&sb);
+    int ok = x86_insn_list_print(&sb, code, syntax) == 0 &&
+             strcmp(sb.data ? sb.data : "", expect) == 0;
+    if (!ok)
+        fprintf(stderr, "unexpected:\n%s", sb.data ? sb.data : "");
+    strbuf_free(&sb);
+    return ok;
+}
+
+static void test_operand_order(void)
+{
+    x86_insn_list_t code;
+    x86_insn_list_init(&code);
+    x86_emit2(&code, X86_MOV, 'l', x86_mem(X86_BP, 4, -8), x86_reg(X86_AX, 4));
+    x86_emit2(&code, X86_SUB, 'q', x86_imm(16), x86_reg(X86_SP, 8));
+    x86_emit2(&code, X86_SUBSS, 0, x86_reg(X86_XMM1, 16),
+              x86_reg(X86_XMM0, 16));
+    ASSERT(prints(&code, ASM_ATT,
+                  "    movl -8(%ebp), %eax\n"
+                  "    subq $16, %rsp\n"
+                  "    subss %xmm1, %xmm0\n"));
+    ASSERT(prints(&code, ASM_INTEL,
+                  "    movl eax, [ebp-8]\n"
+                  "    subq rsp, 16\n"
+                  "    subss xmm0, xmm1\n"));
+    x86_insn_list_free(&code);
+}
+
+static void test_memory_operands(void)
+{
+    x86_insn_list_t code;
+    x86_insn_list_init(&code);
+    x86_operand_t frame = x86_mem(X86_BP, 4, -8);
+    frame.index = X86_CX;
+    frame.scale = 4;
+    x86_operand_t glob = x86_mem(X86_NOREG, 4, 16);
+    glob.sym = "arr";
+    glob.index = X86_CX;
+    glob.scale = 1;
+    x86_emit2(&code, X86_MOV, 'l', frame, x86_reg(X86_AX, 4));
+    x86_emit2(&code, X86_MOV, 'l', glob, x86_reg(X86_AX, 4));
+    x86_emit1(&code, X86_FLDT, 0, x86_mem(X86_BP, 8, 0));
+    ASSERT(prints(&code, ASM_ATT,
+                  "    movl -8(%ebp,%ecx,4), %eax\n"
+                  "    movl arr+16(,%ecx,1), %eax\n"
+                  "    fldt -0(%rbp)\n"));
+    ASSERT(prints(&code, ASM_INTEL,
+                  "    movl eax, [ebp-8+ecx*4]\n"
+                  "    movl eax, [arr+16+ecx]\n"
+                  "    fld tword ptr [rbp-0]\n"));
+    x86_insn_list_free(&code);
+}
+
+static void test_bare_and_immediates(void)
+{
+    x86_insn_list_t code;
+    x86_insn_list_init(&code);
+    x86_insn_t ins = {0};
+    ins.op = X86_ADD;
+    ins.sfx = 'q';
+    ins.flags = X86_INSF_BARE;
+    ins.nops = 2;
+    ins.ops[0] = x86_reg(X86_R8, 8);
+    ins.ops[1] = x86_reg(X86_AX, 8);
+    x86_emit_insn(&code, &ins);
+    x86_emit2(&code, X86_AND, 'q', x86_uimm(0xffffffff00000000ULL),
+              x86_reg(X86_CX, 8));
+    x86_operand_t addr = x86_sym_addr("msg");
+    addr.flags |= X86_OPF_FLAT;
+    x86_emit2(&code, X86_MOV, 'l', addr, x86_reg(X86_DX, 4));
+    ASSERT(prints(&code, ASM_ATT,
+                  "    addq %r8, %rax\n"
+                  "    andq $18446744069414584320, %rcx\n"
+                  "    movl $msg, %edx\n"));
+    ASSERT(prints(&code, ASM_INTEL,
+                  "    add rax, r8\n"
+                  "    andq rcx, 18446744069414584320\n"
+                  "    movl edx, OFFSET FLAT:msg\n"));
+    x86_insn_list_free(&code);
+}
+
+static void test_control_flow(void)
+{
+    x86_insn_list_t code;
+    x86_insn_list_init(&code);
+    x86_emit1(&code, X86_GLOBL, 0, x86_sym("f"));
+    x86_emit1(&code, X86_LABEL, 0, x86_sym("f"));
+    x86_emit2(&code, X86_LOC, 0, x86_imm(3), x86_imm(5));
+    x86_emit_cc(&code, X86_JCC, X86_CC_NE, x86_label(7, "_true"));
+    x86_emit_cc(&code, X86_SETCC, X86_CC_BE, x86_reg(X86_AX, 1));
+    x86_emit1(&code, X86_CALL, 0, x86_reg(X86_BX, 4));
+    x86_emit1(&code, X86_LABEL, 0, x86_label(7, "_true"));
+    x86_emit1(&code, X86_COMMENT, 0, x86_sym("note"));
+    x86_emit0(&code, X86_RET, 0);
+    ASSERT(prints(&code, ASM_ATT,
+                  ".globl f\n"
+                  "f:\n"
+                  ".loc 1 3 5\n"
+                  "    jne L7_true\n"
+                  "    setbe %al\n"
+                  "    call *%ebx\n"
+                  "L7_true:\n"
+                  "    # note\n"
+                  "    ret\n"));
+    ASSERT(prints(&code, ASM_INTEL,
+                  ".globl f\n"
+                  "f:\n"
+                  ".loc 1 3 5\n"
+                  "    jne L7_true\n"
+                  "    setbe al\n"
+                  "    call ebx\n"
+                  "L7_true:\n"
+                  "    # note\n"
+                  "    ret\n"));
+    x86_insn_list_free(&code);
+}
+
+static void test_operand_equal(void)
+{
+    x86_operand_t a = x86_reg(X86_AX, 4);
+    x86_operand_t b = x86_reg(X86_AX, 8);
+    x86_operand_t c = x86_mem(X86_BP, 4, -4);
+    x86_operand_t d = x86_mem(X86_BP, 4, -4);
+    ASSERT(!x86_operand_equal(&a, &b));
+    ASSERT(x86_operand_equal(&c, &d));
+    d.value = -8;
+    ASSERT(!x86_operand_equal(&c, &d));
+}
+
+int main(void)
+{
+    test_operand_order();
+    test_memory_operands();
+    test_bare_and_immediates();
+    test_control_flow();
+    test_operand_equal();
+    if (failures) {
+        printf("%d x86_insn test(s) failed\n", failures);
+        return 1;
+    }
+    printf("All x86_insn tests passed\n");
+    return 0;
+}
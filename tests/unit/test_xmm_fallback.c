@@ -15,6 +15,7 @@ static int has_fail(const char *s) {
 int main(void) {
     ir_instr_t ins = {0};
     strbuf_t sb;
+    x86_insn_list_t code;
 
     regalloc_set_asm_syntax(ASM_ATT);
 
@@ -23,7 +24,10 @@ int main(void) {
     while (regalloc_xmm_acquire() >= 0)
         ;
     strbuf_init(&sb);
-    emit_float_binop(&sb, &ins, NULL, 0, "addss", ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_float_binop(&code, &ins, NULL, 0, X86_ADDSS);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!has_fail(sb.data)) {
         printf("float binop fallback missing: %s\n", sb.data);
         return 1;
@@ -35,7 +39,10 @@ int main(void) {
     while (regalloc_xmm_acquire() >= 0)
         ;
     strbuf_init(&sb);
-    emit_cplx_mul(&sb, &ins, NULL, 0, ASM_ATT);
+    x86_insn_list_init(&code);
+    emit_cplx_mul(&code, &ins, NULL, 0);
+    x86_insn_list_print(&sb, &code, ASM_ATT);
+    x86_insn_list_free(&code);
     if (!has_fail(sb.data)) {
         printf("complex mul fallback missing: %s\n", sb.data);
         return 1;